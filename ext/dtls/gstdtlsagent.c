@@ -36,6 +36,7 @@
 # define DEPRECATED_IN_MAC_OS_X_VERSION_10_7_AND_LATER
 #endif
 
+#include <openssl/ec.h>
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 
@@ -60,8 +61,15 @@ struct _GstDtlsAgentPrivate
   SSL_CTX *ssl_context;
 
   GstDtlsCertificate *certificate;
+
+  /* client sessions for resumption, by connection id */
+  GMutex sessions_lock;
+  GHashTable *sessions;
 };
 
+/* sessions are only resumed by agents with the same context */
+static const guint8 session_id_context[] = "gstdtls";
+
 static void gst_dtls_agent_finalize (GObject * gobject);
 static void gst_dtls_agent_set_property (GObject *, guint prop_id,
     const GValue *, GParamSpec *);
@@ -189,7 +197,29 @@ gst_dtls_agent_init (GstDtlsAgent * self)
   SSL_CTX_set_read_ahead (priv->ssl_context, 1);
 #if OPENSSL_VERSION_NUMBER >= 0x1000200fL
   SSL_CTX_set_ecdh_auto (priv->ssl_context, 1);
+#else
+  {
+    /* needed for the ECDHE-ECDSA ciphers of ECDSA certificates */
+    EC_KEY *ecdh = EC_KEY_new_by_curve_name (NID_X9_62_prime256v1);
+
+    if (ecdh) {
+      SSL_CTX_set_tmp_ecdh (priv->ssl_context, ecdh);
+      EC_KEY_free (ecdh);
+    }
+  }
 #endif
+
+  /* Servers keep sessions in the context cache and hand out tickets,
+   * clients keep the session of each connection id so that a repeated
+   * connection can resume it with an abbreviated handshake. A session id
+   * context is required for resumption when peers are verified. */
+  SSL_CTX_set_session_cache_mode (priv->ssl_context, SSL_SESS_CACHE_SERVER);
+  SSL_CTX_set_session_id_context (priv->ssl_context, session_id_context,
+      sizeof (session_id_context) - 1);
+
+  g_mutex_init (&priv->sessions_lock);
+  priv->sessions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) SSL_SESSION_free);
 }
 
 static void
@@ -200,6 +230,14 @@ gst_dtls_agent_finalize (GObject * gobject)
   SSL_CTX_free (priv->ssl_context);
   priv->ssl_context = NULL;
 
+  if (priv->certificate) {
+    g_object_unref (priv->certificate);
+    priv->certificate = NULL;
+  }
+
+  g_hash_table_unref (priv->sessions);
+  g_mutex_clear (&priv->sessions_lock);
+
   GST_DEBUG_OBJECT (gobject, "finalized");
 
   G_OBJECT_CLASS (gst_dtls_agent_parent_class)->finalize (gobject);
@@ -272,3 +310,35 @@ _gst_dtls_agent_peek_context (GstDtlsAgent * self)
   g_return_val_if_fail (GST_IS_DTLS_AGENT (self), NULL);
   return self->priv->ssl_context;
 }
+
+void
+_gst_dtls_agent_store_session (GstDtlsAgent * self, const gchar * id,
+    GstDtlsAgentSession session)
+{
+  g_return_if_fail (GST_IS_DTLS_AGENT (self));
+  g_return_if_fail (id);
+
+  g_mutex_lock (&self->priv->sessions_lock);
+  if (session)
+    g_hash_table_insert (self->priv->sessions, g_strdup (id), session);
+  else
+    g_hash_table_remove (self->priv->sessions, id);
+  g_mutex_unlock (&self->priv->sessions_lock);
+}
+
+GstDtlsAgentSession
+_gst_dtls_agent_get_session (GstDtlsAgent * self, const gchar * id)
+{
+  SSL_SESSION *session;
+
+  g_return_val_if_fail (GST_IS_DTLS_AGENT (self), NULL);
+  g_return_val_if_fail (id, NULL);
+
+  g_mutex_lock (&self->priv->sessions_lock);
+  session = g_hash_table_lookup (self->priv->sessions, id);
+  if (session)
+    CRYPTO_add (&session->references, 1, CRYPTO_LOCK_SSL_SESSION);
+  g_mutex_unlock (&self->priv->sessions_lock);
+
+  return session;
+}
@@ -40,6 +40,7 @@ G_BEGIN_DECLS
 #define GST_DTLS_AGENT_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_DTLS_AGENT, GstDtlsAgentClass))
 
 typedef gpointer GstDtlsAgentContext;
+typedef gpointer GstDtlsAgentSession;
 
 typedef struct _GstDtlsAgent        GstDtlsAgent;
 typedef struct _GstDtlsAgentClass   GstDtlsAgentClass;
@@ -77,6 +78,13 @@ gchar *gst_dtls_agent_get_certificate_pem(GstDtlsAgent *self);
 void _gst_dtls_init_openssl(void);
 const GstDtlsAgentContext _gst_dtls_agent_peek_context(GstDtlsAgent *);
 
+/*
+ * Client sessions kept for resumption. Storing takes the reference of the
+ * session, NULL forgets it. Getting returns a new reference or NULL.
+ */
+void _gst_dtls_agent_store_session(GstDtlsAgent *, const gchar *id, GstDtlsAgentSession);
+GstDtlsAgentSession _gst_dtls_agent_get_session(GstDtlsAgent *, const gchar *id);
+
 G_END_DECLS
 
 #endif /* gstdtlsagent_h */
@@ -38,6 +38,7 @@
 # define DEPRECATED_IN_MAC_OS_X_VERSION_10_7_AND_LATER
 #endif
 
+#include <openssl/ec.h>
 #include <openssl/ssl.h>
 
 GST_DEBUG_CATEGORY_STATIC (gst_dtls_certificate_debug);
@@ -53,12 +54,14 @@ enum
 {
   PROP_0,
   PROP_PEM,
+  PROP_KEY_TYPE,
   NUM_PROPERTIES
 };
 
 static GParamSpec *properties[NUM_PROPERTIES];
 
 #define DEFAULT_PEM NULL
+#define DEFAULT_KEY_TYPE GST_DTLS_KEY_TYPE_RSA
 
 struct _GstDtlsCertificatePrivate
 {
@@ -66,8 +69,28 @@ struct _GstDtlsCertificatePrivate
   EVP_PKEY *private_key;
 
   gchar *pem;
+  GstDtlsKeyType key_type;
 };
 
+GType
+gst_dtls_key_type_get_type (void)
+{
+  static gsize id = 0;
+  static const GEnumValue values[] = {
+    {GST_DTLS_KEY_TYPE_RSA, "2048 bit RSA", "rsa"},
+    {GST_DTLS_KEY_TYPE_ECDSA, "ECDSA P-256", "ecdsa"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&id)) {
+    GType tmp = g_enum_register_static ("GstDtlsKeyType", values);
+    g_once_init_leave (&id, tmp);
+  }
+
+  return (GType) id;
+}
+
+static void gst_dtls_certificate_constructed (GObject * gobject);
 static void gst_dtls_certificate_finalize (GObject * gobject);
 static void gst_dtls_certificate_set_property (GObject *, guint prop_id,
     const GValue *, GParamSpec *);
@@ -94,10 +117,18 @@ gst_dtls_certificate_class_init (GstDtlsCertificateClass * klass)
       DEFAULT_PEM,
       G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_KEY_TYPE] =
+      g_param_spec_enum ("key-type",
+      "Key type",
+      "Type of the private key of a generated certificate",
+      GST_TYPE_DTLS_KEY_TYPE, DEFAULT_KEY_TYPE,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class, NUM_PROPERTIES, properties);
 
   _gst_dtls_init_openssl ();
 
+  gobject_class->constructed = gst_dtls_certificate_constructed;
   gobject_class->finalize = gst_dtls_certificate_finalize;
 }
 
@@ -110,6 +141,26 @@ gst_dtls_certificate_init (GstDtlsCertificate * self)
   priv->x509 = NULL;
   priv->private_key = NULL;
   priv->pem = NULL;
+  priv->key_type = DEFAULT_KEY_TYPE;
+}
+
+/* Both construct properties are needed to know what to do, so this happens
+ * once they are all set */
+static void
+gst_dtls_certificate_constructed (GObject * gobject)
+{
+  GstDtlsCertificate *self = GST_DTLS_CERTIFICATE (gobject);
+  gchar *pem = self->priv->pem;
+
+  self->priv->pem = NULL;
+  if (pem) {
+    init_from_pem_string (self, pem);
+    g_free (pem);
+  } else {
+    init_generated (self);
+  }
+
+  G_OBJECT_CLASS (gst_dtls_certificate_parent_class)->constructed (gobject);
 }
 
 static void
@@ -135,16 +186,14 @@ gst_dtls_certificate_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
 {
   GstDtlsCertificate *self = GST_DTLS_CERTIFICATE (object);
-  const gchar *pem;
 
   switch (prop_id) {
     case PROP_PEM:
-      pem = g_value_get_string (value);
-      if (pem) {
-        init_from_pem_string (self, pem);
-      } else {
-        init_generated (self);
-      }
+      g_free (self->priv->pem);
+      self->priv->pem = g_value_dup_string (value);
+      break;
+    case PROP_KEY_TYPE:
+      self->priv->key_type = g_value_get_enum (value);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
@@ -162,16 +211,74 @@ gst_dtls_certificate_get_property (GObject * object, guint prop_id,
       g_return_if_fail (self->priv->pem);
       g_value_set_string (value, self->priv->pem);
       break;
+    case PROP_KEY_TYPE:
+      g_value_set_enum (value, self->priv->key_type);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
   }
 }
 
+static gboolean
+generate_rsa_key (GstDtlsCertificate * self)
+{
+  GstDtlsCertificatePrivate *priv = self->priv;
+  RSA *rsa;
+
+  rsa = RSA_generate_key (2048, RSA_F4, NULL, NULL);
+
+  if (!rsa) {
+    GST_WARNING_OBJECT (self, "failed to generate RSA");
+    return FALSE;
+  }
+
+  if (!EVP_PKEY_assign_RSA (priv->private_key, rsa)) {
+    GST_WARNING_OBJECT (self, "failed to assign RSA");
+    RSA_free (rsa);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* A P-256 key is generated in well under a millisecond, where a 2048 bit RSA
+ * key takes tens to hundreds of milliseconds */
+static gboolean
+generate_ecdsa_key (GstDtlsCertificate * self)
+{
+  GstDtlsCertificatePrivate *priv = self->priv;
+  EC_KEY *ec_key;
+
+  ec_key = EC_KEY_new_by_curve_name (NID_X9_62_prime256v1);
+
+  if (!ec_key) {
+    GST_WARNING_OBJECT (self, "failed to create EC key");
+    return FALSE;
+  }
+
+  /* peers only support named curves */
+  EC_KEY_set_asn1_flag (ec_key, OPENSSL_EC_NAMED_CURVE);
+
+  if (!EC_KEY_generate_key (ec_key)) {
+    GST_WARNING_OBJECT (self, "failed to generate EC key");
+    EC_KEY_free (ec_key);
+    return FALSE;
+  }
+
+  if (!EVP_PKEY_assign_EC_KEY (priv->private_key, ec_key)) {
+    GST_WARNING_OBJECT (self, "failed to assign EC key");
+    EC_KEY_free (ec_key);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 static void
 init_generated (GstDtlsCertificate * self)
 {
   GstDtlsCertificatePrivate *priv = self->priv;
-  RSA *rsa;
+  gboolean key_generated;
   X509_NAME *name = NULL;
 
   g_return_if_fail (!priv->x509);
@@ -192,28 +299,19 @@ init_generated (GstDtlsCertificate * self)
     priv->private_key = NULL;
     return;
   }
-  rsa = RSA_generate_key (2048, RSA_F4, NULL, NULL);
 
-  if (!rsa) {
-    GST_WARNING_OBJECT (self, "failed to generate RSA");
-    EVP_PKEY_free (priv->private_key);
-    priv->private_key = NULL;
-    X509_free (priv->x509);
-    priv->x509 = NULL;
-    return;
-  }
+  if (priv->key_type == GST_DTLS_KEY_TYPE_ECDSA)
+    key_generated = generate_ecdsa_key (self);
+  else
+    key_generated = generate_rsa_key (self);
 
-  if (!EVP_PKEY_assign_RSA (priv->private_key, rsa)) {
-    GST_WARNING_OBJECT (self, "failed to assign RSA");
-    RSA_free (rsa);
-    rsa = NULL;
+  if (!key_generated) {
     EVP_PKEY_free (priv->private_key);
     priv->private_key = NULL;
     X509_free (priv->x509);
     priv->x509 = NULL;
     return;
   }
-  rsa = NULL;
 
   X509_set_version (priv->x509, 2);
   ASN1_INTEGER_set (X509_get_serialNumber (priv->x509), 0);
@@ -309,6 +407,41 @@ beach:
   return pem;
 }
 
+static GMutex generated_lock;
+static GCond generated_cond;
+static GstDtlsCertificate *generated[GST_DTLS_KEY_TYPE_ECDSA + 1];
+static gboolean generating[GST_DTLS_KEY_TYPE_ECDSA + 1];
+
+GstDtlsCertificate *
+_gst_dtls_certificate_get_generated (GstDtlsKeyType key_type)
+{
+  GstDtlsCertificate *certificate;
+
+  g_return_val_if_fail (key_type <= GST_DTLS_KEY_TYPE_ECDSA, NULL);
+
+  g_mutex_lock (&generated_lock);
+  while (generating[key_type])
+    g_cond_wait (&generated_cond, &generated_lock);
+
+  if (!generated[key_type]) {
+    generating[key_type] = TRUE;
+    g_mutex_unlock (&generated_lock);
+
+    certificate = g_object_new (GST_TYPE_DTLS_CERTIFICATE, "key-type",
+        key_type, NULL);
+
+    g_mutex_lock (&generated_lock);
+    generated[key_type] = certificate;
+    generating[key_type] = FALSE;
+    g_cond_broadcast (&generated_cond);
+  }
+
+  certificate = g_object_ref (generated[key_type]);
+  g_mutex_unlock (&generated_lock);
+
+  return certificate;
+}
+
 GstDtlsCertificateInternalCertificate
 _gst_dtls_certificate_get_internal_certificate (GstDtlsCertificate * self)
 {
@@ -37,6 +37,22 @@ G_BEGIN_DECLS
 #define GST_IS_DTLS_CERTIFICATE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_DTLS_CERTIFICATE))
 #define GST_DTLS_CERTIFICATE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_DTLS_CERTIFICATE, GstDtlsCertificateClass))
 
+/**
+ * GstDtlsKeyType:
+ * @GST_DTLS_KEY_TYPE_RSA: 2048 bit RSA key
+ * @GST_DTLS_KEY_TYPE_ECDSA: ECDSA key on the P-256 curve, much faster to
+ *   generate than RSA
+ *
+ * Type of the private key of a generated certificate
+ */
+typedef enum {
+    GST_DTLS_KEY_TYPE_RSA,
+    GST_DTLS_KEY_TYPE_ECDSA
+} GstDtlsKeyType;
+
+#define GST_TYPE_DTLS_KEY_TYPE (gst_dtls_key_type_get_type())
+GType gst_dtls_key_type_get_type(void);
+
 typedef gpointer GstDtlsCertificateInternalCertificate;
 typedef gpointer GstDtlsCertificateInternalKey;
 
@@ -48,7 +64,8 @@ typedef struct _GstDtlsCertificatePrivate GstDtlsCertificatePrivate;
  * GstDtlsCertificate:
  *
  * Handles a X509 certificate and a private key.
- * If a certificate is created without the "pem" property, a self-signed certificate is generated.
+ * If a certificate is created without the "pem" property, a self-signed certificate is generated,
+ * with a key of the type set by the "key-type" property.
  */
 struct _GstDtlsCertificate {
     GObject parent_instance;
@@ -62,6 +79,12 @@ struct _GstDtlsCertificateClass {
 
 GType gst_dtls_certificate_get_type(void) G_GNUC_CONST;
 
+/*
+ * Returns the generated certificate shared by all agents for @key_type.
+ * It is generated on first use, concurrent callers wait for it.
+ */
+GstDtlsCertificate *_gst_dtls_certificate_get_generated(GstDtlsKeyType key_type);
+
 /* internal */
 GstDtlsCertificateInternalCertificate _gst_dtls_certificate_get_internal_certificate(GstDtlsCertificate *);
 GstDtlsCertificateInternalKey _gst_dtls_certificate_get_internal_key(GstDtlsCertificate *);
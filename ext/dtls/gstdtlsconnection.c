@@ -67,6 +67,7 @@ enum
 {
   PROP_0,
   PROP_AGENT,
+  PROP_CONNECTION_ID,
   NUM_PROPERTIES
 };
 
@@ -77,14 +78,22 @@ static int connection_ex_index;
 static GstClock *system_clock;
 static void handle_timeout (gpointer data, gpointer user_data);
 
+/* records up to this size are written into buffers of the connection pool,
+ * which covers everything sent in MTU sized datagrams */
+#define POOL_BUFFER_SIZE 2048
+
 struct _GstDtlsConnectionPrivate
 {
   SSL *ssl;
   BIO *bio;
 
+  GstDtlsAgent *agent;
+  gchar *connection_id;
+
   gboolean is_client;
   gboolean is_alive;
   gboolean keys_exported;
+  gboolean handshake_failed;
 
   GMutex mutex;
   GCond condition;
@@ -93,6 +102,9 @@ struct _GstDtlsConnectionPrivate
   gint bio_buffer_offset;
 
   GClosure *send_closure;
+  /* records written while the mutex is held, sent when it is released */
+  GstBufferList *send_list;
+  GstBufferPool *pool;
 
   gboolean timeout_pending;
   GThreadPool *thread_pool;
@@ -105,8 +117,10 @@ static void gst_dtls_connection_set_property (GObject *, guint prop_id,
 static void log_state (GstDtlsConnection *, const gchar * str);
 static void export_srtp_keys (GstDtlsConnection *);
 static void openssl_poll (GstDtlsConnection *);
+static void flush_send_list (GstDtlsConnection *);
 static int openssl_verify_callback (int preverify_ok,
     X509_STORE_CTX * x509_ctx);
+static gboolean verify_peer_certificate (GstDtlsConnection *, X509 * cert);
 
 static BIO_METHOD *BIO_s_gst_dtls_connection (void);
 static int bio_method_write (BIO *, const char *data, int size);
@@ -152,6 +166,13 @@ gst_dtls_connection_class_init (GstDtlsConnectionClass * klass)
       GST_TYPE_DTLS_AGENT,
       G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_CONNECTION_ID] =
+      g_param_spec_string ("connection-id",
+      "Connection id",
+      "Id of the connection, a client resumes the last session of the agent "
+      "with the same id",
+      NULL, G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class, NUM_PROPERTIES, properties);
 
   _gst_dtls_init_openssl ();
@@ -165,16 +186,26 @@ static void
 gst_dtls_connection_init (GstDtlsConnection * self)
 {
   GstDtlsConnectionPrivate *priv = GST_DTLS_CONNECTION_GET_PRIVATE (self);
+  GstStructure *config;
+
   self->priv = priv;
 
   priv->ssl = NULL;
   priv->bio = NULL;
 
   priv->send_closure = NULL;
+  priv->send_list = NULL;
+
+  priv->pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (priv->pool);
+  gst_buffer_pool_config_set_params (config, NULL, POOL_BUFFER_SIZE, 0, 0);
+  gst_buffer_pool_set_config (priv->pool, config);
+  gst_buffer_pool_set_active (priv->pool, TRUE);
 
   priv->is_client = FALSE;
   priv->is_alive = TRUE;
   priv->keys_exported = FALSE;
+  priv->handshake_failed = FALSE;
 
   priv->bio_buffer = NULL;
   priv->bio_buffer_len = 0;
@@ -203,11 +234,28 @@ gst_dtls_connection_finalize (GObject * gobject)
   SSL_free (priv->ssl);
   priv->ssl = NULL;
 
+  if (priv->agent) {
+    g_object_unref (priv->agent);
+    priv->agent = NULL;
+  }
+
+  g_free (priv->connection_id);
+  priv->connection_id = NULL;
+
   if (priv->send_closure) {
     g_closure_unref (priv->send_closure);
     priv->send_closure = NULL;
   }
 
+  if (priv->send_list) {
+    gst_buffer_list_unref (priv->send_list);
+    priv->send_list = NULL;
+  }
+
+  gst_buffer_pool_set_active (priv->pool, FALSE);
+  gst_object_unref (priv->pool);
+  priv->pool = NULL;
+
   g_mutex_clear (&priv->mutex);
   g_cond_clear (&priv->condition);
 
@@ -232,6 +280,7 @@ gst_dtls_connection_set_property (GObject * object, guint prop_id,
       g_return_if_fail (GST_IS_DTLS_AGENT (agent));
 
       ssl_context = _gst_dtls_agent_peek_context (agent);
+      priv->agent = g_object_ref (agent);
 
       priv->ssl = SSL_new (ssl_context);
       g_return_if_fail (priv->ssl);
@@ -249,6 +298,10 @@ gst_dtls_connection_set_property (GObject * object, guint prop_id,
 
       log_state (self, "connection created");
       break;
+    case PROP_CONNECTION_ID:
+      g_free (priv->connection_id);
+      priv->connection_id = g_value_dup_string (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
   }
@@ -274,9 +327,20 @@ gst_dtls_connection_start (GstDtlsConnection * self, gboolean is_client)
   priv->bio_buffer_len = 0;
   priv->bio_buffer_offset = 0;
   priv->keys_exported = FALSE;
+  priv->handshake_failed = FALSE;
 
   priv->is_client = is_client;
   if (priv->is_client) {
+    if (priv->connection_id) {
+      SSL_SESSION *session =
+          _gst_dtls_agent_get_session (priv->agent, priv->connection_id);
+
+      if (session) {
+        GST_DEBUG_OBJECT (self, "trying to resume the previous session");
+        SSL_set_session (priv->ssl, session);
+        SSL_SESSION_free (session);
+      }
+    }
     SSL_set_connect_state (priv->ssl);
   } else {
     SSL_set_accept_state (priv->ssl);
@@ -287,6 +351,8 @@ gst_dtls_connection_start (GstDtlsConnection * self, gboolean is_client)
 
   log_state (self, "first poll done");
 
+  flush_send_list (self);
+
   GST_TRACE_OBJECT (self, "unlocking @ start");
   g_mutex_unlock (&priv->mutex);
 }
@@ -315,6 +381,7 @@ handle_timeout (gpointer data, gpointer user_data)
       openssl_poll (self);
       log_state (self, "handling timeout after poll");
     }
+    flush_send_list (self);
   }
   g_mutex_unlock (&priv->mutex);
 }
@@ -468,22 +535,12 @@ gst_dtls_connection_set_send_callback (GstDtlsConnection * self,
   g_mutex_unlock (&self->priv->mutex);
 }
 
-gint
-gst_dtls_connection_process (GstDtlsConnection * self, gpointer data, gint len)
+static gint
+process_locked (GstDtlsConnection * self, gpointer data, gint len)
 {
-  GstDtlsConnectionPrivate *priv;
+  GstDtlsConnectionPrivate *priv = self->priv;
   gint result;
 
-  g_return_val_if_fail (GST_IS_DTLS_CONNECTION (self), 0);
-  g_return_val_if_fail (self->priv->ssl, 0);
-  g_return_val_if_fail (self->priv->bio, 0);
-
-  priv = self->priv;
-
-  GST_TRACE_OBJECT (self, "locking @ process");
-  g_mutex_lock (&priv->mutex);
-  GST_TRACE_OBJECT (self, "locked @ process");
-
   g_warn_if_fail (!priv->bio_buffer);
 
   priv->bio_buffer = data;
@@ -492,6 +549,11 @@ gst_dtls_connection_process (GstDtlsConnection * self, gpointer data, gint len)
 
   log_state (self, "process start");
 
+  if (priv->handshake_failed) {
+    GST_DEBUG_OBJECT (self, "handshake failed, dropping %d B", len);
+    return -1;
+  }
+
   if (SSL_want_write (priv->ssl)) {
     openssl_poll (self);
     log_state (self, "process want write, after poll");
@@ -501,18 +563,97 @@ gst_dtls_connection_process (GstDtlsConnection * self, gpointer data, gint len)
 
   log_state (self, "process after read");
 
-  openssl_poll (self);
+  /* once the keys are out there is nothing left to poll for, SSL_read()
+   * takes care of any later handshake messages */
+  if (!priv->keys_exported || !SSL_is_init_finished (priv->ssl)) {
+    openssl_poll (self);
+    log_state (self, "process after poll");
+  }
 
-  log_state (self, "process after poll");
+  /* the record may have completed a handshake that was rejected afterwards,
+   * nothing read from that peer may be passed on */
+  if (priv->handshake_failed)
+    result = -1;
 
   GST_DEBUG_OBJECT (self, "read result: %d", result);
 
+  return result;
+}
+
+gint
+gst_dtls_connection_process (GstDtlsConnection * self, gpointer data, gint len)
+{
+  GstDtlsConnectionPrivate *priv;
+  gint result;
+
+  g_return_val_if_fail (GST_IS_DTLS_CONNECTION (self), 0);
+  g_return_val_if_fail (self->priv->ssl, 0);
+  g_return_val_if_fail (self->priv->bio, 0);
+
+  priv = self->priv;
+
+  GST_TRACE_OBJECT (self, "locking @ process");
+  g_mutex_lock (&priv->mutex);
+  GST_TRACE_OBJECT (self, "locked @ process");
+
+  result = process_locked (self, data, len);
+  flush_send_list (self);
+
   GST_TRACE_OBJECT (self, "unlocking @ process");
   g_mutex_unlock (&priv->mutex);
 
   return result;
 }
 
+static gboolean
+process_list_item (GstBuffer ** buffer, guint idx, gpointer user_data)
+{
+  GstDtlsConnection *self = GST_DTLS_CONNECTION (user_data);
+  GstMapInfo map_info;
+  gint size = 0;
+
+  *buffer = gst_buffer_make_writable (*buffer);
+
+  if (gst_buffer_map (*buffer, &map_info, GST_MAP_READWRITE)) {
+    if (map_info.size)
+      size = process_locked (self, map_info.data, map_info.size);
+    gst_buffer_unmap (*buffer, &map_info);
+  }
+
+  if (size > 0)
+    gst_buffer_set_size (*buffer, size);
+  else
+    gst_buffer_replace (buffer, NULL);
+
+  return TRUE;
+}
+
+guint
+gst_dtls_connection_process_list (GstDtlsConnection * self,
+    GstBufferList * list)
+{
+  GstDtlsConnectionPrivate *priv;
+
+  g_return_val_if_fail (GST_IS_DTLS_CONNECTION (self), 0);
+  g_return_val_if_fail (self->priv->ssl, 0);
+  g_return_val_if_fail (self->priv->bio, 0);
+  g_return_val_if_fail (gst_buffer_list_is_writable (list), 0);
+
+  priv = self->priv;
+
+  GST_TRACE_OBJECT (self, "locking @ process list");
+  g_mutex_lock (&priv->mutex);
+  GST_TRACE_OBJECT (self, "locked @ process list");
+
+  gst_buffer_list_foreach (list, process_list_item, self);
+  flush_send_list (self);
+
+  GST_TRACE_OBJECT (self, "unlocking @ process list");
+  g_mutex_unlock (&priv->mutex);
+
+  return gst_buffer_list_length (list);
+}
+
 gint
 gst_dtls_connection_send (GstDtlsConnection * self, gpointer data, gint len)
 {
@@ -527,10 +668,14 @@ gst_dtls_connection_send (GstDtlsConnection * self, gpointer data, gint len)
   g_mutex_lock (&self->priv->mutex);
   GST_TRACE_OBJECT (self, "locked @ send");
 
-  if (SSL_is_init_finished (self->priv->ssl)) {
+  if (self->priv->handshake_failed) {
+    GST_DEBUG_OBJECT (self, "handshake failed, not sending %d B", len);
+    ret = 0;
+  } else if (SSL_is_init_finished (self->priv->ssl)) {
     ret = SSL_write (self->priv->ssl, data, len);
     GST_DEBUG_OBJECT (self, "data sent: input was %d B, output is %d B", len,
         ret);
+    flush_send_list (self);
   } else {
     GST_WARNING_OBJECT (self,
         "tried to send data before handshake was complete");
@@ -543,6 +688,66 @@ gst_dtls_connection_send (GstDtlsConnection * self, gpointer data, gint len)
   return ret;
 }
 
+guint
+gst_dtls_connection_send_list (GstDtlsConnection * self, GstBufferList * list)
+{
+  GstDtlsConnectionPrivate *priv;
+  guint i, len, n_sent = 0;
+
+  g_return_val_if_fail (GST_IS_DTLS_CONNECTION (self), 0);
+  g_return_val_if_fail (self->priv->ssl, 0);
+  g_return_val_if_fail (self->priv->bio, 0);
+
+  priv = self->priv;
+
+  GST_TRACE_OBJECT (self, "locking @ send list");
+  g_mutex_lock (&priv->mutex);
+  GST_TRACE_OBJECT (self, "locked @ send list");
+
+  if (priv->handshake_failed) {
+    GST_DEBUG_OBJECT (self, "handshake failed, not sending");
+    g_mutex_unlock (&priv->mutex);
+    return 0;
+  }
+
+  if (!SSL_is_init_finished (priv->ssl)) {
+    GST_WARNING_OBJECT (self,
+        "tried to send data before handshake was complete");
+    g_mutex_unlock (&priv->mutex);
+    return 0;
+  }
+
+  len = gst_buffer_list_length (list);
+  for (i = 0; i < len; i++) {
+    GstBuffer *buffer = gst_buffer_list_get (list, i);
+    GstMapInfo map_info;
+    gint ret;
+
+    if (!gst_buffer_map (buffer, &map_info, GST_MAP_READ))
+      continue;
+
+    if (map_info.size) {
+      ret = SSL_write (priv->ssl, map_info.data, map_info.size);
+      if (ret == map_info.size) {
+        n_sent++;
+      } else {
+        GST_WARNING_OBJECT (self, "error sending data: %d B were written, "
+            "expected value was %" G_GSIZE_FORMAT " B", ret, map_info.size);
+      }
+    }
+
+    gst_buffer_unmap (buffer, &map_info);
+  }
+
+  GST_DEBUG_OBJECT (self, "sent %u of %u buffers", n_sent, len);
+  flush_send_list (self);
+
+  GST_TRACE_OBJECT (self, "unlocking @ send list");
+  g_mutex_unlock (&priv->mutex);
+
+  return n_sent;
+}
+
 /*
      ######   #######  ##    ##
     ##    ## ##     ## ###   ##
@@ -659,6 +864,25 @@ beach:
   self->priv->keys_exported = TRUE;
 }
 
+/* called with the mutex held when the peer is rejected after OpenSSL
+ * completed the handshake, the connection is then as dead as after a failed
+ * certificate verification during the handshake */
+static void
+fail_handshake (GstDtlsConnection * self)
+{
+  GstDtlsConnectionPrivate *priv = self->priv;
+
+  GST_WARNING_OBJECT (self, "handshake failed");
+
+  priv->handshake_failed = TRUE;
+  SSL_shutdown (priv->ssl);
+
+  if (priv->is_alive) {
+    priv->is_alive = FALSE;
+    g_cond_signal (&priv->condition);
+  }
+}
+
 static void
 openssl_poll (GstDtlsConnection * self)
 {
@@ -666,6 +890,9 @@ openssl_poll (GstDtlsConnection * self)
   char buf[512];
   int error;
 
+  if (self->priv->handshake_failed)
+    return;
+
   log_state (self, "poll: before handshake");
 
   ret = SSL_do_handshake (self->priv->ssl);
@@ -674,6 +901,32 @@ openssl_poll (GstDtlsConnection * self)
 
   if (ret == 1) {
     if (!self->priv->keys_exported) {
+      GstDtlsConnectionPrivate *priv = self->priv;
+
+      if (SSL_session_reused (priv->ssl)) {
+        X509 *cert = SSL_get_peer_certificate (priv->ssl);
+        gboolean accepted;
+
+        /* no certificate was exchanged, the peer certificate of the
+         * resumed session still has to be accepted */
+        GST_INFO_OBJECT (self, "session resumed");
+        accepted = cert && verify_peer_certificate (self, cert);
+        X509_free (cert);
+
+        if (!accepted) {
+          GST_WARNING_OBJECT (self, "peer certificate of the resumed session "
+              "was not accepted");
+          if (priv->is_client && priv->connection_id)
+            _gst_dtls_agent_store_session (priv->agent, priv->connection_id,
+                NULL);
+          fail_handshake (self);
+          return;
+        }
+      } else if (priv->is_client && priv->connection_id) {
+        _gst_dtls_agent_store_session (priv->agent, priv->connection_id,
+            SSL_get1_session (priv->ssl));
+      }
+
       GST_INFO_OBJECT (self,
           "handshake just completed successfully, exporting keys");
       export_srtp_keys (self);
@@ -716,14 +969,45 @@ openssl_poll (GstDtlsConnection * self)
   }
 }
 
+/* passes the records written since the last call to the send callback,
+ * called with the mutex held so that records of different threads keep
+ * their order */
+static void
+flush_send_list (GstDtlsConnection * self)
+{
+  GstDtlsConnectionPrivate *priv = self->priv;
+  GValue values[2] = { G_VALUE_INIT };
+  GstBufferList *list;
+
+  if (!priv->send_list)
+    return;
+
+  list = priv->send_list;
+  priv->send_list = NULL;
+
+  if (!priv->send_closure) {
+    gst_buffer_list_unref (list);
+    return;
+  }
+
+  GST_LOG_OBJECT (self, "sending %u records", gst_buffer_list_length (list));
+
+  g_value_init (&values[0], GST_TYPE_DTLS_CONNECTION);
+  g_value_set_object (&values[0], self);
+
+  g_value_init (&values[1], G_TYPE_POINTER);
+  g_value_set_pointer (&values[1], list);
+
+  g_closure_invoke (priv->send_closure, NULL, 2, values, NULL);
+
+  g_value_unset (&values[0]);
+}
+
 static int
 openssl_verify_callback (int preverify_ok, X509_STORE_CTX * x509_ctx)
 {
   GstDtlsConnection *self;
   SSL *ssl;
-  BIO *bio;
-  gchar *pem = NULL;
-  gboolean accepted = FALSE;
 
   ssl =
       X509_STORE_CTX_get_ex_data (x509_ctx,
@@ -731,7 +1015,17 @@ openssl_verify_callback (int preverify_ok, X509_STORE_CTX * x509_ctx)
   self = SSL_get_ex_data (ssl, connection_ex_index);
   g_return_val_if_fail (GST_IS_DTLS_CONNECTION (self), FALSE);
 
-  pem = _gst_dtls_x509_to_pem (x509_ctx->cert);
+  return verify_peer_certificate (self, x509_ctx->cert);
+}
+
+static gboolean
+verify_peer_certificate (GstDtlsConnection * self, X509 * cert)
+{
+  BIO *bio;
+  gchar *pem = NULL;
+  gboolean accepted = FALSE;
+
+  pem = _gst_dtls_x509_to_pem (cert);
 
   if (!pem) {
     GST_WARNING_OBJECT (self,
@@ -743,7 +1037,7 @@ openssl_verify_callback (int preverify_ok, X509_STORE_CTX * x509_ctx)
       gint len;
 
       len =
-          X509_NAME_print_ex (bio, X509_get_subject_name (x509_ctx->cert), 1,
+          X509_NAME_print_ex (bio, X509_get_subject_name (cert), 1,
           XN_FLAG_MULTILINE);
       BIO_read (bio, buffer, len);
       buffer[len] = '\0';
@@ -794,24 +1088,27 @@ static int
 bio_method_write (BIO * bio, const char *data, int size)
 {
   GstDtlsConnection *self = GST_DTLS_CONNECTION (bio->ptr);
+  GstDtlsConnectionPrivate *priv = self->priv;
+  GstBuffer *buffer = NULL;
 
   GST_LOG_OBJECT (self, "BIO: writing %d", size);
 
-  if (self->priv->send_closure) {
-    GValue values[3] = { G_VALUE_INIT };
-
-    g_value_init (&values[0], GST_TYPE_DTLS_CONNECTION);
-    g_value_set_object (&values[0], self);
+  if (!priv->send_closure)
+    return size;
 
-    g_value_init (&values[1], G_TYPE_POINTER);
-    g_value_set_pointer (&values[1], (gpointer) data);
-
-    g_value_init (&values[2], G_TYPE_INT);
-    g_value_set_int (&values[2], size);
-
-    g_closure_invoke (self->priv->send_closure, NULL, 3, values, NULL);
+  if (size <= POOL_BUFFER_SIZE &&
+      gst_buffer_pool_acquire_buffer (priv->pool, &buffer,
+          NULL) == GST_FLOW_OK) {
+    gst_buffer_fill (buffer, 0, data, size);
+    gst_buffer_set_size (buffer, size);
+  } else {
+    buffer = gst_buffer_new_wrapped (g_memdup (data, size), size);
   }
 
+  if (!priv->send_list)
+    priv->send_list = gst_buffer_list_new ();
+  gst_buffer_list_add (priv->send_list, buffer);
+
   return size;
 }
 
@@ -26,7 +26,7 @@
 #ifndef gstdtlsconnection_h
 #define gstdtlsconnection_h
 
-#include <glib-object.h>
+#include <gst/gst.h>
 
 G_BEGIN_DECLS
 
@@ -100,9 +100,12 @@ void gst_dtls_connection_close(GstDtlsConnection *);
 
 /*
  * Sets the closure that will be called whenever data needs to be sent.
+ * The records written by one call into the connection are collected and
+ * passed to the closure together, once per call.
  *
- * The closure will get called with the following arguments:
- * void cb(GstDtlsConnection *, gpointer data, gint length, gpointer user_data)
+ * The closure will get called with the following arguments, and takes
+ * ownership of the list:
+ * void cb(GstDtlsConnection *, GstBufferList * list, gpointer user_data)
  */
 void gst_dtls_connection_set_send_callback(GstDtlsConnection *, GClosure *);
 
@@ -112,12 +115,26 @@ void gst_dtls_connection_set_send_callback(GstDtlsConnection *, GClosure *);
  */
 gint gst_dtls_connection_process(GstDtlsConnection *, gpointer ptr, gint len);
 
+/*
+ * Processes all buffers of a writable list under a single lock, each one is
+ * decoded in-place and the buffers without plaintext data are removed.
+ * Returns the number of buffers left in the list.
+ */
+guint gst_dtls_connection_process_list(GstDtlsConnection *, GstBufferList *);
+
 /*
  * If the DTLS handshake is completed this function will encode the given data.
  * Returns the length of the data sent, or 0 if the DTLS handshake is not completed.
  */
 gint gst_dtls_connection_send(GstDtlsConnection *, gpointer ptr, gint len);
 
+/*
+ * Encodes all buffers of the list under a single lock, the records are passed
+ * to the send callback as one list.
+ * Returns the number of buffers sent, or 0 if the DTLS handshake is not completed.
+ */
+guint gst_dtls_connection_send_list(GstDtlsConnection *, GstBufferList *);
+
 G_END_DECLS
 
 #endif /* gstdtlsconnection_h */
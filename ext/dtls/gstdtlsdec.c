@@ -63,6 +63,7 @@ enum
   PROP_CONNECTION_ID,
   PROP_PEM,
   PROP_PEER_PEM,
+  PROP_KEY_TYPE,
 
   PROP_DECODER_KEY,
   PROP_SRTP_CIPHER,
@@ -75,6 +76,7 @@ static GParamSpec *properties[NUM_PROPERTIES];
 #define DEFAULT_CONNECTION_ID NULL
 #define DEFAULT_PEM NULL
 #define DEFAULT_PEER_PEM NULL
+#define DEFAULT_KEY_TYPE GST_DTLS_KEY_TYPE_RSA
 
 #define DEFAULT_DECODER_KEY NULL
 #define DEFAULT_SRTP_CIPHER 0
@@ -102,9 +104,15 @@ static GstFlowReturn sink_chain (GstPad *, GstObject * parent, GstBuffer *);
 static GstFlowReturn sink_chain_list (GstPad *, GstObject * parent,
     GstBufferList *);
 
-static GstDtlsAgent *get_agent_by_pem (const gchar * pem);
+static GstDtlsAgent *get_agent_by_pem (const gchar * pem,
+    GstDtlsKeyType key_type);
+static gboolean is_generated_cert_agent (GstDtlsAgent *);
+static void ensure_agent (GstDtlsDec *);
 static void agent_weak_ref_notify (gchar * pem, GstDtlsAgent *);
 static void create_connection (GstDtlsDec *, gchar * id);
+static void ensure_connection (GstDtlsDec *);
+static void add_pending_connection (GstDtlsDec *);
+static void remove_pending_connection (const gchar * id);
 static void connection_weak_ref_notify (gchar * id, GstDtlsConnection *);
 
 static void
@@ -140,7 +148,7 @@ gst_dtls_dec_class_init (GstDtlsDecClass * klass)
   properties[PROP_PEM] =
       g_param_spec_string ("pem",
       "PEM string",
-      "A string containing a X509 certificate and RSA private key in PEM format",
+      "A string containing a X509 certificate and private key in PEM format",
       DEFAULT_PEM, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
   properties[PROP_PEER_PEM] =
@@ -149,6 +157,14 @@ gst_dtls_dec_class_init (GstDtlsDecClass * klass)
       "The X509 certificate received in the DTLS handshake, in PEM format",
       DEFAULT_PEER_PEM, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_KEY_TYPE] =
+      g_param_spec_enum ("key-type",
+      "Key type",
+      "Type of the private key of the generated certificate, used when no "
+      "pem is set. ECDSA keys are much faster to generate than RSA keys",
+      GST_TYPE_DTLS_KEY_TYPE, DEFAULT_KEY_TYPE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   properties[PROP_DECODER_KEY] =
       g_param_spec_boxed ("decoder-key",
       "Decoder key",
@@ -187,9 +203,13 @@ gst_dtls_dec_class_init (GstDtlsDecClass * klass)
 static void
 gst_dtls_dec_init (GstDtlsDec * self)
 {
-  self->agent = get_agent_by_pem (NULL);
+  /* the agent and the connection are only created when they are needed, so
+   * that a certificate is only generated once the key type is final */
+  self->agent = NULL;
+  self->key_type = DEFAULT_KEY_TYPE;
   self->connection_id = NULL;
   self->connection = NULL;
+  g_mutex_init (&self->connection_mutex);
   self->peer_pem = NULL;
 
   self->decoder_key = NULL;
@@ -226,6 +246,7 @@ gst_dtls_dec_finalize (GObject * object)
   self->peer_pem = NULL;
 
   g_mutex_clear (&self->src_mutex);
+  g_mutex_clear (&self->connection_mutex);
 
   GST_LOG_OBJECT (self, "finalized");
 
@@ -237,6 +258,9 @@ gst_dtls_dec_dispose (GObject * object)
 {
   GstDtlsDec *self = GST_DTLS_DEC (object);
 
+  if (self->connection_id && !self->connection)
+    remove_pending_connection (self->connection_id);
+
   if (self->agent) {
     g_object_unref (self->agent);
     self->agent = NULL;
@@ -258,19 +282,42 @@ gst_dtls_dec_set_property (GObject * object, guint prop_id,
 
   switch (prop_id) {
     case PROP_CONNECTION_ID:
+      g_mutex_lock (&self->connection_mutex);
+      if (self->connection_id && !self->connection)
+        remove_pending_connection (self->connection_id);
       g_free (self->connection_id);
       self->connection_id = g_value_dup_string (value);
-      g_return_if_fail (self->agent);
-      create_connection (self, self->connection_id);
+      /* without a pem the connection waits for the key type to be final */
+      if (self->agent)
+        create_connection (self, self->connection_id);
+      else
+        add_pending_connection (self);
+      g_mutex_unlock (&self->connection_mutex);
       break;
     case PROP_PEM:
+      g_mutex_lock (&self->connection_mutex);
       if (self->agent) {
         g_object_unref (self->agent);
       }
-      self->agent = get_agent_by_pem (g_value_get_string (value));
+      self->agent =
+          get_agent_by_pem (g_value_get_string (value), self->key_type);
       if (self->connection_id) {
         create_connection (self, self->connection_id);
       }
+      g_mutex_unlock (&self->connection_mutex);
+      break;
+    case PROP_KEY_TYPE:
+      g_mutex_lock (&self->connection_mutex);
+      self->key_type = g_value_get_enum (value);
+      if (self->agent && is_generated_cert_agent (self->agent)) {
+        g_object_unref (self->agent);
+        self->agent = NULL;
+        if (self->connection) {
+          ensure_agent (self);
+          create_connection (self, self->connection_id);
+        }
+      }
+      g_mutex_unlock (&self->connection_mutex);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
@@ -288,12 +335,18 @@ gst_dtls_dec_get_property (GObject * object, guint prop_id, GValue * value,
       g_value_set_string (value, self->connection_id);
       break;
     case PROP_PEM:
+      g_mutex_lock (&self->connection_mutex);
+      ensure_agent (self);
       g_value_take_string (value,
           gst_dtls_agent_get_certificate_pem (self->agent));
+      g_mutex_unlock (&self->connection_mutex);
       break;
     case PROP_PEER_PEM:
       g_value_set_string (value, self->peer_pem);
       break;
+    case PROP_KEY_TYPE:
+      g_value_set_enum (value, self->key_type);
+      break;
     case PROP_DECODER_KEY:
       g_value_set_boxed (value, self->decoder_key);
       break;
@@ -316,6 +369,7 @@ gst_dtls_dec_change_state (GstElement * element, GstStateChange transition)
 
   switch (transition) {
     case GST_STATE_CHANGE_NULL_TO_READY:
+      ensure_connection (self);
       if (self->connection) {
         g_signal_connect_object (self->connection,
             "on-decoder-key", G_CALLBACK (on_key_received), self, 0);
@@ -505,20 +559,6 @@ process_buffer (GstDtlsDec * self, GstBuffer * buffer)
   return size;
 }
 
-static gboolean
-process_buffer_from_list (GstBuffer ** buffer, guint idx, gpointer user_data)
-{
-  GstDtlsDec *self = GST_DTLS_DEC (user_data);
-  gint size;
-
-  *buffer = gst_buffer_make_writable (*buffer);
-  size = process_buffer (self, *buffer);
-  if (size <= 0)
-    gst_buffer_replace (buffer, NULL);
-
-  return TRUE;
-}
-
 static GstFlowReturn
 sink_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
 {
@@ -527,9 +567,8 @@ sink_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
   GstPad *other_pad;
 
   list = gst_buffer_list_make_writable (list);
-  gst_buffer_list_foreach (list, process_buffer_from_list, self);
 
-  if (gst_buffer_list_length (list) == 0) {
+  if (gst_dtls_connection_process_list (self->connection, list) == 0) {
     GST_DEBUG_OBJECT (self, "Not produced any buffers");
     gst_buffer_list_unref (list);
 
@@ -602,29 +641,33 @@ sink_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 static GHashTable *agent_table = NULL;
 G_LOCK_DEFINE_STATIC (agent_table);
 
-static GstDtlsAgent *generated_cert_agent = NULL;
+/* one agent per key type, sharing the generated certificate */
+static GstDtlsAgent *generated_cert_agents[GST_DTLS_KEY_TYPE_ECDSA + 1];
 
 static GstDtlsAgent *
-get_agent_by_pem (const gchar * pem)
+get_agent_by_pem (const gchar * pem, GstDtlsKeyType key_type)
 {
   GstDtlsAgent *agent;
 
   if (!pem) {
-    if (g_once_init_enter (&generated_cert_agent)) {
+    if (g_once_init_enter (&generated_cert_agents[key_type])) {
       GstDtlsAgent *new_agent;
+      GstDtlsCertificate *certificate;
 
+      certificate = _gst_dtls_certificate_get_generated (key_type);
       new_agent = g_object_new (GST_TYPE_DTLS_AGENT, "certificate",
-          g_object_new (GST_TYPE_DTLS_CERTIFICATE, NULL), NULL);
+          certificate, NULL);
+      g_object_unref (certificate);
 
-      GST_DEBUG_OBJECT (generated_cert_agent,
+      GST_DEBUG_OBJECT (new_agent,
           "no agent with generated cert found, creating new");
-      g_once_init_leave (&generated_cert_agent, new_agent);
+      g_once_init_leave (&generated_cert_agents[key_type], new_agent);
     } else {
-      GST_DEBUG_OBJECT (generated_cert_agent,
+      GST_DEBUG_OBJECT (generated_cert_agents[key_type],
           "using agent with generated cert");
     }
 
-    agent = generated_cert_agent;
+    agent = generated_cert_agents[key_type];
     g_object_ref (agent);
   } else {
     G_LOCK (agent_table);
@@ -637,9 +680,12 @@ get_agent_by_pem (const gchar * pem)
     agent = GST_DTLS_AGENT (g_hash_table_lookup (agent_table, pem));
 
     if (!agent) {
-      agent = g_object_new (GST_TYPE_DTLS_AGENT,
-          "certificate", g_object_new (GST_TYPE_DTLS_CERTIFICATE, "pem", pem,
-              NULL), NULL);
+      GstDtlsCertificate *certificate;
+
+      certificate = g_object_new (GST_TYPE_DTLS_CERTIFICATE, "pem", pem, NULL);
+      agent = g_object_new (GST_TYPE_DTLS_AGENT, "certificate", certificate,
+          NULL);
+      g_object_unref (certificate);
 
       g_object_weak_ref (G_OBJECT (agent), (GWeakNotify) agent_weak_ref_notify,
           (gpointer) g_strdup (pem));
@@ -659,6 +705,26 @@ get_agent_by_pem (const gchar * pem)
   return agent;
 }
 
+static gboolean
+is_generated_cert_agent (GstDtlsAgent * agent)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (generated_cert_agents); i++) {
+    if (agent == g_atomic_pointer_get (&generated_cert_agents[i]))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static void
+ensure_agent (GstDtlsDec * self)
+{
+  if (!self->agent)
+    self->agent = get_agent_by_pem (NULL, self->key_type);
+}
+
 static void
 agent_weak_ref_notify (gchar * pem, GstDtlsAgent * agent)
 {
@@ -671,20 +737,74 @@ agent_weak_ref_notify (gchar * pem, GstDtlsAgent * agent)
 }
 
 static GHashTable *connection_table = NULL;
+/* decoders that have a connection id but no connection yet */
+static GHashTable *pending_table = NULL;
 G_LOCK_DEFINE_STATIC (connection_table);
 
+static void
+free_weak_ref (GWeakRef * ref)
+{
+  g_weak_ref_clear (ref);
+  g_free (ref);
+}
+
+static void
+add_pending_connection (GstDtlsDec * self)
+{
+  GWeakRef *ref;
+
+  ref = g_new (GWeakRef, 1);
+  g_weak_ref_init (ref, self);
+
+  G_LOCK (connection_table);
+  if (!pending_table) {
+    pending_table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) free_weak_ref);
+  }
+  g_hash_table_insert (pending_table, g_strdup (self->connection_id), ref);
+  G_UNLOCK (connection_table);
+}
+
+static void
+remove_pending_connection (const gchar * id)
+{
+  G_LOCK (connection_table);
+  if (pending_table)
+    g_hash_table_remove (pending_table, id);
+  G_UNLOCK (connection_table);
+}
+
 GstDtlsConnection *
 gst_dtls_dec_fetch_connection (gchar * id)
 {
   GstDtlsConnection *connection;
+  GstDtlsDec *pending = NULL;
   g_return_val_if_fail (id, NULL);
 
-  GST_DEBUG ("fetching '%s' from connection table, size is %d",
-      id, g_hash_table_size (connection_table));
+  GST_DEBUG ("fetching '%s' from connection table", id);
 
   G_LOCK (connection_table);
 
-  connection = g_hash_table_lookup (connection_table, id);
+  connection = connection_table ?
+      g_hash_table_lookup (connection_table, id) : NULL;
+
+  if (!connection && pending_table) {
+    GWeakRef *ref = g_hash_table_lookup (pending_table, id);
+
+    if (ref)
+      pending = g_weak_ref_get (ref);
+  }
+
+  if (pending) {
+    /* the encoder got here first, the decoder creates its connection now */
+    G_UNLOCK (connection_table);
+    ensure_connection (pending);
+    g_object_unref (pending);
+    G_LOCK (connection_table);
+
+    connection = connection_table ?
+        g_hash_table_lookup (connection_table, id) : NULL;
+  }
 
   if (connection) {
     g_object_ref (connection);
@@ -723,16 +843,31 @@ create_connection (GstDtlsDec * self, gchar * id)
   }
 
   self->connection =
-      g_object_new (GST_TYPE_DTLS_CONNECTION, "agent", self->agent, NULL);
+      g_object_new (GST_TYPE_DTLS_CONNECTION, "agent", self->agent,
+      "connection-id", id, NULL);
 
   g_object_weak_ref (G_OBJECT (self->connection),
       (GWeakNotify) connection_weak_ref_notify, g_strdup (id));
 
   g_hash_table_insert (connection_table, g_strdup (id), self->connection);
 
+  if (pending_table)
+    g_hash_table_remove (pending_table, id);
+
   G_UNLOCK (connection_table);
 }
 
+static void
+ensure_connection (GstDtlsDec * self)
+{
+  g_mutex_lock (&self->connection_mutex);
+  if (!self->connection && self->connection_id) {
+    ensure_agent (self);
+    create_connection (self, self->connection_id);
+  }
+  g_mutex_unlock (&self->connection_mutex);
+}
+
 static void
 connection_weak_ref_notify (gchar * id, GstDtlsConnection * connection)
 {
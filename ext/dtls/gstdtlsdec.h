@@ -27,6 +27,7 @@
 #define gstdtlsdec_h
 
 #include "gstdtlsagent.h"
+#include "gstdtlscertificate.h"
 #include "gstdtlsconnection.h"
 
 #include <gst/gst.h>
@@ -55,6 +56,7 @@ struct _GstDtlsDec {
     GMutex src_mutex;
 
     GstDtlsAgent *agent;
+    GstDtlsKeyType key_type;
     GstDtlsConnection *connection;
     GMutex connection_mutex;
     gchar *connection_id;
@@ -96,10 +96,11 @@ static gboolean src_activate_mode (GstPad *, GstObject *, GstPadMode,
 static void src_task_loop (GstPad *);
 
 static GstFlowReturn sink_chain (GstPad *, GstObject *, GstBuffer *);
+static GstFlowReturn sink_chain_list (GstPad *, GstObject *, GstBufferList *);
 
 static void on_key_received (GstDtlsConnection *, gpointer key, guint cipher,
     guint auth, GstDtlsEnc *);
-static void on_send_data (GstDtlsConnection *, gconstpointer data, gint length,
+static void on_send_data (GstDtlsConnection *, GstBufferList * list,
     GstDtlsEnc *);
 
 static void
@@ -357,6 +358,7 @@ gst_dtls_enc_request_new_pad (GstElement * element,
   }
 
   gst_pad_set_chain_function (sink, GST_DEBUG_FUNCPTR (sink_chain));
+  gst_pad_set_chain_list_function (sink, GST_DEBUG_FUNCPTR (sink_chain_list));
 
   ret = gst_pad_set_active (sink, TRUE);
   g_warn_if_fail (ret);
@@ -408,7 +410,8 @@ src_task_loop (GstPad * pad)
 {
   GstDtlsEnc *self = GST_DTLS_ENC (GST_PAD_PARENT (pad));
   GstFlowReturn ret;
-  GstBuffer *buffer;
+  GstBuffer *buffer = NULL;
+  GstBufferList *list = NULL;
   gboolean check_connection_timeout = FALSE;
 
   GST_TRACE_OBJECT (self, "src loop: acquiring lock");
@@ -436,7 +439,14 @@ src_task_loop (GstPad * pad)
   }
   GST_TRACE_OBJECT (self, "src loop: queue has element");
 
-  buffer = g_queue_pop_head (&self->queue);
+  /* everything queued meanwhile is pushed at once */
+  if (self->queue.length == 1) {
+    buffer = g_queue_pop_head (&self->queue);
+  } else {
+    list = gst_buffer_list_new_sized (self->queue.length);
+    while (!g_queue_is_empty (&self->queue))
+      gst_buffer_list_add (list, g_queue_pop_head (&self->queue));
+  }
   g_mutex_unlock (&self->queue_lock);
 
   if (self->send_initial_events) {
@@ -458,7 +468,10 @@ src_task_loop (GstPad * pad)
 
   GST_TRACE_OBJECT (self, "src loop: releasing lock");
 
-  ret = gst_pad_push (self->src, buffer);
+  if (list)
+    ret = gst_pad_push_list (self->src, list);
+  else
+    ret = gst_pad_push (self->src, buffer);
   if (check_connection_timeout)
     gst_dtls_connection_check_timeout (self->connection);
 
@@ -495,6 +508,24 @@ sink_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
   return GST_FLOW_OK;
 }
 
+static GstFlowReturn
+sink_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  GstDtlsEnc *self = GST_DTLS_ENC (parent);
+  guint len, ret;
+
+  len = gst_buffer_list_length (list);
+  ret = gst_dtls_connection_send_list (self->connection, list);
+  if (ret != len) {
+    GST_WARNING_OBJECT (self, "error sending data: %u of %u buffers were sent",
+        ret, len);
+  }
+
+  gst_buffer_list_unref (list);
+
+  return GST_FLOW_OK;
+}
+
 static void
 on_key_received (GstDtlsConnection * connection, gpointer key, guint cipher,
     guint auth, GstDtlsEnc * self)
@@ -526,25 +557,29 @@ on_key_received (GstDtlsConnection * connection, gpointer key, guint cipher,
 }
 
 static void
-on_send_data (GstDtlsConnection * connection, gconstpointer data, gint length,
+on_send_data (GstDtlsConnection * connection, GstBufferList * list,
     GstDtlsEnc * self)
 {
-  GstBuffer *buffer;
+  guint i, len;
 
-  GST_DEBUG_OBJECT (self, "sending data from %s with length %d",
-      self->connection_id, length);
+  len = gst_buffer_list_length (list);
 
-  buffer = gst_buffer_new_wrapped (g_memdup (data, length), length);
+  GST_DEBUG_OBJECT (self, "sending %u buffers from %s", len,
+      self->connection_id);
 
   GST_TRACE_OBJECT (self, "send data: acquiring lock");
   g_mutex_lock (&self->queue_lock);
   GST_TRACE_OBJECT (self, "send data: acquired lock");
 
-  g_queue_push_tail (&self->queue, buffer);
+  for (i = 0; i < len; i++)
+    g_queue_push_tail (&self->queue,
+        gst_buffer_ref (gst_buffer_list_get (list, i)));
 
   GST_TRACE_OBJECT (self, "send data: signaling add");
   g_cond_signal (&self->queue_cond_add);
 
   GST_TRACE_OBJECT (self, "send data: releasing lock");
   g_mutex_unlock (&self->queue_lock);
+
+  gst_buffer_list_unref (list);
 }
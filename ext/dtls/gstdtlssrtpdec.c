@@ -30,6 +30,7 @@
 #include "gstdtlssrtpdec.h"
 
 #include "gstdtlsconnection.h"
+#include "gstdtlscertificate.h"
 
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -69,6 +70,7 @@ enum
   PROP_0,
   PROP_PEM,
   PROP_PEER_PEM,
+  PROP_KEY_TYPE,
   NUM_PROPERTIES
 };
 
@@ -76,6 +78,7 @@ static GParamSpec *properties[NUM_PROPERTIES];
 
 #define DEFAULT_PEM NULL
 #define DEFAULT_PEER_PEM NULL
+#define DEFAULT_KEY_TYPE GST_DTLS_KEY_TYPE_RSA
 
 static void gst_dtls_srtp_dec_set_property (GObject *, guint prop_id,
     const GValue *, GParamSpec *);
@@ -122,7 +125,7 @@ gst_dtls_srtp_dec_class_init (GstDtlsSrtpDecClass * klass)
   properties[PROP_PEM] =
       g_param_spec_string ("pem",
       "PEM string",
-      "A string containing a X509 certificate and RSA private key in PEM format",
+      "A string containing a X509 certificate and private key in PEM format",
       DEFAULT_PEM, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
   properties[PROP_PEER_PEM] =
@@ -131,6 +134,14 @@ gst_dtls_srtp_dec_class_init (GstDtlsSrtpDecClass * klass)
       "The X509 certificate received in the DTLS handshake, in PEM format",
       DEFAULT_PEER_PEM, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_KEY_TYPE] =
+      g_param_spec_enum ("key-type",
+      "Key type",
+      "Type of the private key of the generated certificate, used when no "
+      "pem is set",
+      GST_TYPE_DTLS_KEY_TYPE, DEFAULT_KEY_TYPE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class, NUM_PROPERTIES, properties);
 
   gst_element_class_add_pad_template (element_class,
@@ -246,6 +257,14 @@ gst_dtls_srtp_dec_set_property (GObject * object,
         GST_WARNING_OBJECT (self, "tried to set pem after disabling DTLS");
       }
       break;
+    case PROP_KEY_TYPE:
+      if (self->bin.dtls_element) {
+        g_object_set_property (G_OBJECT (self->bin.dtls_element), "key-type",
+            value);
+      } else {
+        GST_WARNING_OBJECT (self, "tried to set key-type after disabling DTLS");
+      }
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
   }
@@ -273,6 +292,14 @@ gst_dtls_srtp_dec_get_property (GObject * object,
         GST_WARNING_OBJECT (self, "tried to get peer-pem after disabling DTLS");
       }
       break;
+    case PROP_KEY_TYPE:
+      if (self->bin.dtls_element) {
+        g_object_get_property (G_OBJECT (self->bin.dtls_element), "key-type",
+            value);
+      } else {
+        GST_WARNING_OBJECT (self, "tried to get key-type after disabling DTLS");
+      }
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (self, prop_id, pspec);
   }
@@ -0,0 +1,216 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Runs the bands of a frame (or any other work split into independent
+ * parts) on the calling thread and a thread pool together.
+ *
+ * The calling thread is one of the threads: it wakes up at most one worker
+ * per remaining band, takes bands itself until none are left and then waits
+ * for the workers to finish theirs. Bands are handed out in order from an
+ * atomic counter, so a band index is only ever processed by one thread and
+ * can be used to pick per-band scratch memory.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstbandrunner.h"
+
+struct _GstBandRunner
+{
+  GThreadPool *pool;
+  guint n_threads;
+
+  /* the bands of the gst_band_runner_run() call in progress */
+  GstBandRunnerFunc func;
+  gpointer user_data;
+  guint n_bands;
+  gint next_band;
+
+  /* workers that have not finished yet, with lock */
+  GMutex lock;
+  GCond cond;
+  guint pending;
+};
+
+/* Runs bands until all of them are taken */
+static void
+gst_band_runner_work (GstBandRunner * runner)
+{
+  gint i;
+
+  while ((i = g_atomic_int_add (&runner->next_band, 1)) <
+      (gint) runner->n_bands)
+    runner->func (i, runner->n_bands, runner->user_data);
+}
+
+static void
+gst_band_runner_worker_func (gpointer data, gpointer user_data)
+{
+  GstBandRunner *runner = user_data;
+
+  gst_band_runner_work (runner);
+
+  g_mutex_lock (&runner->lock);
+  if (--runner->pending == 0)
+    g_cond_signal (&runner->cond);
+  g_mutex_unlock (&runner->lock);
+}
+
+/**
+ * gst_band_runner_new:
+ *
+ * Returns: a new #GstBandRunner that runs all bands on the calling thread
+ */
+GstBandRunner *
+gst_band_runner_new (void)
+{
+  GstBandRunner *runner = g_new0 (GstBandRunner, 1);
+
+  g_mutex_init (&runner->lock);
+  g_cond_init (&runner->cond);
+  runner->n_threads = 1;
+
+  return runner;
+}
+
+/**
+ * gst_band_runner_free:
+ * @runner: a #GstBandRunner
+ *
+ * Frees @runner and stops its threads.
+ */
+void
+gst_band_runner_free (GstBandRunner * runner)
+{
+  g_return_if_fail (runner != NULL);
+
+  if (runner->pool)
+    g_thread_pool_free (runner->pool, FALSE, TRUE);
+
+  g_mutex_clear (&runner->lock);
+  g_cond_clear (&runner->cond);
+  g_free (runner);
+}
+
+/**
+ * gst_band_runner_set_threads:
+ * @runner: a #GstBandRunner
+ * @n_threads: number of threads, the calling thread being one of them, or 0
+ *     for the number of processors
+ * @error: return location for an error
+ *
+ * Sets the number of threads the bands are run on. Must not be called while
+ * gst_band_runner_run() is in progress.
+ *
+ * Returns: %FALSE if the worker threads could not be created, @runner then
+ * keeps running all bands on the calling thread
+ */
+gboolean
+gst_band_runner_set_threads (GstBandRunner * runner, guint n_threads,
+    GError ** error)
+{
+  g_return_val_if_fail (runner != NULL, FALSE);
+
+  if (runner->pool) {
+    g_thread_pool_free (runner->pool, FALSE, TRUE);
+    runner->pool = NULL;
+  }
+  runner->n_threads = 1;
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  if (n_threads > 1) {
+    runner->pool = g_thread_pool_new (gst_band_runner_worker_func, runner,
+        n_threads - 1, FALSE, error);
+    if (runner->pool == NULL)
+      return FALSE;
+    runner->n_threads = n_threads;
+  }
+
+  return TRUE;
+}
+
+/**
+ * gst_band_runner_get_n_threads:
+ * @runner: a #GstBandRunner
+ *
+ * Returns: the number of threads the bands are run on, including the calling
+ * thread
+ */
+guint
+gst_band_runner_get_n_threads (GstBandRunner * runner)
+{
+  g_return_val_if_fail (runner != NULL, 1);
+
+  return runner->n_threads;
+}
+
+/**
+ * gst_band_runner_run:
+ * @runner: a #GstBandRunner
+ * @n_bands: number of bands
+ * @func: function processing one band
+ * @user_data: data passed to @func
+ *
+ * Calls @func for each band from 0 to @n_bands - 1, from the calling thread
+ * and the worker threads. Returns when all bands are done, so @user_data can
+ * live on the stack. Only one thread may run bands on @runner at a time.
+ */
+void
+gst_band_runner_run (GstBandRunner * runner, guint n_bands,
+    GstBandRunnerFunc func, gpointer user_data)
+{
+  guint i, n_workers = 0;
+
+  g_return_if_fail (runner != NULL);
+  g_return_if_fail (func != NULL);
+
+  if (n_bands == 0)
+    return;
+
+  if (n_bands == 1 || runner->pool == NULL) {
+    for (i = 0; i < n_bands; i++)
+      func (i, n_bands, user_data);
+    return;
+  }
+
+  runner->func = func;
+  runner->user_data = user_data;
+  runner->n_bands = n_bands;
+  runner->next_band = 0;
+
+  n_workers = MIN (runner->n_threads, n_bands) - 1;
+  runner->pending = n_workers;
+  for (i = 0; i < n_workers; i++)
+    g_thread_pool_push (runner->pool, runner, NULL);
+
+  /* the calling thread takes bands too */
+  gst_band_runner_work (runner);
+
+  g_mutex_lock (&runner->lock);
+  while (runner->pending > 0)
+    g_cond_wait (&runner->cond, &runner->lock);
+  g_mutex_unlock (&runner->lock);
+
+  runner->func = NULL;
+  runner->user_data = NULL;
+}
@@ -0,0 +1,60 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_BAND_RUNNER_H__
+#define __GST_BAND_RUNNER_H__
+
+#ifndef GST_USE_UNSTABLE_API
+#warning "The Base library from gst-plugins-bad is unstable API and may change in future."
+#warning "You can define GST_USE_UNSTABLE_API to avoid this warning."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstBandRunner GstBandRunner;
+
+/**
+ * GstBandRunnerFunc:
+ * @band: index of the band to process
+ * @n_bands: number of bands the work is split into
+ * @user_data: data passed to gst_band_runner_run()
+ *
+ * Processes one band. Called from the thread that runs the bands or from one
+ * of the worker threads, each band exactly once.
+ */
+typedef void (*GstBandRunnerFunc) (guint band, guint n_bands,
+                                   gpointer user_data);
+
+GstBandRunner * gst_band_runner_new           (void);
+void            gst_band_runner_free          (GstBandRunner * runner);
+
+gboolean        gst_band_runner_set_threads   (GstBandRunner * runner,
+                                               guint n_threads,
+                                               GError ** error);
+guint           gst_band_runner_get_n_threads (GstBandRunner * runner);
+
+void            gst_band_runner_run           (GstBandRunner * runner,
+                                               guint n_bands,
+                                               GstBandRunnerFunc func,
+                                               gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __GST_BAND_RUNNER_H__ */
@@ -0,0 +1,1011 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Field metrics shared by fieldanalysis, ivtc and combdetect.
+ *
+ * Every metric is a sum or maximum over lines that do not depend on each
+ * other, so the lines are split into bands that the calling thread and a
+ * thread pool work on together. The one exception is the comb run length of
+ * ivtc, which carries state from line to line: there only the comb test is
+ * banded and the run lengths are accumulated afterwards, skipping lines
+ * without combing.
+ *
+ * The per line kernels use SSE2 on x86-64. Elsewhere the temporal metrics
+ * use the Orc programs that fieldanalysis used before and the comb tests
+ * are plain C.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "gstfieldmetrics.h"
+#include "gstfieldmetricsorc.h"
+
+#include <gst/base/gstbandrunner.h>
+
+#if HAVE_CPU_X86_64
+#include <emmintrin.h>
+#endif
+
+/* fewer lines than this per band are not worth a thread */
+#define MIN_BAND_LINES 8
+
+/* ivtc and combdetect count a pixel as combed once its run reaches this */
+#define COMB_RUN_THRESHOLD 100
+#define COMB_RUN_MAX 1000
+
+typedef enum
+{
+  JOB_SAD,
+  JOB_SSD,
+  JOB_3_TAP,
+  JOB_5_TAP,
+  JOB_COMB_BLOCKS,
+  JOB_COMB_RUNS
+} GstFieldMetricsJobType;
+
+typedef struct
+{
+  GstFieldMetrics *metrics;
+
+  /* lines, or rows of blocks, of this band */
+  gint start;
+  gint end;
+
+  guint64 sum;
+
+  /* scratch for comb_blocks */
+  guint8 *mask;
+  guint *block_scores;
+  gint scratch_width;
+} GstFieldMetricsJob;
+
+struct _GstFieldMetrics
+{
+  /* parameters of the metric being calculated */
+  GstFieldMetricsJobType type;
+  const guint8 *f1, *f2;
+  gint stride1, stride2;
+  gint width;
+  gint pstride;
+  guint32 threshold;
+
+  GstFieldMetricsCombMethod method;
+  gint row_stride;
+  gint block_width, block_height;
+  gint64 spatial_thresh;
+  guint64 *row_scores;
+
+  /* comb_runs: comb test result per pixel and whether a line has any */
+  guint8 *runs_mask;
+  guint8 *runs_any;
+  gint *runs;
+  gsize runs_mask_size;
+  gint runs_width;
+  gint runs_height;
+
+  /* one job with its scratch memory per thread */
+  GstFieldMetricsJob *jobs;
+  guint n_threads;
+
+  GstBandRunner *runner;
+};
+
+/* line kernels */
+
+static guint64
+sad_row (const guint8 * a, const guint8 * b, gint width, guint32 nf)
+{
+  guint64 sum = 0;
+  gint x = 0;
+
+#if HAVE_CPU_X86_64
+  {
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i nfv = _mm_set1_epi8 ((char) MIN (nf, 255));
+    __m128i acc = zero;
+
+    for (; x + 16 <= width; x += 16) {
+      __m128i va = _mm_loadu_si128 ((const __m128i *) (a + x));
+      __m128i vb = _mm_loadu_si128 ((const __m128i *) (b + x));
+      __m128i ad = _mm_or_si128 (_mm_subs_epu8 (va, vb),
+          _mm_subs_epu8 (vb, va));
+      /* all ones where the difference is not above the noise floor */
+      __m128i quiet = _mm_cmpeq_epi8 (_mm_subs_epu8 (ad, nfv), zero);
+
+      acc = _mm_add_epi64 (acc, _mm_sad_epu8 (_mm_andnot_si128 (quiet, ad),
+              zero));
+    }
+    acc = _mm_add_epi64 (acc, _mm_srli_si128 (acc, 8));
+    sum = _mm_cvtsi128_si64 (acc);
+  }
+#else
+  if (width > 0) {
+    guint32 tmp = 0;
+
+    field_metrics_orc_same_parity_sad (&tmp, a, b, nf, width);
+    sum = tmp;
+    x = width;
+  }
+#endif
+
+  for (; x < width; x++) {
+    guint32 d = ABS (a[x] - b[x]);
+
+    if (d > nf)
+      sum += d;
+  }
+
+  return sum;
+}
+
+static guint64
+ssd_row (const guint8 * a, const guint8 * b, gint width, guint32 nf)
+{
+  guint64 sum = 0;
+  gint x = 0;
+
+#if HAVE_CPU_X86_64
+  if (nf >= 255 * 255)
+    return 0;
+  {
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i sign = _mm_set1_epi16 ((short) 0x8000);
+    __m128i nfv = _mm_xor_si128 (_mm_set1_epi16 ((short) nf), sign);
+    __m128i acc = zero;
+    guint32 lanes[4];
+
+    for (; x + 16 <= width; x += 16) {
+      __m128i va = _mm_loadu_si128 ((const __m128i *) (a + x));
+      __m128i vb = _mm_loadu_si128 ((const __m128i *) (b + x));
+      __m128i d, sq, over;
+
+      /* the squares fit in unsigned 16 bits, compared with the sign flipped */
+      d = _mm_sub_epi16 (_mm_unpacklo_epi8 (va, zero),
+          _mm_unpacklo_epi8 (vb, zero));
+      sq = _mm_mullo_epi16 (d, d);
+      over = _mm_cmpgt_epi16 (_mm_xor_si128 (sq, sign), nfv);
+      sq = _mm_and_si128 (sq, over);
+      acc = _mm_add_epi32 (acc, _mm_unpacklo_epi16 (sq, zero));
+      acc = _mm_add_epi32 (acc, _mm_unpackhi_epi16 (sq, zero));
+
+      d = _mm_sub_epi16 (_mm_unpackhi_epi8 (va, zero),
+          _mm_unpackhi_epi8 (vb, zero));
+      sq = _mm_mullo_epi16 (d, d);
+      over = _mm_cmpgt_epi16 (_mm_xor_si128 (sq, sign), nfv);
+      sq = _mm_and_si128 (sq, over);
+      acc = _mm_add_epi32 (acc, _mm_unpacklo_epi16 (sq, zero));
+      acc = _mm_add_epi32 (acc, _mm_unpackhi_epi16 (sq, zero));
+    }
+    _mm_storeu_si128 ((__m128i *) lanes, acc);
+    sum = (guint64) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+#else
+  if (width > 0) {
+    guint32 tmp = 0;
+
+    field_metrics_orc_same_parity_ssd (&tmp, a, b, nf, width);
+    sum = tmp;
+    x = width;
+  }
+#endif
+
+  for (; x < width; x++) {
+    guint32 d = (a[x] - b[x]) * (a[x] - b[x]);
+
+    if (d > nf)
+      sum += d;
+  }
+
+  return sum;
+}
+
+/* horizontal [1,4,1] of sample @x, mirrored at the edges */
+static inline gint
+tap3 (const guint8 * l, gint x, gint width, gint pstride)
+{
+  gint left = x > 0 ? x - 1 : MIN (1, width - 1);
+  gint right = x < width - 1 ? x + 1 : MAX (width - 2, 0);
+
+  return l[left * pstride] + (l[x * pstride] << 2) + l[right * pstride];
+}
+
+static guint64
+tap3_row (const guint8 * a, const guint8 * b, gint width, gint pstride,
+    guint32 nf)
+{
+  guint64 sum = 0;
+  guint32 d;
+  gint x;
+
+  if (width <= 0)
+    return 0;
+
+  /* left edge */
+  d = ABS (tap3 (a, 0, width, pstride) - tap3 (b, 0, width, pstride));
+  if (d > nf)
+    sum += d;
+  x = 1;
+
+  if (pstride == 1) {
+#if HAVE_CPU_X86_64
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i ones = _mm_set1_epi16 (1);
+    __m128i nfv = _mm_set1_epi16 ((short) MIN (nf, 32767));
+    __m128i acc = zero;
+    guint32 lanes[4];
+
+    for (; x + 8 < width; x += 8) {
+      __m128i ta, tb, t;
+
+      ta = _mm_add_epi16 (_mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i
+                      *) (a + x - 1)), zero),
+          _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) (a + x + 1)),
+              zero));
+      ta = _mm_add_epi16 (ta, _mm_slli_epi16 (_mm_unpacklo_epi8
+              (_mm_loadl_epi64 ((const __m128i *) (a + x)), zero), 2));
+      tb = _mm_add_epi16 (_mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i
+                      *) (b + x - 1)), zero),
+          _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) (b + x + 1)),
+              zero));
+      tb = _mm_add_epi16 (tb, _mm_slli_epi16 (_mm_unpacklo_epi8
+              (_mm_loadl_epi64 ((const __m128i *) (b + x)), zero), 2));
+
+      t = _mm_sub_epi16 (ta, tb);
+      t = _mm_max_epi16 (t, _mm_sub_epi16 (zero, t));
+      t = _mm_and_si128 (t, _mm_cmpgt_epi16 (t, nfv));
+      acc = _mm_add_epi32 (acc, _mm_madd_epi16 (t, ones));
+    }
+    _mm_storeu_si128 ((__m128i *) lanes, acc);
+    sum += (guint64) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+    if (width > 2) {
+      guint32 tmp = 0;
+
+      field_metrics_orc_same_parity_3_tap (&tmp, a, a + 1, a + 2, b, b + 1,
+          b + 2, nf, width - 2);
+      sum += tmp;
+      x = width - 1;
+    }
+#endif
+  }
+
+  for (; x < width; x++) {
+    d = ABS (tap3 (a, x, width, pstride) - tap3 (b, x, width, pstride));
+    if (d > nf)
+      sum += d;
+  }
+
+  return sum;
+}
+
+/* vertical [1,-3,4,-3,1] */
+static guint64
+tap5_row (const guint8 * m2, const guint8 * m1, const guint8 * c,
+    const guint8 * p1, const guint8 * p2, gint width, guint32 nf)
+{
+  guint64 sum = 0;
+  gint x = 0;
+
+#if HAVE_CPU_X86_64
+  {
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i ones = _mm_set1_epi16 (1);
+    __m128i nfv = _mm_set1_epi16 ((short) MIN (nf, 32767));
+    __m128i acc = zero;
+    guint32 lanes[4];
+
+    for (; x + 8 <= width; x += 8) {
+      __m128i vm2 = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)
+              (m2 + x)), zero);
+      __m128i vm1 = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)
+              (m1 + x)), zero);
+      __m128i vc = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)
+              (c + x)), zero);
+      __m128i vp1 = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)
+              (p1 + x)), zero);
+      __m128i vp2 = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *)
+              (p2 + x)), zero);
+      __m128i n = _mm_add_epi16 (vm1, vp1);
+      __m128i t;
+
+      t = _mm_add_epi16 (_mm_add_epi16 (vm2, vp2), _mm_slli_epi16 (vc, 2));
+      t = _mm_sub_epi16 (t, _mm_add_epi16 (n, _mm_add_epi16 (n, n)));
+      t = _mm_max_epi16 (t, _mm_sub_epi16 (zero, t));
+      t = _mm_and_si128 (t, _mm_cmpgt_epi16 (t, nfv));
+      acc = _mm_add_epi32 (acc, _mm_madd_epi16 (t, ones));
+    }
+    _mm_storeu_si128 ((__m128i *) lanes, acc);
+    sum = (guint64) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+#else
+  if (width > 0) {
+    guint32 tmp = 0;
+
+    field_metrics_orc_opposite_parity_5_tap (&tmp, m2, m1, c, p1, p2, nf,
+        width);
+    sum = tmp;
+    x = width;
+  }
+#endif
+
+  for (; x < width; x++) {
+    guint32 d = ABS (m2[x] - 3 * (m1[x] + p1[x]) + (c[x] << 2) + p2[x]);
+
+    if (d > nf)
+      sum += d;
+  }
+
+  return sum;
+}
+
+/* Sets @mask[i] to 1 where sample i of line @fj is combed with respect to
+ * the lines around it, and to 0 elsewhere. */
+static void
+comb_mask_row (GstFieldMetricsCombMethod method, const guint8 * fjm2,
+    const guint8 * fjm1, const guint8 * fj, const guint8 * fjp1,
+    const guint8 * fjp2, gint width, gint pstride, gint64 t, guint8 * mask)
+{
+  gint i = 0;
+
+#if HAVE_CPU_X86_64
+  /* the vector version works on 16 bit differences. For a non-negative
+   * threshold the isCombed product test follows from the first test: both
+   * differences are larger than t, so their product is larger than t^2 */
+  if (pstride == 1 && t >= 0 && t < 255) {
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i tv = _mm_set1_epi16 ((short) t);
+    __m128i ntv = _mm_set1_epi16 ((short) -t);
+    __m128i t6v = _mm_set1_epi16 ((short) (6 * t));
+    __m128i ten = _mm_set1_epi16 (10);
+    __m128i fifteen = _mm_set1_epi16 (15);
+    __m128i one = _mm_set1_epi8 (1);
+
+    for (; i + 16 <= width; i += 16) {
+      __m128i res[2];
+      gint h;
+
+      for (h = 0; h < 2; h++) {
+        __m128i vm1 = _mm_loadu_si128 ((const __m128i *) (fjm1 + i));
+        __m128i vj = _mm_loadu_si128 ((const __m128i *) (fj + i));
+        __m128i vp1 = _mm_loadu_si128 ((const __m128i *) (fjp1 + i));
+        __m128i d1, d2, cond;
+
+        if (h == 0) {
+          vm1 = _mm_unpacklo_epi8 (vm1, zero);
+          vj = _mm_unpacklo_epi8 (vj, zero);
+          vp1 = _mm_unpacklo_epi8 (vp1, zero);
+        } else {
+          vm1 = _mm_unpackhi_epi8 (vm1, zero);
+          vj = _mm_unpackhi_epi8 (vj, zero);
+          vp1 = _mm_unpackhi_epi8 (vp1, zero);
+        }
+
+        d1 = _mm_sub_epi16 (vj, vm1);
+        d2 = _mm_sub_epi16 (vj, vp1);
+        cond = _mm_or_si128 (_mm_and_si128 (_mm_cmpgt_epi16 (d1, tv),
+                _mm_cmpgt_epi16 (d2, tv)),
+            _mm_and_si128 (_mm_cmplt_epi16 (d1, ntv),
+                _mm_cmplt_epi16 (d2, ntv)));
+
+        if (method == GST_FIELD_METRICS_COMB_32DETECT) {
+          __m128i vm2 = _mm_loadu_si128 ((const __m128i *) (fjm2 + i));
+          __m128i d;
+
+          vm2 = h == 0 ? _mm_unpacklo_epi8 (vm2, zero) :
+              _mm_unpackhi_epi8 (vm2, zero);
+          d = _mm_sub_epi16 (vj, vm2);
+          d = _mm_max_epi16 (d, _mm_sub_epi16 (zero, d));
+          cond = _mm_and_si128 (cond, _mm_cmplt_epi16 (d, ten));
+          d = _mm_max_epi16 (d1, _mm_sub_epi16 (zero, d1));
+          cond = _mm_and_si128 (cond, _mm_cmpgt_epi16 (d, fifteen));
+        } else if (method == GST_FIELD_METRICS_COMB_5_TAP) {
+          __m128i vm2 = _mm_loadu_si128 ((const __m128i *) (fjm2 + i));
+          __m128i vp2 = _mm_loadu_si128 ((const __m128i *) (fjp2 + i));
+          __m128i n = _mm_add_epi16 (vm1, vp1);
+          __m128i v;
+
+          if (h == 0) {
+            vm2 = _mm_unpacklo_epi8 (vm2, zero);
+            vp2 = _mm_unpacklo_epi8 (vp2, zero);
+          } else {
+            vm2 = _mm_unpackhi_epi8 (vm2, zero);
+            vp2 = _mm_unpackhi_epi8 (vp2, zero);
+          }
+          v = _mm_add_epi16 (_mm_add_epi16 (vm2, vp2), _mm_slli_epi16 (vj, 2));
+          v = _mm_sub_epi16 (v, _mm_add_epi16 (n, _mm_add_epi16 (n, n)));
+          v = _mm_max_epi16 (v, _mm_sub_epi16 (zero, v));
+          cond = _mm_and_si128 (cond, _mm_cmpgt_epi16 (v, t6v));
+        }
+        res[h] = cond;
+      }
+
+      _mm_storeu_si128 ((__m128i *) (mask + i),
+          _mm_and_si128 (_mm_packs_epi16 (res[0], res[1]), one));
+    }
+  }
+#endif
+
+  for (; i < width; i++) {
+    const gint idx = i * pstride;
+    const gint diff1 = fj[idx] - fjm1[idx];
+    const gint diff2 = fj[idx] - fjp1[idx];
+
+    /* change in the same direction */
+    if ((diff1 > t && diff2 > t) || (diff1 < -t && diff2 < -t)) {
+      switch (method) {
+        case GST_FIELD_METRICS_COMB_32DETECT:
+          mask[i] = abs (fj[idx] - fjm2[idx]) < 10
+              && abs (fj[idx] - fjm1[idx]) > 15;
+          break;
+        case GST_FIELD_METRICS_COMB_IS_COMBED:
+          mask[i] = (gint64) (fjm1[idx] - fj[idx]) * (fjp1[idx] - fj[idx]) >
+              t * t;
+          break;
+        case GST_FIELD_METRICS_COMB_5_TAP:
+          mask[i] = abs (fjm2[idx] + (fj[idx] << 2) + fjp2[idx] -
+              3 * (fjm1[idx] + fjp1[idx])) > 6 * t;
+          break;
+      }
+    } else {
+      mask[i] = 0;
+    }
+  }
+}
+
+/* the ivtc comb test: the middle line is outside of the range of the lines
+ * above and below by more than 5 */
+static gboolean
+comb_test_row (const guint8 * s1, const guint8 * s2, const guint8 * s3,
+    gint width, guint8 * mask)
+{
+  guint8 any = 0;
+  gint i = 0;
+
+#if HAVE_CPU_X86_64
+  {
+    __m128i zero = _mm_setzero_si128 ();
+    __m128i five = _mm_set1_epi8 (5);
+    __m128i one = _mm_set1_epi8 (1);
+    __m128i acc = zero;
+
+    for (; i + 16 <= width; i += 16) {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (s1 + i));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (s2 + i));
+      __m128i c = _mm_loadu_si128 ((const __m128i *) (s3 + i));
+      __m128i below = _mm_subs_epu8 (_mm_min_epu8 (a, c), b);
+      __m128i above = _mm_subs_epu8 (b, _mm_max_epu8 (a, c));
+      __m128i quiet = _mm_cmpeq_epi8 (_mm_subs_epu8 (_mm_or_si128 (below,
+                  above), five), zero);
+      __m128i m = _mm_andnot_si128 (quiet, one);
+
+      _mm_storeu_si128 ((__m128i *) (mask + i), m);
+      acc = _mm_or_si128 (acc, m);
+    }
+    any = _mm_movemask_epi8 (_mm_cmpeq_epi8 (acc, zero)) != 0xffff;
+  }
+#endif
+
+  for (; i < width; i++) {
+    mask[i] = s2[i] < MIN (s1[i], s3[i]) - 5 || s2[i] > MAX (s1[i], s3[i]) + 5;
+    any |= mask[i];
+  }
+
+  return any;
+}
+
+/* jobs */
+
+static void
+ensure_job_scratch (GstFieldMetricsJob * job, gint width, gint n_blocks)
+{
+  if (job->scratch_width < width) {
+    g_free (job->mask);
+    g_free (job->block_scores);
+    job->mask = g_malloc (width);
+    job->block_scores = g_new (guint, width);
+    job->scratch_width = width;
+  }
+  memset (job->block_scores, 0, n_blocks * sizeof (guint));
+}
+
+/* line @k of the frame woven from the fields @fj and @fjp1, whose line 0 is
+ * @fj and line 1 is @fjp1 */
+static inline const guint8 *
+woven_line (const guint8 * fj, const guint8 * fjp1, gint line_stride, gint k)
+{
+  return ((k & 1) ? fjp1 : fj) + ((k - (k & 1)) / 2) * line_stride;
+}
+
+static guint64
+comb_blocks_row (GstFieldMetrics * m, GstFieldMetricsJob * job, gint row)
+{
+  const gint width = m->width;
+  const gint bw = m->block_width;
+  const gint n_blocks = width / bw;
+  const guint8 *fj = m->f1 + row * m->row_stride;
+  const guint8 *fjp1 = m->f2 + row * m->row_stride;
+  guint8 *mask;
+  guint *scores;
+  guint64 block_score = 0;
+  gint i, j;
+
+  ensure_job_scratch (job, width, n_blocks);
+  mask = job->mask;
+  scores = job->block_scores;
+
+  for (j = 0; j < m->block_height; j++) {
+    const guint8 *lm2 = woven_line (fj, fjp1, m->stride1, j - 2);
+    const guint8 *lm1 = woven_line (fj, fjp1, m->stride1, j - 1);
+    const guint8 *l = woven_line (fj, fjp1, m->stride1, j);
+    const guint8 *lp1 = woven_line (fj, fjp1, m->stride1, j + 1);
+    const guint8 *lp2 = woven_line (fj, fjp1, m->stride1, j + 2);
+
+    comb_mask_row (m->method, lm2, lm1, l, lp1, lp2, width, m->pstride,
+        m->spatial_thresh, mask);
+
+    /* a sample adds to the score of its block if the samples to its left
+     * and right are combed too; at the edges one neighbour is enough */
+    for (i = 1; i < width; i++) {
+      const gint res_idx = (i - 1) / bw;
+
+      if (i == 1) {
+        if (mask[0] && mask[1])
+          scores[res_idx]++;
+      } else if (i == width - 1) {
+        if (mask[i - 2] && mask[i - 1] && mask[i])
+          scores[res_idx]++;
+        if (mask[i - 1] && mask[i])
+          scores[i / bw]++;
+      } else if (mask[i - 2] && mask[i - 1] && mask[i]) {
+        scores[res_idx]++;
+      }
+    }
+  }
+
+  for (i = 0; i < n_blocks; i++)
+    block_score = MAX (block_score, scores[i]);
+
+  return block_score;
+}
+
+static void
+run_job (GstFieldMetricsJob * job)
+{
+  GstFieldMetrics *m = job->metrics;
+  gint j;
+
+  job->sum = 0;
+
+  switch (m->type) {
+    case JOB_SAD:
+      for (j = job->start; j < job->end; j++)
+        job->sum += sad_row (m->f1 + j * m->stride1, m->f2 + j * m->stride2,
+            m->width, m->threshold);
+      break;
+    case JOB_SSD:
+      for (j = job->start; j < job->end; j++)
+        job->sum += ssd_row (m->f1 + j * m->stride1, m->f2 + j * m->stride2,
+            m->width, m->threshold);
+      break;
+    case JOB_3_TAP:
+      for (j = job->start; j < job->end; j++)
+        job->sum += tap3_row (m->f1 + j * m->stride1, m->f2 + j * m->stride2,
+            m->width, m->pstride, m->threshold);
+      break;
+    case JOB_5_TAP:{
+      /* line j of the field of interest f1 lies between lines j - 1 and j
+       * of the other field f2; the neighbours are mirrored at the edges */
+      const gint lines = m->row_stride;
+
+      for (j = job->start; j < job->end; j++) {
+        const guint8 *c = m->f1 + j * m->stride1;
+        const guint8 *p1 = m->f2 + j * m->stride2;
+        const guint8 *p2 = j + 1 < lines ? c + m->stride1 :
+            j > 0 ? c - m->stride1 : c;
+        const guint8 *m1 = j > 0 ? p1 - m->stride2 : p1;
+        const guint8 *m2 = j > 0 ? c - m->stride1 : p2;
+
+        if (j == lines - 1) {
+          p1 = m1;
+          p2 = m2;
+        }
+        job->sum += tap5_row (m2, m1, c, p1, p2, m->width, m->threshold);
+      }
+      break;
+    }
+    case JOB_COMB_BLOCKS:
+      for (j = job->start; j < job->end; j++)
+        m->row_scores[j] = comb_blocks_row (m, job, j);
+      break;
+    case JOB_COMB_RUNS:
+      for (j = job->start; j < job->end; j++) {
+        const guint8 *s1 = woven_line (m->f1, m->f2, m->stride1, j - 1);
+        const guint8 *s2 = woven_line (m->f1, m->f2, m->stride1, j);
+        const guint8 *s3 = woven_line (m->f1, m->f2, m->stride1, j + 1);
+
+        m->runs_any[j] = comb_test_row (s1, s2, s3, m->width,
+            m->runs_mask + j * m->width);
+      }
+      break;
+  }
+}
+
+static void
+gst_field_metrics_job_func (guint band, guint n_bands, gpointer user_data)
+{
+  GstFieldMetrics *metrics = user_data;
+
+  run_job (&metrics->jobs[band]);
+}
+
+/* Splits the units (lines or rows of blocks) from @start to @end into bands
+ * and runs them. Returns the sum of the band results. */
+static guint64
+gst_field_metrics_run (GstFieldMetrics * metrics, gint start, gint end,
+    gint min_units)
+{
+  gint n_units = end - start;
+  guint i, n_bands;
+  guint64 sum = 0;
+
+  if (n_units <= 0)
+    return 0;
+
+  n_bands = CLAMP (n_units / MAX (min_units, 1), 1, (gint) metrics->n_threads);
+
+  for (i = 0; i < n_bands; i++) {
+    GstFieldMetricsJob *job = &metrics->jobs[i];
+
+    job->start = start + (gint64) n_units * i / n_bands;
+    job->end = start + (gint64) n_units * (i + 1) / n_bands;
+  }
+
+  gst_band_runner_run (metrics->runner, n_bands, gst_field_metrics_job_func,
+      metrics);
+
+  for (i = 0; i < n_bands; i++)
+    sum += metrics->jobs[i].sum;
+
+  return sum;
+}
+
+/**
+ * gst_field_metrics_new:
+ *
+ * Returns: a new #GstFieldMetrics that calculates on the calling thread only
+ */
+GstFieldMetrics *
+gst_field_metrics_new (void)
+{
+  GstFieldMetrics *metrics = g_new0 (GstFieldMetrics, 1);
+
+  metrics->runner = gst_band_runner_new ();
+  metrics->n_threads = 1;
+  metrics->jobs = g_new0 (GstFieldMetricsJob, 1);
+  metrics->jobs[0].metrics = metrics;
+
+  return metrics;
+}
+
+/**
+ * gst_field_metrics_free:
+ * @metrics: a #GstFieldMetrics
+ *
+ * Frees @metrics and stops its threads.
+ */
+void
+gst_field_metrics_free (GstFieldMetrics * metrics)
+{
+  guint i;
+
+  g_return_if_fail (metrics != NULL);
+
+  gst_band_runner_free (metrics->runner);
+
+  for (i = 0; i < metrics->n_threads; i++) {
+    g_free (metrics->jobs[i].mask);
+    g_free (metrics->jobs[i].block_scores);
+  }
+  g_free (metrics->jobs);
+  g_free (metrics->runs_mask);
+  g_free (metrics->runs_any);
+  g_free (metrics->runs);
+
+  g_free (metrics);
+}
+
+/**
+ * gst_field_metrics_set_threads:
+ * @metrics: a #GstFieldMetrics
+ * @n_threads: number of threads, the calling thread being one of them, or 0
+ *     for the number of processors
+ * @error: return location for an error
+ *
+ * Sets the number of threads the metrics are calculated with. Must not be
+ * called while a metric is being calculated.
+ *
+ * Returns: %FALSE if the worker threads could not be created, @metrics then
+ * keeps calculating on the calling thread only
+ */
+gboolean
+gst_field_metrics_set_threads (GstFieldMetrics * metrics, guint n_threads,
+    GError ** error)
+{
+  gboolean ret;
+  guint i;
+
+  g_return_val_if_fail (metrics != NULL, FALSE);
+
+  for (i = 1; i < metrics->n_threads; i++) {
+    g_free (metrics->jobs[i].mask);
+    g_free (metrics->jobs[i].block_scores);
+  }
+
+  ret = gst_band_runner_set_threads (metrics->runner, n_threads, error);
+  n_threads = gst_band_runner_get_n_threads (metrics->runner);
+
+  metrics->jobs = g_renew (GstFieldMetricsJob, metrics->jobs, n_threads);
+  for (i = 1; i < n_threads; i++) {
+    memset (&metrics->jobs[i], 0, sizeof (GstFieldMetricsJob));
+    metrics->jobs[i].metrics = metrics;
+  }
+  metrics->n_threads = n_threads;
+
+  return ret;
+}
+
+static void
+set_planes (GstFieldMetrics * metrics, GstFieldMetricsJobType type,
+    const guint8 * f1, gint stride1, const guint8 * f2, gint stride2,
+    gint width, guint32 threshold)
+{
+  metrics->type = type;
+  metrics->f1 = f1;
+  metrics->stride1 = stride1;
+  metrics->f2 = f2;
+  metrics->stride2 = stride2;
+  metrics->width = width;
+  metrics->pstride = 1;
+  metrics->threshold = threshold;
+}
+
+/**
+ * gst_field_metrics_sad:
+ * @metrics: a #GstFieldMetrics
+ * @f1: first line of the first field
+ * @stride1: distance between the lines of @f1
+ * @f2: first line of the second field
+ * @stride2: distance between the lines of @f2
+ * @width: bytes per line to compare
+ * @lines: number of lines
+ * @noise_floor: absolute differences up to this are ignored
+ *
+ * Returns: the sum of the absolute differences above @noise_floor
+ */
+guint64
+gst_field_metrics_sad (GstFieldMetrics * metrics, const guint8 * f1,
+    gint stride1, const guint8 * f2, gint stride2, gint width, gint lines,
+    guint32 noise_floor)
+{
+  set_planes (metrics, JOB_SAD, f1, stride1, f2, stride2, width, noise_floor);
+
+  return gst_field_metrics_run (metrics, 0, lines, MIN_BAND_LINES);
+}
+
+/**
+ * gst_field_metrics_ssd:
+ * @noise_floor: squared differences up to this are ignored
+ *
+ * Like gst_field_metrics_sad() for squared differences.
+ *
+ * Returns: the sum of the squared differences above @noise_floor
+ */
+guint64
+gst_field_metrics_ssd (GstFieldMetrics * metrics, const guint8 * f1,
+    gint stride1, const guint8 * f2, gint stride2, gint width, gint lines,
+    guint32 noise_floor)
+{
+  set_planes (metrics, JOB_SSD, f1, stride1, f2, stride2, width, noise_floor);
+
+  return gst_field_metrics_run (metrics, 0, lines, MIN_BAND_LINES);
+}
+
+/**
+ * gst_field_metrics_3_tap:
+ * @width: samples per line
+ * @pstride: distance between samples
+ * @noise_floor: differences up to this are ignored
+ *
+ * Like gst_field_metrics_sad() but compares the samples filtered
+ * horizontally with [1,4,1], mirrored at the edges of the lines.
+ *
+ * Returns: the sum of the filtered absolute differences above @noise_floor
+ */
+guint64
+gst_field_metrics_3_tap (GstFieldMetrics * metrics, const guint8 * f1,
+    gint stride1, const guint8 * f2, gint stride2, gint width, gint pstride,
+    gint lines, guint32 noise_floor)
+{
+  set_planes (metrics, JOB_3_TAP, f1, stride1, f2, stride2, width,
+      noise_floor);
+  metrics->pstride = pstride;
+
+  return gst_field_metrics_run (metrics, 0, lines, MIN_BAND_LINES);
+}
+
+/**
+ * gst_field_metrics_5_tap:
+ * @metrics: a #GstFieldMetrics
+ * @f: first line of the field to filter
+ * @fstride: distance between the lines of @f
+ * @o: first line of the opposite field, the one below the first line of @f
+ *     in the woven frame
+ * @ostride: distance between the lines of @o
+ * @width: bytes per line
+ * @lines: number of lines of @f
+ * @noise_floor: filter results up to this are ignored
+ *
+ * Filters the frame woven from @f and @o vertically with [1,-3,4,-3,1] at
+ * the lines of @f, mirroring at the top and bottom. Large results mean the
+ * fields do not belong together.
+ *
+ * Returns: the sum of the absolute filter results above @noise_floor
+ */
+guint64
+gst_field_metrics_5_tap (GstFieldMetrics * metrics, const guint8 * f,
+    gint fstride, const guint8 * o, gint ostride, gint width, gint lines,
+    guint32 noise_floor)
+{
+  set_planes (metrics, JOB_5_TAP, f, fstride, o, ostride, width, noise_floor);
+  metrics->row_stride = lines;
+
+  return gst_field_metrics_run (metrics, 0, lines, MIN_BAND_LINES);
+}
+
+/**
+ * gst_field_metrics_comb_blocks:
+ * @metrics: a #GstFieldMetrics
+ * @method: the comb test
+ * @fj: line 0 of the woven frame in the first row of blocks
+ * @fjp1: line 1 of the woven frame in the first row of blocks
+ * @line_stride: distance between the lines of one field
+ * @row_stride: distance between rows of blocks
+ * @width: samples per line, a multiple of @block_width
+ * @pstride: distance between samples
+ * @block_width: width of the blocks
+ * @block_height: lines per row of blocks
+ * @spatial_thresh: threshold of the comb test
+ * @n_rows: number of rows of blocks
+ * @row_scores: return location for the highest block score of each row
+ *
+ * Tests every sample of the woven frame for combing and counts, per block,
+ * the combed samples whose horizontal neighbours are combed too. The two
+ * lines above every row of blocks and the two below are read as well.
+ */
+void
+gst_field_metrics_comb_blocks (GstFieldMetrics * metrics,
+    GstFieldMetricsCombMethod method, const guint8 * fj, const guint8 * fjp1,
+    gint line_stride, gint row_stride, gint width, gint pstride,
+    gint block_width, gint block_height, gint64 spatial_thresh, guint n_rows,
+    guint64 * row_scores)
+{
+  g_return_if_fail (block_width > 0);
+
+  set_planes (metrics, JOB_COMB_BLOCKS, fj, line_stride, fjp1, line_stride,
+      width, 0);
+  metrics->pstride = pstride;
+  metrics->method = method;
+  metrics->row_stride = row_stride;
+  metrics->block_width = block_width;
+  metrics->block_height = block_height;
+  metrics->spatial_thresh = spatial_thresh;
+  metrics->row_scores = row_scores;
+
+  gst_field_metrics_run (metrics, 0, n_rows, 1);
+}
+
+/**
+ * gst_field_metrics_comb_runs:
+ * @metrics: a #GstFieldMetrics
+ * @top: frame to take the top field from
+ * @bottom: frame to take the bottom field from
+ * @stride: distance between the lines of @top and @bottom
+ * @width: width in pixels
+ * @height: height in lines
+ * @combed: return location for the combed pixels, or %NULL
+ * @combed_stride: distance between the lines of @combed
+ *
+ * Finds the pixels where the woven frame is combed: the pixel is outside of
+ * the range of the pixels above and below it by more than 5, and such pixels
+ * form a run that is long enough, counting horizontally connected pixels
+ * and the run of the pixel above. The top and bottom two lines are left out
+ * as they often contain artifacts. If @combed is not %NULL, it is set to 1
+ * for combed pixels and to 0 for the others, except for the left out lines.
+ *
+ * Returns: the number of combed pixels
+ */
+guint64
+gst_field_metrics_comb_runs (GstFieldMetrics * metrics, const guint8 * top,
+    const guint8 * bottom, gint stride, gint width, gint height,
+    guint8 * combed, gint combed_stride)
+{
+  guint64 score = 0;
+  gint *runs;
+  gint i, j;
+
+  if (width <= 0 || height <= 4)
+    return 0;
+
+  if (metrics->runs_width != width || metrics->runs_height != height) {
+    g_free (metrics->runs_mask);
+    g_free (metrics->runs_any);
+    g_free (metrics->runs);
+    metrics->runs_mask = g_malloc ((gsize) width * height);
+    metrics->runs_any = g_malloc (height);
+    metrics->runs = g_new (gint, width);
+    metrics->runs_width = width;
+    metrics->runs_height = height;
+  }
+
+  /* the frame is woven from top and bottom, woven_line() picks the line with
+   * the same stride for both fields */
+  set_planes (metrics, JOB_COMB_RUNS, top, 2 * stride, bottom + stride,
+      2 * stride, width, 0);
+  gst_field_metrics_run (metrics, 2, height - 2, MIN_BAND_LINES);
+
+  runs = metrics->runs;
+  memset (runs, 0, width * sizeof (gint));
+
+  for (j = 2; j < height - 2; j++) {
+    const guint8 *mask = metrics->runs_mask + j * width;
+    guint8 *c = combed ? combed + j * combed_stride : NULL;
+
+    if (!metrics->runs_any[j]) {
+      memset (runs, 0, width * sizeof (gint));
+      if (c)
+        memset (c, 0, width);
+      continue;
+    }
+
+    for (i = 0; i < width; i++) {
+      if (mask[i]) {
+        if (i > 0)
+          runs[i] += runs[i - 1];
+        runs[i] = MIN (runs[i] + 1, COMB_RUN_MAX);
+      } else {
+        runs[i] = 0;
+      }
+
+      if (runs[i] > COMB_RUN_THRESHOLD) {
+        score++;
+        if (c)
+          c[i] = 1;
+      } else if (c) {
+        c[i] = 0;
+      }
+    }
+  }
+
+  return score;
+}
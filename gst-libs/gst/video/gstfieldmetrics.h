@@ -0,0 +1,102 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_FIELD_METRICS_H__
+#define __GST_FIELD_METRICS_H__
+
+#ifndef GST_USE_UNSTABLE_API
+#warning "The field metrics API is unstable and may change in future."
+#warning "You can define GST_USE_UNSTABLE_API to avoid this warning."
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstFieldMetrics GstFieldMetrics;
+
+/**
+ * GstFieldMetricsCombMethod:
+ * @GST_FIELD_METRICS_COMB_32DETECT: 32detect from transcode, via HandBrake
+ * @GST_FIELD_METRICS_COMB_IS_COMBED: isCombed from tritical's IsCombedT
+ * @GST_FIELD_METRICS_COMB_5_TAP: vertical [1,-3,4,-3,1] filter
+ *
+ * How gst_field_metrics_comb_blocks() decides whether a sample is combed.
+ */
+typedef enum {
+  GST_FIELD_METRICS_COMB_32DETECT,
+  GST_FIELD_METRICS_COMB_IS_COMBED,
+  GST_FIELD_METRICS_COMB_5_TAP
+} GstFieldMetricsCombMethod;
+
+GstFieldMetrics *gst_field_metrics_new          (void);
+void             gst_field_metrics_free         (GstFieldMetrics * metrics);
+
+gboolean         gst_field_metrics_set_threads  (GstFieldMetrics * metrics,
+                                                 guint n_threads,
+                                                 GError ** error);
+
+guint64          gst_field_metrics_sad          (GstFieldMetrics * metrics,
+                                                 const guint8 * f1, gint stride1,
+                                                 const guint8 * f2, gint stride2,
+                                                 gint width, gint lines,
+                                                 guint32 noise_floor);
+
+guint64          gst_field_metrics_ssd          (GstFieldMetrics * metrics,
+                                                 const guint8 * f1, gint stride1,
+                                                 const guint8 * f2, gint stride2,
+                                                 gint width, gint lines,
+                                                 guint32 noise_floor);
+
+guint64          gst_field_metrics_3_tap        (GstFieldMetrics * metrics,
+                                                 const guint8 * f1, gint stride1,
+                                                 const guint8 * f2, gint stride2,
+                                                 gint width, gint pstride,
+                                                 gint lines,
+                                                 guint32 noise_floor);
+
+guint64          gst_field_metrics_5_tap        (GstFieldMetrics * metrics,
+                                                 const guint8 * f, gint fstride,
+                                                 const guint8 * o, gint ostride,
+                                                 gint width, gint lines,
+                                                 guint32 noise_floor);
+
+void             gst_field_metrics_comb_blocks  (GstFieldMetrics * metrics,
+                                                 GstFieldMetricsCombMethod method,
+                                                 const guint8 * fj,
+                                                 const guint8 * fjp1,
+                                                 gint line_stride,
+                                                 gint row_stride,
+                                                 gint width, gint pstride,
+                                                 gint block_width,
+                                                 gint block_height,
+                                                 gint64 spatial_thresh,
+                                                 guint n_rows,
+                                                 guint64 * row_scores);
+
+guint64          gst_field_metrics_comb_runs    (GstFieldMetrics * metrics,
+                                                 const guint8 * top,
+                                                 const guint8 * bottom,
+                                                 gint stride,
+                                                 gint width, gint height,
+                                                 guint8 * combed,
+                                                 gint combed_stride);
+
+G_END_DECLS
+
+#endif /* __GST_FIELD_METRICS_H__ */
@@ -1,5 +1,5 @@
 
-/* autogenerated from gstfieldanalysisorc.orc */
+/* autogenerated from gstfieldmetricsorc.orc */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -95,18 +95,18 @@ typedef union
 #ifndef DISABLE_ORC
 #include <orc/orc.h>
 #endif
-void fieldanalysis_orc_same_parity_sad_planar_yuv (guint32 * ORC_RESTRICT a1,
+void field_metrics_orc_same_parity_sad (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     int p1, int n);
-void fieldanalysis_orc_same_parity_ssd_planar_yuv (guint32 * ORC_RESTRICT a1,
+void field_metrics_orc_same_parity_ssd (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     int p1, int n);
-void fieldanalysis_orc_same_parity_3_tap_planar_yuv (guint32 * ORC_RESTRICT a1,
+void field_metrics_orc_same_parity_3_tap (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     const orc_uint8 * ORC_RESTRICT s3, const orc_uint8 * ORC_RESTRICT s4,
     const orc_uint8 * ORC_RESTRICT s5, const orc_uint8 * ORC_RESTRICT s6,
     int p1, int n);
-void fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (guint32 *
+void field_metrics_orc_opposite_parity_5_tap (guint32 *
     ORC_RESTRICT a1, const orc_uint8 * ORC_RESTRICT s1,
     const orc_uint8 * ORC_RESTRICT s2, const orc_uint8 * ORC_RESTRICT s3,
     const orc_uint8 * ORC_RESTRICT s4, const orc_uint8 * ORC_RESTRICT s5,
@@ -157,10 +157,10 @@ void fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (guint32 *
 
 
 
-/* fieldanalysis_orc_same_parity_sad_planar_yuv */
+/* field_metrics_orc_same_parity_sad */
 #ifdef DISABLE_ORC
 void
-fieldanalysis_orc_same_parity_sad_planar_yuv (guint32 * ORC_RESTRICT a1,
+field_metrics_orc_same_parity_sad (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     int p1, int n)
 {
@@ -213,7 +213,7 @@ fieldanalysis_orc_same_parity_sad_planar_yuv (guint32 * ORC_RESTRICT a1,
 
 #else
 static void
-_backup_fieldanalysis_orc_same_parity_sad_planar_yuv (OrcExecutor *
+_backup_field_metrics_orc_same_parity_sad (OrcExecutor *
     ORC_RESTRICT ex)
 {
   int i;
@@ -265,7 +265,7 @@ _backup_fieldanalysis_orc_same_parity_sad_planar_yuv (OrcExecutor *
 }
 
 void
-fieldanalysis_orc_same_parity_sad_planar_yuv (guint32 * ORC_RESTRICT a1,
+field_metrics_orc_same_parity_sad (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     int p1, int n)
 {
@@ -281,22 +281,20 @@ fieldanalysis_orc_same_parity_sad_planar_yuv (guint32 * ORC_RESTRICT a1,
 
 #if 1
       static const orc_uint8 bc[] = {
-        1, 9, 44, 102, 105, 101, 108, 100, 97, 110, 97, 108, 121, 115, 105, 115,
-        95, 111, 114, 99, 95, 115, 97, 109, 101, 95, 112, 97, 114, 105, 116,
-        121,
-        95, 115, 97, 100, 95, 112, 108, 97, 110, 97, 114, 95, 121, 117, 118, 12,
-        1, 1, 12, 1, 1, 13, 4, 16, 4, 20, 2, 20, 2, 20, 4, 20,
-        4, 150, 32, 4, 150, 33, 5, 98, 32, 32, 33, 69, 32, 32, 154, 34,
-        32, 111, 35, 34, 24, 106, 34, 34, 35, 181, 12, 34, 2, 0,
+        1, 9, 33, 102, 105, 101, 108, 100, 95, 109, 101, 116, 114, 105, 99,
+        115, 95, 111, 114, 99, 95, 115, 97, 109, 101, 95, 112, 97, 114, 105,
+        116, 121, 95, 115, 97, 100, 12, 1, 1, 12, 1, 1, 13, 4, 16, 4, 20, 2,
+        20, 2, 20, 4, 20, 4, 150, 32, 4, 150, 33, 5, 98, 32, 32, 33, 69, 32,
+        32, 154, 34, 32, 111, 35, 34, 24, 106, 34, 34, 35, 181, 12, 34, 2, 0,
       };
       p = orc_program_new_from_static_bytecode (bc);
       orc_program_set_backup_function (p,
-          _backup_fieldanalysis_orc_same_parity_sad_planar_yuv);
+          _backup_field_metrics_orc_same_parity_sad);
 #else
       p = orc_program_new ();
-      orc_program_set_name (p, "fieldanalysis_orc_same_parity_sad_planar_yuv");
+      orc_program_set_name (p, "field_metrics_orc_same_parity_sad");
       orc_program_set_backup_function (p,
-          _backup_fieldanalysis_orc_same_parity_sad_planar_yuv);
+          _backup_field_metrics_orc_same_parity_sad);
       orc_program_add_source (p, 1, "s1");
       orc_program_add_source (p, 1, "s2");
       orc_program_add_accumulator (p, 4, "a1");
@@ -346,10 +344,10 @@ fieldanalysis_orc_same_parity_sad_planar_yuv (guint32 * ORC_RESTRICT a1,
 #endif
 
 
-/* fieldanalysis_orc_same_parity_ssd_planar_yuv */
+/* field_metrics_orc_same_parity_ssd */
 #ifdef DISABLE_ORC
 void
-fieldanalysis_orc_same_parity_ssd_planar_yuv (guint32 * ORC_RESTRICT a1,
+field_metrics_orc_same_parity_ssd (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     int p1, int n)
 {
@@ -399,7 +397,7 @@ fieldanalysis_orc_same_parity_ssd_planar_yuv (guint32 * ORC_RESTRICT a1,
 
 #else
 static void
-_backup_fieldanalysis_orc_same_parity_ssd_planar_yuv (OrcExecutor *
+_backup_field_metrics_orc_same_parity_ssd (OrcExecutor *
     ORC_RESTRICT ex)
 {
   int i;
@@ -448,7 +446,7 @@ _backup_fieldanalysis_orc_same_parity_ssd_planar_yuv (OrcExecutor *
 }
 
 void
-fieldanalysis_orc_same_parity_ssd_planar_yuv (guint32 * ORC_RESTRICT a1,
+field_metrics_orc_same_parity_ssd (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     int p1, int n)
 {
@@ -464,23 +462,20 @@ fieldanalysis_orc_same_parity_ssd_planar_yuv (guint32 * ORC_RESTRICT a1,
 
 #if 1
       static const orc_uint8 bc[] = {
-        1, 9, 44, 102, 105, 101, 108, 100, 97, 110, 97, 108, 121, 115, 105, 115,
-        95, 111, 114, 99, 95, 115, 97, 109, 101, 95, 112, 97, 114, 105, 116,
-        121,
-        95, 115, 115, 100, 95, 112, 108, 97, 110, 97, 114, 95, 121, 117, 118,
-        12,
-        1, 1, 12, 1, 1, 13, 4, 16, 4, 20, 2, 20, 2, 20, 4, 20,
-        4, 150, 32, 4, 150, 33, 5, 98, 32, 32, 33, 176, 34, 32, 32, 111,
-        35, 34, 24, 106, 34, 34, 35, 181, 12, 34, 2, 0,
+        1, 9, 33, 102, 105, 101, 108, 100, 95, 109, 101, 116, 114, 105, 99,
+        115, 95, 111, 114, 99, 95, 115, 97, 109, 101, 95, 112, 97, 114, 105,
+        116, 121, 95, 115, 115, 100, 12, 1, 1, 12, 1, 1, 13, 4, 16, 4, 20, 2,
+        20, 2, 20, 4, 20, 4, 150, 32, 4, 150, 33, 5, 98, 32, 32, 33, 176, 34,
+        32, 32, 111, 35, 34, 24, 106, 34, 34, 35, 181, 12, 34, 2, 0,
       };
       p = orc_program_new_from_static_bytecode (bc);
       orc_program_set_backup_function (p,
-          _backup_fieldanalysis_orc_same_parity_ssd_planar_yuv);
+          _backup_field_metrics_orc_same_parity_ssd);
 #else
       p = orc_program_new ();
-      orc_program_set_name (p, "fieldanalysis_orc_same_parity_ssd_planar_yuv");
+      orc_program_set_name (p, "field_metrics_orc_same_parity_ssd");
       orc_program_set_backup_function (p,
-          _backup_fieldanalysis_orc_same_parity_ssd_planar_yuv);
+          _backup_field_metrics_orc_same_parity_ssd);
       orc_program_add_source (p, 1, "s1");
       orc_program_add_source (p, 1, "s2");
       orc_program_add_accumulator (p, 4, "a1");
@@ -528,10 +523,10 @@ fieldanalysis_orc_same_parity_ssd_planar_yuv (guint32 * ORC_RESTRICT a1,
 #endif
 
 
-/* fieldanalysis_orc_same_parity_3_tap_planar_yuv */
+/* field_metrics_orc_same_parity_3_tap */
 #ifdef DISABLE_ORC
 void
-fieldanalysis_orc_same_parity_3_tap_planar_yuv (guint32 * ORC_RESTRICT a1,
+field_metrics_orc_same_parity_3_tap (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     const orc_uint8 * ORC_RESTRICT s3, const orc_uint8 * ORC_RESTRICT s4,
     const orc_uint8 * ORC_RESTRICT s5, const orc_uint8 * ORC_RESTRICT s6,
@@ -636,7 +631,7 @@ fieldanalysis_orc_same_parity_3_tap_planar_yuv (guint32 * ORC_RESTRICT a1,
 
 #else
 static void
-_backup_fieldanalysis_orc_same_parity_3_tap_planar_yuv (OrcExecutor *
+_backup_field_metrics_orc_same_parity_3_tap (OrcExecutor *
     ORC_RESTRICT ex)
 {
   int i;
@@ -738,7 +733,7 @@ _backup_fieldanalysis_orc_same_parity_3_tap_planar_yuv (OrcExecutor *
 }
 
 void
-fieldanalysis_orc_same_parity_3_tap_planar_yuv (guint32 * ORC_RESTRICT a1,
+field_metrics_orc_same_parity_3_tap (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     const orc_uint8 * ORC_RESTRICT s3, const orc_uint8 * ORC_RESTRICT s4,
     const orc_uint8 * ORC_RESTRICT s5, const orc_uint8 * ORC_RESTRICT s6,
@@ -756,27 +751,25 @@ fieldanalysis_orc_same_parity_3_tap_planar_yuv (guint32 * ORC_RESTRICT a1,
 
 #if 1
       static const orc_uint8 bc[] = {
-        1, 9, 46, 102, 105, 101, 108, 100, 97, 110, 97, 108, 121, 115, 105, 115,
-        95, 111, 114, 99, 95, 115, 97, 109, 101, 95, 112, 97, 114, 105, 116,
-        121,
-        95, 51, 95, 116, 97, 112, 95, 112, 108, 97, 110, 97, 114, 95, 121, 117,
-        118, 12, 1, 1, 12, 1, 1, 12, 1, 1, 12, 1, 1, 12, 1, 1,
-        12, 1, 1, 13, 4, 14, 2, 2, 0, 0, 0, 16, 4, 20, 2, 20,
-        2, 20, 2, 20, 2, 20, 2, 20, 2, 20, 4, 20, 4, 150, 32, 4,
-        150, 33, 5, 150, 34, 6, 150, 35, 7, 150, 36, 8, 150, 37, 9, 93,
-        33, 33, 16, 93, 36, 36, 16, 70, 32, 32, 33, 70, 32, 32, 34, 70,
-        35, 35, 36, 70, 35, 35, 37, 98, 32, 32, 35, 69, 32, 32, 154, 38,
-        32, 111, 39, 38, 24, 106, 38, 38, 39, 181, 12, 38, 2, 0,
+        1, 9, 35, 102, 105, 101, 108, 100, 95, 109, 101, 116, 114, 105, 99,
+        115, 95, 111, 114, 99, 95, 115, 97, 109, 101, 95, 112, 97, 114, 105,
+        116, 121, 95, 51, 95, 116, 97, 112, 12, 1, 1, 12, 1, 1, 12, 1, 1, 12,
+        1, 1, 12, 1, 1, 12, 1, 1, 13, 4, 14, 2, 2, 0, 0, 0, 16, 4, 20, 2, 20,
+        2, 20, 2, 20, 2, 20, 2, 20, 2, 20, 4, 20, 4, 150, 32, 4, 150, 33, 5,
+        150, 34, 6, 150, 35, 7, 150, 36, 8, 150, 37, 9, 93, 33, 33, 16, 93, 36,
+        36, 16, 70, 32, 32, 33, 70, 32, 32, 34, 70, 35, 35, 36, 70, 35, 35, 37,
+        98, 32, 32, 35, 69, 32, 32, 154, 38, 32, 111, 39, 38, 24, 106, 38, 38,
+        39, 181, 12, 38, 2, 0,
       };
       p = orc_program_new_from_static_bytecode (bc);
       orc_program_set_backup_function (p,
-          _backup_fieldanalysis_orc_same_parity_3_tap_planar_yuv);
+          _backup_field_metrics_orc_same_parity_3_tap);
 #else
       p = orc_program_new ();
       orc_program_set_name (p,
-          "fieldanalysis_orc_same_parity_3_tap_planar_yuv");
+          "field_metrics_orc_same_parity_3_tap");
       orc_program_set_backup_function (p,
-          _backup_fieldanalysis_orc_same_parity_3_tap_planar_yuv);
+          _backup_field_metrics_orc_same_parity_3_tap);
       orc_program_add_source (p, 1, "s1");
       orc_program_add_source (p, 1, "s2");
       orc_program_add_source (p, 1, "s3");
@@ -859,10 +852,10 @@ fieldanalysis_orc_same_parity_3_tap_planar_yuv (guint32 * ORC_RESTRICT a1,
 #endif
 
 
-/* fieldanalysis_orc_opposite_parity_5_tap_planar_yuv */
+/* field_metrics_orc_opposite_parity_5_tap */
 #ifdef DISABLE_ORC
 void
-fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (guint32 * ORC_RESTRICT a1,
+field_metrics_orc_opposite_parity_5_tap (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     const orc_uint8 * ORC_RESTRICT s3, const orc_uint8 * ORC_RESTRICT s4,
     const orc_uint8 * ORC_RESTRICT s5, int p1, int n)
@@ -965,7 +958,7 @@ fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (guint32 * ORC_RESTRICT a1,
 
 #else
 static void
-_backup_fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (OrcExecutor *
+_backup_field_metrics_orc_opposite_parity_5_tap (OrcExecutor *
     ORC_RESTRICT ex)
 {
   int i;
@@ -1066,7 +1059,7 @@ _backup_fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (OrcExecutor *
 }
 
 void
-fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (guint32 * ORC_RESTRICT a1,
+field_metrics_orc_opposite_parity_5_tap (guint32 * ORC_RESTRICT a1,
     const orc_uint8 * ORC_RESTRICT s1, const orc_uint8 * ORC_RESTRICT s2,
     const orc_uint8 * ORC_RESTRICT s3, const orc_uint8 * ORC_RESTRICT s4,
     const orc_uint8 * ORC_RESTRICT s5, int p1, int n)
@@ -1083,28 +1076,25 @@ fieldanalysis_orc_opposite_parity_5_tap_planar_yuv (guint32 * ORC_RESTRICT a1,
 
 #if 1
       static const orc_uint8 bc[] = {
-        1, 9, 50, 102, 105, 101, 108, 100, 97, 110, 97, 108, 121, 115, 105, 115,
-        95, 111, 114, 99, 95, 111, 112, 112, 111, 115, 105, 116, 101, 95, 112,
-        97,
-        114, 105, 116, 121, 95, 53, 95, 116, 97, 112, 95, 112, 108, 97, 110, 97,
-        114, 95, 121, 117, 118, 12, 1, 1, 12, 1, 1, 12, 1, 1, 12, 1,
-        1, 12, 1, 1, 13, 4, 14, 2, 2, 0, 0, 0, 14, 2, 3, 0,
-        0, 0, 16, 4, 20, 2, 20, 2, 20, 2, 20, 2, 20, 2, 20, 4,
-        20, 4, 150, 32, 4, 150, 33, 5, 150, 34, 6, 150, 35, 7, 150, 36,
-        8, 93, 34, 34, 16, 89, 33, 33, 17, 89, 35, 35, 17, 98, 32, 32,
-        33, 70, 32, 32, 34, 98, 32, 32, 35, 70, 32, 32, 36, 69, 32, 32,
-        154, 37, 32, 111, 38, 37, 24, 106, 37, 37, 38, 181, 12, 37, 2, 0,
-
+        1, 9, 39, 102, 105, 101, 108, 100, 95, 109, 101, 116, 114, 105, 99,
+        115, 95, 111, 114, 99, 95, 111, 112, 112, 111, 115, 105, 116, 101, 95,
+        112, 97, 114, 105, 116, 121, 95, 53, 95, 116, 97, 112, 12, 1, 1, 12, 1,
+        1, 12, 1, 1, 12, 1, 1, 12, 1, 1, 13, 4, 14, 2, 2, 0, 0, 0, 14, 2, 3, 0,
+        0, 0, 16, 4, 20, 2, 20, 2, 20, 2, 20, 2, 20, 2, 20, 4, 20, 4, 150, 32,
+        4, 150, 33, 5, 150, 34, 6, 150, 35, 7, 150, 36, 8, 93, 34, 34, 16, 89,
+        33, 33, 17, 89, 35, 35, 17, 98, 32, 32, 33, 70, 32, 32, 34, 98, 32, 32,
+        35, 70, 32, 32, 36, 69, 32, 32, 154, 37, 32, 111, 38, 37, 24, 106, 37,
+        37, 38, 181, 12, 37, 2, 0,
       };
       p = orc_program_new_from_static_bytecode (bc);
       orc_program_set_backup_function (p,
-          _backup_fieldanalysis_orc_opposite_parity_5_tap_planar_yuv);
+          _backup_field_metrics_orc_opposite_parity_5_tap);
 #else
       p = orc_program_new ();
       orc_program_set_name (p,
-          "fieldanalysis_orc_opposite_parity_5_tap_planar_yuv");
+          "field_metrics_orc_opposite_parity_5_tap");
       orc_program_set_backup_function (p,
-          _backup_fieldanalysis_orc_opposite_parity_5_tap_planar_yuv);
+          _backup_field_metrics_orc_opposite_parity_5_tap);
       orc_program_add_source (p, 1, "s1");
       orc_program_add_source (p, 1, "s2");
       orc_program_add_source (p, 1, "s3");
@@ -28,7 +28,10 @@
  * 
  * It also provides several background shading effects. These effects are
  * applied to a previous picture before the render() implementation can draw a
- * new frame.
+ * new frame. The previous picture is the last pushed buffer, which the base
+ * class keeps a reference to while a shader is set, so in-place elements
+ * right after a visualizer will have to copy the frames unless the shader is
+ * "none".
  */
 
 #ifdef HAVE_CONFIG_H
@@ -42,18 +45,26 @@
 #include <gst/video/gstvideopool.h>
 
 #include "gstaudiovisualizer.h"
+#include "gstaudiovisualizerorc.h"
+
+#include <gst/base/gstbandrunner.h>
 
 GST_DEBUG_CATEGORY_STATIC (audio_visualizer_debug);
 #define GST_CAT_DEFAULT (audio_visualizer_debug)
 
 #define DEFAULT_SHADER GST_AUDIO_VISUALIZER_SHADER_FADE
 #define DEFAULT_SHADE_AMOUNT   0x000a0a0a
+#define DEFAULT_N_THREADS 1
+
+/* frames smaller than this are not split into bands */
+#define MIN_BAND_PIXELS (128 * 1024)
 
 enum
 {
   PROP_0,
   PROP_SHADER,
-  PROP_SHADE_AMOUNT
+  PROP_SHADE_AMOUNT,
+  PROP_N_THREADS
 };
 
 static GstBaseTransformClass *parent_class = NULL;
@@ -116,8 +127,12 @@ struct _GstAudioVisualizerPrivate
   GstAdapter *adapter;
 
   GstBuffer *inbuf;
-  GstBuffer *tempbuf;
-  GstVideoFrame tempframe;
+  /* previous output frame, shaded into the next one */
+  GstBuffer *prevbuf;
+
+  /* row bands rendered in parallel, see gst_audio_visualizer_run_bands() */
+  guint n_threads;
+  GstBandRunner *runner;
 
   guint spf;                    /* samples per video frame */
   guint64 frame_duration;
@@ -176,327 +191,186 @@ gst_audio_visualizer_shader_get_type (void)
 }
 
 /* we're only supporting GST_VIDEO_FORMAT_xRGB right now) */
-#if G_BYTE_ORDER == G_LITTLE_ENDIAN
-
-#define SHADE(_d, _s, _i, _r, _g, _b)                     \
-G_STMT_START {                                            \
-    _d[_i * 4 + 0] = (_s[_i * 4 + 0] > _b) ? _s[_i * 4 + 0] - _b : 0; \
-    _d[_i * 4 + 1] = (_s[_i * 4 + 1] > _g) ? _s[_i * 4 + 1] - _g : 0; \
-    _d[_i * 4 + 2] = (_s[_i * 4 + 2] > _r) ? _s[_i * 4 + 2] - _r : 0; \
-    _d[_i * 4 + 3] = 0;                                       \
-} G_STMT_END
-
-#else /* G_BYTE_ORDER == G_LITTLE_ENDIAN */
-
-#define SHADE(_d, _s, _i, _r, _g, _b)                     \
-G_STMT_START {                                            \
-    _d[_i * 4 + 0] = 0;                                       \
-    _d[_i * 4 + 1] = (_s[_i * 4 + 1] > _r) ? _s[_i * 4 + 1] - _r : 0; \
-    _d[_i * 4 + 2] = (_s[_i * 4 + 2] > _g) ? _s[_i * 4 + 2] - _g : 0; \
-    _d[_i * 4 + 3] = (_s[_i * 4 + 3] > _b) ? _s[_i * 4 + 3] - _b : 0; \
-} G_STMT_END
-
-#endif
 
+/* shades @n_rows rows of @width pixels from (@sx, @sy) in @sframe to
+ * (@dx, @dy) in @dframe, the x byte of the output is always 0 */
 static void
-shader_fade (GstAudioVisualizer * scope, const GstVideoFrame * sframe,
-    GstVideoFrame * dframe)
+shade_rows (GstAudioVisualizer * scope, const GstVideoFrame * sframe, gint sy,
+    gint sx, GstVideoFrame * dframe, gint dy, gint dx, gint width, gint n_rows)
 {
-  guint i, j;
   guint32 shade_amount = scope->priv->shade_amount;
-  guint r = (shade_amount >> 16) & 0xff;
-  guint g = (shade_amount >> 8) & 0xff;
-  guint b = (shade_amount >> 0) & 0xff;
-  guint8 *s, *d;
-  gint ss, ds, width, height;
+  const guint8 *s;
+  guint8 *d;
+  gint ss, ds;
+
+  if (width <= 0 || n_rows <= 0)
+    return;
 
-  s = GST_VIDEO_FRAME_PLANE_DATA (sframe, 0);
   ss = GST_VIDEO_FRAME_PLANE_STRIDE (sframe, 0);
-  d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
   ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
+  s = (const guint8 *) GST_VIDEO_FRAME_PLANE_DATA (sframe, 0) + sy * ss +
+      sx * 4;
+  d = (guint8 *) GST_VIDEO_FRAME_PLANE_DATA (dframe, 0) + dy * ds + dx * 4;
+
+  /* saturating subtraction of 0xffRRGGBB in native endianness, which is the
+   * pixel layout of both BGRx on little and xRGB on big endian machines */
+  audiovisualizer_orc_shade (d, ds, s, ss,
+      0xff000000 | (shade_amount & 0x00ffffff), width, n_rows);
+}
 
-  width = GST_VIDEO_FRAME_WIDTH (sframe);
-  height = GST_VIDEO_FRAME_HEIGHT (sframe);
+static void
+clear_rows (GstVideoFrame * dframe, gint y, gint n_rows)
+{
+  guint8 *d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
+  gint ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
+  gint width = GST_VIDEO_FRAME_WIDTH (dframe);
 
-  for (j = 0; j < height; j++) {
-    for (i = 0; i < width; i++) {
-      SHADE (d, s, i, r, g, b);
-    }
-    s += ss;
-    d += ds;
-  }
+  for (d += y * ds; n_rows > 0; n_rows--, d += ds)
+    memset (d, 0, width * 4);
 }
 
 static void
-shader_fade_and_move_up (GstAudioVisualizer * scope,
-    const GstVideoFrame * sframe, GstVideoFrame * dframe)
+clear_column (GstVideoFrame * dframe, gint x, gint y0, gint y1)
 {
-  guint i, j;
-  guint32 shade_amount = scope->priv->shade_amount;
-  guint r = (shade_amount >> 16) & 0xff;
-  guint g = (shade_amount >> 8) & 0xff;
-  guint b = (shade_amount >> 0) & 0xff;
-  guint8 *s, *d;
-  gint ss, ds, width, height;
+  guint8 *d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
+  gint ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
 
-  s = GST_VIDEO_FRAME_PLANE_DATA (sframe, 0);
-  ss = GST_VIDEO_FRAME_PLANE_STRIDE (sframe, 0);
-  d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
-  ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
+  for (d += y0 * ds + x * 4; y0 < y1; y0++, d += ds)
+    GST_WRITE_UINT32_LE (d, 0);
+}
 
-  width = GST_VIDEO_FRAME_WIDTH (sframe);
-  height = GST_VIDEO_FRAME_HEIGHT (sframe);
+/* The shaders fill rows [@y0, @y1) of @dframe from the previous frame in
+ * @sframe, pixels that are not moved there are cleared. */
 
-  for (j = 1; j < height; j++) {
-    s += ss;
-    for (i = 0; i < width; i++) {
-      SHADE (d, s, i, r, g, b);
-    }
-    d += ds;
-  }
+static void
+shader_fade (GstAudioVisualizer * scope, const GstVideoFrame * sframe,
+    GstVideoFrame * dframe, gint y0, gint y1)
+{
+  gint width = GST_VIDEO_FRAME_WIDTH (dframe);
+
+  shade_rows (scope, sframe, y0, 0, dframe, y0, 0, width, y1 - y0);
 }
 
 static void
-shader_fade_and_move_down (GstAudioVisualizer * scope,
-    const GstVideoFrame * sframe, GstVideoFrame * dframe)
+shader_fade_and_move_up (GstAudioVisualizer * scope,
+    const GstVideoFrame * sframe, GstVideoFrame * dframe, gint y0, gint y1)
 {
-  guint i, j;
-  guint32 shade_amount = scope->priv->shade_amount;
-  guint r = (shade_amount >> 16) & 0xff;
-  guint g = (shade_amount >> 8) & 0xff;
-  guint b = (shade_amount >> 0) & 0xff;
-  guint8 *s, *d;
-  gint ss, ds, width, height;
+  gint width = GST_VIDEO_FRAME_WIDTH (dframe);
+  gint height = GST_VIDEO_FRAME_HEIGHT (dframe);
+  gint end = MIN (y1, height - 1);
 
-  s = GST_VIDEO_FRAME_PLANE_DATA (sframe, 0);
-  ss = GST_VIDEO_FRAME_PLANE_STRIDE (sframe, 0);
-  d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
-  ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
+  shade_rows (scope, sframe, y0 + 1, 0, dframe, y0, 0, width, end - y0);
+  if (y1 == height)
+    clear_rows (dframe, height - 1, 1);
+}
 
-  width = GST_VIDEO_FRAME_WIDTH (sframe);
-  height = GST_VIDEO_FRAME_HEIGHT (sframe);
+static void
+shader_fade_and_move_down (GstAudioVisualizer * scope,
+    const GstVideoFrame * sframe, GstVideoFrame * dframe, gint y0, gint y1)
+{
+  gint width = GST_VIDEO_FRAME_WIDTH (dframe);
+  gint start = MAX (y0, 1);
 
-  for (j = 1; j < height; j++) {
-    d += ds;
-    for (i = 0; i < width; i++) {
-      SHADE (d, s, i, r, g, b);
-    }
-    s += ss;
-  }
+  if (y0 == 0)
+    clear_rows (dframe, 0, 1);
+  shade_rows (scope, sframe, start - 1, 0, dframe, start, 0, width,
+      y1 - start);
 }
 
 static void
 shader_fade_and_move_left (GstAudioVisualizer * scope,
-    const GstVideoFrame * sframe, GstVideoFrame * dframe)
+    const GstVideoFrame * sframe, GstVideoFrame * dframe, gint y0, gint y1)
 {
-  guint i, j;
-  guint32 shade_amount = scope->priv->shade_amount;
-  guint r = (shade_amount >> 16) & 0xff;
-  guint g = (shade_amount >> 8) & 0xff;
-  guint b = (shade_amount >> 0) & 0xff;
-  guint8 *s, *d;
-  gint ss, ds, width, height;
-
-  s = GST_VIDEO_FRAME_PLANE_DATA (sframe, 0);
-  ss = GST_VIDEO_FRAME_PLANE_STRIDE (sframe, 0);
-  d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
-  ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
+  gint width = GST_VIDEO_FRAME_WIDTH (dframe);
 
-  width = GST_VIDEO_FRAME_WIDTH (sframe);
-  height = GST_VIDEO_FRAME_HEIGHT (sframe);
-
-  width -= 1;
-  s += 4;
-
-  /* move to the left */
-  for (j = 0; j < height; j++) {
-    for (i = 0; i < width; i++) {
-      SHADE (d, s, i, r, g, b);
-    }
-    d += ds;
-    s += ss;
-  }
+  shade_rows (scope, sframe, y0, 1, dframe, y0, 0, width - 1, y1 - y0);
+  clear_column (dframe, width - 1, y0, y1);
 }
 
 static void
 shader_fade_and_move_right (GstAudioVisualizer * scope,
-    const GstVideoFrame * sframe, GstVideoFrame * dframe)
+    const GstVideoFrame * sframe, GstVideoFrame * dframe, gint y0, gint y1)
 {
-  guint i, j;
-  guint32 shade_amount = scope->priv->shade_amount;
-  guint r = (shade_amount >> 16) & 0xff;
-  guint g = (shade_amount >> 8) & 0xff;
-  guint b = (shade_amount >> 0) & 0xff;
-  guint8 *s, *d;
-  gint ss, ds, width, height;
-
-  s = GST_VIDEO_FRAME_PLANE_DATA (sframe, 0);
-  ss = GST_VIDEO_FRAME_PLANE_STRIDE (sframe, 0);
-  d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
-  ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
+  gint width = GST_VIDEO_FRAME_WIDTH (dframe);
 
-  width = GST_VIDEO_FRAME_WIDTH (sframe);
-  height = GST_VIDEO_FRAME_HEIGHT (sframe);
-
-  width -= 1;
-  d += 4;
-
-  /* move to the right */
-  for (j = 0; j < height; j++) {
-    for (i = 0; i < width; i++) {
-      SHADE (d, s, i, r, g, b);
-    }
-    d += ds;
-    s += ss;
-  }
+  clear_column (dframe, 0, y0, y1);
+  shade_rows (scope, sframe, y0, 0, dframe, y0, 1, width - 1, y1 - y0);
 }
 
 static void
 shader_fade_and_move_horiz_out (GstAudioVisualizer * scope,
-    const GstVideoFrame * sframe, GstVideoFrame * dframe)
+    const GstVideoFrame * sframe, GstVideoFrame * dframe, gint y0, gint y1)
 {
-  guint i, j;
-  guint32 shade_amount = scope->priv->shade_amount;
-  guint r = (shade_amount >> 16) & 0xff;
-  guint g = (shade_amount >> 8) & 0xff;
-  guint b = (shade_amount >> 0) & 0xff;
-  guint8 *s, *d;
-  gint ss, ds, width, height;
-
-  s = GST_VIDEO_FRAME_PLANE_DATA (sframe, 0);
-  ss = GST_VIDEO_FRAME_PLANE_STRIDE (sframe, 0);
-  d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
-  ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
-
-  width = GST_VIDEO_FRAME_WIDTH (sframe);
-  height = GST_VIDEO_FRAME_HEIGHT (sframe);
+  gint width = GST_VIDEO_FRAME_WIDTH (dframe);
+  gint mid = GST_VIDEO_FRAME_HEIGHT (dframe) / 2;
+  gint start, end;
 
   /* move upper half up */
-  for (j = 0; j < height / 2; j++) {
-    s += ss;
-    for (i = 0; i < width; i++) {
-      SHADE (d, s, i, r, g, b);
-    }
-    d += ds;
-  }
+  end = MIN (y1, mid);
+  shade_rows (scope, sframe, y0 + 1, 0, dframe, y0, 0, width, end - y0);
+  if (y0 <= mid && mid < y1)
+    clear_rows (dframe, mid, 1);
   /* move lower half down */
-  for (j = 0; j < height / 2; j++) {
-    d += ds;
-    for (i = 0; i < width; i++) {
-      SHADE (d, s, i, r, g, b);
-    }
-    s += ss;
-  }
+  start = MAX (y0, mid + 1);
+  shade_rows (scope, sframe, start - 1, 0, dframe, start, 0, width,
+      y1 - start);
 }
 
 static void
 shader_fade_and_move_horiz_in (GstAudioVisualizer * scope,
-    const GstVideoFrame * sframe, GstVideoFrame * dframe)
+    const GstVideoFrame * sframe, GstVideoFrame * dframe, gint y0, gint y1)
 {
-  guint i, j;
-  guint32 shade_amount = scope->priv->shade_amount;
-  guint r = (shade_amount >> 16) & 0xff;
-  guint g = (shade_amount >> 8) & 0xff;
-  guint b = (shade_amount >> 0) & 0xff;
-  guint8 *s, *d;
-  gint ss, ds, width, height;
-
-  s = GST_VIDEO_FRAME_PLANE_DATA (sframe, 0);
-  ss = GST_VIDEO_FRAME_PLANE_STRIDE (sframe, 0);
-  d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
-  ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
-
-  width = GST_VIDEO_FRAME_WIDTH (sframe);
-  height = GST_VIDEO_FRAME_HEIGHT (sframe);
+  gint width = GST_VIDEO_FRAME_WIDTH (dframe);
+  gint height = GST_VIDEO_FRAME_HEIGHT (dframe);
+  gint mid = height / 2;
+  gint start, end;
 
+  if (y0 == 0)
+    clear_rows (dframe, 0, 1);
   /* move upper half down */
-  for (j = 0; j < height / 2; j++) {
-    d += ds;
-    for (i = 0; i < width; i++) {
-      SHADE (d, s, i, r, g, b);
-    }
-    s += ss;
-  }
+  start = MAX (y0, 1);
+  end = MIN (y1, mid);
+  shade_rows (scope, sframe, start - 1, 0, dframe, start, 0, width,
+      end - start);
   /* move lower half up */
-  for (j = 0; j < height / 2; j++) {
-    s += ss;
-    for (i = 0; i < width; i++) {
-      SHADE (d, s, i, r, g, b);
-    }
-    d += ds;
-  }
+  start = MAX (y0, mid);
+  end = MIN (y1, height - 1);
+  shade_rows (scope, sframe, start + 1, 0, dframe, start, 0, width,
+      end - start);
+  if (y1 == height && height > 1)
+    clear_rows (dframe, height - 1, 1);
 }
 
 static void
 shader_fade_and_move_vert_out (GstAudioVisualizer * scope,
-    const GstVideoFrame * sframe, GstVideoFrame * dframe)
+    const GstVideoFrame * sframe, GstVideoFrame * dframe, gint y0, gint y1)
 {
-  guint i, j;
-  guint32 shade_amount = scope->priv->shade_amount;
-  guint r = (shade_amount >> 16) & 0xff;
-  guint g = (shade_amount >> 8) & 0xff;
-  guint b = (shade_amount >> 0) & 0xff;
-  guint8 *s, *s1, *d, *d1;
-  gint ss, ds, width, height;
-
-  s = GST_VIDEO_FRAME_PLANE_DATA (sframe, 0);
-  ss = GST_VIDEO_FRAME_PLANE_STRIDE (sframe, 0);
-  d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
-  ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
-
-  width = GST_VIDEO_FRAME_WIDTH (sframe);
-  height = GST_VIDEO_FRAME_HEIGHT (sframe);
-
-  for (j = 0; j < height; j++) {
-    /* move left half to the left */
-    s1 = s + 1;
-    for (i = 0; i < width / 2; i++) {
-      SHADE (d, s1, i, r, g, b);
-    }
-    /* move right half to the right */
-    d1 = d + 1;
-    for (; i < width - 1; i++) {
-      SHADE (d1, s, i, r, g, b);
-    }
-    s += ss;
-    d += ds;
-  }
+  gint width = GST_VIDEO_FRAME_WIDTH (dframe);
+  gint mid = width / 2;
+
+  /* move left half to the left */
+  shade_rows (scope, sframe, y0, 1, dframe, y0, 0, mid, y1 - y0);
+  clear_column (dframe, mid, y0, y1);
+  /* move right half to the right */
+  shade_rows (scope, sframe, y0, mid, dframe, y0, mid + 1, width - 1 - mid,
+      y1 - y0);
 }
 
 static void
 shader_fade_and_move_vert_in (GstAudioVisualizer * scope,
-    const GstVideoFrame * sframe, GstVideoFrame * dframe)
+    const GstVideoFrame * sframe, GstVideoFrame * dframe, gint y0, gint y1)
 {
-  guint i, j;
-  guint32 shade_amount = scope->priv->shade_amount;
-  guint r = (shade_amount >> 16) & 0xff;
-  guint g = (shade_amount >> 8) & 0xff;
-  guint b = (shade_amount >> 0) & 0xff;
-  guint8 *s, *s1, *d, *d1;
-  gint ss, ds, width, height;
-
-  s = GST_VIDEO_FRAME_PLANE_DATA (sframe, 0);
-  ss = GST_VIDEO_FRAME_PLANE_STRIDE (sframe, 0);
-  d = GST_VIDEO_FRAME_PLANE_DATA (dframe, 0);
-  ds = GST_VIDEO_FRAME_PLANE_STRIDE (dframe, 0);
-
-  width = GST_VIDEO_FRAME_WIDTH (sframe);
-  height = GST_VIDEO_FRAME_HEIGHT (sframe);
-
-  for (j = 0; j < height; j++) {
-    /* move left half to the right */
-    d1 = d + 1;
-    for (i = 0; i < width / 2; i++) {
-      SHADE (d1, s, i, r, g, b);
-    }
-    /* move right half to the left */
-    s1 = s + 1;
-    for (; i < width - 1; i++) {
-      SHADE (d, s1, i, r, g, b);
-    }
-    s += ss;
-    d += ds;
-  }
+  gint width = GST_VIDEO_FRAME_WIDTH (dframe);
+  gint mid = width / 2;
+
+  clear_column (dframe, 0, y0, y1);
+  /* move left half to the right */
+  shade_rows (scope, sframe, y0, 0, dframe, y0, 1, mid - 1, y1 - y0);
+  /* move right half to the left */
+  shade_rows (scope, sframe, y0, mid + 1, dframe, y0, mid, width - 1 - mid,
+      y1 - y0);
+  if (width > 1)
+    clear_column (dframe, width - 1, y0, y1);
 }
 
 static void
@@ -544,6 +418,100 @@ gst_audio_visualizer_change_shader (GstAudioVisualizer * scope)
   scope->priv->shader = shader;
 }
 
+/* row bands */
+
+typedef struct
+{
+  GstAudioVisualizer *scope;
+  GstAudioVisualizerBandFunc func;
+  gpointer user_data;
+  gint height;
+} GstAudioVisualizerBands;
+
+static void
+gst_audio_visualizer_band_func (guint band, guint n_bands, gpointer user_data)
+{
+  GstAudioVisualizerBands *bands = user_data;
+  gint y0 = bands->height * band / n_bands;
+  gint y1 = bands->height * (band + 1) / n_bands;
+
+  bands->func (bands->scope, y0, y1, bands->user_data);
+}
+
+static gboolean
+gst_audio_visualizer_threads_start (GstAudioVisualizer * scope)
+{
+  GstAudioVisualizerPrivate *priv = scope->priv;
+  GError *err = NULL;
+
+  if (!gst_band_runner_set_threads (priv->runner, priv->n_threads, &err)) {
+    GST_ELEMENT_ERROR (scope, RESOURCE, FAILED, (NULL),
+        ("Failed to create thread pool: %s", err->message));
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (scope, "rendering with %u threads",
+      gst_band_runner_get_n_threads (priv->runner));
+
+  return TRUE;
+}
+
+/**
+ * gst_audio_visualizer_run_bands:
+ * @scope: the visualizer
+ * @func: function rendering a band of rows
+ * @user_data: data passed to @func
+ *
+ * Splits the rows of the output frame into bands and calls @func for each of
+ * them, from the configured number of threads if the frame is big enough.
+ * Returns when all bands are done, so @user_data can live on the stack.
+ */
+void
+gst_audio_visualizer_run_bands (GstAudioVisualizer * scope,
+    GstAudioVisualizerBandFunc func, gpointer user_data)
+{
+  GstAudioVisualizerPrivate *priv = scope->priv;
+  GstAudioVisualizerBands bands;
+  gint width = GST_VIDEO_INFO_WIDTH (&scope->vinfo);
+  gint height = GST_VIDEO_INFO_HEIGHT (&scope->vinfo);
+  gint n_bands;
+
+  n_bands = gst_band_runner_get_n_threads (priv->runner);
+  /* don't wake up threads for small frames */
+  n_bands = MIN (n_bands,
+      (gint) ((gint64) width * height / MIN_BAND_PIXELS));
+  n_bands = MIN (n_bands, height);
+
+  if (n_bands <= 1) {
+    func (scope, 0, height, user_data);
+    return;
+  }
+
+  bands.scope = scope;
+  bands.func = func;
+  bands.user_data = user_data;
+  bands.height = height;
+  gst_band_runner_run (priv->runner, n_bands, gst_audio_visualizer_band_func,
+      &bands);
+}
+
+typedef struct
+{
+  GstAudioVisualizerShaderFunc shader;
+  const GstVideoFrame *sframe;
+  GstVideoFrame *dframe;
+} GstAudioVisualizerShade;
+
+static void
+gst_audio_visualizer_shade_band (GstAudioVisualizer * scope, gint y0, gint y1,
+    gpointer user_data)
+{
+  GstAudioVisualizerShade *shade = user_data;
+
+  shade->shader (scope, shade->sframe, shade->dframe, y0, y1);
+}
+
 /* base class */
 
 GType
@@ -606,6 +574,12 @@ gst_audio_visualizer_class_init (GstAudioVisualizerClass * klass)
           "Shading color to use (big-endian ARGB)", 0, G_MAXUINT32,
           DEFAULT_SHADE_AMOUNT,
           G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to render each frame with, 0 for the number of "
+          "processors (takes effect on the next start)",
+          0, G_MAXUINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -644,6 +618,8 @@ gst_audio_visualizer_init (GstAudioVisualizer * scope,
   scope->priv->shader_type = DEFAULT_SHADER;
   gst_audio_visualizer_change_shader (scope);
   scope->priv->shade_amount = DEFAULT_SHADE_AMOUNT;
+  scope->priv->n_threads = DEFAULT_N_THREADS;
+  scope->priv->runner = gst_band_runner_new ();
 
   /* reset the initial video state */
   gst_video_info_init (&scope->vinfo);
@@ -670,6 +646,9 @@ gst_audio_visualizer_set_property (GObject * object, guint prop_id,
     case PROP_SHADE_AMOUNT:
       scope->priv->shade_amount = g_value_get_uint (value);
       break;
+    case PROP_N_THREADS:
+      scope->priv->n_threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -689,6 +668,9 @@ gst_audio_visualizer_get_property (GObject * object, guint prop_id,
     case PROP_SHADE_AMOUNT:
       g_value_set_uint (value, scope->priv->shade_amount);
       break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, scope->priv->n_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -709,11 +691,8 @@ gst_audio_visualizer_finalize (GObject * object)
     gst_buffer_unref (priv->inbuf);
     priv->inbuf = NULL;
   }
-  if (priv->tempbuf) {
-    gst_video_frame_unmap (&priv->tempframe);
-    gst_buffer_unref (priv->tempbuf);
-    priv->tempbuf = NULL;
-  }
+  gst_buffer_replace (&priv->prevbuf, NULL);
+  gst_band_runner_free (priv->runner);
 
   g_mutex_clear (&priv->config_lock);
 
@@ -791,14 +770,8 @@ gst_audio_visualizer_src_setcaps (GstAudioVisualizer * scope, GstCaps * caps)
       GST_VIDEO_INFO_FPS_D (&info), GST_VIDEO_INFO_FPS_N (&info));
   scope->req_spf = priv->spf;
 
-  if (priv->tempbuf) {
-    gst_video_frame_unmap (&priv->tempframe);
-    gst_buffer_unref (priv->tempbuf);
-  }
-  priv->tempbuf = gst_buffer_new_wrapped (g_malloc0 (scope->vinfo.size),
-      scope->vinfo.size);
-  gst_video_frame_map (&priv->tempframe, &scope->vinfo, priv->tempbuf,
-      GST_MAP_READWRITE);
+  /* the previous frame doesn't fit the new format anymore */
+  gst_buffer_replace (&priv->prevbuf, NULL);
 
   if (klass->setup && !klass->setup (scope))
     goto setup_failed;
@@ -1020,6 +993,11 @@ default_decide_allocation (GstAudioVisualizer * scope, GstQuery * query)
     update_pool = FALSE;
   }
 
+  /* the previous frame is kept around for the shader */
+  min += 1;
+  if (max != 0)
+    max += 1;
+
   if (pool == NULL) {
     /* we did not get a pool, make one ourselves then */
     pool = gst_video_buffer_pool_new ();
@@ -1137,7 +1115,8 @@ gst_audio_visualizer_chain (GstPad * pad, GstObject * parent,
   GST_LOG_OBJECT (scope, "avail: %u, bpf: %u", avail, sbpf);
   while (avail >= sbpf) {
     GstBuffer *outbuf;
-    GstVideoFrame outframe;
+    GstVideoFrame outframe, prevframe;
+    GstAudioVisualizerShaderFunc shader;
 
     /* get timestamp of the current adapter content */
     ts = gst_adapter_prev_pts (priv->adapter, &dist);
@@ -1210,8 +1189,21 @@ gst_audio_visualizer_chain (GstPad * pad, GstObject * parent,
 
     gst_video_frame_map (&outframe, &scope->vinfo, outbuf, GST_MAP_READWRITE);
 
-    if (priv->shader) {
-      gst_video_frame_copy (&outframe, &priv->tempframe);
+    /* FIXME: SHADER assumes 32bpp */
+    shader = priv->shader;
+    if (GST_VIDEO_INFO_COMP_PSTRIDE (&scope->vinfo, 0) != 4)
+      shader = NULL;
+
+    /* shade the previous frame straight into the new one, this replaces
+     * copying it over and shading it after rendering */
+    if (shader && priv->prevbuf &&
+        gst_video_frame_map (&prevframe, &scope->vinfo, priv->prevbuf,
+            GST_MAP_READ)) {
+      GstAudioVisualizerShade shade = { shader, &prevframe, &outframe };
+
+      gst_audio_visualizer_run_bands (scope, gst_audio_visualizer_shade_band,
+          &shade);
+      gst_video_frame_unmap (&prevframe);
     } else {
       /* gst_video_frame_clear() or is output frame already cleared */
       gint i;
@@ -1231,16 +1223,17 @@ gst_audio_visualizer_chain (GstPad * pad, GstObject * parent,
         ret = GST_FLOW_ERROR;
         gst_video_frame_unmap (&outframe);
         goto beach;
-      } else {
-        /* run various post processing (shading and geometric transformation) */
-        /* FIXME: SHADER assumes 32bpp */
-        if (priv->shader && GST_VIDEO_INFO_COMP_PSTRIDE (&scope->vinfo, 0) == 4) {
-          priv->shader (scope, &outframe, &priv->tempframe);
-        }
       }
     }
     gst_video_frame_unmap (&outframe);
 
+    /* keep the frame for shading the next one. The extra ref makes the pushed
+     * buffer non-writable, so an in-place element downstream copies it in
+     * gst_buffer_make_writable(). That is the same copy as keeping a private
+     * copy here, which read-only consumers like encoders and sinks would pay
+     * for nothing. */
+    gst_buffer_replace (&priv->prevbuf, shader ? outbuf : NULL);
+
     g_mutex_unlock (&priv->config_lock);
     ret = gst_pad_push (priv->srcpad, outbuf);
     outbuf = NULL;
@@ -1438,6 +1431,8 @@ gst_audio_visualizer_change_state (GstElement * element,
   switch (transition) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
       gst_audio_visualizer_reset (scope);
+      if (!gst_audio_visualizer_threads_start (scope))
+        return GST_STATE_CHANGE_FAILURE;
       break;
     default:
       break;
@@ -1447,7 +1442,9 @@ gst_audio_visualizer_change_state (GstElement * element,
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_buffer_replace (&scope->priv->prevbuf, NULL);
       gst_audio_visualizer_set_allocation (scope, NULL, NULL, NULL, NULL);
+      gst_band_runner_set_threads (scope->priv->runner, 1, NULL);
       break;
     case GST_STATE_CHANGE_READY_TO_NULL:
       break;
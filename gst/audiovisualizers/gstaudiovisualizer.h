@@ -43,7 +43,8 @@ typedef struct _GstAudioVisualizer GstAudioVisualizer;
 typedef struct _GstAudioVisualizerClass GstAudioVisualizerClass;
 typedef struct _GstAudioVisualizerPrivate GstAudioVisualizerPrivate;
 
-typedef void (*GstAudioVisualizerShaderFunc)(GstAudioVisualizer *scope, const GstVideoFrame *s, GstVideoFrame *d);
+typedef void (*GstAudioVisualizerShaderFunc)(GstAudioVisualizer *scope, const GstVideoFrame *s, GstVideoFrame *d, gint y0, gint y1);
+typedef void (*GstAudioVisualizerBandFunc)(GstAudioVisualizer *scope, gint y0, gint y1, gpointer user_data);
 
 /**
  * GstAudioVisualizerShader:
@@ -104,5 +105,7 @@ struct _GstAudioVisualizerClass
 
 GType gst_audio_visualizer_get_type (void);
 
+void gst_audio_visualizer_run_bands (GstAudioVisualizer * scope, GstAudioVisualizerBandFunc func, gpointer user_data);
+
 G_END_DECLS
 #endif /* __GST_AUDIO_VISUALIZER_H__ */
@@ -116,6 +116,8 @@ gst_spectra_scope_finalize (GObject * object)
     g_free (scope->freq_data);
     scope->freq_data = NULL;
   }
+  g_free (scope->tops);
+  scope->tops = NULL;
 
   G_OBJECT_CLASS (gst_spectra_scope_parent_class)->finalize (object);
 }
@@ -129,37 +131,52 @@ gst_spectra_scope_setup (GstAudioVisualizer * bscope)
   if (scope->fft_ctx)
     gst_fft_s16_free (scope->fft_ctx);
   g_free (scope->freq_data);
+  g_free (scope->tops);
 
   /* we'd need this amount of samples per render() call */
   bscope->req_spf = num_freq * 2 - 2;
   scope->fft_ctx = gst_fft_s16_new (bscope->req_spf, FALSE);
   scope->freq_data = g_new (GstFFTS16Complex, num_freq);
+  scope->tops = g_new (guint, num_freq - 1);
 
   return TRUE;
 }
 
-static inline void
-add_pixel (guint32 * _p, guint32 _c)
+/* per byte saturating addition */
+static inline guint32
+add_pixel (guint32 p, guint32 c)
 {
-  guint8 *p = (guint8 *) _p;
-  guint8 *c = (guint8 *) & _c;
-
-  if (p[0] < 255 - c[0])
-    p[0] += c[0];
-  else
-    p[0] = 255;
-  if (p[1] < 255 - c[1])
-    p[1] += c[1];
-  else
-    p[1] = 255;
-  if (p[2] < 255 - c[2])
-    p[2] += c[2];
-  else
-    p[2] = 255;
-  if (p[3] < 255 - c[3])
-    p[3] += c[3];
-  else
-    p[3] = 255;
+  guint32 s = (p & 0x7f7f7f7f) + (c & 0x7f7f7f7f);
+  guint32 carry = ((p & c) | ((p | c) & s)) & 0x80808080;
+
+  return (s ^ ((p ^ c) & 0x80808080)) | ((carry >> 7) * 0xff);
+}
+
+/* draws the parts of the bars within rows [@y0, @y1) */
+static void
+gst_spectra_scope_render_band (GstAudioVisualizer * bscope, gint y0, gint y1,
+    gpointer user_data)
+{
+  GstSpectraScope *scope = GST_SPECTRA_SCOPE (bscope);
+  guint32 *vdata = user_data;
+  guint x, y, off, top;
+  guint w = GST_VIDEO_INFO_WIDTH (&bscope->vinfo);
+  guint h = GST_VIDEO_INFO_HEIGHT (&bscope->vinfo) - 1;
+  guint start = y0, end = MIN ((guint) y1, h);
+
+  for (x = 0; x < w; x++) {
+    top = scope->tops[x];
+    if (top >= start && top < (guint) y1)
+      vdata[(top * w) + x] = 0x00FFFFFF;
+    y = MAX (top + 1, start);
+    for (off = (y * w) + x; y < end; y++, off += w)
+      vdata[off] = add_pixel (vdata[off], 0x007F7F7F);
+    /* ensure bottom line is full bright (especially in move-up mode) */
+    if (top < h && h < (guint) y1) {
+      off = (h * w) + x;
+      vdata[off] = add_pixel (vdata[off], 0x00FEFEFE);
+    }
+  }
 }
 
 static gboolean
@@ -169,7 +186,7 @@ gst_spectra_scope_render (GstAudioVisualizer * bscope, GstBuffer * audio,
   GstSpectraScope *scope = GST_SPECTRA_SCOPE (bscope);
   gint16 *mono_adata;
   GstFFTS16Complex *fdata = scope->freq_data;
-  guint x, y, off, l;
+  guint x, y;
   guint w = GST_VIDEO_INFO_WIDTH (&bscope->vinfo);
   guint h = GST_VIDEO_INFO_HEIGHT (&bscope->vinfo) - 1;
   gfloat fr, fi;
@@ -204,7 +221,7 @@ gst_spectra_scope_render (GstAudioVisualizer * bscope, GstBuffer * audio,
   gst_fft_s16_fft (scope->fft_ctx, mono_adata, fdata);
   g_free (mono_adata);
 
-  /* draw lines */
+  /* find the bar tops, the bars are drawn in bands of rows */
   for (x = 0; x < w; x++) {
     /* figure out the range so that we don't need to clip,
      * or even better do a log mapping? */
@@ -213,16 +230,11 @@ gst_spectra_scope_render (GstAudioVisualizer * bscope, GstBuffer * audio,
     y = (guint) (h * sqrt (fr * fr + fi * fi));
     if (y > h)
       y = h;
-    y = h - y;
-    off = (y * w) + x;
-    vdata[off] = 0x00FFFFFF;
-    for (l = y; l < h; l++) {
-      off += w;
-      add_pixel (&vdata[off], 0x007F7F7F);
-    }
-    /* ensure bottom line is full bright (especially in move-up mode) */
-    add_pixel (&vdata[off], 0x007F7F7F);
+    scope->tops[x] = h - y;
   }
+  gst_audio_visualizer_run_bands (bscope, gst_spectra_scope_render_band,
+      vdata);
+
   gst_buffer_unmap (audio, &amap);
   return TRUE;
 }
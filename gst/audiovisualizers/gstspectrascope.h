@@ -40,6 +40,8 @@ struct _GstSpectraScope
 
   GstFFTS16 *fft_ctx;
   GstFFTS16Complex *freq_data;
+  /* row of the top of the bar in each column */
+  guint *tops;
 };
 
 struct _GstSpectraScopeClass
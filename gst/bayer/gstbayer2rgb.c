@@ -25,6 +25,12 @@
  * SECTION:element-bayer2rgb
  *
  * Decodes raw camera bayer (fourcc BA81) to RGB.
+ *
+ * Besides 8 bit bayer, 10, 12, 14 and 16 bit samples stored in 16 bit
+ * little or big endian words are accepted, and can be output to ARGB64
+ * without losing precision. The #GstBayer2RGB:method property selects the
+ * demosaicing algorithm, and frames can be split into bands of rows that
+ * are demosaiced by #GstBayer2RGB:n-threads threads.
  */
 
 /*
@@ -81,6 +87,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <_stdint.h>
+#include <gst/base/gstbandrunner.h>
 #include "gstbayerorc.h"
 
 #define GST_CAT_DEFAULT gst_bayer2rgb_debug
@@ -106,6 +113,29 @@ typedef struct _GstBayer2RGBClass GstBayer2RGBClass;
 
 typedef void (*GstBayer2RGBProcessFunc) (GstBayer2RGB *, guint8 *, guint);
 
+typedef enum
+{
+  GST_BAYER_2_RGB_METHOD_BILINEAR,
+  GST_BAYER_2_RGB_METHOD_EDGE,
+  GST_BAYER_2_RGB_METHOD_MALVAR
+} GstBayer2RGBMethod;
+
+/* A band of rows demosaiced by one thread, with its line buffers */
+typedef struct
+{
+  GstBayer2RGB *bayer2rgb;
+  int start;
+  int end;
+
+  int alloc_width;
+  guint8 *tmp;                  /* 8 bit bilinear line ring */
+  guint16 *in_rows;             /* ring of 8 padded input rows */
+  int in_id[8];
+  guint16 *g_rows;              /* ring of 4 padded green rows */
+  int g_id[4];
+  guint16 *rgb;                 /* red, green and blue of one output row */
+} GstBayer2RGBJob;
+
 struct _GstBayer2RGB
 {
   GstBaseTransform basetransform;
@@ -118,6 +148,26 @@ struct _GstBayer2RGB
   int g_off;                    /* offset for green */
   int b_off;                    /* offset for blue */
   int format;
+  int red_x;                    /* position of red in the 2x2 pattern */
+  int red_y;
+  int bpp;                      /* bits per sample */
+  gboolean big_endian;
+
+  /* properties */
+  GstBayer2RGBMethod method;
+  guint n_threads;
+
+  /* the frame being demosaiced */
+  GstBayer2RGBMethod frame_method;
+  const guint8 *src;
+  int src_stride;
+  guint8 *dest;
+  int dest_stride;
+
+  /* one job with its scratch memory per thread */
+  GstBandRunner *runner;
+  GstBayer2RGBJob *jobs;
+  guint n_jobs_alloc;
 };
 
 struct _GstBayer2RGBClass
@@ -126,21 +176,61 @@ struct _GstBayer2RGBClass
 };
 
 #define	SRC_CAPS                                 \
-  GST_VIDEO_CAPS_MAKE ("{ RGBx, xRGB, BGRx, xBGR, RGBA, ARGB, BGRA, ABGR }")
-
-#define SINK_CAPS "video/x-bayer,format=(string){bggr,grbg,gbrg,rggb}," \
+  GST_VIDEO_CAPS_MAKE ("{ RGBx, xRGB, BGRx, xBGR, RGBA, ARGB, BGRA, ABGR, " \
+      "ARGB64 }")
+
+#define SINK_FORMATS "{ bggr, grbg, gbrg, rggb, "                       \
+  "bggr10le, grbg10le, gbrg10le, rggb10le, "                            \
+  "bggr10be, grbg10be, gbrg10be, rggb10be, "                            \
+  "bggr12le, grbg12le, gbrg12le, rggb12le, "                            \
+  "bggr12be, grbg12be, gbrg12be, rggb12be, "                            \
+  "bggr14le, grbg14le, gbrg14le, rggb14le, "                            \
+  "bggr14be, grbg14be, gbrg14be, rggb14be, "                            \
+  "bggr16le, grbg16le, gbrg16le, rggb16le, "                            \
+  "bggr16be, grbg16be, gbrg16be, rggb16be }"
+
+#define SINK_CAPS "video/x-bayer,format=(string)" SINK_FORMATS ","      \
   "width=(int)[1,MAX],height=(int)[1,MAX],framerate=(fraction)[0/1,MAX]"
 
+/* fewer rows than this per band are not worth a thread */
+#define MIN_BAND_ROWS 16
+
+#define DEFAULT_METHOD GST_BAYER_2_RGB_METHOD_BILINEAR
+#define DEFAULT_N_THREADS 1
+
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_METHOD,
+  PROP_N_THREADS
 };
 
+#define GST_TYPE_BAYER_2_RGB_METHOD (gst_bayer2rgb_method_get_type ())
+static GType
+gst_bayer2rgb_method_get_type (void)
+{
+  static GType method_type = 0;
+  static const GEnumValue methods[] = {
+    {GST_BAYER_2_RGB_METHOD_BILINEAR, "Bilinear interpolation", "bilinear"},
+    {GST_BAYER_2_RGB_METHOD_EDGE,
+        "Edge directed green with color difference interpolation", "edge"},
+    {GST_BAYER_2_RGB_METHOD_MALVAR,
+        "Malvar-He-Cutler gradient corrected interpolation", "malvar"},
+    {0, NULL, NULL}
+  };
+
+  if (!method_type) {
+    method_type = g_enum_register_static ("GstBayer2RGBMethod", methods);
+  }
+  return method_type;
+}
+
 GType gst_bayer2rgb_get_type (void);
 
 #define gst_bayer2rgb_parent_class parent_class
 G_DEFINE_TYPE (GstBayer2RGB, gst_bayer2rgb, GST_TYPE_BASE_TRANSFORM);
 
+static void gst_bayer2rgb_finalize (GObject * object);
 static void gst_bayer2rgb_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_bayer2rgb_get_property (GObject * object, guint prop_id,
@@ -155,6 +245,9 @@ static GstCaps *gst_bayer2rgb_transform_caps (GstBaseTransform * base,
     GstPadDirection direction, GstCaps * caps, GstCaps * filter);
 static gboolean gst_bayer2rgb_get_unit_size (GstBaseTransform * base,
     GstCaps * caps, gsize * size);
+static gboolean gst_bayer2rgb_start (GstBaseTransform * base);
+static gboolean gst_bayer2rgb_stop (GstBaseTransform * base);
+static void gst_bayer2rgb_worker_func (gpointer data, gpointer user_data);
 
 
 static void
@@ -166,9 +259,21 @@ gst_bayer2rgb_class_init (GstBayer2RGBClass * klass)
   gobject_class = (GObjectClass *) klass;
   gstelement_class = (GstElementClass *) klass;
 
+  gobject_class->finalize = gst_bayer2rgb_finalize;
   gobject_class->set_property = gst_bayer2rgb_set_property;
   gobject_class->get_property = gst_bayer2rgb_get_property;
 
+  g_object_class_install_property (gobject_class, PROP_METHOD,
+      g_param_spec_enum ("method", "Method", "Demosaicing method",
+          GST_TYPE_BAYER_2_RGB_METHOD, DEFAULT_METHOD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to demosaic each frame with, "
+          "0 for the number of processors (takes effect on the next start)",
+          0, G_MAXUINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_set_static_metadata (gstelement_class,
       "Bayer to RGB decoder for cameras", "Filter/Converter/Video",
       "Converts video/x-bayer to video/x-raw",
@@ -189,6 +294,10 @@ gst_bayer2rgb_class_init (GstBayer2RGBClass * klass)
       GST_DEBUG_FUNCPTR (gst_bayer2rgb_set_caps);
   GST_BASE_TRANSFORM_CLASS (klass)->transform =
       GST_DEBUG_FUNCPTR (gst_bayer2rgb_transform);
+  GST_BASE_TRANSFORM_CLASS (klass)->start =
+      GST_DEBUG_FUNCPTR (gst_bayer2rgb_start);
+  GST_BASE_TRANSFORM_CLASS (klass)->stop =
+      GST_DEBUG_FUNCPTR (gst_bayer2rgb_stop);
 
   GST_DEBUG_CATEGORY_INIT (gst_bayer2rgb_debug, "bayer2rgb", 0,
       "bayer2rgb element");
@@ -197,17 +306,60 @@ gst_bayer2rgb_class_init (GstBayer2RGBClass * klass)
 static void
 gst_bayer2rgb_init (GstBayer2RGB * filter)
 {
+  filter->method = DEFAULT_METHOD;
+  filter->n_threads = DEFAULT_N_THREADS;
+  filter->runner = gst_band_runner_new ();
+
   gst_bayer2rgb_reset (filter);
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (filter), TRUE);
 }
 
-/* No properties are implemented, so only a warning is produced */
+static void
+gst_bayer2rgb_free_jobs (GstBayer2RGB * filter)
+{
+  guint i;
+
+  gst_band_runner_set_threads (filter->runner, 1, NULL);
+
+  for (i = 0; i < filter->n_jobs_alloc; i++) {
+    g_free (filter->jobs[i].tmp);
+    g_free (filter->jobs[i].in_rows);
+    g_free (filter->jobs[i].g_rows);
+    g_free (filter->jobs[i].rgb);
+  }
+  g_free (filter->jobs);
+  filter->jobs = NULL;
+  filter->n_jobs_alloc = 0;
+}
+
+static void
+gst_bayer2rgb_finalize (GObject * object)
+{
+  GstBayer2RGB *filter = GST_BAYER2RGB (object);
+
+  gst_bayer2rgb_free_jobs (filter);
+  gst_band_runner_free (filter->runner);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gst_bayer2rgb_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
 {
+  GstBayer2RGB *filter = GST_BAYER2RGB (object);
 
   switch (prop_id) {
+    case PROP_METHOD:
+      GST_OBJECT_LOCK (filter);
+      filter->method = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (filter);
+      filter->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -218,14 +370,105 @@ static void
 gst_bayer2rgb_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
+  GstBayer2RGB *filter = GST_BAYER2RGB (object);
 
   switch (prop_id) {
+    case PROP_METHOD:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_enum (value, filter->method);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint (value, filter->n_threads);
+      GST_OBJECT_UNLOCK (filter);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static gboolean
+gst_bayer2rgb_start (GstBaseTransform * base)
+{
+  GstBayer2RGB *filter = GST_BAYER2RGB (base);
+  GError *err = NULL;
+  guint i, n_threads;
+
+  GST_OBJECT_LOCK (filter);
+  n_threads = filter->n_threads;
+  GST_OBJECT_UNLOCK (filter);
+
+  gst_bayer2rgb_free_jobs (filter);
+
+  if (!gst_band_runner_set_threads (filter->runner, n_threads, &err)) {
+    GST_ELEMENT_ERROR (filter, RESOURCE, FAILED, (NULL),
+        ("Failed to create thread pool: %s", err->message));
+    g_clear_error (&err);
+    return FALSE;
+  }
+  n_threads = gst_band_runner_get_n_threads (filter->runner);
+
+  GST_DEBUG_OBJECT (filter, "demosaicing with %u threads", n_threads);
+
+  filter->jobs = g_new0 (GstBayer2RGBJob, n_threads);
+  for (i = 0; i < n_threads; i++)
+    filter->jobs[i].bayer2rgb = filter;
+  filter->n_jobs_alloc = n_threads;
+
+  return TRUE;
+}
+
+static gboolean
+gst_bayer2rgb_stop (GstBaseTransform * base)
+{
+  gst_bayer2rgb_free_jobs (GST_BAYER2RGB (base));
+
+  return TRUE;
+}
+
+/* Parses a video/x-bayer format: the first four letters give the pattern,
+ * followed by the sample depth and endianness for more than 8 bits */
+static gboolean
+gst_bayer2rgb_parse_format (const gchar * format, int *pattern, int *bpp,
+    gboolean * big_endian)
+{
+  if (g_str_has_prefix (format, "bggr")) {
+    *pattern = GST_BAYER_2_RGB_FORMAT_BGGR;
+  } else if (g_str_has_prefix (format, "gbrg")) {
+    *pattern = GST_BAYER_2_RGB_FORMAT_GBRG;
+  } else if (g_str_has_prefix (format, "grbg")) {
+    *pattern = GST_BAYER_2_RGB_FORMAT_GRBG;
+  } else if (g_str_has_prefix (format, "rggb")) {
+    *pattern = GST_BAYER_2_RGB_FORMAT_RGGB;
+  } else {
+    return FALSE;
+  }
+
+  format += 4;
+  *big_endian = FALSE;
+  if (*format == '\0') {
+    *bpp = 8;
+    return TRUE;
+  }
+
+  if (g_str_equal (format, "10le") || g_str_equal (format, "10be"))
+    *bpp = 10;
+  else if (g_str_equal (format, "12le") || g_str_equal (format, "12be"))
+    *bpp = 12;
+  else if (g_str_equal (format, "14le") || g_str_equal (format, "14be"))
+    *bpp = 14;
+  else if (g_str_equal (format, "16le") || g_str_equal (format, "16be"))
+    *bpp = 16;
+  else
+    return FALSE;
+
+  *big_endian = g_str_has_suffix (format, "be");
+
+  return TRUE;
+}
+
 static gboolean
 gst_bayer2rgb_set_caps (GstBaseTransform * base, GstCaps * incaps,
     GstCaps * outcaps)
@@ -244,16 +487,27 @@ gst_bayer2rgb_set_caps (GstBaseTransform * base, GstCaps * incaps,
   gst_structure_get_int (structure, "height", &bayer2rgb->height);
 
   format = gst_structure_get_string (structure, "format");
-  if (g_str_equal (format, "bggr")) {
-    bayer2rgb->format = GST_BAYER_2_RGB_FORMAT_BGGR;
-  } else if (g_str_equal (format, "gbrg")) {
-    bayer2rgb->format = GST_BAYER_2_RGB_FORMAT_GBRG;
-  } else if (g_str_equal (format, "grbg")) {
-    bayer2rgb->format = GST_BAYER_2_RGB_FORMAT_GRBG;
-  } else if (g_str_equal (format, "rggb")) {
-    bayer2rgb->format = GST_BAYER_2_RGB_FORMAT_RGGB;
-  } else {
+  if (format == NULL || !gst_bayer2rgb_parse_format (format,
+          &bayer2rgb->format, &bayer2rgb->bpp, &bayer2rgb->big_endian))
     return FALSE;
+
+  switch (bayer2rgb->format) {
+    case GST_BAYER_2_RGB_FORMAT_BGGR:
+      bayer2rgb->red_x = 1;
+      bayer2rgb->red_y = 1;
+      break;
+    case GST_BAYER_2_RGB_FORMAT_GBRG:
+      bayer2rgb->red_x = 0;
+      bayer2rgb->red_y = 1;
+      break;
+    case GST_BAYER_2_RGB_FORMAT_GRBG:
+      bayer2rgb->red_x = 1;
+      bayer2rgb->red_y = 0;
+      break;
+    case GST_BAYER_2_RGB_FORMAT_RGGB:
+      bayer2rgb->red_x = 0;
+      bayer2rgb->red_y = 0;
+      break;
   }
 
   /* To cater for different RGB formats, we need to set params for later */
@@ -275,6 +529,8 @@ gst_bayer2rgb_reset (GstBayer2RGB * filter)
   filter->r_off = 0;
   filter->g_off = 0;
   filter->b_off = 0;
+  filter->bpp = 8;
+  filter->big_endian = FALSE;
   gst_video_info_init (&filter->info);
 }
 
@@ -292,7 +548,7 @@ gst_bayer2rgb_transform_caps (GstBaseTransform * base,
 
   if (direction == GST_PAD_SRC) {
     newcaps = gst_caps_from_string ("video/x-bayer,"
-        "format=(string){bggr,grbg,gbrg,rggb}");
+        "format=(string)" SINK_FORMATS);
   } else {
     newcaps = gst_caps_new_empty_simple ("video/x-raw");
   }
@@ -336,11 +592,27 @@ gst_bayer2rgb_get_unit_size (GstBaseTransform * base, GstCaps * caps,
     name = gst_structure_get_name (structure);
     /* Our name must be either video/x-bayer video/x-raw */
     if (strcmp (name, "video/x-raw")) {
-      *size = GST_ROUND_UP_4 (width) * height;
+      const gchar *format = gst_structure_get_string (structure, "format");
+      int pattern, bpp = 8;
+      gboolean big_endian;
+
+      if (format != NULL)
+        gst_bayer2rgb_parse_format (format, &pattern, &bpp, &big_endian);
+
+      if (bpp > 8)
+        *size = GST_ROUND_UP_4 (width * 2) * height;
+      else
+        *size = GST_ROUND_UP_4 (width) * height;
       return TRUE;
     } else {
-      /* For output, calculate according to format (always 32 bits) */
-      *size = width * height * 4;
+      GstVideoInfo info;
+
+      /* For output, calculate according to format (32 or 64 bits) */
+      if (gst_video_info_from_caps (&info, caps)
+          && GST_VIDEO_INFO_FORMAT (&info) == GST_VIDEO_FORMAT_ARGB64)
+        *size = width * height * 8;
+      else
+        *size = width * height * 4;
       return TRUE;
     }
 
@@ -383,14 +655,33 @@ typedef void (*process_func) (guint8 * d0, const guint8 * s0, const guint8 * s1,
     const guint8 * s2, const guint8 * s3, const guint8 * s4, const guint8 * s5,
     int n);
 
+/* Mirrors a row or column index into [0, n - 1], keeping its parity so that
+ * the bayer pattern is preserved at the borders */
+static inline int
+mirror (int i, int n)
+{
+  if (i < 0)
+    i = -i;
+  if (i >= n)
+    i = 2 * (n - 1) - i;
+
+  return CLAMP (i, 0, n - 1);
+}
+
+/* Bilinear interpolation of 8 bit bayer with the ORC kernels. The rows are
+ * horizontally upsampled into a ring of 4 rows, each output row is then
+ * merged from the upsampled rows above, at and below it. */
 static void
-gst_bayer2rgb_process (GstBayer2RGB * bayer2rgb, uint8_t * dest,
-    int dest_stride, uint8_t * src, int src_stride)
+gst_bayer2rgb_process (GstBayer2RGB * bayer2rgb, GstBayer2RGBJob * job)
 {
   int j;
   guint8 *tmp;
   process_func merge[2] = { NULL, NULL };
   int r_off, g_off, b_off;
+  const guint8 *src = bayer2rgb->src;
+  int src_stride = bayer2rgb->src_stride;
+  guint8 *dest = bayer2rgb->dest;
+  int dest_stride = bayer2rgb->dest_stride;
 
   /* We exploit some symmetry in the functions here.  The base functions
    * are all named for the BGGR arrangement.  For RGGB, we swap the
@@ -425,32 +716,367 @@ gst_bayer2rgb_process (GstBayer2RGB * bayer2rgb, uint8_t * dest,
     merge[1] = tmp;
   }
 
-  tmp = g_malloc (2 * 4 * bayer2rgb->width);
+  tmp = job->tmp;
 #define LINE(x) (tmp + ((x)&7) * bayer2rgb->width)
 
-  gst_bayer2rgb_split_and_upsample_horiz (LINE (3 * 2 + 0), LINE (3 * 2 + 1),
-      src + 1 * src_stride, bayer2rgb->width);
-  j = 0;
+  j = job->start;
+  gst_bayer2rgb_split_and_upsample_horiz (LINE ((j - 1) * 2 + 0),
+      LINE ((j - 1) * 2 + 1),
+      src + mirror (j - 1, bayer2rgb->height) * src_stride, bayer2rgb->width);
   gst_bayer2rgb_split_and_upsample_horiz (LINE (j * 2 + 0), LINE (j * 2 + 1),
       src + j * src_stride, bayer2rgb->width);
 
-  for (j = 0; j < bayer2rgb->height; j++) {
-    if (j < bayer2rgb->height - 1) {
-      gst_bayer2rgb_split_and_upsample_horiz (LINE ((j + 1) * 2 + 0),
-          LINE ((j + 1) * 2 + 1), src + (j + 1) * src_stride, bayer2rgb->width);
-    }
+  for (j = job->start; j < job->end; j++) {
+    gst_bayer2rgb_split_and_upsample_horiz (LINE ((j + 1) * 2 + 0),
+        LINE ((j + 1) * 2 + 1),
+        src + mirror (j + 1, bayer2rgb->height) * src_stride,
+        bayer2rgb->width);
 
     merge[j & 1] (dest + j * dest_stride,
         LINE (j * 2 - 2), LINE (j * 2 - 1),
         LINE (j * 2 + 0), LINE (j * 2 + 1),
         LINE (j * 2 + 2), LINE (j * 2 + 3), bayer2rgb->width >> 1);
   }
+#undef LINE
+}
+
+/* The other methods and sample depths work on rows of 16 bit samples,
+ * padded by two mirrored samples on each side */
+#define PAD 2
+
+static const guint16 *
+gst_bayer2rgb_get_row (GstBayer2RGB * bayer2rgb, GstBayer2RGBJob * job, int j)
+{
+  int width = bayer2rgb->width;
+  guint16 *row = job->in_rows + (j & 7) * (job->alloc_width + 2 * PAD) + PAD;
+
+  if (job->in_id[j & 7] != j) {
+    const guint8 *s =
+        bayer2rgb->src + mirror (j, bayer2rgb->height) * bayer2rgb->src_stride;
+    guint16 mask = (1 << bayer2rgb->bpp) - 1;
+    int i;
+
+    if (bayer2rgb->bpp == 8) {
+      for (i = 0; i < width; i++)
+        row[i] = s[i];
+    } else if (bayer2rgb->big_endian) {
+      for (i = 0; i < width; i++)
+        row[i] = GST_READ_UINT16_BE (s + 2 * i) & mask;
+    } else {
+      for (i = 0; i < width; i++)
+        row[i] = GST_READ_UINT16_LE (s + 2 * i) & mask;
+    }
+
+    for (i = 1; i <= PAD; i++) {
+      row[-i] = row[mirror (-i, width)];
+      row[width - 1 + i] = row[mirror (width - 1 + i, width)];
+    }
+    job->in_id[j & 7] = j;
+  }
+
+  return row;
+}
+
+/* Returns the column of the red samples on row @j, or of the blue samples
+ * if @j has none. *@red_row is set to whether it has red samples. */
+static inline int
+gst_bayer2rgb_chroma_x (GstBayer2RGB * bayer2rgb, int j, gboolean * red_row)
+{
+  *red_row = (j & 1) == bayer2rgb->red_y;
+
+  return *red_row ? bayer2rgb->red_x : bayer2rgb->red_x ^ 1;
+}
+
+/* Green at red and blue samples is interpolated along the direction with
+ * the smallest gradient, with a laplacian correction from the chroma channel
+ * (Hamilton-Adams) */
+static const guint16 *
+gst_bayer2rgb_get_green_row (GstBayer2RGB * bayer2rgb, GstBayer2RGBJob * job,
+    int j)
+{
+  int width = bayer2rgb->width;
+  guint16 *row = job->g_rows + (j & 3) * (job->alloc_width + 2 * PAD) + PAD;
+
+  if (job->g_id[j & 3] != j) {
+    const guint16 *s0 = gst_bayer2rgb_get_row (bayer2rgb, job, j - 2);
+    const guint16 *s1 = gst_bayer2rgb_get_row (bayer2rgb, job, j - 1);
+    const guint16 *s2 = gst_bayer2rgb_get_row (bayer2rgb, job, j);
+    const guint16 *s3 = gst_bayer2rgb_get_row (bayer2rgb, job, j + 1);
+    const guint16 *s4 = gst_bayer2rgb_get_row (bayer2rgb, job, j + 2);
+    int max = (1 << bayer2rgb->bpp) - 1;
+    gboolean red_row;
+    int c_x = gst_bayer2rgb_chroma_x (bayer2rgb, j, &red_row);
+    int i;
+
+    for (i = c_x ^ 1; i < width; i += 2)
+      row[i] = s2[i];
+
+    for (i = c_x; i < width; i += 2) {
+      int c = 2 * s2[i];
+      int dh = ABS (s2[i - 1] - s2[i + 1]) + ABS (c - s2[i - 2] - s2[i + 2]);
+      int dv = ABS (s1[i] - s3[i]) + ABS (c - s0[i] - s4[i]);
+      int gh = 2 * (s2[i - 1] + s2[i + 1]) + c - s2[i - 2] - s2[i + 2];
+      int gv = 2 * (s1[i] + s3[i]) + c - s0[i] - s4[i];
+      int g;
+
+      if (dh < dv)
+        g = (gh + 2) >> 2;
+      else if (dv < dh)
+        g = (gv + 2) >> 2;
+      else
+        g = (gh + gv + 4) >> 3;
+
+      row[i] = CLAMP (g, 0, max);
+    }
+
+    for (i = 1; i <= PAD; i++) {
+      row[-i] = row[mirror (-i, width)];
+      row[width - 1 + i] = row[mirror (width - 1 + i, width)];
+    }
+    job->g_id[j & 3] = j;
+  }
+
+  return row;
+}
+
+static void
+gst_bayer2rgb_bilinear_row (GstBayer2RGB * bayer2rgb, GstBayer2RGBJob * job,
+    int j, guint16 * r, guint16 * g, guint16 * b)
+{
+  const guint16 *s1 = gst_bayer2rgb_get_row (bayer2rgb, job, j - 1);
+  const guint16 *s2 = gst_bayer2rgb_get_row (bayer2rgb, job, j);
+  const guint16 *s3 = gst_bayer2rgb_get_row (bayer2rgb, job, j + 1);
+  int width = bayer2rgb->width;
+  gboolean red_row;
+  int c_x = gst_bayer2rgb_chroma_x (bayer2rgb, j, &red_row);
+  guint16 *cc = red_row ? r : b;        /* chroma sampled on this row */
+  guint16 *oc = red_row ? b : r;        /* chroma sampled on the others */
+  int i;
+
+  for (i = c_x; i < width; i += 2) {
+    cc[i] = s2[i];
+    g[i] = (s1[i] + s3[i] + s2[i - 1] + s2[i + 1] + 2) >> 2;
+    oc[i] = (s1[i - 1] + s1[i + 1] + s3[i - 1] + s3[i + 1] + 2) >> 2;
+  }
 
-  g_free (tmp);
+  for (i = c_x ^ 1; i < width; i += 2) {
+    g[i] = s2[i];
+    cc[i] = (s2[i - 1] + s2[i + 1] + 1) >> 1;
+    oc[i] = (s1[i] + s3[i] + 1) >> 1;
+  }
 }
 
+/* Chroma is interpolated on the color differences with the green rows */
+static void
+gst_bayer2rgb_edge_row (GstBayer2RGB * bayer2rgb, GstBayer2RGBJob * job,
+    int j, guint16 * r, guint16 * g, guint16 * b)
+{
+  const guint16 *g1 = gst_bayer2rgb_get_green_row (bayer2rgb, job, j - 1);
+  const guint16 *g2 = gst_bayer2rgb_get_green_row (bayer2rgb, job, j);
+  const guint16 *g3 = gst_bayer2rgb_get_green_row (bayer2rgb, job, j + 1);
+  const guint16 *s1 = gst_bayer2rgb_get_row (bayer2rgb, job, j - 1);
+  const guint16 *s2 = gst_bayer2rgb_get_row (bayer2rgb, job, j);
+  const guint16 *s3 = gst_bayer2rgb_get_row (bayer2rgb, job, j + 1);
+  int width = bayer2rgb->width;
+  int max = (1 << bayer2rgb->bpp) - 1;
+  gboolean red_row;
+  int c_x = gst_bayer2rgb_chroma_x (bayer2rgb, j, &red_row);
+  guint16 *cc = red_row ? r : b;
+  guint16 *oc = red_row ? b : r;
+  int i, v;
+
+  for (i = c_x; i < width; i += 2) {
+    cc[i] = s2[i];
+    g[i] = g2[i];
+    v = g2[i] + ((s1[i - 1] - g1[i - 1] + s1[i + 1] - g1[i + 1] +
+            s3[i - 1] - g3[i - 1] + s3[i + 1] - g3[i + 1]) >> 2);
+    oc[i] = CLAMP (v, 0, max);
+  }
 
+  for (i = c_x ^ 1; i < width; i += 2) {
+    g[i] = s2[i];
+    v = s2[i] + ((s2[i - 1] - g2[i - 1] + s2[i + 1] - g2[i + 1]) >> 1);
+    cc[i] = CLAMP (v, 0, max);
+    v = s2[i] + ((s1[i] - g1[i] + s3[i] - g3[i]) >> 1);
+    oc[i] = CLAMP (v, 0, max);
+  }
+}
 
+/* H. S. Malvar, L. He and R. Cutler, "High-quality linear interpolation for
+ * demosaicing of Bayer-patterned color images", ICASSP 2004. The kernels
+ * are scaled by 16 to stay in integers. */
+static void
+gst_bayer2rgb_malvar_row (GstBayer2RGB * bayer2rgb, GstBayer2RGBJob * job,
+    int j, guint16 * r, guint16 * g, guint16 * b)
+{
+  const guint16 *s0 = gst_bayer2rgb_get_row (bayer2rgb, job, j - 2);
+  const guint16 *s1 = gst_bayer2rgb_get_row (bayer2rgb, job, j - 1);
+  const guint16 *s2 = gst_bayer2rgb_get_row (bayer2rgb, job, j);
+  const guint16 *s3 = gst_bayer2rgb_get_row (bayer2rgb, job, j + 1);
+  const guint16 *s4 = gst_bayer2rgb_get_row (bayer2rgb, job, j + 2);
+  int width = bayer2rgb->width;
+  int max = (1 << bayer2rgb->bpp) - 1;
+  gboolean red_row;
+  int c_x = gst_bayer2rgb_chroma_x (bayer2rgb, j, &red_row);
+  guint16 *cc = red_row ? r : b;
+  guint16 *oc = red_row ? b : r;
+  int i, v;
+
+  for (i = c_x; i < width; i += 2) {
+    int c = s2[i];
+    int cross = s1[i] + s3[i] + s2[i - 1] + s2[i + 1];
+    int far = s0[i] + s4[i] + s2[i - 2] + s2[i + 2];
+    int diag = s1[i - 1] + s1[i + 1] + s3[i - 1] + s3[i + 1];
+
+    cc[i] = c;
+    v = (8 * c + 4 * cross - 2 * far + 8) >> 4;
+    g[i] = CLAMP (v, 0, max);
+    v = (12 * c + 4 * diag - 3 * far + 8) >> 4;
+    oc[i] = CLAMP (v, 0, max);
+  }
+
+  for (i = c_x ^ 1; i < width; i += 2) {
+    int c = s2[i];
+    int diag = s1[i - 1] + s1[i + 1] + s3[i - 1] + s3[i + 1];
+    int hfar = s2[i - 2] + s2[i + 2];
+    int vfar = s0[i] + s4[i];
+
+    g[i] = c;
+    /* chroma of this row is on the left and right */
+    v = (10 * c + 8 * (s2[i - 1] + s2[i + 1]) - 2 * diag - 2 * hfar + vfar +
+        8) >> 4;
+    cc[i] = CLAMP (v, 0, max);
+    /* the other chroma is above and below */
+    v = (10 * c + 8 * (s1[i] + s3[i]) - 2 * diag - 2 * vfar + hfar + 8) >> 4;
+    oc[i] = CLAMP (v, 0, max);
+  }
+}
+
+static void
+gst_bayer2rgb_pack_row (GstBayer2RGB * bayer2rgb, guint8 * dest,
+    const guint16 * r, const guint16 * g, const guint16 * b)
+{
+  int width = bayer2rgb->width;
+  int bpp = bayer2rgb->bpp;
+  int i;
+
+  if (GST_VIDEO_INFO_FORMAT (&bayer2rgb->info) == GST_VIDEO_FORMAT_ARGB64) {
+    guint16 *d = (guint16 *) dest;
+
+    /* scale up to 16 bits, replicating the high bits into the low ones */
+    for (i = 0; i < width; i++) {
+      d[4 * i + 0] = 0xffff;
+      d[4 * i + 1] = (r[i] << (16 - bpp)) | (r[i] >> (2 * bpp - 16));
+      d[4 * i + 2] = (g[i] << (16 - bpp)) | (g[i] >> (2 * bpp - 16));
+      d[4 * i + 3] = (b[i] << (16 - bpp)) | (b[i] >> (2 * bpp - 16));
+    }
+  } else {
+    int shift = bpp - 8;
+    int r_off = bayer2rgb->r_off;
+    int g_off = bayer2rgb->g_off;
+    int b_off = bayer2rgb->b_off;
+    int a_off = 6 - r_off - g_off - b_off;
+
+    for (i = 0; i < width; i++) {
+      dest[4 * i + r_off] = r[i] >> shift;
+      dest[4 * i + g_off] = g[i] >> shift;
+      dest[4 * i + b_off] = b[i] >> shift;
+      dest[4 * i + a_off] = 0xff;
+    }
+  }
+}
+
+static void
+gst_bayer2rgb_process_generic (GstBayer2RGB * bayer2rgb, GstBayer2RGBJob * job)
+{
+  guint16 *r = job->rgb;
+  guint16 *g = r + job->alloc_width;
+  guint16 *b = g + job->alloc_width;
+  int i, j;
+
+  for (i = 0; i < 8; i++)
+    job->in_id[i] = G_MININT;
+  for (i = 0; i < 4; i++)
+    job->g_id[i] = G_MININT;
+
+  for (j = job->start; j < job->end; j++) {
+    switch (bayer2rgb->frame_method) {
+      case GST_BAYER_2_RGB_METHOD_EDGE:
+        gst_bayer2rgb_edge_row (bayer2rgb, job, j, r, g, b);
+        break;
+      case GST_BAYER_2_RGB_METHOD_MALVAR:
+        gst_bayer2rgb_malvar_row (bayer2rgb, job, j, r, g, b);
+        break;
+      case GST_BAYER_2_RGB_METHOD_BILINEAR:
+      default:
+        gst_bayer2rgb_bilinear_row (bayer2rgb, job, j, r, g, b);
+        break;
+    }
+
+    gst_bayer2rgb_pack_row (bayer2rgb,
+        bayer2rgb->dest + j * bayer2rgb->dest_stride, r, g, b);
+  }
+}
+
+static gboolean
+gst_bayer2rgb_use_orc (GstBayer2RGB * bayer2rgb)
+{
+  return bayer2rgb->frame_method == GST_BAYER_2_RGB_METHOD_BILINEAR &&
+      bayer2rgb->bpp == 8 &&
+      GST_VIDEO_INFO_FORMAT (&bayer2rgb->info) != GST_VIDEO_FORMAT_ARGB64 &&
+      bayer2rgb->width >= 4;
+}
+
+static void
+gst_bayer2rgb_run_job (GstBayer2RGB * bayer2rgb, GstBayer2RGBJob * job)
+{
+  int width = bayer2rgb->width;
+
+  if (job->alloc_width != width) {
+    g_free (job->tmp);
+    g_free (job->in_rows);
+    g_free (job->g_rows);
+    g_free (job->rgb);
+    job->tmp = g_malloc (2 * 4 * width);
+    job->in_rows = g_new (guint16, 8 * (width + 2 * PAD));
+    job->g_rows = g_new (guint16, 4 * (width + 2 * PAD));
+    job->rgb = g_new (guint16, 3 * width);
+    job->alloc_width = width;
+  }
+
+  if (gst_bayer2rgb_use_orc (bayer2rgb))
+    gst_bayer2rgb_process (bayer2rgb, job);
+  else
+    gst_bayer2rgb_process_generic (bayer2rgb, job);
+}
+
+static void
+gst_bayer2rgb_job_func (guint band, guint n_bands, gpointer user_data)
+{
+  GstBayer2RGB *bayer2rgb = user_data;
+
+  gst_bayer2rgb_run_job (bayer2rgb, &bayer2rgb->jobs[band]);
+}
+
+/* Splits the frame into bands of rows for the calling thread and the pool */
+static void
+gst_bayer2rgb_run (GstBayer2RGB * bayer2rgb)
+{
+  int height = bayer2rgb->height;
+  guint i, n_bands;
+
+  n_bands = CLAMP (height / MIN_BAND_ROWS, 1, (gint) bayer2rgb->n_jobs_alloc);
+
+  for (i = 0; i < n_bands; i++) {
+    GstBayer2RGBJob *job = &bayer2rgb->jobs[i];
+
+    job->start = (gint64) height * i / n_bands;
+    job->end = (gint64) height * (i + 1) / n_bands;
+  }
+
+  gst_band_runner_run (bayer2rgb->runner, n_bands, gst_bayer2rgb_job_func,
+      bayer2rgb);
+}
 
 static GstFlowReturn
 gst_bayer2rgb_transform (GstBaseTransform * base, GstBuffer * inbuf,
@@ -458,18 +1084,37 @@ gst_bayer2rgb_transform (GstBaseTransform * base, GstBuffer * inbuf,
 {
   GstBayer2RGB *filter = GST_BAYER2RGB (base);
   GstMapInfo map;
-  uint8_t *output;
   GstVideoFrame frame;
 
   GST_DEBUG ("transforming buffer");
-  gst_buffer_map (inbuf, &map, GST_MAP_READ);
-  gst_video_frame_map (&frame, &filter->info, outbuf, GST_MAP_WRITE);
+  if (!gst_buffer_map (inbuf, &map, GST_MAP_READ))
+    goto map_failed;
+  if (!gst_video_frame_map (&frame, &filter->info, outbuf, GST_MAP_WRITE)) {
+    gst_buffer_unmap (inbuf, &map);
+    goto map_failed;
+  }
+
+  filter->src = map.data;
+  if (filter->bpp > 8)
+    filter->src_stride = GST_ROUND_UP_4 (filter->width * 2);
+  else
+    filter->src_stride = filter->width;
+  filter->dest = GST_VIDEO_FRAME_PLANE_DATA (&frame, 0);
+  filter->dest_stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, 0);
+
+  GST_OBJECT_LOCK (filter);
+  filter->frame_method = filter->method;
+  GST_OBJECT_UNLOCK (filter);
+
+  gst_bayer2rgb_run (filter);
 
-  output = GST_VIDEO_FRAME_PLANE_DATA (&frame, 0);
-  gst_bayer2rgb_process (filter, output, filter->width * 4,
-      map.data, filter->width);
   gst_video_frame_unmap (&frame);
   gst_buffer_unmap (inbuf, &map);
 
   return GST_FLOW_OK;
+
+map_failed:
+  GST_ELEMENT_ERROR (filter, RESOURCE, FAILED, (NULL),
+      ("Failed to map buffers"));
+  return GST_FLOW_ERROR;
 }
@@ -30,6 +30,8 @@ GType gst_compare_get_type (void);
 GType gst_debug_spy_get_type (void);
 GType gst_error_ignore_get_type (void);
 GType gst_watchdog_get_type (void);
+GType gst_profile_stamp_get_type (void);
+GType gst_profile_meter_get_type (void);
 
 static gboolean
 plugin_init (GstPlugin * plugin)
@@ -48,6 +50,10 @@ plugin_init (GstPlugin * plugin)
       gst_watchdog_get_type ());
   gst_element_register (plugin, "errorignore", GST_RANK_NONE,
       gst_error_ignore_get_type ());
+  gst_element_register (plugin, "profilestamp", GST_RANK_NONE,
+      gst_profile_stamp_get_type ());
+  gst_element_register (plugin, "profilemeter", GST_RANK_NONE,
+      gst_profile_meter_get_type ());
 
   return TRUE;
 }
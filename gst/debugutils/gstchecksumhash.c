@@ -0,0 +1,301 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/gst.h>
+
+#include "gstchecksumhash.h"
+
+#define XXH_PRIME64_1 G_GUINT64_CONSTANT (11400714785074694791)
+#define XXH_PRIME64_2 G_GUINT64_CONSTANT (14029467366897019727)
+#define XXH_PRIME64_3 G_GUINT64_CONSTANT (1609587929392839161)
+#define XXH_PRIME64_4 G_GUINT64_CONSTANT (9650029242287828579)
+#define XXH_PRIME64_5 G_GUINT64_CONSTANT (2870177450012600261)
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+typedef struct
+{
+  guint64 v[4];
+  guint64 total_size;
+  guint8 mem[32];
+  guint mem_size;
+} XXH64State;
+
+struct _GstChecksumHash
+{
+  GstChecksumHashType type;
+
+  union
+  {
+    GChecksum *checksum;
+    guint32 crc;
+    XXH64State xxh;
+  } state;
+};
+
+/* CRC32C (Castagnoli), slicing-by-8 */
+static guint32 crc32c_table[8][256];
+
+static gpointer
+crc32c_init_table (gpointer data)
+{
+  guint32 i, j, crc;
+
+  for (i = 0; i < 256; i++) {
+    crc = i;
+    for (j = 0; j < 8; j++)
+      crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78 : 0);
+    crc32c_table[0][i] = crc;
+  }
+  for (i = 0; i < 256; i++) {
+    crc = crc32c_table[0][i];
+    for (j = 1; j < 8; j++) {
+      crc = (crc >> 8) ^ crc32c_table[0][crc & 0xff];
+      crc32c_table[j][i] = crc;
+    }
+  }
+
+  return NULL;
+}
+
+static guint32
+crc32c_update (guint32 crc, const guint8 * data, gsize size)
+{
+  while (size >= 8) {
+    guint32 lo = GST_READ_UINT32_LE (data) ^ crc;
+    guint32 hi = GST_READ_UINT32_LE (data + 4);
+
+    crc = crc32c_table[7][lo & 0xff] ^ crc32c_table[6][(lo >> 8) & 0xff] ^
+        crc32c_table[5][(lo >> 16) & 0xff] ^ crc32c_table[4][lo >> 24] ^
+        crc32c_table[3][hi & 0xff] ^ crc32c_table[2][(hi >> 8) & 0xff] ^
+        crc32c_table[1][(hi >> 16) & 0xff] ^ crc32c_table[0][hi >> 24];
+    data += 8;
+    size -= 8;
+  }
+  while (size--)
+    crc = crc32c_table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+  return crc;
+}
+
+/* XXH64 with seed 0 */
+static inline guint64
+xxh64_round (guint64 acc, guint64 input)
+{
+  acc += input * XXH_PRIME64_2;
+  acc = ROTL64 (acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+static inline guint64
+xxh64_merge_round (guint64 acc, guint64 val)
+{
+  acc ^= xxh64_round (0, val);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static void
+xxh64_init (XXH64State * state)
+{
+  memset (state, 0, sizeof (XXH64State));
+  state->v[0] = XXH_PRIME64_1 + XXH_PRIME64_2;
+  state->v[1] = XXH_PRIME64_2;
+  state->v[2] = 0;
+  state->v[3] = -XXH_PRIME64_1;
+}
+
+static const guint8 *
+xxh64_consume (XXH64State * state, const guint8 * p, const guint8 * end)
+{
+  guint64 v0 = state->v[0], v1 = state->v[1];
+  guint64 v2 = state->v[2], v3 = state->v[3];
+
+  while (p + 32 <= end) {
+    v0 = xxh64_round (v0, GST_READ_UINT64_LE (p));
+    v1 = xxh64_round (v1, GST_READ_UINT64_LE (p + 8));
+    v2 = xxh64_round (v2, GST_READ_UINT64_LE (p + 16));
+    v3 = xxh64_round (v3, GST_READ_UINT64_LE (p + 24));
+    p += 32;
+  }
+
+  state->v[0] = v0;
+  state->v[1] = v1;
+  state->v[2] = v2;
+  state->v[3] = v3;
+
+  return p;
+}
+
+static void
+xxh64_update (XXH64State * state, const guint8 * data, gsize size)
+{
+  const guint8 *end = data + size;
+
+  state->total_size += size;
+
+  if (state->mem_size + size < 32) {
+    memcpy (state->mem + state->mem_size, data, size);
+    state->mem_size += size;
+    return;
+  }
+
+  if (state->mem_size) {
+    guint fill = 32 - state->mem_size;
+
+    memcpy (state->mem + state->mem_size, data, fill);
+    xxh64_consume (state, state->mem, state->mem + 32);
+    data += fill;
+    state->mem_size = 0;
+  }
+
+  data = xxh64_consume (state, data, end);
+
+  if (data < end) {
+    memcpy (state->mem, data, end - data);
+    state->mem_size = end - data;
+  }
+}
+
+static guint64
+xxh64_digest (XXH64State * state)
+{
+  const guint8 *p = state->mem;
+  const guint8 *end = p + state->mem_size;
+  guint64 h;
+
+  if (state->total_size >= 32) {
+    h = ROTL64 (state->v[0], 1) + ROTL64 (state->v[1], 7) +
+        ROTL64 (state->v[2], 12) + ROTL64 (state->v[3], 18);
+    h = xxh64_merge_round (h, state->v[0]);
+    h = xxh64_merge_round (h, state->v[1]);
+    h = xxh64_merge_round (h, state->v[2]);
+    h = xxh64_merge_round (h, state->v[3]);
+  } else {
+    h = XXH_PRIME64_5;
+  }
+
+  h += state->total_size;
+
+  while (p + 8 <= end) {
+    h ^= xxh64_round (0, GST_READ_UINT64_LE (p));
+    h = ROTL64 (h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    p += 8;
+  }
+  if (p + 4 <= end) {
+    h ^= (guint64) GST_READ_UINT32_LE (p) * XXH_PRIME64_1;
+    h = ROTL64 (h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    p += 4;
+  }
+  while (p < end) {
+    h ^= *p * XXH_PRIME64_5;
+    h = ROTL64 (h, 11) * XXH_PRIME64_1;
+    p++;
+  }
+
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+GstChecksumHash *
+gst_checksum_hash_new (GstChecksumHashType type)
+{
+  static GOnce crc32c_once = G_ONCE_INIT;
+  GstChecksumHash *hash;
+
+  hash = g_slice_new (GstChecksumHash);
+  hash->type = type;
+
+  switch (type) {
+    case GST_CHECKSUM_HASH_CRC32C:
+      g_once (&crc32c_once, crc32c_init_table, NULL);
+      hash->state.crc = 0xffffffff;
+      break;
+    case GST_CHECKSUM_HASH_XXHASH64:
+      xxh64_init (&hash->state.xxh);
+      break;
+    case GST_CHECKSUM_HASH_MD5:
+      hash->state.checksum = g_checksum_new (G_CHECKSUM_MD5);
+      break;
+    case GST_CHECKSUM_HASH_SHA256:
+      hash->state.checksum = g_checksum_new (G_CHECKSUM_SHA256);
+      break;
+    case GST_CHECKSUM_HASH_SHA1:
+    default:
+      hash->type = GST_CHECKSUM_HASH_SHA1;
+      hash->state.checksum = g_checksum_new (G_CHECKSUM_SHA1);
+      break;
+  }
+
+  return hash;
+}
+
+void
+gst_checksum_hash_update (GstChecksumHash * hash, const guint8 * data,
+    gsize size)
+{
+  switch (hash->type) {
+    case GST_CHECKSUM_HASH_CRC32C:
+      hash->state.crc = crc32c_update (hash->state.crc, data, size);
+      break;
+    case GST_CHECKSUM_HASH_XXHASH64:
+      xxh64_update (&hash->state.xxh, data, size);
+      break;
+    default:
+      g_checksum_update (hash->state.checksum, data, size);
+      break;
+  }
+}
+
+gchar *
+gst_checksum_hash_get_string (GstChecksumHash * hash)
+{
+  switch (hash->type) {
+    case GST_CHECKSUM_HASH_CRC32C:
+      return g_strdup_printf ("%08x", hash->state.crc ^ 0xffffffff);
+    case GST_CHECKSUM_HASH_XXHASH64:
+      return g_strdup_printf ("%016" G_GINT64_MODIFIER "x",
+          xxh64_digest (&hash->state.xxh));
+    default:
+      return g_strdup (g_checksum_get_string (hash->state.checksum));
+  }
+}
+
+void
+gst_checksum_hash_free (GstChecksumHash * hash)
+{
+  switch (hash->type) {
+    case GST_CHECKSUM_HASH_CRC32C:
+    case GST_CHECKSUM_HASH_XXHASH64:
+      break;
+    default:
+      g_checksum_free (hash->state.checksum);
+      break;
+  }
+
+  g_slice_free (GstChecksumHash, hash);
+}
@@ -0,0 +1,52 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_CHECKSUM_HASH_H_
+#define _GST_CHECKSUM_HASH_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  GST_CHECKSUM_HASH_SHA1,
+  GST_CHECKSUM_HASH_MD5,
+  GST_CHECKSUM_HASH_SHA256,
+  GST_CHECKSUM_HASH_CRC32C,
+  GST_CHECKSUM_HASH_XXHASH64
+} GstChecksumHashType;
+
+/* Incremental hash over GChecksum or one of the non-cryptographic hashes,
+ * which are many times faster and good enough to detect changed output. */
+typedef struct _GstChecksumHash GstChecksumHash;
+
+G_GNUC_INTERNAL
+GstChecksumHash *gst_checksum_hash_new (GstChecksumHashType type);
+G_GNUC_INTERNAL
+void gst_checksum_hash_update (GstChecksumHash * hash, const guint8 * data,
+                               gsize size);
+/* the hash can't be updated anymore afterwards */
+G_GNUC_INTERNAL
+gchar *gst_checksum_hash_get_string (GstChecksumHash * hash);
+G_GNUC_INTERNAL
+void gst_checksum_hash_free (GstChecksumHash * hash);
+
+G_END_DECLS
+
+#endif
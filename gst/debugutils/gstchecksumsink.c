@@ -17,22 +17,116 @@
  * Boston, MA 02110-1301, USA.
  */
 
+/**
+ * SECTION:element-checksumsink
+ *
+ * Prints a checksum of every buffer, together with its timestamp.
+ *
+ * Besides the checksums of GChecksum, the much faster CRC32C and XXH64
+ * hashes can be selected with #GstChecksumSink:hash. For raw video
+ * #GstChecksumSink:plane-checksums prints one checksum per plane, over the
+ * visible pixels only, so that the checksums don't depend on the padding
+ * and strides of the frames. Buffers are hashed by #GstChecksumSink:n-threads
+ * threads and printed in stream order.
+ *
+ * With #GstChecksumSink:golden-file, the checksums are compared to the
+ * ones in a file in the output format, the first frame that doesn't match
+ * is posted as a "checksum-mismatch" element message with the fields:
+ * <itemizedlist>
+ * <listitem><para>guint64 frame-number: number of the frame, from 0</para></listitem>
+ * <listitem><para>GstClockTime timestamp: timestamp of the frame</para></listitem>
+ * <listitem><para>gchararray expected: checksum in the file, NULL if the file has no more lines</para></listitem>
+ * <listitem><para>gchararray actual: checksum of the frame, NULL if the stream ended early</para></listitem>
+ * </itemizedlist>
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 filesrc location=test.mkv ! decodebin ! checksumsink hash=xxhash64 plane-checksums=true n-threads=0 golden-file=test.golden
+ * ]|
+ * </refsect2>
+ */
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#include <string.h>
 #include <gst/gst.h>
 #include <gst/base/gstbasesink.h>
 #include "gstchecksumsink.h"
 
-static void gst_checksum_sink_dispose (GObject * object);
+GST_DEBUG_CATEGORY_STATIC (gst_checksum_sink_debug);
+#define GST_CAT_DEFAULT gst_checksum_sink_debug
+
+enum
+{
+  PROP_0,
+  PROP_HASH,
+  PROP_PLANE_CHECKSUMS,
+  PROP_N_THREADS,
+  PROP_GOLDEN_FILE
+};
+
+#define DEFAULT_HASH GST_CHECKSUM_HASH_SHA1
+#define DEFAULT_PLANE_CHECKSUMS FALSE
+#define DEFAULT_N_THREADS 1
+#define DEFAULT_GOLDEN_FILE NULL
+
+/* frames queued per hashing thread */
+#define JOBS_PER_THREAD 2
+
+typedef struct
+{
+  GstBuffer *buffer;
+  GstChecksumHashType hash;
+  gboolean plane_checksums;
+  gboolean is_video;
+  GstVideoInfo info;
+
+  gchar *checksum;
+  gboolean done;
+} GstChecksumSinkJob;
+
+#define GST_TYPE_CHECKSUM_SINK_HASH (gst_checksum_sink_hash_get_type())
+static GType
+gst_checksum_sink_hash_get_type (void)
+{
+  static volatile gsize hash_type = 0;
+
+  static const GEnumValue hash_types[] = {
+    {GST_CHECKSUM_HASH_SHA1, "SHA-1", "sha1"},
+    {GST_CHECKSUM_HASH_MD5, "MD5", "md5"},
+    {GST_CHECKSUM_HASH_SHA256, "SHA-256", "sha256"},
+    {GST_CHECKSUM_HASH_CRC32C, "CRC32C", "crc32c"},
+    {GST_CHECKSUM_HASH_XXHASH64, "XXH64", "xxhash64"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&hash_type)) {
+    GType tmp = g_enum_register_static ("GstChecksumSinkHash", hash_types);
+    g_once_init_leave (&hash_type, tmp);
+  }
+  return (GType) hash_type;
+}
+
+static void gst_checksum_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_checksum_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 static void gst_checksum_sink_finalize (GObject * object);
 
 static gboolean gst_checksum_sink_start (GstBaseSink * sink);
 static gboolean gst_checksum_sink_stop (GstBaseSink * sink);
+static gboolean gst_checksum_sink_set_caps (GstBaseSink * sink,
+    GstCaps * caps);
+static gboolean gst_checksum_sink_event (GstBaseSink * sink, GstEvent * event);
 static GstFlowReturn
 gst_checksum_sink_render (GstBaseSink * sink, GstBuffer * buffer);
 
+static void gst_checksum_sink_hash_job (GstChecksumSinkJob * job,
+    GstChecksumSink * checksumsink);
+
 static GstStaticPadTemplate gst_checksum_sink_sink_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -48,7 +142,9 @@ GST_STATIC_PAD_TEMPLATE ("src",
 /* class initialization */
 
 #define gst_checksum_sink_parent_class parent_class
-G_DEFINE_TYPE (GstChecksumSink, gst_checksum_sink, GST_TYPE_BASE_SINK);
+G_DEFINE_TYPE_WITH_CODE (GstChecksumSink, gst_checksum_sink,
+    GST_TYPE_BASE_SINK, GST_DEBUG_CATEGORY_INIT (gst_checksum_sink_debug,
+        "checksumsink", 0, "debug category for checksumsink element"));
 
 static void
 gst_checksum_sink_class_init (GstChecksumSinkClass * klass)
@@ -57,12 +153,36 @@ gst_checksum_sink_class_init (GstChecksumSinkClass * klass)
   GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
   GstBaseSinkClass *base_sink_class = GST_BASE_SINK_CLASS (klass);
 
-  gobject_class->dispose = gst_checksum_sink_dispose;
+  gobject_class->set_property = gst_checksum_sink_set_property;
+  gobject_class->get_property = gst_checksum_sink_get_property;
   gobject_class->finalize = gst_checksum_sink_finalize;
   base_sink_class->start = GST_DEBUG_FUNCPTR (gst_checksum_sink_start);
   base_sink_class->stop = GST_DEBUG_FUNCPTR (gst_checksum_sink_stop);
+  base_sink_class->set_caps = GST_DEBUG_FUNCPTR (gst_checksum_sink_set_caps);
+  base_sink_class->event = GST_DEBUG_FUNCPTR (gst_checksum_sink_event);
   base_sink_class->render = GST_DEBUG_FUNCPTR (gst_checksum_sink_render);
 
+  g_object_class_install_property (gobject_class, PROP_HASH,
+      g_param_spec_enum ("hash", "Hash", "Checksum type",
+          GST_TYPE_CHECKSUM_SINK_HASH, DEFAULT_HASH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_PLANE_CHECKSUMS,
+      g_param_spec_boolean ("plane-checksums", "Plane checksums",
+          "Print one checksum per plane of raw video frames, excluding "
+          "the padding", DEFAULT_PLANE_CHECKSUMS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to hash buffers with, 1 hashes in the streaming "
+          "thread, 0 for the number of processors (takes effect on the next "
+          "start)", 0, G_MAXUINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_GOLDEN_FILE,
+      g_param_spec_string ("golden-file", "Golden file",
+          "File with the expected output to compare the checksums with "
+          "(takes effect on the next start)", DEFAULT_GOLDEN_FILE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&gst_checksum_sink_src_template));
   gst_element_class_add_pad_template (element_class,
@@ -77,45 +197,366 @@ static void
 gst_checksum_sink_init (GstChecksumSink * checksumsink)
 {
   gst_base_sink_set_sync (GST_BASE_SINK (checksumsink), FALSE);
+
+  checksumsink->hash = DEFAULT_HASH;
+  checksumsink->plane_checksums = DEFAULT_PLANE_CHECKSUMS;
+  checksumsink->n_threads = DEFAULT_N_THREADS;
+  checksumsink->golden_file = DEFAULT_GOLDEN_FILE;
+
+  g_mutex_init (&checksumsink->lock);
+  g_cond_init (&checksumsink->cond);
+  g_queue_init (&checksumsink->jobs);
+}
+
+void
+gst_checksum_sink_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (object);
+
+  switch (prop_id) {
+    case PROP_HASH:
+      checksumsink->hash = g_value_get_enum (value);
+      break;
+    case PROP_PLANE_CHECKSUMS:
+      checksumsink->plane_checksums = g_value_get_boolean (value);
+      break;
+    case PROP_N_THREADS:
+      checksumsink->n_threads = g_value_get_uint (value);
+      break;
+    case PROP_GOLDEN_FILE:
+      g_free (checksumsink->golden_file);
+      checksumsink->golden_file = g_value_dup_string (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
 }
 
 void
-gst_checksum_sink_dispose (GObject * object)
+gst_checksum_sink_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
 {
-  G_OBJECT_CLASS (parent_class)->dispose (object);
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (object);
+
+  switch (prop_id) {
+    case PROP_HASH:
+      g_value_set_enum (value, checksumsink->hash);
+      break;
+    case PROP_PLANE_CHECKSUMS:
+      g_value_set_boolean (value, checksumsink->plane_checksums);
+      break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, checksumsink->n_threads);
+      break;
+    case PROP_GOLDEN_FILE:
+      g_value_set_string (value, checksumsink->golden_file);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
 }
 
 void
 gst_checksum_sink_finalize (GObject * object)
 {
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (object);
+
+  g_free (checksumsink->golden_file);
+  g_mutex_clear (&checksumsink->lock);
+  g_cond_clear (&checksumsink->cond);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* Reads the last word of every line, as printed by the element */
+static gboolean
+gst_checksum_sink_load_golden (GstChecksumSink * checksumsink)
+{
+  GError *err = NULL;
+  gchar *contents;
+  gchar **lines;
+  guint i;
+
+  if (!g_file_get_contents (checksumsink->golden_file, &contents, NULL, &err)) {
+    GST_ELEMENT_ERROR (checksumsink, RESOURCE, OPEN_READ,
+        ("Could not read golden file \"%s\".", checksumsink->golden_file),
+        ("%s", err->message));
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  checksumsink->golden = g_ptr_array_new_with_free_func (g_free);
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    gchar *line = g_strstrip (lines[i]);
+    gchar *checksum;
+
+    if (line[0] == '\0' || line[0] == '#')
+      continue;
+
+    checksum = strrchr (line, ' ');
+    checksum = checksum ? checksum + 1 : line;
+    g_ptr_array_add (checksumsink->golden, g_strdup (checksum));
+  }
+  g_strfreev (lines);
+  g_free (contents);
+
+  GST_DEBUG_OBJECT (checksumsink, "loaded %u checksums from %s",
+      checksumsink->golden->len, checksumsink->golden_file);
+
+  return TRUE;
+}
+
 static gboolean
 gst_checksum_sink_start (GstBaseSink * sink)
 {
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+  guint n_threads;
+
+  checksumsink->n_frames = 0;
+  checksumsink->mismatch_posted = FALSE;
+  checksumsink->is_video = FALSE;
+
+  if (checksumsink->golden_file &&
+      !gst_checksum_sink_load_golden (checksumsink))
+    return FALSE;
+
+  n_threads = checksumsink->n_threads;
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  if (n_threads > 1) {
+    checksumsink->pool =
+        g_thread_pool_new ((GFunc) gst_checksum_sink_hash_job, checksumsink,
+        n_threads, FALSE, NULL);
+    checksumsink->max_jobs = n_threads * JOBS_PER_THREAD;
+  }
+
   return TRUE;
 }
 
 static gboolean
 gst_checksum_sink_stop (GstBaseSink * sink)
 {
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+
+  /* runs the remaining jobs, they print their checksums in order */
+  if (checksumsink->pool) {
+    g_thread_pool_free (checksumsink->pool, FALSE, TRUE);
+    checksumsink->pool = NULL;
+  }
+
+  if (checksumsink->golden) {
+    g_ptr_array_unref (checksumsink->golden);
+    checksumsink->golden = NULL;
+  }
+
   return TRUE;
 }
 
+static gboolean
+gst_checksum_sink_set_caps (GstBaseSink * sink, GstCaps * caps)
+{
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+  GstStructure *s = gst_caps_get_structure (caps, 0);
+
+  checksumsink->is_video = gst_structure_has_name (s, "video/x-raw") &&
+      gst_video_info_from_caps (&checksumsink->info, caps);
+
+  return TRUE;
+}
+
+static void
+gst_checksum_sink_post_mismatch (GstChecksumSink * checksumsink,
+    GstClockTime timestamp, const gchar * expected, const gchar * actual)
+{
+  GST_WARNING_OBJECT (checksumsink, "frame %" G_GUINT64_FORMAT " at %"
+      GST_TIME_FORMAT " has checksum %s, expected %s", checksumsink->n_frames,
+      GST_TIME_ARGS (timestamp), GST_STR_NULL (actual),
+      GST_STR_NULL (expected));
+
+  checksumsink->mismatch_posted = TRUE;
+  gst_element_post_message (GST_ELEMENT_CAST (checksumsink),
+      gst_message_new_element (GST_OBJECT_CAST (checksumsink),
+          gst_structure_new ("checksum-mismatch",
+              "frame-number", G_TYPE_UINT64, checksumsink->n_frames,
+              "timestamp", G_TYPE_UINT64, timestamp,
+              "expected", G_TYPE_STRING, expected,
+              "actual", G_TYPE_STRING, actual, NULL)));
+}
+
+/* called for each frame in stream order */
+static void
+gst_checksum_sink_output (GstChecksumSink * checksumsink, GstBuffer * buffer,
+    const gchar * checksum)
+{
+  g_print ("%" GST_TIME_FORMAT " %s\n",
+      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)), checksum);
+
+  if (checksumsink->golden && !checksumsink->mismatch_posted) {
+    const gchar *expected = NULL;
+
+    if (checksumsink->n_frames < checksumsink->golden->len)
+      expected = g_ptr_array_index (checksumsink->golden,
+          checksumsink->n_frames);
+
+    if (g_strcmp0 (expected, checksum) != 0)
+      gst_checksum_sink_post_mismatch (checksumsink,
+          GST_BUFFER_TIMESTAMP (buffer), expected, checksum);
+  }
+
+  checksumsink->n_frames++;
+}
+
+static gchar *
+gst_checksum_sink_compute (GstChecksumSinkJob * job)
+{
+  GstChecksumHash *hash;
+  GstVideoFrame frame;
+  GString *result;
+  guint plane, comp;
+
+  if (!job->plane_checksums || !job->is_video ||
+      !gst_video_frame_map (&frame, &job->info, job->buffer, GST_MAP_READ)) {
+    GstMapInfo map;
+    gchar *checksum;
+
+    if (!gst_buffer_map (job->buffer, &map, GST_MAP_READ))
+      return NULL;
+
+    hash = gst_checksum_hash_new (job->hash);
+    gst_checksum_hash_update (hash, map.data, map.size);
+    checksum = gst_checksum_hash_get_string (hash);
+    gst_checksum_hash_free (hash);
+    gst_buffer_unmap (job->buffer, &map);
+
+    return checksum;
+  }
+
+  result = g_string_new (NULL);
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (&frame); plane++) {
+    const guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (&frame, plane);
+    gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame, plane);
+    gint row_size = ABS (stride), height = 0, y;
+    gchar *checksum;
+
+    /* the visible bytes of a row follow from any component of the plane,
+     * formats without a pixel stride are hashed with the full stride */
+    for (comp = 0; comp < GST_VIDEO_FRAME_N_COMPONENTS (&frame); comp++) {
+      if (GST_VIDEO_FRAME_COMP_PLANE (&frame, comp) != plane)
+        continue;
+      if (GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, comp) > 0)
+        row_size = GST_VIDEO_FRAME_COMP_WIDTH (&frame, comp) *
+            GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, comp);
+      height = GST_VIDEO_FRAME_COMP_HEIGHT (&frame, comp);
+      break;
+    }
+
+    hash = gst_checksum_hash_new (job->hash);
+    for (y = 0; y < height; y++)
+      gst_checksum_hash_update (hash, data + y * stride, row_size);
+    checksum = gst_checksum_hash_get_string (hash);
+    gst_checksum_hash_free (hash);
+
+    if (plane > 0)
+      g_string_append_c (result, ':');
+    g_string_append (result, checksum);
+    g_free (checksum);
+  }
+  gst_video_frame_unmap (&frame);
+
+  return g_string_free (result, FALSE);
+}
+
+static void
+gst_checksum_sink_job_free (GstChecksumSinkJob * job)
+{
+  gst_buffer_unref (job->buffer);
+  g_free (job->checksum);
+  g_slice_free (GstChecksumSinkJob, job);
+}
+
+/* runs in the thread pool, the finished jobs at the head of the queue are
+ * output by whichever thread completes the first of them */
+static void
+gst_checksum_sink_hash_job (GstChecksumSinkJob * job,
+    GstChecksumSink * checksumsink)
+{
+  job->checksum = gst_checksum_sink_compute (job);
+
+  g_mutex_lock (&checksumsink->lock);
+  job->done = TRUE;
+  while ((job = g_queue_peek_head (&checksumsink->jobs)) && job->done) {
+    g_queue_pop_head (&checksumsink->jobs);
+    gst_checksum_sink_output (checksumsink, job->buffer,
+        GST_STR_NULL (job->checksum));
+    gst_checksum_sink_job_free (job);
+  }
+  g_cond_broadcast (&checksumsink->cond);
+  g_mutex_unlock (&checksumsink->lock);
+}
+
+static void
+gst_checksum_sink_wait_jobs (GstChecksumSink * checksumsink)
+{
+  g_mutex_lock (&checksumsink->lock);
+  while (!g_queue_is_empty (&checksumsink->jobs))
+    g_cond_wait (&checksumsink->cond, &checksumsink->lock);
+  g_mutex_unlock (&checksumsink->lock);
+}
+
+static gboolean
+gst_checksum_sink_event (GstBaseSink * sink, GstEvent * event)
+{
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
+    gst_checksum_sink_wait_jobs (checksumsink);
+
+    /* the golden file has more frames than the stream */
+    if (checksumsink->golden && !checksumsink->mismatch_posted &&
+        checksumsink->n_frames < checksumsink->golden->len)
+      gst_checksum_sink_post_mismatch (checksumsink, GST_CLOCK_TIME_NONE,
+          g_ptr_array_index (checksumsink->golden, checksumsink->n_frames),
+          NULL);
+  }
+
+  return GST_BASE_SINK_CLASS (parent_class)->event (sink, event);
+}
+
 static GstFlowReturn
 gst_checksum_sink_render (GstBaseSink * sink, GstBuffer * buffer)
 {
-  gchar *s;
-  GstMapInfo map;
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+  GstChecksumSinkJob *job;
 
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  s = g_compute_checksum_for_data (G_CHECKSUM_SHA1, map.data, map.size);
-  gst_buffer_unmap (buffer, &map);
-  g_print ("%" GST_TIME_FORMAT " %s\n",
-      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)), s);
+  job = g_slice_new0 (GstChecksumSinkJob);
+  job->buffer = gst_buffer_ref (buffer);
+  job->hash = checksumsink->hash;
+  job->plane_checksums = checksumsink->plane_checksums;
+  job->is_video = checksumsink->is_video;
+  if (job->is_video)
+    job->info = checksumsink->info;
+
+  if (!checksumsink->pool) {
+    job->checksum = gst_checksum_sink_compute (job);
+    gst_checksum_sink_output (checksumsink, buffer,
+        GST_STR_NULL (job->checksum));
+    gst_checksum_sink_job_free (job);
+    return GST_FLOW_OK;
+  }
+
+  g_mutex_lock (&checksumsink->lock);
+  while (checksumsink->jobs.length >= checksumsink->max_jobs)
+    g_cond_wait (&checksumsink->cond, &checksumsink->lock);
+  g_queue_push_tail (&checksumsink->jobs, job);
+  g_mutex_unlock (&checksumsink->lock);
 
-  g_free (s);
+  g_thread_pool_push (checksumsink->pool, job, NULL);
 
   return GST_FLOW_OK;
 }
@@ -22,6 +22,9 @@
 
 #include <gst/gst.h>
 #include <gst/base/gstbasesink.h>
+#include <gst/video/video.h>
+
+#include "gstchecksumhash.h"
 
 G_BEGIN_DECLS
 
@@ -38,6 +41,26 @@ struct _GstChecksumSink
 {
   GstBaseSink base_checksumsink;
 
+  /* properties */
+  GstChecksumHashType hash;
+  gboolean plane_checksums;
+  guint n_threads;
+  gchar *golden_file;
+
+  GstVideoInfo info;
+  gboolean is_video;
+
+  /* hashing jobs in stream order, protected by lock */
+  GThreadPool *pool;
+  guint max_jobs;
+  GMutex lock;
+  GCond cond;
+  GQueue jobs;
+  guint64 n_frames;
+
+  /* expected checksums, one per frame */
+  GPtrArray *golden;
+  gboolean mismatch_posted;
 };
 
 struct _GstChecksumSinkClass
@@ -0,0 +1,127 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstprofilemeta.h"
+
+static gboolean
+gst_profile_meta_init (GstProfileMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  meta->name = 0;
+  meta->time = GST_CLOCK_TIME_NONE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_profile_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstProfileMeta *smeta = (GstProfileMeta *) meta;
+
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    /* parts of the buffer went through the stamp at the same time as the
+     * whole, so regions keep the stamp too */
+    if (!gst_buffer_add_profile_meta (dest, smeta->name, smeta->time))
+      return FALSE;
+  } else {
+    /* return FALSE, if transform type is not supported */
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+GType
+gst_profile_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstProfileMetaAPI", tags);
+
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+const GstMetaInfo *
+gst_profile_meta_get_info (void)
+{
+  static const GstMetaInfo *profile_meta_info = NULL;
+
+  if (g_once_init_enter (&profile_meta_info)) {
+    const GstMetaInfo *meta = gst_meta_register (GST_PROFILE_META_API_TYPE,
+        "GstProfileMeta", sizeof (GstProfileMeta),
+        (GstMetaInitFunction) gst_profile_meta_init,
+        (GstMetaFreeFunction) NULL,
+        (GstMetaTransformFunction) gst_profile_meta_transform);
+    g_once_init_leave (&profile_meta_info, meta);
+  }
+
+  return profile_meta_info;
+}
+
+/* Adds a stamp named @name to @buffer, or updates the existing one */
+GstProfileMeta *
+gst_buffer_add_profile_meta (GstBuffer * buffer, GQuark name,
+    GstClockTime time)
+{
+  GstProfileMeta *meta;
+
+  meta = gst_buffer_get_profile_meta (buffer, name);
+  if (meta == NULL) {
+    meta = (GstProfileMeta *) gst_buffer_add_meta (buffer,
+        GST_PROFILE_META_INFO, NULL);
+    meta->name = name;
+  }
+  meta->time = time;
+
+  return meta;
+}
+
+/* Returns the stamp named @name, or the most recent one if @name is 0 */
+GstProfileMeta *
+gst_buffer_get_profile_meta (GstBuffer * buffer, GQuark name)
+{
+  GstProfileMeta *found = NULL;
+  gpointer state = NULL;
+  GstMeta *meta;
+
+  while ((meta = gst_buffer_iterate_meta (buffer, &state))) {
+    GstProfileMeta *pmeta;
+
+    if (meta->info->api != GST_PROFILE_META_API_TYPE)
+      continue;
+
+    pmeta = (GstProfileMeta *) meta;
+    if (name != 0) {
+      if (pmeta->name == name)
+        return pmeta;
+    } else if (found == NULL || pmeta->time > found->time) {
+      found = pmeta;
+    }
+  }
+
+  return found;
+}
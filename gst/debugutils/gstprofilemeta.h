@@ -0,0 +1,60 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PROFILE_META_H__
+#define __GST_PROFILE_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_PROFILE_META_API_TYPE (gst_profile_meta_api_get_type())
+#define GST_PROFILE_META_INFO (gst_profile_meta_get_info())
+
+typedef struct _GstProfileMeta GstProfileMeta;
+
+/**
+ * GstProfileMeta:
+ * @meta: parent #GstMeta
+ * @name: the name of the profilestamp element that added the meta
+ * @time: the time from gst_util_get_timestamp() at which the buffer went
+ *     through that element
+ *
+ * Stamp put on buffers by profilestamp and measured by profilemeter.
+ * A buffer can carry a stamp for each point of the pipeline it went
+ * through.
+ */
+struct _GstProfileMeta
+{
+  GstMeta meta;
+
+  GQuark name;
+  GstClockTime time;
+};
+
+G_GNUC_INTERNAL GType gst_profile_meta_api_get_type (void);
+G_GNUC_INTERNAL const GstMetaInfo *gst_profile_meta_get_info (void);
+
+G_GNUC_INTERNAL GstProfileMeta *gst_buffer_add_profile_meta (GstBuffer * buffer,
+    GQuark name, GstClockTime time);
+G_GNUC_INTERNAL GstProfileMeta *gst_buffer_get_profile_meta (GstBuffer * buffer,
+    GQuark name);
+
+G_END_DECLS
+
+#endif /* __GST_PROFILE_META_H__ */
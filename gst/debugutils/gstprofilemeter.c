@@ -0,0 +1,549 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:element-profilemeter
+ * @see_also: profilestamp
+ *
+ * The profilemeter element measures the buffers going through it. It
+ * records the time since they went through a profilestamp element, the
+ * time between buffers and the throughput. Every #GstProfileMeter:interval
+ * milliseconds and at EOS, it posts an element message named
+ * "profilemeter" with the measurements since the previous one:
+ *
+ * <itemizedlist>
+ * <listitem><para>"stamp-name" G_TYPE_STRING: the stamp that was measured,
+ * NULL for the most recent stamp of each buffer</para></listitem>
+ * <listitem><para>"duration" G_TYPE_UINT64: time covered by the
+ * message</para></listitem>
+ * <listitem><para>"buffers", "bytes" G_TYPE_UINT64: amount of data that went
+ * through</para></listitem>
+ * <listitem><para>"buffers-per-second", "bytes-per-second" G_TYPE_DOUBLE:
+ * throughput</para></listitem>
+ * <listitem><para>"latency-min", "latency-max", "latency-mean",
+ * "latency-p50", "latency-p90", "latency-p99" G_TYPE_UINT64: time since the
+ * stamp, only for stamped buffers</para></listitem>
+ * <listitem><para>"interarrival-min", "interarrival-max", "interarrival-mean",
+ * "interarrival-p50", "interarrival-p90", "interarrival-p99" G_TYPE_UINT64:
+ * time between buffers</para></listitem>
+ * <listitem><para>"jitter" G_TYPE_UINT64: variation of the time between
+ * buffers, smoothed as in RFC 3550</para></listitem>
+ * <listitem><para>"throughput-min", "throughput-max", "throughput-mean",
+ * "throughput-p50", "throughput-p90", "throughput-p99" G_TYPE_UINT64: bytes
+ * per second of each buffer, its size over the time since the previous
+ * buffer</para></listitem>
+ * <listitem><para>"latency-histogram", "interarrival-histogram"
+ * GST_TYPE_ARRAY of G_TYPE_UINT64: number of values in microseconds
+ * between successive powers of two, the first one counts values below
+ * 2us and the last one values above 2^31us</para></listitem>
+ * <listitem><para>"throughput-histogram" GST_TYPE_ARRAY of G_TYPE_UINT64:
+ * the same for the throughput in KiB per second</para></listitem>
+ * </itemizedlist>
+ *
+ * Times are in nanoseconds. Percentiles are within 1/16th of their
+ * value. The same fields for everything measured since the element
+ * started are in the #GstProfileMeter:stats property.
+ *
+ * Several profilestamp/profilemeter pairs can be used in one pipeline to
+ * find out which part of it adds latency.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 -m videotestsrc ! profilestamp stamp-name=in ! videoconvert ! videoscale ! profilemeter stamp-name=in ! fakesink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include "gstprofilemeter.h"
+#include "gstprofilemeta.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_profile_meter_debug);
+#define GST_CAT_DEFAULT gst_profile_meter_debug
+
+#define DEFAULT_INTERVAL 1000
+
+/* coarse histograms in the messages */
+#define N_COARSE_BUCKETS 32
+
+enum
+{
+  PROP_0,
+  PROP_STAMP_NAME,
+  PROP_INTERVAL,
+  PROP_STATS
+};
+
+static void gst_profile_meter_set_property (GObject * object,
+    guint prop_id, const GValue * value, GParamSpec * pspec);
+static void gst_profile_meter_get_property (GObject * object,
+    guint prop_id, GValue * value, GParamSpec * pspec);
+static void gst_profile_meter_finalize (GObject * object);
+
+static gboolean gst_profile_meter_start (GstBaseTransform * trans);
+static gboolean gst_profile_meter_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
+static GstFlowReturn gst_profile_meter_transform_ip (GstBaseTransform * trans,
+    GstBuffer * buf);
+
+static GstStaticPadTemplate gst_profile_meter_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate gst_profile_meter_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+#define gst_profile_meter_parent_class parent_class
+G_DEFINE_TYPE (GstProfileMeter, gst_profile_meter, GST_TYPE_BASE_TRANSFORM);
+
+static void
+gst_profile_meter_class_init (GstProfileMeterClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS (klass);
+
+  gobject_class->set_property = gst_profile_meter_set_property;
+  gobject_class->get_property = gst_profile_meter_get_property;
+  gobject_class->finalize = gst_profile_meter_finalize;
+
+  trans_class->start = GST_DEBUG_FUNCPTR (gst_profile_meter_start);
+  trans_class->sink_event = GST_DEBUG_FUNCPTR (gst_profile_meter_sink_event);
+  trans_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_profile_meter_transform_ip);
+
+  g_object_class_install_property (gobject_class, PROP_STAMP_NAME,
+      g_param_spec_string ("stamp-name", "Stamp name",
+          "Name of the profilestamp to measure the latency from, "
+          "NULL for the most recent stamp of each buffer", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_INTERVAL,
+      g_param_spec_uint ("interval", "Interval",
+          "Interval in ms between messages, 0 to only post one at EOS",
+          0, G_MAXUINT, DEFAULT_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Stats",
+          "Measurements since the element started, with the same fields "
+          "as the messages", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_profile_meter_src_template));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_profile_meter_sink_template));
+
+  gst_element_class_set_static_metadata (element_class, "Profile meter",
+      "Filter/Analyzer/Debug", "Measures the latency since a profilestamp, "
+      "the jitter and the throughput of buffers", "agent <agent@local>");
+
+  GST_DEBUG_CATEGORY_INIT (gst_profile_meter_debug, "profilemeter", 0,
+      "profilemeter element");
+}
+
+static void
+gst_profile_meter_init (GstProfileMeter * meter)
+{
+  meter->interval = DEFAULT_INTERVAL;
+
+  gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (meter), TRUE);
+}
+
+static void
+gst_profile_meter_finalize (GObject * object)
+{
+  GstProfileMeter *meter = GST_PROFILE_METER (object);
+
+  g_free (meter->stamp_name);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static guint
+msb64 (guint64 v)
+{
+  guint n = 0;
+
+  if (v >> 32) {
+    v >>= 32;
+    n += 32;
+  }
+  if (v >> 16) {
+    v >>= 16;
+    n += 16;
+  }
+  if (v >> 8) {
+    v >>= 8;
+    n += 8;
+  }
+  if (v >> 4) {
+    v >>= 4;
+    n += 4;
+  }
+  if (v >> 2) {
+    v >>= 2;
+    n += 2;
+  }
+  if (v >> 1)
+    n += 1;
+
+  return n;
+}
+
+static guint
+histogram_bucket (guint64 value)
+{
+  guint e;
+
+  if (value < (1 << GST_PROFILE_HISTOGRAM_SUB_BITS))
+    return value;
+
+  e = msb64 (value);
+  return ((e - GST_PROFILE_HISTOGRAM_SUB_BITS + 1) <<
+      GST_PROFILE_HISTOGRAM_SUB_BITS) +
+      ((value >> (e - GST_PROFILE_HISTOGRAM_SUB_BITS)) &
+      ((1 << GST_PROFILE_HISTOGRAM_SUB_BITS) - 1));
+}
+
+/* Smallest value counted in @bucket, the bucket is @width wide */
+static guint64
+histogram_bucket_start (guint bucket, guint64 * width)
+{
+  guint shift, mantissa;
+
+  if (bucket < (1 << GST_PROFILE_HISTOGRAM_SUB_BITS)) {
+    *width = 1;
+    return bucket;
+  }
+
+  shift = (bucket >> GST_PROFILE_HISTOGRAM_SUB_BITS) - 1;
+  mantissa = bucket & ((1 << GST_PROFILE_HISTOGRAM_SUB_BITS) - 1);
+  *width = G_GUINT64_CONSTANT (1) << shift;
+
+  return (guint64) ((1 << GST_PROFILE_HISTOGRAM_SUB_BITS) + mantissa) << shift;
+}
+
+static void
+histogram_add (GstProfileHistogram * h, guint64 value)
+{
+  if (h->count == 0 || value < h->min)
+    h->min = value;
+  if (value > h->max)
+    h->max = value;
+  h->count++;
+  h->sum += value;
+  h->buckets[histogram_bucket (value)]++;
+}
+
+static guint64
+histogram_percentile (const GstProfileHistogram * h, guint percent)
+{
+  guint64 rank, seen = 0;
+  guint i;
+
+  if (h->count == 0)
+    return 0;
+
+  /* rank of the value, counting from 1 */
+  rank = MAX ((h->count * percent + 99) / 100, 1);
+
+  for (i = 0; i < GST_PROFILE_HISTOGRAM_N_BUCKETS; i++) {
+    seen += h->buckets[i];
+    if (seen >= rank) {
+      guint64 width, start = histogram_bucket_start (i, &width);
+
+      return CLAMP (start + width / 2, h->min, h->max);
+    }
+  }
+
+  return h->max;
+}
+
+static void
+set_field (GstStructure * s, const gchar * prefix, const gchar * field,
+    guint64 value)
+{
+  gchar *name = g_strdup_printf ("%s-%s", prefix, field);
+
+  gst_structure_set (s, name, G_TYPE_UINT64, value, NULL);
+  g_free (name);
+}
+
+/* The coarse histogram counts values in @unit between powers of two */
+static void
+histogram_set_fields (const GstProfileHistogram * h, GstStructure * s,
+    const gchar * prefix, guint64 unit)
+{
+  guint64 coarse[N_COARSE_BUCKETS] = { 0, };
+  GValue array = G_VALUE_INIT;
+  GValue v = G_VALUE_INIT;
+  gchar *name;
+  guint i;
+
+  if (h->count == 0)
+    return;
+
+  set_field (s, prefix, "min", h->min);
+  set_field (s, prefix, "max", h->max);
+  set_field (s, prefix, "mean", h->sum / h->count);
+  set_field (s, prefix, "p50", histogram_percentile (h, 50));
+  set_field (s, prefix, "p90", histogram_percentile (h, 90));
+  set_field (s, prefix, "p99", histogram_percentile (h, 99));
+
+  for (i = 0; i < GST_PROFILE_HISTOGRAM_N_BUCKETS; i++) {
+    guint64 width, v;
+
+    if (h->buckets[i] == 0)
+      continue;
+    v = histogram_bucket_start (i, &width) / unit;
+    coarse[v < 2 ? 0 : MIN (msb64 (v), N_COARSE_BUCKETS - 1)] +=
+        h->buckets[i];
+  }
+
+  g_value_init (&array, GST_TYPE_ARRAY);
+  g_value_init (&v, G_TYPE_UINT64);
+  for (i = 0; i < N_COARSE_BUCKETS; i++) {
+    g_value_set_uint64 (&v, coarse[i]);
+    gst_value_array_append_value (&array, &v);
+  }
+  g_value_unset (&v);
+
+  name = g_strdup_printf ("%s-histogram", prefix);
+  gst_structure_take_value (s, name, &array);
+  g_free (name);
+}
+
+/* Call with the object lock */
+static GstStructure *
+gst_profile_meter_make_structure (GstProfileMeter * meter,
+    const GstProfileMeterStats * stats, GstClockTime now)
+{
+  GstClockTime duration = now - stats->start;
+  GstStructure *s;
+  gdouble seconds;
+
+  seconds = (gdouble) duration / GST_SECOND;
+
+  s = gst_structure_new ("profilemeter",
+      "stamp-name", G_TYPE_STRING, meter->stamp_name,
+      "duration", G_TYPE_UINT64, duration,
+      "buffers", G_TYPE_UINT64, stats->buffers,
+      "bytes", G_TYPE_UINT64, stats->bytes,
+      "buffers-per-second", G_TYPE_DOUBLE,
+      seconds > 0 ? stats->buffers / seconds : 0.0,
+      "bytes-per-second", G_TYPE_DOUBLE,
+      seconds > 0 ? stats->bytes / seconds : 0.0,
+      "jitter", G_TYPE_UINT64, meter->jitter, NULL);
+
+  histogram_set_fields (&stats->latency, s, "latency", GST_USECOND);
+  histogram_set_fields (&stats->interarrival, s, "interarrival", GST_USECOND);
+  histogram_set_fields (&stats->throughput, s, "throughput", 1024);
+
+  return s;
+}
+
+static void
+gst_profile_meter_stats_reset (GstProfileMeterStats * stats,
+    GstClockTime now)
+{
+  memset (stats, 0, sizeof (GstProfileMeterStats));
+  stats->start = now;
+}
+
+static void
+gst_profile_meter_post (GstProfileMeter * meter, GstStructure * s)
+{
+  gst_element_post_message (GST_ELEMENT_CAST (meter),
+      gst_message_new_element (GST_OBJECT_CAST (meter), s));
+}
+
+static void
+gst_profile_meter_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstProfileMeter *meter = GST_PROFILE_METER (object);
+
+  switch (prop_id) {
+    case PROP_STAMP_NAME:
+      GST_OBJECT_LOCK (meter);
+      g_free (meter->stamp_name);
+      meter->stamp_name = g_value_dup_string (value);
+      meter->quark = meter->stamp_name ?
+          g_quark_from_string (meter->stamp_name) : 0;
+      GST_OBJECT_UNLOCK (meter);
+      break;
+    case PROP_INTERVAL:
+      GST_OBJECT_LOCK (meter);
+      meter->interval = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (meter);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_profile_meter_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstProfileMeter *meter = GST_PROFILE_METER (object);
+
+  switch (prop_id) {
+    case PROP_STAMP_NAME:
+      GST_OBJECT_LOCK (meter);
+      g_value_set_string (value, meter->stamp_name);
+      GST_OBJECT_UNLOCK (meter);
+      break;
+    case PROP_INTERVAL:
+      GST_OBJECT_LOCK (meter);
+      g_value_set_uint (value, meter->interval);
+      GST_OBJECT_UNLOCK (meter);
+      break;
+    case PROP_STATS:
+      GST_OBJECT_LOCK (meter);
+      g_value_take_boxed (value, gst_profile_meter_make_structure (meter,
+              &meter->total, gst_util_get_timestamp ()));
+      GST_OBJECT_UNLOCK (meter);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static gboolean
+gst_profile_meter_start (GstBaseTransform * trans)
+{
+  GstProfileMeter *meter = GST_PROFILE_METER (trans);
+  GstClockTime now = gst_util_get_timestamp ();
+
+  GST_OBJECT_LOCK (meter);
+  gst_profile_meter_stats_reset (&meter->current, now);
+  gst_profile_meter_stats_reset (&meter->total, now);
+  meter->last_arrival = GST_CLOCK_TIME_NONE;
+  meter->last_delta = GST_CLOCK_TIME_NONE;
+  meter->jitter = 0;
+  GST_OBJECT_UNLOCK (meter);
+
+  return TRUE;
+}
+
+static gboolean
+gst_profile_meter_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstProfileMeter *meter = GST_PROFILE_METER (trans);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:{
+      GstClockTime now = gst_util_get_timestamp ();
+      GstStructure *s;
+
+      GST_OBJECT_LOCK (meter);
+      s = gst_profile_meter_make_structure (meter, &meter->current, now);
+      gst_profile_meter_stats_reset (&meter->current, now);
+      GST_OBJECT_UNLOCK (meter);
+
+      gst_profile_meter_post (meter, s);
+      break;
+    }
+    case GST_EVENT_FLUSH_STOP:
+      /* the time between buffers across a flush is meaningless */
+      GST_OBJECT_LOCK (meter);
+      meter->last_arrival = GST_CLOCK_TIME_NONE;
+      meter->last_delta = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (meter);
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
+}
+
+static GstFlowReturn
+gst_profile_meter_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstProfileMeter *meter = GST_PROFILE_METER (trans);
+  GstClockTime now = gst_util_get_timestamp ();
+  GstProfileMeta *meta;
+  GstStructure *s = NULL;
+  gsize size = gst_buffer_get_size (buf);
+
+  GST_OBJECT_LOCK (meter);
+
+  meta = gst_buffer_get_profile_meta (buf, meter->quark);
+  if (meta && GST_CLOCK_TIME_IS_VALID (meta->time) && now >= meta->time) {
+    histogram_add (&meter->current.latency, now - meta->time);
+    histogram_add (&meter->total.latency, now - meta->time);
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (meter->last_arrival)) {
+    GstClockTime delta = now - meter->last_arrival;
+
+    histogram_add (&meter->current.interarrival, delta);
+    histogram_add (&meter->total.interarrival, delta);
+
+    if (delta > 0) {
+      guint64 rate = gst_util_uint64_scale (size, GST_SECOND, delta);
+
+      histogram_add (&meter->current.throughput, rate);
+      histogram_add (&meter->total.throughput, rate);
+    }
+
+    if (GST_CLOCK_TIME_IS_VALID (meter->last_delta)) {
+      GstClockTimeDiff d = GST_CLOCK_DIFF (meter->last_delta, delta);
+
+      /* J += (|D| - J) / 16 */
+      meter->jitter = (GstClockTimeDiff) meter->jitter +
+          (ABS (d) - (GstClockTimeDiff) meter->jitter) / 16;
+    }
+    meter->last_delta = delta;
+  }
+  meter->last_arrival = now;
+
+  meter->current.buffers++;
+  meter->current.bytes += size;
+  meter->total.buffers++;
+  meter->total.bytes += size;
+
+  if (meter->interval > 0 &&
+      now - meter->current.start >= meter->interval * GST_MSECOND) {
+    s = gst_profile_meter_make_structure (meter, &meter->current, now);
+    gst_profile_meter_stats_reset (&meter->current, now);
+  }
+
+  GST_OBJECT_UNLOCK (meter);
+
+  if (s)
+    gst_profile_meter_post (meter, s);
+
+  return GST_FLOW_OK;
+}
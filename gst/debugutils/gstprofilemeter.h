@@ -0,0 +1,86 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PROFILE_METER_H__
+#define __GST_PROFILE_METER_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PROFILE_METER            (gst_profile_meter_get_type())
+#define GST_PROFILE_METER(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_PROFILE_METER,GstProfileMeter))
+#define GST_IS_PROFILE_METER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PROFILE_METER))
+#define GST_PROFILE_METER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass) ,GST_TYPE_PROFILE_METER,GstProfileMeterClass))
+#define GST_IS_PROFILE_METER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass) ,GST_TYPE_PROFILE_METER))
+
+typedef struct _GstProfileMeter      GstProfileMeter;
+typedef struct _GstProfileMeterClass GstProfileMeterClass;
+
+/* Values up to 15 have their own bucket, larger ones are split in 16
+ * buckets per power of two, so a bucket is at most 1/16th of its value
+ * wide */
+#define GST_PROFILE_HISTOGRAM_SUB_BITS 4
+#define GST_PROFILE_HISTOGRAM_N_BUCKETS \
+    ((64 - GST_PROFILE_HISTOGRAM_SUB_BITS + 1) << GST_PROFILE_HISTOGRAM_SUB_BITS)
+
+typedef struct {
+  guint64 count;
+  guint64 min, max, sum;
+  guint64 buckets[GST_PROFILE_HISTOGRAM_N_BUCKETS];
+} GstProfileHistogram;
+
+/* What was measured over some time, times are in nanoseconds */
+typedef struct {
+  GstClockTime start;
+  guint64 buffers;
+  guint64 bytes;
+  GstProfileHistogram latency;
+  GstProfileHistogram interarrival;
+  /* bytes per second of each buffer since the previous one */
+  GstProfileHistogram throughput;
+} GstProfileMeterStats;
+
+struct _GstProfileMeter {
+  GstBaseTransform parent;
+
+  /* properties */
+  gchar *stamp_name;
+  guint interval;
+
+  GQuark quark;
+
+  GstClockTime last_arrival;
+  GstClockTime last_delta;
+  GstClockTime jitter;
+
+  /* since the last message and since start */
+  GstProfileMeterStats current;
+  GstProfileMeterStats total;
+};
+
+struct _GstProfileMeterClass {
+  GstBaseTransformClass parent_class;
+};
+
+GType gst_profile_meter_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_PROFILE_METER_H__ */
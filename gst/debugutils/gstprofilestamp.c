@@ -0,0 +1,190 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/**
+ * SECTION:element-profilestamp
+ * @see_also: profilemeter
+ *
+ * The profilestamp element records on each buffer the time at which it
+ * went through, with a meta. A profilemeter element further down the
+ * pipeline measures the time the buffers took to get there.
+ *
+ * The stamp is kept by elements that copy buffer metadata, but is lost
+ * when an element creates new buffers from the data, for example an
+ * encoder; place the pair of elements on each side of the stages to
+ * measure.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 -m videotestsrc ! profilestamp stamp-name=in ! videoconvert ! videoscale ! profilemeter stamp-name=in ! fakesink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include "gstprofilestamp.h"
+#include "gstprofilemeta.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_profile_stamp_debug);
+#define GST_CAT_DEFAULT gst_profile_stamp_debug
+
+enum
+{
+  PROP_0,
+  PROP_STAMP_NAME
+};
+
+static void gst_profile_stamp_set_property (GObject * object,
+    guint prop_id, const GValue * value, GParamSpec * pspec);
+static void gst_profile_stamp_get_property (GObject * object,
+    guint prop_id, GValue * value, GParamSpec * pspec);
+static void gst_profile_stamp_finalize (GObject * object);
+
+static gboolean gst_profile_stamp_start (GstBaseTransform * trans);
+static GstFlowReturn gst_profile_stamp_transform_ip (GstBaseTransform * trans,
+    GstBuffer * buf);
+
+static GstStaticPadTemplate gst_profile_stamp_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate gst_profile_stamp_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+#define gst_profile_stamp_parent_class parent_class
+G_DEFINE_TYPE (GstProfileStamp, gst_profile_stamp, GST_TYPE_BASE_TRANSFORM);
+
+static void
+gst_profile_stamp_class_init (GstProfileStampClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS (klass);
+
+  gobject_class->set_property = gst_profile_stamp_set_property;
+  gobject_class->get_property = gst_profile_stamp_get_property;
+  gobject_class->finalize = gst_profile_stamp_finalize;
+
+  trans_class->start = GST_DEBUG_FUNCPTR (gst_profile_stamp_start);
+  trans_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_profile_stamp_transform_ip);
+
+  g_object_class_install_property (gobject_class, PROP_STAMP_NAME,
+      g_param_spec_string ("stamp-name", "Stamp name",
+          "Name of the stamp, the element name if NULL", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_profile_stamp_src_template));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_profile_stamp_sink_template));
+
+  gst_element_class_set_static_metadata (element_class, "Profile stamp",
+      "Filter/Analyzer/Debug", "Stamps buffers with the time they go "
+      "through, for a profilemeter further down the pipeline",
+      "agent <agent@local>");
+
+  GST_DEBUG_CATEGORY_INIT (gst_profile_stamp_debug, "profilestamp", 0,
+      "profilestamp element");
+}
+
+static void
+gst_profile_stamp_init (GstProfileStamp * stamp)
+{
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (stamp), TRUE);
+}
+
+static void
+gst_profile_stamp_finalize (GObject * object)
+{
+  GstProfileStamp *stamp = GST_PROFILE_STAMP (object);
+
+  g_free (stamp->stamp_name);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_profile_stamp_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstProfileStamp *stamp = GST_PROFILE_STAMP (object);
+
+  switch (prop_id) {
+    case PROP_STAMP_NAME:
+      GST_OBJECT_LOCK (stamp);
+      g_free (stamp->stamp_name);
+      stamp->stamp_name = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (stamp);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_profile_stamp_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstProfileStamp *stamp = GST_PROFILE_STAMP (object);
+
+  switch (prop_id) {
+    case PROP_STAMP_NAME:
+      GST_OBJECT_LOCK (stamp);
+      g_value_set_string (value, stamp->stamp_name);
+      GST_OBJECT_UNLOCK (stamp);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static gboolean
+gst_profile_stamp_start (GstBaseTransform * trans)
+{
+  GstProfileStamp *stamp = GST_PROFILE_STAMP (trans);
+
+  GST_OBJECT_LOCK (stamp);
+  stamp->quark = g_quark_from_string (stamp->stamp_name ?
+      stamp->stamp_name : GST_OBJECT_NAME (stamp));
+  GST_OBJECT_UNLOCK (stamp);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_profile_stamp_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstProfileStamp *stamp = GST_PROFILE_STAMP (trans);
+
+  gst_buffer_add_profile_meta (buf, stamp->quark, gst_util_get_timestamp ());
+
+  return GST_FLOW_OK;
+}
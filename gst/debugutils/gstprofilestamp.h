@@ -0,0 +1,53 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_PROFILE_STAMP_H__
+#define __GST_PROFILE_STAMP_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_PROFILE_STAMP            (gst_profile_stamp_get_type())
+#define GST_PROFILE_STAMP(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_PROFILE_STAMP,GstProfileStamp))
+#define GST_IS_PROFILE_STAMP(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_PROFILE_STAMP))
+#define GST_PROFILE_STAMP_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass) ,GST_TYPE_PROFILE_STAMP,GstProfileStampClass))
+#define GST_IS_PROFILE_STAMP_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass) ,GST_TYPE_PROFILE_STAMP))
+
+typedef struct _GstProfileStamp      GstProfileStamp;
+typedef struct _GstProfileStampClass GstProfileStampClass;
+
+struct _GstProfileStamp {
+  GstBaseTransform parent;
+
+  /* properties */
+  gchar *stamp_name;
+
+  GQuark quark;
+};
+
+struct _GstProfileStampClass {
+  GstBaseTransformClass parent_class;
+};
+
+GType gst_profile_stamp_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_PROFILE_STAMP_H__ */
@@ -32,6 +32,11 @@
  * This element is currently intended for transcoding pipelines,
  * although may be useful in other contexts.
  *
+ * The timers of all watchdog elements are run by a single thread, and
+ * restarting the timer for a buffer only stores the time it was seen. The
+ * number of times the watchdog triggered and the longest pause between
+ * buffers are available in the #GstWatchdog:stats property.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -75,7 +80,8 @@ gst_watchdog_change_state (GstElement * element, GstStateChange transition);
 enum
 {
   PROP_0,
-  PROP_TIMEOUT
+  PROP_TIMEOUT,
+  PROP_STATS
 };
 
 /* class initialization */
@@ -122,6 +128,11 @@ gst_watchdog_class_init (GstWatchdogClass * klass)
           "received. 0 means disabled.", 0, G_MAXINT, 1000,
           G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Stats", "Number of times the watchdog "
+          "triggered (\"stalls\") and longest time between two buffers in "
+          "nanoseconds (\"max-interval\")", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -162,27 +173,34 @@ gst_watchdog_get_property (GObject * object, guint property_id,
     case PROP_TIMEOUT:
       g_value_set_int (value, watchdog->timeout);
       break;
+    case PROP_STATS:{
+      guint n_stalls, max_interval;
+
+      GST_OBJECT_LOCK (watchdog);
+      if (watchdog->timer) {
+        gst_watchdog_timer_get_stats (watchdog->timer, &n_stalls,
+            &max_interval);
+      } else {
+        n_stalls = watchdog->n_stalls;
+        max_interval = watchdog->max_interval;
+      }
+      GST_OBJECT_UNLOCK (watchdog);
+
+      g_value_take_boxed (value,
+          gst_structure_new ("application/x-watchdog-stats",
+              "stalls", G_TYPE_UINT, n_stalls,
+              "max-interval", G_TYPE_UINT64, max_interval * GST_MSECOND,
+              NULL));
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
   }
 }
 
-static gpointer
-gst_watchdog_thread (gpointer user_data)
-{
-  GstWatchdog *watchdog = GST_WATCHDOG (user_data);
-
-  GST_DEBUG_OBJECT (watchdog, "thread starting");
-
-  g_main_loop_run (watchdog->main_loop);
-
-  GST_DEBUG_OBJECT (watchdog, "thread exiting");
-
-  return NULL;
-}
-
-static gboolean
+/* Called from the watchdog timer thread */
+static void
 gst_watchdog_trigger (gpointer ptr)
 {
   GstWatchdog *watchdog = GST_WATCHDOG (ptr);
@@ -191,27 +209,13 @@ gst_watchdog_trigger (gpointer ptr)
 
   GST_ELEMENT_ERROR (watchdog, STREAM, FAILED, ("Watchdog triggered"),
       ("Watchdog triggered"));
-
-  return FALSE;
-}
-
-static gboolean
-gst_watchdog_quit_mainloop (gpointer ptr)
-{
-  GstWatchdog *watchdog = GST_WATCHDOG (ptr);
-
-  GST_DEBUG_OBJECT (watchdog, "watchdog quit");
-
-  g_main_loop_quit (watchdog->main_loop);
-
-  return FALSE;
 }
 
 /*  Call with OBJECT_LOCK taken */
 static void
 gst_watchdog_feed (GstWatchdog * watchdog, gpointer mini_object, gboolean force)
 {
-  if (watchdog->source) {
+  if (watchdog->timer) {
     if (watchdog->waiting_for_flush_start) {
       if (mini_object && GST_IS_EVENT (mini_object) &&
           GST_EVENT_TYPE (mini_object) == GST_EVENT_FLUSH_START) {
@@ -238,24 +242,20 @@ gst_watchdog_feed (GstWatchdog * watchdog, gpointer mini_object, gboolean force)
         force = TRUE;
       }
     }
-    g_source_destroy (watchdog->source);
-    g_source_unref (watchdog->source);
-    watchdog->source = NULL;
-
   }
 
   if (watchdog->timeout == 0) {
     GST_LOG_OBJECT (watchdog, "Timeout is 0 => nothing to do");
-  } else if (watchdog->main_context == NULL) {
-    GST_LOG_OBJECT (watchdog, "No maincontext => nothing to do");
+    if (watchdog->timer)
+      gst_watchdog_timer_disarm (watchdog->timer);
+  } else if (watchdog->timer == NULL) {
+    GST_LOG_OBJECT (watchdog, "No timer => nothing to do");
   } else if ((GST_STATE (watchdog) != GST_STATE_PLAYING) && force == FALSE) {
     GST_LOG_OBJECT (watchdog,
         "Not in playing and force is FALSE => Nothing to do");
+    gst_watchdog_timer_disarm (watchdog->timer);
   } else {
-    watchdog->source = g_timeout_source_new (watchdog->timeout);
-    g_source_set_callback (watchdog->source, gst_watchdog_trigger,
-        gst_object_ref (watchdog), gst_object_unref);
-    g_source_attach (watchdog->source, watchdog->main_context);
+    gst_watchdog_timer_arm (watchdog->timer, watchdog->timeout);
   }
 }
 
@@ -267,9 +267,7 @@ gst_watchdog_start (GstBaseTransform * trans)
   GST_DEBUG_OBJECT (watchdog, "start");
   GST_OBJECT_LOCK (watchdog);
 
-  watchdog->main_context = g_main_context_new ();
-  watchdog->main_loop = g_main_loop_new (watchdog->main_context, TRUE);
-  watchdog->thread = g_thread_new ("watchdog", gst_watchdog_thread, watchdog);
+  watchdog->timer = gst_watchdog_timer_new (gst_watchdog_trigger, watchdog);
 
   GST_OBJECT_UNLOCK (watchdog);
   return TRUE;
@@ -279,35 +277,28 @@ static gboolean
 gst_watchdog_stop (GstBaseTransform * trans)
 {
   GstWatchdog *watchdog = GST_WATCHDOG (trans);
-  GSource *quit_source;
+  GstWatchdogTimer *timer;
 
   GST_DEBUG_OBJECT (watchdog, "stop");
   GST_OBJECT_LOCK (watchdog);
+  timer = watchdog->timer;
+  watchdog->timer = NULL;
+  GST_OBJECT_UNLOCK (watchdog);
 
-  if (watchdog->source) {
-    g_source_destroy (watchdog->source);
-    g_source_unref (watchdog->source);
-    watchdog->source = NULL;
-  }
-
-  /* dispatch an idle event that trigger g_main_loop_quit to avoid race
-   * between g_main_loop_run and g_main_loop_quit */
-  quit_source = g_idle_source_new ();
-  g_source_set_callback (quit_source, gst_watchdog_quit_mainloop, watchdog,
-      NULL);
-  g_source_attach (quit_source, watchdog->main_context);
-  g_source_unref (quit_source);
-
-  g_thread_join (watchdog->thread);
-  watchdog->thread = NULL;
+  if (timer) {
+    guint n_stalls, max_interval;
 
-  g_main_loop_unref (watchdog->main_loop);
-  watchdog->main_loop = NULL;
+    /* not under the object lock, this waits for a running
+     * gst_watchdog_trigger() which needs it to post the error */
+    gst_watchdog_timer_get_stats (timer, &n_stalls, &max_interval);
+    gst_watchdog_timer_free (timer);
 
-  g_main_context_unref (watchdog->main_context);
-  watchdog->main_context = NULL;
+    GST_OBJECT_LOCK (watchdog);
+    watchdog->n_stalls = n_stalls;
+    watchdog->max_interval = max_interval;
+    GST_OBJECT_UNLOCK (watchdog);
+  }
 
-  GST_OBJECT_UNLOCK (watchdog);
   return TRUE;
 }
 
@@ -360,7 +351,13 @@ gst_watchdog_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
 {
   GstWatchdog *watchdog = GST_WATCHDOG (trans);
 
-  GST_DEBUG_OBJECT (watchdog, "transform_ip");
+  GST_LOG_OBJECT (watchdog, "transform_ip");
+
+  /* unless the buffer ends a wait, restarting the running timer is
+   * enough */
+  if (G_LIKELY (!g_atomic_int_get (&watchdog->waiting_for_a_buffer) &&
+          watchdog->timer && gst_watchdog_timer_feed (watchdog->timer)))
+    return GST_FLOW_OK;
 
   GST_OBJECT_LOCK (watchdog);
   gst_watchdog_feed (watchdog, buf, FALSE);
@@ -405,11 +402,8 @@ gst_watchdog_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
       /* Disable the timer */
       GST_OBJECT_LOCK (watchdog);
-      if (watchdog->source) {
-        g_source_destroy (watchdog->source);
-        g_source_unref (watchdog->source);
-        watchdog->source = NULL;
-      }
+      if (watchdog->timer)
+        gst_watchdog_timer_disarm (watchdog->timer);
       GST_OBJECT_UNLOCK (watchdog);
       break;
     default:
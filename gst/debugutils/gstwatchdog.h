@@ -23,6 +23,8 @@
 
 #include <gst/base/gstbasetransform.h>
 
+#include "gstwatchdogtimer.h"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_WATCHDOG   (gst_watchdog_get_type())
@@ -41,10 +43,10 @@ struct _GstWatchdog
   /* properties */
   int timeout;
 
-  GMainContext *main_context;
-  GMainLoop *main_loop;
-  GThread *thread;
-  GSource *source;
+  GstWatchdogTimer *timer;
+  /* stats of the last timer, once it is freed */
+  guint n_stalls;
+  guint max_interval;
 
   gboolean waiting_for_a_buffer;
   gboolean waiting_for_flush_start;
@@ -0,0 +1,310 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstwatchdogtimer.h"
+
+struct _GstWatchdogTimer
+{
+  GstWatchdogTimerFunc func;
+  gpointer user_data;
+
+  /* time of the last feed in ms since service_epoch, wraps around */
+  volatile gint last_feed;
+  /* TRUE while the timer is scheduled */
+  volatile gint armed;
+  /* longest time between two feeds, updated by the feeding thread */
+  guint max_interval;
+
+  /* protected by service_lock */
+  guint timeout;
+  gint64 deadline;
+  gint heap_index;
+  guint n_stalls;
+};
+
+static GMutex service_lock;
+static GCond service_cond;
+static GThread *service_thread;
+/* incremented when the thread is stopped, a thread exits when the
+ * generation it was started for is over */
+static guint service_generation;
+static guint service_n_timers;
+static gint64 service_epoch;
+/* armed timers, a binary min-heap on the deadline */
+static GPtrArray *service_heap;
+/* timer whose function is being called, NULL if it was freed meanwhile */
+static GstWatchdogTimer *service_current;
+
+static inline guint32
+gst_watchdog_timer_ticks (gint64 time)
+{
+  return (guint32) ((time - service_epoch) / 1000);
+}
+
+static void
+heap_set (guint i, GstWatchdogTimer * timer)
+{
+  g_ptr_array_index (service_heap, i) = timer;
+  timer->heap_index = i;
+}
+
+static void
+heap_sift_up (guint i)
+{
+  GstWatchdogTimer *timer = g_ptr_array_index (service_heap, i);
+
+  while (i > 0) {
+    guint parent = (i - 1) / 2;
+    GstWatchdogTimer *p = g_ptr_array_index (service_heap, parent);
+
+    if (p->deadline <= timer->deadline)
+      break;
+    heap_set (i, p);
+    i = parent;
+  }
+  heap_set (i, timer);
+}
+
+static void
+heap_sift_down (guint i)
+{
+  GstWatchdogTimer *timer = g_ptr_array_index (service_heap, i);
+  guint len = service_heap->len;
+
+  while (2 * i + 1 < len) {
+    guint child = 2 * i + 1;
+    GstWatchdogTimer *c = g_ptr_array_index (service_heap, child);
+
+    if (child + 1 < len) {
+      GstWatchdogTimer *c2 = g_ptr_array_index (service_heap, child + 1);
+
+      if (c2->deadline < c->deadline) {
+        child++;
+        c = c2;
+      }
+    }
+    if (timer->deadline <= c->deadline)
+      break;
+    heap_set (i, c);
+    i = child;
+  }
+  heap_set (i, timer);
+}
+
+static void
+heap_insert (GstWatchdogTimer * timer)
+{
+  g_ptr_array_add (service_heap, timer);
+  heap_sift_up (service_heap->len - 1);
+}
+
+static void
+heap_remove (GstWatchdogTimer * timer)
+{
+  guint i = timer->heap_index;
+  GstWatchdogTimer *last;
+
+  last = g_ptr_array_index (service_heap, service_heap->len - 1);
+  g_ptr_array_set_size (service_heap, service_heap->len - 1);
+  timer->heap_index = -1;
+
+  if (last != timer) {
+    heap_set (i, last);
+    heap_sift_up (i);
+    heap_sift_down (last->heap_index);
+  }
+}
+
+static gpointer
+gst_watchdog_timer_thread (gpointer user_data)
+{
+  guint generation = GPOINTER_TO_UINT (user_data);
+
+  g_mutex_lock (&service_lock);
+  while (generation == service_generation) {
+    GstWatchdogTimer *timer;
+    gint64 now;
+    gint32 elapsed;
+
+    if (service_heap->len == 0) {
+      g_cond_wait (&service_cond, &service_lock);
+      continue;
+    }
+
+    timer = g_ptr_array_index (service_heap, 0);
+    now = g_get_monotonic_time ();
+    if (timer->deadline > now) {
+      g_cond_wait_until (&service_cond, &service_lock, timer->deadline);
+      continue;
+    }
+
+    /* a feed stored after now was read gives a negative value */
+    elapsed = (gint32) (gst_watchdog_timer_ticks (now) -
+        (guint32) g_atomic_int_get (&timer->last_feed));
+    if (elapsed < 0 || (guint) elapsed < timer->timeout) {
+      /* fed since it was scheduled, wait for the rest of the timeout */
+      timer->deadline =
+          now + (gint64) (timer->timeout - MAX (elapsed, 0)) * 1000;
+      heap_sift_down (0);
+      continue;
+    }
+
+    heap_remove (timer);
+    g_atomic_int_set (&timer->armed, FALSE);
+    timer->n_stalls++;
+
+    service_current = timer;
+    g_mutex_unlock (&service_lock);
+    timer->func (timer->user_data);
+    g_mutex_lock (&service_lock);
+    if (generation == service_generation)
+      service_current = NULL;
+    g_cond_broadcast (&service_cond);
+  }
+  g_mutex_unlock (&service_lock);
+
+  return NULL;
+}
+
+GstWatchdogTimer *
+gst_watchdog_timer_new (GstWatchdogTimerFunc func, gpointer user_data)
+{
+  GstWatchdogTimer *timer;
+
+  timer = g_slice_new0 (GstWatchdogTimer);
+  timer->func = func;
+  timer->user_data = user_data;
+  timer->heap_index = -1;
+
+  g_mutex_lock (&service_lock);
+  if (service_heap == NULL) {
+    service_heap = g_ptr_array_new ();
+    service_epoch = g_get_monotonic_time ();
+  }
+  if (service_n_timers++ == 0)
+    service_thread = g_thread_new ("watchdog", gst_watchdog_timer_thread,
+        GUINT_TO_POINTER (service_generation));
+  g_mutex_unlock (&service_lock);
+
+  return timer;
+}
+
+/* Waits for the timer function to return if it is running in another
+ * thread. The thread stops with the last timer. */
+void
+gst_watchdog_timer_free (GstWatchdogTimer * timer)
+{
+  GThread *thread = NULL;
+
+  g_mutex_lock (&service_lock);
+  if (timer->heap_index >= 0)
+    heap_remove (timer);
+
+  if (service_current == timer) {
+    if (g_thread_self () == service_thread)
+      service_current = NULL;
+    else
+      while (service_current == timer)
+        g_cond_wait (&service_cond, &service_lock);
+  }
+
+  if (--service_n_timers == 0) {
+    service_generation++;
+    thread = service_thread;
+    service_thread = NULL;
+    g_cond_broadcast (&service_cond);
+  }
+  g_mutex_unlock (&service_lock);
+
+  if (thread) {
+    if (thread == g_thread_self ())
+      g_thread_unref (thread);
+    else
+      g_thread_join (thread);
+  }
+
+  g_slice_free (GstWatchdogTimer, timer);
+}
+
+/* Schedules the timer to expire @timeout_ms from now */
+void
+gst_watchdog_timer_arm (GstWatchdogTimer * timer, guint timeout_ms)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  g_mutex_lock (&service_lock);
+  timer->timeout = timeout_ms;
+  timer->deadline = now + (gint64) timeout_ms * 1000;
+  g_atomic_int_set (&timer->last_feed, gst_watchdog_timer_ticks (now));
+
+  if (timer->heap_index >= 0)
+    heap_remove (timer);
+  heap_insert (timer);
+  g_atomic_int_set (&timer->armed, TRUE);
+
+  if (timer->heap_index == 0)
+    g_cond_broadcast (&service_cond);
+  g_mutex_unlock (&service_lock);
+}
+
+void
+gst_watchdog_timer_disarm (GstWatchdogTimer * timer)
+{
+  g_mutex_lock (&service_lock);
+  if (timer->heap_index >= 0)
+    heap_remove (timer);
+  g_atomic_int_set (&timer->armed, FALSE);
+  g_mutex_unlock (&service_lock);
+}
+
+/* Restarts the timeout of an armed timer, without taking any lock.
+ * Returns FALSE if the timer is not armed, then it needs
+ * gst_watchdog_timer_arm(). */
+gboolean
+gst_watchdog_timer_feed (GstWatchdogTimer * timer)
+{
+  guint32 now, interval;
+
+  if (!g_atomic_int_get (&timer->armed))
+    return FALSE;
+
+  now = gst_watchdog_timer_ticks (g_get_monotonic_time ());
+  interval = now - (guint32) g_atomic_int_get (&timer->last_feed);
+  g_atomic_int_set (&timer->last_feed, now);
+
+  if ((gint32) interval > 0 && interval > timer->max_interval)
+    timer->max_interval = interval;
+
+  return TRUE;
+}
+
+void
+gst_watchdog_timer_get_stats (GstWatchdogTimer * timer, guint * n_stalls,
+    guint * max_interval_ms)
+{
+  g_mutex_lock (&service_lock);
+  if (n_stalls)
+    *n_stalls = timer->n_stalls;
+  if (max_interval_ms)
+    *max_interval_ms = timer->max_interval;
+  g_mutex_unlock (&service_lock);
+}
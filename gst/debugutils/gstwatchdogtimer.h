@@ -0,0 +1,54 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_WATCHDOG_TIMER_H_
+#define _GST_WATCHDOG_TIMER_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Timers of all watchdogs are handled by one thread shared by the process.
+ * Feeding a timer only stores the current time; the thread checks when a
+ * timer was last fed once its deadline is reached and either reschedules
+ * it or calls its function. */
+
+typedef struct _GstWatchdogTimer GstWatchdogTimer;
+
+typedef void (*GstWatchdogTimerFunc) (gpointer user_data);
+
+G_GNUC_INTERNAL
+GstWatchdogTimer *gst_watchdog_timer_new (GstWatchdogTimerFunc func,
+                                          gpointer user_data);
+G_GNUC_INTERNAL
+void gst_watchdog_timer_free (GstWatchdogTimer * timer);
+
+G_GNUC_INTERNAL
+void gst_watchdog_timer_arm (GstWatchdogTimer * timer, guint timeout_ms);
+G_GNUC_INTERNAL
+void gst_watchdog_timer_disarm (GstWatchdogTimer * timer);
+G_GNUC_INTERNAL
+gboolean gst_watchdog_timer_feed (GstWatchdogTimer * timer);
+
+G_GNUC_INTERNAL
+void gst_watchdog_timer_get_stats (GstWatchdogTimer * timer,
+                                   guint * n_stalls, guint * max_interval_ms);
+
+G_END_DECLS
+
+#endif
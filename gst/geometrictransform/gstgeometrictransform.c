@@ -24,6 +24,7 @@
 #include "gstgeometrictransform.h"
 #include "geometricmath.h"
 #include <string.h>
+#include <math.h>
 
 GST_DEBUG_CATEGORY_STATIC (geometric_transform_debug);
 #define GST_CAT_DEFAULT geometric_transform_debug
@@ -49,7 +50,9 @@ static GstVideoFilterClass *parent_class = NULL;
 enum
 {
   PROP_0,
-  PROP_OFF_EDGE_PIXELS
+  PROP_OFF_EDGE_PIXELS,
+  PROP_INTERPOLATION,
+  PROP_N_THREADS
 };
 
 #define GST_GT_OFF_EDGES_PIXELS_METHOD_TYPE ( \
@@ -74,7 +77,98 @@ gst_geometric_transform_off_edges_pixels_method_get_type (void)
   return method_type;
 }
 
+#define GST_GT_INTERPOLATION_METHOD_TYPE ( \
+    gst_geometric_transform_interpolation_method_get_type())
+static GType
+gst_geometric_transform_interpolation_method_get_type (void)
+{
+  static GType method_type = 0;
+
+  static const GEnumValue method_types[] = {
+    {GST_GT_INTERPOLATION_NEAREST, "Nearest neighbour", "nearest"},
+    {GST_GT_INTERPOLATION_BILINEAR, "Bilinear", "bilinear"},
+    {0, NULL, NULL}
+  };
+
+  if (!method_type) {
+    method_type =
+        g_enum_register_static ("GstGeometricTransformInterpolationMethod",
+        method_types);
+  }
+  return method_type;
+}
+
 #define DEFAULT_OFF_EDGE_PIXELS GST_GT_OFF_EDGES_PIXELS_IGNORE
+#define DEFAULT_INTERPOLATION GST_GT_INTERPOLATION_NEAREST
+#define DEFAULT_N_THREADS 1
+
+/* output is produced in tiles of this size, which keeps the input pixels
+ * read for neighbouring output pixels in cache */
+#define TILE_WIDTH 64
+#define TILE_HEIGHT 16
+
+/* Converts an input position as returned by map_func into a map entry,
+ * applying the off edge pixels method. Must be called with the object lock */
+static void
+gst_geometric_transform_make_entry (GstGeometricTransform * gt,
+    gdouble in_x, gdouble in_y, GstGeometricTransformMapEntry * entry)
+{
+  gint ix, iy;
+
+  /* operate on out of edge pixels */
+  switch (gt->off_edge_pixels) {
+    case GST_GT_OFF_EDGES_PIXELS_CLAMP:
+      in_x = CLAMP (in_x, 0, gt->width - 1);
+      in_y = CLAMP (in_y, 0, gt->height - 1);
+      break;
+
+    case GST_GT_OFF_EDGES_PIXELS_WRAP:
+      in_x = mod_float (in_x, gt->width);
+      in_y = mod_float (in_y, gt->height);
+      if (in_x < 0)
+        in_x += gt->width;
+      if (in_y < 0)
+        in_y += gt->height;
+      break;
+
+    default:
+      break;
+  }
+
+  if (gt->interpolation == GST_GT_INTERPOLATION_BILINEAR) {
+    gdouble fl_x = floor (in_x);
+    gdouble fl_y = floor (in_y);
+    gint fx = (gint) ((in_x - fl_x) * 256.0 + 0.5);
+    gint fy = (gint) ((in_y - fl_y) * 256.0 + 0.5);
+
+    ix = (gint) fl_x;
+    iy = (gint) fl_y;
+    if (fx == 256) {
+      ix++;
+      fx = 0;
+    }
+    if (fy == 256) {
+      iy++;
+      fy = 0;
+    }
+    entry->fx = fx;
+    entry->fy = fy;
+  } else {
+    ix = (gint) in_x;
+    iy = (gint) in_y;
+    entry->fx = 0;
+    entry->fy = 0;
+  }
+
+  /* only set the values if the values are valid */
+  if (ix >= 0 && ix < gt->width && iy >= 0 && iy < gt->height) {
+    entry->x = ix;
+    entry->y = iy;
+  } else {
+    entry->x = GST_GT_MAP_ENTRY_INVALID;
+    entry->y = 0;
+  }
+}
 
 /* must be called with the object lock */
 static gboolean
@@ -84,7 +178,7 @@ gst_geometric_transform_generate_map (GstGeometricTransform * gt)
   gdouble in_x, in_y;
   gboolean ret = TRUE;
   GstGeometricTransformClass *klass;
-  gdouble *ptr;
+  GstGeometricTransformMapEntry *ptr;
 
   GST_INFO_OBJECT (gt, "Generating new transform map");
 
@@ -98,9 +192,9 @@ gst_geometric_transform_generate_map (GstGeometricTransform * gt)
   g_return_val_if_fail (klass->map_func, FALSE);
 
   /*
-   * (x,y) pairs of the inverse mapping
+   * fixed point input position of the inverse mapping
    */
-  gt->map = g_malloc0 (sizeof (gdouble) * gt->width * gt->height * 2);
+  gt->map = g_new (GstGeometricTransformMapEntry, gt->width * gt->height);
   ptr = gt->map;
 
   for (y = 0; y < gt->height; y++) {
@@ -111,9 +205,8 @@ gst_geometric_transform_generate_map (GstGeometricTransform * gt)
         goto end;
       }
 
-      ptr[0] = in_x;
-      ptr[1] = in_y;
-      ptr += 2;
+      gst_geometric_transform_make_entry (gt, in_x, in_y, ptr);
+      ptr++;
     }
   }
 
@@ -140,6 +233,13 @@ gst_geometric_transform_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
   gt = GST_GEOMETRIC_TRANSFORM_CAST (vfilter);
   klass = GST_GEOMETRIC_TRANSFORM_GET_CLASS (gt);
 
+  /* map entries store coordinates as 16 bit integers */
+  if (in_info->width > G_MAXINT16 || in_info->height > G_MAXINT16) {
+    GST_ERROR_OBJECT (gt, "Unsupported frame size %dx%d", in_info->width,
+        in_info->height);
+    return FALSE;
+  }
+
   old_width = gt->width;
   old_height = gt->height;
 
@@ -147,6 +247,15 @@ gst_geometric_transform_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
   gt->height = in_info->height;
   gt->row_stride = in_info->stride[0];
   gt->pixel_stride = GST_VIDEO_INFO_COMP_PSTRIDE (in_info, 0);
+  gt->format = GST_VIDEO_INFO_FORMAT (in_info);
+
+  /* in AYUV black is not just all zeros:
+   * 0x10 is black for Y,
+   * 0x80 is black for Cr and Cb */
+  if (gt->format == GST_VIDEO_FORMAT_AYUV)
+    GST_WRITE_UINT32_BE (gt->black, 0xff108080);
+  else
+    memset (gt->black, 0, sizeof (gt->black));
 
   /* regenerate the map */
   GST_OBJECT_LOCK (gt);
@@ -164,48 +273,150 @@ gst_geometric_transform_set_info (GstVideoFilter * vfilter, GstCaps * incaps,
   return ret;
 }
 
-static void
-gst_geometric_transform_do_map (GstGeometricTransform * gt, guint8 * in_data,
-    guint8 * out_data, gint x, gint y, gdouble in_x, gdouble in_y)
+static inline guint8
+bilinear_u8 (const guint8 * p00, const guint8 * p01, const guint8 * p10,
+    const guint8 * p11, guint fx, guint fy)
 {
-  gint in_offset;
-  gint out_offset;
+  guint top = *p00 * (256 - fx) + *p01 * fx;
+  guint bottom = *p10 * (256 - fx) + *p11 * fx;
 
-  out_offset = y * gt->row_stride + x * gt->pixel_stride;
+  return (top * (256 - fy) + bottom * fy + 32768) >> 16;
+}
 
-  /* operate on out of edge pixels */
-  switch (gt->off_edge_pixels) {
-    case GST_GT_OFF_EDGES_PIXELS_CLAMP:
-      in_x = CLAMP (in_x, 0, gt->width - 1);
-      in_y = CLAMP (in_y, 0, gt->height - 1);
-      break;
+static inline guint16
+bilinear_u16 (guint16 p00, guint16 p01, guint16 p10, guint16 p11, guint fx,
+    guint fy)
+{
+  guint64 top = p00 * (256 - fx) + p01 * fx;
+  guint64 bottom = p10 * (256 - fx) + p11 * fx;
 
-    case GST_GT_OFF_EDGES_PIXELS_WRAP:
-      in_x = mod_float (in_x, gt->width);
-      in_y = mod_float (in_y, gt->height);
-      if (in_x < 0)
-        in_x += gt->width;
-      if (in_y < 0)
-        in_y += gt->height;
-      break;
+  return (top * (256 - fy) + bottom * fy + 32768) >> 16;
+}
 
-    default:
+/* Produces @n output pixels at @out from the map entries at @entry */
+static void
+gst_geometric_transform_map_span (GstGeometricTransform * gt,
+    const guint8 * in_data, gint in_stride, guint8 * out,
+    const GstGeometricTransformMapEntry * entry, gint n)
+{
+  const gint pstride = gt->pixel_stride;
+  gint i, c;
+
+  if (gt->interpolation == GST_GT_INTERPOLATION_NEAREST) {
+    /* constant sizes let the compiler turn the copies into single moves */
+    switch (pstride) {
+#define NEAREST_SPAN(size) \
+      for (i = 0; i < n; i++, entry++, out += size) { \
+        if (entry->x != GST_GT_MAP_ENTRY_INVALID) \
+          memcpy (out, in_data + entry->y * in_stride + entry->x * size, size); \
+        else \
+          memcpy (out, gt->black, size); \
+      } \
       break;
+      case 1:
+        NEAREST_SPAN (1);
+      case 2:
+        NEAREST_SPAN (2);
+      case 3:
+        NEAREST_SPAN (3);
+      case 4:
+        NEAREST_SPAN (4);
+#undef NEAREST_SPAN
+      default:
+        g_assert_not_reached ();
+        break;
+    }
+    return;
+  }
+
+  for (i = 0; i < n; i++, entry++, out += pstride) {
+    const guint8 *p00, *p01, *p10, *p11;
+    gint x1, y1;
+
+    if (entry->x == GST_GT_MAP_ENTRY_INVALID) {
+      memcpy (out, gt->black, pstride);
+      continue;
+    }
+
+    if (gt->off_edge_pixels == GST_GT_OFF_EDGES_PIXELS_WRAP) {
+      /* the neighbours past the right and bottom edges wrap around too */
+      x1 = (entry->x + 1) % gt->width;
+      y1 = (entry->y + 1) % gt->height;
+    } else {
+      x1 = MIN (entry->x + 1, gt->width - 1);
+      y1 = MIN (entry->y + 1, gt->height - 1);
+    }
+    p00 = in_data + entry->y * in_stride + entry->x * pstride;
+    p01 = in_data + entry->y * in_stride + x1 * pstride;
+    p10 = in_data + y1 * in_stride + entry->x * pstride;
+    p11 = in_data + y1 * in_stride + x1 * pstride;
+
+    if (gt->format == GST_VIDEO_FORMAT_GRAY16_LE) {
+      GST_WRITE_UINT16_LE (out, bilinear_u16 (GST_READ_UINT16_LE (p00),
+              GST_READ_UINT16_LE (p01), GST_READ_UINT16_LE (p10),
+              GST_READ_UINT16_LE (p11), entry->fx, entry->fy));
+    } else if (gt->format == GST_VIDEO_FORMAT_GRAY16_BE) {
+      GST_WRITE_UINT16_BE (out, bilinear_u16 (GST_READ_UINT16_BE (p00),
+              GST_READ_UINT16_BE (p01), GST_READ_UINT16_BE (p10),
+              GST_READ_UINT16_BE (p11), entry->fx, entry->fy));
+    } else {
+      for (c = 0; c < pstride; c++)
+        out[c] = bilinear_u8 (p00 + c, p01 + c, p10 + c, p11 + c, entry->fx,
+            entry->fy);
+    }
   }
+}
 
-  {
-    gint trunc_x = (gint) in_x;
-    gint trunc_y = (gint) in_y;
-    /* only set the values if the values are valid */
-    if (trunc_x >= 0 && trunc_x < gt->width && trunc_y >= 0 &&
-        trunc_y < gt->height) {
-      in_offset = trunc_y * gt->row_stride + trunc_x * gt->pixel_stride;
+typedef struct
+{
+  GstGeometricTransform *gt;
+  const guint8 *in_data;
+  gint in_stride;
+  guint8 *out_data;
+  gint out_stride;
+} GstGeometricTransformRemap;
 
-      memcpy (out_data + out_offset, in_data + in_offset, gt->pixel_stride);
+/* remaps the rows of a band from the precalculated map, tile by tile */
+static void
+gst_geometric_transform_map_band (guint band, guint n_bands,
+    gpointer user_data)
+{
+  GstGeometricTransformRemap *remap = user_data;
+  GstGeometricTransform *gt = remap->gt;
+  gint y_start = gt->height * band / n_bands;
+  gint y_end = gt->height * (band + 1) / n_bands;
+  gint tx, ty, y;
+
+  for (ty = y_start; ty < y_end; ty += TILE_HEIGHT) {
+    gint ty_end = MIN (ty + TILE_HEIGHT, y_end);
+
+    for (tx = 0; tx < gt->width; tx += TILE_WIDTH) {
+      gint n = MIN (TILE_WIDTH, gt->width - tx);
+
+      for (y = ty; y < ty_end; y++) {
+        gst_geometric_transform_map_span (gt, remap->in_data,
+            remap->in_stride,
+            remap->out_data + y * remap->out_stride + tx * gt->pixel_stride,
+            gt->map + y * gt->width + tx, n);
+      }
     }
   }
 }
 
+/* must be called with the object lock */
+static void
+gst_geometric_transform_apply_map (GstGeometricTransform * gt,
+    const guint8 * in_data, gint in_stride, guint8 * out_data, gint out_stride)
+{
+  GstGeometricTransformRemap remap =
+      { gt, in_data, in_stride, out_data, out_stride };
+  guint n_bands;
+
+  n_bands = MIN (gst_band_runner_get_n_threads (gt->runner), gt->height);
+  gst_band_runner_run (gt->runner, n_bands, gst_geometric_transform_map_band,
+      &remap);
+}
+
 static void
 gst_geometric_transform_before_transform (GstBaseTransform * trans,
     GstBuffer * outbuf)
@@ -229,27 +440,22 @@ gst_geometric_transform_transform_frame (GstVideoFilter * vfilter,
 {
   GstGeometricTransform *gt;
   GstGeometricTransformClass *klass;
-  gint x, y, i;
+  gint x, y;
   GstFlowReturn ret = GST_FLOW_OK;
-  gdouble *ptr;
   guint8 *in_data;
   guint8 *out_data;
+  gint in_stride, out_stride;
 
   gt = GST_GEOMETRIC_TRANSFORM_CAST (vfilter);
   klass = GST_GEOMETRIC_TRANSFORM_GET_CLASS (gt);
 
   in_data = GST_VIDEO_FRAME_PLANE_DATA (in_frame, 0);
   out_data = GST_VIDEO_FRAME_PLANE_DATA (out_frame, 0);
+  in_stride = GST_VIDEO_FRAME_PLANE_STRIDE (in_frame, 0);
+  out_stride = GST_VIDEO_FRAME_PLANE_STRIDE (out_frame, 0);
 
-  if (GST_VIDEO_FRAME_FORMAT (out_frame) == GST_VIDEO_FORMAT_AYUV) {
-    /* in AYUV black is not just all zeros:
-     * 0x10 is black for Y,
-     * 0x80 is black for Cr and Cb */
-    for (i = 0; i < out_frame->map[0].size; i += 4)
-      GST_WRITE_UINT32_BE (out_data + i, 0xff108080);
-  } else {
-    memset (out_data, 0, out_frame->map[0].size);
-  }
+  /* every output pixel is written by the mapping, off edge pixels are set
+   * to black there */
 
   GST_OBJECT_LOCK (gt);
   if (gt->precalc_map) {
@@ -261,31 +467,35 @@ gst_geometric_transform_transform_frame (GstVideoFilter * vfilter,
         }
       gst_geometric_transform_generate_map (gt);
     }
-    g_return_val_if_fail (gt->map, GST_FLOW_ERROR);
-    ptr = gt->map;
-    for (y = 0; y < gt->height; y++) {
-      for (x = 0; x < gt->width; x++) {
-        /* do the mapping */
-        gst_geometric_transform_do_map (gt, in_data, out_data, x, y, ptr[0],
-            ptr[1]);
-        ptr += 2;
-      }
+    if (gt->map == NULL) {
+      ret = GST_FLOW_ERROR;
+      goto end;
     }
+    gst_geometric_transform_apply_map (gt, in_data, in_stride, out_data,
+        out_stride);
   } else {
+    GstGeometricTransformMapEntry *row;
+
+    /* map_func may keep state between calls, so this is done row by row on
+     * the streaming thread */
+    row = g_new (GstGeometricTransformMapEntry, gt->width);
     for (y = 0; y < gt->height; y++) {
       for (x = 0; x < gt->width; x++) {
         gdouble in_x, in_y;
 
         if (klass->map_func (gt, x, y, &in_x, &in_y)) {
-          gst_geometric_transform_do_map (gt, in_data, out_data, x, y, in_x,
-              in_y);
+          gst_geometric_transform_make_entry (gt, in_x, in_y, &row[x]);
         } else {
           GST_WARNING_OBJECT (gt, "Failed to do mapping for %d %d", x, y);
           ret = GST_FLOW_ERROR;
+          g_free (row);
           goto end;
         }
       }
+      gst_geometric_transform_map_span (gt, in_data, in_stride,
+          out_data + y * out_stride, row, gt->width);
     }
+    g_free (row);
   }
 end:
   GST_OBJECT_UNLOCK (gt);
@@ -304,6 +514,19 @@ gst_geometric_transform_set_property (GObject * object, guint prop_id,
     case PROP_OFF_EDGE_PIXELS:
       GST_OBJECT_LOCK (gt);
       gt->off_edge_pixels = g_value_get_enum (value);
+      /* the method is applied when generating the map */
+      gst_geometric_transform_set_need_remap (gt);
+      GST_OBJECT_UNLOCK (gt);
+      break;
+    case PROP_INTERPOLATION:
+      GST_OBJECT_LOCK (gt);
+      gt->interpolation = g_value_get_enum (value);
+      gst_geometric_transform_set_need_remap (gt);
+      GST_OBJECT_UNLOCK (gt);
+      break;
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (gt);
+      gt->n_threads = g_value_get_uint (value);
       GST_OBJECT_UNLOCK (gt);
       break;
     default:
@@ -324,12 +547,41 @@ gst_geometric_transform_get_property (GObject * object, guint prop_id,
     case PROP_OFF_EDGE_PIXELS:
       g_value_set_enum (value, gt->off_edge_pixels);
       break;
+    case PROP_INTERPOLATION:
+      g_value_set_enum (value, gt->interpolation);
+      break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, gt->n_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static gboolean
+gst_geometric_transform_start (GstBaseTransform * trans)
+{
+  GstGeometricTransform *gt = GST_GEOMETRIC_TRANSFORM_CAST (trans);
+  GError *err = NULL;
+  guint n_threads;
+
+  GST_OBJECT_LOCK (gt);
+  n_threads = gt->n_threads;
+  GST_OBJECT_UNLOCK (gt);
+
+  if (!gst_band_runner_set_threads (gt->runner, n_threads, &err)) {
+    GST_ELEMENT_ERROR (gt, RESOURCE, FAILED, (NULL),
+        ("Failed to create thread pool: %s", err->message));
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (gt, "remapping with %u threads",
+      gst_band_runner_get_n_threads (gt->runner));
+
+  return TRUE;
+}
 
 static gboolean
 gst_geometric_transform_stop (GstBaseTransform * trans)
@@ -344,9 +596,21 @@ gst_geometric_transform_stop (GstBaseTransform * trans)
   g_free (gt->map);
   gt->map = NULL;
 
+  gst_band_runner_set_threads (gt->runner, 1, NULL);
+
   return TRUE;
 }
 
+static void
+gst_geometric_transform_finalize (GObject * object)
+{
+  GstGeometricTransform *gt = GST_GEOMETRIC_TRANSFORM_CAST (object);
+
+  gst_band_runner_free (gt->runner);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gst_geometric_transform_base_init (gpointer g_class)
 {
@@ -373,7 +637,9 @@ gst_geometric_transform_class_init (gpointer klass, gpointer class_data)
 
   obj_class->set_property = gst_geometric_transform_set_property;
   obj_class->get_property = gst_geometric_transform_get_property;
+  obj_class->finalize = gst_geometric_transform_finalize;
 
+  trans_class->start = GST_DEBUG_FUNCPTR (gst_geometric_transform_start);
   trans_class->stop = GST_DEBUG_FUNCPTR (gst_geometric_transform_stop);
   trans_class->before_transform =
       GST_DEBUG_FUNCPTR (gst_geometric_transform_before_transform);
@@ -388,6 +654,19 @@ gst_geometric_transform_class_init (gpointer klass, gpointer class_data)
           "What to do with off edge pixels",
           GST_GT_OFF_EDGES_PIXELS_METHOD_TYPE, DEFAULT_OFF_EDGE_PIXELS,
           GST_PARAM_CONTROLLABLE | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_INTERPOLATION,
+      g_param_spec_enum ("interpolation", "Interpolation",
+          "How to sample input pixels at fractional positions",
+          GST_GT_INTERPOLATION_METHOD_TYPE, DEFAULT_INTERPOLATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (obj_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to remap each frame with, 0 for the number of "
+          "processors (takes effect on the next start)",
+          0, G_MAXUINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -396,8 +675,11 @@ gst_geometric_transform_init (GTypeInstance * instance, gpointer g_class)
   GstGeometricTransform *gt = GST_GEOMETRIC_TRANSFORM_CAST (instance);
 
   gt->off_edge_pixels = DEFAULT_OFF_EDGE_PIXELS;
+  gt->interpolation = DEFAULT_INTERPOLATION;
+  gt->n_threads = DEFAULT_N_THREADS;
   gt->precalc_map = TRUE;
   gt->needs_remap = TRUE;
+  gt->runner = gst_band_runner_new ();
 }
 
 GType
@@ -22,6 +22,7 @@
 
 #include <gst/video/gstvideofilter.h>
 #include <gst/video/video.h>
+#include <gst/base/gstbandrunner.h>
 
 G_BEGIN_DECLS
 
@@ -46,6 +47,12 @@ enum
   GST_GT_OFF_EDGES_PIXELS_WRAP
 };
 
+enum
+{
+  GST_GT_INTERPOLATION_NEAREST = 0,
+  GST_GT_INTERPOLATION_BILINEAR
+};
+
 typedef struct _GstGeometricTransform GstGeometricTransform;
 typedef struct _GstGeometricTransformClass GstGeometricTransformClass;
 
@@ -77,6 +84,24 @@ typedef gboolean (*GstGeometricTransformMapFunc) (GstGeometricTransform * gt,
 typedef gboolean (*GstGeometricTransformPrepareFunc) (
     GstGeometricTransform * gt);
 
+/**
+ * GstGeometricTransformMapEntry:
+ *
+ * Input position of one output pixel in the precalculated map. @x and @y
+ * are the integer part of the input position, with the off edge pixels
+ * method already applied, or @x is %GST_GT_MAP_ENTRY_INVALID when the output
+ * pixel is left black. @fx and @fy are the fractional part in 1/256 units,
+ * only used for bilinear interpolation.
+ */
+typedef struct {
+  gint16 x;
+  gint16 y;
+  guint8 fx;
+  guint8 fy;
+} GstGeometricTransformMapEntry;
+
+#define GST_GT_MAP_ENTRY_INVALID G_MININT16
+
 /**
  * GstGeometricTransform:
  *
@@ -99,8 +124,16 @@ struct _GstGeometricTransform {
 
   /* properties */
   gint off_edge_pixels;
+  gint interpolation;
+  guint n_threads;
+
+  GstGeometricTransformMapEntry *map;
+
+  /* value of a black pixel */
+  guint8 black[4];
 
-  gdouble *map;
+  /* rows are remapped in parallel by the runner */
+  GstBandRunner *runner;
 };
 
 struct _GstGeometricTransformClass {
@@ -48,6 +48,12 @@ GST_DEBUG_CATEGORY_STATIC (gst_comb_detect_debug_category);
 
 /* prototypes */
 
+static void gst_comb_detect_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_comb_detect_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_comb_detect_finalize (GObject * object);
+static gboolean gst_comb_detect_start (GstBaseTransform * trans);
 
 static GstCaps *gst_comb_detect_transform_caps (GstBaseTransform * trans,
     GstPadDirection direction, GstCaps * caps, GstCaps * filter);
@@ -57,19 +63,20 @@ static gboolean gst_comb_detect_set_info (GstVideoFilter * filter,
 static GstFlowReturn gst_comb_detect_transform_frame (GstVideoFilter * filter,
     GstVideoFrame * inframe, GstVideoFrame * outframe);
 
+#define DEFAULT_N_THREADS 1
+
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_N_THREADS
 };
 
 /* pad templates */
 
-/* Yeah, the max width is hard-coded 2048. */
-#define MAX_WIDTH 2048
 #define VIDEO_CAPS \
   "video/x-raw, " \
   "format = (string) { I420, Y444, Y42B }, " \
-  "width = [1, 2048], " \
+  "width = " GST_VIDEO_SIZE_RANGE ", " \
   "height = " GST_VIDEO_SIZE_RANGE ", " \
   "framerate = " GST_VIDEO_FPS_RANGE
 
@@ -97,10 +104,22 @@ G_DEFINE_TYPE_WITH_CODE (GstCombDetect, gst_comb_detect, GST_TYPE_VIDEO_FILTER,
 static void
 gst_comb_detect_class_init (GstCombDetectClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstBaseTransformClass *base_transform_class =
       GST_BASE_TRANSFORM_CLASS (klass);
   GstVideoFilterClass *video_filter_class = GST_VIDEO_FILTER_CLASS (klass);
 
+  gobject_class->set_property = gst_comb_detect_set_property;
+  gobject_class->get_property = gst_comb_detect_get_property;
+  gobject_class->finalize = gst_comb_detect_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to detect combing with, 0 for the number of "
+          "processors (takes effect on the next start)",
+          0, G_MAXUINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /* Setting up pads and setting metadata should be moved to
      base_class_init if you intend to subclass this class. */
   gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
@@ -114,6 +133,7 @@ gst_comb_detect_class_init (GstCombDetectClass * klass)
 
   base_transform_class->transform_caps =
       GST_DEBUG_FUNCPTR (gst_comb_detect_transform_caps);
+  base_transform_class->start = GST_DEBUG_FUNCPTR (gst_comb_detect_start);
   video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_comb_detect_set_info);
   video_filter_class->transform_frame =
       GST_DEBUG_FUNCPTR (gst_comb_detect_transform_frame);
@@ -123,6 +143,80 @@ gst_comb_detect_class_init (GstCombDetectClass * klass)
 static void
 gst_comb_detect_init (GstCombDetect * combdetect)
 {
+  combdetect->n_threads = DEFAULT_N_THREADS;
+  combdetect->metrics = gst_field_metrics_new ();
+}
+
+static void
+gst_comb_detect_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstCombDetect *combdetect = GST_COMB_DETECT (object);
+
+  switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (combdetect);
+      combdetect->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (combdetect);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_comb_detect_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstCombDetect *combdetect = GST_COMB_DETECT (object);
+
+  switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (combdetect);
+      g_value_set_uint (value, combdetect->n_threads);
+      GST_OBJECT_UNLOCK (combdetect);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_comb_detect_finalize (GObject * object)
+{
+  GstCombDetect *combdetect = GST_COMB_DETECT (object);
+
+  gst_field_metrics_free (combdetect->metrics);
+  g_free (combdetect->combed);
+
+  G_OBJECT_CLASS (gst_comb_detect_parent_class)->finalize (object);
+}
+
+static gboolean
+gst_comb_detect_start (GstBaseTransform * trans)
+{
+  GstCombDetect *combdetect = GST_COMB_DETECT (trans);
+  GError *err = NULL;
+  guint n_threads;
+
+  GST_OBJECT_LOCK (combdetect);
+  n_threads = combdetect->n_threads;
+  GST_OBJECT_UNLOCK (combdetect);
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  GST_DEBUG_OBJECT (combdetect, "detecting with %u threads", n_threads);
+  if (!gst_field_metrics_set_threads (combdetect->metrics, n_threads, &err)) {
+    GST_ELEMENT_ERROR (combdetect, RESOURCE, FAILED, (NULL),
+        ("Failed to create thread pool: %s", err->message));
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  return TRUE;
 }
 
 
@@ -184,6 +278,11 @@ gst_comb_detect_set_info (GstVideoFilter * filter,
 
   memcpy (&combdetect->vinfo, in_info, sizeof (GstVideoInfo));
 
+  g_free (combdetect->combed);
+  combdetect->combed =
+      g_malloc ((gsize) GST_VIDEO_INFO_COMP_WIDTH (in_info, 0) *
+      GST_VIDEO_INFO_COMP_HEIGHT (in_info, 0));
+
   return TRUE;
 }
 
@@ -211,47 +310,36 @@ gst_comb_detect_transform_frame (GstVideoFilter * filter,
   }
 
   {
+    GstCombDetect *combdetect = GST_COMB_DETECT (filter);
     int j;
-    int thisline[MAX_WIDTH];
-    int score = 0;
+    int score;
 
     height = GST_VIDEO_FRAME_COMP_HEIGHT (outframe, 0);
     width = GST_VIDEO_FRAME_COMP_WIDTH (outframe, 0);
 
-    memset (thisline, 0, sizeof (thisline));
-
     k = 0;
+    score = gst_field_metrics_comb_runs (combdetect->metrics,
+        GET_LINE (inframe, 0, 0), GET_LINE (inframe, 0, 0),
+        GST_VIDEO_FRAME_COMP_STRIDE (inframe, 0), width, height,
+        combdetect->combed, width);
+
     for (j = 0; j < height; j++) {
+      guint8 *dest = GET_LINE (outframe, 0, j);
+      guint8 *src = GET_LINE (inframe, 0, j);
       int i;
+
       if (j < 2 || j >= height - 2) {
-        guint8 *dest = GET_LINE (outframe, 0, j);
-        guint8 *src = GET_LINE (inframe, 0, j);
         for (i = 0; i < width; i++) {
           dest[i] = src[i] / 2;
         }
       } else {
-        guint8 *dest = GET_LINE (outframe, 0, j);
-        guint8 *src1 = GET_LINE (inframe, 0, j - 1);
-        guint8 *src2 = GET_LINE (inframe, 0, j);
-        guint8 *src3 = GET_LINE (inframe, 0, j + 1);
+        const guint8 *combed = combdetect->combed + j * width;
 
         for (i = 0; i < width; i++) {
-          if (src2[i] < MIN (src1[i], src3[i]) - 5 ||
-              src2[i] > MAX (src1[i], src3[i]) + 5) {
-            if (i > 0) {
-              thisline[i] += thisline[i - 1];
-            }
-            thisline[i]++;
-            if (thisline[i] > 1000)
-              thisline[i] = 1000;
-          } else {
-            thisline[i] = 0;
-          }
-          if (thisline[i] > 100) {
+          if (combed[i]) {
             dest[i] = ((i + j + z) & 0x4) ? 235 : 16;
-            score++;
           } else {
-            dest[i] = src2[i];
+            dest[i] = src[i];
           }
         }
       }
@@ -22,6 +22,7 @@
 
 #include <gst/video/video.h>
 #include <gst/video/gstvideofilter.h>
+#include <gst/video/gstfieldmetrics.h>
 
 G_BEGIN_DECLS
 
@@ -39,6 +40,10 @@ struct _GstCombDetect
   GstVideoFilter base_combdetect;
 
   GstVideoInfo vinfo;
+
+  GstFieldMetrics *metrics;
+  guint8 *combed;
+  guint n_threads;
 };
 
 struct _GstCombDetectClass
@@ -58,6 +58,12 @@ GST_DEBUG_CATEGORY_STATIC (gst_ivtc_debug_category);
 
 /* prototypes */
 
+static void gst_ivtc_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_ivtc_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_ivtc_finalize (GObject * object);
+static gboolean gst_ivtc_start (GstBaseTransform * trans);
 
 static GstCaps *gst_ivtc_transform_caps (GstBaseTransform * trans,
     GstPadDirection direction, GstCaps * caps, GstCaps * filter);
@@ -73,20 +79,23 @@ static void gst_ivtc_flush (GstIvtc * ivtc);
 static void gst_ivtc_retire_fields (GstIvtc * ivtc, int n_fields);
 static void gst_ivtc_construct_frame (GstIvtc * itvc, GstBuffer * outbuf);
 
-static int get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom);
+static int get_comb_score (GstIvtc * ivtc, GstVideoFrame * top,
+    GstVideoFrame * bottom);
+
+#define DEFAULT_N_THREADS 1
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_N_THREADS
 };
 
 /* pad templates */
 
-#define MAX_WIDTH 2048
 #define VIDEO_CAPS \
   "video/x-raw, " \
   "format = (string) { I420, Y444, Y42B }, " \
-  "width = [1, 2048], " \
+  "width = " GST_VIDEO_SIZE_RANGE ", " \
   "height = " GST_VIDEO_SIZE_RANGE ", " \
   "framerate = " GST_VIDEO_FPS_RANGE
 
@@ -114,9 +123,21 @@ G_DEFINE_TYPE_WITH_CODE (GstIvtc, gst_ivtc, GST_TYPE_BASE_TRANSFORM,
 static void
 gst_ivtc_class_init (GstIvtcClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstBaseTransformClass *base_transform_class =
       GST_BASE_TRANSFORM_CLASS (klass);
 
+  gobject_class->set_property = gst_ivtc_set_property;
+  gobject_class->get_property = gst_ivtc_get_property;
+  gobject_class->finalize = gst_ivtc_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to compare fields with, 0 for the number of "
+          "processors (takes effect on the next start)",
+          0, G_MAXUINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /* Setting up pads and setting metadata should be moved to
      base_class_init if you intend to subclass this class. */
   gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
@@ -134,11 +155,85 @@ gst_ivtc_class_init (GstIvtcClass * klass)
   base_transform_class->set_caps = GST_DEBUG_FUNCPTR (gst_ivtc_set_caps);
   base_transform_class->sink_event = GST_DEBUG_FUNCPTR (gst_ivtc_sink_event);
   base_transform_class->transform = GST_DEBUG_FUNCPTR (gst_ivtc_transform);
+  base_transform_class->start = GST_DEBUG_FUNCPTR (gst_ivtc_start);
 }
 
 static void
 gst_ivtc_init (GstIvtc * ivtc)
 {
+  ivtc->n_threads = DEFAULT_N_THREADS;
+  ivtc->metrics = gst_field_metrics_new ();
+}
+
+static void
+gst_ivtc_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstIvtc *ivtc = GST_IVTC (object);
+
+  switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (ivtc);
+      ivtc->n_threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (ivtc);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_ivtc_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstIvtc *ivtc = GST_IVTC (object);
+
+  switch (property_id) {
+    case PROP_N_THREADS:
+      GST_OBJECT_LOCK (ivtc);
+      g_value_set_uint (value, ivtc->n_threads);
+      GST_OBJECT_UNLOCK (ivtc);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_ivtc_finalize (GObject * object)
+{
+  GstIvtc *ivtc = GST_IVTC (object);
+
+  gst_field_metrics_free (ivtc->metrics);
+
+  G_OBJECT_CLASS (gst_ivtc_parent_class)->finalize (object);
+}
+
+static gboolean
+gst_ivtc_start (GstBaseTransform * trans)
+{
+  GstIvtc *ivtc = GST_IVTC (trans);
+  GError *err = NULL;
+  guint n_threads;
+
+  GST_OBJECT_LOCK (ivtc);
+  n_threads = ivtc->n_threads;
+  GST_OBJECT_UNLOCK (ivtc);
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  GST_DEBUG_OBJECT (ivtc, "comparing fields with %u threads", n_threads);
+  if (!gst_field_metrics_set_threads (ivtc->metrics, n_threads, &err)) {
+    GST_ELEMENT_ERROR (ivtc, RESOURCE, FAILED, (NULL),
+        ("Failed to create thread pool: %s", err->message));
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  return TRUE;
 }
 
 static GstCaps *
@@ -319,9 +414,9 @@ similarity (GstIvtc * ivtc, int i1, int i2)
   f2 = &ivtc->fields[i2];
 
   if (f1->parity == TOP_FIELD) {
-    score = get_comb_score (&f1->frame, &f2->frame);
+    score = get_comb_score (ivtc, &f1->frame, &f2->frame);
   } else {
-    score = get_comb_score (&f2->frame, &f1->frame);
+    score = get_comb_score (ivtc, &f2->frame, &f1->frame);
   }
 
   GST_DEBUG ("score %d", score);
@@ -629,47 +724,20 @@ gst_ivtc_construct_frame (GstIvtc * ivtc, GstBuffer * outbuf)
 
 }
 
+/* counts the pixels of the frame woven from @top and @bottom that are part of
+ * a long enough run of combing; the top and bottom two lines are left out as
+ * they sometimes contain artifacts */
 static int
-get_comb_score (GstVideoFrame * top, GstVideoFrame * bottom)
+get_comb_score (GstIvtc * ivtc, GstVideoFrame * top, GstVideoFrame * bottom)
 {
-  int j;
-  int thisline[MAX_WIDTH];
-  int score = 0;
-  int height;
-  int width;
-  int k;
+  int score;
 
-  height = GST_VIDEO_FRAME_COMP_HEIGHT (top, 0);
-  width = GST_VIDEO_FRAME_COMP_WIDTH (top, 0);
-
-  memset (thisline, 0, sizeof (thisline));
-
-  k = 0;
-  /* remove a few lines from top and bottom, as they sometimes contain
-   * artifacts */
-  for (j = 2; j < height - 2; j++) {
-    guint8 *src1 = GET_LINE_IL (top, bottom, 0, j - 1);
-    guint8 *src2 = GET_LINE_IL (top, bottom, 0, j);
-    guint8 *src3 = GET_LINE_IL (top, bottom, 0, j + 1);
-    int i;
-
-    for (i = 0; i < width; i++) {
-      if (src2[i] < MIN (src1[i], src3[i]) - 5 ||
-          src2[i] > MAX (src1[i], src3[i]) + 5) {
-        if (i > 0) {
-          thisline[i] += thisline[i - 1];
-        }
-        thisline[i]++;
-        if (thisline[i] > 1000)
-          thisline[i] = 1000;
-      } else {
-        thisline[i] = 0;
-      }
-      if (thisline[i] > 100) {
-        score++;
-      }
-    }
-  }
+  score = gst_field_metrics_comb_runs (ivtc->metrics,
+      GST_VIDEO_FRAME_PLANE_DATA (top, 0),
+      GST_VIDEO_FRAME_PLANE_DATA (bottom, 0),
+      GST_VIDEO_FRAME_COMP_STRIDE (top, 0),
+      GST_VIDEO_FRAME_COMP_WIDTH (top, 0),
+      GST_VIDEO_FRAME_COMP_HEIGHT (top, 0), NULL, 0);
 
   GST_DEBUG ("score %d", score);
 
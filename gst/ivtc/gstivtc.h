@@ -22,6 +22,7 @@
 
 #include <gst/base/gstbasetransform.h>
 #include <gst/video/video.h>
+#include <gst/video/gstfieldmetrics.h>
 
 G_BEGIN_DECLS
 
@@ -58,6 +59,9 @@ struct _GstIvtc
 
   int n_fields;
   GstIvtcField fields[GST_IVTC_MAX_FIELDS];
+
+  GstFieldMetrics *metrics;
+  guint n_threads;
 };
 
 struct _GstIvtcClass
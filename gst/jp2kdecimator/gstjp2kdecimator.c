@@ -177,10 +177,6 @@ gst_jp2k_decimator_decimate_jpc (GstJP2kDecimator * self, GstBuffer * inbuf,
   GstBuffer *outbuf = NULL;
   GstFlowReturn ret = GST_FLOW_OK;
   GstMapInfo info;
-  GstByteReader reader;
-  GstByteWriter writer;
-  MainHeader main_header;
-
 
   if (!gst_buffer_map (inbuf, &info, GST_MAP_READ)) {
     GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, ("Unable to map memory"),
@@ -189,24 +185,11 @@ gst_jp2k_decimator_decimate_jpc (GstJP2kDecimator * self, GstBuffer * inbuf,
     return GST_FLOW_ERROR;
   }
 
-  gst_byte_reader_init (&reader, info.data, info.size);
-  gst_byte_writer_init_with_size (&writer, gst_buffer_get_size (inbuf), FALSE);
-
-  /* main header */
-  memset (&main_header, 0, sizeof (MainHeader));
-  ret = parse_main_header (self, &reader, &main_header);
-  if (ret != GST_FLOW_OK)
-    goto done;
-
-  ret = decimate_main_header (self, &main_header);
-  if (ret != GST_FLOW_OK)
-    goto done;
-
-  ret = write_main_header (self, &writer, &main_header);
+  /* the kept packets are not copied but shared with inbuf if possible */
+  ret = decimate_codestream (self, inbuf, &info, &outbuf);
   if (ret != GST_FLOW_OK)
     goto done;
 
-  outbuf = gst_byte_writer_reset_and_get_buffer (&writer);
   gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_METADATA, 0, -1);
 
   GST_DEBUG_OBJECT (self,
@@ -220,7 +203,6 @@ done:
   gst_buffer_unmap (inbuf, &info);
 
   *outbuf_ = outbuf;
-  reset_main_header (self, &main_header);
   gst_buffer_unref (inbuf);
 
   return ret;
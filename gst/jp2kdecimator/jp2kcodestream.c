@@ -514,12 +514,6 @@ parse_siz (GstJP2kDecimator * self, GstByteReader * reader,
   return GST_FLOW_OK;
 }
 
-static guint
-sizeof_siz (GstJP2kDecimator * self, const ImageSize * siz)
-{
-  return 2 + 38 + 3 * siz->n_components;
-}
-
 static void
 reset_siz (GstJP2kDecimator * self, ImageSize * siz)
 {
@@ -838,9 +832,11 @@ write_plt (GstJP2kDecimator * self, GstByteWriter * writer,
   return GST_FLOW_OK;
 }
 
+/* Fills @p with the next packet, the data stays in the codestream */
 static GstFlowReturn
 parse_packet (GstJP2kDecimator * self, GstByteReader * reader,
-    const MainHeader * header, Tile * tile, const PacketIterator * it)
+    const MainHeader * header, const Tile * tile, const PacketIterator * it,
+    Packet * p)
 {
   GstFlowReturn ret = GST_FLOW_OK;
   guint16 marker = 0, length;
@@ -862,9 +858,10 @@ parse_packet (GstJP2kDecimator * self, GstByteReader * reader,
     plt = tile->plt->data;
   }
 
+  memset (p, 0, sizeof (Packet));
+
   if (plt) {
     guint32 length;
-    Packet *p;
 
     if (plt->packet_lengths->len <= it->cur_packet) {
       GST_ERROR_OBJECT (self, "Truncated PLT");
@@ -880,14 +877,11 @@ parse_packet (GstJP2kDecimator * self, GstByteReader * reader,
       goto done;
     }
 
-    p = g_slice_new0 (Packet);
-
     /* If there is a SOP keep the seqno */
     if (sop && length > 6) {
       if (!gst_byte_reader_peek_uint16_be (reader, &marker)) {
         GST_ERROR_OBJECT (self, "Truncated file");
         ret = GST_FLOW_ERROR;
-        g_slice_free (Packet, p);
         goto done;
       }
 
@@ -899,14 +893,12 @@ parse_packet (GstJP2kDecimator * self, GstByteReader * reader,
         if (!gst_byte_reader_get_uint16_be (reader, &dummy)) {
           GST_ERROR_OBJECT (self, "Truncated file");
           ret = GST_FLOW_ERROR;
-          g_slice_free (Packet, p);
           goto done;
         }
 
         if (!gst_byte_reader_get_uint16_be (reader, &seqno)) {
           GST_ERROR_OBJECT (self, "Truncated file");
           ret = GST_FLOW_ERROR;
-          g_slice_free (Packet, p);
           goto done;
         }
         p->data = gst_byte_reader_peek_data_unchecked (reader);
@@ -925,8 +917,6 @@ parse_packet (GstJP2kDecimator * self, GstByteReader * reader,
       p->eph = eph;
       gst_byte_reader_skip_unchecked (reader, length);
     }
-
-    tile->packets = g_list_prepend (tile->packets, p);
   } else if (sop) {
     if (!gst_byte_reader_peek_uint16_be (reader, &marker)) {
       GST_ERROR_OBJECT (self, "Truncated file");
@@ -966,14 +956,11 @@ parse_packet (GstJP2kDecimator * self, GstByteReader * reader,
       }
 
       if (marker == MARKER_SOP || marker == MARKER_EOC || marker == MARKER_SOT) {
-        Packet *p = g_slice_new (Packet);
-
         p->sop = TRUE;
         p->eph = eph;
         p->seqno = seqno;
         p->data = packet_start_data;
         p->length = reader->byte - packet_start_pos;
-        tile->packets = g_list_prepend (tile->packets, p);
 
         if (marker == MARKER_EOC || marker == MARKER_SOT)
           goto done;
@@ -1001,40 +988,9 @@ sizeof_packet (GstJP2kDecimator * self, const Packet * packet)
           && !packet->data) ? 2 : 0);
 }
 
+/* Parses the tile part header up to the SOD marker */
 static GstFlowReturn
-parse_packets (GstJP2kDecimator * self, GstByteReader * reader,
-    const MainHeader * header, Tile * tile)
-{
-  guint16 marker = 0;
-  GstFlowReturn ret = GST_FLOW_OK;
-  PacketIterator it;
-
-  /* Start of data here */
-  if (!gst_byte_reader_get_uint16_be (reader, &marker)
-      && marker != MARKER_SOD) {
-    GST_ERROR_OBJECT (self, "No SOD in tile");
-    return GST_FLOW_ERROR;
-  }
-
-  ret = init_packet_iterator (self, &it, header, tile);
-  if (ret != GST_FLOW_OK)
-    goto done;
-
-  while ((it.next (&it))) {
-    ret = parse_packet (self, reader, header, tile, &it);
-    if (ret != GST_FLOW_OK)
-      goto done;
-  }
-
-  tile->packets = g_list_reverse (tile->packets);
-
-done:
-
-  return ret;
-}
-
-static GstFlowReturn
-parse_tile (GstJP2kDecimator * self, GstByteReader * reader,
+parse_tile_header (GstJP2kDecimator * self, GstByteReader * reader,
     const MainHeader * header, Tile * tile)
 {
   GstFlowReturn ret = GST_FLOW_OK;
@@ -1210,15 +1166,14 @@ parse_tile (GstJP2kDecimator * self, GstByteReader * reader,
     }
   }
 
-  ret = parse_packets (self, reader, header, tile);
-
 done:
 
   return ret;
 }
 
+/* Size of the tile part header including SOT and SOD */
 static guint
-sizeof_tile (GstJP2kDecimator * self, const Tile * tile)
+sizeof_tile_header (GstJP2kDecimator * self, const Tile * tile)
 {
   guint size = 0;
   GList *l;
@@ -1250,11 +1205,6 @@ sizeof_tile (GstJP2kDecimator * self, const Tile * tile)
   /* SOD */
   size += 2;
 
-  for (l = tile->packets; l; l = l->next) {
-    Packet *p = l->data;
-    size += sizeof_packet (self, p);
-  }
-
   return size;
 }
 
@@ -1350,9 +1300,10 @@ write_packet (GstJP2kDecimator * self, GstByteWriter * writer,
   return GST_FLOW_OK;
 }
 
+/* Writes the tile part header up to and including the SOD marker */
 static GstFlowReturn
-write_tile (GstJP2kDecimator * self, GstByteWriter * writer,
-    const MainHeader * header, Tile * tile)
+write_tile_header (GstJP2kDecimator * self, GstByteWriter * writer,
+    const Tile * tile)
 {
   GList *l;
   GstFlowReturn ret = GST_FLOW_OK;
@@ -1412,21 +1363,14 @@ write_tile (GstJP2kDecimator * self, GstByteWriter * writer,
     goto done;
   }
 
-  for (l = tile->packets; l; l = l->next) {
-    Packet *p = l->data;
-
-    ret = write_packet (self, writer, p);
-    if (ret != GST_FLOW_OK)
-      goto done;
-  }
-
 done:
 
   return ret;
 }
 
-GstFlowReturn
-parse_main_header (GstJP2kDecimator * self, GstByteReader * reader,
+/* Parses the main header up to the first SOT marker, without the tiles */
+static GstFlowReturn
+parse_main_header_markers (GstJP2kDecimator * self, GstByteReader * reader,
     MainHeader * header)
 {
   GstFlowReturn ret = GST_FLOW_OK;
@@ -1589,68 +1533,11 @@ parse_main_header (GstJP2kDecimator * self, GstByteReader * reader,
       (header->siz.y - header->siz.yto + header->siz.yt - 1) / header->siz.yt;
   header->n_tiles = header->n_tiles_x * header->n_tiles_y;
 
-  header->tiles = g_slice_alloc0 (sizeof (Tile) * header->n_tiles);
-
-  /* now at SOT marker, read the tiles */
-  {
-    gint i;
-
-    for (i = 0; i < header->n_tiles; i++) {
-      ret = parse_tile (self, reader, header, &header->tiles[i]);
-      if (ret != GST_FLOW_OK)
-        goto done;
-    }
-  }
-
-  /* now there must be the EOC marker */
-  if (!gst_byte_reader_get_uint16_be (reader, &marker)
-      || marker != MARKER_EOC) {
-    GST_ERROR_OBJECT (self, "Frame does not end with EOC");
-    ret = GST_FLOW_ERROR;
-    goto done;
-  }
-
 done:
 
   return ret;
 }
 
-guint
-sizeof_main_header (GstJP2kDecimator * self, const MainHeader * header)
-{
-  guint size = 2;
-  GList *l;
-  gint i;
-
-  size += sizeof_siz (self, &header->siz);
-  size += sizeof_cod (self, &header->cod);
-  size += 2 + 2 + header->qcd.length;
-
-  for (l = header->qcc; l; l = l->next) {
-    Buffer *b = l->data;
-    size += 2 + 2 + b->length;
-  }
-
-  for (l = header->crg; l; l = l->next) {
-    Buffer *b = l->data;
-    size += 2 + 2 + b->length;
-  }
-
-  for (l = header->com; l; l = l->next) {
-    Buffer *b = l->data;
-    size += 2 + 2 + b->length;
-  }
-
-  for (i = 0; i < header->n_tiles; i++) {
-    size += sizeof_tile (self, &header->tiles[i]);
-  }
-
-  /* EOC */
-  size += 2;
-
-  return size;
-}
-
 void
 reset_main_header (GstJP2kDecimator * self, MainHeader * header)
 {
@@ -1682,13 +1569,13 @@ reset_main_header (GstJP2kDecimator * self, MainHeader * header)
   memset (header, 0, sizeof (MainHeader));
 }
 
-GstFlowReturn
-write_main_header (GstJP2kDecimator * self, GstByteWriter * writer,
+/* Writes the main header up to the first tile */
+static GstFlowReturn
+write_main_header_markers (GstJP2kDecimator * self, GstByteWriter * writer,
     const MainHeader * header)
 {
   GstFlowReturn ret = GST_FLOW_OK;
   GList *l;
-  gint i;
 
   if (!gst_byte_writer_ensure_free_space (writer, 2)) {
     GST_ERROR_OBJECT (self, "Could not ensure free space");
@@ -1733,86 +1620,304 @@ write_main_header (GstJP2kDecimator * self, GstByteWriter * writer,
       goto done;
   }
 
-  for (i = 0; i < header->n_tiles; i++) {
-    ret = write_tile (self, writer, header, &header->tiles[i]);
+done:
+  return ret;
+}
+
+static gboolean
+keep_packet (GstJP2kDecimator * self, const PacketIterator * it)
+{
+  return !((self->max_layers != 0 && it->cur_layer >= self->max_layers) ||
+      (self->max_decomposition_levels != -1
+          && it->cur_resolution > self->max_decomposition_levels));
+}
+
+/* Streaming decimation
+ *
+ * The codestream is walked once, only the main header and the header of the
+ * current tile part are parsed into structures. The output is collected as
+ * segments that either reference the input, for the kept packets, or the
+ * bytes written for the rewritten headers and the dropped packets. The
+ * result is the same as parsing the whole codestream into the tiles of the
+ * MainHeader, decimating and writing it again, which is what the unit test
+ * compares it with.
+ */
+typedef struct
+{
+  gboolean input;
+  guint offset, length;
+} Segment;
+
+typedef struct
+{
+  const guint8 *data;           /* input codestream */
+  GstByteWriter writer;
+  guint writer_pos;             /* end of the last writer segment */
+  GArray *segments;             /* array of Segment */
+  guint size;
+} Output;
+
+static void
+output_add (Output * out, gboolean input, guint offset, guint length)
+{
+  Segment *last = NULL;
+
+  if (length == 0)
+    return;
+
+  if (out->segments->len > 0)
+    last = &g_array_index (out->segments, Segment, out->segments->len - 1);
+
+  if (last && last->input == input && last->offset + last->length == offset) {
+    last->length += length;
+  } else {
+    Segment segment = { input, offset, length };
+
+    g_array_append_val (out->segments, segment);
+  }
+
+  out->size += length;
+}
+
+/* Adds the bytes written since the last call */
+static void
+output_add_written (Output * out)
+{
+  guint pos = gst_byte_writer_get_pos (&out->writer);
+
+  output_add (out, FALSE, out->writer_pos, pos - out->writer_pos);
+  out->writer_pos = pos;
+}
+
+static GstBuffer *
+output_finish (Output * out, GstBuffer * inbuf)
+{
+  GstBuffer *outbuf;
+  guint written_size = gst_byte_writer_get_size (&out->writer);
+  guint8 *written = gst_byte_writer_reset_and_get_data (&out->writer);
+  guint i;
+
+  if (out->segments->len <= GST_BUFFER_MEM_MAX &&
+      gst_buffer_n_memory (inbuf) == 1) {
+    GstMemory *mem;
+
+    /* the kept packets are shared with the input */
+    mem = gst_memory_new_wrapped (0, written, written_size, 0, written_size,
+        written, g_free);
+    outbuf = gst_buffer_new ();
+    for (i = 0; i < out->segments->len; i++) {
+      Segment *segment = &g_array_index (out->segments, Segment, i);
+
+      if (segment->input)
+        gst_buffer_copy_into (outbuf, inbuf, GST_BUFFER_COPY_MEMORY,
+            segment->offset, segment->length);
+      else
+        gst_buffer_append_memory (outbuf, gst_memory_share (mem,
+                segment->offset, segment->length));
+    }
+    gst_memory_unref (mem);
+  } else {
+    GstMapInfo map;
+    guint pos = 0;
+
+    /* too many pieces for one buffer, they would be merged anyway */
+    outbuf = gst_buffer_new_allocate (NULL, out->size, NULL);
+    gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
+    for (i = 0; i < out->segments->len; i++) {
+      Segment *segment = &g_array_index (out->segments, Segment, i);
+
+      memcpy (map.data + pos,
+          (segment->input ? out->data : written) + segment->offset,
+          segment->length);
+      pos += segment->length;
+    }
+    gst_buffer_unmap (outbuf, &map);
+    g_free (written);
+  }
+
+  return outbuf;
+}
+
+static GstFlowReturn
+decimate_tile_streaming (GstJP2kDecimator * self, GstByteReader * reader,
+    const MainHeader * header, GArray * packets, Output * out)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  PacketIterator it;
+  Tile tile;
+  guint16 marker = 0;
+  guint i, size;
+
+  memset (&tile, 0, sizeof (Tile));
+
+  ret = parse_tile_header (self, reader, header, &tile);
+  if (ret != GST_FLOW_OK)
+    goto done;
+
+  /* Start of data here */
+  if (!gst_byte_reader_get_uint16_be (reader, &marker)
+      || marker != MARKER_SOD) {
+    GST_ERROR_OBJECT (self, "No SOD in tile");
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+
+  ret = init_packet_iterator (self, &it, header, &tile);
+  if (ret != GST_FLOW_OK)
+    goto done;
+
+  g_array_set_size (packets, 0);
+  while ((it.next (&it))) {
+    Packet *p;
+
+    g_array_set_size (packets, packets->len + 1);
+    p = &g_array_index (packets, Packet, packets->len - 1);
+
+    ret = parse_packet (self, reader, header, &tile, &it, p);
     if (ret != GST_FLOW_OK)
       goto done;
+
+    if (!keep_packet (self, &it)) {
+      p->data = NULL;
+      p->length = 1;
+    }
   }
 
-  if (!gst_byte_writer_ensure_free_space (writer, 2)) {
-    GST_ERROR_OBJECT (self, "Could not ensure free space");
-    ret = GST_FLOW_ERROR;
+  if (tile.plt) {
+    PacketLengthTilePart *plt;
+
+    if (g_list_length (tile.plt) > 1) {
+      GST_ERROR_OBJECT (self, "Multiple PLT per tile not supported yet");
+      ret = GST_FLOW_ERROR;
+      goto done;
+    }
+
+    plt = g_slice_new (PacketLengthTilePart);
+    plt->index = 0;
+    plt->packet_lengths = g_array_sized_new (FALSE, FALSE, sizeof (guint32),
+        packets->len);
+    for (i = 0; i < packets->len; i++) {
+      guint32 len = sizeof_packet (self, &g_array_index (packets, Packet, i));
+
+      g_array_append_val (plt->packet_lengths, len);
+    }
+
+    reset_plt (self, tile.plt->data);
+    g_slice_free (PacketLengthTilePart, tile.plt->data);
+    tile.plt->data = plt;
+  }
+
+  size = sizeof_tile_header (self, &tile);
+  for (i = 0; i < packets->len; i++)
+    size += sizeof_packet (self, &g_array_index (packets, Packet, i));
+  tile.sot.tile_part_size = size;
+
+  ret = write_tile_header (self, &out->writer, &tile);
+  if (ret != GST_FLOW_OK)
     goto done;
+
+  for (i = 0; i < packets->len; i++) {
+    Packet *p = &g_array_index (packets, Packet, i);
+    guint offset, length;
+
+    if (p->data == NULL) {
+      ret = write_packet (self, &out->writer, p);
+      if (ret != GST_FLOW_OK)
+        goto done;
+      continue;
+    }
+
+    offset = p->data - out->data;
+    length = p->length;
+
+    if (p->sop) {
+      /* reference the SOP marker too if it is written the same way */
+      if (offset >= 6 && GST_READ_UINT16_BE (p->data - 6) == MARKER_SOP &&
+          GST_READ_UINT16_BE (p->data - 4) == 4) {
+        offset -= 6;
+        length += 6;
+      } else {
+        if (!gst_byte_writer_ensure_free_space (&out->writer, 6)) {
+          GST_ERROR_OBJECT (self, "Could not ensure free space");
+          ret = GST_FLOW_ERROR;
+          goto done;
+        }
+        gst_byte_writer_put_uint16_be_unchecked (&out->writer, MARKER_SOP);
+        gst_byte_writer_put_uint16_be_unchecked (&out->writer, 4);
+        gst_byte_writer_put_uint16_be_unchecked (&out->writer, p->seqno);
+      }
+    }
+
+    output_add_written (out);
+    output_add (out, TRUE, offset, length);
   }
-  gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_EOC);
 
 done:
+  reset_tile (self, header, &tile);
+
   return ret;
 }
 
 GstFlowReturn
-decimate_main_header (GstJP2kDecimator * self, MainHeader * header)
+decimate_codestream (GstJP2kDecimator * self, GstBuffer * inbuf,
+    const GstMapInfo * info, GstBuffer ** outbuf)
 {
   GstFlowReturn ret = GST_FLOW_OK;
+  GstByteReader reader;
+  MainHeader header;
+  GArray *packets;
+  Output out;
+  guint16 marker = 0;
   gint i;
 
-  for (i = 0; i < header->n_tiles; i++) {
-    Tile *tile = &header->tiles[i];
-    GList *l;
-    PacketIterator it;
-    PacketLengthTilePart *plt = NULL;
-
-    if (tile->plt) {
-      if (g_list_length (tile->plt) > 1) {
-        GST_ERROR_OBJECT (self, "Multiple PLT per tile not supported yet");
-        ret = GST_FLOW_ERROR;
-        goto done;
-      }
-      plt = g_slice_new (PacketLengthTilePart);
-      plt->index = 0;
-      plt->packet_lengths = g_array_new (FALSE, FALSE, sizeof (guint32));
-    }
-
-    init_packet_iterator (self, &it, header, tile);
+  *outbuf = NULL;
 
-    l = tile->packets;
-    while ((it.next (&it))) {
-      Packet *p;
+  gst_byte_reader_init (&reader, info->data, info->size);
+  memset (&header, 0, sizeof (MainHeader));
 
-      if (l == NULL) {
-        GST_ERROR_OBJECT (self, "Not enough packets");
-        ret = GST_FLOW_ERROR;
-        g_array_free (plt->packet_lengths, TRUE);
-        g_slice_free (PacketLengthTilePart, plt);
-        goto done;
-      }
-
-      p = l->data;
+  memset (&out, 0, sizeof (Output));
+  out.data = info->data;
+  /* only the headers and the dropped packets are written */
+  gst_byte_writer_init_with_size (&out.writer, 4096, FALSE);
+  out.segments = g_array_new (FALSE, FALSE, sizeof (Segment));
+  packets = g_array_new (FALSE, FALSE, sizeof (Packet));
 
-      if ((self->max_layers != 0 && it.cur_layer >= self->max_layers) ||
-          (self->max_decomposition_levels != -1
-              && it.cur_resolution > self->max_decomposition_levels)) {
-        p->data = NULL;
-        p->length = 1;
-      }
+  ret = parse_main_header_markers (self, &reader, &header);
+  if (ret != GST_FLOW_OK)
+    goto done;
 
-      if (plt) {
-        guint32 len = sizeof_packet (self, p);
-        g_array_append_val (plt->packet_lengths, len);
-      }
+  ret = write_main_header_markers (self, &out.writer, &header);
+  if (ret != GST_FLOW_OK)
+    goto done;
 
-      l = l->next;
-    }
+  for (i = 0; i < header.n_tiles; i++) {
+    ret = decimate_tile_streaming (self, &reader, &header, packets, &out);
+    if (ret != GST_FLOW_OK)
+      goto done;
+  }
 
-    if (plt) {
-      reset_plt (self, tile->plt->data);
-      g_slice_free (PacketLengthTilePart, tile->plt->data);
-      tile->plt->data = plt;
-    }
+  /* now there must be the EOC marker */
+  if (!gst_byte_reader_get_uint16_be (&reader, &marker)
+      || marker != MARKER_EOC) {
+    GST_ERROR_OBJECT (self, "Frame does not end with EOC");
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
 
-    tile->sot.tile_part_size = sizeof_tile (self, tile);
+  if (!gst_byte_writer_put_uint16_be (&out.writer, MARKER_EOC)) {
+    GST_ERROR_OBJECT (self, "Could not ensure free space");
+    ret = GST_FLOW_ERROR;
+    goto done;
   }
+  output_add_written (&out);
+
+  *outbuf = output_finish (&out, inbuf);
 
 done:
+  gst_byte_writer_reset (&out.writer);
+  g_array_free (out.segments, TRUE);
+  g_array_free (packets, TRUE);
+  reset_main_header (self, &header);
+
   return ret;
 }
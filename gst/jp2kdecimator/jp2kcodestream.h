@@ -184,10 +184,7 @@ struct _PacketIterator
   gint cur_packet;
 };
 
-GstFlowReturn parse_main_header (GstJP2kDecimator * self, GstByteReader * reader, MainHeader * header);
-guint sizeof_main_header (GstJP2kDecimator * self, const MainHeader * header);
 void reset_main_header (GstJP2kDecimator * self, MainHeader * header);
-GstFlowReturn write_main_header (GstJP2kDecimator * self, GstByteWriter * writer, const MainHeader * header);
-GstFlowReturn decimate_main_header (GstJP2kDecimator * self, MainHeader * header);
+GstFlowReturn decimate_codestream (GstJP2kDecimator * self, GstBuffer * inbuf, const GstMapInfo * info, GstBuffer ** outbuf);
 
 #endif /* __JP2K_CODESTREAM_H__ */
@@ -34,6 +34,12 @@
  *
  * Unlike the adder, the liveadder mixes the streams according the their
  * timestamps and waits for some milli-seconds before trying doing the mixing.
+ *
+ * The streams are mixed in periods of the duration of the first buffer
+ * received. A period is mixed as soon as all sink pads that are not EOS have
+ * data for it, and at the latest once its running time plus the latency is
+ * reached, the data that arrives later is dropped. The #GstLiveAdder:stats
+ * property tells how late the data of each sink pad arrives.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -48,6 +54,8 @@
 
 #define DEFAULT_LATENCY_MS 60
 
+#define QUEUE_INITIAL_SIZE 16
+
 GST_DEBUG_CATEGORY_STATIC (live_adder_debug);
 #define GST_CAT_DEFAULT (live_adder_debug)
 
@@ -82,15 +90,50 @@ enum
 {
   PROP_0,
   PROP_LATENCY,
+  PROP_STATS
 };
 
+typedef struct _GstLiveAdderItem
+{
+  /* timestamped in running time */
+  GstBuffer *buffer;
+  /* monotonic time at which the buffer was received */
+  gint64 arrival;
+} GstLiveAdderItem;
+
 typedef struct _GstLiveAdderPadPrivate
 {
+  /* only used by the streaming thread of the pad */
   GstSegment segment;
-  gboolean eos;
-
   GstClockTime expected_timestamp;
-
+  /* end of the last queued buffer, 0 if none */
+  GstClockTime queued_end;
+
+  volatile gint eos;
+
+  /* hands the buffers to the srcpad task without taking the object lock,
+   * only popped with the object lock held */
+  GstAtomicQueue *queue;
+
+  /* set by the task while it waits for this pad to queue data up to
+   * wait_end, cleared by whichever thread sees that first */
+  volatile gint waiting;
+  GstClockTime wait_end;
+
+  /* the rest is protected by the object lock */
+  /* buffers taken from the queue, ordered head to tail */
+  GQueue pending;
+  GstClockTime pending_end;
+  /* arrival of the data that completed the period being mixed, -1 if it
+   * is not complete */
+  gint64 period_arrival;
+
+  /* statistics, kept as long as the pad exists */
+  guint64 completed;
+  guint64 missed;
+  guint64 dropped;
+  GstClockTime lateness_sum;
+  GstClockTime lateness_max;
 } GstLiveAdderPadPrivate;
 
 G_DEFINE_TYPE (GstLiveAdder, gst_live_adder, GST_TYPE_ELEMENT);
@@ -128,6 +171,12 @@ static gboolean gst_live_adder_sink_event (GstPad * pad, GstObject * parent,
 
 
 static void reset_pad_private (GstPad * pad);
+static void flush_pad_private (GstPad * pad);
+static void pad_private_free (GstLiveAdderPadPrivate * padprivate);
+static void gst_live_adder_item_free (GstLiveAdderItem * item);
+static void gst_live_adder_pad_update (GstLiveAdder * adder,
+    GstLiveAdderPadPrivate * padprivate);
+static GstStructure *gst_live_adder_get_stats (GstLiveAdder * adder);
 
 /* clipping versions */
 #define MAKE_FUNC(name,type,ttype,min,max)                      \
@@ -137,6 +186,16 @@ static void name (type *out, type *in, gint bytes) {            \
     out[i] = CLAMP ((ttype)out[i] + (ttype)in[i], min, max);    \
 }
 
+/* unsigned versions, silence is in the middle of the range and the output
+ * starts with silence */
+#define MAKE_FUNC_U(name,type,ttype,bias,max)                   \
+static void name (type *out, type *in, gint bytes) {            \
+  gint i;                                                       \
+  for (i = 0; i < bytes / sizeof (type); i++)                   \
+    out[i] = CLAMP ((ttype)out[i] + (ttype)in[i] - (ttype)bias, \
+        0, max);                                                \
+}
+
 /* non-clipping versions (for float) */
 #define MAKE_FUNC_NC(name,type,ttype)                           \
 static void name (type *out, type *in, gint bytes) {            \
@@ -149,9 +208,9 @@ static void name (type *out, type *in, gint bytes) {            \
 MAKE_FUNC (add_int32, gint32, gint64, G_MININT32, G_MAXINT32)
 MAKE_FUNC (add_int16, gint16, gint32, G_MININT16, G_MAXINT16)
 MAKE_FUNC (add_int8, gint8, gint16, G_MININT8, G_MAXINT8)
-MAKE_FUNC (add_uint32, guint32, guint64, 0, G_MAXUINT32)
-MAKE_FUNC (add_uint16, guint16, guint32, 0, G_MAXUINT16)
-MAKE_FUNC (add_uint8, guint8, guint16, 0, G_MAXUINT8)
+MAKE_FUNC_U (add_uint32, guint32, gint64, G_MAXINT32 + 1U, G_MAXUINT32)
+MAKE_FUNC_U (add_uint16, guint16, gint32, 0x8000, G_MAXUINT16)
+MAKE_FUNC_U (add_uint8, guint8, gint16, 0x80, G_MAXUINT8)
 MAKE_FUNC_NC (add_float64, gdouble, gdouble)
 MAKE_FUNC_NC (add_float32, gfloat, gfloat)
 /* *INDENT-ON* */
@@ -187,6 +246,21 @@ gst_live_adder_class_init (GstLiveAdderClass * klass)
           "Amount of data to buffer (in milliseconds)",
           0, G_MAXUINT, DEFAULT_LATENCY_MS,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstLiveAdder:stats:
+   *
+   * A structure with a "pad-stats" structure per sink pad, named after the
+   * pad. It holds the number of periods the pad completed ("completed"),
+   * the periods mixed without all of its data ("missed"), the buffers
+   * dropped because they arrived too late ("dropped") and how much later
+   * than the first pad the pad completed a period on average and at most
+   * ("average-lateness", "max-lateness", in nanoseconds).
+   */
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Per sink pad lateness statistics", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -209,8 +283,6 @@ gst_live_adder_init (GstLiveAdder * adder)
   adder->next_timestamp = GST_CLOCK_TIME_NONE;
 
   adder->latency_ms = DEFAULT_LATENCY_MS;
-
-  adder->buffers = g_queue_new ();
 }
 
 
@@ -221,11 +293,6 @@ gst_live_adder_finalize (GObject * object)
 
   g_cond_clear (&adder->not_empty_cond);
 
-  g_queue_foreach (adder->buffers, (GFunc) gst_mini_object_unref, NULL);
-  while (g_queue_pop_head (adder->buffers)) {
-  }
-  g_queue_free (adder->buffers);
-
   g_list_free (adder->sinkpads);
 
   G_OBJECT_CLASS (gst_live_adder_parent_class)->finalize (object);
@@ -280,6 +347,9 @@ gst_live_adder_get_property (GObject * object,
       g_value_set_uint (value, adder->latency_ms);
       GST_OBJECT_UNLOCK (adder);
       break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_live_adder_get_stats (adder));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -453,13 +523,9 @@ gst_live_adder_flush_start (GstLiveAdder * adder)
   GST_DEBUG_OBJECT (adder, "Disabling pop on queue");
 
   GST_OBJECT_LOCK (adder);
-  /* mark ourselves as flushing */
+  /* mark ourselves as flushing, the queued data is dropped on flush-stop */
   adder->srcresult = GST_FLOW_FLUSHING;
 
-  /* Empty the queue */
-  g_queue_foreach (adder->buffers, (GFunc) gst_mini_object_unref, NULL);
-  while (g_queue_pop_head (adder->buffers));
-
   /* unlock clock, we just unschedule, the entry will be released by the
    * locking streaming thread. */
   if (adder->clock_id)
@@ -555,6 +621,9 @@ gst_live_adder_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
     case GST_EVENT_FLUSH_STOP:
       GST_OBJECT_LOCK (adder);
       adder->next_timestamp = GST_CLOCK_TIME_NONE;
+      adder->period_samples = 0;
+      adder->discont = FALSE;
+      g_list_foreach (adder->sinkpads, (GFunc) flush_pad_private, NULL);
       reset_pad_private (pad);
       GST_OBJECT_UNLOCK (adder);
       ret = gst_pad_push_event (adder->srcpad, event);
@@ -563,22 +632,21 @@ gst_live_adder_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       break;
     case GST_EVENT_EOS:
     {
-      GST_OBJECT_LOCK (adder);
+      GstFlowReturn srcresult;
 
-      ret = adder->srcresult == GST_FLOW_OK;
-      if (ret && !padprivate->eos) {
+      srcresult = g_atomic_int_get ((gint *) & adder->srcresult);
+      ret = srcresult == GST_FLOW_OK;
+      if (ret && !g_atomic_int_get (&padprivate->eos)) {
         GST_DEBUG_OBJECT (adder, "queuing EOS");
-        padprivate->eos = TRUE;
-        g_cond_broadcast (&adder->not_empty_cond);
-      } else if (padprivate->eos) {
+        g_atomic_int_set (&padprivate->eos, TRUE);
+        gst_live_adder_pad_update (adder, padprivate);
+      } else if (g_atomic_int_get (&padprivate->eos)) {
         GST_DEBUG_OBJECT (adder, "dropping EOS, we are already EOS");
       } else {
         GST_DEBUG_OBJECT (adder, "dropping EOS, reason %s",
-            gst_flow_get_name (adder->srcresult));
+            gst_flow_get_name (srcresult));
       }
 
-      GST_OBJECT_UNLOCK (adder);
-
       gst_event_unref (event);
       break;
     }
@@ -880,19 +948,49 @@ gst_live_adder_length_from_duration (GstLiveAdder * adder,
   return (guint) ret;
 }
 
+static void
+gst_live_adder_item_free (GstLiveAdderItem * item)
+{
+  gst_buffer_unref (item->buffer);
+  g_slice_free (GstLiveAdderItem, item);
+}
+
+/* Called from the streaming thread of a pad after it queued a buffer or
+ * went EOS, wakes up the task if it is waiting for this pad. The object lock
+ * is only taken when the task has to be woken up. */
+static void
+gst_live_adder_pad_update (GstLiveAdder * adder,
+    GstLiveAdderPadPrivate * padprivate)
+{
+  if (g_atomic_int_get (&padprivate->waiting) &&
+      (g_atomic_int_get (&padprivate->eos) ||
+          padprivate->queued_end >= padprivate->wait_end) &&
+      g_atomic_int_compare_and_exchange (&padprivate->waiting, TRUE, FALSE) &&
+      g_atomic_int_dec_and_test (&adder->n_missing)) {
+    GST_LOG_OBJECT (adder, "all pads have data for the next period");
+    GST_OBJECT_LOCK (adder);
+    if (adder->clock_id)
+      gst_clock_id_unschedule (adder->clock_id);
+    GST_OBJECT_UNLOCK (adder);
+  }
+
+  if (g_atomic_int_get (&adder->idle)) {
+    GST_OBJECT_LOCK (adder);
+    g_cond_broadcast (&adder->not_empty_cond);
+    GST_OBJECT_UNLOCK (adder);
+  }
+}
+
 static GstFlowReturn
 gst_live_live_adder_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 {
   GstLiveAdder *adder = GST_LIVE_ADDER (parent);
   GstLiveAdderPadPrivate *padprivate = NULL;
+  GstLiveAdderItem *item;
   GstFlowReturn ret = GST_FLOW_OK;
-  GList *item = NULL;
-  GstClockTime skip = 0;
   gint64 drift = 0;             /* Positive if new buffer after old buffer */
 
-  GST_OBJECT_LOCK (adder);
-
-  ret = adder->srcresult;
+  ret = g_atomic_int_get ((gint *) & adder->srcresult);
 
   GST_DEBUG ("Incoming buffer time:%" GST_TIME_FORMAT " duration:%"
       GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)),
@@ -913,7 +1011,7 @@ gst_live_live_adder_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
     goto out;
   }
 
-  if (padprivate->eos) {
+  if (g_atomic_int_get (&padprivate->eos)) {
     GST_DEBUG_OBJECT (adder, "Received buffer after EOS");
     ret = GST_FLOW_EOS;
     gst_buffer_unref (buffer);
@@ -987,138 +1085,22 @@ gst_live_live_adder_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
       gst_segment_to_running_time (&padprivate->segment,
       padprivate->segment.format, GST_BUFFER_TIMESTAMP (buffer));
 
+  /* late buffers are dropped by the task, it knows what was already mixed */
+  item = g_slice_new (GstLiveAdderItem);
+  item->buffer = buffer;
+  item->arrival = g_get_monotonic_time ();
+  padprivate->queued_end = GST_BUFFER_TIMESTAMP (buffer) +
+      GST_BUFFER_DURATION (buffer);
+  gst_atomic_queue_push (padprivate->queue, item);
 
-  if (GST_CLOCK_TIME_IS_VALID (adder->next_timestamp) &&
-      GST_BUFFER_TIMESTAMP (buffer) < adder->next_timestamp) {
-    if (GST_BUFFER_TIMESTAMP (buffer) + GST_BUFFER_DURATION (buffer) <
-        adder->next_timestamp) {
-      GST_DEBUG_OBJECT (adder, "Buffer is late, dropping (ts: %" GST_TIME_FORMAT
-          " duration: %" GST_TIME_FORMAT ")",
-          GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)),
-          GST_TIME_ARGS (GST_BUFFER_DURATION (buffer)));
-      gst_buffer_unref (buffer);
-      goto out;
-    } else {
-      skip = adder->next_timestamp - GST_BUFFER_TIMESTAMP (buffer);
-      GST_DEBUG_OBJECT (adder, "Buffer is partially late, skipping %"
-          GST_TIME_FORMAT, GST_TIME_ARGS (skip));
-    }
-  }
-
-  /* If our new buffer's head is higher than the queue's head, lets wake up,
-   * we may not have to wait for as long
-   */
-  if (adder->clock_id &&
-      g_queue_peek_head (adder->buffers) != NULL &&
-      GST_BUFFER_TIMESTAMP (buffer) + skip <
-      GST_BUFFER_TIMESTAMP (g_queue_peek_head (adder->buffers)))
-    gst_clock_id_unschedule (adder->clock_id);
-
-  for (item = g_queue_peek_head_link (adder->buffers);
-      item; item = g_list_next (item)) {
-    GstBuffer *oldbuffer = item->data;
-    GstClockTime old_skip = 0;
-    GstClockTime mix_duration = 0;
-    GstClockTime mix_start = 0;
-    GstClockTime mix_end = 0;
-    GstMapInfo oldmap, map;
-
-    /* We haven't reached our place yet */
-    if (GST_BUFFER_TIMESTAMP (buffer) + skip >=
-        GST_BUFFER_TIMESTAMP (oldbuffer) + GST_BUFFER_DURATION (oldbuffer))
-      continue;
-
-    /* We're past our place, lets insert ouselves here */
-    if (GST_BUFFER_TIMESTAMP (buffer) + GST_BUFFER_DURATION (buffer) <=
-        GST_BUFFER_TIMESTAMP (oldbuffer))
-      break;
-
-    /* if we reach this spot, we have overlap, so we must mix */
-
-    /* First make a subbuffer with the non-overlapping part */
-    if (GST_BUFFER_TIMESTAMP (buffer) + skip < GST_BUFFER_TIMESTAMP (oldbuffer)) {
-      GstBuffer *subbuffer = NULL;
-      GstClockTime subbuffer_duration = GST_BUFFER_TIMESTAMP (oldbuffer) -
-          (GST_BUFFER_TIMESTAMP (buffer) + skip);
-
-      subbuffer = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL,
-          gst_live_adder_length_from_duration (adder, skip),
-          gst_live_adder_length_from_duration (adder, subbuffer_duration));
-
-      GST_BUFFER_TIMESTAMP (subbuffer) = GST_BUFFER_TIMESTAMP (buffer) + skip;
-      GST_BUFFER_DURATION (subbuffer) = subbuffer_duration;
-
-      skip += subbuffer_duration;
-
-      g_queue_insert_before (adder->buffers, item, subbuffer);
-    }
-
-    /* Now we are on the overlapping part */
-    oldbuffer = gst_buffer_make_writable (oldbuffer);
-    item->data = oldbuffer;
-
-    old_skip = GST_BUFFER_TIMESTAMP (buffer) + skip -
-        GST_BUFFER_TIMESTAMP (oldbuffer);
-
-    mix_start = GST_BUFFER_TIMESTAMP (oldbuffer) + old_skip;
-
-    if (GST_BUFFER_TIMESTAMP (buffer) + GST_BUFFER_DURATION (buffer) <
-        GST_BUFFER_TIMESTAMP (oldbuffer) + GST_BUFFER_DURATION (oldbuffer))
-      mix_end = GST_BUFFER_TIMESTAMP (buffer) + GST_BUFFER_DURATION (buffer);
-    else
-      mix_end = GST_BUFFER_TIMESTAMP (oldbuffer) +
-          GST_BUFFER_DURATION (oldbuffer);
-
-    mix_duration = mix_end - mix_start;
-
-    if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_GAP)) {
-      GST_BUFFER_FLAG_UNSET (oldbuffer, GST_BUFFER_FLAG_GAP);
-      gst_buffer_map (oldbuffer, &oldmap, GST_MAP_WRITE);
-      gst_buffer_map (buffer, &map, GST_MAP_READ);
-      adder->func (oldmap.data +
-          gst_live_adder_length_from_duration (adder, old_skip),
-          map.data +
-          gst_live_adder_length_from_duration (adder, skip),
-          gst_live_adder_length_from_duration (adder, mix_duration));
-      gst_buffer_unmap (oldbuffer, &oldmap);
-      gst_buffer_unmap (buffer, &map);
-    }
-    skip += mix_duration;
-  }
-
-  g_cond_broadcast (&adder->not_empty_cond);
-
-  if (skip == GST_BUFFER_DURATION (buffer)) {
-    gst_buffer_unref (buffer);
-  } else {
-    if (skip) {
-      GstClockTime subbuffer_duration = GST_BUFFER_DURATION (buffer) - skip;
-      GstClockTime subbuffer_ts = GST_BUFFER_TIMESTAMP (buffer) + skip;
-      GstBuffer *new_buffer = gst_buffer_copy_region (buffer,
-          GST_BUFFER_COPY_ALL,
-          gst_live_adder_length_from_duration (adder, skip),
-          gst_live_adder_length_from_duration (adder, subbuffer_duration));
-      gst_buffer_unref (buffer);
-      buffer = new_buffer;
-      GST_BUFFER_PTS (buffer) = subbuffer_ts;
-      GST_BUFFER_DURATION (buffer) = subbuffer_duration;
-    }
-
-    if (item)
-      g_queue_insert_before (adder->buffers, item, buffer);
-    else
-      g_queue_push_tail (adder->buffers, buffer);
-  }
+  gst_live_adder_pad_update (adder, padprivate);
 
 out:
 
-  GST_OBJECT_UNLOCK (adder);
-
   return ret;
 
 invalid_timestamp:
 
-  GST_OBJECT_UNLOCK (adder);
   gst_buffer_unref (buffer);
   GST_ELEMENT_ERROR (adder, STREAM, FAILED,
       ("Buffer without a valid timestamp received"),
@@ -1145,40 +1127,333 @@ check_eos_locked (GstLiveAdder * adder)
     GstPad *pad = item->data;
     GstLiveAdderPadPrivate *padprivate = gst_pad_get_element_private (pad);
 
-    if (padprivate && padprivate->eos != TRUE)
+    if (padprivate && !g_atomic_int_get (&padprivate->eos))
       return FALSE;
   }
 
   return TRUE;
 }
 
+/* Moves the buffers the pads queued to their pending queues, dropping the
+ * ones that end before the next period. Returns the earliest timestamp of
+ * the pending buffers or GST_CLOCK_TIME_NONE if there are none. */
+static GstClockTime
+gst_live_adder_collect_locked (GstLiveAdder * adder)
+{
+  GstClockTime first = GST_CLOCK_TIME_NONE;
+  GList *l;
+
+  for (l = adder->sinkpads; l; l = g_list_next (l)) {
+    GstLiveAdderPadPrivate *padprivate = gst_pad_get_element_private (l->data);
+    GstLiveAdderItem *item;
+
+    if (!padprivate)
+      continue;
+
+    while ((item = gst_atomic_queue_pop (padprivate->queue))) {
+      GstClockTime end = GST_BUFFER_TIMESTAMP (item->buffer) +
+          GST_BUFFER_DURATION (item->buffer);
+
+      if (GST_CLOCK_TIME_IS_VALID (adder->next_timestamp) &&
+          end <= adder->next_timestamp) {
+        GST_DEBUG_OBJECT (l->data, "Buffer is late, dropping (ts: %"
+            GST_TIME_FORMAT " duration: %" GST_TIME_FORMAT ")",
+            GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (item->buffer)),
+            GST_TIME_ARGS (GST_BUFFER_DURATION (item->buffer)));
+        padprivate->dropped++;
+        gst_live_adder_item_free (item);
+        continue;
+      }
+
+      g_queue_push_tail (&padprivate->pending, item);
+      padprivate->pending_end = end;
+    }
+
+    item = g_queue_peek_head (&padprivate->pending);
+    if (item && (!GST_CLOCK_TIME_IS_VALID (first) ||
+            GST_BUFFER_TIMESTAMP (item->buffer) < first))
+      first = GST_BUFFER_TIMESTAMP (item->buffer);
+  }
+
+  return first;
+}
+
+/* Starts a new run of periods at @timestamp */
+static void
+gst_live_adder_restart_locked (GstLiveAdder * adder, GstClockTime timestamp)
+{
+  GList *l;
+
+  if (adder->period_samples == 0) {
+    /* the first buffer received defines the period */
+    for (l = adder->sinkpads; l; l = g_list_next (l)) {
+      GstLiveAdderPadPrivate *padprivate =
+          gst_pad_get_element_private (l->data);
+      GstLiveAdderItem *item;
+
+      if (!padprivate)
+        continue;
+
+      item = g_queue_peek_head (&padprivate->pending);
+      if (item && GST_BUFFER_TIMESTAMP (item->buffer) == timestamp) {
+        adder->period_samples =
+            gst_util_uint64_scale_int_round (GST_BUFFER_DURATION
+            (item->buffer), GST_AUDIO_INFO_RATE (&adder->info), GST_SECOND);
+        break;
+      }
+    }
+    adder->period_samples = MAX (adder->period_samples, 1);
+    GST_DEBUG_OBJECT (adder, "mixing periods of %u samples",
+        adder->period_samples);
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (adder->next_timestamp)) {
+    GST_DEBUG_OBJECT (adder, "Expected data at %" GST_TIME_FORMAT
+        ", but is at %" GST_TIME_FORMAT ", setting discont",
+        GST_TIME_ARGS (adder->next_timestamp), GST_TIME_ARGS (timestamp));
+    adder->discont = TRUE;
+  }
+
+  adder->base_timestamp = timestamp;
+  adder->n_samples = 0;
+  adder->next_timestamp = timestamp;
+}
+
+/* Returns the number of pads that are not EOS and have no data up to @end */
+static guint
+gst_live_adder_count_missing_locked (GstLiveAdder * adder, GstClockTime end)
+{
+  guint n_missing = 0;
+  GList *l;
+
+  for (l = adder->sinkpads; l; l = g_list_next (l)) {
+    GstLiveAdderPadPrivate *padprivate = gst_pad_get_element_private (l->data);
+
+    if (padprivate && !g_atomic_int_get (&padprivate->eos) &&
+        padprivate->pending_end < end)
+      n_missing++;
+  }
+
+  return n_missing;
+}
+
+/* Marks the pads that have no data up to @end yet, the streaming thread of
+ * the last one of them to queue it unschedules the clock wait of the task.
+ * Returns TRUE if they all did already. */
+static gboolean
+gst_live_adder_arm_locked (GstLiveAdder * adder, GstClockTime end)
+{
+  GList *l;
+
+  g_atomic_int_set (&adder->n_missing, 1);
+
+  for (l = adder->sinkpads; l; l = g_list_next (l)) {
+    GstLiveAdderPadPrivate *padprivate = gst_pad_get_element_private (l->data);
+
+    if (!padprivate || g_atomic_int_get (&padprivate->eos) ||
+        padprivate->pending_end >= end)
+      continue;
+
+    padprivate->wait_end = end;
+    g_atomic_int_inc (&adder->n_missing);
+    g_atomic_int_set (&padprivate->waiting, TRUE);
+  }
+
+  /* data queued before the pads were marked did not wake us up */
+  gst_live_adder_collect_locked (adder);
+
+  for (l = adder->sinkpads; l; l = g_list_next (l)) {
+    GstLiveAdderPadPrivate *padprivate = gst_pad_get_element_private (l->data);
+
+    if (padprivate && g_atomic_int_get (&padprivate->waiting) &&
+        (g_atomic_int_get (&padprivate->eos) ||
+            padprivate->pending_end >= end) &&
+        g_atomic_int_compare_and_exchange (&padprivate->waiting, TRUE, FALSE))
+      g_atomic_int_add (&adder->n_missing, -1);
+  }
+
+  return g_atomic_int_dec_and_test (&adder->n_missing);
+}
+
+static void
+gst_live_adder_disarm_locked (GstLiveAdder * adder)
+{
+  GList *l;
+
+  for (l = adder->sinkpads; l; l = g_list_next (l)) {
+    GstLiveAdderPadPrivate *padprivate = gst_pad_get_element_private (l->data);
+
+    if (padprivate)
+      g_atomic_int_set (&padprivate->waiting, FALSE);
+  }
+}
+
+/* Waits until any pad queued data or went EOS */
+static void
+gst_live_adder_wait_data_locked (GstLiveAdder * adder)
+{
+  g_atomic_int_set (&adder->idle, TRUE);
+
+  if (!GST_CLOCK_TIME_IS_VALID (gst_live_adder_collect_locked (adder)) &&
+      adder->srcresult == GST_FLOW_OK && !check_eos_locked (adder))
+    g_cond_wait (&adder->not_empty_cond, GST_OBJECT_GET_LOCK (adder));
+
+  g_atomic_int_set (&adder->idle, FALSE);
+}
+
+/* Mixes the pending data of all pads between @start and @end into a new
+ * buffer and updates the lateness statistics of the pads. */
+static GstBuffer *
+gst_live_adder_mix_locked (GstLiveAdder * adder, GstClockTime start,
+    GstClockTime end)
+{
+  guint size = adder->period_samples * GST_AUDIO_INFO_BPF (&adder->info);
+  gint64 first_arrival = G_MAXINT64;
+  gboolean gap = TRUE;
+  GstBuffer *outbuf;
+  GstMapInfo outmap;
+  GList *l;
+
+  outbuf = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_map (outbuf, &outmap, GST_MAP_WRITE);
+  gst_audio_format_fill_silence (adder->info.finfo, outmap.data, size);
+
+  for (l = adder->sinkpads; l; l = g_list_next (l)) {
+    GstLiveAdderPadPrivate *padprivate = gst_pad_get_element_private (l->data);
+    GstLiveAdderItem *item;
+
+    if (!padprivate)
+      continue;
+
+    padprivate->period_arrival = -1;
+
+    while ((item = g_queue_peek_head (&padprivate->pending))) {
+      GstBuffer *buffer = item->buffer;
+      GstClockTime ts = GST_BUFFER_TIMESTAMP (buffer);
+      GstClockTime buffer_end = ts + GST_BUFFER_DURATION (buffer);
+
+      if (ts >= end)
+        break;
+
+      if (buffer_end <= start) {
+        /* queued after a later buffer of the same pad */
+        padprivate->dropped++;
+      } else if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_GAP)) {
+        GstClockTime mix_start = MAX (ts, start);
+        GstClockTime mix_end = MIN (buffer_end, end);
+        guint in_offset, out_offset, len;
+        GstMapInfo map;
+
+        in_offset = gst_live_adder_length_from_duration (adder,
+            mix_start - ts);
+        out_offset = gst_live_adder_length_from_duration (adder,
+            mix_start - start);
+        len = gst_live_adder_length_from_duration (adder, mix_end - mix_start);
+
+        gst_buffer_map (buffer, &map, GST_MAP_READ);
+        if (in_offset < map.size && out_offset < size) {
+          len = MIN (len, map.size - in_offset);
+          len = MIN (len, size - out_offset);
+          adder->func (outmap.data + out_offset, map.data + in_offset, len);
+          gap = FALSE;
+        }
+        gst_buffer_unmap (buffer, &map);
+      }
+
+      if (buffer_end >= end) {
+        padprivate->period_arrival = item->arrival;
+        first_arrival = MIN (first_arrival, item->arrival);
+        if (buffer_end > end)
+          break;
+      }
+
+      g_queue_pop_head (&padprivate->pending);
+      gst_live_adder_item_free (item);
+    }
+  }
+
+  gst_buffer_unmap (outbuf, &outmap);
+
+  /* the lateness of a pad is measured against the first pad that had the
+   * complete data of the period */
+  for (l = adder->sinkpads; l; l = g_list_next (l)) {
+    GstLiveAdderPadPrivate *padprivate = gst_pad_get_element_private (l->data);
+    GstClockTime lateness;
+
+    if (!padprivate)
+      continue;
+
+    if (padprivate->period_arrival < 0) {
+      if (!g_atomic_int_get (&padprivate->eos)) {
+        GST_LOG_OBJECT (l->data, "missed period at %" GST_TIME_FORMAT,
+            GST_TIME_ARGS (start));
+        padprivate->missed++;
+      }
+      continue;
+    }
+
+    lateness = (padprivate->period_arrival - first_arrival) * GST_USECOND;
+    padprivate->completed++;
+    padprivate->lateness_sum += lateness;
+    padprivate->lateness_max = MAX (padprivate->lateness_max, lateness);
+    GST_LOG_OBJECT (l->data, "completed period at %" GST_TIME_FORMAT
+        " %" GST_TIME_FORMAT " late", GST_TIME_ARGS (start),
+        GST_TIME_ARGS (lateness));
+  }
+
+  GST_BUFFER_TIMESTAMP (outbuf) = start;
+  GST_BUFFER_DURATION (outbuf) = end - start;
+  GST_BUFFER_OFFSET (outbuf) = GST_BUFFER_OFFSET_NONE;
+  GST_BUFFER_OFFSET_END (outbuf) = GST_BUFFER_OFFSET_NONE;
+  if (gap)
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_GAP);
+  if (adder->discont) {
+    GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+    adder->discont = FALSE;
+  }
+
+  return outbuf;
+}
+
 static void
 gst_live_adder_loop (gpointer data)
 {
   GstLiveAdder *adder = GST_LIVE_ADDER (data);
-  GstClockTime buffer_timestamp = 0;
+  GstClockTime first, start, end;
   GstClockTime sync_time = 0;
   GstClock *clock = NULL;
   GstClockID id = NULL;
   GstClockReturn ret;
   GstBuffer *buffer = NULL;
   GstFlowReturn result;
+  guint n_missing;
 
   GST_OBJECT_LOCK (adder);
 
 again:
 
-  for (;;) {
-    if (adder->srcresult != GST_FLOW_OK)
-      goto flushing;
-    if (!g_queue_is_empty (adder->buffers))
-      break;
+  if (adder->srcresult != GST_FLOW_OK)
+    goto flushing;
+
+  first = gst_live_adder_collect_locked (adder);
+  if (!GST_CLOCK_TIME_IS_VALID (first)) {
     if (check_eos_locked (adder))
       goto eos;
-    g_cond_wait (&adder->not_empty_cond, GST_OBJECT_GET_LOCK (adder));
+    gst_live_adder_wait_data_locked (adder);
+    goto again;
   }
 
-  buffer_timestamp = GST_BUFFER_TIMESTAMP (g_queue_peek_head (adder->buffers));
+  if (!GST_CLOCK_TIME_IS_VALID (adder->next_timestamp))
+    gst_live_adder_restart_locked (adder, first);
+
+  start = adder->next_timestamp;
+  end = adder->base_timestamp +
+      gst_util_uint64_scale_int (adder->n_samples + adder->period_samples,
+      GST_SECOND, GST_AUDIO_INFO_RATE (&adder->info));
+
+  n_missing = gst_live_adder_count_missing_locked (adder, end);
+  if (n_missing == 0)
+    goto mix;
 
   clock = GST_ELEMENT_CLOCK (adder);
 
@@ -1187,13 +1462,16 @@ again:
     if (adder->playing)
       goto no_clock;
     else
-      goto push_buffer;
+      goto mix;
   }
 
-  GST_DEBUG_OBJECT (adder, "sync to timestamp %" GST_TIME_FORMAT,
-      GST_TIME_ARGS (buffer_timestamp));
+  if (gst_live_adder_arm_locked (adder, end))
+    goto mix;
 
-  sync_time = buffer_timestamp + GST_ELEMENT_CAST (adder)->base_time;
+  GST_DEBUG_OBJECT (adder, "waiting for %u pads, sync to timestamp %"
+      GST_TIME_FORMAT, n_missing, GST_TIME_ARGS (start));
+
+  sync_time = start + GST_ELEMENT_CAST (adder)->base_time;
   /* add latency, this includes our own latency and the peer latency. */
   sync_time += adder->latency_ms * GST_MSECOND;
   sync_time += adder->peer_latency;
@@ -1209,65 +1487,36 @@ again:
   /* and free the entry */
   gst_clock_id_unref (id);
   adder->clock_id = NULL;
+  gst_live_adder_disarm_locked (adder);
 
-  /* at this point, the clock could have been unlocked by a timeout, a new
-   * head element was added to the queue or because we are shutting down. Check
-   * for shutdown first. */
+  /* at this point, the clock could have been unlocked by a timeout, because
+   * all pads have data now or because we are shutting down. Check for
+   * shutdown first. */
 
   if (adder->srcresult != GST_FLOW_OK)
     goto flushing;
 
   if (ret == GST_CLOCK_UNSCHEDULED) {
     GST_DEBUG_OBJECT (adder,
-        "Wait got unscheduled, will retry to push with new buffer");
+        "Wait got unscheduled, will retry to mix with the new data");
     goto again;
   }
 
   if (ret != GST_CLOCK_OK && ret != GST_CLOCK_EARLY)
     goto clock_error;
 
-push_buffer:
-
-  buffer = g_queue_pop_head (adder->buffers);
+mix:
 
-  if (!buffer)
+  /* nothing to mix in this period, continue where the data is */
+  first = gst_live_adder_collect_locked (adder);
+  if (first >= end) {
+    gst_live_adder_restart_locked (adder, first);
     goto again;
-
-  /*
-   * We make sure the timestamps are exactly contiguous
-   * If its only small skew (due to rounding errors), we correct it
-   * silently. Otherwise we put the discont flag
-   */
-  if (GST_CLOCK_TIME_IS_VALID (adder->next_timestamp) &&
-      GST_BUFFER_TIMESTAMP (buffer) != adder->next_timestamp) {
-    GstClockTimeDiff diff = GST_CLOCK_DIFF (GST_BUFFER_TIMESTAMP (buffer),
-        adder->next_timestamp);
-    if (diff < 0)
-      diff = -diff;
-
-    if (diff < GST_SECOND / GST_AUDIO_INFO_RATE (&adder->info)) {
-      GST_BUFFER_TIMESTAMP (buffer) = adder->next_timestamp;
-      GST_DEBUG_OBJECT (adder, "Correcting slight skew");
-      GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_DISCONT);
-    } else {
-      GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
-      GST_DEBUG_OBJECT (adder, "Expected buffer at %" GST_TIME_FORMAT
-          ", but is at %" GST_TIME_FORMAT ", setting discont",
-          GST_TIME_ARGS (adder->next_timestamp),
-          GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)));
-    }
-  } else {
-    GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_DISCONT);
   }
 
-  GST_BUFFER_OFFSET (buffer) = GST_BUFFER_OFFSET_NONE;
-  GST_BUFFER_OFFSET_END (buffer) = GST_BUFFER_OFFSET_NONE;
-
-  if (GST_BUFFER_DURATION_IS_VALID (buffer))
-    adder->next_timestamp = GST_BUFFER_TIMESTAMP (buffer) +
-        GST_BUFFER_DURATION (buffer);
-  else
-    adder->next_timestamp = GST_CLOCK_TIME_NONE;
+  buffer = gst_live_adder_mix_locked (adder, start, end);
+  adder->n_samples += adder->period_samples;
+  adder->next_timestamp = end;
   GST_OBJECT_UNLOCK (adder);
 
   GST_LOG_OBJECT (adder, "About to push buffer time:%" GST_TIME_FORMAT
@@ -1370,6 +1619,8 @@ gst_live_adder_request_new_pad (GstElement * element, GstPadTemplate * templ,
   gst_segment_init (&padprivate->segment, GST_FORMAT_UNDEFINED);
   padprivate->eos = FALSE;
   padprivate->expected_timestamp = GST_CLOCK_TIME_NONE;
+  padprivate->queue = gst_atomic_queue_new (QUEUE_INITIAL_SIZE);
+  g_queue_init (&padprivate->pending);
 
   gst_pad_set_element_private (newpad, padprivate);
 
@@ -1398,14 +1649,14 @@ not_sink:
 could_not_add:
   {
     GST_DEBUG_OBJECT (adder, "could not add pad");
-    g_free (padprivate);
+    pad_private_free (padprivate);
     gst_object_unref (newpad);
     return NULL;
   }
 could_not_activate:
   {
     GST_DEBUG_OBJECT (adder, "could not activate new pad");
-    g_free (padprivate);
+    pad_private_free (padprivate);
     gst_object_unref (newpad);
     return NULL;
   }
@@ -1425,11 +1676,54 @@ gst_live_adder_release_pad (GstElement * element, GstPad * pad)
   padprivate = gst_pad_get_element_private (pad);
   gst_pad_set_element_private (pad, NULL);
   adder->sinkpads = g_list_remove_all (adder->sinkpads, pad);
+  /* the task might be waiting for this pad */
+  if (adder->clock_id)
+    gst_clock_id_unschedule (adder->clock_id);
+  g_cond_broadcast (&adder->not_empty_cond);
   GST_OBJECT_UNLOCK (element);
 
+  /* waits for the chain function, it uses the private data without lock */
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
+
+  if (padprivate)
+    pad_private_free (padprivate);
+}
+
+static void
+pad_private_free (GstLiveAdderPadPrivate * padprivate)
+{
+  GstLiveAdderItem *item;
+
+  while ((item = gst_atomic_queue_pop (padprivate->queue)))
+    gst_live_adder_item_free (item);
+  gst_atomic_queue_unref (padprivate->queue);
+  g_queue_foreach (&padprivate->pending, (GFunc) gst_live_adder_item_free,
+      NULL);
+  g_queue_clear (&padprivate->pending);
+
   g_free (padprivate);
+}
 
-  gst_element_remove_pad (element, pad);
+/* Drops the queued data of the pad, called with the object lock */
+static void
+flush_pad_private (GstPad * pad)
+{
+  GstLiveAdderPadPrivate *padprivate;
+  GstLiveAdderItem *item;
+
+  padprivate = gst_pad_get_element_private (pad);
+
+  if (!padprivate)
+    return;
+
+  while ((item = gst_atomic_queue_pop (padprivate->queue)))
+    gst_live_adder_item_free (item);
+  g_queue_foreach (&padprivate->pending, (GFunc) gst_live_adder_item_free,
+      NULL);
+  g_queue_clear (&padprivate->pending);
+  padprivate->pending_end = 0;
+  g_atomic_int_set (&padprivate->waiting, FALSE);
 }
 
 static void
@@ -1445,7 +1739,41 @@ reset_pad_private (GstPad * pad)
   gst_segment_init (&padprivate->segment, GST_FORMAT_UNDEFINED);
 
   padprivate->expected_timestamp = GST_CLOCK_TIME_NONE;
-  padprivate->eos = FALSE;
+  padprivate->queued_end = 0;
+  g_atomic_int_set (&padprivate->eos, FALSE);
+  flush_pad_private (pad);
+}
+
+static GstStructure *
+gst_live_adder_get_stats (GstLiveAdder * adder)
+{
+  GstStructure *s;
+  GList *l;
+
+  s = gst_structure_new_empty ("application/x-liveadder-stats");
+
+  GST_OBJECT_LOCK (adder);
+  for (l = adder->sinkpads; l; l = g_list_next (l)) {
+    GstLiveAdderPadPrivate *padprivate = gst_pad_get_element_private (l->data);
+    GstStructure *pad_stats;
+
+    if (!padprivate)
+      continue;
+
+    pad_stats = gst_structure_new ("pad-stats",
+        "completed", G_TYPE_UINT64, padprivate->completed,
+        "missed", G_TYPE_UINT64, padprivate->missed,
+        "dropped", G_TYPE_UINT64, padprivate->dropped,
+        "average-lateness", G_TYPE_UINT64, padprivate->completed ?
+        padprivate->lateness_sum / padprivate->completed : (guint64) 0,
+        "max-lateness", G_TYPE_UINT64, padprivate->lateness_max, NULL);
+    gst_structure_set (s, GST_PAD_NAME (l->data), GST_TYPE_STRUCTURE,
+        pad_stats, NULL);
+    gst_structure_free (pad_stats);
+  }
+  GST_OBJECT_UNLOCK (adder);
+
+  return s;
 }
 
 static GstStateChangeReturn
@@ -1462,6 +1790,8 @@ gst_live_adder_change_state (GstElement * element, GstStateChange transition)
       adder->segment_pending = TRUE;
       adder->peer_latency = 0;
       adder->next_timestamp = GST_CLOCK_TIME_NONE;
+      adder->period_samples = 0;
+      adder->discont = FALSE;
       g_list_foreach (adder->sinkpads, (GFunc) reset_pad_private, NULL);
       GST_OBJECT_UNLOCK (adder);
       break;
@@ -57,14 +57,25 @@ struct _GstLiveAdder
   gint padcount;
   GList *sinkpads;
 
+  /* also read without the lock by the chain functions */
   GstFlowReturn srcresult;
   GstClockID clock_id;
 
-  /* the queue is ordered head to tail */
-  GQueue *buffers;
   GCond not_empty_cond;
+  /* TRUE while the task waits on not_empty_cond for data on any pad */
+  volatile gint idle;
+  /* pads the task waits for to complete the next period, plus one while
+   * the task is still marking them */
+  volatile gint n_missing;
 
+  /* start of the next output period */
   GstClockTime next_timestamp;
+  /* output periods are counted in samples from base_timestamp so that the
+   * timestamps stay exactly contiguous */
+  GstClockTime base_timestamp;
+  guint64 n_samples;
+  guint period_samples;
+  gboolean discont;
 
   /* the next are valid for both int and float */
   GstAudioInfo info;
@@ -63,6 +63,10 @@
 
 #define DURATION_SCAN_LIMIT         4 * 1024 * 1024
 
+/* Minimum SCR distance between two index entries added while parsing
+ * linearly, 100ms. Keyframes are always added. */
+#define INDEX_INTERVAL              (CLOCK_FREQ / 10)
+
 typedef enum
 {
   SCAN_SCR,
@@ -274,6 +278,7 @@ gst_ps_demux_init (GstPsDemux * demux)
   demux->adapter = gst_adapter_new ();
   demux->rev_adapter = gst_adapter_new ();
   demux->flowcombiner = gst_flow_combiner_new ();
+  demux->index = g_array_new (FALSE, FALSE, sizeof (GstPsDemuxIndexEntry));
 
   gst_ps_demux_reset (demux);
 }
@@ -286,6 +291,7 @@ gst_ps_demux_finalize (GstPsDemux * demux)
   g_free (demux->streams_found);
 
   gst_flow_combiner_free (demux->flowcombiner);
+  g_array_free (demux->index, TRUE);
   g_object_unref (demux->adapter);
   g_object_unref (demux->rev_adapter);
 
@@ -337,6 +343,7 @@ gst_ps_demux_reset (GstPsDemux * demux)
   demux->need_no_more_pads = TRUE;
   demux->adjust_segment = TRUE;
   gst_ps_demux_reset_psm (demux);
+  g_array_set_size (demux->index, 0);
   gst_segment_init (&demux->sink_segment, GST_FORMAT_UNDEFINED);
   gst_segment_init (&demux->src_segment, GST_FORMAT_TIME);
   gst_ps_demux_flush (demux);
@@ -900,6 +907,9 @@ gst_ps_demux_flush (GstPsDemux * demux)
   demux->adapter_offset = G_MAXUINT64;
   demux->current_scr = G_MAXUINT64;
   demux->bytes_since_scr = 0;
+  demux->index_linear_start = G_MAXUINT64;
+  demux->index_last_scr = G_MAXUINT64;
+  demux->index_pack_offset = G_MAXUINT64;
 }
 
 static inline void
@@ -1115,6 +1125,208 @@ not_supported:
   }
 }
 
+#define INDEX_ENTRY(demux,idx) \
+  (&g_array_index ((demux)->index, GstPsDemuxIndexEntry, (idx)))
+
+/* Find the index entry at @offset. Returns TRUE if there is one, @idx is set
+ * to its position or to the position where it would be inserted */
+static gboolean
+gst_ps_demux_index_find (GstPsDemux * demux, guint64 offset, guint * idx)
+{
+  guint lo = 0, hi = demux->index->len;
+
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (INDEX_ENTRY (demux, mid)->offset < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  *idx = lo;
+
+  return lo < demux->index->len && INDEX_ENTRY (demux, lo)->offset == offset;
+}
+
+/* Find the last index entry with an SCR not after @scr */
+static gboolean
+gst_ps_demux_index_lookup (GstPsDemux * demux, guint64 scr, guint * idx)
+{
+  guint lo = 0, hi = demux->index->len;
+
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (INDEX_ENTRY (demux, mid)->scr <= scr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo == 0)
+    return FALSE;
+
+  *idx = lo - 1;
+
+  return TRUE;
+}
+
+/* Add the pack at @offset with @scr to the index. @linear is TRUE if the
+ * pack is parsed as part of the current linear run, in which case the entry
+ * is contiguous with the previous one if that was parsed in the same run. */
+static void
+gst_ps_demux_index_add (GstPsDemux * demux, guint64 scr, guint64 offset,
+    guint flags, gboolean linear)
+{
+  GstPsDemuxIndexEntry entry;
+  guint idx, start, end;
+
+  if (gst_ps_demux_index_find (demux, offset, &idx)) {
+    if (INDEX_ENTRY (demux, idx)->scr == scr) {
+      flags |= INDEX_ENTRY (demux, idx)->flags;
+      g_array_remove_index (demux->index, idx);
+    } else {
+      g_array_remove_index (demux->index, idx);
+      if (idx < demux->index->len)
+        INDEX_ENTRY (demux, idx)->flags &= ~GST_PS_DEMUX_INDEX_CONTIGUOUS;
+    }
+  }
+
+  /* Keep the index sorted by SCR too: the last seen pack wins over entries
+   * disagreeing with it, e.g. around SCR discontinuities */
+  start = idx;
+  while (start > 0 && INDEX_ENTRY (demux, start - 1)->scr > scr)
+    start--;
+  end = idx;
+  while (end < demux->index->len && INDEX_ENTRY (demux, end)->scr < scr)
+    end++;
+  if (start < end) {
+    GST_DEBUG_OBJECT (demux, "SCR %" G_GUINT64_FORMAT " at %" G_GUINT64_FORMAT
+        " not monotonic, dropping %u index entries", scr, offset, end - start);
+    g_array_remove_range (demux->index, start, end - start);
+    idx = start;
+    if (idx < demux->index->len)
+      INDEX_ENTRY (demux, idx)->flags &= ~GST_PS_DEMUX_INDEX_CONTIGUOUS;
+  }
+
+  if (linear && idx > 0 &&
+      INDEX_ENTRY (demux, idx - 1)->offset >= demux->index_linear_start)
+    flags |= GST_PS_DEMUX_INDEX_CONTIGUOUS;
+
+  entry.scr = scr;
+  entry.offset = offset;
+  entry.flags = flags;
+  g_array_insert_val (demux->index, idx, entry);
+}
+
+/* Called for each pack parsed while playing forward in pull mode */
+static void
+gst_ps_demux_index_pack (GstPsDemux * demux, guint64 scr)
+{
+  guint64 offset, distance;
+  guint idx;
+
+  offset = gst_adapter_prev_offset (demux->adapter, &distance);
+  if (offset == GST_BUFFER_OFFSET_NONE) {
+    demux->index_linear_start = G_MAXUINT64;
+    demux->index_pack_offset = G_MAXUINT64;
+    return;
+  }
+  offset += distance;
+
+  demux->index_pack_scr = scr;
+  demux->index_pack_offset = offset;
+
+  if (demux->index_linear_start == G_MAXUINT64) {
+    demux->index_linear_start = offset;
+    demux->index_last_scr = G_MAXUINT64;
+  }
+
+  /* refresh known packs, otherwise add one every INDEX_INTERVAL */
+  if (!gst_ps_demux_index_find (demux, offset, &idx)
+      && demux->index_last_scr != G_MAXUINT64
+      && scr >= demux->index_last_scr
+      && scr - demux->index_last_scr < INDEX_INTERVAL)
+    return;
+
+  gst_ps_demux_index_add (demux, scr, offset, 0, TRUE);
+  demux->index_last_scr = scr;
+}
+
+/* Check if a video PES payload starts a keyframe or GOP */
+static gboolean
+gst_ps_demux_is_keyframe (gint stream_type, const guint8 * data, gsize size)
+{
+  gsize i;
+
+  for (i = 0; i + 4 < size; i++) {
+    guint8 code;
+
+    if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1)
+      continue;
+
+    code = data[i + 3];
+
+    switch (stream_type) {
+      case ST_VIDEO_MPEG1:
+      case ST_VIDEO_MPEG2:
+      case ST_GST_VIDEO_MPEG1_OR_2:
+        /* sequence header or GOP */
+        if (code == 0xb3 || code == 0xb8)
+          return TRUE;
+        break;
+      case ST_VIDEO_MPEG4:
+        /* visual object sequence, GOV or I-VOP */
+        if (code == 0xb0 || code == 0xb3 || (code == 0xb6
+                && (data[i + 4] >> 6) == 0))
+          return TRUE;
+        break;
+      case ST_VIDEO_H264:
+        /* IDR slice or SPS */
+        if ((code & 0x1f) == 5 || (code & 0x1f) == 7)
+          return TRUE;
+        break;
+      default:
+        return FALSE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Move @offset back to the closest keyframe, if the index knows it */
+static void
+gst_ps_demux_index_find_keyframe (GstPsDemux * demux, guint64 * offset,
+    guint64 * scr)
+{
+  GstPsDemuxIndexEntry *entry;
+  guint idx;
+
+  if (!gst_ps_demux_index_find (demux, *offset, &idx)) {
+    /* there could be a keyframe between the previous entry and @offset if
+     * that part of the file was not parsed */
+    if (idx == 0 || idx == demux->index->len ||
+        !(INDEX_ENTRY (demux, idx)->flags & GST_PS_DEMUX_INDEX_CONTIGUOUS))
+      return;
+    idx--;
+  }
+
+  for (;;) {
+    entry = INDEX_ENTRY (demux, idx);
+    if (entry->flags & GST_PS_DEMUX_INDEX_KEYFRAME)
+      break;
+    if (idx == 0 || !(entry->flags & GST_PS_DEMUX_INDEX_CONTIGUOUS))
+      return;
+    idx--;
+  }
+
+  GST_DEBUG_OBJECT (demux, "keyframe at offset %" G_GUINT64_FORMAT
+      " SCR %" G_GUINT64_FORMAT, entry->offset, entry->scr);
+  *offset = entry->offset;
+  *scr = entry->scr;
+}
+
 #define MAX_RECURSION_COUNT 100
 
 /* Binary search for requested SCR */
@@ -1154,10 +1366,14 @@ find_offset (GstPsDemux * demux, guint64 scr,
 }
 
 static inline gboolean
-gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment)
+gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment,
+    gboolean keyframe)
 {
   gboolean found;
   guint64 fscr, offset;
+  guint64 min_scr, min_scr_offset, max_scr, max_scr_offset;
+  GstPsDemuxIndexEntry *entry;
+  guint idx;
   guint64 scr = GSTTIME_TO_MPEGTIME (seeksegment->position + demux->base_time);
 
   /* In some clips the PTS values are completely unaligned with SCR values.
@@ -1173,9 +1389,47 @@ gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment)
   GST_INFO_OBJECT (demux, "sink segment configured %" GST_SEGMENT_FORMAT
       ", trying to go at SCR: %" G_GUINT64_FORMAT, &demux->sink_segment, scr);
 
-  offset =
-      find_offset (demux, scr, demux->first_scr, demux->first_scr_offset,
-      demux->last_scr, demux->last_scr_offset, 0);
+  min_scr = demux->first_scr;
+  min_scr_offset = demux->first_scr_offset;
+  max_scr = demux->last_scr;
+  max_scr_offset = demux->last_scr_offset;
+
+  /* Narrow the search down with the index, if the packs up to the next entry
+   * were all parsed the entry is where we need to go */
+  if (gst_ps_demux_index_lookup (demux, scr, &idx)) {
+    entry = INDEX_ENTRY (demux, idx);
+    if (entry->scr == scr || (idx + 1 < demux->index->len &&
+            (INDEX_ENTRY (demux, idx + 1)->flags &
+                GST_PS_DEMUX_INDEX_CONTIGUOUS))) {
+      GST_DEBUG_OBJECT (demux, "found SCR %" G_GUINT64_FORMAT " in index",
+          entry->scr);
+      offset = entry->offset;
+      fscr = entry->scr;
+      goto done;
+    }
+    if (entry->scr > min_scr) {
+      min_scr = entry->scr;
+      min_scr_offset = entry->offset;
+    }
+    idx++;
+  } else {
+    idx = 0;
+  }
+
+  if (idx < demux->index->len) {
+    entry = INDEX_ENTRY (demux, idx);
+    if (entry->scr < max_scr) {
+      max_scr = entry->scr;
+      max_scr_offset = entry->offset;
+    }
+  }
+
+  GST_DEBUG_OBJECT (demux, "searching between SCR %" G_GUINT64_FORMAT " at %"
+      G_GUINT64_FORMAT " and %" G_GUINT64_FORMAT " at %" G_GUINT64_FORMAT,
+      min_scr, min_scr_offset, max_scr, max_scr_offset);
+
+  offset = find_offset (demux, scr, min_scr, min_scr_offset, max_scr,
+      max_scr_offset, 0);
 
   if (offset == (guint64) - 1) {
     return FALSE;
@@ -1195,6 +1449,10 @@ gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment)
     found = gst_ps_demux_scan_backward_ts (demux, &offset, SCAN_SCR, &fscr, 0);
   }
 
+done:
+  if (keyframe)
+    gst_ps_demux_index_find_keyframe (demux, &offset, &fscr);
+
   GST_INFO_OBJECT (demux, "doing seek at offset %" G_GUINT64_FORMAT
       " SCR: %" G_GUINT64_FORMAT " %" GST_TIME_FORMAT,
       offset, fscr, GST_TIME_ARGS (MPEGTIME_TO_GSTTIME (fscr)));
@@ -1212,7 +1470,7 @@ gst_ps_demux_handle_seek_pull (GstPsDemux * demux, GstEvent * event)
   GstSeekType start_type, stop_type;
   gint64 start, stop;
   gdouble rate;
-  gboolean update, flush;
+  gboolean update, flush, keyframe;
   GstSegment seeksegment;
   GstClockTime first_pts = MPEGTIME_TO_GSTTIME (demux->first_pts);
 
@@ -1230,7 +1488,7 @@ gst_ps_demux_handle_seek_pull (GstPsDemux * demux, GstEvent * event)
     goto no_scr_rate;
 
   flush = flags & GST_SEEK_FLAG_FLUSH;
-  /* keyframe = flags & GST_SEEK_FLAG_KEY_UNIT; *//* FIXME */
+  keyframe = flags & GST_SEEK_FLAG_KEY_UNIT;
 
   if (flush) {
     /* Flush start up and downstream to make sure data flow and loops are
@@ -1268,7 +1526,7 @@ gst_ps_demux_handle_seek_pull (GstPsDemux * demux, GstEvent * event)
 
   if (flush || seeksegment.position != demux->src_segment.position) {
     /* Do the actual seeking */
-    if (!gst_ps_demux_do_seek (demux, &seeksegment)) {
+    if (!gst_ps_demux_do_seek (demux, &seeksegment, keyframe)) {
       return FALSE;
     }
   }
@@ -1719,6 +1977,9 @@ gst_ps_demux_parse_pack_start (GstPsDemux * demux)
   /* scr adjusted is the new scr found + the colected adjustment */
   scr_adjusted = scr + demux->scr_adjust;
 
+  if (demux->random_access && demux->sink_segment.rate >= 0.0)
+    gst_ps_demux_index_pack (demux, scr);
+
   GST_LOG_OBJECT (demux,
       "SCR: %" G_GINT64_FORMAT " (%" G_GINT64_FORMAT "), mux_rate %"
       G_GINT64_FORMAT ", GStreamer Time:%" GST_TIME_FORMAT,
@@ -2271,6 +2532,14 @@ gst_ps_demux_data_cb (GstPESFilter * filter, gboolean first,
     goto done;
   }
 
+  if (first && demux->index_pack_offset != G_MAXUINT64 &&
+      gst_ps_demux_is_keyframe (demux->current_stream->type,
+          map.data + offset, datalen)) {
+    gst_ps_demux_index_add (demux, demux->index_pack_scr,
+        demux->index_pack_offset, GST_PS_DEMUX_INDEX_KEYFRAME, TRUE);
+    demux->index_last_scr = demux->index_pack_scr;
+  }
+
   /* After 2 seconds of bitstream emit no more pads */
   if (demux->need_no_more_pads
       && (demux->current_scr - demux->first_scr) > 2 * CLOCK_FREQ) {
@@ -2634,6 +2903,8 @@ gst_ps_demux_scan_forward_ts (GstPsDemux * demux, guint64 * pos,
     if (found) {
       *rts = ts;
       *pos = offset + cursor - 1;
+      if (mode == SCAN_SCR)
+        gst_ps_demux_index_add (demux, ts, *pos, 0, FALSE);
     } else {
       offset += cursor;
     }
@@ -2700,6 +2971,8 @@ gst_ps_demux_scan_backward_ts (GstPsDemux * demux, guint64 * pos,
     if (found) {
       *rts = ts;
       *pos = offset + cursor;
+      if (mode == SCAN_SCR)
+        gst_ps_demux_index_add (demux, ts, *pos, 0, FALSE);
     }
 
   } while (!found && offset > 0);
@@ -3095,6 +3368,8 @@ gst_ps_demux_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
       demux->current_scr = G_MAXUINT64;
       demux->bytes_since_scr = 0;
     }
+    demux->index_linear_start = G_MAXUINT64;
+    demux->index_pack_offset = G_MAXUINT64;
   } else {
     GST_LOG_OBJECT (demux, "Received buffer with offset %" G_GUINT64_FORMAT,
         GST_BUFFER_OFFSET (buffer));
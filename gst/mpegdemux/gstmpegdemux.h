@@ -84,6 +84,19 @@ typedef enum
   STATE_PS_DEMUX_NEED_MORE_DATA,
 } GstPsDemuxState;
 
+/* Set on an index entry when the data between the previous entry and this
+ * one was parsed linearly, so no keyframe was missed in between */
+#define GST_PS_DEMUX_INDEX_CONTIGUOUS	(1 << 0)
+/* Set on an index entry when the pack starts a video keyframe/GOP */
+#define GST_PS_DEMUX_INDEX_KEYFRAME	(1 << 1)
+
+typedef struct
+{
+  guint64 scr;                  /* SCR of the pack, not adjusted */
+  guint64 offset;               /* offset of the pack start code */
+  guint flags;
+} GstPsDemuxIndexEntry;
+
 /* Information associated with a single FluPS stream. */
 struct _GstPsStream
 {
@@ -154,6 +167,16 @@ struct _GstPsDemux
 
   GstFlowCombiner *flowcombiner;
 
+  /* SCR index, GstPsDemuxIndexEntry sorted by offset (and SCR) */
+  GArray *index;
+  /* offset of the first pack of the current linear run */
+  guint64 index_linear_start;
+  /* SCR of the last entry added while parsing linearly */
+  guint64 index_last_scr;
+  /* the pack currently being parsed */
+  guint64 index_pack_scr;
+  guint64 index_pack_offset;
+
   /* Indicates an MPEG-2 stream */
   gboolean is_mpeg2_pack;
 };
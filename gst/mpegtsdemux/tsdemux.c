@@ -66,6 +66,13 @@
 
 #define GST_FLOW_REWINDING GST_FLOW_CUSTOM_ERROR
 
+/* Number of packets the index scan reads after each chunk of 100 packets
+ * the streaming thread pulls, so the scan reads the file 10 times as fast
+ * as it is played */
+#define INDEX_SCAN_CHUNK 1000
+
+#define PTS_MASK G_GUINT64_CONSTANT (0x1ffffffff)
+
 /* latency in nsecs */
 #define TS_LATENCY (700 * GST_MSECOND)
 
@@ -177,6 +184,11 @@ struct _TSDemuxStream
   /* Whether the next output buffer should be DISCONT */
   gboolean discont;
 
+  /* Offset of the packet starting the current PES and whether it had the
+   * random access indicator set */
+  guint64 pes_offset;
+  gboolean pes_rai;
+
   /* The value to use when calculating the newsegment */
   GstClockTime first_pts;
 
@@ -265,6 +277,8 @@ enum
   PROP_0,
   PROP_PROGRAM_NUMBER,
   PROP_EMIT_STATS,
+  PROP_INDEX_FILE,
+  PROP_INDEX_SCAN,
   /* FILL ME */
 };
 
@@ -298,6 +312,9 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream);
 static void gst_ts_demux_stream_flush (TSDemuxStream * stream,
     GstTSDemux * demux, gboolean hard);
 
+static GstFlowReturn gst_ts_demux_input_done (MpegTSBase * base,
+    GstBuffer * buffer);
+
 static gboolean push_event (MpegTSBase * base, GstEvent * event);
 static void gst_ts_demux_check_and_sync_streams (GstTSDemux * demux,
     GstClockTime time);
@@ -325,6 +342,13 @@ gst_ts_demux_dispose (GObject * object)
 
   gst_flow_combiner_free (demux->flowcombiner);
 
+  if (demux->index) {
+    mpegts_index_free (demux->index);
+    demux->index = NULL;
+  }
+  g_free (demux->index_file);
+  demux->index_file = NULL;
+
   GST_CALL_PARENT (G_OBJECT_CLASS, dispose, (object));
 }
 
@@ -350,6 +374,17 @@ gst_ts_demux_class_init (GstTSDemuxClass * klass)
           "Emit messages for every pcr/opcr/pts/dts", FALSE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_INDEX_FILE,
+      g_param_spec_string ("index-file", "Index file",
+          "File to load the keyframe index from and save it to when "
+          "stopping (NULL to not persist the index)", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_INDEX_SCAN,
+      g_param_spec_boolean ("index-scan", "Index scan",
+          "Index the whole file while playing in pull mode", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   element_class = GST_ELEMENT_CLASS (klass);
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&video_template));
@@ -378,6 +413,31 @@ gst_ts_demux_class_init (GstTSDemuxClass * klass)
   ts_class->seek = GST_DEBUG_FUNCPTR (gst_ts_demux_do_seek);
   ts_class->flush = GST_DEBUG_FUNCPTR (gst_ts_demux_flush);
   ts_class->drain = GST_DEBUG_FUNCPTR (gst_ts_demux_drain);
+  ts_class->input_done = GST_DEBUG_FUNCPTR (gst_ts_demux_input_done);
+}
+
+static void
+gst_ts_demux_index_save (GstTSDemux * demux)
+{
+  gchar *filename;
+  GError *err = NULL;
+
+  GST_OBJECT_LOCK (demux);
+  filename = g_strdup (demux->index_file);
+  GST_OBJECT_UNLOCK (demux);
+
+  if (filename && demux->index->dirty && demux->index->upstream_size > 0
+      && demux->index->entries->len > 0) {
+    if (!mpegts_index_save (demux->index, filename, &err)) {
+      GST_WARNING_OBJECT (demux, "Failed to save index to %s: %s", filename,
+          err->message);
+      g_clear_error (&err);
+    } else {
+      GST_DEBUG_OBJECT (demux, "Saved %u index entries to %s",
+          demux->index->entries->len, filename);
+    }
+  }
+  g_free (filename);
 }
 
 static void
@@ -385,6 +445,14 @@ gst_ts_demux_reset (MpegTSBase * base)
 {
   GstTSDemux *demux = (GstTSDemux *) base;
 
+  demux->index_scanning = FALSE;
+  demux->index_scan_started = FALSE;
+  gst_ts_demux_index_save (demux);
+  mpegts_index_clear (demux->index);
+  demux->index_stream = NULL;
+  demux->index_last = GST_CLOCK_TIME_NONE;
+  demux->index_ref_ts = GST_CLOCK_TIME_NONE;
+
   demux->rate = 1.0;
   gst_segment_init (&demux->segment, GST_FORMAT_UNDEFINED);
   if (demux->segment_event) {
@@ -416,6 +484,7 @@ gst_ts_demux_init (GstTSDemux * demux)
   demux->flowcombiner = gst_flow_combiner_new ();
   demux->requested_program_number = -1;
   demux->program_number = -1;
+  demux->index = mpegts_index_new ();
   gst_ts_demux_reset (base);
 }
 
@@ -435,6 +504,17 @@ gst_ts_demux_set_property (GObject * object, guint prop_id,
     case PROP_EMIT_STATS:
       demux->emit_statistics = g_value_get_boolean (value);
       break;
+    case PROP_INDEX_FILE:
+      GST_OBJECT_LOCK (demux);
+      g_free (demux->index_file);
+      demux->index_file = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_INDEX_SCAN:
+      GST_OBJECT_LOCK (demux);
+      demux->index_scan = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -453,6 +533,16 @@ gst_ts_demux_get_property (GObject * object, guint prop_id,
     case PROP_EMIT_STATS:
       g_value_set_boolean (value, demux->emit_statistics);
       break;
+    case PROP_INDEX_FILE:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_string (value, demux->index_file);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case PROP_INDEX_SCAN:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_boolean (value, demux->index_scan);
+      GST_OBJECT_UNLOCK (demux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -798,6 +888,7 @@ gst_ts_demux_do_seek (MpegTSBase * base, GstEvent * event)
   GstSeekType start_type, stop_type;
   gint64 start, stop;
   guint64 start_offset;
+  MpegTSIndexEntry entry;
 
   gst_event_parse_seek (event, &rate, &format, &flags, &start_type, &start,
       &stop_type, &stop);
@@ -819,7 +910,13 @@ gst_ts_demux_do_seek (MpegTSBase * base, GstEvent * event)
   /* configure the segment with the seek variables */
   GST_DEBUG_OBJECT (demux, "configuring seek");
 
-  if (start_type != GST_SEEK_TYPE_NONE) {
+  if (start_type != GST_SEEK_TYPE_NONE && start >= 0
+      && mpegts_index_lookup (demux->index, start, &entry)) {
+    /* The index knows the last keyframe before the target, start there */
+    GST_DEBUG_OBJECT (demux, "Index entry %" GST_TIME_FORMAT " at offset %"
+        G_GUINT64_FORMAT, GST_TIME_ARGS (entry.ts), entry.offset);
+    start_offset = entry.offset;
+  } else if (start_type != GST_SEEK_TYPE_NONE) {
     start_offset =
         mpegts_packetizer_ts_to_offset (base->packetizer, MAX (0,
             start - SEEK_TIMESTAMP_OFFSET), demux->program->pcr_pid);
@@ -846,6 +943,7 @@ gst_ts_demux_do_seek (MpegTSBase * base, GstEvent * event)
 
   /* record offset and rate */
   base->seek_offset = start_offset;
+  demux->index_last = GST_CLOCK_TIME_NONE;
   demux->last_seek_offset = base->seek_offset;
   demux->rate = rate;
   res = GST_FLOW_OK;
@@ -1568,6 +1666,250 @@ gst_ts_demux_flush_streams (GstTSDemux * demux, gboolean hard)
     gst_ts_demux_stream_flush (walk->data, demux, hard);
 }
 
+/* Indexes the keyframes of the index stream in the next INDEX_SCAN_CHUNK
+ * packets of the file, converting PTS with the mapping seen when playing.
+ * Runs from the streaming thread between the chunks it pulls, so the scan
+ * never pulls concurrently with it. PCR discontinuities are not handled,
+ * the resulting entries are out of order and not indexed. */
+static void
+gst_ts_demux_index_scan_chunk (GstTSDemux * demux)
+{
+  MpegTSBase *base = (MpegTSBase *) demux;
+  MpegTSIndex *index = demux->index;
+  guint packetsize = base->packetsize;
+  guint sync = packetsize == MPEGTS_M2TS_PACKETSIZE ? 4 : 0;
+  guint16 pid = demux->index_stream->pid;
+  guint8 stream_type = demux->index_stream->stream_type;
+  GstBuffer *buf = NULL;
+  GstFlowReturn ret;
+  GstMapInfo map;
+  gboolean at_end;
+  gsize pos = 0;
+
+  ret = gst_pad_pull_range (base->sinkpad, demux->index_scan_offset,
+      INDEX_SCAN_CHUNK * packetsize, &buf);
+  if (ret == GST_FLOW_FLUSHING) {
+    /* seeking or shutting down, the streaming thread stops too and the scan
+     * continues from the same offset with the next chunk */
+    return;
+  } else if (ret == GST_FLOW_EOS) {
+    mpegts_index_set_complete (index);
+    demux->index_scanning = FALSE;
+    GST_DEBUG_OBJECT (demux, "Index scan done");
+    return;
+  } else if (ret != GST_FLOW_OK) {
+    GST_WARNING_OBJECT (demux, "Index scan stopped: %s",
+        gst_flow_get_name (ret));
+    demux->index_scanning = FALSE;
+    return;
+  }
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  at_end = map.size < INDEX_SCAN_CHUNK * packetsize;
+
+  while (pos + packetsize <= map.size) {
+    const guint8 *data = map.data + pos + sync;
+    PESHeader header;
+
+    if (!demux->index_scan_synced) {
+      if (pos + 3 * packetsize > map.size)
+        break;
+      if (data[0] != 0x47 || data[packetsize] != 0x47
+          || data[2 * packetsize] != 0x47) {
+        pos++;
+        continue;
+      }
+      demux->index_scan_synced = TRUE;
+    } else if (data[0] != 0x47) {
+      GST_DEBUG_OBJECT (demux, "Index scan lost sync at %" G_GUINT64_FORMAT,
+          demux->index_scan_offset + pos);
+      demux->index_scan_synced = FALSE;
+      demux->index_scan_last = GST_CLOCK_TIME_NONE;
+      continue;
+    }
+
+    /* start of a PES of the index stream with payload */
+    if ((((data[1] & 0x1f) << 8) | data[2]) == pid && (data[1] & 0x40)
+        && (data[3] & 0x10)) {
+      const guint8 *payload = data + 4;
+      guint size = 184;
+      gboolean rai = FALSE;
+
+      if (data[3] & 0x20) {
+        if (data[4] > 182)
+          goto next;
+        rai = data[4] > 0 && (data[5] & MPEGTS_AFC_RANDOM_ACCES_FLAGS);
+        payload += 1 + data[4];
+        size -= 1 + data[4];
+      }
+
+      if (mpegts_parse_pes_header (payload, size, &header) == PES_PARSING_OK
+          && header.PTS != -1 && (demux->index_is_audio || rai
+              || mpegts_index_is_keyframe (stream_type,
+                  payload + header.header_size,
+                  size - header.header_size))) {
+        gint64 diff = (header.PTS - demux->index_ref_raw) & PTS_MASK;
+        GstClockTime ref_ts = demux->index_ref_ts;
+
+        if (diff > (PTS_MASK >> 1))
+          diff -= (gint64) (PTS_MASK + 1);
+
+        if (diff >= 0)
+          mpegts_index_add (index, &demux->index_scan_last,
+              ref_ts + MPEGTIME_TO_GSTTIME (diff),
+              demux->index_scan_offset + pos);
+        else if (MPEGTIME_TO_GSTTIME (-diff) <= ref_ts)
+          mpegts_index_add (index, &demux->index_scan_last,
+              ref_ts - MPEGTIME_TO_GSTTIME (-diff),
+              demux->index_scan_offset + pos);
+      }
+    }
+
+  next:
+    pos += packetsize;
+  }
+
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  if (at_end) {
+    mpegts_index_set_complete (index);
+    demux->index_scanning = FALSE;
+    GST_DEBUG_OBJECT (demux, "Index scan done");
+  }
+  demux->index_scan_offset += pos;
+}
+
+static GstFlowReturn
+gst_ts_demux_input_done (MpegTSBase * base, GstBuffer * buffer)
+{
+  GstTSDemux *demux = GST_TS_DEMUX_CAST (base);
+
+  gst_buffer_unref (buffer);
+
+  if (demux->index_scanning && base->mode != BASE_MODE_PUSHING)
+    gst_ts_demux_index_scan_chunk (demux);
+
+  return GST_FLOW_OK;
+}
+
+/* Indexes the current PES of the index stream if it starts with a
+ * keyframe, and starts the index scan once the PTS mapping is known */
+static void
+gst_ts_demux_index_pes (GstTSDemux * demux, TSDemuxStream * stream)
+{
+  MpegTSBase *base = (MpegTSBase *) demux;
+  gboolean scan;
+
+  if (!GST_CLOCK_TIME_IS_VALID (stream->pts)) {
+    demux->index_last = GST_CLOCK_TIME_NONE;
+    return;
+  }
+
+  if (!demux->index_is_audio && !stream->pes_rai
+      && !mpegts_index_is_keyframe (stream->stream.stream_type, stream->data,
+          stream->current_size))
+    return;
+
+  if (!GST_CLOCK_TIME_IS_VALID (demux->index_ref_ts)) {
+    demux->index_ref_raw = stream->raw_pts;
+    demux->index_ref_ts = stream->pts;
+  }
+
+  mpegts_index_add (demux->index, &demux->index_last, stream->pts,
+      stream->pes_offset);
+
+  if (demux->index_scanning || demux->index_scan_started
+      || demux->index->complete || base->mode == BASE_MODE_PUSHING
+      || base->packetsize == 0)
+    return;
+
+  GST_OBJECT_LOCK (demux);
+  scan = demux->index_scan;
+  GST_OBJECT_UNLOCK (demux);
+
+  if (scan) {
+    GST_DEBUG_OBJECT (demux, "Starting index scan of pid 0x%04x",
+        demux->index_stream->pid);
+    demux->index_scanning = TRUE;
+    demux->index_scan_started = TRUE;
+    demux->index_scan_offset = 0;
+    demux->index_scan_last = GST_CLOCK_TIME_NONE;
+    demux->index_scan_synced = FALSE;
+  }
+}
+
+/* Picks the first video stream (else audio stream) of @program that can be
+ * indexed and loads the index file if it was made for the same file and
+ * stream */
+static void
+gst_ts_demux_index_select_stream (GstTSDemux * demux,
+    MpegTSBaseProgram * program)
+{
+  MpegTSBase *base = (MpegTSBase *) demux;
+  MpegTSBaseStream *video = NULL, *audio = NULL, *bs;
+  gint64 size = -1;
+  gchar *filename;
+  GList *tmp;
+
+  for (tmp = program->stream_list; tmp; tmp = tmp->next) {
+    TSDemuxStream *stream = (TSDemuxStream *) tmp->data;
+
+    MpegTSBaseStream *bstream = (MpegTSBaseStream *) stream;
+
+    if (stream->pad == NULL)
+      continue;
+    switch (mpegts_index_stream_kind (bstream->stream_type)) {
+      case MPEGTS_INDEX_STREAM_VIDEO:
+        if (!video)
+          video = bstream;
+        break;
+      case MPEGTS_INDEX_STREAM_AUDIO:
+        if (!audio)
+          audio = bstream;
+        break;
+      default:
+        break;
+    }
+  }
+
+  bs = video ? video : audio;
+  demux->index_stream = bs;
+  demux->index_is_audio = (video == NULL);
+  demux->index_last = GST_CLOCK_TIME_NONE;
+
+  if (bs == NULL || bs->pid == demux->index->pid)
+    return;
+
+  GST_DEBUG_OBJECT (demux, "Indexing keyframes of pid 0x%04x", bs->pid);
+
+  demux->index_scanning = FALSE;
+  demux->index_scan_started = FALSE;
+  mpegts_index_clear (demux->index);
+  demux->index_ref_ts = GST_CLOCK_TIME_NONE;
+
+  gst_pad_peer_query_duration (base->sinkpad, GST_FORMAT_BYTES, &size);
+  g_mutex_lock (&demux->index->lock);
+  demux->index->pid = bs->pid;
+  demux->index->upstream_size = MAX (size, 0);
+  g_mutex_unlock (&demux->index->lock);
+
+  GST_OBJECT_LOCK (demux);
+  filename = g_strdup (demux->index_file);
+  GST_OBJECT_UNLOCK (demux);
+
+  if (filename && size > 0) {
+    GError *err = NULL;
+
+    if (!mpegts_index_load (demux->index, filename, bs->pid, size, &err)) {
+      GST_INFO_OBJECT (demux, "Not using index file %s: %s", filename,
+          err->message);
+      g_clear_error (&err);
+    }
+  }
+  g_free (filename);
+}
+
 static void
 gst_ts_demux_program_started (MpegTSBase * base, MpegTSBaseProgram * program)
 {
@@ -1598,6 +1940,8 @@ gst_ts_demux_program_started (MpegTSBase * base, MpegTSBaseProgram * program)
       activate_pad_for_stream (demux, stream);
     }
     gst_element_no_more_pads ((GstElement *) demux);
+
+    gst_ts_demux_index_select_stream (demux, program);
   }
 }
 
@@ -1609,6 +1953,7 @@ gst_ts_demux_program_stopped (MpegTSBase * base, MpegTSBaseProgram * program)
   if (demux->program == program) {
     demux->program = NULL;
     demux->program_number = -1;
+    demux->index_stream = NULL;
   }
 }
 
@@ -1815,6 +2160,8 @@ gst_ts_demux_parse_pes_header (GstTSDemux * demux, TSDemuxStream * stream,
 
   GST_MEMDUMP ("Header buffer", data, MIN (length, 32));
 
+  stream->pes_offset = bufferoffset;
+
   parseres = mpegts_parse_pes_header (data, length, &header);
   if (G_UNLIKELY (parseres == PES_PARSING_NEED_MORE))
     goto discont;
@@ -1881,6 +2228,8 @@ gst_ts_demux_parse_pes_header (GstTSDemux * demux, TSDemuxStream * stream,
 
 discont:
   stream->state = PENDING_PACKET_DISCONT;
+  if ((MpegTSBaseStream *) stream == demux->index_stream)
+    demux->index_last = GST_CLOCK_TIME_NONE;
   return;
 }
 
@@ -1911,6 +2260,8 @@ gst_ts_demux_queue_data (GstTSDemux * demux, TSDemuxStream * stream,
         cc, stream->continuity_counter);
     if (stream->state != PENDING_PACKET_EMPTY)
       stream->state = PENDING_PACKET_DISCONT;
+    if ((MpegTSBaseStream *) stream == demux->index_stream)
+      demux->index_last = GST_CLOCK_TIME_NONE;
   }
   stream->continuity_counter = cc;
 
@@ -1929,6 +2280,9 @@ gst_ts_demux_queue_data (GstTSDemux * demux, TSDemuxStream * stream,
     {
       GST_LOG ("HEADER: Parsing PES header");
 
+      stream->pes_rai =
+          (packet->afc_flags & MPEGTS_AFC_RANDOM_ACCES_FLAGS) != 0;
+
       /* parse the header */
       gst_ts_demux_parse_pes_header (demux, stream, data, size, packet->offset);
       break;
@@ -2151,6 +2505,9 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream)
     goto beach;
   }
 
+  if ((MpegTSBaseStream *) stream == demux->index_stream)
+    gst_ts_demux_index_pes (demux, stream);
+
   if (stream->needs_keyframe) {
     MpegTSBase *base = (MpegTSBase *) demux;
 
@@ -2172,6 +2529,7 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream)
       base->mode = BASE_MODE_SEEKING;
 
       stream->continuity_counter = CONTINUITY_UNSET;
+      demux->index_last = GST_CLOCK_TIME_NONE;
       res = GST_FLOW_REWINDING;
       g_free (stream->data);
       goto beach;
@@ -2331,6 +2689,7 @@ gst_ts_demux_flush (MpegTSBase * base, gboolean hard)
   GstTSDemux *demux = GST_TS_DEMUX_CAST (base);
 
   gst_ts_demux_flush_streams (demux, hard);
+  demux->index_last = GST_CLOCK_TIME_NONE;
 
   if (demux->segment_event) {
     gst_event_unref (demux->segment_event);
@@ -2393,6 +2752,7 @@ gst_ts_demux_plugin_init (GstPlugin * plugin)
   GST_DEBUG_CATEGORY_INIT (ts_demux_debug, "tsdemux", 0,
       "MPEG transport stream demuxer");
   init_pes_parser ();
+  init_mpegts_index ();
 
   return gst_element_register (plugin, "tsdemux",
       GST_RANK_PRIMARY, GST_TYPE_TS_DEMUX);
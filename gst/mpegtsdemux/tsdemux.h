@@ -32,6 +32,7 @@
 #include <gst/base/gstflowcombiner.h>
 #include "mpegtsbase.h"
 #include "mpegtspacketizer.h"
+#include "tsindex.h"
 
 G_BEGIN_DECLS
 #define GST_TYPE_TS_DEMUX \
@@ -84,6 +85,27 @@ struct _GstTSDemux
 
   /* Used when seeking for a keyframe to go backward in the stream */
   guint64 last_seek_offset;
+
+  /* Keyframe index of index_stream, used to resolve seeks */
+  MpegTSIndex *index;
+  MpegTSBaseStream *index_stream;
+  gboolean index_is_audio;
+  /* ts of the last keyframe indexed by the streaming thread */
+  GstClockTime index_last;
+  /* raw PTS (90kHz) <=> ts mapping used by the index scan */
+  guint64 index_ref_raw;
+  GstClockTime index_ref_ts;
+  /* scan of the whole file, run between the chunks of the streaming
+   * thread */
+  gboolean index_scanning;
+  gboolean index_scan_started;
+  guint64 index_scan_offset;
+  GstClockTime index_scan_last;
+  gboolean index_scan_synced;
+
+  /* protected by the OBJECT_LOCK */
+  gchar *index_file;
+  gboolean index_scan;
 };
 
 struct _GstTSDemuxClass
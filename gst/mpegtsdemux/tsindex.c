@@ -0,0 +1,428 @@
+/*
+ * tsindex.c : keyframe index for MPEG transport streams
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The index maps timestamps of keyframes of one stream to the offset of the
+ * TS packet starting their PES packet. It is filled by the demuxer while
+ * playing and optionally by a scan of the whole file, so entries are not
+ * necessarily added in order. A lookup is only answered if it is known
+ * that no keyframe between the returned entry and the requested time is
+ * missing, otherwise the caller has to fall back to estimating the offset.
+ *
+ * Sidecar file layout (all values big endian):
+ *   "TSIX" version:u32 upstream_size:u64 pid:u16 flags:u16 n_entries:u32
+ *   n_entries * { ts:u64 offset:u64 flags:u32 }
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/base/gstbytereader.h>
+#include <gst/base/gstbytewriter.h>
+#include <gst/mpegts/mpegts.h>
+
+#include "gstmpegdefs.h"
+#include "tsindex.h"
+
+GST_DEBUG_CATEGORY_STATIC (mpegts_index_debug);
+#define GST_CAT_DEFAULT mpegts_index_debug
+
+#define INDEX_MAGIC GST_MAKE_FOURCC ('T', 'S', 'I', 'X')
+#define INDEX_VERSION 1
+#define INDEX_HEADER_SIZE (4 + 4 + 8 + 2 + 2 + 4)
+#define INDEX_ENTRY_SIZE (8 + 8 + 4)
+
+#define INDEX_FLAG_COMPLETE (1 << 0)
+
+/* Keyframes closer than this to an existing entry are not indexed, this
+ * keeps the index small for streams where every packet is a keyframe */
+#define INDEX_MIN_INTERVAL (250 * GST_MSECOND)
+
+/* How far into a PES packet we look for a keyframe start code */
+#define KEYFRAME_SCAN_BYTES 8192
+
+#define ENTRY(index,i) (&g_array_index ((index)->entries, MpegTSIndexEntry, (i)))
+
+MpegTSIndex *
+mpegts_index_new (void)
+{
+  MpegTSIndex *index = g_slice_new0 (MpegTSIndex);
+
+  g_mutex_init (&index->lock);
+  index->entries = g_array_new (FALSE, FALSE, sizeof (MpegTSIndexEntry));
+
+  return index;
+}
+
+void
+mpegts_index_free (MpegTSIndex * index)
+{
+  g_array_free (index->entries, TRUE);
+  g_mutex_clear (&index->lock);
+  g_slice_free (MpegTSIndex, index);
+}
+
+void
+mpegts_index_clear (MpegTSIndex * index)
+{
+  g_mutex_lock (&index->lock);
+  g_array_set_size (index->entries, 0);
+  index->pid = 0;
+  index->upstream_size = 0;
+  index->complete = FALSE;
+  index->dirty = FALSE;
+  g_mutex_unlock (&index->lock);
+}
+
+/* Returns the position of the first entry with an offset >= @offset */
+static guint
+find_offset (MpegTSIndex * index, guint64 offset)
+{
+  guint lo = 0, hi = index->entries->len;
+
+  while (lo < hi) {
+    guint mid = (lo + hi) / 2;
+
+    if (ENTRY (index, mid)->offset < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* Returns the number of entries with a ts <= @ts */
+static guint
+find_ts (MpegTSIndex * index, GstClockTime ts)
+{
+  guint lo = 0, hi = index->entries->len;
+
+  while (lo < hi) {
+    guint mid = (lo + hi) / 2;
+
+    if (ENTRY (index, mid)->ts <= ts)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/* Adds a keyframe seen at @offset. @last is the producer's cursor: the ts of
+ * the previous keyframe it added, or GST_CLOCK_TIME_NONE after a
+ * discontinuity. Entries following the cursor are marked contiguous. */
+void
+mpegts_index_add (MpegTSIndex * index, GstClockTime * last, GstClockTime ts,
+    guint64 offset)
+{
+  MpegTSIndexEntry *entry;
+  guint p, n;
+
+  g_mutex_lock (&index->lock);
+
+  n = index->entries->len;
+  p = find_offset (index, offset);
+
+  if (p < n && ENTRY (index, p)->offset == offset) {
+    entry = ENTRY (index, p);
+  } else {
+    /* Keep ts in the same order as the offsets, timestamp discontinuities
+     * would make the lookup return wrong entries */
+    if ((p > 0 && ENTRY (index, p - 1)->ts >= ts) ||
+        (p < n && ENTRY (index, p)->ts <= ts)) {
+      GST_DEBUG ("Not indexing %" GST_TIME_FORMAT " at offset %"
+          G_GUINT64_FORMAT ", out of order", GST_TIME_ARGS (ts), offset);
+      *last = GST_CLOCK_TIME_NONE;
+      goto done;
+    }
+
+    if ((p > 0 && ts - ENTRY (index, p - 1)->ts < INDEX_MIN_INTERVAL) ||
+        (p < n && ENTRY (index, p)->ts - ts < INDEX_MIN_INTERVAL))
+      goto done;
+
+    {
+      MpegTSIndexEntry new_entry = { ts, offset, 0 };
+
+      g_array_insert_val (index->entries, p, new_entry);
+      entry = ENTRY (index, p);
+      index->dirty = TRUE;
+    }
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (*last) && p > 0
+      && ENTRY (index, p - 1)->ts == *last
+      && !(entry->flags & MPEGTS_INDEX_ENTRY_CONTIGUOUS)) {
+    entry->flags |= MPEGTS_INDEX_ENTRY_CONTIGUOUS;
+    index->dirty = TRUE;
+  }
+  *last = entry->ts;
+
+done:
+  g_mutex_unlock (&index->lock);
+}
+
+void
+mpegts_index_set_complete (MpegTSIndex * index)
+{
+  g_mutex_lock (&index->lock);
+  if (!index->complete) {
+    GST_DEBUG ("Index complete with %u entries", index->entries->len);
+    index->complete = TRUE;
+    index->dirty = TRUE;
+  }
+  g_mutex_unlock (&index->lock);
+}
+
+/* Finds the last keyframe at or before @ts. Returns FALSE if there is none
+ * or if a keyframe closer to @ts might be missing from the index */
+gboolean
+mpegts_index_lookup (MpegTSIndex * index, GstClockTime ts,
+    MpegTSIndexEntry * entry)
+{
+  gboolean res = FALSE;
+  guint p, n;
+
+  g_mutex_lock (&index->lock);
+
+  n = index->entries->len;
+  p = find_ts (index, ts);
+  if (p == 0)
+    goto done;
+
+  if (index->complete || (p < n
+          && (ENTRY (index, p)->flags & MPEGTS_INDEX_ENTRY_CONTIGUOUS))) {
+    *entry = *ENTRY (index, p - 1);
+    res = TRUE;
+  }
+
+done:
+  g_mutex_unlock (&index->lock);
+
+  return res;
+}
+
+gboolean
+mpegts_index_save (MpegTSIndex * index, const gchar * filename,
+    GError ** error)
+{
+  GstByteWriter bw;
+  gboolean res;
+  guint i, n;
+
+  g_mutex_lock (&index->lock);
+
+  n = index->entries->len;
+  gst_byte_writer_init_with_size (&bw,
+      INDEX_HEADER_SIZE + n * INDEX_ENTRY_SIZE, FALSE);
+  gst_byte_writer_put_uint32_le (&bw, INDEX_MAGIC);
+  gst_byte_writer_put_uint32_be (&bw, INDEX_VERSION);
+  gst_byte_writer_put_uint64_be (&bw, index->upstream_size);
+  gst_byte_writer_put_uint16_be (&bw, index->pid);
+  gst_byte_writer_put_uint16_be (&bw,
+      index->complete ? INDEX_FLAG_COMPLETE : 0);
+  gst_byte_writer_put_uint32_be (&bw, n);
+  for (i = 0; i < n; i++) {
+    MpegTSIndexEntry *entry = ENTRY (index, i);
+
+    gst_byte_writer_put_uint64_be (&bw, entry->ts);
+    gst_byte_writer_put_uint64_be (&bw, entry->offset);
+    gst_byte_writer_put_uint32_be (&bw, entry->flags);
+  }
+
+  res = g_file_set_contents (filename, (const gchar *) bw.parent.data,
+      bw.parent.size, error);
+  if (res)
+    index->dirty = FALSE;
+
+  g_mutex_unlock (&index->lock);
+
+  gst_byte_writer_reset (&bw);
+
+  return res;
+}
+
+/* Replaces the index with the one stored in @filename if it was made for a
+ * file of @upstream_size bytes with the same indexed @pid */
+gboolean
+mpegts_index_load (MpegTSIndex * index, const gchar * filename, guint16 pid,
+    guint64 upstream_size, GError ** error)
+{
+  GstByteReader br;
+  gchar *contents;
+  gsize length;
+  guint32 magic, version, n, i;
+  guint64 size;
+  guint16 file_pid, flags;
+  GArray *entries;
+
+  if (!g_file_get_contents (filename, &contents, &length, error))
+    return FALSE;
+
+  gst_byte_reader_init (&br, (const guint8 *) contents, length);
+  if (length < INDEX_HEADER_SIZE)
+    goto invalid;
+
+  magic = gst_byte_reader_get_uint32_le_unchecked (&br);
+  version = gst_byte_reader_get_uint32_be_unchecked (&br);
+  size = gst_byte_reader_get_uint64_be_unchecked (&br);
+  file_pid = gst_byte_reader_get_uint16_be_unchecked (&br);
+  flags = gst_byte_reader_get_uint16_be_unchecked (&br);
+  n = gst_byte_reader_get_uint32_be_unchecked (&br);
+
+  if (magic != INDEX_MAGIC || version != INDEX_VERSION)
+    goto invalid;
+  if (gst_byte_reader_get_remaining (&br) / INDEX_ENTRY_SIZE < n)
+    goto invalid;
+
+  if (size != upstream_size || file_pid != pid) {
+    g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED,
+        "Index was made for a different file");
+    g_free (contents);
+    return FALSE;
+  }
+
+  entries = g_array_sized_new (FALSE, FALSE, sizeof (MpegTSIndexEntry), n);
+  for (i = 0; i < n; i++) {
+    MpegTSIndexEntry entry;
+
+    entry.ts = gst_byte_reader_get_uint64_be_unchecked (&br);
+    entry.offset = gst_byte_reader_get_uint64_be_unchecked (&br);
+    entry.flags = gst_byte_reader_get_uint32_be_unchecked (&br);
+
+    if (!GST_CLOCK_TIME_IS_VALID (entry.ts) || entry.offset >= size ||
+        (i > 0 && (entry.ts <= g_array_index (entries, MpegTSIndexEntry,
+                        i - 1).ts
+                || entry.offset <= g_array_index (entries,
+                    MpegTSIndexEntry, i - 1).offset))) {
+      g_array_free (entries, TRUE);
+      goto invalid;
+    }
+    g_array_append_val (entries, entry);
+  }
+  g_free (contents);
+
+  g_mutex_lock (&index->lock);
+  g_array_free (index->entries, TRUE);
+  index->entries = entries;
+  index->pid = pid;
+  index->upstream_size = upstream_size;
+  index->complete = (flags & INDEX_FLAG_COMPLETE) != 0;
+  index->dirty = FALSE;
+  GST_DEBUG ("Loaded %u index entries (complete:%d)", n, index->complete);
+  g_mutex_unlock (&index->lock);
+
+  return TRUE;
+
+invalid:
+  g_set_error (error, GST_STREAM_ERROR, GST_STREAM_ERROR_FORMAT,
+      "Invalid index file");
+  g_free (contents);
+  return FALSE;
+}
+
+/* Video streams are indexed at the keyframes mpegts_index_is_keyframe()
+ * detects, audio streams at every PES */
+MpegTSIndexStreamKind
+mpegts_index_stream_kind (guint8 stream_type)
+{
+  switch (stream_type) {
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_MPEG1:
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_MPEG2:
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_H264:
+    case GST_MPEGTS_STREAM_TYPE_VIDEO_HEVC:
+      return MPEGTS_INDEX_STREAM_VIDEO;
+    case GST_MPEGTS_STREAM_TYPE_AUDIO_MPEG1:
+    case GST_MPEGTS_STREAM_TYPE_AUDIO_MPEG2:
+    case GST_MPEGTS_STREAM_TYPE_AUDIO_AAC_ADTS:
+    case GST_MPEGTS_STREAM_TYPE_AUDIO_AAC_LATM:
+    case GST_MPEGTS_STREAM_TYPE_AUDIO_AAC_CLEAN:
+    case ST_PS_AUDIO_AC3:
+      return MPEGTS_INDEX_STREAM_AUDIO;
+    default:
+      return MPEGTS_INDEX_STREAM_NONE;
+  }
+}
+
+/* Looks for the start codes that begin a random access point at the start
+ * of a video PES payload. Stream types we don't know rely on the random
+ * access indicator only. */
+gboolean
+mpegts_index_is_keyframe (guint8 stream_type, const guint8 * data, gsize size)
+{
+  gsize i;
+
+  size = MIN (size, KEYFRAME_SCAN_BYTES);
+
+  for (i = 0; i + 3 < size; i++) {
+    guint8 code;
+
+    if (data[i] != 0x00 || data[i + 1] != 0x00 || data[i + 2] != 0x01)
+      continue;
+
+    code = data[i + 3];
+    switch (stream_type) {
+      case GST_MPEGTS_STREAM_TYPE_VIDEO_MPEG1:
+      case GST_MPEGTS_STREAM_TYPE_VIDEO_MPEG2:
+        /* sequence header or group of pictures */
+        if (code == 0xb3 || code == 0xb8)
+          return TRUE;
+        /* picture header without a preceding sequence header */
+        if (code == 0x00)
+          return FALSE;
+        break;
+      case GST_MPEGTS_STREAM_TYPE_VIDEO_H264:
+        switch (code & 0x1f) {
+          case 5:              /* IDR slice */
+          case 7:              /* SPS */
+            return TRUE;
+          case 1:              /* non-IDR slice */
+            return FALSE;
+        }
+        break;
+      case GST_MPEGTS_STREAM_TYPE_VIDEO_HEVC:
+      {
+        guint type = (code >> 1) & 0x3f;
+
+        /* IRAP slices, VPS and SPS */
+        if ((type >= 16 && type <= 21) || type == 32 || type == 33)
+          return TRUE;
+        if (type < 16)
+          return FALSE;
+        break;
+      }
+      default:
+        return FALSE;
+    }
+    i += 3;
+  }
+
+  return FALSE;
+}
+
+void
+init_mpegts_index (void)
+{
+  GST_DEBUG_CATEGORY_INIT (mpegts_index_debug, "mpegtsindex", 0,
+      "MPEG TS keyframe index");
+}
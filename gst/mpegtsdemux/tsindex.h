@@ -0,0 +1,86 @@
+/*
+ * tsindex.h : keyframe index for MPEG transport streams
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __MPEGTS_INDEX_H__
+#define __MPEGTS_INDEX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Set on an entry when no keyframe was missed between the previous entry
+ * and this one, i.e. both were seen while reading the stream linearly */
+#define MPEGTS_INDEX_ENTRY_CONTIGUOUS	(1 << 0)
+
+typedef enum {
+  MPEGTS_INDEX_STREAM_NONE,
+  MPEGTS_INDEX_STREAM_VIDEO,
+  MPEGTS_INDEX_STREAM_AUDIO
+} MpegTSIndexStreamKind;
+
+typedef struct {
+  GstClockTime	ts;		/* Timestamp of the keyframe */
+  guint64	offset;		/* Offset of the TS packet starting its PES */
+  guint32	flags;
+} MpegTSIndexEntry;
+
+typedef struct {
+  GMutex	lock;
+
+  /* MpegTSIndexEntry sorted by offset (and therefore by ts) */
+  GArray	*entries;
+
+  /* PID of the indexed stream and size of the indexed file */
+  guint16	pid;
+  guint64	upstream_size;
+
+  /* TRUE if the whole file was scanned: every keyframe is in the index */
+  gboolean	complete;
+  /* TRUE if the index changed since it was last loaded/saved */
+  gboolean	dirty;
+} MpegTSIndex;
+
+G_GNUC_INTERNAL MpegTSIndex *mpegts_index_new (void);
+G_GNUC_INTERNAL void mpegts_index_free (MpegTSIndex * index);
+G_GNUC_INTERNAL void mpegts_index_clear (MpegTSIndex * index);
+
+G_GNUC_INTERNAL void mpegts_index_add (MpegTSIndex * index, GstClockTime * last,
+				       GstClockTime ts, guint64 offset);
+G_GNUC_INTERNAL void mpegts_index_set_complete (MpegTSIndex * index);
+G_GNUC_INTERNAL gboolean mpegts_index_lookup (MpegTSIndex * index,
+					      GstClockTime ts,
+					      MpegTSIndexEntry * entry);
+
+G_GNUC_INTERNAL gboolean mpegts_index_save (MpegTSIndex * index,
+					    const gchar * filename,
+					    GError ** error);
+G_GNUC_INTERNAL gboolean mpegts_index_load (MpegTSIndex * index,
+					    const gchar * filename,
+					    guint16 pid, guint64 upstream_size,
+					    GError ** error);
+
+G_GNUC_INTERNAL MpegTSIndexStreamKind mpegts_index_stream_kind (guint8 stream_type);
+G_GNUC_INTERNAL gboolean mpegts_index_is_keyframe (guint8 stream_type,
+						   const guint8 * data,
+						   gsize size);
+G_GNUC_INTERNAL void init_mpegts_index (void);
+
+G_END_DECLS
+
+#endif /* __MPEGTS_INDEX_H__ */
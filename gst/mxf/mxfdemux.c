@@ -113,9 +113,22 @@ enum
   PROP_0,
   PROP_PACKAGE,
   PROP_MAX_DRIFT,
-  PROP_STRUCTURE
+  PROP_STRUCTURE,
+  PROP_LAZY_METADATA
 };
 
+#define DEFAULT_LAZY_METADATA FALSE
+
+/* SMPTE 377M Annex A set types and static local tags used to find the
+ * metadata sets needed for playback without parsing everything */
+#define MXF_SET_TYPE_PREFACE 0x012f
+#define MXF_SET_TYPE_CONTENT_STORAGE 0x0118
+#define MXF_SET_TYPE_MATERIAL_PACKAGE 0x0136
+#define MXF_SET_TYPE_SOURCE_PACKAGE 0x0137
+#define MXF_TAG_INSTANCE_UID 0x3c0a
+#define MXF_TAG_PACKAGES 0x1901
+#define MXF_TAG_PACKAGE_UID 0x4401
+
 static gboolean gst_mxf_demux_sink_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
 static gboolean gst_mxf_demux_src_event (GstPad * pad, GstObject * parent,
@@ -150,6 +163,23 @@ gst_mxf_demux_partition_free (GstMXFDemuxPartition * partition)
   g_free (partition);
 }
 
+static void
+gst_mxf_demux_clear_index_tables (GstMXFDemux * demux)
+{
+  guint i;
+
+  for (i = 0; i < demux->index_tables->len; i++) {
+    GstMXFDemuxIndexTable *t =
+        &g_array_index (demux->index_tables, GstMXFDemuxIndexTable, i);
+
+    g_array_free (t->ranges, TRUE);
+    g_array_free (t->entries, TRUE);
+    g_ptr_array_free (t->partitions, TRUE);
+  }
+  g_array_set_size (demux->index_tables, 0);
+  demux->index_tables_dirty = TRUE;
+}
+
 static void
 gst_mxf_demux_reset_mxf_state (GstMXFDemux * demux)
 {
@@ -157,6 +187,9 @@ gst_mxf_demux_reset_mxf_state (GstMXFDemux * demux)
 
   GST_DEBUG_OBJECT (demux, "Resetting MXF state");
 
+  /* the index tables reference the partitions */
+  gst_mxf_demux_clear_index_tables (demux);
+
   g_list_foreach (demux->partitions, (GFunc) gst_mxf_demux_partition_free,
       NULL);
   g_list_free (demux->partitions);
@@ -225,6 +258,9 @@ gst_mxf_demux_reset_metadata (GstMXFDemux * demux)
   }
   demux->metadata = mxf_metadata_hash_table_new ();
 
+  if (demux->metadata_sets)
+    g_hash_table_remove_all (demux->metadata_sets);
+
   if (demux->tags) {
     gst_tag_list_unref (demux->tags);
     demux->tags = NULL;
@@ -417,12 +453,14 @@ gst_mxf_demux_handle_partition_pack (GstMXFDemux * demux, const MXFUL * key,
   if (p) {
     mxf_partition_pack_reset (&p->partition);
     memcpy (&p->partition, &partition, sizeof (MXFPartitionPack));
+    demux->index_tables_dirty = TRUE;
   } else {
     p = g_new0 (GstMXFDemuxPartition, 1);
     memcpy (&p->partition, &partition, sizeof (MXFPartitionPack));
     demux->partitions =
         g_list_insert_sorted (demux->partitions, p,
         (GCompareFunc) gst_mxf_demux_partition_compare);
+    demux->index_tables_dirty = TRUE;
   }
 
   for (l = demux->partitions; l; l = l->next) {
@@ -478,6 +516,222 @@ gst_mxf_demux_handle_primer_pack (GstMXFDemux * demux, const MXFUL * key,
   return GST_FLOW_OK;
 }
 
+static void
+gst_mxf_demux_metadata_set_free (GstMXFDemuxMetadataSet * set)
+{
+  gst_buffer_unref (set->buffer);
+  g_slice_free (GstMXFDemuxMetadataSet, set);
+}
+
+/* Returns the value of @tag in the local set @data, or NULL */
+static const guint8 *
+gst_mxf_demux_find_local_tag (const guint8 * data, guint size, guint16 tag,
+    guint16 * tag_size)
+{
+  while (size >= 4) {
+    guint16 t = GST_READ_UINT16_BE (data);
+    guint16 len = GST_READ_UINT16_BE (data + 2);
+
+    if (len > size - 4)
+      break;
+
+    if (t == tag) {
+      *tag_size = len;
+      return data + 4;
+    }
+
+    data += 4 + len;
+    size -= 4 + len;
+  }
+
+  return NULL;
+}
+
+static void
+gst_mxf_demux_queue_metadata_uid (GstMXFDemux * demux, GQueue * queue,
+    const guint8 * uid)
+{
+  GstMXFDemuxMetadataSet *set;
+
+  set = g_hash_table_lookup (demux->metadata_sets, uid);
+  if (set)
+    g_queue_push_tail (queue, set);
+}
+
+static void
+gst_mxf_demux_queue_metadata_umid (GstMXFDemux * demux, GQueue * queue,
+    GPtrArray * packages, const guint8 * umid)
+{
+  guint i;
+
+  for (i = 0; i < packages->len; i++) {
+    GstMXFDemuxMetadataSet *set = g_ptr_array_index (packages, i);
+
+    if (mxf_umid_is_equal (&set->package_uid, (const MXFUMID *) umid))
+      g_queue_push_tail (queue, set);
+  }
+}
+
+/* Queues the packages of the content storage that can be chosen for
+ * playback, the others are never parsed */
+static void
+gst_mxf_demux_queue_metadata_packages (GstMXFDemux * demux, GQueue * queue,
+    const guint8 * data, guint16 size)
+{
+  MXFUMID wanted = { {0,} };
+  gboolean have_material = FALSE;
+  guint32 i, n, item_size;
+
+  if (size < 8)
+    return;
+
+  n = GST_READ_UINT32_BE (data);
+  item_size = GST_READ_UINT32_BE (data + 4);
+  if (item_size != 16 || n > (size - 8) / 16)
+    return;
+
+  if (demux->requested_package_string)
+    mxf_umid_from_string (demux->requested_package_string, &wanted);
+  else
+    memcpy (&wanted, &demux->current_package_uid, sizeof (MXFUMID));
+
+  for (i = 0; i < n; i++) {
+    GstMXFDemuxMetadataSet *set =
+        g_hash_table_lookup (demux->metadata_sets, data + 8 + 16 * i);
+
+    if (!set)
+      continue;
+
+    if (!have_material && set->type == MXF_SET_TYPE_MATERIAL_PACKAGE) {
+      have_material = TRUE;
+      g_queue_push_tail (queue, set);
+    } else if (!mxf_umid_is_zero (&wanted)
+        && mxf_umid_is_equal (&set->package_uid, &wanted)) {
+      g_queue_push_tail (queue, set);
+    }
+  }
+}
+
+/* lazy-metadata: parses the sets reachable from the preface. Strong and
+ * weak references are found by looking for InstanceUIDs and package UMIDs
+ * in the values of each set, of the content storage's packages only the
+ * ones that can be chosen for playback are followed. Must be called with
+ * the metadata writer lock */
+static void
+gst_mxf_demux_parse_needed_metadata (GstMXFDemux * demux)
+{
+  GHashTable *visited;
+  GPtrArray *packages;
+  GQueue queue = G_QUEUE_INIT;
+  GHashTableIter iter;
+  GstMXFDemuxMetadataSet *set;
+  guint n_parsed = 0;
+
+  if (!demux->preface)
+    return;
+
+  packages = g_ptr_array_new ();
+  g_hash_table_iter_init (&iter, demux->metadata_sets);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer) & set)) {
+    if (set->type == MXF_SET_TYPE_MATERIAL_PACKAGE
+        || set->type == MXF_SET_TYPE_SOURCE_PACKAGE)
+      g_ptr_array_add (packages, set);
+  }
+
+  visited = g_hash_table_new ((GHashFunc) mxf_uuid_hash,
+      (GEqualFunc) mxf_uuid_is_equal);
+
+  gst_mxf_demux_queue_metadata_uid (demux, &queue,
+      MXF_METADATA_BASE (demux->preface)->instance_uid.u);
+  /* The primary package and the identifications are referenced from the
+   * preface itself */
+
+  while ((set = g_queue_pop_head (&queue))) {
+    MXFMetadataBase *m;
+    GstMapInfo map;
+    const guint8 *data;
+    guint size;
+
+    if (g_hash_table_lookup (visited, &set->instance_uid))
+      continue;
+    g_hash_table_insert (visited, &set->instance_uid, set);
+
+    gst_buffer_map (set->buffer, &map, GST_MAP_READ);
+
+    m = g_hash_table_lookup (demux->metadata, &set->instance_uid);
+    if (!m || m->offset != set->offset) {
+      MXFMetadataBase *parsed;
+
+      if (set->descriptive)
+        parsed = (MXFMetadataBase *) mxf_descriptive_metadata_new
+            (set->dm_scheme, set->dm_type, set->primer, set->offset, map.data,
+            map.size);
+      else
+        parsed = (MXFMetadataBase *) mxf_metadata_new (set->type, set->primer,
+            set->offset, map.data, map.size);
+      if (parsed) {
+        g_hash_table_replace (demux->metadata, &parsed->instance_uid, parsed);
+        if (MXF_IS_METADATA_PREFACE (parsed))
+          demux->preface = MXF_METADATA_PREFACE (parsed);
+        n_parsed++;
+      }
+    }
+
+    data = map.data;
+    size = map.size;
+    while (size >= 4) {
+      guint16 tag = GST_READ_UINT16_BE (data);
+      guint16 len = GST_READ_UINT16_BE (data + 2);
+      const guint8 *value = data + 4;
+
+      if (len > size - 4)
+        break;
+
+      if (tag == MXF_TAG_INSTANCE_UID) {
+        /* skip */
+      } else if (set->type == MXF_SET_TYPE_CONTENT_STORAGE
+          && tag == MXF_TAG_PACKAGES) {
+        gst_mxf_demux_queue_metadata_packages (demux, &queue, value, len);
+      } else if (len == 16) {
+        gst_mxf_demux_queue_metadata_uid (demux, &queue, value);
+      } else if (len == 32) {
+        gst_mxf_demux_queue_metadata_umid (demux, &queue, packages, value);
+      } else if (len >= 8) {
+        guint32 n = GST_READ_UINT32_BE (value);
+        guint32 item_size = GST_READ_UINT32_BE (value + 4);
+        guint32 i;
+
+        /* batches and arrays of references */
+        if ((item_size == 16 || item_size == 32)
+            && n == (len - 8) / item_size && (len - 8) % item_size == 0) {
+          for (i = 0; i < n; i++) {
+            if (item_size == 16)
+              gst_mxf_demux_queue_metadata_uid (demux, &queue,
+                  value + 8 + 16 * i);
+            else
+              gst_mxf_demux_queue_metadata_umid (demux, &queue, packages,
+                  value + 8 + 32 * i);
+          }
+        }
+      }
+
+      data += 4 + len;
+      size -= 4 + len;
+    }
+
+    gst_buffer_unmap (set->buffer, &map);
+  }
+
+  GST_DEBUG_OBJECT (demux, "Parsed %u of %u metadata sets", n_parsed,
+      g_hash_table_size (demux->metadata_sets));
+
+  if (n_parsed > 0)
+    gst_mxf_demux_reset_linked_metadata (demux);
+
+  g_hash_table_destroy (visited);
+  g_ptr_array_free (packages, TRUE);
+}
+
 static GstFlowReturn
 gst_mxf_demux_resolve_references (GstMXFDemux * demux)
 {
@@ -497,6 +751,9 @@ gst_mxf_demux_resolve_references (GstMXFDemux * demux)
     return GST_FLOW_ERROR;
   }
 
+  if (demux->lazy_metadata)
+    gst_mxf_demux_parse_needed_metadata (demux);
+
   g_hash_table_iter_init (&iter, demux->metadata);
   while (g_hash_table_iter_next (&iter, NULL, (gpointer) & m)) {
     m->resolved = MXF_METADATA_BASE_RESOLVE_STATE_NONE;
@@ -1258,6 +1515,62 @@ error:
   return ret;
 }
 
+/* lazy-metadata: remembers where a set is instead of parsing it */
+static void
+gst_mxf_demux_index_metadata_set (GstMXFDemux * demux, const MXFUL * key,
+    GstBuffer * buffer)
+{
+  GstMXFDemuxMetadataSet *set, *old;
+  const guint8 *tag_data;
+  guint16 tag_size;
+  GstMapInfo map;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  tag_data = gst_mxf_demux_find_local_tag (map.data, map.size,
+      MXF_TAG_INSTANCE_UID, &tag_size);
+  if (!tag_data || tag_size != 16) {
+    GST_WARNING_OBJECT (demux, "Metadata set without instance uid");
+    gst_buffer_unmap (buffer, &map);
+    return;
+  }
+
+  old = g_hash_table_lookup (demux->metadata_sets, tag_data);
+  if (old && old->offset >= demux->offset) {
+    gst_buffer_unmap (buffer, &map);
+    return;
+  }
+
+  set = g_slice_new0 (GstMXFDemuxMetadataSet);
+  memcpy (&set->instance_uid, tag_data, 16);
+  set->offset = demux->offset;
+  set->primer = &demux->current_partition->primer;
+
+  if (mxf_is_descriptive_metadata (key)) {
+    set->descriptive = TRUE;
+    set->dm_scheme = GST_READ_UINT8 (key->u + 12);
+    set->dm_type = GST_READ_UINT24_BE (key->u + 13);
+  } else {
+    set->type = GST_READ_UINT16_BE (key->u + 13);
+  }
+
+  if (set->type == MXF_SET_TYPE_MATERIAL_PACKAGE
+      || set->type == MXF_SET_TYPE_SOURCE_PACKAGE) {
+    tag_data = gst_mxf_demux_find_local_tag (map.data, map.size,
+        MXF_TAG_PACKAGE_UID, &tag_size);
+    if (tag_data && tag_size == 32)
+      memcpy (&set->package_uid, tag_data, 32);
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  set->buffer = gst_buffer_ref (buffer);
+
+  g_rw_lock_writer_lock (&demux->metadata_lock);
+  demux->update_metadata = TRUE;
+  gst_mxf_demux_reset_linked_metadata (demux);
+  g_hash_table_replace (demux->metadata_sets, &set->instance_uid, set);
+  g_rw_lock_writer_unlock (&demux->metadata_lock);
+}
+
 static GstFlowReturn
 gst_mxf_demux_handle_metadata (GstMXFDemux * demux, const MXFUL * key,
     GstBuffer * buffer)
@@ -1289,6 +1602,14 @@ gst_mxf_demux_handle_metadata (GstMXFDemux * demux, const MXFUL * key,
     return GST_FLOW_OK;
   }
 
+  if (demux->lazy_metadata) {
+    gst_mxf_demux_index_metadata_set (demux, key, buffer);
+
+    /* Everything else is parsed on demand when resolving */
+    if (type != MXF_SET_TYPE_PREFACE)
+      return GST_FLOW_OK;
+  }
+
   gst_buffer_map (buffer, &map, GST_MAP_READ);
   metadata =
       mxf_metadata_new (type, &demux->current_partition->primer, demux->offset,
@@ -1381,6 +1702,12 @@ gst_mxf_demux_handle_descriptive_metadata (GstMXFDemux * demux,
     return GST_FLOW_OK;
   }
 
+  /* Parsed on demand when a DM segment refers to it */
+  if (demux->lazy_metadata) {
+    gst_mxf_demux_index_metadata_set (demux, key, buffer);
+    return GST_FLOW_OK;
+  }
+
   gst_buffer_map (buffer, &map, GST_MAP_READ);
   m = mxf_descriptive_metadata_new (scheme, type,
       &demux->current_partition->primer, demux->offset, map.data, map.size);
@@ -1445,11 +1772,6 @@ gst_mxf_demux_handle_generic_container_system_item (GstMXFDemux * demux,
       " at offset %" G_GUINT64_FORMAT, gst_buffer_get_size (buffer),
       demux->offset);
 
-  if (demux->current_partition->essence_container_offset == 0)
-    demux->current_partition->essence_container_offset =
-        demux->offset - demux->current_partition->partition.this_partition -
-        demux->run_in;
-
   /* TODO: parse this */
   return GST_FLOW_OK;
 }
@@ -1592,6 +1914,80 @@ gst_mxf_demux_pad_set_component (GstMXFDemux * demux, GstMXFDemuxPad * pad,
   return ret;
 }
 
+/* Returns the index of the last entry at or before @position in the
+ * sparse index of @etrack, or -1 */
+static gint
+gst_mxf_demux_track_index_search (GstMXFDemuxEssenceTrack * etrack,
+    gint64 position)
+{
+  gint lo, hi;
+
+  if (!etrack->offsets || etrack->offsets->len == 0)
+    return -1;
+
+  lo = 0;
+  hi = etrack->offsets->len - 1;
+  if (g_array_index (etrack->offsets, GstMXFDemuxIndex, hi).position <=
+      position)
+    return hi;
+
+  while (lo <= hi) {
+    gint mid = lo + (hi - lo) / 2;
+    gint64 p = g_array_index (etrack->offsets, GstMXFDemuxIndex, mid).position;
+
+    if (p == position)
+      return mid;
+    else if (p < position)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+
+  return hi;
+}
+
+static GstMXFDemuxIndex *
+gst_mxf_demux_track_index_find (GstMXFDemuxEssenceTrack * etrack,
+    gint64 position)
+{
+  gint i = gst_mxf_demux_track_index_search (etrack, position);
+  GstMXFDemuxIndex *idx;
+
+  if (i == -1)
+    return NULL;
+
+  idx = &g_array_index (etrack->offsets, GstMXFDemuxIndex, i);
+  return idx->position == position ? idx : NULL;
+}
+
+static void
+gst_mxf_demux_track_index_add (GstMXFDemuxEssenceTrack * etrack,
+    gint64 position, guint64 offset, gboolean keyframe)
+{
+  GstMXFDemuxIndex *idx;
+  GstMXFDemuxIndex index;
+  gint i;
+
+  if (!etrack->offsets)
+    etrack->offsets = g_array_new (FALSE, FALSE, sizeof (GstMXFDemuxIndex));
+
+  i = gst_mxf_demux_track_index_search (etrack, position);
+  if (i != -1) {
+    idx = &g_array_index (etrack->offsets, GstMXFDemuxIndex, i);
+    if (idx->position == position) {
+      idx->offset = offset;
+      idx->keyframe = keyframe;
+      return;
+    }
+  }
+
+  index.position = position;
+  index.offset = offset;
+  index.keyframe = keyframe;
+  /* usually appends, elements are mostly handled in order */
+  g_array_insert_val (etrack->offsets, i + 1, index);
+}
+
 static GstFlowReturn
 gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
     const MXFUL * key, GstBuffer * buffer, gboolean peek)
@@ -1614,11 +2010,6 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
   GST_DEBUG_OBJECT (demux, "  essence element type = 0x%02x", key->u[14]);
   GST_DEBUG_OBJECT (demux, "  essence element number = 0x%02x", key->u[15]);
 
-  if (demux->current_partition->essence_container_offset == 0)
-    demux->current_partition->essence_container_offset =
-        demux->offset - demux->current_partition->partition.this_partition -
-        demux->run_in;
-
   if (!demux->current_package) {
     GST_ERROR_OBJECT (demux, "No package selected yet");
     return GST_FLOW_ERROR;
@@ -1661,8 +2052,8 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
         GstMXFDemuxIndex *idx =
             &g_array_index (etrack->offsets, GstMXFDemuxIndex, i);
 
-        if (idx->offset != 0 && idx->offset == demux->offset - demux->run_in) {
-          etrack->position = i;
+        if (idx->offset == demux->offset - demux->run_in) {
+          etrack->position = idx->position;
           break;
         }
       }
@@ -1674,10 +2065,10 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
     }
   }
 
-  if (etrack->offsets && etrack->offsets->len > etrack->position) {
+  {
     GstMXFDemuxIndex *index =
-        &g_array_index (etrack->offsets, GstMXFDemuxIndex, etrack->position);
-    if (index->offset != 0)
+        gst_mxf_demux_track_index_find (etrack, etrack->position);
+    if (index)
       keyframe = index->keyframe;
   }
 
@@ -1713,26 +2104,8 @@ gst_mxf_demux_handle_generic_container_essence_element (GstMXFDemux * demux,
   if (outbuf)
     keyframe = !GST_BUFFER_FLAG_IS_SET (outbuf, GST_BUFFER_FLAG_DELTA_UNIT);
 
-  if (!etrack->offsets)
-    etrack->offsets = g_array_new (FALSE, TRUE, sizeof (GstMXFDemuxIndex));
-
-  {
-    if (etrack->offsets->len > etrack->position) {
-      GstMXFDemuxIndex *index =
-          &g_array_index (etrack->offsets, GstMXFDemuxIndex, etrack->position);
-
-      index->offset = demux->offset - demux->run_in;
-      index->keyframe = keyframe;
-    } else {
-      GstMXFDemuxIndex index;
-
-      index.offset = demux->offset - demux->run_in;
-      index.keyframe = keyframe;
-      if (etrack->offsets->len < etrack->position)
-        g_array_set_size (etrack->offsets, etrack->position);
-      g_array_insert_val (etrack->offsets, etrack->position, index);
-    }
-  }
+  gst_mxf_demux_track_index_add (etrack, etrack->position,
+      demux->offset - demux->run_in, keyframe);
 
   if (peek)
     goto out;
@@ -1895,39 +2268,6 @@ out:
   return ret;
 }
 
-static void
-read_partition_header (GstMXFDemux * demux, guint64 offset)
-{
-  GstBuffer *buf;
-  MXFUL key;
-  guint read;
-
-  if (gst_mxf_demux_pull_klv_packet (demux, offset, &key, &buf, &read)
-      != GST_FLOW_OK)
-    return;
-  offset += read;
-
-  if (!mxf_is_partition_pack (&key)) {
-    gst_buffer_unref (buf);
-    return;
-  }
-
-  do {
-    gst_buffer_unref (buf);
-    if (gst_mxf_demux_pull_klv_packet (demux, offset, &key, &buf, &read)
-        != GST_FLOW_OK)
-      return;
-    offset += read;
-  }
-  while (mxf_is_fill (&key));
-
-  if (mxf_is_index_table_segment (&key)) {
-    gst_mxf_demux_handle_index_table_segment (demux, &key, buf, offset);
-  }
-
-  gst_buffer_unref (buf);
-}
-
 static GstFlowReturn
 gst_mxf_demux_handle_random_index_pack (GstMXFDemux * demux, const MXFUL * key,
     GstBuffer * buffer)
@@ -2009,9 +2349,15 @@ compare_index_table_segments (gconstpointer comparee, gconstpointer compared)
   comparee_segment = (MXFIndexTableSegment *) comparee;
   compared_segment = (MXFIndexTableSegment *) compared;
 
-  /* FIXME : is that the correct comparison ? */
-  return comparee_segment->index_start_position -
-      compared_segment->index_start_position;
+  if (comparee_segment->index_sid != compared_segment->index_sid)
+    return comparee_segment->index_sid < compared_segment->index_sid ? -1 : 1;
+  if (comparee_segment->body_sid != compared_segment->body_sid)
+    return comparee_segment->body_sid < compared_segment->body_sid ? -1 : 1;
+  if (comparee_segment->index_start_position !=
+      compared_segment->index_start_position)
+    return comparee_segment->index_start_position <
+        compared_segment->index_start_position ? -1 : 1;
+  return 0;
 }
 
 static GstFlowReturn
@@ -2051,6 +2397,7 @@ gst_mxf_demux_handle_index_table_segment (GstMXFDemux * demux,
   if (l == NULL) {
     demux->pending_index_table_segments =
         g_list_prepend (demux->pending_index_table_segments, segment);
+    demux->index_tables_dirty = TRUE;
   } else {
     mxf_index_table_segment_reset (segment);
     g_free (segment);
@@ -2059,14 +2406,13 @@ gst_mxf_demux_handle_index_table_segment (GstMXFDemux * demux,
   return GST_FLOW_OK;
 }
 
+/* Pulls the key and length of the KLV packet at @offset */
 static GstFlowReturn
-gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
-    GstBuffer ** outbuf, guint * read)
+gst_mxf_demux_pull_klv_header (GstMXFDemux * demux, guint64 offset,
+    MXFUL * key, guint * data_offset, guint64 * length)
 {
   GstBuffer *buffer = NULL;
   const guint8 *data;
-  guint64 data_offset = 0;
-  guint64 length;
   GstFlowReturn ret = GST_FLOW_OK;
   GstMapInfo map;
 #ifndef GST_DISABLE_GST_DEBUG
@@ -2089,12 +2435,12 @@ gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
 
   /* Decode BER encoded packet length */
   if ((map.data[16] & 0x80) == 0) {
-    length = map.data[16];
-    data_offset = 17;
+    *length = map.data[16];
+    *data_offset = 17;
   } else {
     guint slen = map.data[16] & 0x7f;
 
-    data_offset = 16 + 1 + slen;
+    *data_offset = 16 + 1 + slen;
 
     gst_buffer_unmap (buffer, &map);
     gst_buffer_unref (buffer);
@@ -2115,47 +2461,364 @@ gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
     gst_buffer_map (buffer, &map, GST_MAP_READ);
 
     data = map.data;
-    length = 0;
+    *length = 0;
     while (slen) {
-      length = (length << 8) | *data;
+      *length = (*length << 8) | *data;
       data++;
       slen--;
     }
   }
 
   gst_buffer_unmap (buffer, &map);
-  gst_buffer_unref (buffer);
-  buffer = NULL;
+
+  GST_DEBUG_OBJECT (demux, "KLV packet with key %s has length "
+      "%" G_GUINT64_FORMAT, mxf_ul_to_string (key, str), *length);
+
+beach:
+  if (buffer)
+    gst_buffer_unref (buffer);
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_mxf_demux_pull_klv_packet (GstMXFDemux * demux, guint64 offset, MXFUL * key,
+    GstBuffer ** outbuf, guint * read)
+{
+  GstBuffer *buffer = NULL;
+  guint data_offset = 0;
+  guint64 length;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  if ((ret = gst_mxf_demux_pull_klv_header (demux, offset, key, &data_offset,
+              &length)) != GST_FLOW_OK)
+    return ret;
 
   /* GStreamer's buffer sizes are stored in a guint so we
    * limit ourself to G_MAXUINT large buffers */
   if (length > G_MAXUINT) {
     GST_ERROR_OBJECT (demux,
         "Unsupported KLV packet length: %" G_GUINT64_FORMAT, length);
-    ret = GST_FLOW_ERROR;
-    goto beach;
+    return GST_FLOW_ERROR;
   }
 
-  GST_DEBUG_OBJECT (demux, "KLV packet with key %s has length "
-      "%" G_GUINT64_FORMAT, mxf_ul_to_string (key, str), length);
-
   /* Pull the complete KLV packet */
   if ((ret = gst_mxf_demux_pull_range (demux, offset + data_offset, length,
               &buffer)) != GST_FLOW_OK)
-    goto beach;
+    return ret;
 
   *outbuf = buffer;
-  buffer = NULL;
   if (read)
     *read = data_offset + length;
 
-beach:
-  if (buffer)
-    gst_buffer_unref (buffer);
+  return ret;
+}
+
+/* Skips fill packets starting at @offset and returns the key and offset of
+ * the next packet */
+static GstFlowReturn
+gst_mxf_demux_skip_fill (GstMXFDemux * demux, guint64 * offset, MXFUL * key)
+{
+  GstFlowReturn ret;
+  guint data_offset;
+  guint64 length;
+
+  while ((ret = gst_mxf_demux_pull_klv_header (demux, *offset, key,
+              &data_offset, &length)) == GST_FLOW_OK && mxf_is_fill (key))
+    *offset += data_offset + length;
 
   return ret;
 }
 
+/* Registers the partition at @offset, handles its index table segments and
+ * remembers where its essence starts. Returns the partition's
+ * PreviousPartition in @prev_partition as the partition list overrides it */
+static GstMXFDemuxPartition *
+read_partition_header (GstMXFDemux * demux, guint64 offset,
+    guint64 * prev_partition)
+{
+  GstBuffer *buf;
+  MXFUL key;
+  guint read;
+  guint64 old_offset = demux->offset;
+  GstMXFDemuxPartition *old_partition = demux->current_partition;
+  GstMXFDemuxPartition *p = NULL;
+  MXFPartitionPack pack;
+  GstMapInfo map;
+  guint64 index_end;
+  gboolean ret;
+
+  if (gst_mxf_demux_pull_klv_packet (demux, offset, &key, &buf, &read)
+      != GST_FLOW_OK)
+    return NULL;
+
+  if (!mxf_is_partition_pack (&key)) {
+    gst_buffer_unref (buf);
+    return NULL;
+  }
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  ret = mxf_partition_pack_parse (&key, &pack, map.data, map.size);
+  gst_buffer_unmap (buf, &map);
+  if (!ret) {
+    gst_buffer_unref (buf);
+    return NULL;
+  }
+  if (prev_partition)
+    *prev_partition = pack.prev_partition;
+  mxf_partition_pack_reset (&pack);
+
+  demux->offset = offset;
+  if (gst_mxf_demux_handle_partition_pack (demux, &key, buf) != GST_FLOW_OK) {
+    gst_buffer_unref (buf);
+    goto out;
+  }
+  gst_buffer_unref (buf);
+  p = demux->current_partition;
+  offset += read;
+
+  if (gst_mxf_demux_skip_fill (demux, &offset, &key) != GST_FLOW_OK)
+    goto out;
+
+  /* The header metadata starts with the primer pack */
+  if (p->partition.header_byte_count > 0) {
+    offset += p->partition.header_byte_count;
+    if (gst_mxf_demux_skip_fill (demux, &offset, &key) != GST_FLOW_OK)
+      goto out;
+  }
+
+  /* Some writers don't set IndexByteCount, so also continue as long as
+   * there are index table segments */
+  index_end = offset + p->partition.index_byte_count;
+  while (offset < index_end || mxf_is_index_table_segment (&key)) {
+    if (gst_mxf_demux_pull_klv_packet (demux, offset, &key, &buf, &read)
+        != GST_FLOW_OK)
+      goto out;
+
+    if (mxf_is_index_table_segment (&key))
+      gst_mxf_demux_handle_index_table_segment (demux, &key, buf, offset);
+
+    gst_buffer_unref (buf);
+    offset += read;
+
+    if (gst_mxf_demux_skip_fill (demux, &offset, &key) != GST_FLOW_OK)
+      goto out;
+  }
+
+  if (p->partition.body_sid == 0 || p->essence_container_offset != 0)
+    goto out;
+
+  if (mxf_is_generic_container_system_item (&key) ||
+      mxf_is_generic_container_essence_element (&key) ||
+      mxf_is_avid_essence_container_essence_element (&key)) {
+    p->essence_container_offset =
+        offset - demux->run_in - p->partition.this_partition;
+    GST_DEBUG_OBJECT (demux, "Essence of partition at %" G_GUINT64_FORMAT
+        " starts at %" G_GUINT64_FORMAT, p->partition.this_partition, offset);
+  }
+
+out:
+  demux->offset = old_offset;
+  demux->current_partition = old_partition;
+
+  return p;
+}
+
+static gint
+compare_index_table_segment_ptrs (gconstpointer a, gconstpointer b)
+{
+  const MXFIndexTableSegment *sa = *(const MXFIndexTableSegment **) a;
+  const MXFIndexTableSegment *sb = *(const MXFIndexTableSegment **) b;
+
+  return compare_index_table_segments (sa, sb);
+}
+
+static gint
+compare_partitions_body_offset (gconstpointer a, gconstpointer b)
+{
+  const GstMXFDemuxPartition *pa = *(const GstMXFDemuxPartition **) a;
+  const GstMXFDemuxPartition *pb = *(const GstMXFDemuxPartition **) b;
+
+  if (pa->partition.body_offset != pb->partition.body_offset)
+    return pa->partition.body_offset < pb->partition.body_offset ? -1 : 1;
+  if (pa->partition.this_partition != pb->partition.this_partition)
+    return pa->partition.this_partition < pb->partition.this_partition ?
+        -1 : 1;
+  return 0;
+}
+
+static GstMXFDemuxIndexTable *
+gst_mxf_demux_get_index_table (GstMXFDemux * demux, guint32 body_sid,
+    guint32 index_sid, gboolean create)
+{
+  GstMXFDemuxIndexTable *t;
+  guint i;
+
+  for (i = 0; i < demux->index_tables->len; i++) {
+    t = &g_array_index (demux->index_tables, GstMXFDemuxIndexTable, i);
+
+    if (t->body_sid == body_sid && (index_sid == 0
+            || t->index_sid == index_sid))
+      return t;
+  }
+
+  if (!create)
+    return NULL;
+
+  g_array_set_size (demux->index_tables, demux->index_tables->len + 1);
+  t = &g_array_index (demux->index_tables, GstMXFDemuxIndexTable,
+      demux->index_tables->len - 1);
+  t->body_sid = body_sid;
+  t->index_sid = index_sid;
+  t->ranges = g_array_new (FALSE, FALSE, sizeof (GstMXFDemuxIndexRange));
+  t->entries = g_array_new (FALSE, FALSE, sizeof (GstMXFDemuxIndexEntry));
+  t->partitions = g_ptr_array_new ();
+
+  return t;
+}
+
+/* Merges all index table segments found so far into one sorted table per
+ * essence container. Segments repeated in several partitions are only
+ * used once */
+static void
+gst_mxf_demux_build_index_tables (GstMXFDemux * demux)
+{
+  GPtrArray *segments;
+  GList *l;
+  guint i, j;
+
+  if (!demux->index_tables_dirty)
+    return;
+
+  gst_mxf_demux_clear_index_tables (demux);
+  demux->index_tables_dirty = FALSE;
+
+  segments = g_ptr_array_new ();
+  for (l = demux->pending_index_table_segments; l; l = l->next)
+    g_ptr_array_add (segments, l->data);
+  g_ptr_array_sort (segments, compare_index_table_segment_ptrs);
+
+  for (i = 0; i < segments->len; i++) {
+    MXFIndexTableSegment *segment = g_ptr_array_index (segments, i);
+    GstMXFDemuxIndexTable *t;
+    GstMXFDemuxIndexRange range;
+    gint64 end = 0;
+    guint skip = 0;
+
+    if (segment->body_sid == 0)
+      continue;
+
+    t = gst_mxf_demux_get_index_table (demux, segment->body_sid,
+        segment->index_sid, TRUE);
+
+    range.start = segment->index_start_position;
+    range.edit_unit_byte_count = segment->edit_unit_byte_count;
+    range.first_entry = t->entries->len;
+    if (range.edit_unit_byte_count != 0) {
+      /* a CBR segment without duration covers the rest of the stream */
+      range.duration = segment->index_duration > 0 ?
+          segment->index_duration : G_MAXINT64 - range.start;
+    } else {
+      range.duration = segment->n_index_entries;
+    }
+
+    if (t->ranges->len > 0) {
+      GstMXFDemuxIndexRange *last = &g_array_index (t->ranges,
+          GstMXFDemuxIndexRange, t->ranges->len - 1);
+
+      end = last->start + last->duration;
+    }
+
+    /* drop what the previous segments already cover */
+    if (range.start < end) {
+      if (range.start + range.duration <= end)
+        continue;
+      skip = end - range.start;
+      range.start += skip;
+      range.duration -= skip;
+    }
+
+    if (range.duration <= 0)
+      continue;
+
+    if (range.edit_unit_byte_count == 0) {
+      for (j = skip; j < segment->n_index_entries; j++) {
+        const MXFIndexEntry *e = &segment->index_entries[j];
+        GstMXFDemuxIndexEntry entry;
+
+        entry.stream_offset = e->stream_offset;
+        entry.key_frame_offset = e->key_frame_offset;
+        entry.flags = e->flags;
+        g_array_append_val (t->entries, entry);
+      }
+    }
+
+    g_array_append_val (t->ranges, range);
+  }
+
+  g_ptr_array_free (segments, TRUE);
+
+  /* partitions to translate stream offsets into file offsets */
+  for (l = demux->partitions; l; l = l->next) {
+    GstMXFDemuxPartition *p = l->data;
+    GstMXFDemuxIndexTable *t;
+
+    if (p->partition.body_sid == 0)
+      continue;
+
+    t = gst_mxf_demux_get_index_table (demux, p->partition.body_sid, 0, FALSE);
+    if (t)
+      g_ptr_array_add (t->partitions, p);
+  }
+
+  for (i = 0; i < demux->index_tables->len; i++) {
+    GstMXFDemuxIndexTable *t =
+        &g_array_index (demux->index_tables, GstMXFDemuxIndexTable, i);
+
+    g_ptr_array_sort (t->partitions, compare_partitions_body_offset);
+
+    GST_DEBUG_OBJECT (demux, "Index table for body SID %u index SID %u: "
+        "%u ranges, %u entries, %u partitions", t->body_sid, t->index_sid,
+        t->ranges->len, t->entries->len, t->partitions->len);
+  }
+}
+
+static void
+collect_index_table_segments (GstMXFDemux * demux)
+{
+  guint i;
+
+  if (demux->random_index_pack) {
+    for (i = 0; i < demux->random_index_pack->len; i++) {
+      MXFRandomIndexPackEntry *e =
+          &g_array_index (demux->random_index_pack, MXFRandomIndexPackEntry,
+          i);
+
+      if (e->offset < demux->run_in) {
+        GST_ERROR_OBJECT (demux, "Invalid random index pack entry");
+        return;
+      }
+
+      read_partition_header (demux, e->offset, NULL);
+    }
+  } else if (demux->footer_partition_pack_offset != 0) {
+    guint64 offset = demux->footer_partition_pack_offset;
+
+    /* Walk back from the footer to the header partition */
+    while (TRUE) {
+      GstMXFDemuxPartition *p;
+      guint64 prev = 0;
+
+      p = read_partition_header (demux, demux->run_in + offset, &prev);
+      if (!p || offset == 0 || prev >= offset)
+        break;
+      offset = prev;
+    }
+  }
+
+  gst_mxf_demux_build_index_tables (demux);
+}
+
 static void
 gst_mxf_demux_pull_random_index_pack (GstMXFDemux * demux)
 {
@@ -2414,6 +3077,10 @@ gst_mxf_demux_handle_klv_packet (GstMXFDemux * demux, const MXFUL * key,
       goto beach;
     }
   } else if (demux->metadata_resolved && demux->requested_package_string) {
+    /* With lazy metadata the requested package might not be parsed yet */
+    if (demux->lazy_metadata
+        && (ret = gst_mxf_demux_resolve_references (demux)) != GST_FLOW_OK)
+      goto beach;
     if ((ret = gst_mxf_demux_update_tracks (demux)) != GST_FLOW_OK) {
       goto beach;
     }
@@ -2523,29 +3190,100 @@ gst_mxf_demux_set_partition_for_offset (GstMXFDemux * demux, guint64 offset)
   }
 }
 
+/* Looks up the offset of edit unit @position of @etrack in the index
+ * tables. With @keyframe @position is moved back to the closest keyframe.
+ * Returns -1 if the edit unit is not indexed */
 static guint64
-get_offset_from_index_table_segments (GstMXFDemux * demux, gint64 position,
-    gint64 * index_start_position)
+gst_mxf_demux_find_offset_in_index_tables (GstMXFDemux * demux,
+    GstMXFDemuxEssenceTrack * etrack, gint64 * position, gboolean keyframe)
 {
-  GList *l;
-  gint64 start, end;
-  gboolean return_offset = FALSE;
+  GstMXFDemuxIndexTable *t;
+  GstMXFDemuxPartition *p = NULL;
+  guint64 stream_offset;
+  gint64 pos = *position;
+  gint lo, hi;
+
+  gst_mxf_demux_build_index_tables (demux);
+
+  t = gst_mxf_demux_get_index_table (demux, etrack->body_sid, 0, FALSE);
+  if (!t || t->ranges->len == 0)
+    return -1;
+
+  while (TRUE) {
+    const GstMXFDemuxIndexRange *r = NULL;
+    const GstMXFDemuxIndexEntry *e;
+
+    lo = 0;
+    hi = t->ranges->len - 1;
+    while (lo <= hi) {
+      gint mid = lo + (hi - lo) / 2;
+      const GstMXFDemuxIndexRange *tmp =
+          &g_array_index (t->ranges, GstMXFDemuxIndexRange, mid);
+
+      if (pos < tmp->start) {
+        hi = mid - 1;
+      } else if (pos - tmp->start >= tmp->duration) {
+        lo = mid + 1;
+      } else {
+        r = tmp;
+        break;
+      }
+    }
 
-  for (l = demux->pending_index_table_segments; l != NULL; l = l->next) {
-    MXFIndexTableSegment *segment = (MXFIndexTableSegment *) l->data;
-    start = segment->index_start_position;
-    end = start + segment->index_duration;
+    if (!r)
+      return -1;
 
-    if (return_offset)
-      return segment->stream_offset;
+    /* every edit unit of constant size essence is a keyframe */
+    if (r->edit_unit_byte_count != 0) {
+      stream_offset = pos * r->edit_unit_byte_count;
+      break;
+    }
 
-    if (start <= position && position < end) {
-      *index_start_position = segment->index_start_position;
-      return_offset = TRUE;
+    e = &g_array_index (t->entries, GstMXFDemuxIndexEntry,
+        r->first_entry + (pos - r->start));
+    if (!keyframe || (e->flags & GST_MXF_DEMUX_INDEX_ENTRY_RANDOM_ACCESS)
+        || e->key_frame_offset >= 0) {
+      stream_offset = e->stream_offset;
+      break;
     }
+
+    pos += e->key_frame_offset;
+    if (pos < 0)
+      return -1;
   }
 
-  return 0;
+  /* Find the partition containing this part of the essence container */
+  lo = 0;
+  hi = t->partitions->len - 1;
+  while (lo <= hi) {
+    gint mid = lo + (hi - lo) / 2;
+    GstMXFDemuxPartition *tmp = g_ptr_array_index (t->partitions, mid);
+
+    if (tmp->partition.body_offset <= stream_offset) {
+      p = tmp;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  if (!p)
+    return -1;
+
+  if (p->essence_container_offset == 0 && demux->random_access)
+    read_partition_header (demux, demux->run_in + p->partition.this_partition,
+        NULL);
+
+  if (p->essence_container_offset == 0)
+    return -1;
+
+  GST_DEBUG_OBJECT (demux, "Edit unit %" G_GINT64_FORMAT " is at stream "
+      "offset %" G_GUINT64_FORMAT " in partition %" G_GUINT64_FORMAT, pos,
+      stream_offset, p->partition.this_partition);
+
+  *position = pos;
+  return p->partition.this_partition + p->essence_container_offset +
+      (stream_offset - p->partition.body_offset);
 }
 
 static guint64
@@ -2555,6 +3293,7 @@ gst_mxf_demux_find_essence_element (GstMXFDemux * demux,
   GstFlowReturn ret = GST_FLOW_OK;
   guint64 old_offset = demux->offset;
   GstMXFDemuxPartition *old_partition = demux->current_partition;
+  GstMXFDemuxIndex *idx;
   gint i;
 
   GST_DEBUG_OBJECT (demux, "Trying to find essence element %" G_GINT64_FORMAT
@@ -2569,24 +3308,24 @@ from_index:
   }
 
   /* First try to find an offset in our index */
-  if (etrack->offsets && etrack->offsets->len > *position) {
-    GstMXFDemuxIndex *idx =
-        &g_array_index (etrack->offsets, GstMXFDemuxIndex, *position);
+  idx = gst_mxf_demux_track_index_find (etrack, *position);
+  if (idx) {
     guint64 current_offset = -1;
     gint64 current_position = *position;
 
-    if (idx->offset != 0 && (!keyframe || idx->keyframe)) {
+    if (!keyframe || idx->keyframe) {
       current_offset = idx->offset;
-    } else if (idx->offset != 0) {
+    } else {
+      /* Go back over consecutive entries to the previous keyframe */
+      i = gst_mxf_demux_track_index_search (etrack, *position) - 1;
       current_position--;
-      while (current_position >= 0) {
-        idx =
-            &g_array_index (etrack->offsets, GstMXFDemuxIndex,
-            current_position);
-        if (idx->offset == 0) {
+      while (i >= 0) {
+        idx = &g_array_index (etrack->offsets, GstMXFDemuxIndex, i);
+        if (idx->position != current_position) {
           break;
         } else if (!idx->keyframe) {
           current_position--;
+          i--;
           continue;
         } else {
           current_offset = idx->offset;
@@ -2608,16 +3347,14 @@ from_index:
     guint64 new_offset = -1;
     gint64 new_position = -1;
 
-    if (etrack->offsets && etrack->offsets->len) {
-      for (i = etrack->offsets->len - 1; i >= 0; i--) {
-        GstMXFDemuxIndex *idx =
-            &g_array_index (etrack->offsets, GstMXFDemuxIndex, i);
+    i = gst_mxf_demux_track_index_search (etrack, *position);
+    for (; i >= 0; i--) {
+      idx = &g_array_index (etrack->offsets, GstMXFDemuxIndex, i);
 
-        if (idx->offset != 0 && i <= *position && (!keyframe || idx->keyframe)) {
-          new_offset = idx->offset;
-          new_position = i;
-          break;
-        }
+      if (!keyframe || idx->keyframe) {
+        new_offset = idx->offset;
+        new_position = idx->position;
+        break;
       }
     }
 
@@ -2626,27 +3363,36 @@ from_index:
       return new_offset;
     }
   } else if (demux->random_access) {
-    gint64 index_start_position = -1;
+    gint64 start_position = -1;
+    gint64 index_position = *position;
     guint64 offset;
 
+    if (!demux->index_table_segments_collected) {
+      collect_index_table_segments (demux);
+      demux->index_table_segments_collected = TRUE;
+    }
+
+    /* Start scanning from the closest known element before the requested
+     * one, either from our own index or the file's index tables */
     demux->offset = demux->run_in;
-    if (etrack->offsets && etrack->offsets->len) {
-      for (i = etrack->offsets->len - 1; i >= 0; i--) {
-        GstMXFDemuxIndex *idx =
-            &g_array_index (etrack->offsets, GstMXFDemuxIndex, i);
+    i = gst_mxf_demux_track_index_search (etrack, *position);
+    for (; i >= 0; i--) {
+      idx = &g_array_index (etrack->offsets, GstMXFDemuxIndex, i);
 
-        if (idx->offset != 0 && i <= *position) {
-          demux->offset = idx->offset + demux->run_in;
-          break;
-        }
+      if (!keyframe || idx->keyframe) {
+        demux->offset = idx->offset + demux->run_in;
+        start_position = idx->position;
+        break;
       }
     }
 
     offset =
-        get_offset_from_index_table_segments (demux, *position,
-        &index_start_position);
-
-    demux->offset = offset;
+        gst_mxf_demux_find_offset_in_index_tables (demux, etrack,
+        &index_position, keyframe);
+    if (offset != -1 && index_position > start_position) {
+      demux->offset = offset + demux->run_in;
+      start_position = index_position;
+    }
 
     gst_mxf_demux_set_partition_for_offset (demux, demux->offset);
 
@@ -2654,8 +3400,8 @@ from_index:
       GstMXFDemuxEssenceTrack *t =
           &g_array_index (demux->essence_tracks, GstMXFDemuxEssenceTrack, i);
 
-      if (index_start_position != -1)
-        t->position = index_start_position;
+      if (start_position != -1 && t->body_sid == etrack->body_sid)
+        t->position = start_position;
       else
         t->position = (demux->offset == demux->run_in) ? 0 : -1;
     }
@@ -2712,9 +3458,7 @@ from_index:
       /* If we found the position read it from the index again */
       if (((ret == GST_FLOW_OK && etrack->position == *position + 2) ||
               (ret == GST_FLOW_EOS && etrack->position == *position + 1))
-          && etrack->offsets && etrack->offsets->len > *position
-          && g_array_index (etrack->offsets, GstMXFDemuxIndex,
-              *position).offset != 0) {
+          && gst_mxf_demux_track_index_find (etrack, *position)) {
         GST_DEBUG_OBJECT (demux, "Found at offset %" G_GUINT64_FORMAT,
             demux->offset);
         demux->offset = old_offset;
@@ -2914,6 +3658,12 @@ gst_mxf_demux_loop (GstPad * pad)
 
     /* First of all pull&parse the random index pack at EOF */
     gst_mxf_demux_pull_random_index_pack (demux);
+
+    /* and build the index from the partitions it lists */
+    if (demux->random_index_pack) {
+      collect_index_table_segments (demux);
+      demux->index_table_segments_collected = TRUE;
+    }
   }
 
   /* Now actually do something */
@@ -3397,40 +4147,6 @@ no_new_offset:
   }
 }
 
-static void
-collect_index_table_segments (GstMXFDemux * demux)
-{
-  guint i;
-  GList *l;
-
-  if (!demux->random_index_pack)
-    return;
-
-  for (i = 0; i < demux->random_index_pack->len; i++) {
-    GstMXFDemuxPartition *p = NULL;
-    MXFRandomIndexPackEntry *e =
-        &g_array_index (demux->random_index_pack, MXFRandomIndexPackEntry, i);
-
-    if (e->offset < demux->run_in) {
-      GST_ERROR_OBJECT (demux, "Invalid random index pack entry");
-      return;
-    }
-
-    for (l = demux->partitions; l; l = l->next) {
-      GstMXFDemuxPartition *tmp = l->data;
-
-      if (tmp->partition.this_partition + demux->run_in == e->offset) {
-        p = tmp;
-        break;
-      }
-    }
-
-    if (p) {
-      read_partition_header (demux, p->partition.this_partition);
-    }
-  }
-}
-
 static gboolean
 gst_mxf_demux_seek_pull (GstMXFDemux * demux, GstEvent * event)
 {
@@ -4159,6 +4875,9 @@ gst_mxf_demux_set_property (GObject * object, guint prop_id,
     case PROP_MAX_DRIFT:
       demux->max_drift = g_value_get_uint64 (value);
       break;
+    case PROP_LAZY_METADATA:
+      demux->lazy_metadata = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -4195,6 +4914,9 @@ gst_mxf_demux_get_property (GObject * object, guint prop_id,
       g_rw_lock_reader_unlock (&demux->metadata_lock);
       break;
     }
+    case PROP_LAZY_METADATA:
+      g_value_set_boolean (value, demux->lazy_metadata);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -4232,8 +4954,11 @@ gst_mxf_demux_finalize (GObject * object)
   demux->src = NULL;
   g_array_free (demux->essence_tracks, TRUE);
   demux->essence_tracks = NULL;
+  g_array_free (demux->index_tables, TRUE);
+  demux->index_tables = NULL;
 
   g_hash_table_destroy (demux->metadata);
+  g_hash_table_destroy (demux->metadata_sets);
 
   g_rw_lock_clear (&demux->metadata_lock);
 
@@ -4270,6 +4995,12 @@ gst_mxf_demux_class_init (GstMXFDemuxClass * klass)
           "Structural metadata of the MXF file",
           GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_LAZY_METADATA,
+      g_param_spec_boolean ("lazy-metadata", "Lazy metadata",
+          "Only parse the header metadata needed for playback of the "
+          "selected package",
+          DEFAULT_LAZY_METADATA, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gstelement_class->change_state =
       GST_DEBUG_FUNCPTR (gst_mxf_demux_change_state);
   gstelement_class->query = GST_DEBUG_FUNCPTR (gst_mxf_demux_query);
@@ -4301,6 +5032,7 @@ gst_mxf_demux_init (GstMXFDemux * demux)
   gst_element_add_pad (GST_ELEMENT (demux), demux->sinkpad);
 
   demux->max_drift = 500 * GST_MSECOND;
+  demux->lazy_metadata = DEFAULT_LAZY_METADATA;
 
   demux->adapter = gst_adapter_new ();
   demux->flowcombiner = gst_flow_combiner_new ();
@@ -4309,6 +5041,11 @@ gst_mxf_demux_init (GstMXFDemux * demux)
   demux->src = g_ptr_array_new ();
   demux->essence_tracks =
       g_array_new (FALSE, FALSE, sizeof (GstMXFDemuxEssenceTrack));
+  demux->index_tables =
+      g_array_new (FALSE, FALSE, sizeof (GstMXFDemuxIndexTable));
+  demux->metadata_sets = g_hash_table_new_full ((GHashFunc) mxf_uuid_hash,
+      (GEqualFunc) mxf_uuid_is_equal, NULL,
+      (GDestroyNotify) gst_mxf_demux_metadata_set_free);
 
   gst_segment_init (&demux->segment, GST_FORMAT_TIME);
 
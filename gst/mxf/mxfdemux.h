@@ -56,12 +56,67 @@ typedef struct
   guint64 essence_container_offset;
 } GstMXFDemuxPartition;
 
+/* Offset of an essence element seen during playback, kept sorted by
+ * position in GstMXFDemuxEssenceTrack::offsets */
 typedef struct
 {
+  gint64 position;
   guint64 offset;
   gboolean keyframe;
 } GstMXFDemuxIndex;
 
+/* SMPTE 377M 10.2.3 */
+#define GST_MXF_DEMUX_INDEX_ENTRY_RANDOM_ACCESS 0x80
+
+typedef struct
+{
+  guint64 stream_offset;
+  gint8 key_frame_offset;
+  guint8 flags;
+} GstMXFDemuxIndexEntry;
+
+/* Contiguous edit units described by one index table segment */
+typedef struct
+{
+  gint64 start;
+  gint64 duration;
+  /* constant bytes per edit unit, or 0 if the entries are used */
+  guint32 edit_unit_byte_count;
+  guint first_entry;
+} GstMXFDemuxIndexRange;
+
+/* Merged index table segments of one essence container */
+typedef struct
+{
+  guint32 body_sid;
+  guint32 index_sid;
+
+  /* sorted by start, not overlapping */
+  GArray *ranges;
+  GArray *entries;
+
+  /* partitions containing this essence container, sorted by body offset */
+  GPtrArray *partitions;
+} GstMXFDemuxIndexTable;
+
+/* Header metadata set that is only parsed once it is needed */
+typedef struct
+{
+  MXFUUID instance_uid;
+  guint16 type;
+  guint64 offset;
+  GstBuffer *buffer;
+  MXFPrimerPack *primer;
+
+  /* only set for packages */
+  MXFUMID package_uid;
+
+  /* descriptive metadata sets have a scheme and a type of their own */
+  gboolean descriptive;
+  guint8 dm_scheme;
+  guint32 dm_type;
+} GstMXFDemuxMetadataSet;
+
 typedef struct
 {
   guint32 body_sid;
@@ -157,6 +212,11 @@ struct _GstMXFDemux
 
   gboolean index_table_segments_collected;
 
+  /* built from pending_index_table_segments, rebuilt when new segments
+   * or partitions are found */
+  GArray *index_tables;
+  gboolean index_tables_dirty;
+
   GArray *random_index_pack;
 
   /* Metadata */
@@ -167,6 +227,8 @@ struct _GstMXFDemux
   gboolean metadata_resolved;
   MXFMetadataPreface *preface;
   GHashTable *metadata;
+  /* lazy-metadata: unparsed sets by InstanceUID */
+  GHashTable *metadata_sets;
 
   MXFUMID current_package_uid;
   MXFMetadataGenericPackage *current_package;
@@ -177,6 +239,7 @@ struct _GstMXFDemux
   /* Properties */
   gchar *requested_package_string;
   GstClockTime max_drift;
+  gboolean lazy_metadata;
 };
 
 struct _GstMXFDemuxClass
@@ -1371,7 +1371,7 @@ mxf_metadata_content_storage_resolve (MXFMetadataBase * m,
             mxf_uuid_to_string (&self->packages_uids[i], str));
       }
     } else {
-      GST_ERROR ("Package %s not found",
+      GST_DEBUG ("Package %s not found",
           mxf_uuid_to_string (&self->packages_uids[i], str));
     }
   }
@@ -1718,7 +1718,7 @@ mxf_metadata_essence_container_data_write_tags (MXFMetadataBase * m,
     t->data = g_slice_alloc (4);
     t->g_slice = TRUE;
     GST_WRITE_UINT32_BE (t->data, self->index_sid);
-    mxf_primer_pack_add_mapping (primer, 0x3f07, &t->ul);
+    mxf_primer_pack_add_mapping (primer, 0x3f06, &t->ul);
     ret = g_list_prepend (ret, t);
   }
 
@@ -149,6 +149,9 @@ gst_mxf_mux_init (GstMXFMux * mux)
   gst_collect_pads_set_function (mux->collect,
       GST_DEBUG_FUNCPTR (gst_mxf_mux_collected), mux);
 
+  mux->index_entries = g_array_new (FALSE, FALSE, sizeof (GstMXFMuxIndexEntry));
+  mux->index_deltas = g_array_new (FALSE, FALSE, sizeof (guint32));
+
   gst_mxf_mux_reset (mux);
 }
 
@@ -168,6 +171,9 @@ gst_mxf_mux_finalize (GObject * object)
 
   gst_object_unref (mux->collect);
 
+  g_array_free (mux->index_entries, TRUE);
+  g_array_free (mux->index_deltas, TRUE);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -228,6 +234,11 @@ gst_mxf_mux_reset (GstMXFMux * mux)
   mux->last_gc_timestamp = 0;
   mux->last_gc_position = 0;
   mux->offset = 0;
+
+  mux->essence_start = 0;
+  g_array_set_size (mux->index_entries, 0);
+  g_array_set_size (mux->index_deltas, 0);
+  mux->index_deltas_valid = TRUE;
 }
 
 static gboolean
@@ -1100,6 +1111,143 @@ static const guint8 _gc_essence_element_ul[] = {
   0x0d, 0x01, 0x03, 0x01, 0x00, 0x00, 0x00, 0x00
 };
 
+/* Records an element of the content package at the current generic
+ * container position that is about to be written at mux->offset */
+static void
+gst_mxf_mux_add_index_element (GstMXFMux * mux, gboolean keyframe)
+{
+  guint64 stream_offset = mux->offset - mux->essence_start;
+  GstMXFMuxIndexEntry *entry;
+  guint32 delta;
+
+  /* Content packages without any element start where the next one starts */
+  while (mux->index_entries->len <= mux->last_gc_position) {
+    GstMXFMuxIndexEntry new_entry = { stream_offset, 0, TRUE };
+
+    g_array_append_val (mux->index_entries, new_entry);
+  }
+
+  entry = &g_array_index (mux->index_entries, GstMXFMuxIndexEntry,
+      mux->last_gc_position);
+  if (!keyframe)
+    entry->keyframe = FALSE;
+
+  delta = stream_offset - entry->stream_offset;
+  if (mux->last_gc_position == 0) {
+    g_array_append_val (mux->index_deltas, delta);
+  } else if (entry->n_elements >= mux->index_deltas->len
+      || g_array_index (mux->index_deltas, guint32,
+          entry->n_elements) != delta) {
+    mux->index_deltas_valid = FALSE;
+  }
+  entry->n_elements++;
+}
+
+/* Creates the index table segments for all content packages written to the
+ * body partition. If all of them have the same size a single constant
+ * size segment is used */
+static GList *
+gst_mxf_mux_create_index_table_segments (GstMXFMux * mux,
+    guint64 essence_end, guint32 index_sid, guint32 body_sid)
+{
+  GstMXFMuxIndexEntry *entries =
+      (GstMXFMuxIndexEntry *) mux->index_entries->data;
+  guint n = mux->index_entries->len;
+  const guint max_entries = (G_MAXUINT16 - 8) / 11;
+  MXFIndexTableSegment segment;
+  MXFDeltaEntry *deltas = NULL;
+  guint n_deltas = 0;
+  GList *buffers = NULL;
+  guint64 edit_unit_size;
+  gboolean cbr;
+  gint64 last_keyframe = -1;
+  guint i, start;
+
+  if (n == 0)
+    return NULL;
+
+  /* CBR if all content packages are random access and have the same size */
+  edit_unit_size = (n > 1 ? entries[1].stream_offset : essence_end) -
+      entries[0].stream_offset;
+  cbr = edit_unit_size > 0 && edit_unit_size <= G_MAXUINT32;
+  for (i = 0; i < n && cbr; i++) {
+    guint64 next = i + 1 < n ? entries[i + 1].stream_offset : essence_end;
+
+    if (!entries[i].keyframe || next - entries[i].stream_offset !=
+        edit_unit_size)
+      cbr = FALSE;
+  }
+
+  for (i = 0; i < n && mux->index_deltas_valid; i++) {
+    if (entries[i].n_elements != mux->index_deltas->len)
+      mux->index_deltas_valid = FALSE;
+  }
+
+  if (mux->index_deltas_valid) {
+    n_deltas = mux->index_deltas->len;
+    deltas = g_new0 (MXFDeltaEntry, n_deltas);
+    for (i = 0; i < n_deltas; i++)
+      deltas[i].element_delta =
+          g_array_index (mux->index_deltas, guint32, i);
+  }
+
+  GST_DEBUG_OBJECT (mux, "Writing %s index for %u content packages with %u "
+      "delta entries", cbr ? "CBR" : "VBR", n, n_deltas);
+
+  memset (&segment, 0, sizeof (segment));
+  memcpy (&segment.index_edit_rate, &mux->min_edit_rate, sizeof (MXFFraction));
+  segment.index_sid = index_sid;
+  segment.body_sid = body_sid;
+  segment.n_delta_entries = n_deltas;
+  segment.delta_entries = deltas;
+
+  if (cbr) {
+    mxf_uuid_init (&segment.instance_id, mux->metadata);
+    segment.index_start_position = 0;
+    segment.index_duration = n;
+    segment.edit_unit_byte_count = edit_unit_size;
+    buffers = g_list_prepend (buffers,
+        mxf_index_table_segment_to_buffer (&segment));
+  } else {
+    segment.index_entries = g_new0 (MXFIndexEntry, MIN (n, max_entries));
+
+    for (start = 0; start < n; start += max_entries) {
+      guint count = MIN (n - start, max_entries);
+
+      mxf_uuid_init (&segment.instance_id, mux->metadata);
+      segment.index_start_position = start;
+      segment.index_duration = count;
+      segment.n_index_entries = count;
+
+      for (i = 0; i < count; i++) {
+        const GstMXFMuxIndexEntry *e = &entries[start + i];
+        MXFIndexEntry *entry = &segment.index_entries[i];
+
+        if (e->keyframe) {
+          last_keyframe = start + i;
+          entry->key_frame_offset = 0;
+          entry->flags = 0x80;
+        } else {
+          entry->key_frame_offset = last_keyframe >= 0 ?
+              MAX (last_keyframe - (gint64) (start + i), -128) : 0;
+          entry->flags = 0x00;
+        }
+        entry->temporal_offset = 0;
+        entry->stream_offset = e->stream_offset;
+      }
+
+      buffers = g_list_prepend (buffers,
+          mxf_index_table_segment_to_buffer (&segment));
+    }
+
+    g_free (segment.index_entries);
+  }
+
+  g_free (deltas);
+
+  return g_list_reverse (buffers);
+}
+
 static GstFlowReturn
 gst_mxf_mux_handle_buffer (GstMXFMux * mux, GstMXFMuxPad * cpad)
 {
@@ -1112,6 +1260,7 @@ gst_mxf_mux_handle_buffer (GstMXFMux * mux, GstMXFMuxPad * cpad)
   guint8 slen, ber[9];
   gboolean flush = ((cpad->collect.state & GST_COLLECT_PADS_STATE_EOS)
       && !cpad->have_complete_edit_unit && cpad->collect.buffer == NULL);
+  gboolean keyframe;
 
   if (cpad->have_complete_edit_unit) {
     GST_DEBUG_OBJECT (cpad->collect.pad,
@@ -1134,6 +1283,8 @@ gst_mxf_mux_handle_buffer (GstMXFMux * mux, GstMXFMuxPad * cpad)
         cpad->source_track->parent.track_id, cpad->pos);
   }
 
+  keyframe = !buf || !GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
   ret = cpad->write_func (buf,
       cpad->mapping_data, cpad->adapter, &outbuf, flush);
   if (ret != GST_FLOW_OK && ret != GST_FLOW_CUSTOM_SUCCESS) {
@@ -1172,6 +1323,8 @@ gst_mxf_mux_handle_buffer (GstMXFMux * mux, GstMXFMuxPad * cpad)
       cpad->source_track->parent.track_id);
   gst_buffer_unmap (packet, &map);
 
+  gst_mxf_mux_add_index_element (mux, keyframe);
+
   if ((ret = gst_mxf_mux_push (mux, packet)) != GST_FLOW_OK) {
     GST_ERROR_OBJECT (cpad->collect.pad,
         "Failed pushing buffer for track %u, reason %s",
@@ -1191,6 +1344,7 @@ static GstFlowReturn
 gst_mxf_mux_write_body_partition (GstMXFMux * mux)
 {
   GstBuffer *buf;
+  GstFlowReturn ret;
 
   mux->partition.type = MXF_PARTITION_PACK_BODY;
   mux->partition.this_partition = mux->offset;
@@ -1204,7 +1358,12 @@ gst_mxf_mux_write_body_partition (GstMXFMux * mux)
       mux->preface->content_storage->essence_container_data[0]->body_sid;
 
   buf = mxf_partition_pack_to_buffer (&mux->partition);
-  return gst_mxf_mux_push (mux, buf);
+  ret = gst_mxf_mux_push (mux, buf);
+
+  /* The essence container starts right after the partition pack */
+  mux->essence_start = mux->offset;
+
+  return ret;
 }
 
 static GstFlowReturn
@@ -1303,11 +1462,24 @@ gst_mxf_mux_handle_eos (GstMXFMux * mux)
     guint64 body_partition = mux->partition.this_partition;
     guint32 body_sid = mux->partition.body_sid;
     guint64 footer_partition = mux->offset;
+    guint32 index_sid = 2;
+    guint64 index_byte_count = 0;
+    GList *index_segments, *l;
     GArray *rip;
     GstFlowReturn ret;
     GstSegment segment;
     MXFRandomIndexPackEntry entry;
 
+    index_segments = gst_mxf_mux_create_index_table_segments (mux,
+        mux->offset - mux->essence_start, index_sid, body_sid);
+    for (l = index_segments; l; l = l->next)
+      index_byte_count += gst_buffer_get_size (l->data);
+
+    /* Only reference the index from the metadata if there is one */
+    if (index_segments)
+      mux->preface->content_storage->essence_container_data[0]->index_sid =
+          index_sid;
+
     mux->partition.type = MXF_PARTITION_PACK_FOOTER;
     mux->partition.closed = TRUE;
     mux->partition.complete = TRUE;
@@ -1315,13 +1487,25 @@ gst_mxf_mux_handle_eos (GstMXFMux * mux)
     mux->partition.prev_partition = body_partition;
     mux->partition.footer_partition = mux->offset;
     mux->partition.header_byte_count = 0;
-    mux->partition.index_byte_count = 0;
-    mux->partition.index_sid = 0;
+    mux->partition.index_byte_count = index_byte_count;
+    mux->partition.index_sid = index_segments ? index_sid : 0;
     mux->partition.body_offset = 0;
     mux->partition.body_sid = 0;
 
     gst_mxf_mux_write_header_metadata (mux);
 
+    for (l = index_segments; l; l = l->next) {
+      GstBuffer *buf = l->data;
+
+      l->data = NULL;
+      if ((ret = gst_mxf_mux_push (mux, buf)) != GST_FLOW_OK) {
+        GST_ERROR_OBJECT (mux, "Failed pushing index table segment");
+        g_list_foreach (l->next, (GFunc) gst_mini_object_unref, NULL);
+        break;
+      }
+    }
+    g_list_free (index_segments);
+
     rip = g_array_sized_new (FALSE, FALSE, sizeof (MXFRandomIndexPackEntry), 3);
     entry.offset = 0;
     entry.body_sid = 0;
@@ -1339,7 +1523,9 @@ gst_mxf_mux_handle_eos (GstMXFMux * mux)
     }
     g_array_free (rip, TRUE);
 
-    /* Rewrite header partition with updated values */
+    /* Rewrite header partition with updated values. It has to keep the
+     * size it was written with, which had no index */
+    mux->preface->content_storage->essence_container_data[0]->index_sid = 0;
     gst_segment_init (&segment, GST_FORMAT_BYTES);
     if (gst_pad_push_event (mux->srcpad, gst_event_new_segment (&segment))) {
       mux->offset = 0;
@@ -59,6 +59,14 @@ typedef struct
   MXFMetadataTimelineTrack *source_track;
 } GstMXFMuxPad;
 
+/* One content package of the body partition */
+typedef struct
+{
+  guint64 stream_offset;
+  guint n_elements;
+  gboolean keyframe;
+} GstMXFMuxIndexEntry;
+
 typedef enum
 {
   GST_MXF_MUX_STATE_HEADER,
@@ -92,6 +100,14 @@ typedef struct _GstMXFMux {
   guint64 last_gc_position;
   GstClockTime last_gc_timestamp;
 
+  /* Index table of the body partition essence, written to the footer */
+  guint64 essence_start;
+  GArray *index_entries;
+  /* Offsets of the elements inside the first content package, only used
+   * if all content packages have the same layout */
+  GArray *index_deltas;
+  gboolean index_deltas_valid;
+
   gchar *application;
 } GstMXFMux;
 
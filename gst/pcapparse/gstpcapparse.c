@@ -32,12 +32,28 @@
  * ! ffdec_h264 ! fakesink
  * ]| Read from a pcap dump file using filesrc, extract the raw UDP packets,
  * depayload and decode them.
+ * |[
+ * gst-launch-1.0 filesrc location=capture.pcap ! pcapparse split-flows=true
+ *     index-location=capture.pcap.idx name=p
+ *     p.src_0 ! application/x-rtp,media=video,clock-rate=90000,encoding-name=H264
+ *     ! rtph264depay ! fakesink
+ * ]| Expose every UDP flow of a capture on its own pad and cache the flow and
+ * timestamp index next to the capture for the next run.
  * </refsect2>
+ *
+ * When upstream supports random access (e.g. filesrc), the file is scanned
+ * once on startup to build a sparse timestamp index and a table of the UDP
+ * flows it contains. The index is used to answer duration queries and to
+ * seek, and can be stored in and reloaded from #GstPcapParse:index-location.
+ * With #GstPcapParse:split-flows every UDP flow that passes the configured
+ * filters is exposed on a "src_%u" sometimes pad instead of the "src" pad.
+ *
+ * IPv4 and IPv6 frames are supported, optionally carrying 802.1Q/802.1ad VLAN
+ * tags. The address filters only apply to IPv4.
  */
 
 /* TODO:
- * - React on state-change and update state accordingly.
- * - Implement support for timestamping the buffers.
+ * - Implement splitting flows in push mode.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -46,6 +62,9 @@
 
 #include "gstpcapparse.h"
 
+#include <gst/base/gstbytereader.h>
+#include <gst/base/gstbytewriter.h>
+
 #include <string.h>
 
 #ifndef G_OS_WIN32
@@ -64,9 +83,28 @@ enum
   PROP_SRC_PORT,
   PROP_DST_PORT,
   PROP_CAPS,
-  PROP_TS_OFFSET
+  PROP_TS_OFFSET,
+  PROP_SPLIT_FLOWS,
+  PROP_INDEX_LOCATION
 };
 
+#define DEFAULT_SPLIT_FLOWS FALSE
+#define DEFAULT_INDEX_LOCATION NULL
+
+#define PCAP_FILE_HEADER_LEN   24
+#define PCAP_RECORD_HEADER_LEN 16
+/* largest snapshot length libpcap writes */
+#define PCAP_MAX_RECORD_LEN    262144
+
+/* amount of data requested from upstream at once in pull mode */
+#define PULL_CHUNK_SIZE        (1024 * 1024)
+
+/* minimum timestamp distance between two entries of the seek index */
+#define INDEX_INTERVAL         (GST_SECOND / 4)
+
+#define PCAP_INDEX_MAGIC       "GSTPCAPI"
+#define PCAP_INDEX_VERSION     1
+
 GST_DEBUG_CATEGORY_STATIC (gst_pcap_parse_debug);
 #define GST_CAT_DEFAULT gst_pcap_parse_debug
 
@@ -80,18 +118,63 @@ static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS_ANY);
 
+static GstStaticPadTemplate flow_src_template =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS_ANY);
+
 static void gst_pcap_parse_finalize (GObject * object);
 static void gst_pcap_parse_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static void gst_pcap_parse_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 
+static GstStateChangeReturn gst_pcap_parse_change_state (GstElement *
+    element, GstStateChange transition);
+
 static void gst_pcap_parse_reset (GstPcapParse * self);
+static void gst_pcap_parse_reset_pull (GstPcapParse * self);
 
 static GstFlowReturn gst_pcap_parse_chain (GstPad * pad,
     GstObject * parent, GstBuffer * buffer);
 static gboolean gst_pcap_sink_event (GstPad * pad,
     GstObject * parent, GstEvent * event);
+static gboolean gst_pcap_parse_sink_activate (GstPad * sinkpad,
+    GstObject * parent);
+static gboolean gst_pcap_parse_sink_activate_mode (GstPad * sinkpad,
+    GstObject * parent, GstPadMode mode, gboolean active);
+static gboolean gst_pcap_parse_src_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static gboolean gst_pcap_parse_src_query (GstPad * pad,
+    GstObject * parent, GstQuery * query);
+static void gst_pcap_parse_loop (GstPad * pad);
+
+static guint
+gst_pcap_parse_flow_key_hash (gconstpointer key)
+{
+  const guint8 *data = key;
+  guint hash = 2166136261u;
+  guint i;
+
+  /* FNV-1a, keys are always zero-initialized so padding is stable */
+  for (i = 0; i < sizeof (GstPcapParseFlowKey); i++)
+    hash = (hash ^ data[i]) * 16777619u;
+
+  return hash;
+}
+
+static gboolean
+gst_pcap_parse_flow_key_equal (gconstpointer a, gconstpointer b)
+{
+  return memcmp (a, b, sizeof (GstPcapParseFlowKey)) == 0;
+}
+
+static void
+gst_pcap_parse_flow_free (GstPcapParseFlow * flow)
+{
+  g_slice_free (GstPcapParseFlow, flow);
+}
 
 #define parent_class gst_pcap_parse_parent_class
 G_DEFINE_TYPE (GstPcapParse, gst_pcap_parse, GST_TYPE_ELEMENT);
@@ -136,10 +219,25 @@ gst_pcap_parse_class_init (GstPcapParseClass * klass)
           "Relative timestamp offset (ns) to apply (-1 = use absolute packet time)",
           -1, G_MAXINT64, -1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_SPLIT_FLOWS,
+      g_param_spec_boolean ("split-flows", "Split flows",
+          "Expose each UDP flow on its own pad (pull mode only)",
+          DEFAULT_SPLIT_FLOWS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_INDEX_LOCATION,
+      g_param_spec_string ("index-location", "Index location",
+          "File to load the flow and timestamp index from, or to store it "
+          "in after scanning (pull mode only)", DEFAULT_INDEX_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&sink_template));
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&src_template));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&flow_src_template));
+
+  element_class->change_state = GST_DEBUG_FUNCPTR (gst_pcap_parse_change_state);
 
   gst_element_class_set_static_metadata (element_class, "PCapParse",
       "Raw/Parser",
@@ -158,10 +256,18 @@ gst_pcap_parse_init (GstPcapParse * self)
   gst_pad_use_fixed_caps (self->sink_pad);
   gst_pad_set_event_function (self->sink_pad,
       GST_DEBUG_FUNCPTR (gst_pcap_sink_event));
+  gst_pad_set_activate_function (self->sink_pad,
+      GST_DEBUG_FUNCPTR (gst_pcap_parse_sink_activate));
+  gst_pad_set_activatemode_function (self->sink_pad,
+      GST_DEBUG_FUNCPTR (gst_pcap_parse_sink_activate_mode));
   gst_element_add_pad (GST_ELEMENT (self), self->sink_pad);
 
   self->src_pad = gst_pad_new_from_static_template (&src_template, "src");
   gst_pad_use_fixed_caps (self->src_pad);
+  gst_pad_set_event_function (self->src_pad,
+      GST_DEBUG_FUNCPTR (gst_pcap_parse_src_event));
+  gst_pad_set_query_function (self->src_pad,
+      GST_DEBUG_FUNCPTR (gst_pcap_parse_src_query));
   gst_element_add_pad (GST_ELEMENT (self), self->src_pad);
 
   self->src_ip = -1;
@@ -169,10 +275,21 @@ gst_pcap_parse_init (GstPcapParse * self)
   self->src_port = -1;
   self->dst_port = -1;
   self->offset = -1;
+  self->split_flows = DEFAULT_SPLIT_FLOWS;
+  self->index_location = DEFAULT_INDEX_LOCATION;
 
   self->adapter = gst_adapter_new ();
 
+  self->index = g_array_new (FALSE, FALSE, sizeof (GstPcapParseIndexEntry));
+  self->flows = g_hash_table_new (gst_pcap_parse_flow_key_hash,
+      gst_pcap_parse_flow_key_equal);
+  self->flow_list =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) gst_pcap_parse_flow_free);
+  self->flowcombiner = gst_flow_combiner_new ();
+  gst_flow_combiner_add_pad (self->flowcombiner, self->src_pad);
+
   gst_pcap_parse_reset (self);
+  gst_pcap_parse_reset_pull (self);
 }
 
 static void
@@ -183,6 +300,13 @@ gst_pcap_parse_finalize (GObject * object)
   g_object_unref (self->adapter);
   if (self->caps)
     gst_caps_unref (self->caps);
+  g_free (self->index_location);
+
+  gst_buffer_replace (&self->pull_buf, NULL);
+  g_array_free (self->index, TRUE);
+  g_hash_table_destroy (self->flows);
+  g_ptr_array_free (self->flow_list, TRUE);
+  gst_flow_combiner_free (self->flowcombiner);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -242,6 +366,16 @@ gst_pcap_parse_get_property (GObject * object, guint prop_id,
       g_value_set_int64 (value, self->offset);
       break;
 
+    case PROP_SPLIT_FLOWS:
+      g_value_set_boolean (value, self->split_flows);
+      break;
+
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, self->index_location);
+      GST_OBJECT_UNLOCK (self);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -296,6 +430,17 @@ gst_pcap_parse_set_property (GObject * object, guint prop_id,
       self->offset = g_value_get_int64 (value);
       break;
 
+    case PROP_SPLIT_FLOWS:
+      self->split_flows = g_value_get_boolean (value);
+      break;
+
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (self);
+      g_free (self->index_location);
+      self->index_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -315,6 +460,39 @@ gst_pcap_parse_reset (GstPcapParse * self)
   gst_adapter_clear (self->adapter);
 }
 
+static void
+gst_pcap_parse_reset_pull (GstPcapParse * self)
+{
+  guint i;
+
+  for (i = 0; i < self->flow_list->len; i++) {
+    GstPcapParseFlow *flow = g_ptr_array_index (self->flow_list, i);
+
+    if (flow->pad) {
+      gst_flow_combiner_remove_pad (self->flowcombiner, flow->pad);
+      gst_element_remove_pad (GST_ELEMENT_CAST (self), flow->pad);
+      flow->pad = NULL;
+    }
+  }
+  g_hash_table_remove_all (self->flows);
+  g_ptr_array_set_size (self->flow_list, 0);
+  g_array_set_size (self->index, 0);
+  gst_flow_combiner_reset (self->flowcombiner);
+
+  gst_buffer_replace (&self->pull_buf, NULL);
+  self->pull_buf_offset = 0;
+  self->pull_offset = PCAP_FILE_HEADER_LEN;
+  self->upstream_size = -1;
+  self->index_done = FALSE;
+  self->first_ts = GST_CLOCK_TIME_NONE;
+  self->last_ts = GST_CLOCK_TIME_NONE;
+  self->discont = TRUE;
+  self->need_segment = TRUE;
+  self->stream_started = FALSE;
+  self->seqnum = 0;
+  gst_segment_init (&self->segment, GST_FORMAT_TIME);
+}
+
 static guint32
 gst_pcap_parse_read_uint32 (GstPcapParse * self, const guint8 * p)
 {
@@ -333,50 +511,62 @@ gst_pcap_parse_read_uint32 (GstPcapParse * self, const guint8 * p)
 
 #define ETH_HEADER_LEN    14
 #define SLL_HEADER_LEN    16
+#define VLAN_TAG_LEN       4
 #define IP_HEADER_MIN_LEN 20
+#define IPV6_HEADER_LEN   40
 #define UDP_HEADER_LEN     8
 
+#define ETH_TYPE_IPV4     0x0800
+#define ETH_TYPE_IPV6     0x86dd
+#define ETH_TYPE_VLAN     0x8100
+#define ETH_TYPE_QINQ     0x88a8
+
 #define IP_PROTO_UDP      17
 #define IP_PROTO_TCP      6
 
+#define IPV6_EXT_HOP_BY_HOP  0
+#define IPV6_EXT_ROUTING     43
+#define IPV6_EXT_FRAGMENT    44
+#define IPV6_EXT_DEST_OPTS   60
 
+/* Locates the UDP or TCP payload of a captured frame and fills @key with the
+ * addresses and ports of the packet. Filters are not applied here. */
 static gboolean
 gst_pcap_parse_scan_frame (GstPcapParse * self,
-    const guint8 * buf,
-    gint buf_size, const guint8 ** payload, gint * payload_size)
+    const guint8 * buf, gint buf_size, GstPcapParseFlowKey * key,
+    const guint8 ** payload, gint * payload_size)
 {
+  const guint8 *buf_end = buf + buf_size;
   const guint8 *buf_ip = 0;
   const guint8 *buf_proto;
   guint16 eth_type;
-  guint8 b;
   guint8 ip_header_size;
   guint8 ip_protocol;
-  guint32 ip_src_addr;
-  guint32 ip_dst_addr;
-  guint16 src_port;
-  guint16 dst_port;
   guint16 len;
 
+  memset (key, 0, sizeof (GstPcapParseFlowKey));
+
   switch (self->linktype) {
     case LINKTYPE_ETHER:
       if (buf_size < ETH_HEADER_LEN + IP_HEADER_MIN_LEN + UDP_HEADER_LEN)
         return FALSE;
 
-      eth_type = GUINT16_FROM_BE (*((guint16 *) (buf + 12)));
+      eth_type = GST_READ_UINT16_BE (buf + 12);
       buf_ip = buf + ETH_HEADER_LEN;
       break;
     case LINKTYPE_SLL:
       if (buf_size < SLL_HEADER_LEN + IP_HEADER_MIN_LEN + UDP_HEADER_LEN)
         return FALSE;
 
-      eth_type = GUINT16_FROM_BE (*((guint16 *) (buf + 14)));
+      eth_type = GST_READ_UINT16_BE (buf + 14);
       buf_ip = buf + SLL_HEADER_LEN;
       break;
     case LINKTYPE_RAW:
       if (buf_size < IP_HEADER_MIN_LEN + UDP_HEADER_LEN)
         return FALSE;
 
-      eth_type = 0x800;         /* This is fine since IPv4/IPv6 is parse elsewhere */
+      /* no link layer, the IP version tells us what follows */
+      eth_type = ((buf[0] >> 4) == 6) ? ETH_TYPE_IPV6 : ETH_TYPE_IPV4;
       buf_ip = buf;
       break;
 
@@ -384,68 +574,178 @@ gst_pcap_parse_scan_frame (GstPcapParse * self,
       return FALSE;
   }
 
-  if (eth_type != 0x800)
-    return FALSE;
+  /* skip 802.1Q and 802.1ad tags, the real ethertype follows each TCI */
+  while (eth_type == ETH_TYPE_VLAN || eth_type == ETH_TYPE_QINQ) {
+    if (buf_ip + VLAN_TAG_LEN > buf_end)
+      return FALSE;
+    eth_type = GST_READ_UINT16_BE (buf_ip + 2);
+    buf_ip += VLAN_TAG_LEN;
+  }
 
-  b = *buf_ip;
-  if (((b >> 4) & 0x0f) != 4)
-    return FALSE;
+  if (eth_type == ETH_TYPE_IPV4) {
+    if (buf_ip + IP_HEADER_MIN_LEN > buf_end)
+      return FALSE;
+
+    if (((buf_ip[0] >> 4) & 0x0f) != 4)
+      return FALSE;
+
+    ip_header_size = (buf_ip[0] & 0x0f) * 4;
+    if (ip_header_size < IP_HEADER_MIN_LEN || buf_ip + ip_header_size > buf_end)
+      return FALSE;
+
+    ip_protocol = buf_ip[9];
+    key->ip_version = 4;
+    memcpy (key->src_addr, buf_ip + 12, 4);
+    memcpy (key->dst_addr, buf_ip + 16, 4);
+    buf_proto = buf_ip + ip_header_size;
+  } else if (eth_type == ETH_TYPE_IPV6) {
+    if (buf_ip + IPV6_HEADER_LEN > buf_end)
+      return FALSE;
+
+    if (((buf_ip[0] >> 4) & 0x0f) != 6)
+      return FALSE;
+
+    ip_protocol = buf_ip[6];
+    key->ip_version = 6;
+    memcpy (key->src_addr, buf_ip + 8, 16);
+    memcpy (key->dst_addr, buf_ip + 24, 16);
+    buf_proto = buf_ip + IPV6_HEADER_LEN;
+
+    while (ip_protocol == IPV6_EXT_HOP_BY_HOP ||
+        ip_protocol == IPV6_EXT_ROUTING || ip_protocol == IPV6_EXT_FRAGMENT ||
+        ip_protocol == IPV6_EXT_DEST_OPTS) {
+      guint ext_len;
+
+      if (buf_proto + 8 > buf_end)
+        return FALSE;
+
+      if (ip_protocol == IPV6_EXT_FRAGMENT) {
+        /* only the first fragment carries the transport header */
+        if ((GST_READ_UINT16_BE (buf_proto + 2) & 0xfff8) != 0)
+          return FALSE;
+        ext_len = 8;
+      } else {
+        ext_len = (buf_proto[1] + 1) * 8;
+      }
 
-  ip_header_size = (b & 0x0f) * 4;
-  if (buf_ip + ip_header_size > buf + buf_size)
+      ip_protocol = buf_proto[0];
+      buf_proto += ext_len;
+    }
+  } else {
     return FALSE;
+  }
 
-  ip_protocol = *(buf_ip + 9);
   GST_LOG_OBJECT (self, "ip proto %d", (gint) ip_protocol);
 
   if (ip_protocol != IP_PROTO_UDP && ip_protocol != IP_PROTO_TCP)
     return FALSE;
 
-  /* ip info */
-  ip_src_addr = *((guint32 *) (buf_ip + 12));
-  ip_dst_addr = *((guint32 *) (buf_ip + 16));
-  buf_proto = buf_ip + ip_header_size;
+  if (buf_proto + UDP_HEADER_LEN > buf_end)
+    return FALSE;
 
   /* ok for tcp and udp */
-  src_port = GUINT16_FROM_BE (*((guint16 *) (buf_proto + 0)));
-  dst_port = GUINT16_FROM_BE (*((guint16 *) (buf_proto + 2)));
+  key->protocol = ip_protocol;
+  key->src_port = GST_READ_UINT16_BE (buf_proto + 0);
+  key->dst_port = GST_READ_UINT16_BE (buf_proto + 2);
 
   /* extract some params and data according to protocol */
   if (ip_protocol == IP_PROTO_UDP) {
-    len = GUINT16_FROM_BE (*((guint16 *) (buf_proto + 4)));
-    if (len < UDP_HEADER_LEN || buf_proto + len > buf + buf_size)
+    len = GST_READ_UINT16_BE (buf_proto + 4);
+    if (len < UDP_HEADER_LEN || buf_proto + len > buf_end)
       return FALSE;
 
     *payload = buf_proto + UDP_HEADER_LEN;
     *payload_size = len - UDP_HEADER_LEN;
   } else {
-    if (buf_proto + 12 >= buf + buf_size)
+    if (buf_proto + 12 >= buf_end)
       return FALSE;
     len = (buf_proto[12] >> 4) * 4;
-    if (buf_proto + len > buf + buf_size)
+    if (buf_proto + len > buf_end)
       return FALSE;
 
     /* all remaining data following tcp header is payload */
     *payload = buf_proto + len;
-    *payload_size = self->cur_packet_size - (buf_proto - buf) - len;
+    *payload_size = buf_end - buf_proto - len;
   }
 
-  /* but still filter as configured */
-  if (self->src_ip >= 0 && ip_src_addr != self->src_ip)
-    return FALSE;
+  return TRUE;
+}
 
-  if (self->dst_ip >= 0 && ip_dst_addr != self->dst_ip)
-    return FALSE;
+/* Applies the address and port filters, addresses only match IPv4 */
+static gboolean
+gst_pcap_parse_filter_frame (GstPcapParse * self,
+    const GstPcapParseFlowKey * key)
+{
+  guint32 ip_src_addr;
+  guint32 ip_dst_addr;
 
-  if (self->src_port >= 0 && src_port != self->src_port)
+  if (self->src_ip >= 0 || self->dst_ip >= 0) {
+    if (key->ip_version != 4)
+      return FALSE;
+
+    memcpy (&ip_src_addr, key->src_addr, 4);
+    memcpy (&ip_dst_addr, key->dst_addr, 4);
+
+    if (self->src_ip >= 0 && ip_src_addr != self->src_ip)
+      return FALSE;
+
+    if (self->dst_ip >= 0 && ip_dst_addr != self->dst_ip)
+      return FALSE;
+  }
+
+  if (self->src_port >= 0 && key->src_port != self->src_port)
     return FALSE;
 
-  if (self->dst_port >= 0 && dst_port != self->dst_port)
+  if (self->dst_port >= 0 && key->dst_port != self->dst_port)
     return FALSE;
 
   return TRUE;
 }
 
+static GstFlowReturn
+gst_pcap_parse_parse_file_header (GstPcapParse * self, const guint8 * data)
+{
+  guint32 magic;
+  guint32 linktype;
+  guint16 major_version;
+
+  magic = GST_READ_UINT32_LE (data);
+  major_version = GST_READ_UINT16_LE (data + 4);
+
+  if (magic == 0xa1b2c3d4) {
+    self->swap_endian = G_BYTE_ORDER != G_LITTLE_ENDIAN;
+  } else if (magic == 0xd4c3b2a1) {
+    self->swap_endian = G_BYTE_ORDER == G_LITTLE_ENDIAN;
+    major_version = major_version << 8 | major_version >> 8;
+  } else {
+    GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+        ("File is not a libpcap file, magic is %X", magic));
+    return GST_FLOW_ERROR;
+  }
+
+  if (major_version != 2) {
+    GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+        ("File is not a libpcap major version 2, but %u", major_version));
+    return GST_FLOW_ERROR;
+  }
+
+  linktype = gst_pcap_parse_read_uint32 (self, data + 20);
+
+  if (linktype != LINKTYPE_ETHER && linktype != LINKTYPE_SLL &&
+      linktype != LINKTYPE_RAW) {
+    GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+        ("Only dumps of type Ethernet, raw IP or Linux Cooked (SLL) "
+            "understood; type %d unknown", linktype));
+    return GST_FLOW_ERROR;
+  }
+
+  GST_DEBUG_OBJECT (self, "linktype %u", linktype);
+  self->linktype = linktype;
+  self->initialized = TRUE;
+
+  return GST_FLOW_OK;
+}
+
 static GstFlowReturn
 gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 {
@@ -467,6 +767,7 @@ gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
           break;
 
         if (self->cur_packet_size > 0) {
+          GstPcapParseFlowKey key;
           const guint8 *payload_data;
           gint payload_size;
 
@@ -476,7 +777,8 @@ gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
               self->cur_packet_size);
 
           if (gst_pcap_parse_scan_frame (self, data, self->cur_packet_size,
-                  &payload_data, &payload_size)) {
+                  &key, &payload_data, &payload_size) &&
+              gst_pcap_parse_filter_frame (self, &key)) {
             GstBuffer *out_buf;
             guintptr offset = payload_data - data;
 
@@ -533,53 +835,17 @@ gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
         self->cur_packet_size = incl_len;
       }
     } else {
-      guint32 magic;
-      guint32 linktype;
-      guint16 major_version;
-
-      if (avail < 24)
+      if (avail < PCAP_FILE_HEADER_LEN)
         break;
 
-      data = gst_adapter_map (self->adapter, 24);
-
-      magic = *((guint32 *) data);
-      major_version = *((guint16 *) (data + 4));
-      linktype = gst_pcap_parse_read_uint32 (self, data + 20);
+      data = gst_adapter_map (self->adapter, PCAP_FILE_HEADER_LEN);
+      ret = gst_pcap_parse_parse_file_header (self, data);
       gst_adapter_unmap (self->adapter);
 
-      if (magic == 0xa1b2c3d4) {
-        self->swap_endian = FALSE;
-      } else if (magic == 0xd4c3b2a1) {
-        self->swap_endian = TRUE;
-        major_version = major_version << 8 | major_version >> 8;
-      } else {
-        GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
-            ("File is not a libpcap file, magic is %X", magic));
-        ret = GST_FLOW_ERROR;
+      if (ret != GST_FLOW_OK)
         goto out;
-      }
 
-      if (major_version != 2) {
-        GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
-            ("File is not a libpcap major version 2, but %u", major_version));
-        ret = GST_FLOW_ERROR;
-        goto out;
-      }
-
-      if (linktype != LINKTYPE_ETHER && linktype != LINKTYPE_SLL &&
-          linktype != LINKTYPE_RAW) {
-        GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
-            ("Only dumps of type Ethernet, raw IP or Linux Cooked (SLL) "
-                "understood; type %d unknown", linktype));
-        ret = GST_FLOW_ERROR;
-        goto out;
-      }
-
-      GST_DEBUG_OBJECT (self, "linktype %u", linktype);
-      self->linktype = linktype;
-
-      gst_adapter_flush (self->adapter, 24);
-      self->initialized = TRUE;
+      gst_adapter_flush (self->adapter, PCAP_FILE_HEADER_LEN);
     }
   }
 
@@ -628,3 +894,893 @@ gst_pcap_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
 
   return ret;
 }
+
+static gboolean
+gst_pcap_parse_sink_activate (GstPad * sinkpad, GstObject * parent)
+{
+  GstQuery *query;
+  GstPadMode mode = GST_PAD_MODE_PUSH;
+
+  query = gst_query_new_scheduling ();
+
+  if (gst_pad_peer_query (sinkpad, query)) {
+    if (gst_query_has_scheduling_mode_with_flags (query,
+            GST_PAD_MODE_PULL, GST_SCHEDULING_FLAG_SEEKABLE)) {
+      GstSchedulingFlags flags;
+      gst_query_parse_scheduling (query, &flags, NULL, NULL, NULL);
+      if (!(flags & GST_SCHEDULING_FLAG_SEQUENTIAL))
+        mode = GST_PAD_MODE_PULL;
+    }
+  }
+  gst_query_unref (query);
+
+  return gst_pad_activate_mode (sinkpad, mode, TRUE);
+}
+
+static gboolean
+gst_pcap_parse_sink_activate_mode (GstPad * sinkpad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (parent);
+
+  if (mode == GST_PAD_MODE_PUSH) {
+    self->pull_mode = FALSE;
+  } else {
+    if (active) {
+      self->pull_mode = TRUE;
+      return gst_pad_start_task (sinkpad, (GstTaskFunction) gst_pcap_parse_loop,
+          sinkpad, NULL);
+    } else {
+      self->pull_mode = FALSE;
+      return gst_pad_stop_task (sinkpad);
+    }
+  }
+
+  return TRUE;
+}
+
+/* Makes sure @size bytes starting at @offset are available in pull_buf. Data
+ * is requested in large chunks so most records are served without a new
+ * pull_range() call. */
+static GstFlowReturn
+gst_pcap_parse_ensure_range (GstPcapParse * self, guint64 offset, guint size)
+{
+  GstFlowReturn ret;
+
+  if (self->pull_buf != NULL && offset >= self->pull_buf_offset &&
+      offset + size <=
+      self->pull_buf_offset + gst_buffer_get_size (self->pull_buf))
+    return GST_FLOW_OK;
+
+  gst_buffer_replace (&self->pull_buf, NULL);
+  ret = gst_pad_pull_range (self->sink_pad, offset,
+      MAX (size, PULL_CHUNK_SIZE), &self->pull_buf);
+  if (ret != GST_FLOW_OK) {
+    GST_DEBUG_OBJECT (self, "pull_range at offset %" G_GUINT64_FORMAT
+        " failed: %s", offset, gst_flow_get_name (ret));
+    return ret;
+  }
+
+  self->pull_buf_offset = offset;
+
+  if (gst_buffer_get_size (self->pull_buf) < size) {
+    GST_DEBUG_OBJECT (self, "short read at offset %" G_GUINT64_FORMAT, offset);
+    return GST_FLOW_EOS;
+  }
+
+  return GST_FLOW_OK;
+}
+
+/* Reads the record header at @offset and makes sure the complete record is
+ * available in pull_buf */
+static GstFlowReturn
+gst_pcap_parse_pull_record (GstPcapParse * self, guint64 offset,
+    GstClockTime * ts, guint32 * incl_len)
+{
+  GstFlowReturn ret;
+  guint8 header[PCAP_RECORD_HEADER_LEN];
+  guint32 ts_sec;
+  guint32 ts_usec;
+  guint32 len;
+
+  ret = gst_pcap_parse_ensure_range (self, offset, PCAP_RECORD_HEADER_LEN);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  gst_buffer_extract (self->pull_buf, offset - self->pull_buf_offset, header,
+      PCAP_RECORD_HEADER_LEN);
+
+  ts_sec = gst_pcap_parse_read_uint32 (self, header + 0);
+  ts_usec = gst_pcap_parse_read_uint32 (self, header + 4);
+  len = gst_pcap_parse_read_uint32 (self, header + 8);
+
+  if (len > PCAP_MAX_RECORD_LEN) {
+    GST_ELEMENT_ERROR (self, STREAM, DECODE, (NULL),
+        ("Invalid record length %u at offset %" G_GUINT64_FORMAT, len,
+            offset));
+    return GST_FLOW_ERROR;
+  }
+
+  ret = gst_pcap_parse_ensure_range (self, offset,
+      PCAP_RECORD_HEADER_LEN + len);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  *ts = ts_sec * GST_SECOND + ts_usec * GST_USECOND;
+  *incl_len = len;
+
+  return GST_FLOW_OK;
+}
+
+static GstPcapParseFlow *
+gst_pcap_parse_get_flow (GstPcapParse * self, const GstPcapParseFlowKey * key)
+{
+  GstPcapParseFlow *flow;
+
+  flow = g_hash_table_lookup (self->flows, key);
+  if (flow == NULL) {
+    flow = g_slice_new0 (GstPcapParseFlow);
+    flow->key = *key;
+    flow->id = self->flow_list->len;
+    flow->discont = TRUE;
+    g_ptr_array_add (self->flow_list, flow);
+    g_hash_table_insert (self->flows, &flow->key, flow);
+  }
+
+  return flow;
+}
+
+static gchar *
+gst_pcap_parse_address_to_string (guint8 ip_version, const guint8 * addr)
+{
+  if (ip_version == 4)
+    return g_strdup_printf ("%u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+
+  return g_strdup_printf ("%x:%x:%x:%x:%x:%x:%x:%x",
+      GST_READ_UINT16_BE (addr + 0), GST_READ_UINT16_BE (addr + 2),
+      GST_READ_UINT16_BE (addr + 4), GST_READ_UINT16_BE (addr + 6),
+      GST_READ_UINT16_BE (addr + 8), GST_READ_UINT16_BE (addr + 10),
+      GST_READ_UINT16_BE (addr + 12), GST_READ_UINT16_BE (addr + 14));
+}
+
+static GstFlowReturn
+gst_pcap_parse_build_index (GstPcapParse * self)
+{
+  GstFlowReturn ret;
+  GstClockTime last_indexed = GST_CLOCK_TIME_NONE;
+  guint64 offset = PCAP_FILE_HEADER_LEN;
+  guint64 n_records = 0;
+
+  while (TRUE) {
+    GstPcapParseFlowKey key;
+    GstMapInfo map;
+    const guint8 *payload;
+    gint payload_size;
+    GstClockTime ts;
+    guint32 incl_len;
+
+    ret = gst_pcap_parse_pull_record (self, offset, &ts, &incl_len);
+    if (ret == GST_FLOW_EOS)
+      break;
+    else if (ret != GST_FLOW_OK)
+      return ret;
+
+    if (!GST_CLOCK_TIME_IS_VALID (self->first_ts))
+      self->first_ts = ts;
+    if (!GST_CLOCK_TIME_IS_VALID (self->last_ts) || ts > self->last_ts)
+      self->last_ts = ts;
+
+    /* entries stay sorted, records that jump back in time are not indexed */
+    if (!GST_CLOCK_TIME_IS_VALID (last_indexed) ||
+        ts >= last_indexed + INDEX_INTERVAL) {
+      GstPcapParseIndexEntry entry;
+
+      entry.offset = offset;
+      entry.ts = ts;
+      g_array_append_val (self->index, entry);
+      last_indexed = ts;
+    }
+
+    gst_buffer_map (self->pull_buf, &map, GST_MAP_READ);
+    if (gst_pcap_parse_scan_frame (self,
+            map.data + (offset - self->pull_buf_offset) +
+            PCAP_RECORD_HEADER_LEN, incl_len, &key, &payload, &payload_size)
+        && key.protocol == IP_PROTO_UDP) {
+      GstPcapParseFlow *flow = gst_pcap_parse_get_flow (self, &key);
+
+      flow->packets++;
+    }
+    gst_buffer_unmap (self->pull_buf, &map);
+
+    offset += PCAP_RECORD_HEADER_LEN + incl_len;
+    n_records++;
+  }
+
+  GST_INFO_OBJECT (self, "indexed %" G_GUINT64_FORMAT " records, %u flows, "
+      "%u index entries", n_records, self->flow_list->len, self->index->len);
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_pcap_parse_clear_index (GstPcapParse * self)
+{
+  g_hash_table_remove_all (self->flows);
+  g_ptr_array_set_size (self->flow_list, 0);
+  g_array_set_size (self->index, 0);
+  self->first_ts = GST_CLOCK_TIME_NONE;
+  self->last_ts = GST_CLOCK_TIME_NONE;
+}
+
+/* Index file layout, all values little endian:
+ *   magic "GSTPCAPI", version (u32), size of the capture file (u64),
+ *   first and last timestamp (u64),
+ *   number of flows (u32), per flow: ip version (u8), protocol (u8),
+ *     source and destination port (u16), source and destination address
+ *     (16 bytes each), number of packets (u64),
+ *   number of index entries (u32), per entry: offset (u64), timestamp (u64)
+ */
+#define PCAP_INDEX_HEADER_LEN (8 + 4 + 8 + 8 + 8)
+#define PCAP_INDEX_FLOW_LEN   (1 + 1 + 2 + 2 + 16 + 16 + 8)
+#define PCAP_INDEX_ENTRY_LEN  (8 + 8)
+
+static gboolean
+gst_pcap_parse_load_index (GstPcapParse * self)
+{
+  GstByteReader reader;
+  const guint8 *magic;
+  gchar *location;
+  gchar *contents = NULL;
+  gsize length;
+  GError *err = NULL;
+  guint32 version, n_flows, n_entries, i;
+  guint64 size, first_ts, last_ts;
+
+  GST_OBJECT_LOCK (self);
+  location = g_strdup (self->index_location);
+  GST_OBJECT_UNLOCK (self);
+
+  if (location == NULL || self->upstream_size == -1)
+    goto done;
+
+  if (!g_file_get_contents (location, &contents, &length, &err)) {
+    GST_DEBUG_OBJECT (self, "no index loaded from %s: %s", location,
+        err->message);
+    g_clear_error (&err);
+    goto done;
+  }
+
+  gst_byte_reader_init (&reader, (const guint8 *) contents, length);
+
+  if (!gst_byte_reader_get_data (&reader, 8, &magic) ||
+      memcmp (magic, PCAP_INDEX_MAGIC, 8) != 0 ||
+      !gst_byte_reader_get_uint32_le (&reader, &version) ||
+      version != PCAP_INDEX_VERSION ||
+      !gst_byte_reader_get_uint64_le (&reader, &size) ||
+      size != self->upstream_size ||
+      !gst_byte_reader_get_uint64_le (&reader, &first_ts) ||
+      !gst_byte_reader_get_uint64_le (&reader, &last_ts) ||
+      !gst_byte_reader_get_uint32_le (&reader, &n_flows))
+    goto invalid;
+
+  self->first_ts = first_ts;
+  self->last_ts = last_ts;
+
+  for (i = 0; i < n_flows; i++) {
+    GstPcapParseFlowKey key;
+    GstPcapParseFlow *flow;
+    const guint8 *src_addr, *dst_addr;
+    guint64 packets;
+
+    memset (&key, 0, sizeof (key));
+    if (!gst_byte_reader_get_uint8 (&reader, &key.ip_version) ||
+        !gst_byte_reader_get_uint8 (&reader, &key.protocol) ||
+        !gst_byte_reader_get_uint16_le (&reader, &key.src_port) ||
+        !gst_byte_reader_get_uint16_le (&reader, &key.dst_port) ||
+        !gst_byte_reader_get_data (&reader, 16, &src_addr) ||
+        !gst_byte_reader_get_data (&reader, 16, &dst_addr) ||
+        !gst_byte_reader_get_uint64_le (&reader, &packets))
+      goto invalid;
+
+    memcpy (key.src_addr, src_addr, 16);
+    memcpy (key.dst_addr, dst_addr, 16);
+    flow = gst_pcap_parse_get_flow (self, &key);
+    flow->packets = packets;
+  }
+
+  if (!gst_byte_reader_get_uint32_le (&reader, &n_entries) ||
+      gst_byte_reader_get_remaining (&reader) <
+      (guint64) n_entries * PCAP_INDEX_ENTRY_LEN)
+    goto invalid;
+
+  g_array_set_size (self->index, n_entries);
+  for (i = 0; i < n_entries; i++) {
+    GstPcapParseIndexEntry *entry =
+        &g_array_index (self->index, GstPcapParseIndexEntry, i);
+
+    entry->offset = gst_byte_reader_get_uint64_le_unchecked (&reader);
+    entry->ts = gst_byte_reader_get_uint64_le_unchecked (&reader);
+  }
+
+  GST_INFO_OBJECT (self, "loaded index with %u flows and %u entries from %s",
+      n_flows, n_entries, location);
+
+  g_free (contents);
+  g_free (location);
+
+  return TRUE;
+
+invalid:
+  GST_WARNING_OBJECT (self, "ignoring invalid or outdated index file %s",
+      location);
+  gst_pcap_parse_clear_index (self);
+
+done:
+  g_free (contents);
+  g_free (location);
+
+  return FALSE;
+}
+
+static void
+gst_pcap_parse_save_index (GstPcapParse * self)
+{
+  GstByteWriter writer;
+  gchar *location;
+  guint8 *data;
+  guint size, i;
+  GError *err = NULL;
+
+  GST_OBJECT_LOCK (self);
+  location = g_strdup (self->index_location);
+  GST_OBJECT_UNLOCK (self);
+
+  if (location == NULL || self->upstream_size == -1) {
+    g_free (location);
+    return;
+  }
+
+  size = PCAP_INDEX_HEADER_LEN + 4 + self->flow_list->len * PCAP_INDEX_FLOW_LEN
+      + 4 + self->index->len * PCAP_INDEX_ENTRY_LEN;
+  gst_byte_writer_init_with_size (&writer, size, TRUE);
+
+  gst_byte_writer_put_data_unchecked (&writer,
+      (const guint8 *) PCAP_INDEX_MAGIC, 8);
+  gst_byte_writer_put_uint32_le_unchecked (&writer, PCAP_INDEX_VERSION);
+  gst_byte_writer_put_uint64_le_unchecked (&writer, self->upstream_size);
+  gst_byte_writer_put_uint64_le_unchecked (&writer, self->first_ts);
+  gst_byte_writer_put_uint64_le_unchecked (&writer, self->last_ts);
+
+  gst_byte_writer_put_uint32_le_unchecked (&writer, self->flow_list->len);
+  for (i = 0; i < self->flow_list->len; i++) {
+    GstPcapParseFlow *flow = g_ptr_array_index (self->flow_list, i);
+
+    gst_byte_writer_put_uint8_unchecked (&writer, flow->key.ip_version);
+    gst_byte_writer_put_uint8_unchecked (&writer, flow->key.protocol);
+    gst_byte_writer_put_uint16_le_unchecked (&writer, flow->key.src_port);
+    gst_byte_writer_put_uint16_le_unchecked (&writer, flow->key.dst_port);
+    gst_byte_writer_put_data_unchecked (&writer, flow->key.src_addr, 16);
+    gst_byte_writer_put_data_unchecked (&writer, flow->key.dst_addr, 16);
+    gst_byte_writer_put_uint64_le_unchecked (&writer, flow->packets);
+  }
+
+  gst_byte_writer_put_uint32_le_unchecked (&writer, self->index->len);
+  for (i = 0; i < self->index->len; i++) {
+    GstPcapParseIndexEntry *entry =
+        &g_array_index (self->index, GstPcapParseIndexEntry, i);
+
+    gst_byte_writer_put_uint64_le_unchecked (&writer, entry->offset);
+    gst_byte_writer_put_uint64_le_unchecked (&writer, entry->ts);
+  }
+
+  data = gst_byte_writer_reset_and_get_data (&writer);
+
+  if (!g_file_set_contents (location, (const gchar *) data, size, &err)) {
+    GST_WARNING_OBJECT (self, "failed to write index to %s: %s", location,
+        err->message);
+    g_clear_error (&err);
+  } else {
+    GST_INFO_OBJECT (self, "stored index in %s", location);
+  }
+
+  g_free (data);
+  g_free (location);
+}
+
+/* Returns the offset of the last indexed record not later than @ts */
+static guint64
+gst_pcap_parse_index_lookup (GstPcapParse * self, GstClockTime ts)
+{
+  guint lo = 0, hi = self->index->len;
+
+  if (self->index->len == 0)
+    return PCAP_FILE_HEADER_LEN;
+
+  while (hi - lo > 1) {
+    guint mid = lo + (hi - lo) / 2;
+
+    if (g_array_index (self->index, GstPcapParseIndexEntry, mid).ts <= ts)
+      lo = mid;
+    else
+      hi = mid;
+  }
+
+  return g_array_index (self->index, GstPcapParseIndexEntry, lo).offset;
+}
+
+/* Maps a capture timestamp to a buffer timestamp, see ts-offset */
+static GstClockTime
+gst_pcap_parse_output_ts (GstPcapParse * self, GstClockTime ts)
+{
+  if (self->offset < 0 || !GST_CLOCK_TIME_IS_VALID (ts))
+    return ts;
+
+  if (ts < self->base_ts)
+    return self->offset;
+
+  return ts - self->base_ts + self->offset;
+}
+
+static GstClockTime
+gst_pcap_parse_input_ts (GstPcapParse * self, GstClockTime ts)
+{
+  if (self->offset < 0 || !GST_CLOCK_TIME_IS_VALID (ts))
+    return ts;
+
+  if (ts < (GstClockTime) self->offset)
+    return self->base_ts;
+
+  return ts - self->offset + self->base_ts;
+}
+
+static gboolean
+gst_pcap_parse_push_src_event (GstPcapParse * self, GstEvent * event)
+{
+  gboolean ret;
+  guint i;
+
+  ret = gst_pad_push_event (self->src_pad, gst_event_ref (event));
+
+  for (i = 0; i < self->flow_list->len; i++) {
+    GstPcapParseFlow *flow = g_ptr_array_index (self->flow_list, i);
+
+    if (flow->pad)
+      ret |= gst_pad_push_event (flow->pad, gst_event_ref (event));
+  }
+
+  gst_event_unref (event);
+
+  return ret;
+}
+
+static void
+gst_pcap_parse_add_flow_pad (GstPcapParse * self, GstPcapParseFlow * flow)
+{
+  GstElementClass *klass = GST_ELEMENT_GET_CLASS (self);
+  gchar *name, *src, *dst, *stream_id;
+
+  name = g_strdup_printf ("src_%u", flow->id);
+  flow->pad =
+      gst_pad_new_from_template (gst_element_class_get_pad_template (klass,
+          "src_%u"), name);
+  g_free (name);
+
+  gst_pad_use_fixed_caps (flow->pad);
+  gst_pad_set_event_function (flow->pad,
+      GST_DEBUG_FUNCPTR (gst_pcap_parse_src_event));
+  gst_pad_set_query_function (flow->pad,
+      GST_DEBUG_FUNCPTR (gst_pcap_parse_src_query));
+  gst_pad_set_active (flow->pad, TRUE);
+
+  src = gst_pcap_parse_address_to_string (flow->key.ip_version,
+      flow->key.src_addr);
+  dst = gst_pcap_parse_address_to_string (flow->key.ip_version,
+      flow->key.dst_addr);
+  GST_DEBUG_OBJECT (self, "exposing flow %u: %s:%u -> %s:%u, %"
+      G_GUINT64_FORMAT " packets", flow->id, src, flow->key.src_port, dst,
+      flow->key.dst_port, flow->packets);
+
+  stream_id = gst_pad_create_stream_id_printf (flow->pad,
+      GST_ELEMENT_CAST (self), "udp/%s:%u-%s:%u", src, flow->key.src_port,
+      dst, flow->key.dst_port);
+  gst_pad_push_event (flow->pad, gst_event_new_stream_start (stream_id));
+  g_free (stream_id);
+  g_free (src);
+  g_free (dst);
+
+  if (self->caps)
+    gst_pad_set_caps (flow->pad, self->caps);
+
+  gst_flow_combiner_add_pad (self->flowcombiner, flow->pad);
+  gst_element_add_pad (GST_ELEMENT_CAST (self), flow->pad);
+}
+
+static void
+gst_pcap_parse_start_streams (GstPcapParse * self)
+{
+  gchar *stream_id;
+  guint i;
+
+  stream_id = gst_pad_create_stream_id (self->src_pad,
+      GST_ELEMENT_CAST (self), NULL);
+  gst_pad_push_event (self->src_pad, gst_event_new_stream_start (stream_id));
+  g_free (stream_id);
+
+  if (self->caps)
+    gst_pad_set_caps (self->src_pad, self->caps);
+
+  if (self->split_flows) {
+    for (i = 0; i < self->flow_list->len; i++) {
+      GstPcapParseFlow *flow = g_ptr_array_index (self->flow_list, i);
+
+      if (gst_pcap_parse_filter_frame (self, &flow->key))
+        gst_pcap_parse_add_flow_pad (self, flow);
+    }
+  }
+
+  gst_element_no_more_pads (GST_ELEMENT_CAST (self));
+  self->stream_started = TRUE;
+}
+
+static GstFlowReturn
+gst_pcap_parse_handle_record (GstPcapParse * self, GstClockTime ts,
+    guint32 incl_len)
+{
+  GstPcapParseFlowKey key;
+  GstPcapParseFlow *flow = NULL;
+  GstMapInfo map;
+  GstBuffer *outbuf;
+  GstPad *pad;
+  const guint8 *payload;
+  gint payload_size;
+  gsize payload_offset = 0;
+  gboolean found;
+  GstFlowReturn ret;
+
+  gst_buffer_map (self->pull_buf, &map, GST_MAP_READ);
+  found = gst_pcap_parse_scan_frame (self,
+      map.data + (self->pull_offset - self->pull_buf_offset) +
+      PCAP_RECORD_HEADER_LEN, incl_len, &key, &payload, &payload_size) &&
+      gst_pcap_parse_filter_frame (self, &key);
+  if (found)
+    payload_offset = payload - map.data;
+  gst_buffer_unmap (self->pull_buf, &map);
+
+  if (!found)
+    return GST_FLOW_OK;
+
+  ts = gst_pcap_parse_output_ts (self, ts);
+
+  if (self->segment.stop != -1 && ts >= self->segment.stop)
+    return GST_FLOW_EOS;
+
+  /* after a seek we start from the previous index entry */
+  if (ts < self->segment.start)
+    return GST_FLOW_OK;
+
+  if (self->split_flows && key.protocol == IP_PROTO_UDP)
+    flow = g_hash_table_lookup (self->flows, &key);
+
+  /* the payload shares the memory of the chunk we pulled, which keeps the
+   * RTP header in the first and only memory of the buffer */
+  outbuf = gst_buffer_copy_region (self->pull_buf, GST_BUFFER_COPY_MEMORY,
+      payload_offset, payload_size);
+  GST_BUFFER_TIMESTAMP (outbuf) = ts;
+
+  if (flow && flow->pad) {
+    pad = flow->pad;
+    if (flow->discont) {
+      GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+      flow->discont = FALSE;
+    }
+  } else {
+    pad = self->src_pad;
+    if (self->discont) {
+      GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+      self->discont = FALSE;
+    }
+  }
+
+  self->segment.position = ts;
+
+  ret = gst_pad_push (pad, outbuf);
+
+  return gst_flow_combiner_update_pad_flow (self->flowcombiner, pad, ret);
+}
+
+static void
+gst_pcap_parse_loop (GstPad * pad)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (GST_PAD_PARENT (pad));
+  GstFlowReturn ret;
+  GstClockTime ts;
+  guint32 incl_len;
+
+  if (G_UNLIKELY (!self->initialized)) {
+    guint8 header[PCAP_FILE_HEADER_LEN];
+
+    ret = gst_pcap_parse_ensure_range (self, 0, PCAP_FILE_HEADER_LEN);
+    if (ret != GST_FLOW_OK)
+      goto pause;
+
+    gst_buffer_extract (self->pull_buf, 0, header, PCAP_FILE_HEADER_LEN);
+    ret = gst_pcap_parse_parse_file_header (self, header);
+    if (ret != GST_FLOW_OK)
+      goto pause;
+  }
+
+  if (G_UNLIKELY (!self->index_done)) {
+    gint64 size;
+
+    if (gst_pad_peer_query_duration (self->sink_pad, GST_FORMAT_BYTES, &size))
+      self->upstream_size = size;
+
+    if (!gst_pcap_parse_load_index (self)) {
+      ret = gst_pcap_parse_build_index (self);
+      if (ret != GST_FLOW_OK)
+        goto pause;
+      gst_pcap_parse_save_index (self);
+    }
+
+    self->index_done = TRUE;
+    self->base_ts = self->first_ts;
+    self->pull_offset = PCAP_FILE_HEADER_LEN;
+
+    gst_segment_init (&self->segment, GST_FORMAT_TIME);
+    if (GST_CLOCK_TIME_IS_VALID (self->first_ts)) {
+      self->segment.start = gst_pcap_parse_output_ts (self, self->first_ts);
+      self->segment.position = self->segment.start;
+      self->segment.duration = self->last_ts - self->first_ts;
+    }
+    self->need_segment = TRUE;
+  }
+
+  if (G_UNLIKELY (!self->stream_started))
+    gst_pcap_parse_start_streams (self);
+
+  if (G_UNLIKELY (self->need_segment)) {
+    GstEvent *event;
+
+    event = gst_event_new_segment (&self->segment);
+    if (self->seqnum)
+      gst_event_set_seqnum (event, self->seqnum);
+    gst_pcap_parse_push_src_event (self, event);
+    self->need_segment = FALSE;
+  }
+
+  ret = gst_pcap_parse_pull_record (self, self->pull_offset, &ts, &incl_len);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  ret = gst_pcap_parse_handle_record (self, ts, incl_len);
+  self->pull_offset += PCAP_RECORD_HEADER_LEN + incl_len;
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  return;
+
+pause:
+  {
+    const gchar *reason = gst_flow_get_name (ret);
+
+    GST_LOG_OBJECT (self, "pausing task, reason %s", reason);
+    gst_pad_pause_task (pad);
+
+    if (ret == GST_FLOW_EOS) {
+      GstEvent *e;
+
+      e = gst_event_new_eos ();
+      if (self->seqnum)
+        gst_event_set_seqnum (e, self->seqnum);
+      gst_pcap_parse_push_src_event (self, e);
+    } else if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS) {
+      GstEvent *e;
+
+      GST_ELEMENT_ERROR (self, STREAM, FAILED,
+          ("Internal data stream error."),
+          ("stream stopped, reason %s", reason));
+      e = gst_event_new_eos ();
+      if (self->seqnum)
+        gst_event_set_seqnum (e, self->seqnum);
+      gst_pcap_parse_push_src_event (self, e);
+    }
+  }
+}
+
+static gboolean
+gst_pcap_parse_perform_seek (GstPcapParse * self, GstEvent * event)
+{
+  GstFormat format;
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  gint64 start, stop;
+  gdouble rate;
+  gboolean flush;
+  guint32 seqnum;
+  GstClockTime first;
+  guint i;
+
+  gst_event_parse_seek (event, &rate, &format, &flags,
+      &start_type, &start, &stop_type, &stop);
+  seqnum = gst_event_get_seqnum (event);
+
+  if (format != GST_FORMAT_TIME) {
+    GST_DEBUG_OBJECT (self, "seeking is only supported in TIME format");
+    return FALSE;
+  }
+
+  if (rate != 1.0) {
+    GST_DEBUG_OBJECT (self, "only a rate of 1.0 is supported");
+    return FALSE;
+  }
+
+  if (start_type == GST_SEEK_TYPE_END || stop_type == GST_SEEK_TYPE_END) {
+    GST_DEBUG_OBJECT (self, "seeking relative to the end is not supported");
+    return FALSE;
+  }
+
+  flush = ! !(flags & GST_SEEK_FLAG_FLUSH);
+
+  if (flush) {
+    GstEvent *e;
+
+    e = gst_event_new_flush_start ();
+    gst_event_set_seqnum (e, seqnum);
+    gst_pcap_parse_push_src_event (self, e);
+  } else {
+    gst_pad_pause_task (self->sink_pad);
+  }
+
+  GST_PAD_STREAM_LOCK (self->sink_pad);
+
+  if (!self->index_done || !GST_CLOCK_TIME_IS_VALID (self->first_ts)) {
+    GST_DEBUG_OBJECT (self, "no index yet, can't seek");
+    if (flush) {
+      GstEvent *e;
+
+      e = gst_event_new_flush_stop (TRUE);
+      gst_event_set_seqnum (e, seqnum);
+      gst_pcap_parse_push_src_event (self, e);
+    }
+    gst_pad_start_task (self->sink_pad, (GstTaskFunction) gst_pcap_parse_loop,
+        self->sink_pad, NULL);
+    GST_PAD_STREAM_UNLOCK (self->sink_pad);
+    return FALSE;
+  }
+
+  /* seek positions are relative to the first packet of the capture */
+  first = gst_pcap_parse_output_ts (self, self->first_ts);
+
+  if (start_type == GST_SEEK_TYPE_SET) {
+    self->segment.start = first + start;
+    self->segment.time = start;
+  }
+  if (stop_type == GST_SEEK_TYPE_SET) {
+    if (stop == -1)
+      self->segment.stop = -1;
+    else
+      self->segment.stop = first + stop;
+  }
+  self->segment.position = self->segment.start;
+
+  self->pull_offset = gst_pcap_parse_index_lookup (self,
+      gst_pcap_parse_input_ts (self, self->segment.start));
+
+  GST_DEBUG_OBJECT (self, "seeking to offset %" G_GUINT64_FORMAT ", segment %"
+      GST_SEGMENT_FORMAT, self->pull_offset, &self->segment);
+
+  self->discont = TRUE;
+  for (i = 0; i < self->flow_list->len; i++) {
+    GstPcapParseFlow *flow = g_ptr_array_index (self->flow_list, i);
+
+    flow->discont = TRUE;
+  }
+  gst_flow_combiner_reset (self->flowcombiner);
+
+  self->need_segment = TRUE;
+  self->seqnum = seqnum;
+
+  if (flush) {
+    GstEvent *e;
+
+    e = gst_event_new_flush_stop (TRUE);
+    gst_event_set_seqnum (e, seqnum);
+    gst_pcap_parse_push_src_event (self, e);
+  }
+
+  gst_pad_start_task (self->sink_pad, (GstTaskFunction) gst_pcap_parse_loop,
+      self->sink_pad, NULL);
+
+  GST_PAD_STREAM_UNLOCK (self->sink_pad);
+
+  return TRUE;
+}
+
+static gboolean
+gst_pcap_parse_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (parent);
+  gboolean ret;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEEK:
+      if (self->pull_mode) {
+        ret = gst_pcap_parse_perform_seek (self, event);
+        gst_event_unref (event);
+      } else {
+        ret = gst_pad_event_default (pad, parent, event);
+      }
+      break;
+    default:
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_pcap_parse_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (parent);
+  gboolean ret = FALSE;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_DURATION:
+    {
+      GstFormat format;
+
+      gst_query_parse_duration (query, &format, NULL);
+      if (self->pull_mode && self->index_done && format == GST_FORMAT_TIME &&
+          GST_CLOCK_TIME_IS_VALID (self->first_ts)) {
+        gst_query_set_duration (query, GST_FORMAT_TIME,
+            self->last_ts - self->first_ts);
+        ret = TRUE;
+      } else {
+        ret = gst_pad_query_default (pad, parent, query);
+      }
+      break;
+    }
+    case GST_QUERY_SEEKING:
+    {
+      GstFormat format;
+
+      gst_query_parse_seeking (query, &format, NULL, NULL, NULL);
+      if (self->pull_mode && format == GST_FORMAT_TIME) {
+        gst_query_set_seeking (query, GST_FORMAT_TIME, self->index_done, 0,
+            self->index_done ? self->last_ts - self->first_ts : -1);
+        ret = TRUE;
+      } else {
+        ret = gst_pad_query_default (pad, parent, query);
+      }
+      break;
+    }
+    default:
+      ret = gst_pad_query_default (pad, parent, query);
+      break;
+  }
+
+  return ret;
+}
+
+static GstStateChangeReturn
+gst_pcap_parse_change_state (GstElement * element, GstStateChange transition)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (element);
+  GstStateChangeReturn ret;
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_pcap_parse_reset (self);
+      gst_pcap_parse_reset_pull (self);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
@@ -22,6 +22,7 @@
 
 #include <gst/gst.h>
 #include <gst/base/gstadapter.h>
+#include <gst/base/gstflowcombiner.h>
 
 G_BEGIN_DECLS
 
@@ -52,6 +53,34 @@ typedef enum
   LINKTYPE_SLL = 113
 } GstPcapParseLinktype;
 
+/* Identifies a UDP flow by its IP addresses and ports. IPv4 addresses are
+ * stored in the first four bytes of the address arrays. */
+typedef struct
+{
+  guint8 ip_version;
+  guint8 protocol;
+  guint16 src_port;
+  guint16 dst_port;
+  guint8 src_addr[16];
+  guint8 dst_addr[16];
+} GstPcapParseFlowKey;
+
+typedef struct
+{
+  GstPcapParseFlowKey key;
+  guint id;
+  GstPad *pad;
+  guint64 packets;
+  gboolean discont;
+} GstPcapParseFlow;
+
+/* One entry of the sparse seek index, pointing at a record header */
+typedef struct
+{
+  guint64 offset;
+  GstClockTime ts;
+} GstPcapParseIndexEntry;
+
 /**
  * GstPcapParse:
  *
@@ -73,6 +102,8 @@ struct _GstPcapParse
   gint32 dst_port;
   GstCaps *caps;
   gint64 offset;
+  gboolean split_flows;
+  gchar *index_location;
 
   /* state */
   GstAdapter * adapter;
@@ -84,6 +115,25 @@ struct _GstPcapParse
   GstPcapParseLinktype linktype;
 
   gboolean newsegment_sent;
+
+  /* pull mode */
+  gboolean pull_mode;
+  guint64 pull_offset;
+  gboolean discont;
+  GstBuffer *pull_buf;
+  guint64 pull_buf_offset;
+  guint64 upstream_size;
+  gboolean index_done;
+  GArray *index;
+  GstClockTime first_ts;
+  GstClockTime last_ts;
+  GHashTable *flows;
+  GPtrArray *flow_list;
+  GstFlowCombiner *flowcombiner;
+  GstSegment segment;
+  gboolean need_segment;
+  gboolean stream_started;
+  guint32 seqnum;
 };
 
 struct _GstPcapParseClass
@@ -59,6 +59,10 @@ static gboolean gst_raw_parse_handle_seek_pull (GstRawParse * rp,
 
 static void gst_raw_parse_reset (GstRawParse * rp);
 
+/* In pull mode, as many frames as fit in this many bytes are read at once
+ * and pushed as sub-buffers */
+#define PULL_BLOCK_SIZE (4 * 1024 * 1024)
+
 static GstStaticPadTemplate gst_raw_parse_sink_pad_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -232,11 +236,14 @@ gst_raw_parse_push_buffer (GstRawParse * rp, GstBuffer * buffer)
 {
   GstFlowReturn ret;
   gint nframes;
+  gsize size;
   GstRawParseClass *rpclass;
 
   rpclass = GST_RAW_PARSE_GET_CLASS (rp);
 
-  nframes = gst_buffer_get_size (buffer) / rp->framesize;
+  /* set_buffer_flags() may change the buffer layout, keep the input size */
+  size = gst_buffer_get_size (buffer);
+  nframes = size / rp->framesize;
 
   if (rp->segment.rate < 0) {
     rp->n_frames -= nframes;
@@ -267,7 +274,7 @@ gst_raw_parse_push_buffer (GstRawParse * rp, GstBuffer * buffer)
   }
 
   if (rp->segment.rate >= 0) {
-    rp->offset += gst_buffer_get_size (buffer);
+    rp->offset += size;
     rp->n_frames += nframes;
   }
 
@@ -315,7 +322,9 @@ gst_raw_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
   }
 
   while (buffersize > 0 && gst_adapter_available (rp->adapter) >= buffersize) {
-    buffer = gst_adapter_take_buffer (rp->adapter, buffersize);
+    /* frames straddling input buffers get their memory from each of them
+     * instead of being copied */
+    buffer = gst_adapter_take_buffer_fast (rp->adapter, buffersize);
 
     ret = gst_raw_parse_push_buffer (rp, buffer);
     if (ret != GST_FLOW_OK)
@@ -370,6 +379,9 @@ gst_raw_parse_loop (GstElement * element)
 
   if (rp_class->multiple_frames_per_buffer && rp->framesize < 4096)
     size = 4096 - (4096 % rp->framesize);
+  else if (!rp_class->multiple_frames_per_buffer && rp->segment.rate >= 0
+      && rp->framesize < PULL_BLOCK_SIZE)
+    size = PULL_BLOCK_SIZE - (PULL_BLOCK_SIZE % rp->framesize);
   else
     size = rp->framesize;
 
@@ -414,7 +426,8 @@ gst_raw_parse_loop (GstElement * element)
         ", got only %" G_GSIZE_FORMAT " of %u bytes", rp->offset,
         gst_buffer_get_size (buffer), size);
 
-    if (size > rp->framesize) {
+    if (size > rp->framesize
+        && gst_buffer_get_size (buffer) >= rp->framesize) {
       gst_buffer_set_size (buffer, gst_buffer_get_size (buffer) -
           gst_buffer_get_size (buffer) % rp->framesize);
     } else {
@@ -425,7 +438,24 @@ gst_raw_parse_loop (GstElement * element)
     }
   }
 
-  ret = gst_raw_parse_push_buffer (rp, buffer);
+  if (!rp_class->multiple_frames_per_buffer
+      && gst_buffer_get_size (buffer) > rp->framesize) {
+    gsize offset, buffer_size = gst_buffer_get_size (buffer);
+
+    /* split the block into frames sharing its memory */
+    for (offset = 0; offset + rp->framesize <= buffer_size;
+        offset += rp->framesize) {
+      GstBuffer *frame = gst_buffer_copy_region (buffer,
+          GST_BUFFER_COPY_MEMORY, offset, rp->framesize);
+
+      ret = gst_raw_parse_push_buffer (rp, frame);
+      if (ret != GST_FLOW_OK)
+        break;
+    }
+    gst_buffer_unref (buffer);
+  } else {
+    ret = gst_raw_parse_push_buffer (rp, buffer);
+  }
   if (ret != GST_FLOW_OK)
     goto pause;
 
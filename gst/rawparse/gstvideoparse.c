@@ -23,6 +23,13 @@
  * SECTION:element-videoparse
  *
  * Converts a byte stream into video frames.
+ *
+ * The frames are sub-buffers of the input, no data is copied. The
+ * #GstVideoParse:strides, #GstVideoParse:offsets and
+ * #GstVideoParse:framesize properties describe streams whose planes are not
+ * laid out as the format's defaults, for example with padded lines or
+ * frames. Such frames are described with a #GstVideoMeta, or copied to the
+ * default layout if downstream does not support it.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -42,6 +49,49 @@ static void gst_video_parse_set_buffer_flags (GstRawParse * rp,
 
 static void gst_video_parse_update_frame_size (GstVideoParse * vp);
 
+/* Parses a comma separated list of at most GST_VIDEO_MAX_PLANES integers */
+static guint
+gst_video_parse_int_list_from_string (const gchar * str, gint64 * values)
+{
+  gchar **split;
+  guint i, n = 0;
+
+  if (str == NULL)
+    return 0;
+
+  split = g_strsplit (str, ",", -1);
+  for (i = 0; split[i] != NULL && n < GST_VIDEO_MAX_PLANES; i++) {
+    gchar *end;
+    gint64 v = g_ascii_strtoll (split[i], &end, 10);
+
+    if (end == split[i] || v < 0) {
+      GST_WARNING ("invalid plane value '%s'", split[i]);
+      break;
+    }
+    values[n++] = v;
+  }
+  g_strfreev (split);
+
+  return n;
+}
+
+static gchar *
+gst_video_parse_int_list_to_string (const gint64 * values, guint n)
+{
+  GString *str;
+  guint i;
+
+  if (n == 0)
+    return NULL;
+
+  str = g_string_new (NULL);
+  for (i = 0; i < n; i++)
+    g_string_append_printf (str, "%s%" G_GINT64_FORMAT, i ? "," : "",
+        values[i]);
+
+  return g_string_free (str, FALSE);
+}
+
 GST_DEBUG_CATEGORY_STATIC (gst_video_parse_debug);
 #define GST_CAT_DEFAULT gst_video_parse_debug
 
@@ -54,7 +104,10 @@ enum
   PROP_PAR,
   PROP_FRAMERATE,
   PROP_INTERLACED,
-  PROP_TOP_FIELD_FIRST
+  PROP_TOP_FIELD_FIRST,
+  PROP_STRIDES,
+  PROP_OFFSETS,
+  PROP_FRAMESIZE
 };
 
 #define gst_video_parse_parent_class parent_class
@@ -100,6 +153,21 @@ gst_video_parse_class_init (GstVideoParseClass * klass)
       g_param_spec_boolean ("top-field-first", "Top field first",
           "True if top field is earlier than bottom field", TRUE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_STRIDES,
+      g_param_spec_string ("strides", "Strides",
+          "Stride of each plane in bytes using string format: 's0,s1,s2,s3', "
+          "0 or missing planes use the default stride", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_OFFSETS,
+      g_param_spec_string ("offsets", "Offsets",
+          "Offset of each plane in bytes using string format: 'o0,o1,o2,o3', "
+          "missing planes follow the previous one", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_FRAMESIZE,
+      g_param_spec_uint ("framesize", "Framesize",
+          "Size of a frame in bytes including padding, "
+          "0 for the size of the planes", 0, G_MAXUINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_set_static_metadata (gstelement_class, "Video Parse",
       "Filter/Video",
@@ -163,6 +231,29 @@ gst_video_parse_set_property (GObject * object, guint prop_id,
     case PROP_TOP_FIELD_FIRST:
       vp->top_field_first = g_value_get_boolean (value);
       break;
+    case PROP_STRIDES:{
+      gint64 values[GST_VIDEO_MAX_PLANES];
+      guint i;
+
+      vp->n_strides = gst_video_parse_int_list_from_string
+          (g_value_get_string (value), values);
+      for (i = 0; i < vp->n_strides; i++)
+        vp->stride[i] = CLAMP (values[i], 0, G_MAXINT);
+      break;
+    }
+    case PROP_OFFSETS:{
+      gint64 values[GST_VIDEO_MAX_PLANES];
+      guint i;
+
+      vp->n_offsets = gst_video_parse_int_list_from_string
+          (g_value_get_string (value), values);
+      for (i = 0; i < vp->n_offsets; i++)
+        vp->offset[i] = values[i];
+      break;
+    }
+    case PROP_FRAMESIZE:
+      vp->framesize = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -203,23 +294,149 @@ gst_video_parse_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_TOP_FIELD_FIRST:
       g_value_set_boolean (value, vp->top_field_first);
       break;
+    case PROP_STRIDES:{
+      gint64 values[GST_VIDEO_MAX_PLANES];
+      guint i;
+
+      for (i = 0; i < vp->n_strides; i++)
+        values[i] = vp->stride[i];
+      g_value_take_string (value,
+          gst_video_parse_int_list_to_string (values, vp->n_strides));
+      break;
+    }
+    case PROP_OFFSETS:{
+      gint64 values[GST_VIDEO_MAX_PLANES];
+      guint i;
+
+      for (i = 0; i < vp->n_offsets; i++)
+        values[i] = vp->offset[i];
+      g_value_take_string (value,
+          gst_video_parse_int_list_to_string (values, vp->n_offsets));
+      break;
+    }
+    case PROP_FRAMESIZE:
+      g_value_set_uint (value, vp->framesize);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static gint
+gst_video_parse_plane_height (const GstVideoInfo * info, guint plane)
+{
+  guint i;
+
+  for (i = 0; i < GST_VIDEO_INFO_N_COMPONENTS (info); i++) {
+    if (GST_VIDEO_INFO_COMP_PLANE (info, i) == plane)
+      return GST_VIDEO_INFO_COMP_HEIGHT (info, i);
+  }
+
+  return GST_VIDEO_INFO_HEIGHT (info);
+}
+
 void
 gst_video_parse_update_frame_size (GstVideoParse * vp)
 {
-  gint framesize;
+  GstVideoInfo *info = &vp->info;
+  GstVideoInfo default_info;
+  gsize size = 0;
+  guint i, n_planes;
+
+  gst_video_info_init (&default_info);
+  gst_video_info_set_format (&default_info, vp->format, vp->width,
+      vp->height);
+  *info = default_info;
+
+  /* lay the planes out with the configured strides and offsets, planes
+   * without an offset follow the previous one */
+  n_planes = GST_VIDEO_INFO_N_PLANES (info);
+  for (i = 0; i < n_planes; i++) {
+    if (i < vp->n_strides && vp->stride[i] > 0)
+      info->stride[i] = vp->stride[i];
+
+    if (i < vp->n_offsets)
+      info->offset[i] = vp->offset[i];
+    else if (i > 0)
+      info->offset[i] = info->offset[i - 1] + (gsize) info->stride[i - 1] *
+          gst_video_parse_plane_height (info, i - 1);
+
+    size = MAX (size, info->offset[i] + (gsize) info->stride[i] *
+        gst_video_parse_plane_height (info, i));
+  }
+  info->size = size;
+
+  vp->custom_layout = FALSE;
+  for (i = 0; i < n_planes; i++) {
+    if (info->offset[i] != default_info.offset[i] ||
+        info->stride[i] != default_info.stride[i])
+      vp->custom_layout = TRUE;
+  }
+
+  if (vp->framesize > 0) {
+    if (vp->framesize < size)
+      GST_WARNING_OBJECT (vp, "framesize %u is smaller than the planes (%"
+          G_GSIZE_FORMAT " bytes), ignoring it", vp->framesize, size);
+    else
+      size = vp->framesize;
+  }
+
+  GST_DEBUG_OBJECT (vp, "framesize %" G_GSIZE_FORMAT ", custom layout %d",
+      size, vp->custom_layout);
+
+  vp->meta_checked = FALSE;
+  gst_raw_parse_set_framesize (GST_RAW_PARSE (vp), size);
+}
+
+static gboolean
+gst_video_parse_downstream_supports_meta (GstVideoParse * vp)
+{
+  GstPad *srcpad = GST_RAW_PARSE (vp)->srcpad;
+  GstCaps *caps;
+  GstQuery *query;
+  gboolean res = FALSE;
+
+  caps = gst_pad_get_current_caps (srcpad);
+  if (caps == NULL)
+    return FALSE;
+
+  query = gst_query_new_allocation (caps, FALSE);
+  if (gst_pad_peer_query (srcpad, query))
+    res = gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE,
+        NULL);
+  gst_query_unref (query);
+  gst_caps_unref (caps);
+
+  return res;
+}
+
+/* Copies the frame in @buffer to the default layout, for downstream
+ * elements that don't support GstVideoMeta */
+static void
+gst_video_parse_copy_to_default_layout (GstVideoParse * vp, GstBuffer * buffer)
+{
   GstVideoInfo info;
+  GstVideoFrame src, dest;
+  GstBuffer *outbuf;
 
   gst_video_info_init (&info);
   gst_video_info_set_format (&info, vp->format, vp->width, vp->height);
-  framesize = GST_VIDEO_INFO_SIZE (&info);
 
-  gst_raw_parse_set_framesize (GST_RAW_PARSE (vp), framesize);
+  outbuf = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info), NULL);
+
+  if (!gst_video_frame_map (&src, &vp->info, buffer, GST_MAP_READ)) {
+    GST_WARNING_OBJECT (vp, "could not map frame");
+    gst_buffer_unref (outbuf);
+    return;
+  }
+  gst_video_frame_map (&dest, &info, outbuf, GST_MAP_WRITE);
+  gst_video_frame_copy (&dest, &src);
+  gst_video_frame_unmap (&dest);
+  gst_video_frame_unmap (&src);
+
+  gst_buffer_replace_all_memory (buffer, gst_buffer_get_all_memory (outbuf));
+  gst_buffer_unref (outbuf);
 }
 
 static GstCaps *
@@ -252,6 +469,25 @@ gst_video_parse_set_buffer_flags (GstRawParse * rp, GstBuffer * buffer)
 {
   GstVideoParse *vp = GST_VIDEO_PARSE (rp);
 
+  if (vp->custom_layout) {
+    if (!vp->meta_checked) {
+      vp->use_meta = gst_video_parse_downstream_supports_meta (vp);
+      vp->meta_checked = TRUE;
+      GST_DEBUG_OBJECT (vp, "downstream %s GstVideoMeta",
+          vp->use_meta ? "supports" : "does not support");
+    }
+
+    if (vp->use_meta) {
+      gst_buffer_add_video_meta_full (buffer, vp->interlaced ?
+          GST_VIDEO_FRAME_FLAG_INTERLACED : GST_VIDEO_FRAME_FLAG_NONE,
+          vp->format, vp->width, vp->height,
+          GST_VIDEO_INFO_N_PLANES (&vp->info), vp->info.offset,
+          vp->info.stride);
+    } else {
+      gst_video_parse_copy_to_default_layout (vp, buffer);
+    }
+  }
+
   if (vp->interlaced) {
     if (vp->top_field_first) {
       GST_BUFFER_FLAG_SET (buffer, GST_VIDEO_BUFFER_FLAG_TFF);
@@ -55,6 +55,19 @@ struct _GstVideoParse
   gint par_n, par_d;
   gboolean interlaced;
   gboolean top_field_first;
+  gint stride[GST_VIDEO_MAX_PLANES];
+  guint n_strides;
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  guint n_offsets;
+  guint framesize;
+
+  /* layout of the frames in the stream */
+  GstVideoInfo info;
+  /* TRUE if the planes are not where the caps put them */
+  gboolean custom_layout;
+  /* TRUE if downstream was asked whether it supports GstVideoMeta */
+  gboolean meta_checked;
+  gboolean use_meta;
 };
 
 struct _GstVideoParseClass
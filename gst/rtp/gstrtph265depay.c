@@ -158,8 +158,10 @@ static void
 gst_rtp_h265_depay_reset (GstRtpH265Depay * rtph265depay)
 {
   gst_adapter_clear (rtph265depay->adapter);
+  rtph265depay->n_memories = 0;
   rtph265depay->wait_start = TRUE;
   gst_adapter_clear (rtph265depay->picture_adapter);
+  rtph265depay->picture_n_memories = 0;
   rtph265depay->picture_start = FALSE;
   rtph265depay->last_keyframe = FALSE;
   rtph265depay->last_ts = 0;
@@ -804,17 +806,55 @@ incomplete_caps:
   }
 }
 
+/* Takes all data of @adapter in one buffer. The memories of the queued
+ * buffers are chained without copying when the buffer can hold
+ * @n_memories of them, otherwise they are copied once. */
+static GstBuffer *
+gst_rtp_h265_depay_take_chained (GstAdapter * adapter, guint n_memories)
+{
+  gsize size = gst_adapter_available (adapter);
+
+  if (n_memories <= gst_buffer_get_max_memory ())
+    return gst_adapter_take_buffer_fast (adapter, size);
+  else
+    return gst_adapter_take_buffer (adapter, size);
+}
+
+/* Puts a start code or, for hvc1/hev1, the NAL size in front of @nal as a
+ * separate memory, the NAL data is not touched */
+static GstBuffer *
+gst_rtp_h265_depay_wrap_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal)
+{
+  GstMemory *prefix;
+
+  if (rtph265depay->byte_stream) {
+    prefix = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+        (gpointer) sync_bytes, sizeof (sync_bytes), 0, sizeof (sync_bytes),
+        NULL, NULL);
+  } else {
+    GstMapInfo map;
+
+    prefix = gst_allocator_alloc (NULL, 4, NULL);
+    gst_memory_map (prefix, &map, GST_MAP_WRITE);
+    GST_WRITE_UINT32_BE (map.data, gst_buffer_get_size (nal));
+    gst_memory_unmap (prefix, &map);
+  }
+  gst_buffer_prepend_memory (nal, prefix);
+
+  return nal;
+}
+
 static GstBuffer *
 gst_rtp_h265_complete_au (GstRtpH265Depay * rtph265depay,
     GstClockTime * out_timestamp, gboolean * out_keyframe)
 {
-  guint outsize;
   GstBuffer *outbuf;
 
   /* we had a picture in the adapter and we completed it */
   GST_DEBUG_OBJECT (rtph265depay, "taking completed AU");
-  outsize = gst_adapter_available (rtph265depay->picture_adapter);
-  outbuf = gst_adapter_take_buffer (rtph265depay->picture_adapter, outsize);
+  outbuf = gst_rtp_h265_depay_take_chained (rtph265depay->picture_adapter,
+      rtph265depay->picture_n_memories);
+  rtph265depay->picture_n_memories = 0;
 
   *out_timestamp = rtph265depay->last_ts;
   *out_keyframe = rtph265depay->last_keyframe;
@@ -855,16 +895,18 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
 {
   GstRTPBaseDepayload *depayload = GST_RTP_BASE_DEPAYLOAD (rtph265depay);
   gint nal_type;
-  GstMapInfo map;
+  guint8 header[3] = { 0, };
   GstBuffer *outbuf = NULL;
   GstClockTime out_timestamp;
   gboolean keyframe, out_keyframe;
 
-  gst_buffer_map (nal, &map, GST_MAP_READ);
-  if (G_UNLIKELY (map.size < 5))
+  /* the NAL is made of several memories, only read the bytes needed so they
+   * are not merged */
+  if (G_UNLIKELY (gst_buffer_get_size (nal) < 5))
     goto short_nal;
+  gst_buffer_extract (nal, 4, header, 3);
 
-  nal_type = (map.data[4] >> 1) & 0x3f;
+  nal_type = (header[0] >> 1) & 0x3f;
   GST_DEBUG_OBJECT (rtph265depay, "handle NAL type %d (RTP marker bit %d)",
       nal_type, marker);
 
@@ -878,7 +920,6 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
       gst_rtp_h265_depay_add_vps_sps_pps (rtph265depay,
           gst_buffer_copy_region (nal, GST_BUFFER_COPY_ALL,
               4, gst_buffer_get_size (nal) - 4));
-      gst_buffer_unmap (nal, &map);
       gst_buffer_unref (nal);
       return NULL;
     } else if (rtph265depay->sps->len == 0 || rtph265depay->pps->len == 0) {
@@ -889,7 +930,6 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
           gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
               gst_structure_new ("GstForceKeyUnit",
                   "all-headers", G_TYPE_BOOLEAN, TRUE, NULL)));
-      gst_buffer_unmap (nal, &map);
       gst_buffer_unref (nal);
       return NULL;
     }
@@ -909,7 +949,7 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
       if (NAL_TYPE_IS_CODED_SLICE_SEGMENT (nal_type)) {
         /* A NAL unit (X) ends an access unit if the next-occurring VCL NAL unit (Y) has the high-order bit of the first byte after its NAL unit header equal to 1 */
         start = TRUE;
-        if (((map.data[6] >> 7) & 0x01) == 1) {
+        if (((header[2] >> 7) & 0x01) == 1) {
           complete = TRUE;
         }
         complete = TRUE;
@@ -926,9 +966,8 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
             &out_keyframe);
     }
     /* add to adapter */
-    gst_buffer_unmap (nal, &map);
-
     GST_DEBUG_OBJECT (depayload, "adding NAL to picture adapter");
+    rtph265depay->picture_n_memories += gst_buffer_n_memory (nal);
     gst_adapter_push (rtph265depay->picture_adapter, nal);
     rtph265depay->last_ts = in_timestamp;
     rtph265depay->last_keyframe |= keyframe;
@@ -941,7 +980,6 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
     /* no merge, output is input nal */
     GST_DEBUG_OBJECT (depayload, "using NAL as output");
     outbuf = nal;
-    gst_buffer_unmap (nal, &map);
   }
 
   if (outbuf) {
@@ -968,7 +1006,6 @@ gst_rtp_h265_depay_handle_nal (GstRtpH265Depay * rtph265depay, GstBuffer * nal,
 short_nal:
   {
     GST_WARNING_OBJECT (depayload, "dropping short NAL");
-    gst_buffer_unmap (nal, &map);
     gst_buffer_unref (nal);
     return NULL;
   }
@@ -978,22 +1015,17 @@ static GstBuffer *
 gst_rtp_h265_push_fragmentation_unit (GstRtpH265Depay * rtph265depay,
     gboolean send)
 {
-  guint outsize;
-  GstMapInfo map;
   GstBuffer *outbuf;
 
-  outsize = gst_adapter_available (rtph265depay->adapter);
-  outbuf = gst_adapter_take_buffer (rtph265depay->adapter, outsize);
+  /* one more memory for the prefix */
+  outbuf = gst_rtp_h265_depay_take_chained (rtph265depay->adapter,
+      rtph265depay->n_memories + 1);
+  rtph265depay->n_memories = 0;
 
-  gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-  GST_DEBUG_OBJECT (rtph265depay, "output %d bytes", outsize);
+  GST_DEBUG_OBJECT (rtph265depay, "output %" G_GSIZE_FORMAT " bytes",
+      gst_buffer_get_size (outbuf));
 
-  if (rtph265depay->byte_stream) {
-    memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-  } else {
-    goto not_implemented;
-  }
-  gst_buffer_unmap (outbuf, &map);
+  outbuf = gst_rtp_h265_depay_wrap_nal (rtph265depay, outbuf);
 
   rtph265depay->current_fu_type = 0;
 
@@ -1005,14 +1037,6 @@ gst_rtp_h265_push_fragmentation_unit (GstRtpH265Depay * rtph265depay,
     outbuf = NULL;
   }
   return outbuf;
-
-not_implemented:
-  {
-    GST_ERROR_OBJECT (rtph265depay,
-        ("Only bytestream format is currently supported."));
-    gst_buffer_unmap (outbuf, &map);
-    return NULL;
-  }
 }
 
 static GstBuffer *
@@ -1028,16 +1052,17 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
   /* flush remaining data on discont */
   if (GST_BUFFER_IS_DISCONT (buf)) {
     gst_adapter_clear (rtph265depay->adapter);
+    rtph265depay->n_memories = 0;
     rtph265depay->wait_start = TRUE;
     rtph265depay->current_fu_type = 0;
   }
 
   {
     gint payload_len;
-    guint8 *payload;
+    guint8 *payload, *payload_start;
     guint header_len;
     GstMapInfo map;
-    guint outsize, nalu_size;
+    guint nalu_size;
     GstClockTime timestamp;
     gboolean marker;
     guint8 nuh_layer_id, nuh_temporal_id_plus1;
@@ -1052,7 +1077,7 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
     gst_rtp_buffer_map (buf, GST_MAP_READ, &rtp);
 
     payload_len = gst_rtp_buffer_get_payload_len (&rtp);
-    payload = gst_rtp_buffer_get_payload (&rtp);
+    payload = payload_start = gst_rtp_buffer_get_payload (&rtp);
     marker = gst_rtp_buffer_get_marker (&rtp);
 
     GST_DEBUG_OBJECT (rtph265depay, "receiving %d bytes", payload_len);
@@ -1071,7 +1096,7 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
      */
     nal_unit_type = (payload[0] >> 1) & 0x3f;
     nuh_layer_id = ((payload[0] & 0x01) << 5) | (payload[1] >> 3);      /* should be zero for now but this could change in future HEVC extensions */
-    nuh_temporal_id_plus1 = payload[1] & 0x03;
+    nuh_temporal_id_plus1 = payload[1] & 0x07;
 
     /* At least two byte header with type */
     header_len = 2;
@@ -1135,7 +1160,9 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
           goto not_implemented_donl_present;
 #endif
 
+        outbuf = NULL;
         while (payload_len > 2) {
+          gboolean last;
 
           nalu_size = (payload[0] << 8) | payload[1];
 
@@ -1143,34 +1170,27 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
           if (nalu_size > (payload_len - 2))
             nalu_size = payload_len - 2;
 
-          outsize = nalu_size + sizeof (sync_bytes);
-          outbuf = gst_buffer_new_and_alloc (outsize);
-
-          gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-          if (rtph265depay->byte_stream) {
-            memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-          } else {
-            goto not_implemented;
-          }
-
           /* strip NALU size */
           payload += 2;
           payload_len -= 2;
 
-          memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-          gst_buffer_unmap (outbuf, &map);
+          last = payload_len - nalu_size <= 2;
 
-          gst_adapter_push (rtph265depay->adapter, outbuf);
+          /* push what the previous NAL completed */
+          if (outbuf)
+            gst_rtp_base_depayload_push (depayload, outbuf);
+
+          /* each NAL shares the memory of the packet */
+          outbuf = gst_rtp_buffer_get_payload_subbuffer (&rtp,
+              payload - payload_start, nalu_size);
+          outbuf = gst_rtp_h265_depay_wrap_nal (rtph265depay, outbuf);
+
+          outbuf = gst_rtp_h265_depay_handle_nal (rtph265depay, outbuf,
+              timestamp, marker && last);
 
           payload += nalu_size;
           payload_len -= nalu_size;
         }
-
-        outsize = gst_adapter_available (rtph265depay->adapter);
-        outbuf = gst_adapter_take_buffer (rtph265depay->adapter, outsize);
-
-        outbuf = gst_rtp_h265_depay_handle_nal (rtph265depay, outbuf, timestamp,
-            marker);
         break;
       }
       case 49:
@@ -1236,42 +1256,31 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
               ((payload[0] & 0x3f) << 9) | (nuh_layer_id << 3) |
               nuh_temporal_id_plus1;
 
-          /* go back one byte so we can copy the payload + two bytes more in the front which
-           * will be overwritten by the nal_header
-           */
-          payload -= 1;
-          payload_len += 1;
-
-          nalu_size = payload_len;
-          outsize = nalu_size + sizeof (sync_bytes);
-          outbuf = gst_buffer_new_and_alloc (outsize);
-
+          /* the rebuilt NAL header is the only data that is not shared with
+           * the packets */
+          outbuf = gst_buffer_new_allocate (NULL, 2, NULL);
           gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-          memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-          map.data[sizeof (sync_bytes)] = nal_header >> 8;
-          map.data[sizeof (sync_bytes) + 1] = nal_header & 0xff;
+          GST_WRITE_UINT16_BE (map.data, nal_header);
           gst_buffer_unmap (outbuf, &map);
 
-          GST_DEBUG_OBJECT (rtph265depay, "queueing %d bytes", outsize);
-
-          /* and assemble in the adapter */
+          rtph265depay->n_memories++;
           gst_adapter_push (rtph265depay->adapter, outbuf);
         } else {
-
           GST_DEBUG_OBJECT (rtph265depay,
               "Following part of Fragmentation Unit");
+        }
 
-          /* strip off FU header byte */
-          payload += 1;
-          payload_len -= 1;
-
-          outsize = payload_len;
-          outbuf = gst_buffer_new_and_alloc (outsize);
-          gst_buffer_fill (outbuf, 0, payload, outsize);
+        /* strip off FU header byte */
+        payload += 1;
+        payload_len -= 1;
 
-          GST_DEBUG_OBJECT (rtph265depay, "queueing %d bytes", outsize);
+        GST_DEBUG_OBJECT (rtph265depay, "queueing %d bytes", payload_len);
 
-          /* and assemble in the adapter */
+        /* and chain the payload in the adapter */
+        if (payload_len > 0) {
+          outbuf = gst_rtp_buffer_get_payload_subbuffer (&rtp,
+              payload - payload_start, payload_len);
+          rtph265depay->n_memories += gst_buffer_n_memory (outbuf);
           gst_adapter_push (rtph265depay->adapter, outbuf);
         }
 
@@ -1299,18 +1308,8 @@ gst_rtp_h265_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
           goto not_implemented_donl_present;
 #endif
 
-        nalu_size = payload_len;
-        outsize = nalu_size + sizeof (sync_bytes);
-        outbuf = gst_buffer_new_and_alloc (outsize);
-
-        gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
-        if (rtph265depay->byte_stream) {
-          memcpy (map.data, sync_bytes, sizeof (sync_bytes));
-        } else {
-          goto not_implemented;
-        }
-        memcpy (map.data + sizeof (sync_bytes), payload, nalu_size);
-        gst_buffer_unmap (outbuf, &map);
+        outbuf = gst_rtp_buffer_get_payload_buffer (&rtp);
+        outbuf = gst_rtp_h265_depay_wrap_nal (rtph265depay, outbuf);
 
         outbuf = gst_rtp_h265_depay_handle_nal (rtph265depay, outbuf, timestamp,
             marker);
@@ -61,11 +61,14 @@ struct _GstRtpH265Depay
 
   GstBuffer *codec_data;
   GstAdapter *adapter;
+  /* memories of the fragments in adapter */
+  guint n_memories;
   gboolean wait_start;
 
   /* nal merging */
   gboolean merge;
   GstAdapter *picture_adapter;
+  guint picture_n_memories;
   gboolean picture_start;
   GstClockTime last_ts;
   gboolean last_keyframe;
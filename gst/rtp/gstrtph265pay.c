@@ -45,6 +45,9 @@ GST_DEBUG_CATEGORY_STATIC (rtph265pay_debug);
  *
  * This draft will be replaced with an RFC, so some details may change.
  *
+ * RFC 7798 - RTP Payload Format for High Efficiency Video Coding (HEVC)
+ *   4.4.2. Aggregation Packets (APs)
+ *   4.4.3. Fragmentation Units (FUs)
  */
 
 static GstStaticPadTemplate gst_rtp_h265_pay_sink_template =
@@ -103,15 +106,25 @@ GST_STATIC_PAD_TEMPLATE ("src",
 
 #define DEFAULT_SPROP_PARAMETER_SETS    NULL
 #define DEFAULT_CONFIG_INTERVAL		      0
+#define DEFAULT_AGGREGATE               FALSE
 
 enum
 {
   PROP_0,
   PROP_SPROP_PARAMETER_SETS,
-  PROP_CONFIG_INTERVAL
+  PROP_CONFIG_INTERVAL,
+  PROP_AGGREGATE
 };
 
-#define IS_ACCESS_UNIT(x) (((x) > 0x00) && ((x) < 0x06))
+/* RTP payload types of RFC 7798 */
+#define AP_TYPE_ID  48
+#define FU_TYPE_ID  49
+
+/* VPS, SPS, PPS, AUD and prefix SEI come before the slices of their access
+ * unit */
+#define IS_LEADING_NAL(x) (((x) >= GST_H265_NAL_VPS) && \
+    ((x) <= GST_H265_NAL_PREFIX_SEI) && ((x) != GST_H265_NAL_EOS) && \
+    ((x) != GST_H265_NAL_EOB) && ((x) != GST_H265_NAL_FD))
 
 static void gst_rtp_h265_pay_finalize (GObject * object);
 
@@ -166,6 +179,13 @@ gst_rtp_h265_pay_class_init (GstRtpH265PayClass * klass)
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)
       );
 
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      PROP_AGGREGATE,
+      g_param_spec_boolean ("aggregate", "Aggregate",
+          "Combine NAL units of an access unit that fit in the MTU into "
+          "aggregation packets", DEFAULT_AGGREGATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gobject_class->finalize = gst_rtp_h265_pay_finalize;
 
   gst_element_class_add_pad_template (gstelement_class,
@@ -203,10 +223,25 @@ gst_rtp_h265_pay_init (GstRtpH265Pay * rtph265pay)
       (GDestroyNotify) gst_buffer_unref);
   rtph265pay->last_vps_sps_pps = -1;
   rtph265pay->vps_sps_pps_interval = DEFAULT_CONFIG_INTERVAL;
+  rtph265pay->aggregate = DEFAULT_AGGREGATE;
+  rtph265pay->ap_nals = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) gst_buffer_unref);
 
   rtph265pay->adapter = gst_adapter_new ();
 }
 
+static void
+gst_rtp_h265_pay_reset_packets (GstRtpH265Pay * rtph265pay)
+{
+  g_ptr_array_set_size (rtph265pay->ap_nals, 0);
+  rtph265pay->ap_size = 0;
+
+  if (rtph265pay->list) {
+    gst_buffer_list_unref (rtph265pay->list);
+    rtph265pay->list = NULL;
+  }
+}
+
 static void
 gst_rtp_h265_pay_clear_vps_sps_pps (GstRtpH265Pay * rtph265pay)
 {
@@ -228,6 +263,9 @@ gst_rtp_h265_pay_finalize (GObject * object)
   g_ptr_array_free (rtph265pay->pps, TRUE);
   g_ptr_array_free (rtph265pay->vps, TRUE);
 
+  gst_rtp_h265_pay_reset_packets (rtph265pay);
+  g_ptr_array_free (rtph265pay->ap_nals, TRUE);
+
   g_free (rtph265pay->sprop_parameter_sets);
 
   g_object_unref (rtph265pay->adapter);
@@ -851,6 +889,159 @@ gst_rtp_h265_pay_decode_nal (GstRtpH265Pay * payloader,
   return updated;
 }
 
+/* Adds an RTP packet to the packets of the current access unit */
+static void
+gst_rtp_h265_pay_add_packet (GstRtpH265Pay * rtph265pay, GstBuffer * outbuf)
+{
+  if (rtph265pay->list == NULL)
+    rtph265pay->list = gst_buffer_list_new ();
+
+  gst_buffer_list_add (rtph265pay->list, outbuf);
+}
+
+static GstFlowReturn
+gst_rtp_h265_pay_push_packets (GstRTPBasePayload * basepayload)
+{
+  GstRtpH265Pay *rtph265pay = GST_RTP_H265_PAY (basepayload);
+  GstBufferList *list = rtph265pay->list;
+
+  if (list == NULL)
+    return GST_FLOW_OK;
+
+  rtph265pay->list = NULL;
+
+  GST_LOG_OBJECT (rtph265pay, "pushing %u packets",
+      gst_buffer_list_length (list));
+
+  return gst_rtp_base_payload_push_list (basepayload, list);
+}
+
+/* Sends @paybuf in a single NAL unit packet */
+static void
+gst_rtp_h265_pay_add_single (GstRtpH265Pay * rtph265pay, GstBuffer * paybuf,
+    GstClockTime dts, GstClockTime pts, gboolean marker)
+{
+  GstRTPBuffer rtp = { NULL };
+  GstBuffer *outbuf;
+
+  /* create buffer without payload containing only the RTP header
+   * (memory block at index 0) */
+  outbuf = gst_rtp_buffer_new_allocate (0, 0, 0);
+
+  gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_marker (&rtp, marker);
+  gst_rtp_buffer_unmap (&rtp);
+
+  /* timestamp the outbuffer */
+  GST_BUFFER_PTS (outbuf) = pts;
+  GST_BUFFER_DTS (outbuf) = dts;
+
+  /* insert payload memory block */
+  outbuf = gst_buffer_append (outbuf, paybuf);
+
+  gst_rtp_h265_pay_add_packet (rtph265pay, outbuf);
+}
+
+/* Sends the pending NAL units in one aggregation packet, or in a single NAL
+ * unit packet when there is only one */
+static void
+gst_rtp_h265_pay_flush_ap (GstRtpH265Pay * rtph265pay, gboolean marker)
+{
+  GPtrArray *nals = rtph265pay->ap_nals;
+  GstRTPBuffer rtp = { NULL };
+  GstBuffer *outbuf;
+  GstMemory *sizes;
+  GstMapInfo map;
+  guint8 *payload;
+  guint8 f = 0, layer_id = 0x3f, tid = 0x7;
+  guint i;
+
+  if (nals->len == 0)
+    return;
+
+  if (nals->len == 1) {
+    gst_rtp_h265_pay_add_single (rtph265pay,
+        gst_buffer_ref (g_ptr_array_index (nals, 0)), rtph265pay->ap_dts,
+        rtph265pay->ap_pts, marker);
+    goto done;
+  }
+
+  GST_DEBUG_OBJECT (rtph265pay, "aggregating %u NAL units, %u bytes",
+      nals->len, rtph265pay->ap_size);
+
+  /* the size fields of all NAL units, shared into the packet */
+  sizes = gst_allocator_alloc (NULL, 2 * nals->len, NULL);
+  gst_memory_map (sizes, &map, GST_MAP_WRITE);
+  for (i = 0; i < nals->len; i++) {
+    GstBuffer *nal = g_ptr_array_index (nals, i);
+    guint8 header[2];
+
+    gst_buffer_extract (nal, 0, header, 2);
+    f |= header[0] & 0x80;
+    layer_id = MIN (layer_id, ((header[0] & 0x01) << 5) | (header[1] >> 3));
+    tid = MIN (tid, header[1] & 0x07);
+
+    GST_WRITE_UINT16_BE (map.data + 2 * i, gst_buffer_get_size (nal));
+  }
+  gst_memory_unmap (sizes, &map);
+
+  /* PayloadHdr (type = 48) with the lowest LayerId and TID of the NAL units
+   * and F set if any of them has it */
+  outbuf = gst_rtp_buffer_new_allocate (2, 0, 0);
+  gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
+  payload = gst_rtp_buffer_get_payload (&rtp);
+  payload[0] = f | (AP_TYPE_ID << 1) | (layer_id >> 5);
+  payload[1] = ((layer_id & 0x1f) << 3) | tid;
+  gst_rtp_buffer_set_marker (&rtp, marker);
+  gst_rtp_buffer_unmap (&rtp);
+
+  GST_BUFFER_PTS (outbuf) = rtph265pay->ap_pts;
+  GST_BUFFER_DTS (outbuf) = rtph265pay->ap_dts;
+
+  for (i = 0; i < nals->len; i++) {
+    gst_buffer_append_memory (outbuf, gst_memory_share (sizes, 2 * i, 2));
+    outbuf = gst_buffer_append (outbuf,
+        gst_buffer_ref (g_ptr_array_index (nals, i)));
+  }
+  gst_memory_unref (sizes);
+
+  gst_rtp_h265_pay_add_packet (rtph265pay, outbuf);
+
+done:
+  g_ptr_array_set_size (nals, 0);
+  rtph265pay->ap_size = 0;
+}
+
+/* Queues @paybuf for an aggregation packet, sending the pending NAL units
+ * first if it does not fit with them */
+static void
+gst_rtp_h265_pay_aggregate_nal (GstRtpH265Pay * rtph265pay, GstBuffer * paybuf,
+    GstClockTime dts, GstClockTime pts, gboolean end_of_au)
+{
+  guint size = gst_buffer_get_size (paybuf);
+  guint max_size;
+
+  /* PayloadHdr and size fields */
+  max_size =
+      gst_rtp_buffer_calc_payload_len (GST_RTP_BASE_PAYLOAD_MTU (rtph265pay),
+      0, 0) - 2;
+
+  /* all NAL units of an aggregation packet are from the same access unit */
+  if (rtph265pay->ap_nals->len > 0 && (rtph265pay->ap_size + 2 + size >
+          max_size || rtph265pay->ap_pts != pts))
+    gst_rtp_h265_pay_flush_ap (rtph265pay, FALSE);
+
+  if (rtph265pay->ap_nals->len == 0) {
+    rtph265pay->ap_dts = dts;
+    rtph265pay->ap_pts = pts;
+  }
+  g_ptr_array_add (rtph265pay->ap_nals, paybuf);
+  rtph265pay->ap_size += 2 + size;
+
+  if (end_of_au)
+    gst_rtp_h265_pay_flush_ap (rtph265pay, TRUE);
+}
+
 static GstFlowReturn
 gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
     GstBuffer * paybuf, GstClockTime dts, GstClockTime pts, gboolean end_of_au);
@@ -923,7 +1114,6 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
   guint packet_len, payload_len, mtu;
   GstBuffer *outbuf;
   guint8 *payload;
-  GstBufferList *list = NULL;
   gboolean send_vps_sps_pps;
   GstRTPBuffer rtp = { NULL };
   guint size = gst_buffer_get_size (paybuf);
@@ -1001,41 +1191,20 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
 
   packet_len = gst_rtp_buffer_calc_packet_len (size, 0, 0);
 
-  GST_FIXME_OBJECT (rtph265pay, "Set RTP marker bit appropriately");
+  if (rtph265pay->aggregate && gst_rtp_buffer_calc_packet_len (2 + 2 + size, 0,
+          0) <= mtu) {
+    gst_rtp_h265_pay_aggregate_nal (rtph265pay, paybuf, dts, pts, end_of_au);
+    return GST_FLOW_OK;
+  }
+
+  /* keep the NAL units in order */
+  gst_rtp_h265_pay_flush_ap (rtph265pay, FALSE);
 
   if (packet_len < mtu) {
     GST_DEBUG_OBJECT (rtph265pay,
         "NAL Unit fit in one packet datasize=%d mtu=%d", size, mtu);
     /* will fit in one packet */
-
-    /* use buffer lists
-     * create buffer without payload containing only the RTP header
-     * (memory block at index 0) */
-    outbuf = gst_rtp_buffer_new_allocate (0, 0, 0);
-
-    gst_rtp_buffer_map (outbuf, GST_MAP_WRITE, &rtp);
-
-    /* FIXME : only set the marker bit on packets containing access units */
-    /* if (IS_ACCESS_UNIT (nalType) && end_of_au) {
-       gst_rtp_buffer_set_marker (&rtp, 1);
-       } */
-
-    /* timestamp the outbuffer */
-    GST_BUFFER_PTS (outbuf) = pts;
-    GST_BUFFER_DTS (outbuf) = dts;
-
-    /* insert payload memory block */
-    outbuf = gst_buffer_append (outbuf, paybuf);
-
-    list = gst_buffer_list_new ();
-
-    /* add the buffer to the buffer list */
-    gst_buffer_list_add (list, outbuf);
-
-    gst_rtp_buffer_unmap (&rtp);
-
-    /* push the list to the next element in the pipe */
-    ret = gst_rtp_base_payload_push_list (basepayload, list);
+    gst_rtp_h265_pay_add_single (rtph265pay, paybuf, dts, pts, end_of_au);
   } else {
     /* fragmentation Units */
     guint limitedSize;
@@ -1047,16 +1216,12 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
     pos += 2;
     size -= 2;
 
-    ret = GST_FLOW_OK;
-
     GST_DEBUG_OBJECT (basepayload, "Using FU fragmentation for data size=%d",
         size);
 
     /* We keep 3 bytes for PayloadHdr and FU Header */
     payload_len = gst_rtp_buffer_calc_payload_len (mtu - 3, 0, 0);
 
-    list = gst_buffer_list_new ();
-
     while (end == 0) {
       limitedSize = size < payload_len ? size : payload_len;
       GST_DEBUG_OBJECT (basepayload,
@@ -1080,27 +1245,23 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
       }
 
       /* PayloadHdr (type = 49) */
-      payload[0] = (nalHeader[0] & 0x81) | (49 << 1);
+      payload[0] = (nalHeader[0] & 0x81) | (FU_TYPE_ID << 1);
       payload[1] = nalHeader[1];
 
-      /* FIXME - set RTP marker bit appropriately */
-      /* if (IS_ACCESS_UNIT (nalType)) {
-         gst_rtp_buffer_set_marker (&rtp, end && end_of_au);
-         } */
+      /* the last fragment of the access unit has the marker */
+      gst_rtp_buffer_set_marker (&rtp, end && end_of_au);
 
       /* FU Header */
       payload[2] = (start << 7) | (end << 6) | (nalType & 0x3f);
 
       gst_rtp_buffer_unmap (&rtp);
 
-      /* insert payload memory block */
+      /* insert payload memory block, this shares the memory of the NAL */
       gst_buffer_append (outbuf,
           gst_buffer_copy_region (paybuf, GST_BUFFER_COPY_MEMORY, pos,
               limitedSize));
 
-      /* add the buffer to the buffer list */
-      gst_buffer_list_add (list, outbuf);
-
+      gst_rtp_h265_pay_add_packet (rtph265pay, outbuf);
 
       size -= limitedSize;
       pos += limitedSize;
@@ -1108,10 +1269,10 @@ gst_rtp_h265_pay_payload_nal (GstRTPBasePayload * basepayload,
       start = 0;
     }
 
-    ret = gst_rtp_base_payload_push_list (basepayload, list);
     gst_buffer_unref (paybuf);
   }
-  return ret;
+
+  return GST_FLOW_OK;
 }
 
 static GstFlowReturn
@@ -1170,10 +1331,8 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
 
   ret = GST_FLOW_OK;
 
-  /* now loop over all NAL units and put them in a packet
-   * FIXME, we should really try to pack multiple NAL units into one RTP packet
-   * if we can, especially for the config packets that wont't cause decoder
-   * latency. */
+  /* now loop over all NAL units and put them in packets, the packets are
+   * collected and pushed together once the buffer is done */
   if (hevc) {
     guint nal_length_size;
     gsize offset = 0;
@@ -1258,9 +1417,12 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
        */
       next = next_start_code (data, size);
 
-      if (next == size && buffer != NULL) {
+      if (next == size && buffer != NULL
+          && rtph265pay->alignment == GST_H265_ALIGNMENT_UNKNOWN) {
         /* Didn't find the start of next NAL and it's not EOS,
-         * handle it next time */
+         * handle it next time. With aligned input the NAL ends with the
+         * buffer, so the adapter never holds more than one buffer and
+         * mapping it does not copy. */
         break;
       }
 
@@ -1330,17 +1492,17 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
           /* skip */ ;
 
 
-      /* If it's the last nal unit we have in non-bytestream mode, we can
-       * assume it's the end of an access-unit
+      /* If it's the last nal unit we have in au alignment, it's the end of
+       * the access-unit
        *
-       * FIXME: We need to wait until the next packet or EOS to
-       * actually payload the NAL so we can know if the current NAL is
-       * the last one of an access unit or not if we are in bytestream mode
+       * FIXME: in nal alignment we don't know if the current NAL is the last
+       * one of an access unit, the marker is then not set
        */
       if ((rtph265pay->alignment == GST_H265_ALIGNMENT_AU || buffer == NULL) &&
           i == nal_queue->len - 1)
         end_of_au = TRUE;
-      paybuf = gst_adapter_take_buffer (rtph265pay->adapter, size);
+      /* sub-buffer of the input, the payloads share its memory */
+      paybuf = gst_adapter_take_buffer_fast (rtph265pay->adapter, size);
       g_assert (paybuf);
 
       /* put the data in one or more RTP packets */
@@ -1358,6 +1520,22 @@ gst_rtp_h265_pay_handle_buffer (GstRTPBasePayload * basepayload,
     g_array_set_size (nal_queue, 0);
   }
 
+  /* leading NAL units in nal alignment wait for the slices that follow them
+   * in the next buffers */
+  if (rtph265pay->ap_nals->len > 0) {
+    GstBuffer *last = g_ptr_array_index (rtph265pay->ap_nals,
+        rtph265pay->ap_nals->len - 1);
+    guint8 header;
+
+    gst_buffer_extract (last, 0, &header, 1);
+    if (buffer == NULL || rtph265pay->alignment != GST_H265_ALIGNMENT_NAL
+        || !IS_LEADING_NAL ((header >> 1) & 0x3f))
+      gst_rtp_h265_pay_flush_ap (rtph265pay, FALSE);
+  }
+
+  if (ret == GST_FLOW_OK)
+    ret = gst_rtp_h265_pay_push_packets (basepayload);
+
 done:
   if (hevc) {
     gst_buffer_unmap (buffer, &map);
@@ -1387,6 +1565,7 @@ gst_rtp_h265_pay_sink_event (GstRTPBasePayload * payload, GstEvent * event)
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_FLUSH_STOP:
       gst_adapter_clear (rtph265pay->adapter);
+      gst_rtp_h265_pay_reset_packets (rtph265pay);
       break;
     case GST_EVENT_CUSTOM_DOWNSTREAM:
       s = gst_event_get_structure (event);
@@ -1434,6 +1613,7 @@ gst_rtp_h265_pay_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       rtph265pay->last_vps_sps_pps = -1;
       gst_rtp_h265_pay_clear_vps_sps_pps (rtph265pay);
+      gst_rtp_h265_pay_reset_packets (rtph265pay);
       break;
     default:
       break;
@@ -1461,6 +1641,9 @@ gst_rtp_h265_pay_set_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       rtph265pay->vps_sps_pps_interval = g_value_get_uint (value);
       break;
+    case PROP_AGGREGATE:
+      rtph265pay->aggregate = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1482,6 +1665,9 @@ gst_rtp_h265_pay_get_property (GObject * object, guint prop_id,
     case PROP_CONFIG_INTERVAL:
       g_value_set_uint (value, rtph265pay->vps_sps_pps_interval);
       break;
+    case PROP_AGGREGATE:
+      g_value_set_boolean (value, rtph265pay->aggregate);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
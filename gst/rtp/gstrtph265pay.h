@@ -67,6 +67,15 @@ struct _GstRtpH265Pay
   guint vps_sps_pps_interval;
   gboolean send_vps_sps_pps;
   GstClockTime last_vps_sps_pps;
+
+  gboolean aggregate;
+  /* NAL units waiting to be sent in one aggregation packet */
+  GPtrArray *ap_nals;
+  guint ap_size;
+  GstClockTime ap_dts, ap_pts;
+
+  /* packets of the current access unit, pushed together */
+  GstBufferList *list;
 };
 
 struct _GstRtpH265PayClass
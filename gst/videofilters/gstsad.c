@@ -0,0 +1,627 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+/*
+ * Sum of absolute and squared differences of 8 bit planes, shared by the
+ * video filters in this plugin, and the per pixel difference marking of
+ * videodiff.
+ *
+ * All functions take a step of 1, 2 or 4 and then only look at every
+ * step'th pixel of every step'th line, so analysis can run on a subsampled
+ * grid without a separate scaling pass.  The vector versions load whole
+ * registers and mask out the skipped pixels, which costs nothing extra
+ * compared to full resolution; the saving comes from skipping lines.
+ *
+ * The implementation is picked once at runtime: AVX2 if the CPU has it,
+ * then SSE2 or NEON if the build has them, and Orc otherwise.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstsad.h"
+#include "gstvideofiltersbadorc.h"
+
+#if HAVE_CPU_X86_64
+#include <emmintrin.h>
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#include <immintrin.h>
+#define HAVE_AVX2_TARGET 1
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAVE_NEON_INTRINSICS 1
+#endif
+
+typedef guint64 (*GstSadRowFunc) (const guint8 * s1, const guint8 * s2,
+    gint width, gint step);
+
+typedef void (*GstSadMarkRowFunc) (guint8 * d, const guint8 * s1,
+    const guint8 * s2, gint width, gint threshold, gint phase);
+
+typedef struct
+{
+  const gchar *name;
+  GstSadRowFunc sad_row;
+  GstSadRowFunc ssd_row;
+  GstSadMarkRowFunc mark_row;
+} GstSadImpl;
+
+static const GstSadImpl *sad_impl;
+
+/* the stripes drawn over pixels that differ, 8 pixels per period */
+#define MARK_PIXEL(x, phase) ((((x) + (phase)) & 0x4) ? 16 : 240)
+
+/* the pixels from @x to @width that the vector loops leave over */
+static inline guint64
+sad_tail (const guint8 * s1, const guint8 * s2, gint x, gint width, gint step)
+{
+  guint64 sum = 0;
+
+  for (; x < width; x += step)
+    sum += ABS (s1[x] - s2[x]);
+
+  return sum;
+}
+
+static inline guint64
+ssd_tail (const guint8 * s1, const guint8 * s2, gint x, gint width, gint step)
+{
+  guint64 sum = 0;
+
+  for (; x < width; x += step) {
+    gint d = s1[x] - s2[x];
+    sum += d * d;
+  }
+
+  return sum;
+}
+
+static inline void
+mark_tail (guint8 * d, const guint8 * s1, const guint8 * s2, gint x,
+    gint width, gint threshold, gint phase)
+{
+  for (; x < width; x++) {
+    if (ABS (s2[x] - s1[x]) > threshold)
+      d[x] = MARK_PIXEL (x, phase);
+    else
+      d[x] = s2[x];
+  }
+}
+
+/* fills @pattern with the stripes for a vector starting at a multiple of 8 */
+static inline void
+mark_pattern (guint8 * pattern, gint len, gint phase)
+{
+  gint k;
+
+  for (k = 0; k < len; k++)
+    pattern[k] = MARK_PIXEL (k, phase);
+}
+
+/* Orc
+ *
+ * The step 2 and 4 kernels keep the low byte of each 16 or 32 bit word,
+ * which is the first pixel only on little endian. Big endian does those
+ * steps in C. */
+
+static guint64
+sad_row_orc (const guint8 * s1, const guint8 * s2, gint width, gint step)
+{
+  guint32 sum = 0;
+  gint n = width / step;
+
+  if (n > 0) {
+    if (step == 1)
+      video_filters_bad_orc_sad_u8 (&sum, s1, s2, n);
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+    else if (step == 2)
+      video_filters_bad_orc_sad_u8_2 (&sum, s1, s2, n);
+    else
+      video_filters_bad_orc_sad_u8_4 (&sum, s1, s2, n);
+#else
+    else
+      n = 0;
+#endif
+  }
+
+  return sum + sad_tail (s1, s2, n * step, width, step);
+}
+
+static guint64
+ssd_row_orc (const guint8 * s1, const guint8 * s2, gint width, gint step)
+{
+  guint32 sum = 0;
+  gint n = width / step;
+
+  if (n > 0) {
+    if (step == 1)
+      video_filters_bad_orc_ssd_u8 (&sum, s1, s2, n);
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+    else if (step == 2)
+      video_filters_bad_orc_ssd_u8_2 (&sum, s1, s2, n);
+    else
+      video_filters_bad_orc_ssd_u8_4 (&sum, s1, s2, n);
+#else
+    else
+      n = 0;
+#endif
+  }
+
+  return sum + ssd_tail (s1, s2, n * step, width, step);
+}
+
+static void
+mark_row_c (guint8 * d, const guint8 * s1, const guint8 * s2, gint width,
+    gint threshold, gint phase)
+{
+  mark_tail (d, s1, s2, 0, width, threshold, phase);
+}
+
+static const GstSadImpl sad_impl_orc = {
+  "orc", sad_row_orc, ssd_row_orc, mark_row_c
+};
+
+/* SSE2 */
+
+#if HAVE_CPU_X86_64
+static inline __m128i
+sse2_mask (gint step)
+{
+  if (step == 2)
+    return _mm_set1_epi16 (0x00ff);
+  else if (step == 4)
+    return _mm_set1_epi32 (0x000000ff);
+  return _mm_set1_epi8 (-1);
+}
+
+static guint64
+sad_row_sse2 (const guint8 * s1, const guint8 * s2, gint width, gint step)
+{
+  __m128i mask = sse2_mask (step);
+  __m128i acc = _mm_setzero_si128 ();
+  gint x;
+
+  for (x = 0; x + 16 <= width; x += 16) {
+    __m128i a = _mm_loadu_si128 ((const __m128i *) (s1 + x));
+    __m128i b = _mm_loadu_si128 ((const __m128i *) (s2 + x));
+
+    a = _mm_and_si128 (a, mask);
+    b = _mm_and_si128 (b, mask);
+    acc = _mm_add_epi64 (acc, _mm_sad_epu8 (a, b));
+  }
+  acc = _mm_add_epi64 (acc, _mm_srli_si128 (acc, 8));
+
+  return _mm_cvtsi128_si64 (acc) + sad_tail (s1, s2, x, width, step);
+}
+
+static guint64
+ssd_row_sse2 (const guint8 * s1, const guint8 * s2, gint width, gint step)
+{
+  __m128i mask = sse2_mask (step);
+  __m128i zero = _mm_setzero_si128 ();
+  __m128i acc = _mm_setzero_si128 ();
+  guint32 lanes[4];
+  gint x;
+
+  /* every lane gains at most 4 * 255^2 per iteration, which keeps the
+   * 32 bit lanes from overflowing for any sane line width */
+  for (x = 0; x + 16 <= width; x += 16) {
+    __m128i a = _mm_loadu_si128 ((const __m128i *) (s1 + x));
+    __m128i b = _mm_loadu_si128 ((const __m128i *) (s2 + x));
+    __m128i d;
+
+    if (step == 1) {
+      d = _mm_sub_epi16 (_mm_unpacklo_epi8 (a, zero),
+          _mm_unpacklo_epi8 (b, zero));
+      acc = _mm_add_epi32 (acc, _mm_madd_epi16 (d, d));
+      d = _mm_sub_epi16 (_mm_unpackhi_epi8 (a, zero),
+          _mm_unpackhi_epi8 (b, zero));
+    } else {
+      /* the mask leaves the sampled pixels as 16 bit words */
+      d = _mm_sub_epi16 (_mm_and_si128 (a, mask), _mm_and_si128 (b, mask));
+    }
+    acc = _mm_add_epi32 (acc, _mm_madd_epi16 (d, d));
+  }
+  _mm_storeu_si128 ((__m128i *) lanes, acc);
+
+  return (guint64) lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+      ssd_tail (s1, s2, x, width, step);
+}
+
+static void
+mark_row_sse2 (guint8 * d, const guint8 * s1, const guint8 * s2, gint width,
+    gint threshold, gint phase)
+{
+  guint8 pattern[16];
+  __m128i thr, pat;
+  gint x;
+
+  mark_pattern (pattern, 16, phase);
+  pat = _mm_loadu_si128 ((const __m128i *) pattern);
+  thr = _mm_set1_epi8 ((char) threshold);
+
+  for (x = 0; x + 16 <= width; x += 16) {
+    __m128i a = _mm_loadu_si128 ((const __m128i *) (s1 + x));
+    __m128i b = _mm_loadu_si128 ((const __m128i *) (s2 + x));
+    __m128i ad = _mm_or_si128 (_mm_subs_epu8 (a, b), _mm_subs_epu8 (b, a));
+    /* all ones where the difference is within the threshold */
+    __m128i keep = _mm_cmpeq_epi8 (_mm_subs_epu8 (ad, thr),
+        _mm_setzero_si128 ());
+
+    _mm_storeu_si128 ((__m128i *) (d + x),
+        _mm_or_si128 (_mm_and_si128 (keep, b), _mm_andnot_si128 (keep, pat)));
+  }
+
+  mark_tail (d, s1, s2, x, width, threshold, phase);
+}
+
+static const GstSadImpl sad_impl_sse2 = {
+  "sse2", sad_row_sse2, ssd_row_sse2, mark_row_sse2
+};
+#endif
+
+/* AVX2 */
+
+#ifdef HAVE_AVX2_TARGET
+__attribute__ ((target ("avx2")))
+static inline __m256i
+avx2_mask (gint step)
+{
+  if (step == 2)
+    return _mm256_set1_epi16 (0x00ff);
+  else if (step == 4)
+    return _mm256_set1_epi32 (0x000000ff);
+  return _mm256_set1_epi8 (-1);
+}
+
+__attribute__ ((target ("avx2")))
+static guint64
+sad_row_avx2 (const guint8 * s1, const guint8 * s2, gint width, gint step)
+{
+  __m256i mask = avx2_mask (step);
+  __m256i acc = _mm256_setzero_si256 ();
+  guint64 lanes[4];
+  gint x;
+
+  for (x = 0; x + 32 <= width; x += 32) {
+    __m256i a = _mm256_loadu_si256 ((const __m256i *) (s1 + x));
+    __m256i b = _mm256_loadu_si256 ((const __m256i *) (s2 + x));
+
+    a = _mm256_and_si256 (a, mask);
+    b = _mm256_and_si256 (b, mask);
+    acc = _mm256_add_epi64 (acc, _mm256_sad_epu8 (a, b));
+  }
+  _mm256_storeu_si256 ((__m256i *) lanes, acc);
+
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+      sad_tail (s1, s2, x, width, step);
+}
+
+__attribute__ ((target ("avx2")))
+static guint64
+ssd_row_avx2 (const guint8 * s1, const guint8 * s2, gint width, gint step)
+{
+  __m256i mask = avx2_mask (step);
+  __m256i zero = _mm256_setzero_si256 ();
+  __m256i acc = _mm256_setzero_si256 ();
+  guint32 lanes[8];
+  guint64 sum = 0;
+  gint x, i;
+
+  for (x = 0; x + 32 <= width; x += 32) {
+    __m256i a = _mm256_loadu_si256 ((const __m256i *) (s1 + x));
+    __m256i b = _mm256_loadu_si256 ((const __m256i *) (s2 + x));
+    __m256i d;
+
+    if (step == 1) {
+      /* unpacking works per 128 bit lane, which does not matter for a sum */
+      d = _mm256_sub_epi16 (_mm256_unpacklo_epi8 (a, zero),
+          _mm256_unpacklo_epi8 (b, zero));
+      acc = _mm256_add_epi32 (acc, _mm256_madd_epi16 (d, d));
+      d = _mm256_sub_epi16 (_mm256_unpackhi_epi8 (a, zero),
+          _mm256_unpackhi_epi8 (b, zero));
+    } else {
+      d = _mm256_sub_epi16 (_mm256_and_si256 (a, mask),
+          _mm256_and_si256 (b, mask));
+    }
+    acc = _mm256_add_epi32 (acc, _mm256_madd_epi16 (d, d));
+  }
+  _mm256_storeu_si256 ((__m256i *) lanes, acc);
+
+  for (i = 0; i < 8; i++)
+    sum += lanes[i];
+
+  return sum + ssd_tail (s1, s2, x, width, step);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+mark_row_avx2 (guint8 * d, const guint8 * s1, const guint8 * s2, gint width,
+    gint threshold, gint phase)
+{
+  guint8 pattern[32];
+  __m256i thr, pat;
+  gint x;
+
+  mark_pattern (pattern, 32, phase);
+  pat = _mm256_loadu_si256 ((const __m256i *) pattern);
+  thr = _mm256_set1_epi8 ((char) threshold);
+
+  for (x = 0; x + 32 <= width; x += 32) {
+    __m256i a = _mm256_loadu_si256 ((const __m256i *) (s1 + x));
+    __m256i b = _mm256_loadu_si256 ((const __m256i *) (s2 + x));
+    __m256i ad = _mm256_or_si256 (_mm256_subs_epu8 (a, b),
+        _mm256_subs_epu8 (b, a));
+    __m256i keep = _mm256_cmpeq_epi8 (_mm256_subs_epu8 (ad, thr),
+        _mm256_setzero_si256 ());
+
+    _mm256_storeu_si256 ((__m256i *) (d + x),
+        _mm256_blendv_epi8 (pat, b, keep));
+  }
+
+  mark_tail (d, s1, s2, x, width, threshold, phase);
+}
+
+static const GstSadImpl sad_impl_avx2 = {
+  "avx2", sad_row_avx2, ssd_row_avx2, mark_row_avx2
+};
+#endif
+
+/* NEON */
+
+#ifdef HAVE_NEON_INTRINSICS
+/* loaded as bytes so the sampled pixels are the same on either endianness */
+static inline uint8x16_t
+neon_mask (gint step)
+{
+  static const guint8 mask2[16] = {
+    0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0, 0xff, 0
+  };
+  static const guint8 mask4[16] = {
+    0xff, 0, 0, 0, 0xff, 0, 0, 0, 0xff, 0, 0, 0, 0xff, 0, 0, 0
+  };
+
+  if (step == 2)
+    return vld1q_u8 (mask2);
+  else if (step == 4)
+    return vld1q_u8 (mask4);
+  return vdupq_n_u8 (0xff);
+}
+
+static inline guint64
+neon_sum_u32 (uint32x4_t v)
+{
+  uint64x2_t s = vpaddlq_u32 (v);
+
+  return vgetq_lane_u64 (s, 0) + vgetq_lane_u64 (s, 1);
+}
+
+static guint64
+sad_row_neon (const guint8 * s1, const guint8 * s2, gint width, gint step)
+{
+  uint8x16_t mask = neon_mask (step);
+  uint32x4_t acc = vdupq_n_u32 (0);
+  gint x;
+
+  for (x = 0; x + 16 <= width; x += 16) {
+    uint8x16_t d = vabdq_u8 (vandq_u8 (vld1q_u8 (s1 + x), mask),
+        vandq_u8 (vld1q_u8 (s2 + x), mask));
+
+    acc = vpadalq_u16 (acc, vpaddlq_u8 (d));
+  }
+
+  return neon_sum_u32 (acc) + sad_tail (s1, s2, x, width, step);
+}
+
+static guint64
+ssd_row_neon (const guint8 * s1, const guint8 * s2, gint width, gint step)
+{
+  uint8x16_t mask = neon_mask (step);
+  uint32x4_t acc = vdupq_n_u32 (0);
+  gint x;
+
+  for (x = 0; x + 16 <= width; x += 16) {
+    uint8x16_t d = vabdq_u8 (vandq_u8 (vld1q_u8 (s1 + x), mask),
+        vandq_u8 (vld1q_u8 (s2 + x), mask));
+    uint8x8_t lo = vget_low_u8 (d);
+    uint8x8_t hi = vget_high_u8 (d);
+
+    acc = vpadalq_u16 (acc, vmull_u8 (lo, lo));
+    acc = vpadalq_u16 (acc, vmull_u8 (hi, hi));
+  }
+
+  return neon_sum_u32 (acc) + ssd_tail (s1, s2, x, width, step);
+}
+
+static void
+mark_row_neon (guint8 * d, const guint8 * s1, const guint8 * s2, gint width,
+    gint threshold, gint phase)
+{
+  guint8 pattern[16];
+  uint8x16_t thr, pat;
+  gint x;
+
+  mark_pattern (pattern, 16, phase);
+  pat = vld1q_u8 (pattern);
+  thr = vdupq_n_u8 (threshold);
+
+  for (x = 0; x + 16 <= width; x += 16) {
+    uint8x16_t a = vld1q_u8 (s1 + x);
+    uint8x16_t b = vld1q_u8 (s2 + x);
+    uint8x16_t over = vcgtq_u8 (vabdq_u8 (a, b), thr);
+
+    vst1q_u8 (d + x, vbslq_u8 (over, pat, b));
+  }
+
+  mark_tail (d, s1, s2, x, width, threshold, phase);
+}
+
+static const GstSadImpl sad_impl_neon = {
+  "neon", sad_row_neon, ssd_row_neon, mark_row_neon
+};
+#endif
+
+/**
+ * gst_sad_init:
+ *
+ * Picks the fastest implementation for this CPU. Called from plugin_init,
+ * the other functions call it too if needed.
+ */
+void
+gst_sad_init (void)
+{
+  static gsize inited = 0;
+
+  if (g_once_init_enter (&inited)) {
+    const GstSadImpl *impl = &sad_impl_orc;
+
+#if HAVE_CPU_X86_64
+    impl = &sad_impl_sse2;
+#endif
+#ifdef HAVE_AVX2_TARGET
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+      impl = &sad_impl_avx2;
+#endif
+#ifdef HAVE_NEON_INTRINSICS
+    impl = &sad_impl_neon;
+#endif
+
+    sad_impl = impl;
+    g_once_init_leave (&inited, 1);
+  }
+}
+
+/**
+ * gst_sad_get_implementation:
+ *
+ * Returns: the name of the implementation in use, for debugging
+ */
+const gchar *
+gst_sad_get_implementation (void)
+{
+  gst_sad_init ();
+
+  return sad_impl->name;
+}
+
+static guint64
+plane_sum (GstSadRowFunc row, const guint8 * s1, gint stride1,
+    const guint8 * s2, gint stride2, gint width, gint height, gint step)
+{
+  guint64 sum = 0;
+  gint j;
+
+  g_return_val_if_fail (step == 1 || step == 2 || step == 4, 0);
+
+  for (j = 0; j < height; j += step)
+    sum += row (s1 + j * stride1, s2 + j * stride2, width, step);
+
+  return sum;
+}
+
+/**
+ * gst_sad_plane_u8:
+ * @s1: first plane
+ * @stride1: stride of @s1
+ * @s2: second plane
+ * @stride2: stride of @s2
+ * @width: width in pixels
+ * @height: height in lines
+ * @step: 1 for every pixel, 2 or 4 to only use every 2nd or 4th pixel of
+ *     every 2nd or 4th line
+ *
+ * Returns: the sum of absolute differences of the sampled pixels
+ */
+guint64
+gst_sad_plane_u8 (const guint8 * s1, gint stride1, const guint8 * s2,
+    gint stride2, gint width, gint height, gint step)
+{
+  gst_sad_init ();
+
+  return plane_sum (sad_impl->sad_row, s1, stride1, s2, stride2, width,
+      height, step);
+}
+
+/**
+ * gst_ssd_plane_u8:
+ *
+ * Like gst_sad_plane_u8() but sums squared differences.
+ *
+ * Returns: the sum of squared differences of the sampled pixels
+ */
+guint64
+gst_ssd_plane_u8 (const guint8 * s1, gint stride1, const guint8 * s2,
+    gint stride2, gint width, gint height, gint step)
+{
+  gst_sad_init ();
+
+  return plane_sum (sad_impl->ssd_row, s1, stride1, s2, stride2, width,
+      height, step);
+}
+
+/**
+ * gst_sad_mark_plane_u8:
+ * @d: destination plane
+ * @dstride: stride of @d
+ * @s1: previous plane
+ * @stride1: stride of @s1
+ * @s2: current plane
+ * @stride2: stride of @s2
+ * @width: width in pixels
+ * @height: height in lines
+ * @threshold: largest difference that is not marked, 0 to 255
+ * @phase: offset of the stripe pattern, to animate it
+ *
+ * Copies @s2 to @d and draws diagonal stripes over the pixels that differ
+ * from @s1 by more than @threshold.
+ */
+void
+gst_sad_mark_plane_u8 (guint8 * d, gint dstride, const guint8 * s1,
+    gint stride1, const guint8 * s2, gint stride2, gint width, gint height,
+    gint threshold, gint phase)
+{
+  gint j;
+
+  gst_sad_init ();
+
+  threshold = CLAMP (threshold, 0, 255);
+
+  for (j = 0; j < height; j++)
+    sad_impl->mark_row (d + j * dstride, s1 + j * stride1, s2 + j * stride2,
+        width, threshold, phase + j);
+}
+
+/**
+ * gst_sad_n_samples:
+ * @width: width in pixels
+ * @height: height in lines
+ * @step: the step passed to gst_sad_plane_u8()
+ *
+ * Returns: the number of pixels gst_sad_plane_u8() looks at, to turn the
+ * sums into averages
+ */
+guint64
+gst_sad_n_samples (gint width, gint height, gint step)
+{
+  return (guint64) ((width + step - 1) / step) * ((height + step - 1) / step);
+}
@@ -0,0 +1,48 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Suite 500,
+ * Boston, MA 02110-1335, USA.
+ */
+
+#ifndef _GST_SAD_H_
+#define _GST_SAD_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void     gst_sad_init         (void);
+
+const gchar *gst_sad_get_implementation (void);
+
+guint64  gst_sad_plane_u8     (const guint8 * s1, gint stride1,
+                               const guint8 * s2, gint stride2,
+                               gint width, gint height, gint step);
+
+guint64  gst_ssd_plane_u8     (const guint8 * s1, gint stride1,
+                               const guint8 * s2, gint stride2,
+                               gint width, gint height, gint step);
+
+void     gst_sad_mark_plane_u8 (guint8 * d, gint dstride,
+                               const guint8 * s1, gint stride1,
+                               const guint8 * s2, gint stride2,
+                               gint width, gint height,
+                               gint threshold, gint phase);
+
+guint64  gst_sad_n_samples    (gint width, gint height, gint step);
+
+G_END_DECLS
+
+#endif
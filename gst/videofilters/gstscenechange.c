@@ -32,6 +32,11 @@
  *
  * The scenechange element does not work with compressed video.
  *
+ * The #GstSceneChange:analysis-resolution property trades accuracy for
+ * speed by comparing only every 2nd or 4th pixel of every 2nd or 4th line.
+ * Scores are averages over the compared pixels, so the thresholds apply at
+ * any resolution.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -82,12 +87,17 @@
 #include <gst/video/gstvideofilter.h>
 #include <string.h>
 #include "gstscenechange.h"
+#include "gstsad.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_scene_change_debug_category);
 #define GST_CAT_DEFAULT gst_scene_change_debug_category
 
 /* prototypes */
 
+static void gst_scene_change_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_scene_change_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
 
 static GstFlowReturn gst_scene_change_transform_frame_ip (GstVideoFilter *
     filter, GstVideoFrame * frame);
@@ -99,9 +109,33 @@ static gboolean is_shot_change (int frame_number);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_ANALYSIS_RESOLUTION
 };
 
+#define DEFAULT_ANALYSIS_RESOLUTION GST_SCENE_CHANGE_ANALYSIS_RESOLUTION_FULL
+
+#define GST_TYPE_SCENE_CHANGE_ANALYSIS_RESOLUTION \
+    (gst_scene_change_analysis_resolution_get_type ())
+static GType
+gst_scene_change_analysis_resolution_get_type (void)
+{
+  static GType type = 0;
+  static const GEnumValue values[] = {
+    {GST_SCENE_CHANGE_ANALYSIS_RESOLUTION_FULL, "Compare every pixel", "full"},
+    {GST_SCENE_CHANGE_ANALYSIS_RESOLUTION_HALF,
+        "Compare every 2nd pixel of every 2nd line", "half"},
+    {GST_SCENE_CHANGE_ANALYSIS_RESOLUTION_QUARTER,
+        "Compare every 4th pixel of every 4th line", "quarter"},
+    {0, NULL, NULL}
+  };
+
+  if (!type) {
+    type = g_enum_register_static ("GstSceneChangeAnalysisResolution", values);
+  }
+  return type;
+}
+
 #define VIDEO_CAPS \
     GST_VIDEO_CAPS_MAKE("{ I420, Y42B, Y41B, Y444 }")
 
@@ -115,8 +149,19 @@ G_DEFINE_TYPE_WITH_CODE (GstSceneChange, gst_scene_change,
 static void
 gst_scene_change_class_init (GstSceneChangeClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstVideoFilterClass *video_filter_class = GST_VIDEO_FILTER_CLASS (klass);
 
+  gobject_class->set_property = gst_scene_change_set_property;
+  gobject_class->get_property = gst_scene_change_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_ANALYSIS_RESOLUTION,
+      g_param_spec_enum ("analysis-resolution", "Analysis resolution",
+          "Resolution of the grid the frames are compared on",
+          GST_TYPE_SCENE_CHANGE_ANALYSIS_RESOLUTION,
+          DEFAULT_ANALYSIS_RESOLUTION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (GST_ELEMENT_CLASS (klass),
       gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
           gst_caps_from_string (VIDEO_CAPS)));
@@ -137,31 +182,61 @@ gst_scene_change_class_init (GstSceneChangeClass * klass)
 static void
 gst_scene_change_init (GstSceneChange * scenechange)
 {
+  scenechange->analysis_resolution = DEFAULT_ANALYSIS_RESOLUTION;
+}
+
+static void
+gst_scene_change_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstSceneChange *scenechange = GST_SCENE_CHANGE (object);
+
+  switch (property_id) {
+    case PROP_ANALYSIS_RESOLUTION:
+      GST_OBJECT_LOCK (scenechange);
+      scenechange->analysis_resolution = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (scenechange);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
 }
 
+static void
+gst_scene_change_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstSceneChange *scenechange = GST_SCENE_CHANGE (object);
+
+  switch (property_id) {
+    case PROP_ANALYSIS_RESOLUTION:
+      GST_OBJECT_LOCK (scenechange);
+      g_value_set_enum (value, scenechange->analysis_resolution);
+      GST_OBJECT_UNLOCK (scenechange);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
 
+
+/* mean absolute difference of the luma planes, over every @step'th pixel of
+ * every @step'th line */
 static double
-get_frame_score (GstVideoFrame * f1, GstVideoFrame * f2)
+get_frame_score (GstVideoFrame * f1, GstVideoFrame * f2, gint step)
 {
-  int i;
-  int j;
-  int score = 0;
+  guint64 score;
   int width, height;
-  guint8 *s1;
-  guint8 *s2;
 
   width = f1->info.width;
   height = f1->info.height;
 
-  for (j = 0; j < height; j++) {
-    s1 = (guint8 *) f1->data[0] + f1->info.stride[0] * j;
-    s2 = (guint8 *) f2->data[0] + f2->info.stride[0] * j;
-    for (i = 0; i < width; i++) {
-      score += ABS (s1[i] - s2[i]);
-    }
-  }
+  score = gst_sad_plane_u8 (f1->data[0], f1->info.stride[0],
+      f2->data[0], f2->info.stride[0], width, height, step);
 
-  return ((double) score) / (width * height);
+  return ((double) score) / gst_sad_n_samples (width, height, step);
 }
 
 static GstFlowReturn
@@ -176,6 +251,7 @@ gst_scene_change_transform_frame_ip (GstVideoFilter * filter,
   double score;
   gboolean change;
   gboolean ret;
+  gint step;
   int i;
 
   GST_DEBUG_OBJECT (scenechange, "transform_frame_ip");
@@ -196,7 +272,11 @@ gst_scene_change_transform_frame_ip (GstVideoFilter * filter,
     return GST_FLOW_ERROR;
   }
 
-  score = get_frame_score (&oldframe, frame);
+  GST_OBJECT_LOCK (scenechange);
+  step = scenechange->analysis_resolution;
+  GST_OBJECT_UNLOCK (scenechange);
+
+  score = get_frame_score (&oldframe, frame, step);
 
   gst_video_frame_unmap (&oldframe);
 
@@ -36,6 +36,23 @@ typedef struct _GstSceneChangeClass GstSceneChangeClass;
 
 #define SC_N_DIFFS 5
 
+/**
+ * GstSceneChangeAnalysisResolution:
+ * @GST_SCENE_CHANGE_ANALYSIS_RESOLUTION_FULL: compare every pixel
+ * @GST_SCENE_CHANGE_ANALYSIS_RESOLUTION_HALF: compare every 2nd pixel of
+ *     every 2nd line
+ * @GST_SCENE_CHANGE_ANALYSIS_RESOLUTION_QUARTER: compare every 4th pixel of
+ *     every 4th line
+ *
+ * The values are the distance between compared pixels.
+ */
+typedef enum
+{
+  GST_SCENE_CHANGE_ANALYSIS_RESOLUTION_FULL = 1,
+  GST_SCENE_CHANGE_ANALYSIS_RESOLUTION_HALF = 2,
+  GST_SCENE_CHANGE_ANALYSIS_RESOLUTION_QUARTER = 4
+} GstSceneChangeAnalysisResolution;
+
 struct _GstSceneChange
 {
   GstVideoFilter base_scenechange;
@@ -45,6 +62,8 @@ struct _GstSceneChange
   GstBuffer *oldbuf;
   GstVideoInfo oldinfo;
   int count;
+
+  GstSceneChangeAnalysisResolution analysis_resolution;
 };
 
 struct _GstSceneChangeClass
@@ -38,6 +38,7 @@
 #include <gst/video/video.h>
 #include <gst/video/gstvideofilter.h>
 #include "gstvideodiff.h"
+#include "gstsad.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_video_diff_debug_category);
 #define GST_CAT_DEFAULT gst_video_diff_debug_category
@@ -104,26 +105,13 @@ gst_video_diff_transform_frame_ip_planarY (GstVideoDiff * videodiff,
 {
   int width = inframe->info.width;
   int height = inframe->info.height;
-  int i, j;
-  int threshold = videodiff->threshold;
-  int t = videodiff->t;
-
-  for (j = 0; j < height; j++) {
-    guint8 *d = (guint8 *) outframe->data[0] + outframe->info.stride[0] * j;
-    guint8 *s1 = (guint8 *) oldframe->data[0] + oldframe->info.stride[0] * j;
-    guint8 *s2 = (guint8 *) inframe->data[0] + inframe->info.stride[0] * j;
-    for (i = 0; i < width; i++) {
-      if ((s2[i] < s1[i] - threshold) || (s2[i] > s1[i] + threshold)) {
-        if ((i + j + t) & 0x4) {
-          d[i] = 16;
-        } else {
-          d[i] = 240;
-        }
-      } else {
-        d[i] = s2[i];
-      }
-    }
-  }
+  int j;
+
+  gst_sad_mark_plane_u8 (outframe->data[0], outframe->info.stride[0],
+      oldframe->data[0], oldframe->info.stride[0],
+      inframe->data[0], inframe->info.stride[0], width, height,
+      videodiff->threshold, videodiff->t);
+
   for (j = 0; j < GST_VIDEO_FRAME_COMP_HEIGHT (inframe, 1); j++) {
     guint8 *d = (guint8 *) outframe->data[1] + outframe->info.stride[1] * j;
     guint8 *s = (guint8 *) inframe->data[1] + inframe->info.stride[1] * j;
@@ -26,11 +26,13 @@
 #include "gstscenechange.h"
 #include "gstzebrastripe.h"
 #include "gstvideodiff.h"
+#include "gstsad.h"
 
 
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
+  gst_sad_init ();
 
   gst_element_register (plugin, "scenechange", GST_RANK_NONE,
       gst_scene_change_get_type ());
@@ -0,0 +1,1193 @@
+
+/* autogenerated from gstvideofiltersbadorc.orc */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <glib.h>
+
+#ifndef _ORC_INTEGER_TYPEDEFS_
+#define _ORC_INTEGER_TYPEDEFS_
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#include <stdint.h>
+typedef int8_t orc_int8;
+typedef int16_t orc_int16;
+typedef int32_t orc_int32;
+typedef int64_t orc_int64;
+typedef uint8_t orc_uint8;
+typedef uint16_t orc_uint16;
+typedef uint32_t orc_uint32;
+typedef uint64_t orc_uint64;
+#define ORC_UINT64_C(x) UINT64_C(x)
+#elif defined(_MSC_VER)
+typedef signed __int8 orc_int8;
+typedef signed __int16 orc_int16;
+typedef signed __int32 orc_int32;
+typedef signed __int64 orc_int64;
+typedef unsigned __int8 orc_uint8;
+typedef unsigned __int16 orc_uint16;
+typedef unsigned __int32 orc_uint32;
+typedef unsigned __int64 orc_uint64;
+#define ORC_UINT64_C(x) (x##Ui64)
+#define inline __inline
+#else
+#include <limits.h>
+typedef signed char orc_int8;
+typedef short orc_int16;
+typedef int orc_int32;
+typedef unsigned char orc_uint8;
+typedef unsigned short orc_uint16;
+typedef unsigned int orc_uint32;
+#if INT_MAX == LONG_MAX
+typedef long long orc_int64;
+typedef unsigned long long orc_uint64;
+#define ORC_UINT64_C(x) (x##ULL)
+#else
+typedef long orc_int64;
+typedef unsigned long orc_uint64;
+#define ORC_UINT64_C(x) (x##UL)
+#endif
+#endif
+typedef union
+{
+  orc_int16 i;
+  orc_int8 x2[2];
+} orc_union16;
+typedef union
+{
+  orc_int32 i;
+  float f;
+  orc_int16 x2[2];
+  orc_int8 x4[4];
+} orc_union32;
+typedef union
+{
+  orc_int64 i;
+  double f;
+  orc_int32 x2[2];
+  float x2f[2];
+  orc_int16 x4[4];
+} orc_union64;
+#endif
+#ifndef ORC_RESTRICT
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#define ORC_RESTRICT restrict
+#elif defined(__GNUC__) && __GNUC__ >= 4
+#define ORC_RESTRICT __restrict__
+#else
+#define ORC_RESTRICT
+#endif
+#endif
+
+#ifndef ORC_INTERNAL
+#if defined(__SUNPRO_C) && (__SUNPRO_C >= 0x590)
+#define ORC_INTERNAL __attribute__((visibility("hidden")))
+#elif defined(__SUNPRO_C) && (__SUNPRO_C >= 0x550)
+#define ORC_INTERNAL __hidden
+#elif defined (__GNUC__)
+#define ORC_INTERNAL __attribute__((visibility("hidden")))
+#else
+#define ORC_INTERNAL
+#endif
+#endif
+
+
+#ifndef DISABLE_ORC
+#include <orc/orc.h>
+#endif
+void video_filters_bad_orc_sad_u8 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n);
+void video_filters_bad_orc_sad_u8_2 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n);
+void video_filters_bad_orc_sad_u8_4 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n);
+void video_filters_bad_orc_ssd_u8 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n);
+void video_filters_bad_orc_ssd_u8_2 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n);
+void video_filters_bad_orc_ssd_u8_4 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n);
+
+
+/* begin Orc C target preamble */
+#define ORC_CLAMP(x,a,b) ((x)<(a) ? (a) : ((x)>(b) ? (b) : (x)))
+#define ORC_ABS(a) ((a)<0 ? -(a) : (a))
+#define ORC_MIN(a,b) ((a)<(b) ? (a) : (b))
+#define ORC_MAX(a,b) ((a)>(b) ? (a) : (b))
+#define ORC_SB_MAX 127
+#define ORC_SB_MIN (-1-ORC_SB_MAX)
+#define ORC_UB_MAX 255
+#define ORC_UB_MIN 0
+#define ORC_SW_MAX 32767
+#define ORC_SW_MIN (-1-ORC_SW_MAX)
+#define ORC_UW_MAX 65535
+#define ORC_UW_MIN 0
+#define ORC_SL_MAX 2147483647
+#define ORC_SL_MIN (-1-ORC_SL_MAX)
+#define ORC_UL_MAX 4294967295U
+#define ORC_UL_MIN 0
+#define ORC_CLAMP_SB(x) ORC_CLAMP(x,ORC_SB_MIN,ORC_SB_MAX)
+#define ORC_CLAMP_UB(x) ORC_CLAMP(x,ORC_UB_MIN,ORC_UB_MAX)
+#define ORC_CLAMP_SW(x) ORC_CLAMP(x,ORC_SW_MIN,ORC_SW_MAX)
+#define ORC_CLAMP_UW(x) ORC_CLAMP(x,ORC_UW_MIN,ORC_UW_MAX)
+#define ORC_CLAMP_SL(x) ORC_CLAMP(x,ORC_SL_MIN,ORC_SL_MAX)
+#define ORC_CLAMP_UL(x) ORC_CLAMP(x,ORC_UL_MIN,ORC_UL_MAX)
+#define ORC_SWAP_W(x) ((((x)&0xffU)<<8) | (((x)&0xff00U)>>8))
+#define ORC_SWAP_L(x) ((((x)&0xffU)<<24) | (((x)&0xff00U)<<8) | (((x)&0xff0000U)>>8) | (((x)&0xff000000U)>>24))
+#define ORC_SWAP_Q(x) ((((x)&ORC_UINT64_C(0xff))<<56) | (((x)&ORC_UINT64_C(0xff00))<<40) | (((x)&ORC_UINT64_C(0xff0000))<<24) | (((x)&ORC_UINT64_C(0xff000000))<<8) | (((x)&ORC_UINT64_C(0xff00000000))>>8) | (((x)&ORC_UINT64_C(0xff0000000000))>>24) | (((x)&ORC_UINT64_C(0xff000000000000))>>40) | (((x)&ORC_UINT64_C(0xff00000000000000))>>56))
+#define ORC_PTR_OFFSET(ptr,offset) ((void *)(((unsigned char *)(ptr)) + (offset)))
+#define ORC_DENORMAL(x) ((x) & ((((x)&0x7f800000) == 0) ? 0xff800000 : 0xffffffff))
+#define ORC_ISNAN(x) ((((x)&0x7f800000) == 0x7f800000) && (((x)&0x007fffff) != 0))
+#define ORC_DENORMAL_DOUBLE(x) ((x) & ((((x)&ORC_UINT64_C(0x7ff0000000000000)) == 0) ? ORC_UINT64_C(0xfff0000000000000) : ORC_UINT64_C(0xffffffffffffffff)))
+#define ORC_ISNAN_DOUBLE(x) ((((x)&ORC_UINT64_C(0x7ff0000000000000)) == ORC_UINT64_C(0x7ff0000000000000)) && (((x)&ORC_UINT64_C(0x000fffffffffffff)) != 0))
+#ifndef ORC_RESTRICT
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L
+#define ORC_RESTRICT restrict
+#elif defined(__GNUC__) && __GNUC__ >= 4
+#define ORC_RESTRICT __restrict__
+#else
+#define ORC_RESTRICT
+#endif
+#endif
+/* end Orc C target preamble */
+
+
+
+/* video_filters_bad_orc_sad_u8 */
+#ifdef DISABLE_ORC
+void
+video_filters_bad_orc_sad_u8 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  int i;
+  const orc_int8 *ORC_RESTRICT ptr4;
+  const orc_int8 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_int8 var32;
+  orc_union16 var33;
+  orc_int8 var34;
+  orc_union16 var35;
+  orc_union16 var36;
+  orc_union16 var37;
+  orc_union32 var38;
+
+  ptr4 = (orc_int8 *) s1;
+  ptr5 = (orc_int8 *) s2;
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadb */
+    var32 = ptr4[i];
+    /* 1: convubw */
+    var33.i = (orc_uint8) var32;
+    /* 2: loadb */
+    var34 = ptr5[i];
+    /* 3: convubw */
+    var35.i = (orc_uint8) var34;
+    /* 4: subw */
+    var36.i = var33.i - var35.i;
+    /* 5: absw */
+    var37.i = ORC_ABS (var36.i);
+    /* 6: convuwl */
+    var38.i = (orc_uint16) var37.i;
+    /* 7: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var38.i);
+  }
+  *a1 = var12.i;
+
+}
+
+#else
+static void
+_backup_video_filters_bad_orc_sad_u8 (OrcExecutor * ORC_RESTRICT ex)
+{
+  int i;
+  int n = ex->n;
+  const orc_int8 *ORC_RESTRICT ptr4;
+  const orc_int8 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_int8 var32;
+  orc_union16 var33;
+  orc_int8 var34;
+  orc_union16 var35;
+  orc_union16 var36;
+  orc_union16 var37;
+  orc_union32 var38;
+
+  ptr4 = (orc_int8 *) ex->arrays[4];
+  ptr5 = (orc_int8 *) ex->arrays[5];
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadb */
+    var32 = ptr4[i];
+    /* 1: convubw */
+    var33.i = (orc_uint8) var32;
+    /* 2: loadb */
+    var34 = ptr5[i];
+    /* 3: convubw */
+    var35.i = (orc_uint8) var34;
+    /* 4: subw */
+    var36.i = var33.i - var35.i;
+    /* 5: absw */
+    var37.i = ORC_ABS (var36.i);
+    /* 6: convuwl */
+    var38.i = (orc_uint16) var37.i;
+    /* 7: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var38.i);
+  }
+  ex->accumulators[0] = var12.i;
+
+}
+
+void
+video_filters_bad_orc_sad_u8 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  OrcExecutor _ex, *ex = &_ex;
+  static volatile int p_inited = 0;
+  static OrcCode *c = 0;
+  void (*func) (OrcExecutor *);
+
+  if (!p_inited) {
+    orc_once_mutex_lock ();
+    if (!p_inited) {
+      OrcProgram *p;
+
+#if 1
+      static const orc_uint8 bc[] = {
+        1, 9, 28, 118, 105, 100, 101, 111, 95, 102, 105, 108, 116, 101, 114,
+        115, 95, 98, 97, 100, 95, 111, 114, 99, 95, 115, 97, 100, 95, 117, 56,
+        12, 1, 1, 12, 1, 1, 13, 4, 20, 2, 20, 2, 20, 4, 150, 32, 4, 150, 33, 5,
+        98, 32, 32, 33, 69, 32, 32, 154, 34, 32, 181, 12, 34, 2, 0,
+      };
+      p = orc_program_new_from_static_bytecode (bc);
+      orc_program_set_backup_function (p, _backup_video_filters_bad_orc_sad_u8);
+#else
+      p = orc_program_new ();
+      orc_program_set_name (p, "video_filters_bad_orc_sad_u8");
+      orc_program_set_backup_function (p, _backup_video_filters_bad_orc_sad_u8);
+      orc_program_add_source (p, 1, "s1");
+      orc_program_add_source (p, 1, "s2");
+      orc_program_add_accumulator (p, 4, "a1");
+      orc_program_add_temporary (p, 2, "t1");
+      orc_program_add_temporary (p, 2, "t2");
+      orc_program_add_temporary (p, 4, "t3");
+
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T1, ORC_VAR_S1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T2, ORC_VAR_S2, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "subw", 0, ORC_VAR_T1, ORC_VAR_T1, ORC_VAR_T2,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "absw", 0, ORC_VAR_T1, ORC_VAR_T1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convuwl", 0, ORC_VAR_T3, ORC_VAR_T1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "accl", 0, ORC_VAR_A1, ORC_VAR_T3, ORC_VAR_D1,
+          ORC_VAR_D1);
+#endif
+
+      orc_program_compile (p);
+      c = orc_program_take_code (p);
+      orc_program_free (p);
+    }
+    p_inited = TRUE;
+    orc_once_mutex_unlock ();
+  }
+  ex->arrays[ORC_VAR_A2] = c;
+  ex->program = 0;
+
+  ex->n = n;
+  ex->arrays[ORC_VAR_S1] = (void *) s1;
+  ex->arrays[ORC_VAR_S2] = (void *) s2;
+
+  func = c->exec;
+  func (ex);
+  *a1 = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+}
+#endif
+
+
+/* video_filters_bad_orc_sad_u8_2 */
+#ifdef DISABLE_ORC
+void
+video_filters_bad_orc_sad_u8_2 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  int i;
+  const orc_union16 *ORC_RESTRICT ptr4;
+  const orc_union16 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_union16 var32;
+  orc_int8 var33;
+  orc_union16 var34;
+  orc_int8 var35;
+  orc_union16 var36;
+  orc_union16 var37;
+  orc_union16 var38;
+  orc_union16 var39;
+  orc_union32 var40;
+
+  ptr4 = (orc_union16 *) s1;
+  ptr5 = (orc_union16 *) s2;
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadw */
+    var32 = ptr4[i];
+    /* 1: convwb */
+    var33 = var32.i;
+    /* 2: loadw */
+    var34 = ptr5[i];
+    /* 3: convwb */
+    var35 = var34.i;
+    /* 4: convubw */
+    var36.i = (orc_uint8) var33;
+    /* 5: convubw */
+    var37.i = (orc_uint8) var35;
+    /* 6: subw */
+    var38.i = var36.i - var37.i;
+    /* 7: absw */
+    var39.i = ORC_ABS (var38.i);
+    /* 8: convuwl */
+    var40.i = (orc_uint16) var39.i;
+    /* 9: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var40.i);
+  }
+  *a1 = var12.i;
+
+}
+
+#else
+static void
+_backup_video_filters_bad_orc_sad_u8_2 (OrcExecutor * ORC_RESTRICT ex)
+{
+  int i;
+  int n = ex->n;
+  const orc_union16 *ORC_RESTRICT ptr4;
+  const orc_union16 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_union16 var32;
+  orc_int8 var33;
+  orc_union16 var34;
+  orc_int8 var35;
+  orc_union16 var36;
+  orc_union16 var37;
+  orc_union16 var38;
+  orc_union16 var39;
+  orc_union32 var40;
+
+  ptr4 = (orc_union16 *) ex->arrays[4];
+  ptr5 = (orc_union16 *) ex->arrays[5];
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadw */
+    var32 = ptr4[i];
+    /* 1: convwb */
+    var33 = var32.i;
+    /* 2: loadw */
+    var34 = ptr5[i];
+    /* 3: convwb */
+    var35 = var34.i;
+    /* 4: convubw */
+    var36.i = (orc_uint8) var33;
+    /* 5: convubw */
+    var37.i = (orc_uint8) var35;
+    /* 6: subw */
+    var38.i = var36.i - var37.i;
+    /* 7: absw */
+    var39.i = ORC_ABS (var38.i);
+    /* 8: convuwl */
+    var40.i = (orc_uint16) var39.i;
+    /* 9: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var40.i);
+  }
+  ex->accumulators[0] = var12.i;
+
+}
+
+void
+video_filters_bad_orc_sad_u8_2 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  OrcExecutor _ex, *ex = &_ex;
+  static volatile int p_inited = 0;
+  static OrcCode *c = 0;
+  void (*func) (OrcExecutor *);
+
+  if (!p_inited) {
+    orc_once_mutex_lock ();
+    if (!p_inited) {
+      OrcProgram *p;
+
+#if 1
+      static const orc_uint8 bc[] = {
+        1, 9, 30, 118, 105, 100, 101, 111, 95, 102, 105, 108, 116, 101, 114,
+        115, 95, 98, 97, 100, 95, 111, 114, 99, 95, 115, 97, 100, 95, 117, 56,
+        95, 50, 12, 2, 2, 12, 2, 2, 13, 4, 20, 1, 20, 1, 20, 2, 20, 2, 20, 4,
+        157, 32, 4, 157, 33, 5, 150, 34, 32, 150, 35, 33, 98, 34, 34, 35, 69,
+        34, 34, 154, 36, 34, 181, 12, 36, 2, 0,
+      };
+      p = orc_program_new_from_static_bytecode (bc);
+      orc_program_set_backup_function (p,
+          _backup_video_filters_bad_orc_sad_u8_2);
+#else
+      p = orc_program_new ();
+      orc_program_set_name (p, "video_filters_bad_orc_sad_u8_2");
+      orc_program_set_backup_function (p,
+          _backup_video_filters_bad_orc_sad_u8_2);
+      orc_program_add_source (p, 2, "s1");
+      orc_program_add_source (p, 2, "s2");
+      orc_program_add_accumulator (p, 4, "a1");
+      orc_program_add_temporary (p, 1, "b1");
+      orc_program_add_temporary (p, 1, "b2");
+      orc_program_add_temporary (p, 2, "t1");
+      orc_program_add_temporary (p, 2, "t2");
+      orc_program_add_temporary (p, 4, "t3");
+
+      orc_program_append_2 (p, "convwb", 0, ORC_VAR_T1, ORC_VAR_S1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convwb", 0, ORC_VAR_T2, ORC_VAR_S2, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T3, ORC_VAR_T1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T4, ORC_VAR_T2, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "subw", 0, ORC_VAR_T3, ORC_VAR_T3, ORC_VAR_T4,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "absw", 0, ORC_VAR_T3, ORC_VAR_T3, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convuwl", 0, ORC_VAR_T5, ORC_VAR_T3, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "accl", 0, ORC_VAR_A1, ORC_VAR_T5, ORC_VAR_D1,
+          ORC_VAR_D1);
+#endif
+
+      orc_program_compile (p);
+      c = orc_program_take_code (p);
+      orc_program_free (p);
+    }
+    p_inited = TRUE;
+    orc_once_mutex_unlock ();
+  }
+  ex->arrays[ORC_VAR_A2] = c;
+  ex->program = 0;
+
+  ex->n = n;
+  ex->arrays[ORC_VAR_S1] = (void *) s1;
+  ex->arrays[ORC_VAR_S2] = (void *) s2;
+
+  func = c->exec;
+  func (ex);
+  *a1 = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+}
+#endif
+
+
+/* video_filters_bad_orc_sad_u8_4 */
+#ifdef DISABLE_ORC
+void
+video_filters_bad_orc_sad_u8_4 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  int i;
+  const orc_union32 *ORC_RESTRICT ptr4;
+  const orc_union32 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_union32 var32;
+  orc_union16 var33;
+  orc_int8 var34;
+  orc_union32 var35;
+  orc_union16 var36;
+  orc_int8 var37;
+  orc_union16 var38;
+  orc_union16 var39;
+  orc_union16 var40;
+  orc_union16 var41;
+  orc_union32 var42;
+
+  ptr4 = (orc_union32 *) s1;
+  ptr5 = (orc_union32 *) s2;
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadl */
+    var32 = ptr4[i];
+    /* 1: convlw */
+    var33.i = var32.i;
+    /* 2: convwb */
+    var34 = var33.i;
+    /* 3: loadl */
+    var35 = ptr5[i];
+    /* 4: convlw */
+    var36.i = var35.i;
+    /* 5: convwb */
+    var37 = var36.i;
+    /* 6: convubw */
+    var38.i = (orc_uint8) var34;
+    /* 7: convubw */
+    var39.i = (orc_uint8) var37;
+    /* 8: subw */
+    var40.i = var38.i - var39.i;
+    /* 9: absw */
+    var41.i = ORC_ABS (var40.i);
+    /* 10: convuwl */
+    var42.i = (orc_uint16) var41.i;
+    /* 11: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var42.i);
+  }
+  *a1 = var12.i;
+
+}
+
+#else
+static void
+_backup_video_filters_bad_orc_sad_u8_4 (OrcExecutor * ORC_RESTRICT ex)
+{
+  int i;
+  int n = ex->n;
+  const orc_union32 *ORC_RESTRICT ptr4;
+  const orc_union32 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_union32 var32;
+  orc_union16 var33;
+  orc_int8 var34;
+  orc_union32 var35;
+  orc_union16 var36;
+  orc_int8 var37;
+  orc_union16 var38;
+  orc_union16 var39;
+  orc_union16 var40;
+  orc_union16 var41;
+  orc_union32 var42;
+
+  ptr4 = (orc_union32 *) ex->arrays[4];
+  ptr5 = (orc_union32 *) ex->arrays[5];
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadl */
+    var32 = ptr4[i];
+    /* 1: convlw */
+    var33.i = var32.i;
+    /* 2: convwb */
+    var34 = var33.i;
+    /* 3: loadl */
+    var35 = ptr5[i];
+    /* 4: convlw */
+    var36.i = var35.i;
+    /* 5: convwb */
+    var37 = var36.i;
+    /* 6: convubw */
+    var38.i = (orc_uint8) var34;
+    /* 7: convubw */
+    var39.i = (orc_uint8) var37;
+    /* 8: subw */
+    var40.i = var38.i - var39.i;
+    /* 9: absw */
+    var41.i = ORC_ABS (var40.i);
+    /* 10: convuwl */
+    var42.i = (orc_uint16) var41.i;
+    /* 11: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var42.i);
+  }
+  ex->accumulators[0] = var12.i;
+
+}
+
+void
+video_filters_bad_orc_sad_u8_4 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  OrcExecutor _ex, *ex = &_ex;
+  static volatile int p_inited = 0;
+  static OrcCode *c = 0;
+  void (*func) (OrcExecutor *);
+
+  if (!p_inited) {
+    orc_once_mutex_lock ();
+    if (!p_inited) {
+      OrcProgram *p;
+
+#if 1
+      static const orc_uint8 bc[] = {
+        1, 9, 30, 118, 105, 100, 101, 111, 95, 102, 105, 108, 116, 101, 114,
+        115, 95, 98, 97, 100, 95, 111, 114, 99, 95, 115, 97, 100, 95, 117, 56,
+        95, 52, 12, 4, 4, 12, 4, 4, 13, 4, 20, 2, 20, 2, 20, 1, 20, 1, 20, 2,
+        20, 2, 20, 4, 163, 32, 4, 157, 34, 32, 163, 33, 5, 157, 35, 33, 150,
+        36, 34, 150, 37, 35, 98, 36, 36, 37, 69, 36, 36, 154, 38, 36, 181, 12,
+        38, 2, 0,
+      };
+      p = orc_program_new_from_static_bytecode (bc);
+      orc_program_set_backup_function (p,
+          _backup_video_filters_bad_orc_sad_u8_4);
+#else
+      p = orc_program_new ();
+      orc_program_set_name (p, "video_filters_bad_orc_sad_u8_4");
+      orc_program_set_backup_function (p,
+          _backup_video_filters_bad_orc_sad_u8_4);
+      orc_program_add_source (p, 4, "s1");
+      orc_program_add_source (p, 4, "s2");
+      orc_program_add_accumulator (p, 4, "a1");
+      orc_program_add_temporary (p, 2, "w1");
+      orc_program_add_temporary (p, 2, "w2");
+      orc_program_add_temporary (p, 1, "b1");
+      orc_program_add_temporary (p, 1, "b2");
+      orc_program_add_temporary (p, 2, "t1");
+      orc_program_add_temporary (p, 2, "t2");
+      orc_program_add_temporary (p, 4, "t3");
+
+      orc_program_append_2 (p, "convlw", 0, ORC_VAR_T1, ORC_VAR_S1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convwb", 0, ORC_VAR_T3, ORC_VAR_T1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convlw", 0, ORC_VAR_T2, ORC_VAR_S2, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convwb", 0, ORC_VAR_T4, ORC_VAR_T2, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T5, ORC_VAR_T3, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T6, ORC_VAR_T4, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "subw", 0, ORC_VAR_T5, ORC_VAR_T5, ORC_VAR_T6,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "absw", 0, ORC_VAR_T5, ORC_VAR_T5, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convuwl", 0, ORC_VAR_T7, ORC_VAR_T5, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "accl", 0, ORC_VAR_A1, ORC_VAR_T7, ORC_VAR_D1,
+          ORC_VAR_D1);
+#endif
+
+      orc_program_compile (p);
+      c = orc_program_take_code (p);
+      orc_program_free (p);
+    }
+    p_inited = TRUE;
+    orc_once_mutex_unlock ();
+  }
+  ex->arrays[ORC_VAR_A2] = c;
+  ex->program = 0;
+
+  ex->n = n;
+  ex->arrays[ORC_VAR_S1] = (void *) s1;
+  ex->arrays[ORC_VAR_S2] = (void *) s2;
+
+  func = c->exec;
+  func (ex);
+  *a1 = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+}
+#endif
+
+
+/* video_filters_bad_orc_ssd_u8 */
+#ifdef DISABLE_ORC
+void
+video_filters_bad_orc_ssd_u8 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  int i;
+  const orc_int8 *ORC_RESTRICT ptr4;
+  const orc_int8 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_int8 var32;
+  orc_union16 var33;
+  orc_int8 var34;
+  orc_union16 var35;
+  orc_union16 var36;
+  orc_union32 var37;
+
+  ptr4 = (orc_int8 *) s1;
+  ptr5 = (orc_int8 *) s2;
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadb */
+    var32 = ptr4[i];
+    /* 1: convubw */
+    var33.i = (orc_uint8) var32;
+    /* 2: loadb */
+    var34 = ptr5[i];
+    /* 3: convubw */
+    var35.i = (orc_uint8) var34;
+    /* 4: subw */
+    var36.i = var33.i - var35.i;
+    /* 5: mulswl */
+    var37.i = var36.i * var36.i;
+    /* 6: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var37.i);
+  }
+  *a1 = var12.i;
+
+}
+
+#else
+static void
+_backup_video_filters_bad_orc_ssd_u8 (OrcExecutor * ORC_RESTRICT ex)
+{
+  int i;
+  int n = ex->n;
+  const orc_int8 *ORC_RESTRICT ptr4;
+  const orc_int8 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_int8 var32;
+  orc_union16 var33;
+  orc_int8 var34;
+  orc_union16 var35;
+  orc_union16 var36;
+  orc_union32 var37;
+
+  ptr4 = (orc_int8 *) ex->arrays[4];
+  ptr5 = (orc_int8 *) ex->arrays[5];
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadb */
+    var32 = ptr4[i];
+    /* 1: convubw */
+    var33.i = (orc_uint8) var32;
+    /* 2: loadb */
+    var34 = ptr5[i];
+    /* 3: convubw */
+    var35.i = (orc_uint8) var34;
+    /* 4: subw */
+    var36.i = var33.i - var35.i;
+    /* 5: mulswl */
+    var37.i = var36.i * var36.i;
+    /* 6: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var37.i);
+  }
+  ex->accumulators[0] = var12.i;
+
+}
+
+void
+video_filters_bad_orc_ssd_u8 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  OrcExecutor _ex, *ex = &_ex;
+  static volatile int p_inited = 0;
+  static OrcCode *c = 0;
+  void (*func) (OrcExecutor *);
+
+  if (!p_inited) {
+    orc_once_mutex_lock ();
+    if (!p_inited) {
+      OrcProgram *p;
+
+#if 1
+      static const orc_uint8 bc[] = {
+        1, 9, 28, 118, 105, 100, 101, 111, 95, 102, 105, 108, 116, 101, 114,
+        115, 95, 98, 97, 100, 95, 111, 114, 99, 95, 115, 115, 100, 95, 117, 56,
+        12, 1, 1, 12, 1, 1, 13, 4, 20, 2, 20, 2, 20, 4, 150, 32, 4, 150, 33, 5,
+        98, 32, 32, 33, 176, 34, 32, 32, 181, 12, 34, 2, 0,
+      };
+      p = orc_program_new_from_static_bytecode (bc);
+      orc_program_set_backup_function (p, _backup_video_filters_bad_orc_ssd_u8);
+#else
+      p = orc_program_new ();
+      orc_program_set_name (p, "video_filters_bad_orc_ssd_u8");
+      orc_program_set_backup_function (p, _backup_video_filters_bad_orc_ssd_u8);
+      orc_program_add_source (p, 1, "s1");
+      orc_program_add_source (p, 1, "s2");
+      orc_program_add_accumulator (p, 4, "a1");
+      orc_program_add_temporary (p, 2, "t1");
+      orc_program_add_temporary (p, 2, "t2");
+      orc_program_add_temporary (p, 4, "t3");
+
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T1, ORC_VAR_S1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T2, ORC_VAR_S2, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "subw", 0, ORC_VAR_T1, ORC_VAR_T1, ORC_VAR_T2,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "mulswl", 0, ORC_VAR_T3, ORC_VAR_T1, ORC_VAR_T1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "accl", 0, ORC_VAR_A1, ORC_VAR_T3, ORC_VAR_D1,
+          ORC_VAR_D1);
+#endif
+
+      orc_program_compile (p);
+      c = orc_program_take_code (p);
+      orc_program_free (p);
+    }
+    p_inited = TRUE;
+    orc_once_mutex_unlock ();
+  }
+  ex->arrays[ORC_VAR_A2] = c;
+  ex->program = 0;
+
+  ex->n = n;
+  ex->arrays[ORC_VAR_S1] = (void *) s1;
+  ex->arrays[ORC_VAR_S2] = (void *) s2;
+
+  func = c->exec;
+  func (ex);
+  *a1 = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+}
+#endif
+
+
+/* video_filters_bad_orc_ssd_u8_2 */
+#ifdef DISABLE_ORC
+void
+video_filters_bad_orc_ssd_u8_2 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  int i;
+  const orc_union16 *ORC_RESTRICT ptr4;
+  const orc_union16 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_union16 var32;
+  orc_int8 var33;
+  orc_union16 var34;
+  orc_int8 var35;
+  orc_union16 var36;
+  orc_union16 var37;
+  orc_union16 var38;
+  orc_union32 var39;
+
+  ptr4 = (orc_union16 *) s1;
+  ptr5 = (orc_union16 *) s2;
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadw */
+    var32 = ptr4[i];
+    /* 1: convwb */
+    var33 = var32.i;
+    /* 2: loadw */
+    var34 = ptr5[i];
+    /* 3: convwb */
+    var35 = var34.i;
+    /* 4: convubw */
+    var36.i = (orc_uint8) var33;
+    /* 5: convubw */
+    var37.i = (orc_uint8) var35;
+    /* 6: subw */
+    var38.i = var36.i - var37.i;
+    /* 7: mulswl */
+    var39.i = var38.i * var38.i;
+    /* 8: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var39.i);
+  }
+  *a1 = var12.i;
+
+}
+
+#else
+static void
+_backup_video_filters_bad_orc_ssd_u8_2 (OrcExecutor * ORC_RESTRICT ex)
+{
+  int i;
+  int n = ex->n;
+  const orc_union16 *ORC_RESTRICT ptr4;
+  const orc_union16 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_union16 var32;
+  orc_int8 var33;
+  orc_union16 var34;
+  orc_int8 var35;
+  orc_union16 var36;
+  orc_union16 var37;
+  orc_union16 var38;
+  orc_union32 var39;
+
+  ptr4 = (orc_union16 *) ex->arrays[4];
+  ptr5 = (orc_union16 *) ex->arrays[5];
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadw */
+    var32 = ptr4[i];
+    /* 1: convwb */
+    var33 = var32.i;
+    /* 2: loadw */
+    var34 = ptr5[i];
+    /* 3: convwb */
+    var35 = var34.i;
+    /* 4: convubw */
+    var36.i = (orc_uint8) var33;
+    /* 5: convubw */
+    var37.i = (orc_uint8) var35;
+    /* 6: subw */
+    var38.i = var36.i - var37.i;
+    /* 7: mulswl */
+    var39.i = var38.i * var38.i;
+    /* 8: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var39.i);
+  }
+  ex->accumulators[0] = var12.i;
+
+}
+
+void
+video_filters_bad_orc_ssd_u8_2 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  OrcExecutor _ex, *ex = &_ex;
+  static volatile int p_inited = 0;
+  static OrcCode *c = 0;
+  void (*func) (OrcExecutor *);
+
+  if (!p_inited) {
+    orc_once_mutex_lock ();
+    if (!p_inited) {
+      OrcProgram *p;
+
+#if 1
+      static const orc_uint8 bc[] = {
+        1, 9, 30, 118, 105, 100, 101, 111, 95, 102, 105, 108, 116, 101, 114,
+        115, 95, 98, 97, 100, 95, 111, 114, 99, 95, 115, 115, 100, 95, 117, 56,
+        95, 50, 12, 2, 2, 12, 2, 2, 13, 4, 20, 1, 20, 1, 20, 2, 20, 2, 20, 4,
+        157, 32, 4, 157, 33, 5, 150, 34, 32, 150, 35, 33, 98, 34, 34, 35, 176,
+        36, 34, 34, 181, 12, 36, 2, 0,
+      };
+      p = orc_program_new_from_static_bytecode (bc);
+      orc_program_set_backup_function (p,
+          _backup_video_filters_bad_orc_ssd_u8_2);
+#else
+      p = orc_program_new ();
+      orc_program_set_name (p, "video_filters_bad_orc_ssd_u8_2");
+      orc_program_set_backup_function (p,
+          _backup_video_filters_bad_orc_ssd_u8_2);
+      orc_program_add_source (p, 2, "s1");
+      orc_program_add_source (p, 2, "s2");
+      orc_program_add_accumulator (p, 4, "a1");
+      orc_program_add_temporary (p, 1, "b1");
+      orc_program_add_temporary (p, 1, "b2");
+      orc_program_add_temporary (p, 2, "t1");
+      orc_program_add_temporary (p, 2, "t2");
+      orc_program_add_temporary (p, 4, "t3");
+
+      orc_program_append_2 (p, "convwb", 0, ORC_VAR_T1, ORC_VAR_S1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convwb", 0, ORC_VAR_T2, ORC_VAR_S2, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T3, ORC_VAR_T1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T4, ORC_VAR_T2, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "subw", 0, ORC_VAR_T3, ORC_VAR_T3, ORC_VAR_T4,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "mulswl", 0, ORC_VAR_T5, ORC_VAR_T3, ORC_VAR_T3,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "accl", 0, ORC_VAR_A1, ORC_VAR_T5, ORC_VAR_D1,
+          ORC_VAR_D1);
+#endif
+
+      orc_program_compile (p);
+      c = orc_program_take_code (p);
+      orc_program_free (p);
+    }
+    p_inited = TRUE;
+    orc_once_mutex_unlock ();
+  }
+  ex->arrays[ORC_VAR_A2] = c;
+  ex->program = 0;
+
+  ex->n = n;
+  ex->arrays[ORC_VAR_S1] = (void *) s1;
+  ex->arrays[ORC_VAR_S2] = (void *) s2;
+
+  func = c->exec;
+  func (ex);
+  *a1 = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+}
+#endif
+
+
+/* video_filters_bad_orc_ssd_u8_4 */
+#ifdef DISABLE_ORC
+void
+video_filters_bad_orc_ssd_u8_4 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  int i;
+  const orc_union32 *ORC_RESTRICT ptr4;
+  const orc_union32 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_union32 var32;
+  orc_union16 var33;
+  orc_int8 var34;
+  orc_union32 var35;
+  orc_union16 var36;
+  orc_int8 var37;
+  orc_union16 var38;
+  orc_union16 var39;
+  orc_union16 var40;
+  orc_union32 var41;
+
+  ptr4 = (orc_union32 *) s1;
+  ptr5 = (orc_union32 *) s2;
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadl */
+    var32 = ptr4[i];
+    /* 1: convlw */
+    var33.i = var32.i;
+    /* 2: convwb */
+    var34 = var33.i;
+    /* 3: loadl */
+    var35 = ptr5[i];
+    /* 4: convlw */
+    var36.i = var35.i;
+    /* 5: convwb */
+    var37 = var36.i;
+    /* 6: convubw */
+    var38.i = (orc_uint8) var34;
+    /* 7: convubw */
+    var39.i = (orc_uint8) var37;
+    /* 8: subw */
+    var40.i = var38.i - var39.i;
+    /* 9: mulswl */
+    var41.i = var40.i * var40.i;
+    /* 10: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var41.i);
+  }
+  *a1 = var12.i;
+
+}
+
+#else
+static void
+_backup_video_filters_bad_orc_ssd_u8_4 (OrcExecutor * ORC_RESTRICT ex)
+{
+  int i;
+  int n = ex->n;
+  const orc_union32 *ORC_RESTRICT ptr4;
+  const orc_union32 *ORC_RESTRICT ptr5;
+  orc_union32 var12 = { 0 };
+  orc_union32 var32;
+  orc_union16 var33;
+  orc_int8 var34;
+  orc_union32 var35;
+  orc_union16 var36;
+  orc_int8 var37;
+  orc_union16 var38;
+  orc_union16 var39;
+  orc_union16 var40;
+  orc_union32 var41;
+
+  ptr4 = (orc_union32 *) ex->arrays[4];
+  ptr5 = (orc_union32 *) ex->arrays[5];
+
+  for (i = 0; i < n; i++) {
+    /* 0: loadl */
+    var32 = ptr4[i];
+    /* 1: convlw */
+    var33.i = var32.i;
+    /* 2: convwb */
+    var34 = var33.i;
+    /* 3: loadl */
+    var35 = ptr5[i];
+    /* 4: convlw */
+    var36.i = var35.i;
+    /* 5: convwb */
+    var37 = var36.i;
+    /* 6: convubw */
+    var38.i = (orc_uint8) var34;
+    /* 7: convubw */
+    var39.i = (orc_uint8) var37;
+    /* 8: subw */
+    var40.i = var38.i - var39.i;
+    /* 9: mulswl */
+    var41.i = var40.i * var40.i;
+    /* 10: accl */
+    var12.i = ((orc_uint32) var12.i) + ((orc_uint32) var41.i);
+  }
+  ex->accumulators[0] = var12.i;
+
+}
+
+void
+video_filters_bad_orc_ssd_u8_4 (guint32 * ORC_RESTRICT a1,
+    const guint8 * ORC_RESTRICT s1, const guint8 * ORC_RESTRICT s2,
+    int n)
+{
+  OrcExecutor _ex, *ex = &_ex;
+  static volatile int p_inited = 0;
+  static OrcCode *c = 0;
+  void (*func) (OrcExecutor *);
+
+  if (!p_inited) {
+    orc_once_mutex_lock ();
+    if (!p_inited) {
+      OrcProgram *p;
+
+#if 1
+      static const orc_uint8 bc[] = {
+        1, 9, 30, 118, 105, 100, 101, 111, 95, 102, 105, 108, 116, 101, 114,
+        115, 95, 98, 97, 100, 95, 111, 114, 99, 95, 115, 115, 100, 95, 117, 56,
+        95, 52, 12, 4, 4, 12, 4, 4, 13, 4, 20, 2, 20, 2, 20, 1, 20, 1, 20, 2,
+        20, 2, 20, 4, 163, 32, 4, 157, 34, 32, 163, 33, 5, 157, 35, 33, 150,
+        36, 34, 150, 37, 35, 98, 36, 36, 37, 176, 38, 36, 36, 181, 12, 38, 2,
+        0,
+      };
+      p = orc_program_new_from_static_bytecode (bc);
+      orc_program_set_backup_function (p,
+          _backup_video_filters_bad_orc_ssd_u8_4);
+#else
+      p = orc_program_new ();
+      orc_program_set_name (p, "video_filters_bad_orc_ssd_u8_4");
+      orc_program_set_backup_function (p,
+          _backup_video_filters_bad_orc_ssd_u8_4);
+      orc_program_add_source (p, 4, "s1");
+      orc_program_add_source (p, 4, "s2");
+      orc_program_add_accumulator (p, 4, "a1");
+      orc_program_add_temporary (p, 2, "w1");
+      orc_program_add_temporary (p, 2, "w2");
+      orc_program_add_temporary (p, 1, "b1");
+      orc_program_add_temporary (p, 1, "b2");
+      orc_program_add_temporary (p, 2, "t1");
+      orc_program_add_temporary (p, 2, "t2");
+      orc_program_add_temporary (p, 4, "t3");
+
+      orc_program_append_2 (p, "convlw", 0, ORC_VAR_T1, ORC_VAR_S1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convwb", 0, ORC_VAR_T3, ORC_VAR_T1, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convlw", 0, ORC_VAR_T2, ORC_VAR_S2, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convwb", 0, ORC_VAR_T4, ORC_VAR_T2, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T5, ORC_VAR_T3, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "convubw", 0, ORC_VAR_T6, ORC_VAR_T4, ORC_VAR_D1,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "subw", 0, ORC_VAR_T5, ORC_VAR_T5, ORC_VAR_T6,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "mulswl", 0, ORC_VAR_T7, ORC_VAR_T5, ORC_VAR_T5,
+          ORC_VAR_D1);
+      orc_program_append_2 (p, "accl", 0, ORC_VAR_A1, ORC_VAR_T7, ORC_VAR_D1,
+          ORC_VAR_D1);
+#endif
+
+      orc_program_compile (p);
+      c = orc_program_take_code (p);
+      orc_program_free (p);
+    }
+    p_inited = TRUE;
+    orc_once_mutex_unlock ();
+  }
+  ex->arrays[ORC_VAR_A2] = c;
+  ex->program = 0;
+
+  ex->n = n;
+  ex->arrays[ORC_VAR_S1] = (void *) s1;
+  ex->arrays[ORC_VAR_S2] = (void *) s2;
+
+  func = c->exec;
+  func (ex);
+  *a1 = orc_executor_get_accumulator (ex, ORC_VAR_A1);
+}
+#endif
@@ -0,0 +1,1058 @@
+/* GStreamer
+ * Copyright (C) <2009> Руслан Ижбулатов <lrn1986 _at_ gmail _dot_ com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* SSIM calculation for the ssim element.
+ *
+ * The reference engine computes the weighted window sums for every pixel
+ * separately, which is O(width * height * windowsize^2).
+ *
+ * Both the Gaussian and the flat window are separable, so the separable
+ * engine filters every row horizontally into a ring of windowsize rows and
+ * then filters those columns vertically, which is O(width * height *
+ * windowsize). The sums are accumulated in floats with the pixel values
+ * centered around 128 to keep the cancellation in the variances small.
+ * Edges are handled by leaving out the samples outside of the frame and
+ * normalizing exactly like the reference engine does, so both engines agree
+ * up to float rounding.
+ *
+ * The mean and variance of the original only depend on the original frame,
+ * gst_ssim_engine_set_original() calculates them once into the mu and sigma
+ * planes. Every comparison then only filters m, m*m and o*m. All bands of all
+ * comparisons passed to gst_ssim_engine_compare_many() are independent jobs
+ * that the calling thread and the thread pool work on together.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstssimengine.h"
+#include <gst/base/gstbandrunner.h>
+#include <string.h>
+#include <math.h>
+
+#if HAVE_CPU_X86_64
+#include <xmmintrin.h>
+#endif
+
+/* planes filtered for the original (o, o*o) and for comparisons (m, m*m,
+ * o*m) by the separable engine */
+#define N_ORIGINAL_SUMS 2
+#define N_COMPARISON_SUMS 3
+
+typedef struct _GstSSimEngineJob GstSSimEngineJob;
+
+struct _GstSSimEngineJob
+{
+  GstSSimEngine *engine;
+  /* NULL when calculating the statistics of the original */
+  GstSSimComparison *comparison;
+  gint y_start;
+  gint y_end;
+
+  /* windowsize horizontally filtered rows of up to N_COMPARISON_SUMS planes
+   * each, the input row and the vertical sums */
+  gfloat *ring;
+  gfloat *row;
+  gfloat *acc;
+
+  /* per band results */
+  gdouble sum;
+  gfloat lowest;
+  gfloat highest;
+};
+
+struct _GstSSimEngine
+{
+  GstSSimEngineType type;
+  gint width;
+  gint height;
+  gint ssimtype;
+  gint windowtype;
+  gint windowsize;
+  gfloat sigma;
+
+  gfloat const1;
+  gfloat const2;
+
+  /* reference engine */
+  GstSSimWindowCache *windows;
+  gfloat *weights;
+  gfloat *orgmu;
+
+  /* separable engine: 1-D weights and per column/row normalizations */
+  gfloat *kernel;
+  gfloat *norm_x, *norm_y;
+  gfloat *summ_x, *summ_y;
+
+  /* separable engine: mean and variance of the original */
+  gfloat *mu_o;
+  gfloat *sigma_o;
+
+  const guint8 *org;
+  gint org_stride;
+
+  /* bands per frame, and jobs with their scratch memory */
+  gint n_bands;
+  GstSSimEngineJob *jobs;
+  guint n_jobs;
+  guint n_jobs_allocated;
+
+  GstBandRunner *runner;
+};
+
+GstSSimEngine *
+gst_ssim_engine_new (void)
+{
+  GstSSimEngine *engine = g_new0 (GstSSimEngine, 1);
+
+  engine->n_bands = 1;
+  engine->runner = gst_band_runner_new ();
+
+  return engine;
+}
+
+static void
+gst_ssim_engine_free_jobs (GstSSimEngine * engine)
+{
+  guint i;
+
+  for (i = 0; i < engine->n_jobs_allocated; i++) {
+    g_free (engine->jobs[i].ring);
+    g_free (engine->jobs[i].row);
+    g_free (engine->jobs[i].acc);
+  }
+  g_free (engine->jobs);
+  engine->jobs = NULL;
+  engine->n_jobs = 0;
+  engine->n_jobs_allocated = 0;
+}
+
+static void
+gst_ssim_engine_clear (GstSSimEngine * engine)
+{
+  g_free (engine->windows);
+  engine->windows = NULL;
+  g_free (engine->weights);
+  engine->weights = NULL;
+  g_free (engine->orgmu);
+  engine->orgmu = NULL;
+
+  g_free (engine->kernel);
+  engine->kernel = NULL;
+  g_free (engine->norm_x);
+  engine->norm_x = NULL;
+  g_free (engine->norm_y);
+  engine->norm_y = NULL;
+  g_free (engine->summ_x);
+  engine->summ_x = NULL;
+  g_free (engine->summ_y);
+  engine->summ_y = NULL;
+  g_free (engine->mu_o);
+  engine->mu_o = NULL;
+  g_free (engine->sigma_o);
+  engine->sigma_o = NULL;
+
+  gst_ssim_engine_free_jobs (engine);
+}
+
+void
+gst_ssim_engine_free (GstSSimEngine * engine)
+{
+  gst_band_runner_free (engine->runner);
+
+  gst_ssim_engine_clear (engine);
+
+  g_free (engine);
+}
+
+/* Reference engine */
+
+typedef gfloat (*GstSSimWeightFunc) (GstSSimEngine * engine, gint y, gint x);
+
+static gfloat
+gst_ssim_weight_func_none (GstSSimEngine * engine, gint y, gint x)
+{
+  return 1;
+}
+
+static gfloat
+gst_ssim_weight_func_gauss (GstSSimEngine * engine, gint y, gint x)
+{
+  gfloat coord = sqrt (x * x + y * y);
+  return exp (-1 * (coord * coord) / (2 * engine->sigma * engine->sigma)) /
+      (engine->sigma * sqrt (2 * G_PI));
+}
+
+static void
+gst_ssim_regenerate_windows (GstSSimEngine * engine)
+{
+  gint windowiseven;
+  gint y, x, y2, x2;
+  GstSSimWeightFunc func;
+  gfloat normal_summ = 0;
+  gint normal_count = 0;
+
+  engine->weights = g_new (gfloat, engine->windowsize * engine->windowsize);
+
+  windowiseven =
+      ((gint) engine->windowsize / 2) * 2 == engine->windowsize ? 1 : 0;
+
+  engine->windows =
+      g_new (GstSSimWindowCache, engine->height * engine->width);
+
+  if (engine->windowtype == 0)
+    func = gst_ssim_weight_func_none;
+  else
+    func = gst_ssim_weight_func_gauss;
+
+  for (y = 0; y < engine->windowsize; y++) {
+    gint yoffset = y * engine->windowsize;
+    for (x = 0; x < engine->windowsize; x++) {
+      engine->weights[yoffset + x] = func (engine, x - engine->windowsize / 2 +
+          windowiseven, y - engine->windowsize / 2 + windowiseven);
+      normal_summ += engine->weights[yoffset + x];
+      normal_count++;
+    }
+  }
+
+  for (y = 0; y < engine->height; y++) {
+    for (x = 0; x < engine->width; x++) {
+      GstSSimWindowCache win;
+      gint element_count = 0;
+
+      win.x_window_start = x - engine->windowsize / 2 + windowiseven;
+      win.x_weight_start = 0;
+      if (win.x_window_start < 0) {
+        win.x_weight_start = -win.x_window_start;
+        win.x_window_start = 0;
+      }
+
+      win.x_window_end = x + engine->windowsize / 2;
+      if (win.x_window_end >= engine->width)
+        win.x_window_end = engine->width - 1;
+
+      win.y_window_start = y - engine->windowsize / 2 + windowiseven;
+      win.y_weight_start = 0;
+      if (win.y_window_start < 0) {
+        win.y_weight_start = -win.y_window_start;
+        win.y_window_start = 0;
+      }
+
+      win.y_window_end = y + engine->windowsize / 2;
+      if (win.y_window_end >= engine->height)
+        win.y_window_end = engine->height - 1;
+
+      win.element_summ = 0;
+      element_count = (win.y_window_end - win.y_window_start + 1) *
+          (win.x_window_end - win.x_window_start + 1);
+      if (element_count == normal_count)
+        win.element_summ = normal_summ;
+      else {
+        for (y2 = win.y_weight_start; y2 < engine->windowsize; y2++) {
+          for (x2 = win.x_weight_start; x2 < engine->windowsize; x2++) {
+            win.element_summ += engine->weights[y2 * engine->windowsize + x2];
+          }
+        }
+      }
+      engine->windows[(y * engine->width + x)] = win;
+    }
+  }
+}
+
+static void
+calculate_mu (GstSSimEngine * engine, gfloat * outmu, const guint8 * buf,
+    gint stride)
+{
+  gint oy, ox, iy, ix;
+
+  for (oy = 0; oy < engine->height; oy++) {
+    for (ox = 0; ox < engine->width; ox++) {
+      gfloat mu = 0;
+      gfloat elsumm;
+      gint weight_y_base, weight_x_base;
+      gint weight_offset;
+      gint pixel_offset;
+      gint winstart_y;
+      gint wghstart_y;
+      gint winend_y;
+      gint winstart_x;
+      gint wghstart_x;
+      gint winend_x;
+      gfloat weight;
+      gint source_offset;
+
+      source_offset = oy * engine->width + ox;
+
+      winstart_x = engine->windows[source_offset].x_window_start;
+      wghstart_x = engine->windows[source_offset].x_weight_start;
+      winend_x = engine->windows[source_offset].x_window_end;
+      winstart_y = engine->windows[source_offset].y_window_start;
+      wghstart_y = engine->windows[source_offset].y_weight_start;
+      winend_y = engine->windows[source_offset].y_window_end;
+      elsumm = engine->windows[source_offset].element_summ;
+
+      switch (engine->windowtype) {
+        case 0:
+          for (iy = winstart_y; iy <= winend_y; iy++) {
+            pixel_offset = iy * stride;
+            for (ix = winstart_x; ix <= winend_x; ix++)
+              mu += buf[pixel_offset + ix];
+          }
+          mu = mu / elsumm;
+          break;
+        case 1:
+
+          weight_y_base = wghstart_y - winstart_y;
+          weight_x_base = wghstart_x - winstart_x;
+
+          for (iy = winstart_y; iy <= winend_y; iy++) {
+            pixel_offset = iy * stride;
+            weight_offset = (weight_y_base + iy) * engine->windowsize +
+                weight_x_base;
+            for (ix = winstart_x; ix <= winend_x; ix++) {
+              weight = engine->weights[weight_offset + ix];
+              mu += weight * buf[pixel_offset + ix];
+            }
+          }
+          mu = mu / elsumm;
+          break;
+      }
+      outmu[oy * engine->width + ox] = mu;
+    }
+  }
+
+}
+
+static void
+calcssim_without_mu (GstSSimEngine * engine, const guint8 * org,
+    gint org_stride, const gfloat * orgmu, const guint8 * mod, gint mod_stride,
+    guint8 * out, gint out_stride, gfloat * mean, gfloat * lowest,
+    gfloat * highest)
+{
+  gint oy, ox, iy, ix;
+  gfloat cumulative_ssim = 0;
+  *lowest = G_MAXFLOAT;
+  *highest = -G_MAXFLOAT;
+
+  for (oy = 0; oy < engine->height; oy++) {
+    for (ox = 0; ox < engine->width; ox++) {
+      gfloat mu_o = 128, mu_m = 128;
+      gdouble sigma_o = 0, sigma_m = 0, sigma_om = 0;
+      gfloat tmp1 = 0, tmp2 = 0;
+      gfloat elsumm = 0;
+      gint weight_y_base, weight_x_base;
+      gint weight_offset;
+      gint winstart_y;
+      gint wghstart_y;
+      gint winend_y;
+      gint winstart_x;
+      gint wghstart_x;
+      gint winend_x;
+      gfloat weight;
+      gint source_offset;
+
+      source_offset = oy * engine->width + ox;
+
+      winstart_x = engine->windows[source_offset].x_window_start;
+      wghstart_x = engine->windows[source_offset].x_weight_start;
+      winend_x = engine->windows[source_offset].x_window_end;
+      winstart_y = engine->windows[source_offset].y_window_start;
+      wghstart_y = engine->windows[source_offset].y_weight_start;
+      winend_y = engine->windows[source_offset].y_window_end;
+      elsumm = engine->windows[source_offset].element_summ;
+
+      weight_y_base = wghstart_y - winstart_y;
+      weight_x_base = wghstart_x - winstart_x;
+      switch (engine->windowtype) {
+        case 0:
+          for (iy = winstart_y; iy <= winend_y; iy++) {
+            const guint8 *org_with_offset, *mod_with_offset;
+            org_with_offset = &org[iy * org_stride];
+            mod_with_offset = &mod[iy * mod_stride];
+            for (ix = winstart_x; ix <= winend_x; ix++) {
+              tmp1 = org_with_offset[ix] - mu_o;
+              sigma_o += tmp1 * tmp1;
+              tmp2 = mod_with_offset[ix] - mu_m;
+              sigma_m += tmp2 * tmp2;
+              sigma_om += tmp1 * tmp2;
+            }
+          }
+          break;
+        case 1:
+
+          weight_y_base = wghstart_y - winstart_y;
+          weight_x_base = wghstart_x - winstart_x;
+
+          for (iy = winstart_y; iy <= winend_y; iy++) {
+            const guint8 *org_with_offset, *mod_with_offset;
+            gfloat *weights_with_offset;
+            gfloat wt1, wt2;
+            weight_offset = (weight_y_base + iy) * engine->windowsize +
+                weight_x_base;
+            org_with_offset = &org[iy * org_stride];
+            mod_with_offset = &mod[iy * mod_stride];
+            weights_with_offset = &engine->weights[weight_offset];
+            for (ix = winstart_x; ix <= winend_x; ix++) {
+              weight = weights_with_offset[ix];
+              tmp1 = org_with_offset[ix] - mu_o;
+              tmp2 = mod_with_offset[ix] - mu_m;
+              wt1 = weight * tmp1;
+              wt2 = weight * tmp2;
+              sigma_o += wt1 * tmp1;
+              sigma_m += wt2 * tmp2;
+              sigma_om += wt1 * tmp2;
+            }
+          }
+          break;
+      }
+      sigma_o = sqrt (sigma_o / elsumm);
+      sigma_m = sqrt (sigma_m / elsumm);
+      sigma_om = sigma_om / elsumm;
+      tmp1 = (2 * mu_o * mu_m + engine->const1) * (2 * sigma_om +
+          engine->const2) / ((mu_o * mu_o + mu_m * mu_m + engine->const1) *
+          (sigma_o * sigma_o + sigma_m * sigma_m + engine->const2));
+
+      /* SSIM can go negative, that's why it is
+         127 + index * 128 instead of index * 255 */
+      out[oy * out_stride + ox] = 127 + tmp1 * 128;
+      *lowest = MIN (*lowest, tmp1);
+      *highest = MAX (*highest, tmp1);
+      cumulative_ssim += tmp1;
+    }
+  }
+  *mean = cumulative_ssim / (engine->width * engine->height);
+}
+
+static void
+calcssim_canonical (GstSSimEngine * engine, const guint8 * org,
+    gint org_stride, const gfloat * orgmu, const guint8 * mod, gint mod_stride,
+    guint8 * out, gint out_stride, gfloat * mean, gfloat * lowest,
+    gfloat * highest)
+{
+  gint oy, ox, iy, ix;
+  gfloat cumulative_ssim = 0;
+  *lowest = G_MAXFLOAT;
+  *highest = -G_MAXFLOAT;
+
+  for (oy = 0; oy < engine->height; oy++) {
+    for (ox = 0; ox < engine->width; ox++) {
+      gfloat mu_o = 0, mu_m = 0;
+      gdouble sigma_o = 0, sigma_m = 0, sigma_om = 0;
+      gfloat tmp1, tmp2;
+      gfloat elsumm = 0;
+      gint weight_y_base, weight_x_base;
+      gint weight_offset;
+      gint winstart_y;
+      gint wghstart_y;
+      gint winend_y;
+      gint winstart_x;
+      gint wghstart_x;
+      gint winend_x;
+      gfloat weight;
+      gint source_offset;
+
+      source_offset = oy * engine->width + ox;
+
+      winstart_x = engine->windows[source_offset].x_window_start;
+      wghstart_x = engine->windows[source_offset].x_weight_start;
+      winend_x = engine->windows[source_offset].x_window_end;
+      winstart_y = engine->windows[source_offset].y_window_start;
+      wghstart_y = engine->windows[source_offset].y_weight_start;
+      winend_y = engine->windows[source_offset].y_window_end;
+      elsumm = engine->windows[source_offset].element_summ;
+
+      switch (engine->windowtype) {
+        case 0:
+          for (iy = winstart_y; iy <= winend_y; iy++) {
+            for (ix = winstart_x; ix <= winend_x; ix++) {
+              mu_m += mod[iy * mod_stride + ix];
+            }
+          }
+          mu_m = mu_m / elsumm;
+          mu_o = orgmu[oy * engine->width + ox];
+          for (iy = winstart_y; iy <= winend_y; iy++) {
+            for (ix = winstart_x; ix <= winend_x; ix++) {
+              tmp1 = org[iy * org_stride + ix] - mu_o;
+              tmp2 = mod[iy * mod_stride + ix] - mu_m;
+              sigma_o += tmp1 * tmp1;
+              sigma_m += tmp2 * tmp2;
+              sigma_om += tmp1 * tmp2;
+            }
+          }
+          break;
+        case 1:
+
+          weight_y_base = wghstart_y - winstart_y;
+          weight_x_base = wghstart_x - winstart_x;
+
+          for (iy = winstart_y; iy <= winend_y; iy++) {
+            weight_offset = (weight_y_base + iy) * engine->windowsize +
+                weight_x_base;
+            for (ix = winstart_x; ix <= winend_x; ix++) {
+              weight = engine->weights[weight_offset + ix];
+              mu_o += weight * org[iy * org_stride + ix];
+              mu_m += weight * mod[iy * mod_stride + ix];
+            }
+          }
+          mu_m = mu_m / elsumm;
+          mu_o = orgmu[oy * engine->width + ox];
+          for (iy = winstart_y; iy <= winend_y; iy++) {
+            gfloat *weights_with_offset;
+            const guint8 *org_with_offset, *mod_with_offset;
+            gfloat wt1, wt2;
+            weight_offset = (weight_y_base + iy) * engine->windowsize +
+                weight_x_base;
+            weights_with_offset = &engine->weights[weight_offset];
+            org_with_offset = &org[iy * org_stride];
+            mod_with_offset = &mod[iy * mod_stride];
+            for (ix = winstart_x; ix <= winend_x; ix++) {
+              weight = weights_with_offset[ix];
+              tmp1 = org_with_offset[ix] - mu_o;
+              tmp2 = mod_with_offset[ix] - mu_m;
+              wt1 = weight * tmp1;
+              wt2 = weight * tmp2;
+              sigma_o += wt1 * tmp1;
+              sigma_m += wt2 * tmp2;
+              sigma_om += wt1 * tmp2;
+            }
+          }
+          break;
+      }
+      sigma_o = sqrt (sigma_o / elsumm);
+      sigma_m = sqrt (sigma_m / elsumm);
+      sigma_om = sigma_om / elsumm;
+      tmp1 = (2 * mu_o * mu_m + engine->const1) * (2 * sigma_om +
+          engine->const2) / ((mu_o * mu_o + mu_m * mu_m + engine->const1) *
+          (sigma_o * sigma_o + sigma_m * sigma_m + engine->const2));
+
+      /* SSIM can go negative, that's why it is
+         127 + index * 128 instead of index * 255 */
+      out[oy * out_stride + ox] = 127 + tmp1 * 128;
+      *lowest = MIN (*lowest, tmp1);
+      *highest = MAX (*highest, tmp1);
+      cumulative_ssim += tmp1;
+    }
+  }
+  *mean = cumulative_ssim / (engine->width * engine->height);
+}
+
+/* Separable engine */
+
+/* dst[i] += a * src[i] */
+static inline void
+ssim_axpy (gfloat * dst, const gfloat * src, gfloat a, gint n)
+{
+  gint i = 0;
+
+#if HAVE_CPU_X86_64
+  __m128 va = _mm_set1_ps (a);
+
+  for (; i + 8 <= n; i += 8) {
+    __m128 d0 = _mm_loadu_ps (dst + i);
+    __m128 d1 = _mm_loadu_ps (dst + i + 4);
+
+    d0 = _mm_add_ps (d0, _mm_mul_ps (va, _mm_loadu_ps (src + i)));
+    d1 = _mm_add_ps (d1, _mm_mul_ps (va, _mm_loadu_ps (src + i + 4)));
+    _mm_storeu_ps (dst + i, d0);
+    _mm_storeu_ps (dst + i + 4, d1);
+  }
+#endif
+
+  for (; i < n; i++)
+    dst[i] += a * src[i];
+}
+
+/* Offset of the first window sample relative to the pixel, the window of
+ * pixel x covers x - offset ... x - offset + windowsize - 1 */
+static inline gint
+window_offset (GstSSimEngine * engine)
+{
+  return engine->windowsize / 2 - (engine->windowsize % 2 == 0 ? 1 : 0);
+}
+
+static void
+gst_ssim_engine_setup_normalization (GstSSimEngine * engine, gint size,
+    gfloat * norm, gfloat * summ)
+{
+  gint offset = window_offset (engine);
+  gint i, k;
+
+  for (i = 0; i < size; i++) {
+    norm[i] = 0;
+    summ[i] = 0;
+
+    for (k = 0; k < engine->windowsize; k++) {
+      gint pos = i + k - offset;
+
+      /* the reference engine only leaves out the weights before the start
+       * of the frame when normalizing, do the same */
+      if (pos >= 0)
+        norm[i] += engine->kernel[k];
+      if (pos >= 0 && pos < size)
+        summ[i] += engine->kernel[k];
+    }
+  }
+}
+
+static void
+gst_ssim_engine_setup_separable (GstSSimEngine * engine)
+{
+  gint offset = window_offset (engine);
+  gint k;
+
+  engine->kernel = g_new (gfloat, engine->windowsize);
+  for (k = 0; k < engine->windowsize; k++) {
+    gfloat d = k - offset;
+
+    /* The 1 / (sigma * sqrt (2 * pi)) factor of the reference weights
+     * cancels out in the normalization */
+    if (engine->windowtype == 0)
+      engine->kernel[k] = 1;
+    else
+      engine->kernel[k] = exp (-(d * d) / (2 * engine->sigma * engine->sigma));
+  }
+
+  engine->norm_x = g_new (gfloat, engine->width);
+  engine->summ_x = g_new (gfloat, engine->width);
+  engine->norm_y = g_new (gfloat, engine->height);
+  engine->summ_y = g_new (gfloat, engine->height);
+  gst_ssim_engine_setup_normalization (engine, engine->width, engine->norm_x,
+      engine->summ_x);
+  gst_ssim_engine_setup_normalization (engine, engine->height, engine->norm_y,
+      engine->summ_y);
+
+  engine->mu_o = g_new (gfloat, engine->width * engine->height);
+  engine->sigma_o = g_new (gfloat, engine->width * engine->height);
+}
+
+/* Sets up @n_comparisons * n_bands jobs, or n_bands jobs for the original if
+ * @comparisons is NULL */
+static void
+gst_ssim_engine_setup_jobs (GstSSimEngine * engine,
+    GstSSimComparison * comparisons, guint n_comparisons)
+{
+  guint i, n_jobs;
+
+  n_jobs = engine->n_bands * (comparisons ? n_comparisons : 1);
+
+  if (n_jobs > engine->n_jobs_allocated) {
+    engine->jobs = g_renew (GstSSimEngineJob, engine->jobs, n_jobs);
+    for (i = engine->n_jobs_allocated; i < n_jobs; i++) {
+      GstSSimEngineJob *job = &engine->jobs[i];
+
+      job->ring = g_new (gfloat,
+          engine->windowsize * N_COMPARISON_SUMS * engine->width);
+      job->row = g_new (gfloat, N_COMPARISON_SUMS * engine->width);
+      job->acc = g_new (gfloat, N_COMPARISON_SUMS * engine->width);
+    }
+    engine->n_jobs_allocated = n_jobs;
+  }
+
+  for (i = 0; i < n_jobs; i++) {
+    GstSSimEngineJob *job = &engine->jobs[i];
+    gint band = i % engine->n_bands;
+
+    job->engine = engine;
+    job->comparison = comparisons ? &comparisons[i / engine->n_bands] : NULL;
+    job->y_start = engine->height * band / engine->n_bands;
+    job->y_end = engine->height * (band + 1) / engine->n_bands;
+  }
+  engine->n_jobs = n_jobs;
+}
+
+/* Filters row @y horizontally into @dst: o and o*o for the original, m, m*m
+ * and o*m otherwise */
+static void
+filter_row (GstSSimEngine * engine, const guint8 * mod, gint mod_stride,
+    gfloat * row, gint y, gfloat * dst)
+{
+  const guint8 *org = engine->org + y * engine->org_stride;
+  gint width = engine->width;
+  gint offset = window_offset (engine);
+  gint n_sums = mod ? N_COMPARISON_SUMS : N_ORIGINAL_SUMS;
+  gint x, k, p;
+
+  if (mod) {
+    mod += y * mod_stride;
+
+    for (x = 0; x < width; x++) {
+      gfloat o = org[x] - 128.0f;
+      gfloat m = mod[x] - 128.0f;
+
+      row[x] = m;
+      row[width + x] = m * m;
+      row[2 * width + x] = o * m;
+    }
+  } else {
+    for (x = 0; x < width; x++) {
+      gfloat o = org[x] - 128.0f;
+
+      row[x] = o;
+      row[width + x] = o * o;
+    }
+  }
+
+  memset (dst, 0, sizeof (gfloat) * n_sums * width);
+
+  for (k = 0; k < engine->windowsize; k++) {
+    gint d = k - offset;
+    gint x_start = MAX (0, -d);
+    gint x_end = MIN (width, width - d);
+
+    if (x_end <= x_start)
+      continue;
+
+    for (p = 0; p < n_sums; p++)
+      ssim_axpy (dst + p * width + x_start, row + p * width + x_start + d,
+          engine->kernel[k], x_end - x_start);
+  }
+}
+
+/* Filters the rows of the job's band and calls @func for each of them with
+ * the vertical sums in job->acc */
+static void
+filter_band (GstSSimEngineJob * job, const guint8 * mod, gint mod_stride,
+    void (*func) (GstSSimEngineJob * job, gint y))
+{
+  GstSSimEngine *engine = job->engine;
+  gint width = engine->width, height = engine->height;
+  gint windowsize = engine->windowsize;
+  gint offset = window_offset (engine);
+  gint n_sums = mod ? N_COMPARISON_SUMS : N_ORIGINAL_SUMS;
+  gint plane = n_sums * width;
+  gint y, k, p, next_row;
+
+  next_row = MAX (0, job->y_start - offset);
+
+  for (y = job->y_start; y < job->y_end; y++) {
+    gint last_row = MIN (height - 1, y - offset + windowsize - 1);
+
+    /* The ring holds the rows of the window of this line, row r in slot
+     * r % windowsize */
+    for (; next_row <= last_row; next_row++)
+      filter_row (engine, mod, mod_stride, job->row, next_row,
+          job->ring + (next_row % windowsize) * plane);
+
+    memset (job->acc, 0, sizeof (gfloat) * plane);
+    for (k = 0; k < windowsize; k++) {
+      gint r = y + k - offset;
+
+      if (r < 0 || r >= height)
+        continue;
+
+      for (p = 0; p < n_sums; p++)
+        ssim_axpy (job->acc + p * width,
+            job->ring + (r % windowsize) * plane + p * width,
+            engine->kernel[k], width);
+    }
+
+    func (job, y);
+  }
+}
+
+static void
+original_row (GstSSimEngineJob * job, gint y)
+{
+  GstSSimEngine *engine = job->engine;
+  gint width = engine->width;
+  const gfloat *so = job->acc, *soo = job->acc + width;
+  gfloat *mu_o = engine->mu_o + y * width;
+  gfloat *sigma_o = engine->sigma_o + y * width;
+  gint x;
+
+  for (x = 0; x < width; x++) {
+    gfloat norm = engine->norm_x[x] * engine->norm_y[y];
+    gfloat summ = engine->summ_x[x] * engine->summ_y[y];
+
+    if (engine->ssimtype == 0) {
+      /* mean relative to 128 over the normalization of the window */
+      gfloat c_o = (so[x] + 128.0f * summ) / norm - 128.0f;
+
+      mu_o[x] = c_o + 128.0f;
+      sigma_o[x] = (soo[x] - 2 * c_o * so[x] + c_o * c_o * summ) / norm;
+    } else {
+      mu_o[x] = 128.0f;
+      sigma_o[x] = soo[x] / norm;
+    }
+
+    /* rounding can make flat areas slightly negative */
+    sigma_o[x] = MAX (sigma_o[x], 0);
+  }
+}
+
+static void
+comparison_row (GstSSimEngineJob * job, gint y)
+{
+  GstSSimEngine *engine = job->engine;
+  GstSSimComparison *comparison = job->comparison;
+  gint width = engine->width;
+  const gfloat *sm = job->acc, *smm = job->acc + width;
+  const gfloat *som = job->acc + 2 * width;
+  const gfloat *mu_o = engine->mu_o + y * width;
+  const gfloat *sigma_o = engine->sigma_o + y * width;
+  guint8 *out = comparison->out + y * comparison->out_stride;
+  gint x;
+
+  for (x = 0; x < width; x++) {
+    gfloat norm = engine->norm_x[x] * engine->norm_y[y];
+    gfloat summ = engine->summ_x[x] * engine->summ_y[y];
+    gfloat mu_m, sigma_m, sigma_om;
+    gfloat ssim;
+
+    if (engine->ssimtype == 0) {
+      gfloat c_o = mu_o[x] - 128.0f;
+      gfloat c_m = (sm[x] + 128.0f * summ) / norm - 128.0f;
+      /* sum of the centered original over the window */
+      gfloat so = mu_o[x] * norm - 128.0f * summ;
+
+      mu_m = c_m + 128.0f;
+      sigma_m = (smm[x] - 2 * c_m * sm[x] + c_m * c_m * summ) / norm;
+      sigma_om = (som[x] - c_o * sm[x] - c_m * so + c_o * c_m * summ) / norm;
+    } else {
+      mu_m = 128.0f;
+      sigma_m = smm[x] / norm;
+      sigma_om = som[x] / norm;
+    }
+
+    sigma_m = MAX (sigma_m, 0);
+
+    ssim = (2 * mu_o[x] * mu_m + engine->const1) * (2 * sigma_om +
+        engine->const2) / ((mu_o[x] * mu_o[x] + mu_m * mu_m +
+            engine->const1) * (sigma_o[x] + sigma_m + engine->const2));
+
+    if (out)
+      out[x] = 127 + ssim * 128;
+    job->lowest = MIN (job->lowest, ssim);
+    job->highest = MAX (job->highest, ssim);
+    job->sum += ssim;
+  }
+}
+
+static void
+run_job (GstSSimEngineJob * job)
+{
+  if (job->comparison == NULL) {
+    filter_band (job, NULL, 0, original_row);
+  } else {
+    job->sum = 0;
+    job->lowest = G_MAXFLOAT;
+    job->highest = -G_MAXFLOAT;
+    filter_band (job, job->comparison->mod, job->comparison->mod_stride,
+        comparison_row);
+  }
+}
+
+static void
+gst_ssim_engine_job_func (guint job, guint n_jobs, gpointer user_data)
+{
+  GstSSimEngine *engine = user_data;
+
+  run_job (&engine->jobs[job]);
+}
+
+static void
+gst_ssim_engine_run_jobs (GstSSimEngine * engine)
+{
+  gst_band_runner_run (engine->runner, engine->n_jobs,
+      gst_ssim_engine_job_func, engine);
+}
+
+/**
+ * gst_ssim_engine_set_threads:
+ * @engine: a #GstSSimEngine
+ * @n_threads: number of threads to use for the separable engine, 0 for the
+ *     number of processors
+ * @error: return location for an error
+ *
+ * Sets the number of threads, the calling thread being one of them. Must not
+ * be called while a comparison is in progress.
+ *
+ * Returns: %FALSE if the worker threads could not be created
+ */
+gboolean
+gst_ssim_engine_set_threads (GstSSimEngine * engine, guint n_threads,
+    GError ** error)
+{
+  gboolean ret;
+
+  ret = gst_band_runner_set_threads (engine->runner, n_threads, error);
+  engine->n_bands = MAX (1,
+      MIN ((gint) gst_band_runner_get_n_threads (engine->runner),
+          engine->height));
+
+  return ret;
+}
+
+/**
+ * gst_ssim_engine_configure:
+ * @engine: a #GstSSimEngine
+ * @type: the engine to use
+ * @width: width of the frames
+ * @height: height of the frames
+ * @ssimtype: 0 for canonical SSIM, 1 for SSIM with a fixed mu of 128
+ * @windowtype: 0 for a flat window, 1 for a Gaussian window
+ * @windowsize: width and height of the window
+ * @sigma: deviation of the Gaussian window
+ *
+ * (Re)allocates everything for comparing frames of @width x @height.
+ */
+void
+gst_ssim_engine_configure (GstSSimEngine * engine, GstSSimEngineType type,
+    gint width, gint height, gint ssimtype, gint windowtype, gint windowsize,
+    gfloat sigma)
+{
+  gst_ssim_engine_clear (engine);
+
+  engine->type = type;
+  engine->width = width;
+  engine->height = height;
+  engine->ssimtype = ssimtype;
+  engine->windowtype = windowtype;
+  engine->windowsize = windowsize;
+  engine->sigma = sigma;
+  engine->org = NULL;
+
+  /* FIXME: while 0.01 and 0.03 are pretty much static, the 255 implies that
+   * we're working with 8-bit-per-color-component format, which may not be true
+   */
+  engine->const1 = 0.01 * 255 * 0.01 * 255;
+  engine->const2 = 0.03 * 255 * 0.03 * 255;
+
+  engine->n_bands = MAX (1,
+      MIN ((gint) gst_band_runner_get_n_threads (engine->runner), height));
+
+  if (type == GST_SSIM_ENGINE_TYPE_REFERENCE) {
+    gst_ssim_regenerate_windows (engine);
+    if (ssimtype == 0)
+      engine->orgmu = g_new (gfloat, width * height);
+  } else {
+    gst_ssim_engine_setup_separable (engine);
+  }
+}
+
+/**
+ * gst_ssim_engine_set_original:
+ * @engine: a #GstSSimEngine
+ * @org: luma plane of the original frame
+ * @org_stride: stride of @org
+ *
+ * Sets the frame that following comparisons are made against, and
+ * calculates everything that only depends on it. @org must stay valid until
+ * the comparisons are done.
+ */
+void
+gst_ssim_engine_set_original (GstSSimEngine * engine, const guint8 * org,
+    gint org_stride)
+{
+  engine->org = org;
+  engine->org_stride = org_stride;
+
+  if (engine->type == GST_SSIM_ENGINE_TYPE_REFERENCE) {
+    /* Mu is just a blur, we can calculate it once */
+    if (engine->ssimtype == 0)
+      calculate_mu (engine, engine->orgmu, org, org_stride);
+  } else {
+    gst_ssim_engine_setup_jobs (engine, NULL, 0);
+    gst_ssim_engine_run_jobs (engine);
+  }
+}
+
+/**
+ * gst_ssim_engine_compare_many:
+ * @engine: a #GstSSimEngine
+ * @comparisons: the frames to compare against the original
+ * @n_comparisons: number of @comparisons
+ *
+ * Calculates the SSIM index of every comparison's frame against the original
+ * frame. With the separable engine the comparisons are done concurrently.
+ */
+void
+gst_ssim_engine_compare_many (GstSSimEngine * engine,
+    GstSSimComparison * comparisons, guint n_comparisons)
+{
+  guint i, j;
+
+  g_return_if_fail (engine->org != NULL);
+
+  if (n_comparisons == 0)
+    return;
+
+  if (engine->type == GST_SSIM_ENGINE_TYPE_REFERENCE) {
+    for (i = 0; i < n_comparisons; i++) {
+      GstSSimComparison *c = &comparisons[i];
+
+      if (engine->ssimtype == 0)
+        calcssim_canonical (engine, engine->org, engine->org_stride,
+            engine->orgmu, c->mod, c->mod_stride, c->out, c->out_stride,
+            &c->mean, &c->lowest, &c->highest);
+      else
+        calcssim_without_mu (engine, engine->org, engine->org_stride,
+            engine->orgmu, c->mod, c->mod_stride, c->out, c->out_stride,
+            &c->mean, &c->lowest, &c->highest);
+    }
+    return;
+  }
+
+  gst_ssim_engine_setup_jobs (engine, comparisons, n_comparisons);
+  gst_ssim_engine_run_jobs (engine);
+
+  for (i = 0; i < n_comparisons; i++) {
+    GstSSimComparison *c = &comparisons[i];
+    gdouble sum = 0;
+
+    c->lowest = G_MAXFLOAT;
+    c->highest = -G_MAXFLOAT;
+    for (j = 0; j < engine->n_bands; j++) {
+      GstSSimEngineJob *job = &engine->jobs[i * engine->n_bands + j];
+
+      sum += job->sum;
+      c->lowest = MIN (c->lowest, job->lowest);
+      c->highest = MAX (c->highest, job->highest);
+    }
+    c->mean = sum / (engine->width * engine->height);
+  }
+}
+
+/**
+ * gst_ssim_engine_compare:
+ * @engine: a #GstSSimEngine
+ * @mod: luma plane of the modified frame
+ * @mod_stride: stride of @mod
+ * @out: destination for the SSIM map, scaled to 127 + ssim * 128
+ * @out_stride: stride of @out
+ * @mean: return location for the mean SSIM
+ * @lowest: return location for the lowest SSIM
+ * @highest: return location for the highest SSIM
+ *
+ * Calculates the SSIM index of @mod against the original frame.
+ */
+void
+gst_ssim_engine_compare (GstSSimEngine * engine, const guint8 * mod,
+    gint mod_stride, guint8 * out, gint out_stride, gfloat * mean,
+    gfloat * lowest, gfloat * highest)
+{
+  GstSSimComparison c = { mod, mod_stride, out, out_stride, };
+
+  gst_ssim_engine_compare_many (engine, &c, 1);
+
+  *mean = c.mean;
+  *lowest = c.lowest;
+  *highest = c.highest;
+}
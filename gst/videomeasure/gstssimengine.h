@@ -0,0 +1,104 @@
+/* GStreamer
+ * Copyright (C) <2009> Руслан Ижбулатов <lrn1986 _at_ gmail _dot_ com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef __GST_SSIM_ENGINE_H__
+#define __GST_SSIM_ENGINE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GstSSimEngineType:
+ * @GST_SSIM_ENGINE_TYPE_REFERENCE: sums the whole window for every pixel,
+ *     single threaded. Kept for comparisons with earlier results.
+ * @GST_SSIM_ENGINE_TYPE_SEPARABLE: filters rows and columns separately,
+ *     processing bands of rows in parallel.
+ */
+typedef enum {
+  GST_SSIM_ENGINE_TYPE_REFERENCE = 0,
+  GST_SSIM_ENGINE_TYPE_SEPARABLE = 1
+} GstSSimEngineType;
+
+typedef struct _GstSSimWindowCache {
+  gint x_window_start;
+  gint x_weight_start;
+  gint x_window_end;
+  gint y_window_start;
+  gint y_weight_start;
+  gint y_window_end;
+  gfloat element_summ;
+} GstSSimWindowCache;
+
+typedef struct _GstSSimEngine GstSSimEngine;
+
+/**
+ * GstSSimComparison:
+ * @mod: luma plane of the modified frame
+ * @mod_stride: stride of @mod
+ * @out: destination for the SSIM map scaled to 127 + ssim * 128, or %NULL
+ * @out_stride: stride of @out
+ * @mean: the mean SSIM
+ * @lowest: the lowest SSIM
+ * @highest: the highest SSIM
+ *
+ * A frame to compare against the original, and the results.
+ */
+typedef struct {
+  const guint8 *mod;
+  gint mod_stride;
+  guint8 *out;
+  gint out_stride;
+
+  gfloat mean;
+  gfloat lowest;
+  gfloat highest;
+} GstSSimComparison;
+
+GstSSimEngine *gst_ssim_engine_new        (void);
+void           gst_ssim_engine_free       (GstSSimEngine * engine);
+
+gboolean       gst_ssim_engine_set_threads (GstSSimEngine * engine,
+                                            guint n_threads,
+                                            GError ** error);
+
+void           gst_ssim_engine_configure  (GstSSimEngine * engine,
+                                           GstSSimEngineType type,
+                                           gint width, gint height,
+                                           gint ssimtype, gint windowtype,
+                                           gint windowsize, gfloat sigma);
+
+void           gst_ssim_engine_set_original (GstSSimEngine * engine,
+                                             const guint8 * org,
+                                             gint org_stride);
+
+void           gst_ssim_engine_compare_many (GstSSimEngine * engine,
+                                             GstSSimComparison * comparisons,
+                                             guint n_comparisons);
+
+void           gst_ssim_engine_compare    (GstSSimEngine * engine,
+                                           const guint8 * mod,
+                                           gint mod_stride,
+                                           guint8 * out, gint out_stride,
+                                           gfloat * mean, gfloat * lowest,
+                                           gfloat * highest);
+
+G_END_DECLS
+
+#endif /* __GST_SSIM_ENGINE_H__ */
@@ -29,11 +29,12 @@
 
 GstEvent *
 gst_event_new_measured (guint64 framenumber, GstClockTime timestamp,
-    const gchar * metric, const GValue * mean, const GValue * lowest,
-    const GValue * highest)
+    const gchar * stream, const gchar * metric, const GValue * mean,
+    const GValue * lowest, const GValue * highest)
 {
   GstStructure *str = gst_structure_new (GST_EVENT_VIDEO_MEASURE,
       "event", G_TYPE_STRING, "frame-measured",
+      "stream", G_TYPE_STRING, stream,
       "offset", G_TYPE_UINT64, framenumber,
       "timestamp", GST_TYPE_CLOCK_TIME, timestamp,
       "metric", G_TYPE_STRING, metric,
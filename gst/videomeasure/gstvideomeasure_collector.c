@@ -63,16 +63,15 @@ GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS_ANY);
 
-//static GstBaseTransformClass *parent_class = NULL;
-
 static void gst_measure_collector_finalize (GObject * object);
-static gboolean gst_measure_collector_event (GstBaseTransform * base,
+static gboolean gst_measure_collector_sink_event (GstBaseTransform * base,
     GstEvent * event);
 static void gst_measure_collector_save_csv (GstMeasureCollector * mc);
 
 static void gst_measure_collector_post_message (GstMeasureCollector * mc);
 
-GST_BOILERPLATE (GstMeasureCollector, gst_measure_collector, GstBaseTransform,
+#define gst_measure_collector_parent_class parent_class
+G_DEFINE_TYPE (GstMeasureCollector, gst_measure_collector,
     GST_TYPE_BASE_TRANSFORM);
 
 static void
@@ -92,6 +91,15 @@ gst_measure_collector_collect (GstMeasureCollector * mc, GstEvent * gstevent)
     GstStructure *cpy;
     cpy = gst_structure_copy (str);
 
+    /* Measurements of several streams share the frame numbers, keep them in
+     * the order they arrive in */
+    if (gst_structure_has_field (str, "stream")) {
+      g_ptr_array_add (mc->measurements, cpy);
+      if (!mc->metric)
+        mc->metric = g_strdup (metric);
+      return;
+    }
+
     framenumber_v = gst_structure_get_value (str, "offset");
     if (framenumber_v) {
       if (G_VALUE_TYPE (framenumber_v) == G_TYPE_UINT64)
@@ -118,24 +126,47 @@ static void
 gst_measure_collector_post_message (GstMeasureCollector * mc)
 {
   GstMessage *m;
+  GstStructure *s, *streams = NULL;
   guint64 i;
 
-  g_return_if_fail (mc->metric);
+  if (mc->metric == NULL)
+    return;
 
   if (strcmp (mc->metric, "SSIM") == 0) {
     gfloat dresult = 0;
     guint64 mlen;
+    GHashTable *sums;
+    GHashTableIter iter;
+    gpointer key, value;
+
+    if (mc->result)
+      g_value_unset (mc->result);
     g_free (mc->result);
     mc->result = g_new0 (GValue, 1);
     g_value_init (mc->result, G_TYPE_FLOAT);
+    /* per stream sums and counts, if the measurements name streams */
+    sums = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
     mlen = mc->measurements->len;
     for (i = 0; i < mc->measurements->len; i++) {
       const GValue *v;
+      const gchar *stream;
       GstStructure *str =
           (GstStructure *) g_ptr_array_index (mc->measurements, i);
       if (str) {
         v = gst_structure_get_value (str, "mean");
         dresult += g_value_get_float (v);
+
+        stream = gst_structure_get_string (str, "stream");
+        if (stream) {
+          gdouble *sum = g_hash_table_lookup (sums, stream);
+
+          if (sum == NULL) {
+            sum = g_new0 (gdouble, 2);
+            g_hash_table_insert (sums, (gpointer) stream, sum);
+          }
+          sum[0] += g_value_get_float (v);
+          sum[1] += 1;
+        }
       } else {
         GST_WARNING_OBJECT (mc,
             "No measurement info for frame %" G_GUINT64_FORMAT, i);
@@ -143,11 +174,30 @@ gst_measure_collector_post_message (GstMeasureCollector * mc)
       }
     }
     g_value_set_float (mc->result, dresult / mlen);
+
+    if (g_hash_table_size (sums) > 0) {
+      streams = gst_structure_new_empty ("streams");
+      g_hash_table_iter_init (&iter, sums);
+      while (g_hash_table_iter_next (&iter, &key, &value)) {
+        gdouble *sum = value;
+
+        gst_structure_set (streams, (const gchar *) key, G_TYPE_FLOAT,
+            (gfloat) (sum[0] / sum[1]), NULL);
+      }
+    }
+    g_hash_table_unref (sums);
   }
 
-  m = gst_message_new_element (GST_OBJECT_CAST (mc),
-      gst_structure_new ("GstMeasureCollector",
-          "measure-result", G_TYPE_VALUE, mc->result, NULL));
+  if (mc->result == NULL)
+    return;
+
+  s = gst_structure_new_empty ("GstMeasureCollector");
+  gst_structure_set_value (s, "measure-result", mc->result);
+  if (streams) {
+    gst_structure_set (s, "stream-results", GST_TYPE_STRUCTURE, streams, NULL);
+    gst_structure_free (streams);
+  }
+  m = gst_message_new_element (GST_OBJECT_CAST (mc), s);
 
   gst_element_post_message (GST_ELEMENT_CAST (mc), m);
 }
@@ -195,7 +245,7 @@ gst_measure_collector_get_property (GObject * object, guint prop_id,
 }
 
 static gboolean
-gst_measure_collector_event (GstBaseTransform * base, GstEvent * event)
+gst_measure_collector_sink_event (GstBaseTransform * base, GstEvent * event)
 {
   GstMeasureCollector *mc = GST_MEASURE_COLLECTOR (base);
 
@@ -212,7 +262,7 @@ gst_measure_collector_event (GstBaseTransform * base, GstEvent * event)
       break;
   }
 
-  return parent_class->event (base, event);
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (base, event);
 }
 
 static void
@@ -311,9 +361,15 @@ open_failed:
 }
 
 static void
-gst_measure_collector_base_init (gpointer g_class)
+gst_measure_collector_class_init (GstMeasureCollectorClass * klass)
 {
-  GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+  GObjectClass *gobject_class;
+  GstElementClass *element_class;
+  GstBaseTransformClass *trans_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  element_class = GST_ELEMENT_CLASS (klass);
+  trans_class = GST_BASE_TRANSFORM_CLASS (klass);
 
   gst_element_class_set_static_metadata (element_class,
       "Video measure collector", "Filter/Effect/Video",
@@ -324,16 +380,6 @@ gst_measure_collector_base_init (gpointer g_class)
       gst_static_pad_template_get (&gst_measure_collector_sink_template));
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&gst_measure_collector_src_template));
-}
-
-static void
-gst_measure_collector_class_init (GstMeasureCollectorClass * klass)
-{
-  GObjectClass *gobject_class;
-  GstBaseTransformClass *trans_class;
-
-  gobject_class = G_OBJECT_CLASS (klass);
-  trans_class = GST_BASE_TRANSFORM_CLASS (klass);
 
   GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, "measurecollect", 0,
       "measurement collector");
@@ -354,15 +400,15 @@ gst_measure_collector_class_init (GstMeasureCollectorClass * klass)
           " information", "",
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
-  trans_class->event = GST_DEBUG_FUNCPTR (gst_measure_collector_event);
+  trans_class->sink_event =
+      GST_DEBUG_FUNCPTR (gst_measure_collector_sink_event);
 
   trans_class->passthrough_on_same_caps = TRUE;
 
 }
 
 static void
-gst_measure_collector_init (GstMeasureCollector * instance,
-    GstMeasureCollectorClass * g_class)
+gst_measure_collector_init (GstMeasureCollector * instance)
 {
   GstMeasureCollector *measurecollector;
 
@@ -397,6 +443,8 @@ gst_measure_collector_finalize (GObject * object)
   g_ptr_array_free (mc->measurements, TRUE);
   mc->measurements = NULL;
 
+  if (mc->result)
+    g_value_unset (mc->result);
   g_free (mc->result);
   mc->result = NULL;
 
@@ -27,6 +27,13 @@
  * gst-launch -v filesrc location=file.y4m ! y4mdec ! xvimagesink
  * ]|
  * </refsect2>
+ *
+ * When upstream supports pull mode, seeking to any frame is a direct
+ * lookup: frame offsets follow from the frame size as long as the FRAME
+ * headers have no parameters, which is checked on every pulled frame. Only
+ * files with parameters in their FRAME headers are indexed. Frames are
+ * pulled one by one and pushed without copying, described with a
+ * #GstVideoMeta when downstream supports it.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -41,6 +48,7 @@
 #include <string.h>
 
 #define MAX_SIZE 32768
+#define MAX_HEADER_LENGTH 80
 
 GST_DEBUG_CATEGORY (y4mdec_debug);
 #define GST_CAT_DEFAULT y4mdec_debug
@@ -59,6 +67,11 @@ static GstFlowReturn gst_y4m_dec_chain (GstPad * pad, GstObject * parent,
     GstBuffer * buffer);
 static gboolean gst_y4m_dec_sink_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
+static gboolean gst_y4m_dec_sink_activate (GstPad * sinkpad,
+    GstObject * parent);
+static gboolean gst_y4m_dec_sink_activatemode (GstPad * sinkpad,
+    GstObject * parent, GstPadMode mode, gboolean active);
+static void gst_y4m_dec_loop (GstPad * pad);
 
 static gboolean gst_y4m_dec_src_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
@@ -120,6 +133,8 @@ static void
 gst_y4m_dec_init (GstY4mDec * y4mdec)
 {
   y4mdec->adapter = gst_adapter_new ();
+  y4mdec->frame_offsets = g_array_new (FALSE, FALSE, sizeof (guint64));
+  gst_segment_init (&y4mdec->time_segment, GST_FORMAT_TIME);
 
   y4mdec->sinkpad =
       gst_pad_new_from_static_template (&gst_y4m_dec_sink_template, "sink");
@@ -127,6 +142,10 @@ gst_y4m_dec_init (GstY4mDec * y4mdec)
       GST_DEBUG_FUNCPTR (gst_y4m_dec_sink_event));
   gst_pad_set_chain_function (y4mdec->sinkpad,
       GST_DEBUG_FUNCPTR (gst_y4m_dec_chain));
+  gst_pad_set_activate_function (y4mdec->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_y4m_dec_sink_activate));
+  gst_pad_set_activatemode_function (y4mdec->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_y4m_dec_sink_activatemode));
   gst_element_add_pad (GST_ELEMENT (y4mdec), y4mdec->sinkpad);
 
   y4mdec->srcpad = gst_pad_new_from_static_template (&gst_y4m_dec_src_template,
@@ -179,6 +198,10 @@ gst_y4m_dec_dispose (GObject * object)
     g_object_unref (y4mdec->adapter);
     y4mdec->adapter = NULL;
   }
+  if (y4mdec->frame_offsets) {
+    g_array_free (y4mdec->frame_offsets, TRUE);
+    y4mdec->frame_offsets = NULL;
+  }
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
@@ -225,6 +248,10 @@ gst_y4m_dec_change_state (GstElement * element, GstStateChange transition)
         gst_object_unref (y4mdec->pool);
       }
       y4mdec->pool = NULL;
+      y4mdec->have_header = FALSE;
+      y4mdec->n_frames = 0;
+      g_array_set_size (y4mdec->frame_offsets, 0);
+      gst_adapter_clear (y4mdec->adapter);
       break;
     case GST_STATE_CHANGE_READY_TO_NULL:
       break;
@@ -481,13 +508,157 @@ error:
   return FALSE;
 }
 
+/* Sets the caps from the parsed header and sets up a pool when the frames
+ * need stride conversion for downstream */
+static gboolean
+gst_y4m_dec_negotiate (GstY4mDec * y4mdec)
+{
+  GstCaps *caps;
+  GstQuery *query;
+  gboolean ret;
+
+  caps = gst_video_info_to_caps (&y4mdec->info);
+  ret = gst_pad_set_caps (y4mdec->srcpad, caps);
+
+  query = gst_query_new_allocation (caps, FALSE);
+  y4mdec->video_meta = FALSE;
+
+  if (y4mdec->pool) {
+    gst_buffer_pool_set_active (y4mdec->pool, FALSE);
+    gst_object_unref (y4mdec->pool);
+  }
+  y4mdec->pool = NULL;
+
+  if (gst_pad_peer_query (y4mdec->srcpad, query)) {
+    y4mdec->video_meta =
+        gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+
+    /* We only need a pool if we need to do stride conversion for downstream */
+    if (!y4mdec->video_meta && memcmp (&y4mdec->info, &y4mdec->out_info,
+            sizeof (y4mdec->info)) != 0) {
+      GstBufferPool *pool = NULL;
+      GstAllocator *allocator = NULL;
+      GstAllocationParams params;
+      GstStructure *config;
+      guint size, min, max;
+
+      if (gst_query_get_n_allocation_params (query) > 0) {
+        gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
+      } else {
+        allocator = NULL;
+        gst_allocation_params_init (&params);
+      }
+
+      if (gst_query_get_n_allocation_pools (query) > 0) {
+        gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min,
+            &max);
+        size = MAX (size, y4mdec->out_info.size);
+      } else {
+        pool = NULL;
+        size = y4mdec->out_info.size;
+        min = max = 0;
+      }
+
+      if (pool == NULL) {
+        pool = gst_video_buffer_pool_new ();
+      }
+
+      config = gst_buffer_pool_get_config (pool);
+      gst_buffer_pool_config_set_params (config, caps, size, min, max);
+      gst_buffer_pool_config_set_allocator (config, allocator, &params);
+      gst_buffer_pool_set_config (pool, config);
+
+      if (allocator)
+        gst_object_unref (allocator);
+
+      y4mdec->pool = pool;
+    }
+  } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
+          sizeof (y4mdec->info)) != 0) {
+    GstBufferPool *pool;
+    GstStructure *config;
+
+    /* No pool, create our own if we need to do stride conversion */
+    pool = gst_video_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, y4mdec->out_info.size, 0,
+        0);
+    gst_buffer_pool_set_config (pool, config);
+    y4mdec->pool = pool;
+  }
+  if (y4mdec->pool) {
+    gst_buffer_pool_set_active (y4mdec->pool, TRUE);
+  }
+  gst_query_unref (query);
+  gst_caps_unref (caps);
+
+  return ret;
+}
+
+/* Describes the strides of the frame in @buffer with a GstVideoMeta, or
+ * replaces it with a copy in the default layout */
+static GstFlowReturn
+gst_y4m_dec_convert_frame (GstY4mDec * y4mdec, GstBuffer ** buffer)
+{
+  GstFlowReturn flow_ret = GST_FLOW_OK;
+
+  if (y4mdec->video_meta) {
+    gst_buffer_add_video_meta_full (*buffer, 0, y4mdec->info.finfo->format,
+        y4mdec->info.width, y4mdec->info.height, y4mdec->info.finfo->n_planes,
+        y4mdec->info.offset, y4mdec->info.stride);
+  } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
+          sizeof (y4mdec->info)) != 0) {
+    GstBuffer *outbuf;
+    GstVideoFrame iframe, oframe;
+    gint i, j;
+    gint w, h, istride, ostride;
+    guint8 *src, *dest;
+
+    /* Allocate a new buffer and do stride conversion */
+    g_assert (y4mdec->pool != NULL);
+
+    flow_ret = gst_buffer_pool_acquire_buffer (y4mdec->pool, &outbuf, NULL);
+    if (flow_ret != GST_FLOW_OK) {
+      gst_buffer_unref (*buffer);
+      *buffer = NULL;
+      return flow_ret;
+    }
+
+    gst_video_frame_map (&iframe, &y4mdec->info, *buffer, GST_MAP_READ);
+    gst_video_frame_map (&oframe, &y4mdec->out_info, outbuf, GST_MAP_WRITE);
+
+    for (i = 0; i < 3; i++) {
+      w = GST_VIDEO_FRAME_COMP_WIDTH (&iframe, i);
+      h = GST_VIDEO_FRAME_COMP_HEIGHT (&iframe, i);
+      istride = GST_VIDEO_FRAME_COMP_STRIDE (&iframe, i);
+      ostride = GST_VIDEO_FRAME_COMP_STRIDE (&oframe, i);
+      src = GST_VIDEO_FRAME_COMP_DATA (&iframe, i);
+      dest = GST_VIDEO_FRAME_COMP_DATA (&oframe, i);
+
+      for (j = 0; j < h; j++) {
+        memcpy (dest, src, w);
+
+        dest += ostride;
+        src += istride;
+      }
+    }
+
+    gst_video_frame_unmap (&iframe);
+    gst_video_frame_unmap (&oframe);
+    gst_buffer_copy_into (outbuf, *buffer, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
+    gst_buffer_unref (*buffer);
+    *buffer = outbuf;
+  }
+
+  return flow_ret;
+}
+
 static GstFlowReturn
 gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 {
   GstY4mDec *y4mdec;
   int n_avail;
   GstFlowReturn flow_ret = GST_FLOW_OK;
-#define MAX_HEADER_LENGTH 80
   char header[MAX_HEADER_LENGTH];
   int i;
   int len;
@@ -506,8 +677,6 @@ gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
   if (!y4mdec->have_header) {
     gboolean ret;
-    GstCaps *caps;
-    GstQuery *query;
 
     if (n_avail < MAX_HEADER_LENGTH)
       return GST_FLOW_OK;
@@ -530,81 +699,7 @@ gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
     y4mdec->header_size = strlen (header) + 1;
     gst_adapter_flush (y4mdec->adapter, y4mdec->header_size);
 
-    caps = gst_video_info_to_caps (&y4mdec->info);
-    ret = gst_pad_set_caps (y4mdec->srcpad, caps);
-
-    query = gst_query_new_allocation (caps, FALSE);
-    y4mdec->video_meta = FALSE;
-
-    if (y4mdec->pool) {
-      gst_buffer_pool_set_active (y4mdec->pool, FALSE);
-      gst_object_unref (y4mdec->pool);
-    }
-    y4mdec->pool = NULL;
-
-    if (gst_pad_peer_query (y4mdec->srcpad, query)) {
-      y4mdec->video_meta =
-          gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
-
-      /* We only need a pool if we need to do stride conversion for downstream */
-      if (!y4mdec->video_meta && memcmp (&y4mdec->info, &y4mdec->out_info,
-              sizeof (y4mdec->info)) != 0) {
-        GstBufferPool *pool = NULL;
-        GstAllocator *allocator = NULL;
-        GstAllocationParams params;
-        GstStructure *config;
-        guint size, min, max;
-
-        if (gst_query_get_n_allocation_params (query) > 0) {
-          gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
-        } else {
-          allocator = NULL;
-          gst_allocation_params_init (&params);
-        }
-
-        if (gst_query_get_n_allocation_pools (query) > 0) {
-          gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min,
-              &max);
-          size = MAX (size, y4mdec->out_info.size);
-        } else {
-          pool = NULL;
-          size = y4mdec->out_info.size;
-          min = max = 0;
-        }
-
-        if (pool == NULL) {
-          pool = gst_video_buffer_pool_new ();
-        }
-
-        config = gst_buffer_pool_get_config (pool);
-        gst_buffer_pool_config_set_params (config, caps, size, min, max);
-        gst_buffer_pool_config_set_allocator (config, allocator, &params);
-        gst_buffer_pool_set_config (pool, config);
-
-        if (allocator)
-          gst_object_unref (allocator);
-
-        y4mdec->pool = pool;
-      }
-    } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
-            sizeof (y4mdec->info)) != 0) {
-      GstBufferPool *pool;
-      GstStructure *config;
-
-      /* No pool, create our own if we need to do stride conversion */
-      pool = gst_video_buffer_pool_new ();
-      config = gst_buffer_pool_get_config (pool);
-      gst_buffer_pool_config_set_params (config, caps, y4mdec->out_info.size, 0,
-          0);
-      gst_buffer_pool_set_config (pool, config);
-      y4mdec->pool = pool;
-    }
-    if (y4mdec->pool) {
-      gst_buffer_pool_set_active (y4mdec->pool, TRUE);
-    }
-    gst_query_unref (query);
-    gst_caps_unref (caps);
-    if (!ret) {
+    if (!gst_y4m_dec_negotiate (y4mdec)) {
       GST_DEBUG_OBJECT (y4mdec, "Couldn't set caps on src pad");
       return GST_FLOW_ERROR;
     }
@@ -666,7 +761,8 @@ gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
     gst_adapter_flush (y4mdec->adapter, len + 1);
 
-    buffer = gst_adapter_take_buffer (y4mdec->adapter, y4mdec->info.size);
+    buffer = gst_adapter_take_buffer_fast (y4mdec->adapter,
+        y4mdec->info.size);
 
     GST_BUFFER_TIMESTAMP (buffer) =
         gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index);
@@ -676,61 +772,415 @@ gst_y4m_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
 
     y4mdec->frame_index++;
 
-    if (y4mdec->video_meta) {
-      gst_buffer_add_video_meta_full (buffer, 0, y4mdec->info.finfo->format,
-          y4mdec->info.width, y4mdec->info.height, y4mdec->info.finfo->n_planes,
-          y4mdec->info.offset, y4mdec->info.stride);
-    } else if (memcmp (&y4mdec->info, &y4mdec->out_info,
-            sizeof (y4mdec->info)) != 0) {
-      GstBuffer *outbuf;
-      GstVideoFrame iframe, oframe;
-      gint i, j;
-      gint w, h, istride, ostride;
-      guint8 *src, *dest;
-
-      /* Allocate a new buffer and do stride conversion */
-      g_assert (y4mdec->pool != NULL);
-
-      flow_ret = gst_buffer_pool_acquire_buffer (y4mdec->pool, &outbuf, NULL);
-      if (flow_ret != GST_FLOW_OK) {
-        gst_buffer_unref (buffer);
-        break;
-      }
+    flow_ret = gst_y4m_dec_convert_frame (y4mdec, &buffer);
+    if (flow_ret != GST_FLOW_OK)
+      break;
+
+    flow_ret = gst_pad_push (y4mdec->srcpad, buffer);
+    if (flow_ret != GST_FLOW_OK)
+      break;
+  }
 
-      gst_video_frame_map (&iframe, &y4mdec->info, buffer, GST_MAP_READ);
-      gst_video_frame_map (&oframe, &y4mdec->out_info, outbuf, GST_MAP_WRITE);
+  GST_DEBUG ("returning %d", flow_ret);
 
-      for (i = 0; i < 3; i++) {
-        w = GST_VIDEO_FRAME_COMP_WIDTH (&iframe, i);
-        h = GST_VIDEO_FRAME_COMP_HEIGHT (&iframe, i);
-        istride = GST_VIDEO_FRAME_COMP_STRIDE (&iframe, i);
-        ostride = GST_VIDEO_FRAME_COMP_STRIDE (&oframe, i);
-        src = GST_VIDEO_FRAME_COMP_DATA (&iframe, i);
-        dest = GST_VIDEO_FRAME_COMP_DATA (&oframe, i);
+  return flow_ret;
+}
 
-        for (j = 0; j < h; j++) {
-          memcpy (dest, src, w);
+/* Reads the header line at @offset into @header, with the newline replaced
+ * by a NUL */
+static GstFlowReturn
+gst_y4m_dec_pull_header_line (GstY4mDec * y4mdec, guint64 offset,
+    char *header)
+{
+  GstBuffer *buffer = NULL;
+  GstFlowReturn ret;
+  gsize i, size;
+
+  ret = gst_pad_pull_range (y4mdec->sinkpad, offset, MAX_HEADER_LENGTH,
+      &buffer);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  size = gst_buffer_extract (buffer, 0, header, MAX_HEADER_LENGTH);
+  gst_buffer_unref (buffer);
+
+  header[MIN (size, MAX_HEADER_LENGTH - 1)] = 0;
+  for (i = 0; i < size; i++) {
+    if (header[i] == 0x0a)
+      header[i] = 0;
+  }
 
-          dest += ostride;
-          src += istride;
-        }
-      }
+  return GST_FLOW_OK;
+}
 
-      gst_video_frame_unmap (&iframe);
-      gst_video_frame_unmap (&oframe);
-      gst_buffer_copy_into (outbuf, buffer, GST_BUFFER_COPY_TIMESTAMPS, 0, -1);
-      gst_buffer_unref (buffer);
-      buffer = outbuf;
+/* Records the offset of the data of every frame in the file, for files with
+ * parameters in their FRAME headers. Each FRAME header is read, they are
+ * small reads with the frame data in between. */
+static GstFlowReturn
+gst_y4m_dec_build_index (GstY4mDec * y4mdec)
+{
+  char header[MAX_HEADER_LENGTH];
+  guint64 offset = y4mdec->header_size;
+  GstFlowReturn ret;
+
+  g_array_set_size (y4mdec->frame_offsets, 0);
+
+  while (offset + y4mdec->info.size + 6 <= y4mdec->upstream_size) {
+    ret = gst_y4m_dec_pull_header_line (y4mdec, offset, header);
+    if (ret != GST_FLOW_OK)
+      return ret;
+
+    if (memcmp (header, "FRAME", 5) != 0) {
+      GST_WARNING_OBJECT (y4mdec, "No FRAME header at offset %"
+          G_GUINT64_FORMAT ", ignoring the rest of the file", offset);
+      break;
     }
 
-    flow_ret = gst_pad_push (y4mdec->srcpad, buffer);
-    if (flow_ret != GST_FLOW_OK)
+    offset += strlen (header) + 1;
+    if (offset + y4mdec->info.size > y4mdec->upstream_size)
       break;
+
+    g_array_append_val (y4mdec->frame_offsets, offset);
+    offset += y4mdec->info.size;
   }
 
-  GST_DEBUG ("returning %d", flow_ret);
+  GST_DEBUG_OBJECT (y4mdec, "indexed %u frames", y4mdec->frame_offsets->len);
+  y4mdec->n_frames = y4mdec->frame_offsets->len;
 
-  return flow_ret;
+  return GST_FLOW_OK;
+}
+
+/* Pulls the data of a frame. Without an index the frame is assumed to
+ * start with a plain FRAME header, which is pulled and checked along with
+ * the data. */
+static GstFlowReturn
+gst_y4m_dec_pull_frame (GstY4mDec * y4mdec, gint64 frame_index,
+    GstBuffer ** buffer)
+{
+  GstMapInfo map;
+  guint64 offset;
+  gboolean plain;
+  GstFlowReturn ret;
+
+  if (y4mdec->frame_offsets->len > 0) {
+    offset = g_array_index (y4mdec->frame_offsets, guint64, frame_index);
+    ret = gst_pad_pull_range (y4mdec->sinkpad, offset, y4mdec->info.size,
+        buffer);
+    if (ret == GST_FLOW_OK && gst_buffer_get_size (*buffer) < y4mdec->info.size)
+      goto short_read;
+    return ret;
+  }
+
+  offset = gst_y4m_dec_frames_to_bytes (y4mdec, frame_index);
+  ret = gst_pad_pull_range (y4mdec->sinkpad, offset, y4mdec->info.size + 6,
+      buffer);
+  if (ret != GST_FLOW_OK)
+    return ret;
+  if (gst_buffer_get_size (*buffer) < y4mdec->info.size + 6)
+    goto short_read;
+
+  gst_buffer_map (*buffer, &map, GST_MAP_READ);
+  plain = memcmp (map.data, "FRAME\n", 6) == 0;
+  gst_buffer_unmap (*buffer, &map);
+
+  if (!plain) {
+    gst_buffer_unref (*buffer);
+    *buffer = NULL;
+
+    GST_DEBUG_OBJECT (y4mdec, "no plain FRAME header at offset %"
+        G_GUINT64_FORMAT ", indexing the file", offset);
+    ret = gst_y4m_dec_build_index (y4mdec);
+    if (ret != GST_FLOW_OK)
+      return ret;
+    if (frame_index >= y4mdec->n_frames || y4mdec->n_frames == 0)
+      return GST_FLOW_EOS;
+
+    return gst_y4m_dec_pull_frame (y4mdec, frame_index, buffer);
+  }
+
+  /* drop the header, the data stays where it was pulled */
+  gst_buffer_resize (*buffer, 6, y4mdec->info.size);
+
+  return GST_FLOW_OK;
+
+short_read:
+  GST_DEBUG_OBJECT (y4mdec, "short read at offset %" G_GUINT64_FORMAT, offset);
+  gst_buffer_unref (*buffer);
+  *buffer = NULL;
+  return GST_FLOW_EOS;
+}
+
+static GstFlowReturn
+gst_y4m_dec_pull_header (GstY4mDec * y4mdec)
+{
+  char header[MAX_HEADER_LENGTH];
+  gchar *stream_id;
+  gint64 size;
+  GstFlowReturn ret;
+
+  if (!gst_pad_peer_query_duration (y4mdec->sinkpad, GST_FORMAT_BYTES,
+          &size) || size < 0) {
+    GST_ELEMENT_ERROR (y4mdec, STREAM, FAILED, (NULL),
+        ("Could not query the upstream size"));
+    return GST_FLOW_ERROR;
+  }
+  y4mdec->upstream_size = size;
+
+  ret = gst_y4m_dec_pull_header_line (y4mdec, 0, header);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  if (!gst_y4m_dec_parse_header (y4mdec, header)) {
+    GST_ELEMENT_ERROR (y4mdec, STREAM, DECODE,
+        ("Failed to parse YUV4MPEG header"), (NULL));
+    return GST_FLOW_ERROR;
+  }
+  y4mdec->header_size = strlen (header) + 1;
+
+  /* frames are checked when they are pulled */
+  g_array_set_size (y4mdec->frame_offsets, 0);
+  y4mdec->n_frames = gst_y4m_dec_bytes_to_frames (y4mdec,
+      y4mdec->upstream_size);
+
+  stream_id = gst_pad_create_stream_id (y4mdec->srcpad,
+      GST_ELEMENT_CAST (y4mdec), NULL);
+  gst_pad_push_event (y4mdec->srcpad, gst_event_new_stream_start (stream_id));
+  g_free (stream_id);
+
+  if (!gst_y4m_dec_negotiate (y4mdec)) {
+    GST_DEBUG_OBJECT (y4mdec, "Couldn't set caps on src pad");
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  y4mdec->time_segment.duration = gst_y4m_dec_frames_to_timestamp (y4mdec,
+      y4mdec->n_frames);
+  y4mdec->have_header = TRUE;
+
+  return GST_FLOW_OK;
+}
+
+static void
+gst_y4m_dec_loop (GstPad * pad)
+{
+  GstY4mDec *y4mdec = GST_Y4M_DEC (GST_PAD_PARENT (pad));
+  GstSegment *segment = &y4mdec->time_segment;
+  GstBuffer *buffer = NULL;
+  GstClockTime timestamp, duration;
+  GstFlowReturn ret;
+
+  if (!y4mdec->have_header) {
+    ret = gst_y4m_dec_pull_header (y4mdec);
+    if (ret != GST_FLOW_OK)
+      goto pause;
+  }
+
+  if (y4mdec->need_segment) {
+    gint64 n_frames = y4mdec->n_frames;
+    gint64 frame_index;
+
+    /* start at the frame containing the position, which is the stop of the
+     * segment in reverse playback */
+    if (segment->position == -1) {
+      frame_index = segment->rate >= 0 ? 0 : n_frames - 1;
+    } else {
+      frame_index = gst_y4m_dec_timestamp_to_frames (y4mdec,
+          segment->position);
+      if (segment->rate < 0 && frame_index > 0 &&
+          gst_y4m_dec_frames_to_timestamp (y4mdec,
+              frame_index) >= segment->position)
+        frame_index--;
+    }
+    y4mdec->frame_index = CLAMP (frame_index, -1, n_frames);
+
+    GST_DEBUG_OBJECT (y4mdec, "segment %" GST_SEGMENT_FORMAT
+        ", starting at frame %d", segment, y4mdec->frame_index);
+
+    gst_pad_push_event (y4mdec->srcpad, gst_event_new_segment (segment));
+    y4mdec->need_segment = FALSE;
+    y4mdec->discont = TRUE;
+  }
+
+  if (y4mdec->frame_index < 0 || y4mdec->frame_index >= y4mdec->n_frames) {
+    ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  timestamp = gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->frame_index);
+  duration = gst_y4m_dec_frames_to_timestamp (y4mdec,
+      y4mdec->frame_index + 1) - timestamp;
+
+  if (segment->rate >= 0) {
+    if (GST_CLOCK_TIME_IS_VALID (segment->stop) && timestamp >= segment->stop) {
+      ret = GST_FLOW_EOS;
+      goto pause;
+    }
+  } else if (GST_CLOCK_TIME_IS_VALID (segment->start) &&
+      timestamp + duration <= segment->start) {
+    ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  ret = gst_y4m_dec_pull_frame (y4mdec, y4mdec->frame_index, &buffer);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  GST_BUFFER_TIMESTAMP (buffer) = timestamp;
+  GST_BUFFER_DURATION (buffer) = duration;
+  GST_BUFFER_OFFSET (buffer) = y4mdec->frame_index;
+
+  ret = gst_y4m_dec_convert_frame (y4mdec, &buffer);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  /* every frame is a keyframe, but in reverse playback they don't follow
+   * each other */
+  if (y4mdec->discont || segment->rate < 0) {
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+    y4mdec->discont = FALSE;
+  }
+
+  segment->position = timestamp;
+  y4mdec->frame_index += segment->rate >= 0 ? 1 : -1;
+
+  ret = gst_pad_push (y4mdec->srcpad, buffer);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  return;
+
+pause:
+  {
+    const gchar *reason = gst_flow_get_name (ret);
+
+    GST_LOG_OBJECT (y4mdec, "pausing task, reason %s", reason);
+    gst_pad_pause_task (pad);
+
+    if (ret == GST_FLOW_EOS) {
+      if (segment->flags & GST_SEEK_FLAG_SEGMENT) {
+        GstClockTime stop;
+
+        if (segment->rate >= 0) {
+          if ((stop = segment->stop) == -1)
+            stop = segment->duration;
+        } else {
+          stop = segment->start;
+        }
+
+        GST_LOG_OBJECT (y4mdec, "Sending segment done");
+        gst_element_post_message (GST_ELEMENT_CAST (y4mdec),
+            gst_message_new_segment_done (GST_OBJECT_CAST (y4mdec),
+                GST_FORMAT_TIME, stop));
+        gst_pad_push_event (y4mdec->srcpad,
+            gst_event_new_segment_done (GST_FORMAT_TIME, stop));
+      } else {
+        GST_LOG_OBJECT (y4mdec, "Sending EOS, at end of stream");
+        gst_pad_push_event (y4mdec->srcpad, gst_event_new_eos ());
+      }
+    } else if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS) {
+      GST_ELEMENT_ERROR (y4mdec, STREAM, FAILED,
+          ("Internal data stream error."),
+          ("stream stopped, reason %s", reason));
+      gst_pad_push_event (y4mdec->srcpad, gst_event_new_eos ());
+    }
+    return;
+  }
+}
+
+static gboolean
+gst_y4m_dec_sink_activate (GstPad * sinkpad, GstObject * parent)
+{
+  GstQuery *query;
+  gboolean pull_mode = FALSE;
+
+  query = gst_query_new_scheduling ();
+
+  if (gst_pad_peer_query (sinkpad, query))
+    pull_mode = gst_query_has_scheduling_mode_with_flags (query,
+        GST_PAD_MODE_PULL, GST_SCHEDULING_FLAG_SEEKABLE);
+
+  gst_query_unref (query);
+
+  if (pull_mode) {
+    GST_DEBUG ("going to pull mode");
+    return gst_pad_activate_mode (sinkpad, GST_PAD_MODE_PULL, TRUE);
+  } else {
+    GST_DEBUG ("going to push (streaming) mode");
+    return gst_pad_activate_mode (sinkpad, GST_PAD_MODE_PUSH, TRUE);
+  }
+}
+
+static gboolean
+gst_y4m_dec_sink_activatemode (GstPad * sinkpad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  GstY4mDec *y4mdec = GST_Y4M_DEC (parent);
+
+  switch (mode) {
+    case GST_PAD_MODE_PULL:
+      if (active) {
+        y4mdec->pull_mode = TRUE;
+        gst_segment_init (&y4mdec->time_segment, GST_FORMAT_TIME);
+        y4mdec->need_segment = TRUE;
+        return gst_pad_start_task (sinkpad,
+            (GstTaskFunction) gst_y4m_dec_loop, sinkpad, NULL);
+      } else {
+        return gst_pad_stop_task (sinkpad);
+      }
+    case GST_PAD_MODE_PUSH:
+      y4mdec->pull_mode = FALSE;
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+static gboolean
+gst_y4m_dec_handle_seek_pull (GstY4mDec * y4mdec, GstEvent * event)
+{
+  gdouble rate;
+  GstFormat format;
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  gint64 start, stop;
+  gboolean flush;
+
+  gst_event_parse_seek (event, &rate, &format, &flags, &start_type,
+      &start, &stop_type, &stop);
+
+  if (format != GST_FORMAT_TIME) {
+    GST_DEBUG_OBJECT (y4mdec, "can only seek in TIME format");
+    return FALSE;
+  }
+
+  flush = ! !(flags & GST_SEEK_FLAG_FLUSH);
+
+  if (flush)
+    gst_pad_push_event (y4mdec->srcpad, gst_event_new_flush_start ());
+  else
+    gst_pad_pause_task (y4mdec->sinkpad);
+
+  GST_PAD_STREAM_LOCK (y4mdec->sinkpad);
+
+  /* every frame is indexed and a keyframe, so the segment can start at
+   * any frame */
+  gst_segment_do_seek (&y4mdec->time_segment, rate, format, flags,
+      start_type, start, stop_type, stop, NULL);
+
+  if (flush)
+    gst_pad_push_event (y4mdec->srcpad, gst_event_new_flush_stop (TRUE));
+
+  if (flags & GST_SEEK_FLAG_SEGMENT)
+    gst_element_post_message (GST_ELEMENT_CAST (y4mdec),
+        gst_message_new_segment_start (GST_OBJECT_CAST (y4mdec),
+            GST_FORMAT_TIME, y4mdec->time_segment.position));
+
+  y4mdec->need_segment = TRUE;
+  gst_pad_start_task (y4mdec->sinkpad, (GstTaskFunction) gst_y4m_dec_loop,
+      y4mdec->sinkpad, NULL);
+
+  GST_PAD_STREAM_UNLOCK (y4mdec->sinkpad);
+
+  return TRUE;
 }
 
 static gboolean
@@ -800,6 +1250,12 @@ gst_y4m_dec_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
       gint64 framenum;
       guint64 byte;
 
+      if (y4mdec->pull_mode) {
+        res = gst_y4m_dec_handle_seek_pull (y4mdec, event);
+        gst_event_unref (event);
+        break;
+      }
+
       gst_event_parse_seek (event, &rate, &format, &flags, &start_type,
           &start, &stop_type, &stop);
 
@@ -860,6 +1316,14 @@ gst_y4m_dec_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
         break;
       }
 
+      if (y4mdec->pull_mode) {
+        res = y4mdec->have_header;
+        if (res)
+          gst_query_set_duration (query, GST_FORMAT_TIME,
+              gst_y4m_dec_frames_to_timestamp (y4mdec, y4mdec->n_frames));
+        break;
+      }
+
       peer_query = gst_query_new_duration (GST_FORMAT_BYTES);
 
       res = gst_pad_peer_query (y4mdec->sinkpad, peer_query);
@@ -882,6 +1346,21 @@ gst_y4m_dec_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
       gst_query_unref (peer_query);
       break;
     }
+    case GST_QUERY_SEEKING:
+    {
+      GstFormat format;
+
+      gst_query_parse_seeking (query, &format, NULL, NULL, NULL);
+      if (format != GST_FORMAT_TIME || !y4mdec->pull_mode) {
+        res = gst_pad_query_default (pad, parent, query);
+        break;
+      }
+
+      gst_query_set_seeking (query, GST_FORMAT_TIME, TRUE, 0,
+          y4mdec->time_segment.duration);
+      res = TRUE;
+      break;
+    }
     default:
       res = gst_pad_query_default (pad, parent, query);
       break;
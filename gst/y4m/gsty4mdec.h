@@ -54,6 +54,17 @@ struct _GstY4mDec
   GstVideoInfo out_info;
   gboolean video_meta;
   GstBufferPool *pool;
+
+  /* pull mode */
+  gboolean pull_mode;
+  guint64 upstream_size;
+  gint64 n_frames;
+  /* offset of the data of each frame, only filled when FRAME headers have
+   * parameters, otherwise the offsets follow from the frame size */
+  GArray *frame_offsets;
+  GstSegment time_segment;
+  gboolean need_segment;
+  gboolean discont;
 };
 
 struct _GstY4mDecClass
@@ -72,10 +72,18 @@ static GstFlowReturn gst_yadif_transform (GstBaseTransform * trans,
 enum
 {
   PROP_0,
-  PROP_MODE
+  PROP_MODE,
+  PROP_N_THREADS
 };
 
 #define DEFAULT_MODE GST_DEINTERLACE_MODE_AUTO
+#define DEFAULT_N_THREADS 1
+
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define YADIF_FORMATS "{Y42B,I420,Y444,I420_10LE,I422_10LE,Y444_10LE}"
+#else
+#define YADIF_FORMATS "{Y42B,I420,Y444,I420_10BE,I422_10BE,Y444_10BE}"
+#endif
 
 /* pad templates */
 
@@ -83,7 +91,7 @@ static GstStaticPadTemplate gst_yadif_sink_template =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{Y42B,I420,Y444}")
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE (YADIF_FORMATS)
         ",interlace-mode=(string){interleaved,mixed,progressive}")
     );
 
@@ -91,7 +99,7 @@ static GstStaticPadTemplate gst_yadif_src_template =
 GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{Y42B,I420,Y444}")
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE (YADIF_FORMATS)
         ",interlace-mode=(string)progressive")
     );
 
@@ -160,11 +168,20 @@ gst_yadif_class_init (GstYadifClass * klass)
           DEFAULT_MODE,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_N_THREADS,
+      g_param_spec_uint ("n-threads", "Number of threads",
+          "Number of threads to filter each frame with, 0 for the number of "
+          "processors (takes effect on the next start)",
+          0, G_MAXUINT, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
 }
 
 static void
 gst_yadif_init (GstYadif * yadif)
 {
+  yadif->n_threads = DEFAULT_N_THREADS;
+  yadif->runner = gst_band_runner_new ();
 }
 
 void
@@ -177,6 +194,9 @@ gst_yadif_set_property (GObject * object, guint property_id,
     case PROP_MODE:
       yadif->mode = g_value_get_enum (value);
       break;
+    case PROP_N_THREADS:
+      yadif->n_threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -193,6 +213,9 @@ gst_yadif_get_property (GObject * object, guint property_id,
     case PROP_MODE:
       g_value_set_enum (value, yadif->mode);
       break;
+    case PROP_N_THREADS:
+      g_value_set_uint (value, yadif->n_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -212,9 +235,9 @@ gst_yadif_dispose (GObject * object)
 void
 gst_yadif_finalize (GObject * object)
 {
-  /* GstYadif *yadif = GST_YADIF (object); */
+  GstYadif *yadif = GST_YADIF (object);
 
-  /* clean up object here */
+  gst_band_runner_free (yadif->runner);
 
   G_OBJECT_CLASS (gst_yadif_parent_class)->finalize (object);
 }
@@ -258,10 +281,35 @@ gst_yadif_set_caps (GstBaseTransform * trans, GstCaps * incaps,
     GstCaps * outcaps)
 {
   GstYadif *yadif = GST_YADIF (trans);
+  GstVideoInfo info;
+  gint i;
+
+  if (!gst_video_info_from_caps (&info, incaps))
+    goto invalid_caps;
+
+  /* the 16 bit line filter is only exact up to 13 bits per sample, see
+   * filter_line_16bit() */
+  for (i = 0; i < GST_VIDEO_INFO_N_COMPONENTS (&info); i++) {
+    if (GST_VIDEO_INFO_COMP_PSTRIDE (&info, i) == 2 &&
+        GST_VIDEO_INFO_COMP_DEPTH (&info, i) > 13)
+      goto unsupported_depth;
+  }
 
-  gst_video_info_from_caps (&yadif->video_info, incaps);
+  yadif->video_info = info;
 
   return TRUE;
+
+invalid_caps:
+  {
+    GST_ERROR_OBJECT (yadif, "invalid caps %" GST_PTR_FORMAT, incaps);
+    return FALSE;
+  }
+unsupported_depth:
+  {
+    GST_ERROR_OBJECT (yadif, "unsupported depth of %d bits",
+        GST_VIDEO_INFO_COMP_DEPTH (&info, i));
+    return FALSE;
+  }
 }
 
 static gboolean
@@ -277,9 +325,23 @@ gst_yadif_get_unit_size (GstBaseTransform * trans, GstCaps * caps, gsize * size)
   return FALSE;
 }
 
+void yadif_filter (GstYadif * yadif, int parity, int tff);
+
 static gboolean
 gst_yadif_start (GstBaseTransform * trans)
 {
+  GstYadif *yadif = GST_YADIF (trans);
+  GError *err = NULL;
+
+  if (!gst_band_runner_set_threads (yadif->runner, yadif->n_threads, &err)) {
+    GST_ELEMENT_ERROR (yadif, RESOURCE, FAILED, (NULL),
+        ("Failed to create thread pool: %s", err->message));
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (yadif, "filtering with %u threads",
+      gst_band_runner_get_n_threads (yadif->runner));
 
   return TRUE;
 }
@@ -287,12 +349,13 @@ gst_yadif_start (GstBaseTransform * trans)
 static gboolean
 gst_yadif_stop (GstBaseTransform * trans)
 {
+  GstYadif *yadif = GST_YADIF (trans);
+
+  gst_band_runner_set_threads (yadif->runner, 1, NULL);
 
   return TRUE;
 }
 
-void yadif_filter (GstYadif * yadif, int parity, int tff);
-
 static GstFlowReturn
 gst_yadif_transform (GstBaseTransform * trans, GstBuffer * inbuf,
     GstBuffer * outbuf)
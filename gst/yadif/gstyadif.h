@@ -23,6 +23,7 @@
 
 #include <gst/base/gstbasetransform.h>
 #include <gst/video/video.h>
+#include <gst/base/gstbandrunner.h>
 
 G_BEGIN_DECLS
 
@@ -53,6 +54,11 @@ struct _GstYadif
   GstVideoFrame cur_frame;
   GstVideoFrame next_frame;
   GstVideoFrame dest_frame;
+
+  guint n_threads;
+
+  /* line bands processed in parallel, see yadif_filter() */
+  GstBandRunner *runner;
 };
 
 struct _GstYadifClass
@@ -97,7 +97,6 @@ filter_line_c (guint8 * dst,
 
 FILTER}
 
-#if 0
 static void
 filter_line_c_16bit (guint16 * dst,
     guint16 * prev, guint16 * cur, guint16 * next,
@@ -110,17 +109,46 @@ filter_line_c_16bit (guint16 * dst,
   prefs /= 2;
 
 FILTER}
-#endif
 
 void yadif_filter (GstYadif * yadif, int parity, int tff);
 #ifdef HAVE_CPU_X86_64
 void filter_line_x86_64 (guint8 * dst,
     guint8 * prev, guint8 * cur, guint8 * next,
     int w, int prefs, int mrefs, int parity, int mode);
+void filter_line_x86_64_16bit (guint16 * dst,
+    guint16 * prev, guint16 * cur, guint16 * next,
+    int w, int prefs, int mrefs, int parity, int mode);
 #endif
 
-void
-yadif_filter (GstYadif * yadif, int parity, int tff)
+static void
+filter_line_16bit (guint16 * dst,
+    guint16 * prev, guint16 * cur, guint16 * next,
+    int w, int prefs, int mrefs, int parity, int mode)
+{
+#if HAVE_CPU_X86_64
+  /* the SSE2 version handles 8 pixels at a time, do the rest in C. It is only
+   * exact up to 13 bits per sample, gst_yadif_set_caps() rejects formats with
+   * more. */
+  int simd_w = w & ~7;
+
+  filter_line_x86_64_16bit (dst, prev, cur, next, simd_w, prefs, mrefs,
+      parity, mode);
+  dst += simd_w;
+  prev += simd_w;
+  cur += simd_w;
+  next += simd_w;
+  w -= simd_w;
+#endif
+  if (w > 0)
+    filter_line_c_16bit (dst, prev, cur, next, w, prefs, mrefs, parity, mode);
+}
+
+/* Filters the lines of band @band out of @n_bands of every component. Bands
+ * only write their own lines of the destination frame, so they can be
+ * processed concurrently. */
+static void
+yadif_filter_band (GstYadif * yadif, int parity, int tff, int band,
+    int n_bands)
 {
   int y, i;
   const GstVideoInfo *vi = &yadif->video_info;
@@ -135,26 +163,38 @@ yadif_filter (GstYadif * yadif, int parity, int tff)
     guint8 *cur_data = GST_VIDEO_FRAME_COMP_DATA (&yadif->cur_frame, i);
     guint8 *next_data = GST_VIDEO_FRAME_COMP_DATA (&yadif->next_frame, i);
     guint8 *dest_data = GST_VIDEO_FRAME_COMP_DATA (&yadif->dest_frame, i);
+    int y_start = h * band / n_bands;
+    int y_end = h * (band + 1) / n_bands;
 
-    for (y = 0; y < h; y++) {
+    for (y = y_start; y < y_end; y++) {
       if ((y ^ parity) & 1) {
         guint8 *prev = prev_data + y * refs;
         guint8 *cur = cur_data + y * refs;
         guint8 *next = next_data + y * refs;
         guint8 *dst = dest_data + y * refs;
         int mode = ((y == 1) || (y + 2 == h)) ? 2 : yadif->mode;
-#if HAVE_CPU_X86_64
-        if (0) {
-          filter_line_c (dst, prev, cur, next, w,
+
+        if (df == 2) {
+          /* the depth is checked in gst_yadif_set_caps() */
+          filter_line_16bit ((guint16 *) dst, (guint16 *) prev,
+              (guint16 *) cur, (guint16 *) next, w,
               y + 1 < h ? refs : -refs, y ? -refs : refs, parity ^ tff, mode);
         } else {
-          filter_line_x86_64 (dst, prev, cur, next, w,
-              y + 1 < h ? refs : -refs, y ? -refs : refs, parity ^ tff, mode);
-        }
+#if HAVE_CPU_X86_64
+          if (0) {
+            filter_line_c (dst, prev, cur, next, w,
+                y + 1 < h ? refs : -refs, y ? -refs : refs, parity ^ tff,
+                mode);
+          } else {
+            filter_line_x86_64 (dst, prev, cur, next, w,
+                y + 1 < h ? refs : -refs, y ? -refs : refs, parity ^ tff,
+                mode);
+          }
 #else
-        filter_line_c (dst, prev, cur, next, w,
-            y + 1 < h ? refs : -refs, y ? -refs : refs, parity ^ tff, mode);
+          filter_line_c (dst, prev, cur, next, w,
+              y + 1 < h ? refs : -refs, y ? -refs : refs, parity ^ tff, mode);
 #endif
+        }
       } else {
         guint8 *dst = dest_data + y * refs;
         guint8 *cur = cur_data + y * refs;
@@ -168,3 +208,28 @@ yadif_filter (GstYadif * yadif, int parity, int tff)
   emms_c ();
 #endif
 }
+
+typedef struct
+{
+  GstYadif *yadif;
+  int parity;
+  int tff;
+} YadifFilter;
+
+static void
+yadif_band_func (guint band, guint n_bands, gpointer user_data)
+{
+  YadifFilter *filter = user_data;
+
+  yadif_filter_band (filter->yadif, filter->parity, filter->tff, band,
+      n_bands);
+}
+
+void
+yadif_filter (GstYadif * yadif, int parity, int tff)
+{
+  YadifFilter filter = { yadif, parity, tff };
+
+  gst_band_runner_run (yadif->runner,
+      gst_band_runner_get_n_threads (yadif->runner), yadif_band_func, &filter);
+}
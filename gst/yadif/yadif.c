@@ -24,6 +24,8 @@
 
 #if HAVE_CPU_X86_64
 
+#include <emmintrin.h>
+
 typedef struct xmm_reg
 {
   guint64 a, b;
@@ -104,4 +106,121 @@ filter_line_x86_64 (guint8 * dst,
   yadif_filter_line_sse2 (dst, prev, cur, next, w, prefs, mrefs, parity, mode);
 }
 
+/* SSE2 version of filter_line_c_16bit() for up to 13 bits per sample, the
+ * three term spatial scores then still fit into signed 16 bit lanes
+ * (3 * 8191 < 32767, 3 * 16383 is not). @w must be a multiple of 8. */
+
+#define LOAD16(p,o) _mm_loadu_si128 ((const __m128i *) ((p) + (o)))
+#define ABSDIFF16(a,b) _mm_max_epi16 (_mm_sub_epi16 (a, b), _mm_sub_epi16 (b, a))
+#define AVG16(a,b) _mm_srai_epi16 (_mm_add_epi16 (a, b), 1)
+#define SELECT16(mask,a,b) \
+    _mm_or_si128 (_mm_and_si128 (mask, a), _mm_andnot_si128 (mask, b))
+
+/* spatial score and prediction of the edge direction @j, see CHECK() */
+static inline __m128i
+check_16bit (const guint16 * cur, int mrefs, int prefs, int j, __m128i * pred)
+{
+  __m128i score;
+
+  score = _mm_add_epi16 (_mm_add_epi16 (
+          ABSDIFF16 (LOAD16 (cur, mrefs - 1 + j), LOAD16 (cur, prefs - 1 - j)),
+          ABSDIFF16 (LOAD16 (cur, mrefs + j), LOAD16 (cur, prefs - j))),
+      ABSDIFF16 (LOAD16 (cur, mrefs + 1 + j), LOAD16 (cur, prefs + 1 - j)));
+  *pred = AVG16 (LOAD16 (cur, mrefs + j), LOAD16 (cur, prefs - j));
+
+  return score;
+}
+
+void filter_line_x86_64_16bit (guint16 * dst,
+    guint16 * prev, guint16 * cur, guint16 * next,
+    int w, int prefs, int mrefs, int parity, int mode);
+
+void
+filter_line_x86_64_16bit (guint16 * dst,
+    guint16 * prev, guint16 * cur, guint16 * next,
+    int w, int prefs, int mrefs, int parity, int mode)
+{
+  const __m128i one = _mm_set1_epi16 (1);
+  guint16 *prev2 = parity ? prev : cur;
+  guint16 *next2 = parity ? cur : next;
+  int x;
+
+  mrefs /= 2;
+  prefs /= 2;
+
+  for (x = 0; x < w; x += 8) {
+    __m128i c = LOAD16 (cur, mrefs);
+    __m128i e = LOAD16 (cur, prefs);
+    __m128i p2 = LOAD16 (prev2, 0);
+    __m128i n2 = LOAD16 (next2, 0);
+    __m128i d = AVG16 (p2, n2);
+    __m128i temporal_diff0 = ABSDIFF16 (p2, n2);
+    __m128i temporal_diff1 =
+        AVG16 (ABSDIFF16 (LOAD16 (prev, mrefs), c),
+        ABSDIFF16 (LOAD16 (prev, prefs), e));
+    __m128i temporal_diff2 =
+        AVG16 (ABSDIFF16 (LOAD16 (next, mrefs), c),
+        ABSDIFF16 (LOAD16 (next, prefs), e));
+    __m128i diff =
+        _mm_max_epi16 (_mm_max_epi16 (_mm_srai_epi16 (temporal_diff0, 1),
+            temporal_diff1), temporal_diff2);
+    __m128i spatial_pred = AVG16 (c, e);
+    __m128i spatial_score, score, pred, mask, chain;
+
+    spatial_score = _mm_sub_epi16 (_mm_add_epi16 (_mm_add_epi16 (
+                ABSDIFF16 (LOAD16 (cur, mrefs - 1), LOAD16 (cur, prefs - 1)),
+                ABSDIFF16 (c, e)),
+            ABSDIFF16 (LOAD16 (cur, mrefs + 1), LOAD16 (cur, prefs + 1))),
+        one);
+
+    /* direction -2 is only tried where -1 was better, same for 2 and 1 */
+    score = check_16bit (cur, mrefs, prefs, -1, &pred);
+    chain = _mm_cmplt_epi16 (score, spatial_score);
+    spatial_score = SELECT16 (chain, score, spatial_score);
+    spatial_pred = SELECT16 (chain, pred, spatial_pred);
+
+    score = check_16bit (cur, mrefs, prefs, -2, &pred);
+    mask = _mm_and_si128 (chain, _mm_cmplt_epi16 (score, spatial_score));
+    spatial_score = SELECT16 (mask, score, spatial_score);
+    spatial_pred = SELECT16 (mask, pred, spatial_pred);
+
+    score = check_16bit (cur, mrefs, prefs, 1, &pred);
+    chain = _mm_cmplt_epi16 (score, spatial_score);
+    spatial_score = SELECT16 (chain, score, spatial_score);
+    spatial_pred = SELECT16 (chain, pred, spatial_pred);
+
+    score = check_16bit (cur, mrefs, prefs, 2, &pred);
+    mask = _mm_and_si128 (chain, _mm_cmplt_epi16 (score, spatial_score));
+    spatial_pred = SELECT16 (mask, pred, spatial_pred);
+
+    if (mode < 2) {
+      __m128i b = AVG16 (LOAD16 (prev2, 2 * mrefs), LOAD16 (next2, 2 * mrefs));
+      __m128i f = AVG16 (LOAD16 (prev2, 2 * prefs), LOAD16 (next2, 2 * prefs));
+      __m128i de = _mm_sub_epi16 (d, e);
+      __m128i dc = _mm_sub_epi16 (d, c);
+      __m128i bc = _mm_sub_epi16 (b, c);
+      __m128i fe = _mm_sub_epi16 (f, e);
+      __m128i max = _mm_max_epi16 (_mm_max_epi16 (de, dc),
+          _mm_min_epi16 (bc, fe));
+      __m128i min = _mm_min_epi16 (_mm_min_epi16 (de, dc),
+          _mm_max_epi16 (bc, fe));
+
+      diff = _mm_max_epi16 (_mm_max_epi16 (diff, min),
+          _mm_sub_epi16 (_mm_setzero_si128 (), max));
+    }
+
+    spatial_pred = _mm_min_epi16 (spatial_pred, _mm_add_epi16 (d, diff));
+    spatial_pred = _mm_max_epi16 (spatial_pred, _mm_sub_epi16 (d, diff));
+
+    _mm_storeu_si128 ((__m128i *) dst, spatial_pred);
+
+    dst += 8;
+    cur += 8;
+    prev += 8;
+    next += 8;
+    prev2 += 8;
+    next2 += 8;
+  }
+}
+
 #endif
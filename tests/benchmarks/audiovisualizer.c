@@ -0,0 +1,135 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the spectrascope frame rate per shader and thread count. Each
+ * audio buffer holds the samples of one video frame, the frames are counted
+ * at the sink.
+ *
+ * Usage: audiovisualizer [n-buffers [width height]]
+ */
+
+#include <stdlib.h>
+#include <gst/gst.h>
+
+static const gchar *shaders[] = {
+  "none", "fade", "fade-and-move-up", "fade-and-move-down",
+  "fade-and-move-left", "fade-and-move-right", "fade-and-move-horiz-out",
+  "fade-and-move-horiz-in", "fade-and-move-vert-out", "fade-and-move-vert-in"
+};
+
+static void
+on_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  guint *n_frames = user_data;
+
+  (*n_frames)++;
+}
+
+static gdouble
+run_pipeline (const gchar * shader, guint threads, gint width, gint height,
+    guint n_buffers)
+{
+  GstElement *pipeline, *sink;
+  GstMessage *msg;
+  GstBus *bus;
+  GError *err = NULL;
+  gchar *desc;
+  gint64 start;
+  gdouble elapsed;
+  guint n_frames = 0;
+
+  desc = g_strdup_printf ("audiotestsrc wave=white-noise num-buffers=%u "
+      "samplesperbuffer=735 ! audio/x-raw,rate=44100,channels=2 ! "
+      "spectrascope shader=%s n-threads=%u ! "
+      "video/x-raw,width=%d,height=%d,framerate=60/1 ! "
+      "fakesink name=sink signal-handoffs=true", n_buffers, shader, threads,
+      width, height);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (pipeline == NULL) {
+    g_printerr ("failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return -1;
+  }
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (on_handoff), &n_frames);
+  gst_object_unref (sink);
+
+  bus = gst_element_get_bus (pipeline);
+  start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("%s: %s\n", shader, err->message);
+    g_clear_error (&err);
+    elapsed = -1;
+  }
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  if (elapsed <= 0)
+    return -1;
+
+  return n_frames / elapsed;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  guint n_buffers = 300;
+  gint width = 1920, height = 1080;
+  guint i, n_cpus;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_buffers = atoi (argv[1]);
+  if (argc > 3) {
+    width = atoi (argv[2]);
+    height = atoi (argv[3]);
+  }
+
+  n_cpus = g_get_num_processors ();
+
+  g_print ("%-24s %8s %10s\n", "shader", "threads", "fps");
+
+  for (i = 0; i < G_N_ELEMENTS (shaders); i++) {
+    guint threads;
+
+    for (threads = 1; threads <= n_cpus; threads *= 2) {
+      gdouble fps;
+
+      fps = run_pipeline (shaders[i], threads, width, height, n_buffers);
+      if (fps < 0)
+        break;
+
+      g_print ("%-24s %8u %10.1f\n", shaders[i], threads, fps);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,168 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the bayer2rgb throughput on 12 megapixel frames for each
+ * demosaicing method, on one thread and on all processors, for 8 and 12
+ * bit input. A prepared frame is pushed from an appsrc wrapped in new
+ * buffers.
+ *
+ * Usage: bayer2rgb [n-frames]
+ */
+
+#include <stdlib.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+#define WIDTH 4000
+#define HEIGHT 3000
+
+static guint8 *
+make_frame (gint bpp, gsize * size)
+{
+  GRand *rand = g_rand_new_with_seed (0);
+  gint bytes = bpp > 8 ? 2 : 1;
+  guint8 *data;
+  gsize i;
+
+  *size = (gsize) GST_ROUND_UP_4 (WIDTH * bytes) * HEIGHT;
+  data = g_malloc (*size);
+
+  if (bytes == 1) {
+    for (i = 0; i < *size; i++)
+      data[i] = g_rand_int_range (rand, 0, 256);
+  } else {
+    for (i = 0; i + 1 < *size; i += 2)
+      GST_WRITE_UINT16_LE (data + i, g_rand_int_range (rand, 0, 1 << bpp));
+  }
+
+  g_rand_free (rand);
+
+  return data;
+}
+
+static gdouble
+run (const gchar * format, const gchar * out_format, const gchar * method,
+    guint n_threads, guint8 * frame, gsize size, guint n_frames)
+{
+  GstElement *pipeline, *src;
+  GstMessage *msg;
+  GstBus *bus;
+  GError *err = NULL;
+  gchar *desc;
+  gint64 start;
+  gdouble elapsed;
+  guint i;
+
+  desc = g_strdup_printf ("appsrc name=src format=time block=true "
+      "max-bytes=%" G_GSIZE_FORMAT " caps=video/x-bayer,format=%s,width=%d,"
+      "height=%d,framerate=60/1 ! bayer2rgb method=%s n-threads=%u ! "
+      "video/x-raw,format=%s ! fakesink sync=false", 4 * size, format, WIDTH,
+      HEIGHT, method, n_threads, out_format);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (pipeline == NULL) {
+    g_printerr ("failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return -1;
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  bus = gst_element_get_bus (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_frames; i++) {
+    GstBuffer *buf = gst_buffer_new_wrapped_full (0, frame, size, 0, size,
+        NULL, NULL);
+
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (i, GST_SECOND, 60);
+    gst_app_src_push_buffer (GST_APP_SRC (src), buf);
+  }
+  gst_app_src_end_of_stream (GST_APP_SRC (src));
+
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("%s %s: %s\n", format, method, err->message);
+    g_clear_error (&err);
+    elapsed = -1;
+  }
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_object_unref (src);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  static const struct
+  {
+    const gchar *format;
+    gint bpp;
+    const gchar *out_format;
+  } inputs[] = {
+    {"bggr", 8, "BGRx"},
+    {"bggr12le", 12, "BGRx"},
+    {"bggr12le", 12, "ARGB64"}
+  };
+  static const gchar *methods[] = { "bilinear", "edge", "malvar" };
+  guint n_threads[] = { 1, 1 };
+  guint n_frames = 30;
+  guint i, j, k;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_frames = atoi (argv[1]);
+
+  /* single threaded and one thread per processor */
+  n_threads[1] = g_get_num_processors ();
+
+  g_print ("%-10s %-8s %-10s %8s %12s %8s\n", "format", "output", "method",
+      "threads", "Mpixel/s", "fps");
+
+  for (i = 0; i < G_N_ELEMENTS (inputs); i++) {
+    gsize size;
+    guint8 *frame = make_frame (inputs[i].bpp, &size);
+
+    for (j = 0; j < G_N_ELEMENTS (methods); j++) {
+      for (k = 0; k < G_N_ELEMENTS (n_threads); k++) {
+        gdouble t = run (inputs[i].format, inputs[i].out_format, methods[j],
+            n_threads[k], frame, size, n_frames);
+
+        if (t <= 0)
+          continue;
+        g_print ("%-10s %-8s %-10s %8u %12.1f %8.1f\n", inputs[i].format,
+            inputs[i].out_format, methods[j], n_threads[k],
+            (gdouble) WIDTH * HEIGHT * n_frames / t / 1e6, n_frames / t);
+      }
+    }
+
+    g_free (frame);
+  }
+
+  return 0;
+}
@@ -0,0 +1,142 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the time until a burst of DTLS connections has completed the
+ * handshake, for each key type of the generated certificate. All
+ * connections of a burst are started at once in one pipeline, each one
+ * between a client and a server dtlsenc/dtlsdec pair. Every burst is run
+ * twice with the same connection ids, the second run resumes the sessions
+ * of the first one.
+ *
+ * Usage: dtls [n-connections]
+ */
+
+#include <stdlib.h>
+#include <gst/gst.h>
+
+static GMutex lock;
+static GCond cond;
+static guint n_keys;
+
+static void
+on_key_received (GstElement * dec, gpointer user_data)
+{
+  g_mutex_lock (&lock);
+  n_keys++;
+  g_cond_signal (&cond);
+  g_mutex_unlock (&lock);
+}
+
+static gdouble
+run (const gchar * key_type, guint n_connections)
+{
+  GstElement *pipeline;
+  GString *desc;
+  GError *err = NULL;
+  gint64 start, deadline;
+  gdouble elapsed = -1;
+  guint i;
+
+  /* element creation is included, the certificate is generated when the
+   * decoders go to READY */
+  start = g_get_monotonic_time ();
+  desc = g_string_new (NULL);
+  for (i = 0; i < n_connections; i++) {
+    g_string_append_printf (desc,
+        "dtlsenc connection-id=%s-c%u is-client=true ! "
+        "dtlsdec name=s%u connection-id=%s-s%u key-type=%s "
+        "dtlsenc connection-id=%s-s%u is-client=false ! "
+        "dtlsdec name=c%u connection-id=%s-c%u key-type=%s ", key_type, i, i,
+        key_type, i, key_type, key_type, i, i, key_type, i, key_type);
+  }
+  pipeline = gst_parse_launch (desc->str, &err);
+  g_string_free (desc, TRUE);
+  if (pipeline == NULL) {
+    g_printerr ("failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return -1;
+  }
+
+  for (i = 0; i < n_connections; i++) {
+    gchar name[16];
+    GstElement *dec;
+
+    g_snprintf (name, sizeof (name), "c%u", i);
+    dec = gst_bin_get_by_name (GST_BIN (pipeline), name);
+    g_signal_connect (dec, "on-key-received", G_CALLBACK (on_key_received),
+        NULL);
+    gst_object_unref (dec);
+
+    g_snprintf (name, sizeof (name), "s%u", i);
+    dec = gst_bin_get_by_name (GST_BIN (pipeline), name);
+    g_signal_connect (dec, "on-key-received", G_CALLBACK (on_key_received),
+        NULL);
+    gst_object_unref (dec);
+  }
+
+  n_keys = 0;
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  deadline = start + 60 * G_USEC_PER_SEC;
+  g_mutex_lock (&lock);
+  while (n_keys < 2 * n_connections) {
+    if (!g_cond_wait_until (&cond, &lock, deadline))
+      break;
+  }
+  if (n_keys == 2 * n_connections)
+    elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+  else
+    g_printerr ("%s: only %u of %u keys received\n", key_type, n_keys,
+        2 * n_connections);
+  g_mutex_unlock (&lock);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  static const gchar *key_types[] = { "rsa", "ecdsa" };
+  static const gchar *runs[] = { "full", "resumed" };
+  guint n_connections = 100;
+  guint i, j;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_connections = atoi (argv[1]);
+
+  g_print ("%-8s %-8s %12s %12s %14s\n", "key", "run", "connections",
+      "total ms", "handshakes/s");
+
+  for (i = 0; i < G_N_ELEMENTS (key_types); i++) {
+    for (j = 0; j < G_N_ELEMENTS (runs); j++) {
+      gdouble t = run (key_types[i], n_connections);
+
+      if (t <= 0)
+        continue;
+      g_print ("%-8s %-8s %12u %12.1f %14.1f\n", key_types[i], runs[j],
+          n_connections, t * 1000, n_connections / t);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,172 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the data throughput of a dtlsenc ! dtlsdec loopback for several
+ * packet sizes. Once the handshake is completed, the packets are pushed
+ * from an appsrc into the client dtlsenc and counted after the server
+ * dtlsdec.
+ *
+ * Usage: dtlsloopback [n-packets]
+ */
+
+#include <stdlib.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+static GMutex lock;
+static GCond cond;
+static guint64 n_keys;
+static guint64 n_bytes;
+
+static void
+on_key_received (GstElement * dec, gpointer user_data)
+{
+  g_mutex_lock (&lock);
+  n_keys++;
+  g_cond_signal (&cond);
+  g_mutex_unlock (&lock);
+}
+
+static void
+on_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  g_mutex_lock (&lock);
+  n_bytes += gst_buffer_get_size (buffer);
+  g_cond_signal (&cond);
+  g_mutex_unlock (&lock);
+}
+
+static gboolean
+wait_for (guint64 * value, guint64 target, gint64 deadline)
+{
+  gboolean ret = TRUE;
+
+  g_mutex_lock (&lock);
+  while (*value < target) {
+    if (!g_cond_wait_until (&cond, &lock, deadline)) {
+      ret = FALSE;
+      break;
+    }
+  }
+  g_mutex_unlock (&lock);
+
+  return ret;
+}
+
+static gdouble
+run (guint8 * packet, gsize size, guint n_packets)
+{
+  GstElement *pipeline, *src, *sink, *dec;
+  GError *err = NULL;
+  gint64 start;
+  gdouble elapsed = -1;
+  gboolean done;
+  guint i;
+
+  pipeline = gst_parse_launch ("appsrc name=src block=true "
+      "max-bytes=1048576 ! dtlsenc connection-id=c is-client=true ! "
+      "dtlsdec name=s connection-id=s ! fakesink name=sink sync=false "
+      "signal-handoffs=true "
+      "dtlsenc connection-id=s is-client=false ! dtlsdec name=c "
+      "connection-id=c", &err);
+  if (pipeline == NULL) {
+    g_printerr ("failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return -1;
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (on_handoff), NULL);
+  dec = gst_bin_get_by_name (GST_BIN (pipeline), "c");
+  g_signal_connect (dec, "on-key-received", G_CALLBACK (on_key_received),
+      NULL);
+  gst_object_unref (dec);
+  dec = gst_bin_get_by_name (GST_BIN (pipeline), "s");
+  g_signal_connect (dec, "on-key-received", G_CALLBACK (on_key_received),
+      NULL);
+  gst_object_unref (dec);
+
+  n_keys = 0;
+  n_bytes = 0;
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  /* data sent before the handshake is completed is dropped */
+  if (!wait_for (&n_keys, 2,
+          g_get_monotonic_time () + 30 * G_USEC_PER_SEC)) {
+    g_printerr ("handshake not completed\n");
+    goto done;
+  }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_packets; i++) {
+    GstBuffer *buf = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+        packet, size, 0, size, NULL, NULL);
+
+    gst_app_src_push_buffer (GST_APP_SRC (src), buf);
+  }
+
+  done = wait_for (&n_bytes, (guint64) size * n_packets,
+      g_get_monotonic_time () + 60 * G_USEC_PER_SEC);
+  if (done)
+    elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+  else
+    g_printerr ("%" G_GSIZE_FORMAT " B: only %" G_GUINT64_FORMAT " of %"
+        G_GUINT64_FORMAT " bytes received\n", size, n_bytes,
+        (guint64) size * n_packets);
+
+done:
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (src);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  static const gsize sizes[] = { 100, 1200, 8000 };
+  guint n_packets = 100000;
+  guint8 *packet;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_packets = atoi (argv[1]);
+
+  packet = g_malloc0 (sizes[G_N_ELEMENTS (sizes) - 1]);
+
+  g_print ("%-8s %10s %12s %10s\n", "size", "packets", "packets/s", "Mbit/s");
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+    gdouble t = run (packet, sizes[i], n_packets);
+
+    if (t <= 0)
+      continue;
+    g_print ("%-8" G_GSIZE_FORMAT " %10u %12.0f %10.1f\n", sizes[i],
+        n_packets, n_packets / t, sizes[i] * 8.0 * n_packets / t / 1e6);
+  }
+
+  g_free (packet);
+
+  return 0;
+}
@@ -0,0 +1,129 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the remapping throughput of the geometric transform elements per
+ * interpolation method and thread count. The time spent generating the input
+ * frames is measured separately and subtracted.
+ *
+ * Usage: geometrictransform [n-buffers [width height]]
+ */
+
+#include <stdlib.h>
+#include <gst/gst.h>
+
+static const gchar *elements[] = {
+  "bulge", "circle", "diffuse", "fisheye", "kaleidoscope", "marble", "mirror",
+  "perspective", "pinch", "rotate", "sphere", "square", "stretch", "tunnel",
+  "twirl", "waterripple"
+};
+
+static const gchar *interpolations[] = { "nearest", "bilinear" };
+
+static gdouble
+run_pipeline (gint width, gint height, const gchar * filter, guint n_buffers)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  GstBus *bus;
+  GError *err = NULL;
+  gchar *desc;
+  gint64 start;
+  gdouble elapsed;
+
+  desc = g_strdup_printf ("videotestsrc pattern=ball num-buffers=%u ! "
+      "video/x-raw,format=BGRx,width=%d,height=%d ! %s ! fakesink",
+      n_buffers, width, height, filter);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (pipeline == NULL) {
+    g_printerr ("failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return -1;
+  }
+
+  bus = gst_element_get_bus (pipeline);
+  start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("%s: %s\n", filter, err->message);
+    g_clear_error (&err);
+    elapsed = -1;
+  }
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  guint n_buffers = 200;
+  gint width = 1920, height = 1080;
+  guint i, j, n_cpus;
+  gdouble base;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_buffers = atoi (argv[1]);
+  if (argc > 3) {
+    width = atoi (argv[2]);
+    height = atoi (argv[3]);
+  }
+
+  n_cpus = g_get_num_processors ();
+
+  base = run_pipeline (width, height, "identity", n_buffers);
+  if (base < 0)
+    return 1;
+
+  g_print ("%-14s %-10s %8s %10s\n", "element", "interp", "threads", "fps");
+
+  for (i = 0; i < G_N_ELEMENTS (elements); i++) {
+    for (j = 0; j < G_N_ELEMENTS (interpolations); j++) {
+      guint threads;
+
+      for (threads = 1; threads <= n_cpus; threads *= 2) {
+        gchar *filter;
+        gdouble t;
+
+        filter = g_strdup_printf ("%s interpolation=%s n-threads=%u",
+            elements[i], interpolations[j], threads);
+        t = run_pipeline (width, height, filter, n_buffers);
+        g_free (filter);
+
+        if (t < 0)
+          break;
+
+        g_print ("%-14s %-10s %8u %10.1f\n", elements[i], interpolations[j],
+            threads, n_buffers / MAX (t - base, 1e-6));
+      }
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,197 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Compares the throughput of the jp2kdecimator codestream tree, which is
+ * parsed, decimated and written again, with the single pass decimation that
+ * references the kept packets of the input. The frames are synthesized
+ * 2048x1080 codestreams of the size of a 250 Mbit/s DCP frame, with SOP
+ * markers and/or PLT markers to delimit the packets. The outputs of both
+ * are compared byte by byte.
+ *
+ * Usage: jp2kdecimator [n-frames]
+ */
+
+#include "../../gst/jp2kdecimator/jp2kcodestream.c"
+#include "../check/elements/jp2kdecimator.h"
+
+#include <stdlib.h>
+
+GST_DEBUG_CATEGORY (gst_jp2k_decimator_debug);
+
+/* of a 250 Mbit/s DCP at 24 fps */
+#define FRAME_SIZE (250000000 / 8 / 24)
+
+typedef struct
+{
+  const gchar *name;
+  gint max_layers;
+  gint max_decomposition_levels;
+} Decimation;
+
+static GstBuffer *
+decimate_stream (GstJP2kDecimator * self, GstBuffer * inbuf,
+    const GstMapInfo * info)
+{
+  GstBuffer *outbuf = NULL;
+
+  if (decimate_codestream (self, inbuf, info, &outbuf) != GST_FLOW_OK)
+    return NULL;
+
+  return outbuf;
+}
+
+/* Returns the MB/s of the tree (0) or the single pass (1) decimation */
+static gdouble
+run (GstJP2kDecimator * self, GstBuffer * inbuf, gboolean stream,
+    guint n_frames)
+{
+  GstMapInfo info;
+  gint64 start;
+  gdouble elapsed;
+  guint i;
+
+  gst_buffer_map (inbuf, &info, GST_MAP_READ);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_frames; i++) {
+    GstBuffer *outbuf;
+
+    if (stream)
+      outbuf = decimate_stream (self, inbuf, &info);
+    else
+      outbuf = decimate_tree (self, inbuf);
+    if (outbuf == NULL) {
+      g_printerr ("decimation failed\n");
+      break;
+    }
+    gst_buffer_unref (outbuf);
+  }
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  gst_buffer_unmap (inbuf, &info);
+
+  if (i < n_frames || elapsed <= 0)
+    return -1;
+
+  return info.size * (gdouble) n_frames / elapsed / 1e6;
+}
+
+/* Returns the output size if both decimations produce the same output */
+static gsize
+compare (GstJP2kDecimator * self, GstBuffer * inbuf, guint * n_memory)
+{
+  GstBuffer *tree, *stream;
+  GstMapInfo info;
+  gsize size = 0;
+
+  tree = decimate_tree (self, inbuf);
+  gst_buffer_map (inbuf, &info, GST_MAP_READ);
+  stream = decimate_stream (self, inbuf, &info);
+  gst_buffer_unmap (inbuf, &info);
+
+  if (tree && stream) {
+    size = gst_buffer_get_size (tree);
+    *n_memory = gst_buffer_n_memory (stream);
+
+    gst_buffer_map (tree, &info, GST_MAP_READ);
+    if (gst_buffer_get_size (stream) != size ||
+        gst_buffer_memcmp (stream, 0, info.data, size) != 0)
+      size = 0;
+    gst_buffer_unmap (tree, &info);
+  }
+
+  if (tree)
+    gst_buffer_unref (tree);
+  if (stream)
+    gst_buffer_unref (stream);
+
+  return size;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  static const FrameLayout layouts[] = {
+    {"LRCP/SOP", PROGRESSION_ORDER_LRCP, TRUE, FALSE},
+    {"LRCP/PLT", PROGRESSION_ORDER_LRCP, FALSE, TRUE},
+    {"RLCP/PLT", PROGRESSION_ORDER_RLCP, FALSE, TRUE},
+    {"CPRL/SOP+PLT", PROGRESSION_ORDER_CPRL, TRUE, TRUE},
+  };
+  static const Decimation decimations[] = {
+    {"layers=2", 2, -1},
+    {"levels=3", 0, 3},
+    {"both", 2, 3},
+  };
+  GstJP2kDecimator *self;
+  guint n_frames = 200;
+  guint i, j;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_frames = atoi (argv[1]);
+
+  GST_DEBUG_CATEGORY_INIT (gst_jp2k_decimator_debug, "jp2kdecimator", 0,
+      "JPEG2000 decimator");
+
+  /* the element only provides the properties to the codestream functions */
+  self = (GstJP2kDecimator *) gst_element_factory_make ("jp2kdecimator", NULL);
+  if (self == NULL) {
+    g_printerr ("jp2kdecimator element not found\n");
+    return 1;
+  }
+
+  g_print ("%-14s %-10s %10s %8s %12s %12s %8s\n", "layout", "decimate",
+      "out bytes", "memories", "tree MB/s", "single MB/s", "speedup");
+
+  for (i = 0; i < G_N_ELEMENTS (layouts); i++) {
+    GstBuffer *inbuf = create_frame (&layouts[i], FRAME_SIZE);
+
+    for (j = 0; j < G_N_ELEMENTS (decimations); j++) {
+      gdouble tree, stream;
+      guint n_memory = 0;
+      gsize size;
+
+      g_object_set (self, "max-layers", decimations[j].max_layers,
+          "max-decomposition-levels", decimations[j].max_decomposition_levels,
+          NULL);
+
+      size = compare (self, inbuf, &n_memory);
+      if (size == 0) {
+        g_printerr ("%s %s: outputs differ\n", layouts[i].name,
+            decimations[j].name);
+        continue;
+      }
+
+      tree = run (self, inbuf, FALSE, n_frames);
+      stream = run (self, inbuf, TRUE, n_frames);
+      if (tree <= 0 || stream <= 0)
+        continue;
+
+      g_print ("%-14s %-10s %10" G_GSIZE_FORMAT " %8u %12.1f %12.1f %7.1fx\n",
+          layouts[i].name, decimations[j].name, size, n_memory, tree, stream,
+          stream / tree);
+    }
+
+    gst_buffer_unref (inbuf);
+  }
+
+  gst_object_unref (self);
+
+  return 0;
+}
@@ -0,0 +1,199 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures how long mxfdemux takes to open a file, that is until all
+ * source pads are exposed, with and without lazy-metadata. Without a file
+ * a small one is created with mxfmux.
+ *
+ * Usage: mxfdemux [file.mxf [iterations]]
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+static gboolean
+create_file (const gchar * location)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  GstBus *bus;
+  GError *err = NULL;
+  gchar *desc;
+  gboolean ret;
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=250 ! "
+      "video/x-raw,format=v308,width=16,height=16 ! mxfmux ! "
+      "filesink location=%s", location);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (pipeline == NULL) {
+    g_printerr ("failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  bus = gst_element_get_bus (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  ret = (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return ret;
+}
+
+static void
+pad_added_cb (GstElement * demux, GstPad * pad, GstElement * pipeline)
+{
+  GstElement *sink;
+  GstPad *sinkpad;
+
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "async", FALSE, NULL);
+  gst_bin_add (GST_BIN (pipeline), sink);
+  gst_element_sync_state_with_parent (sink);
+
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+}
+
+static void
+no_more_pads_cb (GstElement * demux, GstElement * pipeline)
+{
+  gst_element_post_message (pipeline,
+      gst_message_new_application (GST_OBJECT (pipeline),
+          gst_structure_new_empty ("opened")));
+}
+
+static gdouble
+open_file (const gchar * location, gboolean lazy)
+{
+  GstElement *pipeline, *src, *demux;
+  GstMessage *msg;
+  GstBus *bus;
+  GError *err = NULL;
+  gint64 start;
+  gdouble elapsed;
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  demux = gst_element_factory_make ("mxfdemux", NULL);
+  if (src == NULL || demux == NULL) {
+    g_printerr ("filesrc or mxfdemux not available\n");
+    gst_object_unref (pipeline);
+    return -1;
+  }
+
+  g_object_set (src, "location", location, NULL);
+  g_object_set (demux, "lazy-metadata", lazy, NULL);
+  gst_bin_add_many (GST_BIN (pipeline), src, demux, NULL);
+  gst_element_link (src, demux);
+
+  g_signal_connect (demux, "pad-added", G_CALLBACK (pad_added_cb), pipeline);
+  g_signal_connect (demux, "no-more-pads", G_CALLBACK (no_more_pads_cb),
+      pipeline);
+
+  bus = gst_element_get_bus (pipeline);
+  start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PAUSED);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_APPLICATION | GST_MESSAGE_ERROR);
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("%s: %s\n", location, err->message);
+    g_clear_error (&err);
+    elapsed = -1;
+  }
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  gchar *location = NULL, *tmp = NULL;
+  guint iterations = 20;
+  guint i, lazy;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1) {
+    location = g_strdup (argv[1]);
+  } else {
+    gint fd = g_file_open_tmp ("mxfdemux-benchmark-XXXXXX.mxf", &tmp, NULL);
+
+    if (fd < 0) {
+      g_printerr ("failed to create temporary file\n");
+      return 1;
+    }
+    close (fd);
+
+    if (!create_file (tmp)) {
+      g_printerr ("failed to create test file\n");
+      g_unlink (tmp);
+      g_free (tmp);
+      return 1;
+    }
+    location = g_strdup (tmp);
+  }
+  if (argc > 2)
+    iterations = atoi (argv[2]);
+
+  g_print ("%-14s %12s\n", "lazy-metadata", "open ms");
+
+  for (lazy = 0; lazy <= 1; lazy++) {
+    gdouble total = 0, t;
+
+    /* warm up the page cache */
+    if (open_file (location, lazy) < 0)
+      break;
+
+    for (i = 0; i < iterations; i++) {
+      t = open_file (location, lazy);
+      if (t < 0)
+        break;
+      total += t;
+    }
+
+    if (i > 0)
+      g_print ("%-14s %12.3f\n", lazy ? "true" : "false",
+          1000.0 * total / i);
+  }
+
+  if (tmp) {
+    g_unlink (tmp);
+    g_free (tmp);
+  }
+  g_free (location);
+
+  return 0;
+}
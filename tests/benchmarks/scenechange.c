@@ -0,0 +1,151 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the time scenechange and videodiff spend per 1080p frame, and
+ * for scenechange at each analysis-resolution. Two prepared frames are
+ * pushed alternately from an appsrc, wrapped in new buffers so in-place
+ * filters do not have to copy them, and the time of the same pipeline with
+ * identity instead is subtracted.
+ *
+ * Usage: scenechange [n-frames]
+ */
+
+#include <stdlib.h>
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+
+#define WIDTH 1920
+#define HEIGHT 1080
+
+#define FRAME_SIZE (WIDTH * HEIGHT * 3 / 2)
+
+static guint8 *
+make_frame (guint seed)
+{
+  GRand *rand = g_rand_new_with_seed (seed);
+  guint8 *data = g_malloc (FRAME_SIZE);
+  gsize i;
+
+  for (i = 0; i < FRAME_SIZE; i++)
+    data[i] = g_rand_int_range (rand, 16, 236);
+
+  g_rand_free (rand);
+
+  return data;
+}
+
+static gdouble
+run (const gchar * filter, guint8 * frames[2], guint n_frames)
+{
+  GstElement *pipeline, *src;
+  GstMessage *msg;
+  GstBus *bus;
+  GError *err = NULL;
+  gchar *desc;
+  gint64 start;
+  gdouble elapsed;
+  guint i;
+
+  desc = g_strdup_printf ("appsrc name=src format=time block=true "
+      "max-bytes=%d caps=video/x-raw,format=I420,width=%d,height=%d,"
+      "framerate=30/1 ! %s ! fakesink sync=false", 4 * FRAME_SIZE, WIDTH,
+      HEIGHT, filter);
+  pipeline = gst_parse_launch (desc, &err);
+  g_free (desc);
+  if (pipeline == NULL) {
+    g_printerr ("failed to create pipeline: %s\n", err->message);
+    g_clear_error (&err);
+    return -1;
+  }
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  bus = gst_element_get_bus (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_frames; i++) {
+    GstBuffer *buf = gst_buffer_new_wrapped_full (0, frames[i % 2],
+        FRAME_SIZE, 0, FRAME_SIZE, NULL, NULL);
+
+    GST_BUFFER_PTS (buf) = gst_util_uint64_scale (i, GST_SECOND, 30);
+    gst_app_src_push_buffer (GST_APP_SRC (src), buf);
+  }
+  gst_app_src_end_of_stream (GST_APP_SRC (src));
+
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gst_message_parse_error (msg, &err, NULL);
+    g_printerr ("%s: %s\n", filter, err->message);
+    g_clear_error (&err);
+    elapsed = -1;
+  }
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+  gst_object_unref (src);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  static const gchar *filters[] = {
+    "scenechange analysis-resolution=full",
+    "scenechange analysis-resolution=half",
+    "scenechange analysis-resolution=quarter",
+    "videodiff"
+  };
+  guint8 *frames[2];
+  guint n_frames = 500;
+  gdouble base;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    n_frames = atoi (argv[1]);
+
+  frames[0] = make_frame (0);
+  frames[1] = make_frame (1);
+
+  base = run ("identity", frames, n_frames);
+  if (base < 0)
+    return 1;
+
+  g_print ("%-40s %12s\n", "filter", "us/frame");
+
+  for (i = 0; i < G_N_ELEMENTS (filters); i++) {
+    gdouble t = run (filters[i], frames, n_frames);
+
+    if (t < 0)
+      continue;
+    g_print ("%-40s %12.1f\n", filters[i],
+        1e6 * MAX (t - base, 0) / n_frames);
+  }
+
+  g_free (frames[0]);
+  g_free (frames[1]);
+
+  return 0;
+}
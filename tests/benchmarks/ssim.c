@@ -0,0 +1,194 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the frames per second of the SSIM engines of the ssim element per
+ * resolution and thread count, and the largest difference of the mean SSIM
+ * between the separable and the reference engine. Then measures how the
+ * frame rate of the separable engine scales with the number of modified
+ * streams compared against the same original, as for an ABR ladder.
+ *
+ * Usage: ssim [n-frames]
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "gstssimengine.h"
+
+static const gint resolutions[][2] = {
+  {320, 240}, {640, 360}, {1280, 720}, {1920, 1080}
+};
+
+static void
+fill_frames (guint8 * org, guint8 * mod, gint width, gint height)
+{
+  GRand *rand = g_rand_new_with_seed (0);
+  gint x, y;
+
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      gint v = (x * 255 / width + y * 255 / height) / 2;
+      gint noise = g_rand_int_range (rand, -12, 13);
+
+      org[y * width + x] = v;
+      mod[y * width + x] = CLAMP (v + noise, 0, 255);
+    }
+  }
+
+  g_rand_free (rand);
+}
+
+static gdouble
+run_engine (GstSSimEngineType type, guint n_threads, gint width, gint height,
+    const guint8 * org, const guint8 * mod, guint8 * out, guint n_frames,
+    gfloat * mean)
+{
+  GstSSimEngine *engine;
+  gfloat lowest, highest;
+  gint64 start;
+  gdouble elapsed;
+  guint i;
+
+  engine = gst_ssim_engine_new ();
+  gst_ssim_engine_set_threads (engine, n_threads, NULL);
+  gst_ssim_engine_configure (engine, type, width, height, 0, 1, 11, 1.5);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_frames; i++) {
+    gst_ssim_engine_set_original (engine, org, width);
+    gst_ssim_engine_compare (engine, mod, width, out, width, mean, &lowest,
+        &highest);
+  }
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  gst_ssim_engine_free (engine);
+
+  return n_frames / MAX (elapsed, 1e-6);
+}
+
+/* Compares @n_streams modified frames against the same original at once */
+static gdouble
+run_ladder (guint n_streams, guint n_threads, gint width, gint height,
+    const guint8 * org, const guint8 * mod, guint8 * out, guint n_frames)
+{
+  GstSSimEngine *engine;
+  GstSSimComparison *comparisons;
+  gint64 start;
+  gdouble elapsed;
+  guint i;
+
+  engine = gst_ssim_engine_new ();
+  gst_ssim_engine_set_threads (engine, n_threads, NULL);
+  gst_ssim_engine_configure (engine, GST_SSIM_ENGINE_TYPE_SEPARABLE, width,
+      height, 0, 1, 11, 1.5);
+
+  comparisons = g_new0 (GstSSimComparison, n_streams);
+  for (i = 0; i < n_streams; i++) {
+    comparisons[i].mod = mod;
+    comparisons[i].mod_stride = width;
+    comparisons[i].out = out + i * width * height;
+    comparisons[i].out_stride = width;
+  }
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n_frames; i++) {
+    gst_ssim_engine_set_original (engine, org, width);
+    gst_ssim_engine_compare_many (engine, comparisons, n_streams);
+  }
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  g_free (comparisons);
+  gst_ssim_engine_free (engine);
+
+  return n_frames / MAX (elapsed, 1e-6);
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  guint n_frames = 20;
+  guint i, n_cpus;
+
+  if (argc > 1)
+    n_frames = atoi (argv[1]);
+
+  n_cpus = g_get_num_processors ();
+
+  g_print ("%-10s %-10s %8s %10s %12s\n", "resolution", "engine", "threads",
+      "fps", "mean diff");
+
+  for (i = 0; i < G_N_ELEMENTS (resolutions); i++) {
+    gint width = resolutions[i][0], height = resolutions[i][1];
+    guint8 *org, *mod, *out;
+    gchar *res;
+    gfloat ref_mean, mean;
+    gdouble fps;
+    guint threads;
+
+    org = g_malloc (width * height);
+    mod = g_malloc (width * height);
+    out = g_malloc (width * height);
+    fill_frames (org, mod, width, height);
+    res = g_strdup_printf ("%dx%d", width, height);
+
+    /* the reference engine is slow, a few frames are enough */
+    fps = run_engine (GST_SSIM_ENGINE_TYPE_REFERENCE, 1, width, height, org,
+        mod, out, MAX (n_frames / 10, 1), &ref_mean);
+    g_print ("%-10s %-10s %8u %10.2f %12s\n", res, "reference", 1, fps, "-");
+
+    for (threads = 1; threads <= n_cpus; threads *= 2) {
+      fps = run_engine (GST_SSIM_ENGINE_TYPE_SEPARABLE, threads, width,
+          height, org, mod, out, n_frames, &mean);
+      g_print ("%-10s %-10s %8u %10.2f %12.2e\n", res, "separable", threads,
+          fps, fabs (mean - ref_mean));
+    }
+
+    g_free (res);
+    g_free (org);
+    g_free (mod);
+    g_free (out);
+  }
+
+  g_print ("\n%-10s %8s %8s %10s %14s\n", "resolution", "streams", "threads",
+      "fps", "stream-fps");
+
+  {
+    gint width = 1920, height = 1080;
+    guint8 *org, *mod, *out;
+    guint n_streams;
+    gdouble fps;
+
+    org = g_malloc (width * height);
+    mod = g_malloc (width * height);
+    out = g_malloc (4 * width * height);
+    fill_frames (org, mod, width, height);
+
+    for (n_streams = 1; n_streams <= 4; n_streams *= 2) {
+      fps = run_ladder (n_streams, n_cpus, width, height, org, mod, out,
+          n_frames);
+      g_print ("%-10s %8u %8u %10.2f %14.2f\n", "1920x1080", n_streams,
+          n_cpus, fps, fps * n_streams);
+    }
+
+    g_free (org);
+    g_free (mod);
+    g_free (out);
+  }
+
+  return 0;
+}
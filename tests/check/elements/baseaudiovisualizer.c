@@ -36,6 +36,8 @@ typedef struct _GstTestScopeClass GstTestScopeClass;
 struct _GstTestScope
 {
   GstAudioVisualizer parent;
+
+  guint n_frames;
 };
 
 struct _GstTestScopeClass
@@ -65,10 +67,37 @@ static GType gst_test_scope_get_type (void);
 
 G_DEFINE_TYPE (GstTestScope, gst_test_scope, GST_TYPE_AUDIO_VISUALIZER);
 
+/* draws a white row and column that move with every frame, so that the
+ * shaded trails of the previous frames show up in the output */
+static gboolean
+gst_test_scope_render (GstAudioVisualizer * base, GstBuffer * audio,
+    GstVideoFrame * video)
+{
+  GstTestScope *scope = GST_TEST_SCOPE (base);
+  guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (video, 0);
+  gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (video, 0);
+  gint width = GST_VIDEO_FRAME_WIDTH (video);
+  gint height = GST_VIDEO_FRAME_HEIGHT (video);
+  gint x, y;
+
+  y = (scope->n_frames * 7) % height;
+  for (x = 0; x < width; x++)
+    GST_WRITE_UINT32_BE (data + y * stride + x * 4, 0x00ffffff);
+  x = (scope->n_frames * 11) % width;
+  for (y = 0; y < height; y++)
+    GST_WRITE_UINT32_BE (data + y * stride + x * 4, 0x0080c0ff);
+  scope->n_frames++;
+
+  return TRUE;
+}
+
 static void
 gst_test_scope_class_init (GstTestScopeClass * g_class)
 {
   GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+  GstAudioVisualizerClass *scope_class = GST_AUDIO_VISUALIZER_CLASS (g_class);
+
+  scope_class->render = gst_test_scope_render;
 
   gst_element_class_set_static_metadata (element_class, "test scope",
       "Visualization",
@@ -108,6 +137,15 @@ static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_STATIC_CAPS (CAPS)
     );
 
+static GstStaticPadTemplate sinktemplate_big = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-raw, "
+        "format = (string) xRGB, "
+        "width = (int) 640, "
+        "height = (int) 480, " "framerate = (fraction) 30/1")
+    );
+
 GST_START_TEST (count_in_out)
 {
   GstElement *elem;
@@ -154,6 +192,267 @@ GST_START_TEST (count_in_out)
 
 GST_END_TEST;
 
+/* Reference shading: the source pixel each output pixel is moved from, or
+ * FALSE if the shader clears it */
+static gboolean
+shader_source (GstAudioVisualizerShader shader, gint width, gint height,
+    gint x, gint y, gint * sx, gint * sy)
+{
+  gint hmid = height / 2, wmid = width / 2;
+
+  *sx = x;
+  *sy = y;
+
+  switch (shader) {
+    case GST_AUDIO_VISUALIZER_SHADER_FADE:
+      return TRUE;
+    case GST_AUDIO_VISUALIZER_SHADER_FADE_AND_MOVE_UP:
+      *sy = y + 1;
+      return y < height - 1;
+    case GST_AUDIO_VISUALIZER_SHADER_FADE_AND_MOVE_DOWN:
+      *sy = y - 1;
+      return y > 0;
+    case GST_AUDIO_VISUALIZER_SHADER_FADE_AND_MOVE_LEFT:
+      *sx = x + 1;
+      return x < width - 1;
+    case GST_AUDIO_VISUALIZER_SHADER_FADE_AND_MOVE_RIGHT:
+      *sx = x - 1;
+      return x > 0;
+    case GST_AUDIO_VISUALIZER_SHADER_FADE_AND_MOVE_HORIZ_OUT:
+      if (y == hmid)
+        return FALSE;
+      *sy = y < hmid ? y + 1 : y - 1;
+      return TRUE;
+    case GST_AUDIO_VISUALIZER_SHADER_FADE_AND_MOVE_HORIZ_IN:
+      if (y == 0 || y == height - 1)
+        return FALSE;
+      *sy = y < hmid ? y - 1 : y + 1;
+      return TRUE;
+    case GST_AUDIO_VISUALIZER_SHADER_FADE_AND_MOVE_VERT_OUT:
+      if (x == wmid)
+        return FALSE;
+      *sx = x < wmid ? x + 1 : x - 1;
+      return TRUE;
+    case GST_AUDIO_VISUALIZER_SHADER_FADE_AND_MOVE_VERT_IN:
+      if (x == 0 || x == width - 1)
+        return FALSE;
+      *sx = x < wmid ? x - 1 : x + 1;
+      return TRUE;
+    default:
+      g_assert_not_reached ();
+      return FALSE;
+  }
+}
+
+/* the shaders work on native endian pixels, which is BGRx on little and
+ * xRGB on big endian machines */
+static guint32
+read_pixel (const guint8 * data)
+{
+  guint32 pixel;
+
+  memcpy (&pixel, data, 4);
+  return pixel;
+}
+
+/* saturating subtraction of the shade amount from R, G and B, x becomes 0 */
+static guint32
+shade_pixel (guint32 pixel, guint32 shade_amount)
+{
+  guint32 result = 0;
+  gint shift;
+
+  for (shift = 0; shift < 24; shift += 8) {
+    guint c = (pixel >> shift) & 0xff;
+    guint a = (shade_amount >> shift) & 0xff;
+
+    result |= (c > a ? c - a : 0) << shift;
+  }
+
+  return result;
+}
+
+static void
+check_shader (GstTestScope * scope, GstAudioVisualizerShader shader_type,
+    gint width, gint height, gint n_bands)
+{
+  GstAudioVisualizer *base = GST_AUDIO_VISUALIZER (scope);
+  GstVideoInfo info;
+  GstVideoFrame sframe, dframe;
+  GstBuffer *sbuf, *dbuf;
+  GstMapInfo map;
+  gint x, y, sx, sy, band;
+  guint8 *s, *d;
+  gint ss, ds;
+  gsize i;
+
+  g_object_set (scope, "shader", shader_type, NULL);
+  fail_unless (base->priv->shader != NULL);
+
+  gst_video_info_init (&info);
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_xRGB, width, height);
+  sbuf = gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (&info));
+  dbuf = gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (&info));
+
+  /* the pixels that are not written show up as garbage */
+  gst_buffer_map (sbuf, &map, GST_MAP_WRITE);
+  for (i = 0; i < map.size; i++)
+    map.data[i] = g_random_int_range (0, 256);
+  gst_buffer_unmap (sbuf, &map);
+  gst_buffer_memset (dbuf, 0, 0xab, GST_VIDEO_INFO_SIZE (&info));
+
+  fail_unless (gst_video_frame_map (&sframe, &info, sbuf, GST_MAP_READ));
+  fail_unless (gst_video_frame_map (&dframe, &info, dbuf, GST_MAP_WRITE));
+
+  for (band = 0; band < n_bands; band++)
+    base->priv->shader (base, &sframe, &dframe, height * band / n_bands,
+        height * (band + 1) / n_bands);
+
+  s = GST_VIDEO_FRAME_PLANE_DATA (&sframe, 0);
+  ss = GST_VIDEO_FRAME_PLANE_STRIDE (&sframe, 0);
+  d = GST_VIDEO_FRAME_PLANE_DATA (&dframe, 0);
+  ds = GST_VIDEO_FRAME_PLANE_STRIDE (&dframe, 0);
+
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      guint32 expected = 0, actual;
+
+      if (shader_source (shader_type, width, height, x, y, &sx, &sy)) {
+        fail_unless (sx >= 0 && sx < width && sy >= 0 && sy < height);
+        expected = shade_pixel (read_pixel (s + sy * ss + sx * 4),
+            base->priv->shade_amount);
+      }
+      actual = read_pixel (d + y * ds + x * 4);
+
+      fail_unless (actual == expected,
+          "shader %d, %dx%d in %d bands: pixel %d,%d is 0x%08x, expected "
+          "0x%08x", shader_type, width, height, n_bands, x, y, actual,
+          expected);
+    }
+  }
+
+  gst_video_frame_unmap (&sframe);
+  gst_video_frame_unmap (&dframe);
+  gst_buffer_unref (sbuf);
+  gst_buffer_unref (dbuf);
+}
+
+GST_START_TEST (shaders)
+{
+  static const gint sizes[][2] = {
+    {1, 1}, {2, 2}, {3, 3}, {5, 4}, {8, 7}, {17, 10}, {320, 240}
+  };
+  GstTestScope *scope;
+  GstAudioVisualizerShader shader;
+  guint i;
+
+  scope = g_object_new (GST_TYPE_TEST_SCOPE, NULL);
+  g_object_set (scope, "shade-amount", 0x00102040, NULL);
+
+  for (shader = GST_AUDIO_VISUALIZER_SHADER_FADE;
+      shader <= GST_AUDIO_VISUALIZER_SHADER_FADE_AND_MOVE_VERT_IN; shader++) {
+    for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+      gint width = sizes[i][0], height = sizes[i][1];
+
+      /* bands of one row, odd splits and the whole frame */
+      check_shader (scope, shader, width, height, 1);
+      check_shader (scope, shader, width, height, MIN (height, 3));
+      check_shader (scope, shader, width, height, height);
+    }
+  }
+
+  gst_object_unref (scope);
+}
+
+GST_END_TEST;
+
+/* renders 1s of audio and returns the concatenated frames */
+static GstBuffer *
+render_frames (const gchar * shader, guint n_threads)
+{
+  GstElement *elem;
+  GstPad *srcpad, *sinkpad;
+  GstBuffer *buffer, *frames;
+  GstCaps *caps;
+  GList *l;
+
+  elem = gst_check_setup_element ("testscope");
+  gst_util_set_object_arg (G_OBJECT (elem), "shader", shader);
+  g_object_set (elem, "n-threads", n_threads, NULL);
+  srcpad = gst_check_setup_src_pad (elem, &srctemplate);
+  sinkpad = gst_check_setup_sink_pad (elem, &sinktemplate_big);
+  gst_pad_set_active (srcpad, TRUE);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (elem,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (CAPS);
+  gst_check_setup_events (srcpad, elem, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  buffer = gst_buffer_new_and_alloc (44100 * 2 * sizeof (gint16));
+  gst_buffer_memset (buffer, 0, 0, 44100 * 2 * sizeof (gint16));
+  fail_unless (gst_pad_push (srcpad, buffer) == GST_FLOW_OK);
+  fail_unless_equals_int (g_list_length (buffers), 30);
+
+  frames = gst_buffer_new ();
+  for (l = buffers; l; l = l->next)
+    frames = gst_buffer_append (frames, gst_buffer_ref (l->data));
+
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+
+  gst_element_set_state (elem, GST_STATE_NULL);
+  gst_pad_set_active (srcpad, FALSE);
+  gst_pad_set_active (sinkpad, FALSE);
+  gst_check_teardown_src_pad (elem);
+  gst_check_teardown_sink_pad (elem);
+  gst_check_teardown_element (elem);
+
+  return frames;
+}
+
+static gboolean
+buffers_equal (GstBuffer * a, GstBuffer * b)
+{
+  GstMapInfo map;
+  gboolean equal;
+
+  gst_buffer_map (a, &map, GST_MAP_READ);
+  equal = gst_buffer_get_size (b) == map.size &&
+      gst_buffer_memcmp (b, 0, map.data, map.size) == 0;
+  gst_buffer_unmap (a, &map);
+
+  return equal;
+}
+
+/* 640x480 is big enough to be split into bands with several threads */
+GST_START_TEST (shaders_threads)
+{
+  static const gchar *shaders[] = {
+    "fade", "fade-and-move-up", "fade-and-move-down",
+    "fade-and-move-horiz-out", "fade-and-move-horiz-in",
+    "fade-and-move-vert-out", "fade-and-move-vert-in"
+  };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (shaders); i++) {
+    GstBuffer *single, *threaded;
+
+    single = render_frames (shaders[i], 1);
+    threaded = render_frames (shaders[i], 4);
+    fail_unless (buffers_equal (single, threaded),
+        "%s differs with 4 threads", shaders[i]);
+    gst_buffer_unref (single);
+    gst_buffer_unref (threaded);
+  }
+}
+
+GST_END_TEST;
+
 static void
 baseaudiovisualizer_init (void)
 {
@@ -170,6 +469,8 @@ baseaudiovisualizer_suite (void)
   tcase_add_checked_fixture (tc_chain, baseaudiovisualizer_init, NULL);
 
   tcase_add_test (tc_chain, count_in_out);
+  tcase_add_test (tc_chain, shaders);
+  tcase_add_test (tc_chain, shaders_threads);
 
   return s;
 }
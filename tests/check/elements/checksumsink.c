@@ -0,0 +1,475 @@
+/* GStreamer
+ *
+ * unit test for checksumsink
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstPad *mysrcpad;
+
+/* lines printed by the element, printed from the hashing threads too */
+static GMutex print_lock;
+static GPtrArray *printed;
+static GPrintFunc old_print_func;
+
+static void
+print_func (const gchar * string)
+{
+  g_mutex_lock (&print_lock);
+  g_ptr_array_add (printed, g_strchomp (g_strdup (string)));
+  g_mutex_unlock (&print_lock);
+}
+
+static GstElement *
+setup_checksumsink (const gchar * hash, guint n_threads)
+{
+  GstElement *checksumsink;
+
+  checksumsink = gst_check_setup_element ("checksumsink");
+  gst_util_set_object_arg (G_OBJECT (checksumsink), "hash", hash);
+  g_object_set (checksumsink, "n-threads", n_threads, NULL);
+  mysrcpad = gst_check_setup_src_pad (checksumsink, &srctemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+
+  printed = g_ptr_array_new_with_free_func (g_free);
+  old_print_func = g_set_print_handler (print_func);
+
+  return checksumsink;
+}
+
+static void
+start_checksumsink (GstElement * checksumsink, GstCaps * caps)
+{
+  fail_unless_equals_int (gst_element_set_state (checksumsink,
+          GST_STATE_PLAYING), GST_STATE_CHANGE_SUCCESS);
+  gst_check_setup_events (mysrcpad, checksumsink, caps, GST_FORMAT_TIME);
+}
+
+static void
+cleanup_checksumsink (GstElement * checksumsink)
+{
+  g_set_print_handler (old_print_func);
+  g_ptr_array_unref (printed);
+  printed = NULL;
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_check_teardown_src_pad (checksumsink);
+  gst_check_teardown_element (checksumsink);
+}
+
+static GstBuffer *
+create_buffer (guint i, gsize size)
+{
+  GstBuffer *buffer = gst_buffer_new_and_alloc (size);
+  GstMapInfo map;
+  gsize j;
+
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  for (j = 0; j < size; j++)
+    map.data[j] = i * 7 + j;
+  gst_buffer_unmap (buffer, &map);
+  GST_BUFFER_TIMESTAMP (buffer) = i * GST_SECOND;
+
+  return buffer;
+}
+
+static gchar *
+expected_line (GChecksumType type, GstBuffer * buffer)
+{
+  GstMapInfo map;
+  gchar *checksum, *line;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  checksum = g_compute_checksum_for_data (type, map.data, map.size);
+  gst_buffer_unmap (buffer, &map);
+
+  line = g_strdup_printf ("%" GST_TIME_FORMAT " %s",
+      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)), checksum);
+  g_free (checksum);
+
+  return line;
+}
+
+/* pushes @n_buffers buffers of different sizes and returns the lines the
+ * element should print for them */
+static GPtrArray *
+push_buffers (GChecksumType type, guint n_buffers)
+{
+  GPtrArray *lines = g_ptr_array_new_with_free_func (g_free);
+  guint i;
+
+  for (i = 0; i < n_buffers; i++) {
+    GstBuffer *buffer = create_buffer (i, 1000 + i * 517);
+
+    g_ptr_array_add (lines, expected_line (type, buffer));
+    fail_unless_equals_int (gst_pad_push (mysrcpad, buffer), GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  return lines;
+}
+
+static void
+check_printed (GPtrArray * lines)
+{
+  guint i;
+
+  g_mutex_lock (&print_lock);
+  fail_unless_equals_int (printed->len, lines->len);
+  for (i = 0; i < lines->len; i++)
+    fail_unless_equals_string (g_ptr_array_index (printed, i),
+        g_ptr_array_index (lines, i));
+  g_mutex_unlock (&print_lock);
+}
+
+static void
+run_hash_test (const gchar * hash, GChecksumType type, guint n_threads)
+{
+  GstElement *checksumsink;
+  GPtrArray *lines;
+
+  checksumsink = setup_checksumsink (hash, n_threads);
+  start_checksumsink (checksumsink, NULL);
+
+  lines = push_buffers (type, 50);
+  /* EOS waits for the hashing threads, everything is printed and in order */
+  check_printed (lines);
+
+  fail_unless_equals_int (gst_element_set_state (checksumsink,
+          GST_STATE_NULL), GST_STATE_CHANGE_SUCCESS);
+  g_ptr_array_unref (lines);
+  cleanup_checksumsink (checksumsink);
+}
+
+GST_START_TEST (test_hashes)
+{
+  run_hash_test ("sha1", G_CHECKSUM_SHA1, 1);
+  run_hash_test ("md5", G_CHECKSUM_MD5, 1);
+  run_hash_test ("sha256", G_CHECKSUM_SHA256, 1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_threads_in_order)
+{
+  run_hash_test ("md5", G_CHECKSUM_MD5, 4);
+  run_hash_test ("sha1", G_CHECKSUM_SHA1, 0);
+}
+
+GST_END_TEST;
+
+/* the fast hashes are checked against known values of the standard check
+ * input "123456789" */
+static void
+check_fast_hash (const gchar * hash, const gchar * expected)
+{
+  GstElement *checksumsink;
+  GstBuffer *buffer;
+  gchar *line;
+
+  checksumsink = setup_checksumsink (hash, 1);
+  start_checksumsink (checksumsink, NULL);
+
+  buffer = gst_buffer_new_and_alloc (9);
+  gst_buffer_fill (buffer, 0, "123456789", 9);
+  GST_BUFFER_TIMESTAMP (buffer) = 0;
+  fail_unless_equals_int (gst_pad_push (mysrcpad, buffer), GST_FLOW_OK);
+
+  line = g_strdup_printf ("%" GST_TIME_FORMAT " %s", GST_TIME_ARGS (0),
+      expected);
+  fail_unless_equals_int (printed->len, 1);
+  fail_unless_equals_string (g_ptr_array_index (printed, 0), line);
+  g_free (line);
+
+  fail_unless_equals_int (gst_element_set_state (checksumsink,
+          GST_STATE_NULL), GST_STATE_CHANGE_SUCCESS);
+  cleanup_checksumsink (checksumsink);
+}
+
+GST_START_TEST (test_fast_hashes)
+{
+  check_fast_hash ("crc32c", "e3069283");
+  check_fast_hash ("xxhash64", "8cb841db40e6ae83");
+}
+
+GST_END_TEST;
+
+/* Fills the visible pixels of a frame with a pattern and the padding with
+ * @padding, and returns the expected plane checksums */
+static GstBuffer *
+create_frame (GstVideoInfo * info, guint8 padding, gchar ** checksums)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  GString *result = g_string_new (NULL);
+  guint plane, comp;
+  gint x, y;
+
+  buffer = gst_buffer_new_and_alloc (GST_VIDEO_INFO_SIZE (info));
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  memset (map.data, padding, map.size);
+
+  for (plane = 0; plane < GST_VIDEO_INFO_N_PLANES (info); plane++) {
+    guint8 *data = map.data + GST_VIDEO_INFO_PLANE_OFFSET (info, plane);
+    gint stride = GST_VIDEO_INFO_PLANE_STRIDE (info, plane);
+    gint width = 0, height = 0;
+    GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+    for (comp = 0; comp < GST_VIDEO_INFO_N_COMPONENTS (info); comp++) {
+      if (GST_VIDEO_INFO_COMP_PLANE (info, comp) != plane)
+        continue;
+      width = GST_VIDEO_INFO_COMP_WIDTH (info, comp) *
+          GST_VIDEO_INFO_COMP_PSTRIDE (info, comp);
+      height = GST_VIDEO_INFO_COMP_HEIGHT (info, comp);
+      break;
+    }
+
+    for (y = 0; y < height; y++) {
+      for (x = 0; x < width; x++)
+        data[y * stride + x] = plane * 50 + y * 13 + x;
+      g_checksum_update (checksum, data + y * stride, width);
+    }
+
+    if (plane > 0)
+      g_string_append_c (result, ':');
+    g_string_append (result, g_checksum_get_string (checksum));
+    g_checksum_free (checksum);
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  *checksums = g_string_free (result, FALSE);
+  return buffer;
+}
+
+GST_START_TEST (test_plane_checksums)
+{
+  GstElement *checksumsink;
+  GstVideoInfo info;
+  GstBuffer *buffer;
+  GstCaps *caps;
+  gchar *checksums, *line;
+
+  /* odd sizes, all planes have padding at the end of the rows */
+  gst_video_info_init (&info);
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, 5, 3);
+  fail_unless (GST_VIDEO_INFO_PLANE_STRIDE (&info, 0) > 5);
+  caps = gst_video_info_to_caps (&info);
+
+  checksumsink = setup_checksumsink ("sha1", 1);
+  g_object_set (checksumsink, "plane-checksums", TRUE, NULL);
+  start_checksumsink (checksumsink, caps);
+
+  /* the same picture with different padding has the same checksums */
+  buffer = create_frame (&info, 0x00, &checksums);
+  GST_BUFFER_TIMESTAMP (buffer) = 0;
+  fail_unless_equals_int (gst_pad_push (mysrcpad, buffer), GST_FLOW_OK);
+  g_free (checksums);
+  buffer = create_frame (&info, 0xff, &checksums);
+  GST_BUFFER_TIMESTAMP (buffer) = GST_SECOND;
+  fail_unless_equals_int (gst_pad_push (mysrcpad, buffer), GST_FLOW_OK);
+
+  fail_unless_equals_int (printed->len, 2);
+  line = g_strdup_printf ("%" GST_TIME_FORMAT " %s", GST_TIME_ARGS (0),
+      checksums);
+  fail_unless_equals_string (g_ptr_array_index (printed, 0), line);
+  g_free (line);
+  line = g_strdup_printf ("%" GST_TIME_FORMAT " %s",
+      GST_TIME_ARGS (GST_SECOND), checksums);
+  fail_unless_equals_string (g_ptr_array_index (printed, 1), line);
+  g_free (line);
+  g_free (checksums);
+
+  fail_unless_equals_int (gst_element_set_state (checksumsink,
+          GST_STATE_NULL), GST_STATE_CHANGE_SUCCESS);
+  gst_caps_unref (caps);
+  cleanup_checksumsink (checksumsink);
+}
+
+GST_END_TEST;
+
+/* Runs 10 buffers against a golden file made from the expected output with
+ * line @bad_line changed or, if it's past the end, with @bad_line lines, and
+ * returns the mismatch message if any */
+static GstMessage *
+run_golden (guint n_threads, guint bad_line)
+{
+  GstElement *checksumsink;
+  GstMessage *msg;
+  GPtrArray *lines;
+  GString *golden;
+  GstBus *bus;
+  gchar *filename;
+  guint i;
+  gint fd;
+
+  /* the expected checksums are the same for every run */
+  lines = g_ptr_array_new_with_free_func (g_free);
+  for (i = 0; i < 10; i++) {
+    GstBuffer *buffer = create_buffer (i, 1000 + i * 517);
+
+    g_ptr_array_add (lines, expected_line (G_CHECKSUM_SHA1, buffer));
+    gst_buffer_unref (buffer);
+  }
+
+  golden = g_string_new ("# golden file\n");
+  for (i = 0; i < MIN (bad_line, 10); i++)
+    g_string_append_printf (golden, "%s\n",
+        (gchar *) g_ptr_array_index (lines, i));
+  if (bad_line < 10) {
+    g_string_append (golden, "0:00:00.000000000 0123456789\n");
+    for (i = bad_line + 1; i < 10; i++)
+      g_string_append_printf (golden, "%s\n",
+          (gchar *) g_ptr_array_index (lines, i));
+  } else {
+    for (i = 10; i < bad_line; i++)
+      g_string_append (golden, "0:00:00.000000000 0123456789\n");
+  }
+  g_ptr_array_unref (lines);
+
+  fd = g_file_open_tmp ("checksumsink-XXXXXX", &filename, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  fail_unless (g_file_set_contents (filename, golden->str, -1, NULL));
+  g_string_free (golden, TRUE);
+
+  checksumsink = setup_checksumsink ("sha1", n_threads);
+  g_object_set (checksumsink, "golden-file", filename, NULL);
+  bus = gst_bus_new ();
+  gst_element_set_bus (checksumsink, bus);
+  start_checksumsink (checksumsink, NULL);
+
+  lines = push_buffers (G_CHECKSUM_SHA1, 10);
+  check_printed (lines);
+  g_ptr_array_unref (lines);
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT);
+  /* only the first mismatch is posted */
+  fail_unless (gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT) == NULL);
+
+  fail_unless_equals_int (gst_element_set_state (checksumsink,
+          GST_STATE_NULL), GST_STATE_CHANGE_SUCCESS);
+  gst_element_set_bus (checksumsink, NULL);
+  gst_object_unref (bus);
+  cleanup_checksumsink (checksumsink);
+
+  g_unlink (filename);
+  g_free (filename);
+
+  return msg;
+}
+
+static void
+check_mismatch (GstMessage * msg, guint64 frame_number, gboolean has_expected,
+    gboolean has_actual)
+{
+  const GstStructure *s;
+  guint64 n;
+
+  fail_unless (msg != NULL);
+  s = gst_message_get_structure (msg);
+  fail_unless (gst_structure_has_name (s, "checksum-mismatch"));
+  fail_unless (gst_structure_get_uint64 (s, "frame-number", &n));
+  fail_unless_equals_uint64 (n, frame_number);
+  fail_unless_equals_int (gst_structure_get_string (s, "expected") != NULL,
+      has_expected);
+  fail_unless_equals_int (gst_structure_get_string (s, "actual") != NULL,
+      has_actual);
+  gst_message_unref (msg);
+}
+
+GST_START_TEST (test_golden_file)
+{
+  guint n_threads;
+
+  for (n_threads = 1; n_threads <= 4; n_threads += 3) {
+    /* matching file */
+    fail_unless (run_golden (n_threads, 10) == NULL);
+    /* different checksum */
+    check_mismatch (run_golden (n_threads, 3), 3, TRUE, TRUE);
+    check_mismatch (run_golden (n_threads, 0), 0, TRUE, TRUE);
+    /* file with more frames than the stream */
+    check_mismatch (run_golden (n_threads, 12), 10, TRUE, FALSE);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_golden_file_shorter)
+{
+  GstElement *checksumsink;
+  GPtrArray *lines;
+  GstBus *bus;
+  gchar *filename;
+  gint fd;
+
+  /* the stream has frames past the end of the file */
+  fd = g_file_open_tmp ("checksumsink-XXXXXX", &filename, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  fail_unless (g_file_set_contents (filename, "", -1, NULL));
+
+  checksumsink = setup_checksumsink ("sha1", 1);
+  g_object_set (checksumsink, "golden-file", filename, NULL);
+  bus = gst_bus_new ();
+  gst_element_set_bus (checksumsink, bus);
+  start_checksumsink (checksumsink, NULL);
+
+  lines = push_buffers (G_CHECKSUM_SHA1, 2);
+  g_ptr_array_unref (lines);
+  check_mismatch (gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT), 0, FALSE,
+      TRUE);
+
+  fail_unless_equals_int (gst_element_set_state (checksumsink,
+          GST_STATE_NULL), GST_STATE_CHANGE_SUCCESS);
+  gst_element_set_bus (checksumsink, NULL);
+  gst_object_unref (bus);
+  cleanup_checksumsink (checksumsink);
+
+  g_unlink (filename);
+  g_free (filename);
+}
+
+GST_END_TEST;
+
+static Suite *
+checksumsink_suite (void)
+{
+  Suite *s = suite_create ("checksumsink");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_hashes);
+  tcase_add_test (tc_chain, test_threads_in_order);
+  tcase_add_test (tc_chain, test_fast_hashes);
+  tcase_add_test (tc_chain, test_plane_checksums);
+  tcase_add_test (tc_chain, test_golden_file);
+  tcase_add_test (tc_chain, test_golden_file_shorter);
+
+  return s;
+}
+
+GST_CHECK_MAIN (checksumsink);
@@ -0,0 +1,331 @@
+/* GStreamer
+ *
+ * unit test for dtlsenc and dtlsdec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <string.h>
+
+/* algorithm OIDs of the subject public key */
+static const guint8 rsa_oid[] = {
+  0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01
+};
+static const guint8 ec_oid[] = {
+  0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01
+};
+
+static GMutex lock;
+static GCond cond;
+static guint n_keys;
+static guint n_resumed;
+static GList *received;
+
+static gboolean
+certificate_has_oid (const gchar * pem, const guint8 * oid, gsize oid_size)
+{
+  const gchar *begin, *end;
+  gchar *base64;
+  guint8 *der;
+  gsize der_size, i;
+  gboolean found = FALSE;
+
+  begin = strstr (pem, "-----BEGIN CERTIFICATE-----");
+  end = strstr (pem, "-----END CERTIFICATE-----");
+  fail_unless (begin != NULL && end != NULL);
+  begin += strlen ("-----BEGIN CERTIFICATE-----");
+
+  base64 = g_strndup (begin, end - begin);
+  der = g_base64_decode (base64, &der_size);
+  for (i = 0; i + oid_size <= der_size && !found; i++)
+    found = memcmp (der + i, oid, oid_size) == 0;
+
+  g_free (der);
+  g_free (base64);
+
+  return found;
+}
+
+static gchar *
+get_pem (const gchar * id, const gchar * key_type)
+{
+  GstElement *dec;
+  gchar *pem;
+
+  dec = gst_element_factory_make ("dtlsdec", NULL);
+  fail_unless (dec != NULL);
+
+  /* gst-launch sets properties in this order too */
+  g_object_set (dec, "connection-id", id, NULL);
+  if (key_type)
+    gst_util_set_object_arg (G_OBJECT (dec), "key-type", key_type);
+  g_object_get (dec, "pem", &pem, NULL);
+  fail_unless (pem != NULL);
+
+  gst_object_unref (dec);
+
+  return pem;
+}
+
+GST_START_TEST (test_key_type)
+{
+  gchar *pem;
+
+  /* the key type set after the connection id is the one used */
+  pem = get_pem ("key-type-ecdsa", "ecdsa");
+  fail_unless (certificate_has_oid (pem, ec_oid, sizeof (ec_oid)));
+  fail_if (certificate_has_oid (pem, rsa_oid, sizeof (rsa_oid)));
+  g_free (pem);
+
+  pem = get_pem ("key-type-default", NULL);
+  fail_unless (certificate_has_oid (pem, rsa_oid, sizeof (rsa_oid)));
+  fail_if (certificate_has_oid (pem, ec_oid, sizeof (ec_oid)));
+  g_free (pem);
+}
+
+GST_END_TEST;
+
+static void
+on_key_received (GstElement * dec, gpointer user_data)
+{
+  g_mutex_lock (&lock);
+  n_keys++;
+  g_cond_signal (&cond);
+  g_mutex_unlock (&lock);
+}
+
+#ifndef GST_DISABLE_GST_DEBUG
+static void
+log_func (GstDebugCategory * category, GstDebugLevel level,
+    const gchar * file, const gchar * function, gint line, GObject * object,
+    GstDebugMessage * message, gpointer user_data)
+{
+  if (strcmp (gst_debug_category_get_name (category), "dtlsconnection") != 0)
+    return;
+
+  if (strcmp (gst_debug_message_get (message), "session resumed") == 0)
+    g_atomic_int_inc (&n_resumed);
+}
+#endif
+
+/* runs one handshake between a client and a server, returns the pipeline
+ * after both sides have received their keys. The data the client sends
+ * comes out of the server into a fakesink named "sink". */
+static GstElement *
+handshake (const gchar * id)
+{
+  GstElement *pipeline, *client, *server;
+  gchar *desc;
+  gint64 deadline;
+
+  desc = g_strdup_printf ("dtlsenc name=client-enc connection-id=%s-c "
+      "is-client=true ! dtlsdec name=server connection-id=%s-s key-type=ecdsa "
+      "! fakesink name=sink sync=false signal-handoffs=true "
+      "dtlsenc connection-id=%s-s is-client=false ! "
+      "dtlsdec name=client connection-id=%s-c key-type=ecdsa", id, id, id, id);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  client = gst_bin_get_by_name (GST_BIN (pipeline), "client");
+  server = gst_bin_get_by_name (GST_BIN (pipeline), "server");
+  g_signal_connect (client, "on-key-received", G_CALLBACK (on_key_received),
+      NULL);
+  g_signal_connect (server, "on-key-received", G_CALLBACK (on_key_received),
+      NULL);
+  gst_object_unref (client);
+  gst_object_unref (server);
+
+  n_keys = 0;
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  deadline = g_get_monotonic_time () + 30 * G_USEC_PER_SEC;
+  g_mutex_lock (&lock);
+  while (n_keys < 2) {
+    if (!g_cond_wait_until (&cond, &lock, deadline))
+      break;
+  }
+  fail_unless_equals_int (n_keys, 2);
+  g_mutex_unlock (&lock);
+
+  return pipeline;
+}
+
+static void
+check_peer_certificates (GstElement * pipeline)
+{
+  GstElement *client, *server;
+  gchar *client_pem, *server_pem, *client_peer_pem, *server_peer_pem;
+
+  client = gst_bin_get_by_name (GST_BIN (pipeline), "client");
+  server = gst_bin_get_by_name (GST_BIN (pipeline), "server");
+  g_object_get (client, "pem", &client_pem, "peer-pem", &client_peer_pem,
+      NULL);
+  g_object_get (server, "pem", &server_pem, "peer-pem", &server_peer_pem,
+      NULL);
+
+  /* a resumed session still passes on the certificate of the peer */
+  fail_unless (client_peer_pem != NULL);
+  fail_unless (server_peer_pem != NULL);
+  fail_unless (strstr (server_pem, client_peer_pem) != NULL);
+  fail_unless (strstr (client_pem, server_peer_pem) != NULL);
+
+  g_free (client_pem);
+  g_free (server_pem);
+  g_free (client_peer_pem);
+  g_free (server_peer_pem);
+  gst_object_unref (client);
+  gst_object_unref (server);
+}
+
+GST_START_TEST (test_session_resumption)
+{
+  /* resumption is only visible in the debug log */
+#ifndef GST_DISABLE_GST_DEBUG
+  GstElement *pipeline;
+
+  gst_debug_set_threshold_for_name ("dtlsconnection", GST_LEVEL_INFO);
+  gst_debug_add_log_function (log_func, NULL, NULL);
+  n_resumed = 0;
+
+  /* the first handshake with an id is a full one */
+  pipeline = handshake ("resume");
+  fail_unless_equals_int (g_atomic_int_get (&n_resumed), 0);
+  check_peer_certificates (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  /* the client resumes the session of the same id */
+  pipeline = handshake ("resume");
+  fail_unless (g_atomic_int_get (&n_resumed) > 0);
+  check_peer_certificates (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  /* but not the one of another id */
+  n_resumed = 0;
+  pipeline = handshake ("other");
+  fail_unless_equals_int (g_atomic_int_get (&n_resumed), 0);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  gst_debug_remove_log_function (log_func);
+#endif
+}
+
+GST_END_TEST;
+
+static void
+on_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  g_mutex_lock (&lock);
+  received = g_list_append (received, gst_buffer_ref (buffer));
+  g_cond_signal (&cond);
+  g_mutex_unlock (&lock);
+}
+
+#define N_PACKETS 20
+
+/* The size of packet @index, the last one does not fit in a buffer of the
+ * record pool of the connection */
+static gsize
+packet_size (guint index)
+{
+  return index == N_PACKETS - 1 ? 4000 : 16 + index * 50;
+}
+
+GST_START_TEST (test_loopback_list)
+{
+  GstElement *pipeline, *enc, *sink;
+  GstBufferList *list;
+  GstPad *pad;
+  GList *l;
+  gint64 deadline;
+  guint i;
+
+  pipeline = handshake ("loopback");
+  enc = gst_bin_get_by_name (GST_BIN (pipeline), "client-enc");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (on_handoff), NULL);
+  pad = gst_element_get_request_pad (enc, "sink");
+  fail_unless (pad != NULL);
+
+  /* every packet is filled with its index */
+  list = gst_buffer_list_new ();
+  for (i = 0; i < N_PACKETS; i++) {
+    GstBuffer *buffer = gst_buffer_new_allocate (NULL, packet_size (i), NULL);
+
+    gst_buffer_memset (buffer, 0, i, packet_size (i));
+    gst_buffer_list_add (list, buffer);
+  }
+  fail_unless_equals_int (gst_pad_chain_list (pad, list), GST_FLOW_OK);
+
+  deadline = g_get_monotonic_time () + 10 * G_USEC_PER_SEC;
+  g_mutex_lock (&lock);
+  while (g_list_length (received) < N_PACKETS) {
+    if (!g_cond_wait_until (&cond, &lock, deadline))
+      break;
+  }
+  g_mutex_unlock (&lock);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  /* the packets come out of the server whole and in order */
+  fail_unless_equals_int (g_list_length (received), N_PACKETS);
+  for (l = received, i = 0; l; l = l->next, i++) {
+    GstBuffer *buffer = l->data;
+    GstMapInfo map;
+    gsize j;
+
+    gst_buffer_map (buffer, &map, GST_MAP_READ);
+    fail_unless_equals_int (map.size, packet_size (i));
+    for (j = 0; j < map.size; j++)
+      fail_unless_equals_int (map.data[j], i);
+    gst_buffer_unmap (buffer, &map);
+  }
+  g_list_free_full (received, (GDestroyNotify) gst_buffer_unref);
+  received = NULL;
+
+  gst_element_release_request_pad (enc, pad);
+  gst_object_unref (pad);
+  gst_object_unref (enc);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+static Suite *
+dtls_suite (void)
+{
+  Suite *s = suite_create ("dtls");
+  TCase *tc_chain = tcase_create ("general");
+
+  /* certificate generation and handshakes can take a while */
+  tcase_set_timeout (tc_chain, 60);
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_key_type);
+  tcase_add_test (tc_chain, test_session_resumption);
+  tcase_add_test (tc_chain, test_loopback_list);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dtls);
@@ -0,0 +1,228 @@
+/* GStreamer
+ *
+ * unit test for fieldanalysis
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+
+#define WIDTH 64
+#define HEIGHT 48
+#define N_FRAMES 8
+
+static GstPad *mysrcpad, *mysinkpad;
+
+#define VIDEO_CAPS_STRING "video/x-raw, format = (string) I420, " \
+    "width = (int) 64, height = (int) 48, framerate = (fraction) 25/1"
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS ("video/x-raw"));
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS (VIDEO_CAPS_STRING));
+
+static GstElement *
+setup_fieldanalysis (guint n_threads)
+{
+  GstElement *fieldanalysis;
+  GstCaps *caps;
+
+  fieldanalysis = gst_check_setup_element ("fieldanalysis");
+  g_object_set (fieldanalysis, "n-threads", n_threads, NULL);
+  mysrcpad = gst_check_setup_src_pad (fieldanalysis, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (fieldanalysis, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (fieldanalysis,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (VIDEO_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, fieldanalysis, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return fieldanalysis;
+}
+
+static void
+cleanup_fieldanalysis (GstElement * fieldanalysis)
+{
+  gst_check_drop_buffers ();
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (fieldanalysis);
+  gst_check_teardown_sink_pad (fieldanalysis);
+  gst_check_teardown_element (fieldanalysis);
+}
+
+/* Returns an I420 frame with flat grey fields, the lines of the top field
+ * are @top and those of the bottom field @bottom */
+static GstBuffer *
+create_frame (guint8 top, guint8 bottom, guint index)
+{
+  GstVideoInfo info;
+  GstVideoFrame frame;
+  GstBuffer *buffer;
+  guint8 *data;
+  gint stride, y;
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, WIDTH, HEIGHT);
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info), NULL);
+
+  gst_video_frame_map (&frame, &info, buffer, GST_MAP_WRITE);
+  data = GST_VIDEO_FRAME_COMP_DATA (&frame, 0);
+  stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 0);
+  for (y = 0; y < HEIGHT; y++)
+    memset (data + y * stride, y & 1 ? bottom : top, WIDTH);
+  for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (&frame, 1); y++) {
+    memset (GST_VIDEO_FRAME_COMP_DATA (&frame, 1) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (&frame, 1), 128, WIDTH / 2);
+    memset (GST_VIDEO_FRAME_COMP_DATA (&frame, 2) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (&frame, 2), 128, WIDTH / 2);
+  }
+  gst_video_frame_unmap (&frame);
+
+  GST_BUFFER_PTS (buffer) = index * GST_SECOND / 25;
+  GST_BUFFER_DURATION (buffer) = GST_SECOND / 25;
+
+  return buffer;
+}
+
+/* Fields k of a sequence, no two neighbouring fields in time, of the same
+ * parity or the same frame look alike */
+static guint8
+field_value (guint k)
+{
+  return 16 + 60 * (k % 4);
+}
+
+static void
+check_interlace_mode (const gchar * expected)
+{
+  GstCaps *caps;
+  GstStructure *s;
+
+  caps = gst_pad_get_current_caps (mysinkpad);
+  fail_unless (caps != NULL);
+  s = gst_caps_get_structure (caps, 0);
+  fail_unless_equals_string (gst_structure_get_string (s, "interlace-mode"),
+      expected);
+  gst_caps_unref (caps);
+}
+
+static void
+check_progressive (guint n_threads)
+{
+  GstElement *fieldanalysis;
+  GList *l;
+  guint i;
+
+  fieldanalysis = setup_fieldanalysis (n_threads);
+
+  /* both fields of a frame are from the same picture */
+  for (i = 0; i < N_FRAMES; i++) {
+    guint8 v = field_value (2 * i);
+
+    fail_unless_equals_int (gst_pad_push (mysrcpad, create_frame (v, v, i)),
+        GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  fail_unless_equals_int (g_list_length (buffers), N_FRAMES);
+  for (l = buffers; l; l = l->next) {
+    GstBuffer *buffer = l->data;
+
+    fail_if (GST_BUFFER_FLAG_IS_SET (buffer,
+            GST_VIDEO_BUFFER_FLAG_INTERLACED));
+    fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_VIDEO_BUFFER_FLAG_ONEFIELD));
+  }
+  check_interlace_mode ("progressive");
+
+  cleanup_fieldanalysis (fieldanalysis);
+}
+
+static void
+check_combed (guint n_threads)
+{
+  GstElement *fieldanalysis;
+  GList *l;
+  guint i;
+
+  fieldanalysis = setup_fieldanalysis (n_threads);
+
+  /* every field is from a different point in time */
+  for (i = 0; i < N_FRAMES; i++) {
+    fail_unless_equals_int (gst_pad_push (mysrcpad,
+            create_frame (field_value (2 * i), field_value (2 * i + 1), i)),
+        GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  fail_unless_equals_int (g_list_length (buffers), N_FRAMES);
+  for (l = buffers; l; l = l->next) {
+    GstBuffer *buffer = l->data;
+
+    fail_unless (GST_BUFFER_FLAG_IS_SET (buffer,
+            GST_VIDEO_BUFFER_FLAG_INTERLACED));
+    fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_VIDEO_BUFFER_FLAG_ONEFIELD));
+    fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_VIDEO_BUFFER_FLAG_RFF));
+  }
+  check_interlace_mode ("interleaved");
+
+  cleanup_fieldanalysis (fieldanalysis);
+}
+
+GST_START_TEST (test_progressive)
+{
+  check_progressive (1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_combed)
+{
+  check_combed (1);
+}
+
+GST_END_TEST;
+
+/* the bands of the frames are shared with a thread pool */
+GST_START_TEST (test_threads)
+{
+  check_progressive (4);
+  check_combed (4);
+}
+
+GST_END_TEST;
+
+static Suite *
+fieldanalysis_suite (void)
+{
+  Suite *s = suite_create ("fieldanalysis");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_progressive);
+  tcase_add_test (tc_chain, test_combed);
+  tcase_add_test (tc_chain, test_threads);
+
+  return s;
+}
+
+GST_CHECK_MAIN (fieldanalysis);
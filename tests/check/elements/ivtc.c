@@ -0,0 +1,262 @@
+/* GStreamer
+ *
+ * unit test for ivtc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+
+#define WIDTH 64
+#define HEIGHT 48
+/* cycles of 4 film pictures telecined to 5 frames */
+#define N_CYCLES 4
+
+static GstPad *mysrcpad, *mysinkpad;
+
+#define VIDEO_CAPS_STRING "video/x-raw, format = (string) I420, " \
+    "width = (int) 64, height = (int) 48, framerate = (fraction) 30/1"
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS ("video/x-raw"));
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS (VIDEO_CAPS_STRING));
+
+static GstElement *
+setup_ivtc (guint n_threads)
+{
+  GstElement *ivtc;
+  GstCaps *caps;
+
+  ivtc = gst_check_setup_element ("ivtc");
+  g_object_set (ivtc, "n-threads", n_threads, NULL);
+  mysrcpad = gst_check_setup_src_pad (ivtc, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (ivtc, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (ivtc,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (VIDEO_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, ivtc, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return ivtc;
+}
+
+static void
+cleanup_ivtc (GstElement * ivtc)
+{
+  gst_check_drop_buffers ();
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (ivtc);
+  gst_check_teardown_sink_pad (ivtc);
+  gst_check_teardown_element (ivtc);
+}
+
+/* The luma of film picture @n */
+static guint8
+picture_value (guint n)
+{
+  return 16 + 40 * (n % 5);
+}
+
+/* Returns a 30 fps I420 frame woven from the pictures @top and @bottom */
+static GstBuffer *
+create_frame (guint top, guint bottom, guint index, gboolean tff)
+{
+  GstVideoInfo info;
+  GstVideoFrame frame;
+  GstBuffer *buffer;
+  guint8 *data;
+  gint stride, y;
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, WIDTH, HEIGHT);
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info), NULL);
+
+  gst_video_frame_map (&frame, &info, buffer, GST_MAP_WRITE);
+  data = GST_VIDEO_FRAME_COMP_DATA (&frame, 0);
+  stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 0);
+  for (y = 0; y < HEIGHT; y++)
+    memset (data + y * stride, picture_value (y & 1 ? bottom : top), WIDTH);
+  for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (&frame, 1); y++) {
+    memset (GST_VIDEO_FRAME_COMP_DATA (&frame, 1) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (&frame, 1), 128, WIDTH / 2);
+    memset (GST_VIDEO_FRAME_COMP_DATA (&frame, 2) +
+        y * GST_VIDEO_FRAME_COMP_STRIDE (&frame, 2), 128, WIDTH / 2);
+  }
+  gst_video_frame_unmap (&frame);
+
+  GST_BUFFER_PTS (buffer) = gst_util_uint64_scale (index, GST_SECOND, 30);
+  GST_BUFFER_DURATION (buffer) = gst_util_uint64_scale (index + 1,
+      GST_SECOND, 30) - GST_BUFFER_PTS (buffer);
+  if (tff)
+    GST_BUFFER_FLAG_SET (buffer, GST_VIDEO_BUFFER_FLAG_TFF);
+
+  return buffer;
+}
+
+/* Returns the picture of @buffer, or -1 if its lines are not all from the
+ * same one */
+static gint
+get_picture (GstBuffer * buffer)
+{
+  GstVideoInfo info;
+  GstVideoFrame frame;
+  guint8 *data;
+  gint stride, x, y, n;
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, WIDTH, HEIGHT);
+  fail_unless (gst_video_frame_map (&frame, &info, buffer, GST_MAP_READ));
+  data = GST_VIDEO_FRAME_COMP_DATA (&frame, 0);
+  stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 0);
+
+  for (n = 0; n < 5; n++) {
+    if (data[0] == picture_value (n))
+      break;
+  }
+  for (y = 0; y < HEIGHT && n < 5; y++) {
+    for (x = 0; x < WIDTH; x++) {
+      if (data[y * stride + x] != data[0]) {
+        n = 5;
+        break;
+      }
+    }
+  }
+  gst_video_frame_unmap (&frame);
+
+  return n < 5 ? n : -1;
+}
+
+static void
+check_telecine (guint n_threads)
+{
+  /* 3:2 pulldown of the pictures A B C D: AA BB BC CD DD */
+  static const guint pulldown[5][2] = {
+    {0, 0}, {1, 1}, {1, 2}, {2, 3}, {3, 3}
+  };
+  GstElement *ivtc;
+  GstCaps *caps;
+  GList *l;
+  gint fps_n, fps_d, last = -1;
+  guint i, n_buffers;
+
+  ivtc = setup_ivtc (n_threads);
+
+  for (i = 0; i < 5 * N_CYCLES; i++) {
+    guint base = 4 * (i / 5);
+
+    fail_unless_equals_int (gst_pad_push (mysrcpad,
+            create_frame (base + pulldown[i % 5][0],
+                base + pulldown[i % 5][1], i, TRUE)), GST_FLOW_OK);
+  }
+
+  caps = gst_pad_get_current_caps (mysinkpad);
+  fail_unless (caps != NULL);
+  fail_unless (gst_structure_get_fraction (gst_caps_get_structure (caps, 0),
+          "framerate", &fps_n, &fps_d));
+  fail_unless_equals_int (fps_n, 24);
+  fail_unless_equals_int (fps_d, 1);
+  gst_caps_unref (caps);
+
+  /* the fields that are still held are not output */
+  n_buffers = g_list_length (buffers);
+  fail_unless (n_buffers >= 4 * N_CYCLES - 2 && n_buffers <= 4 * N_CYCLES,
+      "%u buffers", n_buffers);
+
+  /* every output is a whole film picture, each picture once and in order */
+  for (l = buffers; l; l = l->next) {
+    GstBuffer *buffer = l->data;
+    gint picture = get_picture (buffer);
+
+    fail_unless (picture >= 0, "combed output frame");
+    fail_if (GST_BUFFER_FLAG_IS_SET (buffer,
+            GST_VIDEO_BUFFER_FLAG_INTERLACED));
+    if (last >= 0)
+      fail_unless_equals_int (picture, (last + 1) % 5);
+    last = picture;
+  }
+
+  cleanup_ivtc (ivtc);
+}
+
+static void
+check_progressive (guint n_threads)
+{
+  GstElement *ivtc;
+  GList *l;
+  guint i;
+
+  ivtc = setup_ivtc (n_threads);
+
+  /* both fields of every frame are from the same picture */
+  for (i = 0; i < 5 * N_CYCLES; i++) {
+    fail_unless_equals_int (gst_pad_push (mysrcpad,
+            create_frame (i, i, i, FALSE)), GST_FLOW_OK);
+  }
+
+  /* 30 fps in, 24 fps out, so some of the pictures are dropped but none is
+   * combed with another */
+  fail_unless (g_list_length (buffers) >= 4 * N_CYCLES - 2);
+  for (l = buffers; l; l = l->next)
+    fail_unless (get_picture (l->data) >= 0, "combed output frame");
+
+  cleanup_ivtc (ivtc);
+}
+
+GST_START_TEST (test_telecine)
+{
+  check_telecine (1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_progressive)
+{
+  check_progressive (1);
+}
+
+GST_END_TEST;
+
+/* the comb detection runs in bands shared with a thread pool */
+GST_START_TEST (test_threads)
+{
+  check_telecine (4);
+  check_progressive (4);
+}
+
+GST_END_TEST;
+
+static Suite *
+ivtc_suite (void)
+{
+  Suite *s = suite_create ("ivtc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_telecine);
+  tcase_add_test (tc_chain, test_progressive);
+  tcase_add_test (tc_chain, test_threads);
+
+  return s;
+}
+
+GST_CHECK_MAIN (ivtc);
@@ -0,0 +1,214 @@
+/* GStreamer
+ *
+ * unit test for jp2kdecimator
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "../../gst/jp2kdecimator/jp2kcodestream.c"
+#include "jp2kdecimator.h"
+#undef GST_CAT_DEFAULT
+
+#include <gst/check/gstcheck.h>
+
+GST_DEBUG_CATEGORY (gst_jp2k_decimator_debug);
+
+#define TEST_FRAME_SIZE (64 * 1024)
+
+static GstPad *mysrcpad, *mysinkpad;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS ("image/x-jpc"));
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS ("image/x-jpc"));
+
+static const FrameLayout layouts[] = {
+  {"LRCP/SOP", PROGRESSION_ORDER_LRCP, TRUE, FALSE},
+  {"LRCP/PLT", PROGRESSION_ORDER_LRCP, FALSE, TRUE},
+  {"RLCP/PLT", PROGRESSION_ORDER_RLCP, FALSE, TRUE},
+  {"RPCL/SOP", PROGRESSION_ORDER_RPCL, TRUE, FALSE},
+  {"CPRL/SOP+PLT", PROGRESSION_ORDER_CPRL, TRUE, TRUE},
+};
+
+static GstElement *
+setup_jp2kdecimator (void)
+{
+  GstElement *decimator;
+  GstCaps *caps;
+
+  decimator = gst_check_setup_element ("jp2kdecimator");
+  mysrcpad = gst_check_setup_src_pad (decimator, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (decimator, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (decimator,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_new_empty_simple ("image/x-jpc");
+  gst_check_setup_events (mysrcpad, decimator, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return decimator;
+}
+
+static void
+cleanup_jp2kdecimator (GstElement * decimator)
+{
+  gst_check_drop_buffers ();
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (decimator);
+  gst_check_teardown_sink_pad (decimator);
+  gst_check_teardown_element (decimator);
+}
+
+/* Pushes @inbuf and checks that the output is the one of the reference */
+static void
+check_decimation (GstElement * decimator, GstBuffer * inbuf,
+    GstBuffer * expected, const gchar * name)
+{
+  GstBuffer *outbuf;
+  GstMapInfo map;
+
+  fail_unless_equals_int (gst_pad_push (mysrcpad, inbuf), GST_FLOW_OK);
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  outbuf = buffers->data;
+
+  gst_buffer_map (expected, &map, GST_MAP_READ);
+  fail_unless_equals_int (gst_buffer_get_size (outbuf), map.size);
+  fail_unless (gst_buffer_memcmp (outbuf, 0, map.data, map.size) == 0,
+      "%s: output differs from the reference", name);
+  gst_buffer_unmap (expected, &map);
+
+  gst_check_drop_buffers ();
+}
+
+static void
+check_decimate (gint max_layers, gint max_decomposition_levels)
+{
+  GstElement *decimator;
+  guint i;
+
+  decimator = setup_jp2kdecimator ();
+  g_object_set (decimator, "max-layers", max_layers,
+      "max-decomposition-levels", max_decomposition_levels, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (layouts); i++) {
+    GstBuffer *frame, *expected, *split;
+    gsize size;
+
+    frame = create_frame (&layouts[i], TEST_FRAME_SIZE);
+    size = gst_buffer_get_size (frame);
+
+    /* the element only provides the properties to the reference */
+    expected = decimate_tree ((GstJP2kDecimator *) decimator, frame);
+    fail_unless (expected != NULL);
+    fail_unless (gst_buffer_get_size (expected) < size);
+
+    /* kept packets shared with the input */
+    check_decimation (decimator, gst_buffer_ref (frame), expected,
+        layouts[i].name);
+
+    /* and copied from an input of more than one memory */
+    split = gst_buffer_new ();
+    gst_buffer_copy_into (split, frame, GST_BUFFER_COPY_MEMORY, 0, size / 2);
+    gst_buffer_copy_into (split, frame, GST_BUFFER_COPY_MEMORY, size / 2,
+        size - size / 2);
+    fail_unless_equals_int (gst_buffer_n_memory (split), 2);
+    check_decimation (decimator, split, expected, layouts[i].name);
+
+    gst_buffer_unref (expected);
+    gst_buffer_unref (frame);
+  }
+
+  cleanup_jp2kdecimator (decimator);
+}
+
+GST_START_TEST (test_decimate_layers)
+{
+  check_decimate (2, -1);
+  check_decimate (1, -1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_decimate_decomposition_levels)
+{
+  check_decimate (0, 3);
+  check_decimate (0, 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_decimate_both)
+{
+  check_decimate (2, 3);
+  check_decimate (1, 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_missing_sod)
+{
+  GstElement *decimator;
+  GstBuffer *frame;
+  GstMapInfo map;
+  gsize i;
+
+  decimator = setup_jp2kdecimator ();
+  g_object_set (decimator, "max-layers", 2, NULL);
+
+  /* there is no PLT in this layout that could contain the SOD bytes */
+  frame = create_frame (&layouts[0], TEST_FRAME_SIZE);
+  gst_buffer_map (frame, &map, GST_MAP_READWRITE);
+  for (i = 0; i + 1 < map.size; i++) {
+    if (GST_READ_UINT16_BE (map.data + i) == MARKER_SOD)
+      break;
+  }
+  fail_unless (i + 1 < map.size);
+  GST_WRITE_UINT16_BE (map.data + i, MARKER_EPH);
+  gst_buffer_unmap (frame, &map);
+
+  fail_unless_equals_int (gst_pad_push (mysrcpad, frame), GST_FLOW_ERROR);
+  fail_unless (buffers == NULL);
+
+  cleanup_jp2kdecimator (decimator);
+}
+
+GST_END_TEST;
+
+static Suite *
+jp2kdecimator_suite (void)
+{
+  Suite *s = suite_create ("jp2kdecimator");
+  TCase *tc_chain = tcase_create ("general");
+
+  GST_DEBUG_CATEGORY_INIT (gst_jp2k_decimator_debug, "jp2kdecimator", 0,
+      "JPEG2000 decimator");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_decimate_layers);
+  tcase_add_test (tc_chain, test_decimate_decomposition_levels);
+  tcase_add_test (tc_chain, test_decimate_both);
+  tcase_add_test (tc_chain, test_missing_sod);
+
+  return s;
+}
+
+GST_CHECK_MAIN (jp2kdecimator);
@@ -0,0 +1,452 @@
+/* GStreamer
+ *
+ * Reference decimation and synthesized codestreams for jp2kdecimator
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Shared by the unit test and the benchmark, must be included after
+ * gst/jp2kdecimator/jp2kcodestream.c as it uses its static functions.
+ *
+ * The reference parses the whole codestream into the tiles of the
+ * MainHeader, decimates the packets of the tree and writes all of it
+ * again. This is how the element worked before it decimated in a single
+ * pass, and the output of both must be identical. */
+
+#include <string.h>
+
+static GstFlowReturn
+parse_packets (GstJP2kDecimator * self, GstByteReader * reader,
+    const MainHeader * header, Tile * tile)
+{
+  guint16 marker = 0;
+  GstFlowReturn ret = GST_FLOW_OK;
+  PacketIterator it;
+
+  /* Start of data here */
+  if (!gst_byte_reader_get_uint16_be (reader, &marker)
+      || marker != MARKER_SOD) {
+    GST_ERROR_OBJECT (self, "No SOD in tile");
+    return GST_FLOW_ERROR;
+  }
+
+  ret = init_packet_iterator (self, &it, header, tile);
+  if (ret != GST_FLOW_OK)
+    goto done;
+
+  while ((it.next (&it))) {
+    Packet *p = g_slice_new (Packet);
+
+    ret = parse_packet (self, reader, header, tile, &it, p);
+    if (ret != GST_FLOW_OK) {
+      g_slice_free (Packet, p);
+      goto done;
+    }
+    tile->packets = g_list_prepend (tile->packets, p);
+  }
+
+  tile->packets = g_list_reverse (tile->packets);
+
+done:
+
+  return ret;
+}
+
+static GstFlowReturn
+parse_tile (GstJP2kDecimator * self, GstByteReader * reader,
+    const MainHeader * header, Tile * tile)
+{
+  GstFlowReturn ret;
+
+  ret = parse_tile_header (self, reader, header, tile);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  return parse_packets (self, reader, header, tile);
+}
+
+static guint
+sizeof_tile (GstJP2kDecimator * self, const Tile * tile)
+{
+  guint size = sizeof_tile_header (self, tile);
+  GList *l;
+
+  for (l = tile->packets; l; l = l->next) {
+    Packet *p = l->data;
+    size += sizeof_packet (self, p);
+  }
+
+  return size;
+}
+
+static GstFlowReturn
+write_tile (GstJP2kDecimator * self, GstByteWriter * writer,
+    const MainHeader * header, Tile * tile)
+{
+  GList *l;
+  GstFlowReturn ret;
+
+  ret = write_tile_header (self, writer, tile);
+  if (ret != GST_FLOW_OK)
+    goto done;
+
+  for (l = tile->packets; l; l = l->next) {
+    Packet *p = l->data;
+
+    ret = write_packet (self, writer, p);
+    if (ret != GST_FLOW_OK)
+      goto done;
+  }
+
+done:
+
+  return ret;
+}
+
+static GstFlowReturn
+parse_main_header (GstJP2kDecimator * self, GstByteReader * reader,
+    MainHeader * header)
+{
+  GstFlowReturn ret;
+  guint16 marker = 0;
+  gint i;
+
+  ret = parse_main_header_markers (self, reader, header);
+  if (ret != GST_FLOW_OK)
+    goto done;
+
+  header->tiles = g_slice_alloc0 (sizeof (Tile) * header->n_tiles);
+
+  /* now at SOT marker, read the tiles */
+  for (i = 0; i < header->n_tiles; i++) {
+    ret = parse_tile (self, reader, header, &header->tiles[i]);
+    if (ret != GST_FLOW_OK)
+      goto done;
+  }
+
+  /* now there must be the EOC marker */
+  if (!gst_byte_reader_get_uint16_be (reader, &marker)
+      || marker != MARKER_EOC) {
+    GST_ERROR_OBJECT (self, "Frame does not end with EOC");
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+
+done:
+
+  return ret;
+}
+
+static GstFlowReturn
+write_main_header (GstJP2kDecimator * self, GstByteWriter * writer,
+    const MainHeader * header)
+{
+  GstFlowReturn ret;
+  gint i;
+
+  ret = write_main_header_markers (self, writer, header);
+  if (ret != GST_FLOW_OK)
+    goto done;
+
+  for (i = 0; i < header->n_tiles; i++) {
+    ret = write_tile (self, writer, header, &header->tiles[i]);
+    if (ret != GST_FLOW_OK)
+      goto done;
+  }
+
+  if (!gst_byte_writer_ensure_free_space (writer, 2)) {
+    GST_ERROR_OBJECT (self, "Could not ensure free space");
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+  gst_byte_writer_put_uint16_be_unchecked (writer, MARKER_EOC);
+
+done:
+  return ret;
+}
+
+static GstFlowReturn
+decimate_main_header (GstJP2kDecimator * self, MainHeader * header)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  gint i;
+
+  for (i = 0; i < header->n_tiles; i++) {
+    Tile *tile = &header->tiles[i];
+    GList *l;
+    PacketIterator it;
+    PacketLengthTilePart *plt = NULL;
+
+    if (tile->plt) {
+      if (g_list_length (tile->plt) > 1) {
+        GST_ERROR_OBJECT (self, "Multiple PLT per tile not supported yet");
+        ret = GST_FLOW_ERROR;
+        goto done;
+      }
+      plt = g_slice_new (PacketLengthTilePart);
+      plt->index = 0;
+      plt->packet_lengths = g_array_new (FALSE, FALSE, sizeof (guint32));
+    }
+
+    init_packet_iterator (self, &it, header, tile);
+
+    l = tile->packets;
+    while ((it.next (&it))) {
+      Packet *p;
+
+      if (l == NULL) {
+        GST_ERROR_OBJECT (self, "Not enough packets");
+        ret = GST_FLOW_ERROR;
+        if (plt) {
+          g_array_free (plt->packet_lengths, TRUE);
+          g_slice_free (PacketLengthTilePart, plt);
+        }
+        goto done;
+      }
+
+      p = l->data;
+
+      if (!keep_packet (self, &it)) {
+        p->data = NULL;
+        p->length = 1;
+      }
+
+      if (plt) {
+        guint32 len = sizeof_packet (self, p);
+        g_array_append_val (plt->packet_lengths, len);
+      }
+
+      l = l->next;
+    }
+
+    if (plt) {
+      reset_plt (self, tile->plt->data);
+      g_slice_free (PacketLengthTilePart, tile->plt->data);
+      tile->plt->data = plt;
+    }
+
+    tile->sot.tile_part_size = sizeof_tile (self, tile);
+  }
+
+done:
+  return ret;
+}
+
+/* Returns the decimated codestream, or NULL if it can't be decimated */
+static GstBuffer *
+decimate_tree (GstJP2kDecimator * self, GstBuffer * inbuf)
+{
+  GstBuffer *outbuf = NULL;
+  GstByteReader reader;
+  GstByteWriter writer;
+  MainHeader header;
+  GstMapInfo info;
+
+  gst_buffer_map (inbuf, &info, GST_MAP_READ);
+  gst_byte_reader_init (&reader, info.data, info.size);
+  gst_byte_writer_init_with_size (&writer, info.size, FALSE);
+  memset (&header, 0, sizeof (MainHeader));
+
+  if (parse_main_header (self, &reader, &header) == GST_FLOW_OK &&
+      decimate_main_header (self, &header) == GST_FLOW_OK &&
+      write_main_header (self, &writer, &header) == GST_FLOW_OK)
+    outbuf = gst_byte_writer_reset_and_get_buffer (&writer);
+  else
+    gst_byte_writer_reset (&writer);
+
+  reset_main_header (self, &header);
+  gst_buffer_unmap (inbuf, &info);
+
+  return outbuf;
+}
+
+/* Synthesized codestreams: one tile of a 2048x1080 image with 3
+ * components, 5 decomposition levels, 4 layers and one precinct per
+ * resolution. The packets are delimited by SOP and/or PLT markers. */
+#define FRAME_WIDTH 2048
+#define FRAME_HEIGHT 1080
+#define FRAME_COMPONENTS 3
+#define FRAME_DECOMPOSITIONS 5
+#define FRAME_LAYERS 4
+#define FRAME_PACKETS \
+    (FRAME_LAYERS * (FRAME_DECOMPOSITIONS + 1) * FRAME_COMPONENTS)
+
+typedef struct
+{
+  const gchar *name;
+  ProgressionOrder order;
+  gboolean sop, plt;
+} FrameLayout;
+
+/* Layer, resolution and component of the n-th packet */
+static void
+frame_packet_position (ProgressionOrder order, guint n, guint * l, guint * r,
+    guint * c)
+{
+  const guint nl = FRAME_LAYERS, nr = FRAME_DECOMPOSITIONS + 1;
+  const guint nc = FRAME_COMPONENTS;
+
+  switch (order) {
+    case PROGRESSION_ORDER_LRCP:
+      *c = n % nc;
+      *r = (n / nc) % nr;
+      *l = n / nc / nr;
+      break;
+    case PROGRESSION_ORDER_RLCP:
+      *c = n % nc;
+      *l = (n / nc) % nl;
+      *r = n / nc / nl;
+      break;
+    case PROGRESSION_ORDER_RPCL:
+      *l = n % nl;
+      *c = (n / nl) % nc;
+      *r = n / nl / nc;
+      break;
+    default:
+      *l = n % nl;
+      *r = (n / nl) % nr;
+      *c = n / nl / nr;
+      break;
+  }
+}
+
+static void
+frame_put_plt_length (GstByteWriter * writer, guint32 len)
+{
+  gint shift;
+
+  for (shift = 28; shift > 0 && (len >> shift) == 0; shift -= 7);
+  for (; shift > 0; shift -= 7)
+    gst_byte_writer_put_uint8 (writer, 0x80 | ((len >> shift) & 0x7f));
+  gst_byte_writer_put_uint8 (writer, len & 0x7f);
+}
+
+/* Returns a codestream of about @frame_size bytes, each resolution has about
+ * 4 times the data of the previous one */
+static GstBuffer *
+create_frame (const FrameLayout * layout, guint frame_size)
+{
+  GstByteWriter writer;
+  guint32 lengths[FRAME_PACKETS];
+  guint weights = 0, sot_pos, size;
+  guint8 *data;
+  guint i, j;
+
+  for (i = 0; i <= FRAME_DECOMPOSITIONS; i++)
+    weights += (1 << (2 * i)) * FRAME_LAYERS * FRAME_COMPONENTS;
+
+  for (i = 0; i < FRAME_PACKETS; i++) {
+    guint l, r, c;
+
+    frame_packet_position (layout->order, i, &l, &r, &c);
+    lengths[i] = MAX ((guint64) frame_size * (1 << (2 * r)) / weights, 16);
+  }
+
+  gst_byte_writer_init_with_size (&writer, frame_size + 4096, FALSE);
+
+  gst_byte_writer_put_uint16_be (&writer, MARKER_SOC);
+
+  /* SIZ */
+  gst_byte_writer_put_uint16_be (&writer, MARKER_SIZ);
+  gst_byte_writer_put_uint16_be (&writer, 38 + 3 * FRAME_COMPONENTS);
+  gst_byte_writer_put_uint16_be (&writer, 0);
+  gst_byte_writer_put_uint32_be (&writer, FRAME_WIDTH);
+  gst_byte_writer_put_uint32_be (&writer, FRAME_HEIGHT);
+  gst_byte_writer_put_uint32_be (&writer, 0);
+  gst_byte_writer_put_uint32_be (&writer, 0);
+  gst_byte_writer_put_uint32_be (&writer, FRAME_WIDTH);
+  gst_byte_writer_put_uint32_be (&writer, FRAME_HEIGHT);
+  gst_byte_writer_put_uint32_be (&writer, 0);
+  gst_byte_writer_put_uint32_be (&writer, 0);
+  gst_byte_writer_put_uint16_be (&writer, FRAME_COMPONENTS);
+  for (i = 0; i < FRAME_COMPONENTS; i++) {
+    gst_byte_writer_put_uint8 (&writer, 11);
+    gst_byte_writer_put_uint8 (&writer, 1);
+    gst_byte_writer_put_uint8 (&writer, 1);
+  }
+
+  /* COD */
+  gst_byte_writer_put_uint16_be (&writer, MARKER_COD);
+  gst_byte_writer_put_uint16_be (&writer, 12);
+  gst_byte_writer_put_uint8 (&writer, layout->sop ? 0x02 : 0x00);
+  gst_byte_writer_put_uint8 (&writer, layout->order);
+  gst_byte_writer_put_uint16_be (&writer, FRAME_LAYERS);
+  gst_byte_writer_put_uint8 (&writer, 1);
+  gst_byte_writer_put_uint8 (&writer, FRAME_DECOMPOSITIONS);
+  gst_byte_writer_put_uint8 (&writer, 3);
+  gst_byte_writer_put_uint8 (&writer, 3);
+  gst_byte_writer_put_uint8 (&writer, 0);
+  gst_byte_writer_put_uint8 (&writer, 0);
+
+  /* QCD, the values don't matter here */
+  gst_byte_writer_put_uint16_be (&writer, MARKER_QCD);
+  gst_byte_writer_put_uint16_be (&writer,
+      3 + 2 * (3 * FRAME_DECOMPOSITIONS + 1));
+  gst_byte_writer_put_uint8 (&writer, 0x42);
+  for (i = 0; i < 3 * FRAME_DECOMPOSITIONS + 1; i++)
+    gst_byte_writer_put_uint16_be (&writer, 0x4000 + i);
+
+  /* SOT, the tile part size is set at the end */
+  sot_pos = gst_byte_writer_get_pos (&writer);
+  gst_byte_writer_put_uint16_be (&writer, MARKER_SOT);
+  gst_byte_writer_put_uint16_be (&writer, 10);
+  gst_byte_writer_put_uint16_be (&writer, 0);
+  gst_byte_writer_put_uint32_be (&writer, 0);
+  gst_byte_writer_put_uint8 (&writer, 0);
+  gst_byte_writer_put_uint8 (&writer, 1);
+
+  if (layout->plt) {
+    guint plt_pos;
+
+    plt_pos = gst_byte_writer_get_pos (&writer);
+    gst_byte_writer_put_uint16_be (&writer, MARKER_PLT);
+    gst_byte_writer_put_uint16_be (&writer, 0);
+    gst_byte_writer_put_uint8 (&writer, 0);
+    for (i = 0; i < FRAME_PACKETS; i++)
+      frame_put_plt_length (&writer, lengths[i] + (layout->sop ? 6 : 0));
+    size = gst_byte_writer_get_pos (&writer);
+    gst_byte_writer_set_pos (&writer, plt_pos + 2);
+    gst_byte_writer_put_uint16_be (&writer, size - plt_pos - 2);
+    gst_byte_writer_set_pos (&writer, size);
+  }
+
+  gst_byte_writer_put_uint16_be (&writer, MARKER_SOD);
+
+  /* the packet data must not contain anything that looks like a marker */
+  for (i = 0; i < FRAME_PACKETS; i++) {
+    if (layout->sop) {
+      gst_byte_writer_put_uint16_be (&writer, MARKER_SOP);
+      gst_byte_writer_put_uint16_be (&writer, 4);
+      gst_byte_writer_put_uint16_be (&writer, i);
+    }
+    gst_byte_writer_ensure_free_space (&writer, lengths[i]);
+    for (j = 0; j < lengths[i]; j++)
+      gst_byte_writer_put_uint8_unchecked (&writer,
+          g_random_int_range (0, 0xff));
+  }
+
+  size = gst_byte_writer_get_pos (&writer);
+  gst_byte_writer_set_pos (&writer, sot_pos + 6);
+  gst_byte_writer_put_uint32_be (&writer, size - sot_pos);
+  gst_byte_writer_set_pos (&writer, size);
+
+  gst_byte_writer_put_uint16_be (&writer, MARKER_EOC);
+
+  size = gst_byte_writer_get_size (&writer);
+  data = gst_byte_writer_reset_and_get_data (&writer);
+
+  return gst_buffer_new_wrapped (data, size);
+}
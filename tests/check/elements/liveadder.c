@@ -0,0 +1,555 @@
+/* GStreamer
+ *
+ * unit test for liveadder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gsttestclock.h>
+#include <gst/audio/audio.h>
+
+#define RATE 8000
+
+/* 80 samples per buffer, the liveadder mixes periods of the duration of the
+ * first buffer it receives */
+#define N_SAMPLES 80
+#define PERIOD (N_SAMPLES * GST_SECOND / RATE)
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("audio/x-raw"));
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("audio/x-raw"));
+
+static GstElement *adder;
+static GstClock *test_clock;
+static GstPad *mysrcpads[2];
+static GstPad *mysinkpad;
+
+/* protected by check_mutex */
+static gint n_eos;
+static gint n_flush_start;
+static gint n_flush_stop;
+static gint n_seeks;
+
+static gboolean
+sink_event_func (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  g_mutex_lock (&check_mutex);
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_EOS:
+      n_eos++;
+      break;
+    case GST_EVENT_FLUSH_START:
+      n_flush_start++;
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      n_flush_stop++;
+      break;
+    default:
+      break;
+  }
+  g_cond_signal (&check_cond);
+  g_mutex_unlock (&check_mutex);
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static gboolean
+src_event_func (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  if (GST_EVENT_TYPE (event) == GST_EVENT_SEEK) {
+    g_mutex_lock (&check_mutex);
+    n_seeks++;
+    g_mutex_unlock (&check_mutex);
+  }
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static void
+push_segment (GstPad * pad)
+{
+  GstSegment segment;
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_pad_push_event (pad, gst_event_new_segment (&segment)));
+}
+
+/* sets up the liveadder with two linked sink pads in PLAYING with a test
+ * clock that is never advanced, so that the periods are only mixed once all
+ * the pads that are not EOS have data for them */
+static void
+setup_liveadder (const gchar * format)
+{
+  GstCaps *caps;
+  gint i;
+
+  n_eos = n_flush_start = n_flush_stop = n_seeks = 0;
+
+  adder = gst_check_setup_element ("liveadder");
+
+  for (i = 0; i < 2; i++) {
+    GstPad *sinkpad;
+    gchar *name;
+
+    name = g_strdup_printf ("src%d", i);
+    mysrcpads[i] = gst_pad_new_from_static_template (&srctemplate, name);
+    g_free (name);
+    gst_pad_set_event_function (mysrcpads[i], src_event_func);
+    gst_pad_set_active (mysrcpads[i], TRUE);
+
+    sinkpad = gst_element_get_request_pad (adder, "sink_%u");
+    fail_unless (sinkpad != NULL);
+    fail_unless (gst_pad_link (mysrcpads[i], sinkpad) == GST_PAD_LINK_OK);
+    gst_object_unref (sinkpad);
+  }
+
+  mysinkpad = gst_check_setup_sink_pad (adder, &sinktemplate);
+  gst_pad_set_event_function (mysinkpad, sink_event_func);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  test_clock = gst_test_clock_new ();
+  gst_element_set_clock (adder, test_clock);
+  fail_unless (gst_element_set_state (adder,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+
+  caps = gst_caps_new_simple ("audio/x-raw",
+      "format", G_TYPE_STRING, format,
+      "rate", G_TYPE_INT, RATE,
+      "channels", G_TYPE_INT, 1,
+      "layout", G_TYPE_STRING, "interleaved", NULL);
+
+  for (i = 0; i < 2; i++) {
+    gchar *stream_id;
+
+    stream_id = g_strdup_printf ("liveadder-test-%d", i);
+    fail_unless (gst_pad_push_event (mysrcpads[i],
+            gst_event_new_stream_start (stream_id)));
+    g_free (stream_id);
+  }
+
+  /* the caps received on one sink pad are also set on the other ones, so
+   * they all have to be linked and started first */
+  for (i = 0; i < 2; i++) {
+    fail_unless (gst_pad_push_event (mysrcpads[i],
+            gst_event_new_caps (caps)));
+    push_segment (mysrcpads[i]);
+  }
+  gst_caps_unref (caps);
+}
+
+static void
+cleanup_liveadder (void)
+{
+  gint i;
+
+  fail_unless (gst_element_set_state (adder,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+
+  for (i = 0; i < 2; i++) {
+    GstPad *sinkpad = gst_pad_get_peer (mysrcpads[i]);
+
+    gst_element_release_request_pad (adder, sinkpad);
+    gst_object_unref (sinkpad);
+    gst_pad_set_active (mysrcpads[i], FALSE);
+    gst_object_unref (mysrcpads[i]);
+    mysrcpads[i] = NULL;
+  }
+
+  gst_check_drop_buffers ();
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_sink_pad (adder);
+  gst_check_teardown_element (adder);
+  adder = NULL;
+
+  gst_object_unref (test_clock);
+  test_clock = NULL;
+}
+
+static GstBuffer *
+new_buffer (gconstpointer data, gsize size, gint bpf, GstClockTime timestamp)
+{
+  GstBuffer *buffer;
+
+  buffer = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_fill (buffer, 0, data, size);
+  GST_BUFFER_TIMESTAMP (buffer) = timestamp;
+  GST_BUFFER_DURATION (buffer) =
+      gst_util_uint64_scale_int (size / bpf, GST_SECOND, RATE);
+
+  return buffer;
+}
+
+/* a buffer of N_SAMPLES S16 samples of @value */
+static GstBuffer *
+new_s16_buffer (gint16 value, GstClockTime timestamp)
+{
+  gint16 data[N_SAMPLES];
+  gint i;
+
+  for (i = 0; i < N_SAMPLES; i++)
+    data[i] = value;
+
+  return new_buffer (data, sizeof (data), sizeof (gint16), timestamp);
+}
+
+static void
+push_s16 (gint pad, gint16 value, GstClockTime timestamp)
+{
+  fail_unless_equals_int (gst_pad_push (mysrcpads[pad],
+          new_s16_buffer (value, timestamp)), GST_FLOW_OK);
+}
+
+static void
+wait_for_buffers (guint n_buffers)
+{
+  g_mutex_lock (&check_mutex);
+  while (g_list_length (buffers) < n_buffers)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+}
+
+static void
+wait_for_eos (void)
+{
+  g_mutex_lock (&check_mutex);
+  while (n_eos == 0)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+}
+
+static void
+check_buffer (GstBuffer * buffer, GstClockTime timestamp,
+    gconstpointer expected, gsize size)
+{
+  fail_unless_equals_uint64 (GST_BUFFER_TIMESTAMP (buffer), timestamp);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), size);
+  fail_unless (gst_buffer_memcmp (buffer, 0, expected, size) == 0);
+}
+
+static void
+check_s16_buffer (GstBuffer * buffer, GstClockTime timestamp, gint16 value)
+{
+  gint16 data[N_SAMPLES];
+  gint i;
+
+  for (i = 0; i < N_SAMPLES; i++)
+    data[i] = value;
+
+  fail_unless_equals_uint64 (GST_BUFFER_DURATION (buffer), PERIOD);
+  check_buffer (buffer, timestamp, data, sizeof (data));
+}
+
+/* returns the @field of the "pad-stats" of the sink pad @mysrcpad is linked
+ * to */
+static guint64
+get_pad_stat (GstPad * mysrcpad, const gchar * field)
+{
+  GstStructure *stats;
+  const GstStructure *pad_stats;
+  GstPad *sinkpad;
+  guint64 value = G_MAXUINT64;
+
+  g_object_get (adder, "stats", &stats, NULL);
+  fail_unless (stats != NULL);
+
+  sinkpad = gst_pad_get_peer (mysrcpad);
+  pad_stats = gst_value_get_structure (gst_structure_get_value (stats,
+          GST_PAD_NAME (sinkpad)));
+  gst_object_unref (sinkpad);
+  fail_unless (pad_stats != NULL);
+  fail_unless (gst_structure_get_uint64 (pad_stats, field, &value));
+  gst_structure_free (stats);
+
+  return value;
+}
+
+GST_START_TEST (test_mix_s16)
+{
+  const gint16 in0[] = { 1000, -1000, 30000, -30000 };
+  const gint16 in1[] = { 2000, 500, 10000, -10000 };
+  const gint16 out[] = { 3000, -500, G_MAXINT16, G_MININT16 };
+
+  setup_liveadder (GST_AUDIO_NE (S16));
+
+  fail_unless_equals_int (gst_pad_push (mysrcpads[0],
+          new_buffer (in0, sizeof (in0), sizeof (gint16), 0)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_pad_push (mysrcpads[1],
+          new_buffer (in1, sizeof (in1), sizeof (gint16), 0)), GST_FLOW_OK);
+
+  wait_for_buffers (1);
+  check_buffer (buffers->data, 0, out, sizeof (out));
+
+  cleanup_liveadder ();
+}
+
+GST_END_TEST;
+
+/* silence is in the middle of the range for unsigned formats */
+GST_START_TEST (test_mix_u8)
+{
+  const guint8 in0[] = { 0x80 + 10, 0x80 - 10, 250, 5 };
+  const guint8 in1[] = { 0x80 + 20, 0x80 + 5, 250, 5 };
+  const guint8 out[] = { 0x80 + 30, 0x80 - 5, G_MAXUINT8, 0 };
+
+  setup_liveadder ("U8");
+
+  fail_unless_equals_int (gst_pad_push (mysrcpads[0],
+          new_buffer (in0, sizeof (in0), sizeof (guint8), 0)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_pad_push (mysrcpads[1],
+          new_buffer (in1, sizeof (in1), sizeof (guint8), 0)), GST_FLOW_OK);
+
+  wait_for_buffers (1);
+  check_buffer (buffers->data, 0, out, sizeof (out));
+
+  cleanup_liveadder ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mix_u16)
+{
+  const guint16 in0[] = { 0x8000 + 1000, 0x8000 - 1000, 60000, 1000 };
+  const guint16 in1[] = { 0x8000 + 2000, 0x8000 + 500, 60000, 1000 };
+  const guint16 out[] = { 0x8000 + 3000, 0x8000 - 500, G_MAXUINT16, 0 };
+
+  setup_liveadder (GST_AUDIO_NE (U16));
+
+  fail_unless_equals_int (gst_pad_push (mysrcpads[0],
+          new_buffer (in0, sizeof (in0), sizeof (guint16), 0)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_pad_push (mysrcpads[1],
+          new_buffer (in1, sizeof (in1), sizeof (guint16), 0)), GST_FLOW_OK);
+
+  wait_for_buffers (1);
+  check_buffer (buffers->data, 0, out, sizeof (out));
+
+  cleanup_liveadder ();
+}
+
+GST_END_TEST;
+
+/* a buffer that ends before the next period is dropped instead of mixed */
+GST_START_TEST (test_drop_late_buffer)
+{
+  GstBuffer *late;
+
+  setup_liveadder (GST_AUDIO_NE (S16));
+
+  push_s16 (0, 100, 0);
+  push_s16 (1, 200, 0);
+  wait_for_buffers (1);
+
+  /* the period at 0 was mixed already */
+  late = new_s16_buffer (1000, 0);
+  GST_BUFFER_FLAG_SET (late, GST_BUFFER_FLAG_DISCONT);
+  fail_unless_equals_int (gst_pad_push (mysrcpads[0], late), GST_FLOW_OK);
+
+  push_s16 (0, 100, PERIOD);
+  push_s16 (1, 200, PERIOD);
+  wait_for_buffers (2);
+
+  check_s16_buffer (buffers->data, 0, 300);
+  check_s16_buffer (g_list_nth_data (buffers, 1), PERIOD, 300);
+
+  fail_unless_equals_uint64 (get_pad_stat (mysrcpads[0], "dropped"), 1);
+  fail_unless_equals_uint64 (get_pad_stat (mysrcpads[1], "dropped"), 0);
+
+  cleanup_liveadder ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_eos)
+{
+  setup_liveadder (GST_AUDIO_NE (S16));
+
+  push_s16 (0, 100, 0);
+  push_s16 (1, 200, 0);
+  wait_for_buffers (1);
+
+  /* the EOS pad is not waited for anymore, the other one is mixed alone */
+  fail_unless (gst_pad_push_event (mysrcpads[1], gst_event_new_eos ()));
+  push_s16 (0, 100, PERIOD);
+  wait_for_buffers (2);
+  check_s16_buffer (g_list_nth_data (buffers, 1), PERIOD, 100);
+
+  fail_unless_equals_int (gst_pad_push (mysrcpads[1],
+          new_s16_buffer (200, 2 * PERIOD)), GST_FLOW_EOS);
+
+  g_mutex_lock (&check_mutex);
+  fail_unless_equals_int (n_eos, 0);
+  g_mutex_unlock (&check_mutex);
+
+  /* EOS goes downstream once all the pads are EOS */
+  fail_unless (gst_pad_push_event (mysrcpads[0], gst_event_new_eos ()));
+  wait_for_eos ();
+  fail_unless_equals_int (g_list_length (buffers), 2);
+
+  cleanup_liveadder ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_flushing_seek)
+{
+  gint i;
+
+  setup_liveadder (GST_AUDIO_NE (S16));
+
+  push_s16 (0, 100, 0);
+  push_s16 (1, 200, 0);
+  push_s16 (0, 100, PERIOD);
+  push_s16 (1, 200, PERIOD);
+  wait_for_buffers (2);
+
+  /* the seek goes to all the sink pads */
+  fail_unless (gst_pad_push_event (mysinkpad,
+          gst_event_new_seek (1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
+              GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_NONE, -1)));
+  g_mutex_lock (&check_mutex);
+  fail_unless_equals_int (n_seeks, 2);
+  g_mutex_unlock (&check_mutex);
+
+  /* and upstream flushes as a reaction */
+  for (i = 0; i < 2; i++)
+    fail_unless (gst_pad_push_event (mysrcpads[i],
+            gst_event_new_flush_start ()));
+  for (i = 0; i < 2; i++)
+    fail_unless (gst_pad_push_event (mysrcpads[i],
+            gst_event_new_flush_stop (TRUE)));
+
+  g_mutex_lock (&check_mutex);
+  fail_unless (n_flush_start > 0);
+  fail_unless (n_flush_stop > 0);
+  g_mutex_unlock (&check_mutex);
+
+  gst_check_drop_buffers ();
+
+  /* data from before the last mixed period is not late after a flush */
+  for (i = 0; i < 2; i++)
+    push_segment (mysrcpads[i]);
+  push_s16 (0, 300, 0);
+  push_s16 (1, 400, 0);
+  wait_for_buffers (1);
+  check_s16_buffer (buffers->data, 0, 700);
+
+  cleanup_liveadder ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_stats)
+{
+  GstStructure *stats;
+  const GValue *value;
+  GstClockID id, processed;
+  gint i;
+
+  setup_liveadder (GST_AUDIO_NE (S16));
+
+  g_object_get (adder, "stats", &stats, NULL);
+  fail_unless (gst_structure_has_name (stats,
+          "application/x-liveadder-stats"));
+  fail_unless_equals_int (gst_structure_n_fields (stats), 2);
+  for (i = 0; i < 2; i++) {
+    GstPad *sinkpad = gst_pad_get_peer (mysrcpads[i]);
+    const GstStructure *pad_stats;
+
+    value = gst_structure_get_value (stats, GST_PAD_NAME (sinkpad));
+    gst_object_unref (sinkpad);
+    fail_unless (value != NULL);
+    fail_unless (G_VALUE_HOLDS (value, GST_TYPE_STRUCTURE));
+    pad_stats = gst_value_get_structure (value);
+    fail_unless (gst_structure_has_name (pad_stats, "pad-stats"));
+    fail_unless (gst_structure_has_field_typed (pad_stats, "completed",
+            G_TYPE_UINT64));
+    fail_unless (gst_structure_has_field_typed (pad_stats, "missed",
+            G_TYPE_UINT64));
+    fail_unless (gst_structure_has_field_typed (pad_stats, "dropped",
+            G_TYPE_UINT64));
+    fail_unless (gst_structure_has_field_typed (pad_stats,
+            "average-lateness", G_TYPE_UINT64));
+    fail_unless (gst_structure_has_field_typed (pad_stats, "max-lateness",
+            G_TYPE_UINT64));
+  }
+  gst_structure_free (stats);
+
+  /* both pads complete the first period */
+  push_s16 (0, 100, 0);
+  push_s16 (1, 200, 0);
+  wait_for_buffers (1);
+
+  /* only the first pad has data for the second one, it is mixed once the
+   * latency expired */
+  push_s16 (0, 100, PERIOD);
+  gst_test_clock_wait_for_next_pending_id (GST_TEST_CLOCK (test_clock), &id);
+  gst_test_clock_set_time (GST_TEST_CLOCK (test_clock),
+      gst_clock_id_get_time (id));
+  processed =
+      gst_test_clock_process_next_clock_id (GST_TEST_CLOCK (test_clock));
+  fail_unless (processed == id);
+  gst_clock_id_unref (processed);
+  gst_clock_id_unref (id);
+
+  wait_for_buffers (2);
+  check_s16_buffer (g_list_nth_data (buffers, 1), PERIOD, 100);
+
+  fail_unless_equals_uint64 (get_pad_stat (mysrcpads[0], "completed"), 2);
+  fail_unless_equals_uint64 (get_pad_stat (mysrcpads[0], "missed"), 0);
+  fail_unless_equals_uint64 (get_pad_stat (mysrcpads[1], "completed"), 1);
+  fail_unless_equals_uint64 (get_pad_stat (mysrcpads[1], "missed"), 1);
+  fail_unless_equals_uint64 (get_pad_stat (mysrcpads[1], "dropped"), 0);
+  fail_unless (get_pad_stat (mysrcpads[0], "max-lateness") >=
+      get_pad_stat (mysrcpads[0], "average-lateness"));
+
+  cleanup_liveadder ();
+}
+
+GST_END_TEST;
+
+static Suite *
+liveadder_suite (void)
+{
+  Suite *s = suite_create ("liveadder");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_mix_s16);
+  tcase_add_test (tc_chain, test_mix_u8);
+  tcase_add_test (tc_chain, test_mix_u16);
+  tcase_add_test (tc_chain, test_drop_late_buffer);
+  tcase_add_test (tc_chain, test_eos);
+  tcase_add_test (tc_chain, test_flushing_seek);
+  tcase_add_test (tc_chain, test_stats);
+
+  return s;
+}
+
+GST_CHECK_MAIN (liveadder);
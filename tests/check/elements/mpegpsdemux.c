@@ -0,0 +1,305 @@
+/* GStreamer
+ *
+ * unit test for mpegpsdemux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+/* 10 seconds of 25 fps video, one frame per pack, a GOP every second */
+#define N_FRAMES 250
+#define GOP_SIZE 25
+#define SCR_PER_FRAME (90000 / 25)
+#define PTS_DELAY 9000
+#define PAYLOAD_SIZE 2000
+
+/* the frame that starts at 5.5s, and the keyframe of its GOP */
+#define SEEK_TIME (5500 * GST_MSECOND)
+#define SEEK_FRAME 137
+#define SEEK_KEYFRAME 125
+
+typedef struct
+{
+  GThread *test_thread;
+  /* pull_range calls done from the thread that seeks */
+  guint seek_pulls;
+  /* frame index of the first buffer after a reset, or -1 */
+  gint first_frame;
+} SeekData;
+
+static guint8 *
+write_pack_header (guint8 * p, guint64 scr)
+{
+  /* mux rate in units of 50 bytes/s */
+  const guint mux_rate = (PAYLOAD_SIZE + 36) * 25 / 50;
+
+  p[0] = 0x00;
+  p[1] = 0x00;
+  p[2] = 0x01;
+  p[3] = 0xba;
+  p[4] = 0x44 | ((scr >> 27) & 0x38) | ((scr >> 28) & 0x03);
+  p[5] = (scr >> 20) & 0xff;
+  p[6] = ((scr >> 12) & 0xf8) | 0x04 | ((scr >> 13) & 0x03);
+  p[7] = (scr >> 5) & 0xff;
+  p[8] = ((scr << 3) & 0xf8) | 0x04;
+  p[9] = 0x01;
+  p[10] = (mux_rate >> 14) & 0xff;
+  p[11] = (mux_rate >> 6) & 0xff;
+  p[12] = ((mux_rate << 2) & 0xfc) | 0x03;
+  p[13] = 0xf8;
+
+  return p + 14;
+}
+
+/* A video PES packet whose payload starts with a sequence header for
+ * keyframes and a picture start code otherwise, followed by the frame
+ * index */
+static guint8 *
+write_pes_packet (guint8 * p, guint64 pts, guint index, gboolean keyframe)
+{
+  guint length = 3 + 5 + PAYLOAD_SIZE;
+
+  p[0] = 0x00;
+  p[1] = 0x00;
+  p[2] = 0x01;
+  p[3] = 0xe0;
+  GST_WRITE_UINT16_BE (p + 4, length);
+  p[6] = 0x80;
+  p[7] = 0x80;
+  p[8] = 5;
+  p[9] = 0x21 | ((pts >> 29) & 0x0e);
+  p[10] = (pts >> 22) & 0xff;
+  p[11] = ((pts >> 14) & 0xfe) | 0x01;
+  p[12] = (pts >> 7) & 0xff;
+  p[13] = ((pts << 1) & 0xfe) | 0x01;
+  p += 14;
+
+  memset (p, 0xff, PAYLOAD_SIZE);
+  p[0] = 0x00;
+  p[1] = 0x00;
+  p[2] = 0x01;
+  p[3] = keyframe ? 0xb3 : 0x00;
+  GST_WRITE_UINT32_BE (p + 4, index);
+
+  return p + PAYLOAD_SIZE;
+}
+
+static gchar *
+create_file (void)
+{
+  guint8 *data, *p;
+  gchar *filename;
+  gsize size;
+  gint fd;
+  guint i;
+
+  fd = g_file_open_tmp ("mpegpsdemux-XXXXXX", &filename, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+
+  size = N_FRAMES * (14 + 14 + PAYLOAD_SIZE);
+  p = data = g_malloc (size);
+  for (i = 0; i < N_FRAMES; i++) {
+    p = write_pack_header (p, i * SCR_PER_FRAME);
+    p = write_pes_packet (p, i * SCR_PER_FRAME + PTS_DELAY, i,
+        i % GOP_SIZE == 0);
+  }
+  fail_unless_equals_int (p - data, size);
+
+  fail_unless (g_file_set_contents (filename, (gchar *) data, size, NULL));
+  g_free (data);
+
+  return filename;
+}
+
+static GstPadProbeReturn
+pull_probe (GstPad * pad, GstPadProbeInfo * info, SeekData * data)
+{
+  if (GST_PAD_PROBE_INFO_BUFFER (info)
+      && g_thread_self () == data->test_thread)
+    data->seek_pulls++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad, SeekData * data)
+{
+  GstMapInfo map;
+
+  if (data->first_frame >= 0)
+    return;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  if (map.size >= 8 && map.data[0] == 0 && map.data[1] == 0 &&
+      map.data[2] == 1)
+    data->first_frame = GST_READ_UINT32_BE (map.data + 4);
+  gst_buffer_unmap (buffer, &map);
+}
+
+static void
+pad_added (GstElement * demux, GstPad * pad, GstElement * sink)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (sink, "sink");
+
+  fail_unless_equals_int (gst_pad_link (pad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+}
+
+static GstElement *
+create_pipeline (const gchar * filename, SeekData * data)
+{
+  GstElement *pipeline, *src, *demux, *sink;
+  GstPad *pad;
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  demux = gst_element_factory_make ("mpegpsdemux", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (src && demux && sink);
+
+  g_object_set (src, "location", filename, NULL);
+  g_object_set (sink, "signal-handoffs", TRUE, "sync", FALSE, NULL);
+  gst_bin_add_many (GST_BIN (pipeline), src, demux, sink, NULL);
+  fail_unless (gst_element_link (src, demux));
+  g_signal_connect (demux, "pad-added", G_CALLBACK (pad_added), sink);
+  g_signal_connect (sink, "preroll-handoff", G_CALLBACK (handoff), data);
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff), data);
+
+  data->test_thread = g_thread_self ();
+  data->seek_pulls = 0;
+  data->first_frame = -1;
+  pad = gst_element_get_static_pad (demux, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_PULL | GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) pull_probe, data, NULL);
+  gst_object_unref (pad);
+
+  return pipeline;
+}
+
+static void
+wait_for_eos (GstElement * pipeline)
+{
+  GstMessage *msg;
+  GstBus *bus;
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+}
+
+/* Seeks to SEEK_TIME and returns the number of pulls the seek needed */
+static guint
+do_seek (GstElement * pipeline, SeekData * data, GstSeekFlags flags)
+{
+  data->seek_pulls = 0;
+  data->first_frame = -1;
+
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | flags, SEEK_TIME));
+
+  return data->seek_pulls;
+}
+
+static void
+cleanup (GstElement * pipeline, gchar * filename)
+{
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+  g_unlink (filename);
+  g_free (filename);
+}
+
+GST_START_TEST (test_seek_unindexed)
+{
+  GstElement *pipeline;
+  SeekData data;
+  gchar *filename;
+
+  filename = create_file ();
+  pipeline = create_pipeline (filename, &data);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PAUSED),
+      GST_STATE_CHANGE_ASYNC);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+  fail_unless_equals_int (data.first_frame, 0);
+
+  /* only the first packs were parsed, so the demuxer has to search the file,
+   * and can't know about any keyframe before the target */
+  fail_unless (do_seek (pipeline, &data, GST_SEEK_FLAG_KEY_UNIT) > 0);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+  fail_unless_equals_int (data.first_frame, SEEK_FRAME);
+
+  cleanup (pipeline, filename);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_seek_indexed)
+{
+  GstElement *pipeline;
+  SeekData data;
+  gchar *filename;
+
+  filename = create_file ();
+  pipeline = create_pipeline (filename, &data);
+
+  /* play the whole file once to index it */
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  wait_for_eos (pipeline);
+  fail_unless_equals_int (data.first_frame, 0);
+
+  /* the index answers the seek without reading the file */
+  fail_unless_equals_int (do_seek (pipeline, &data, GST_SEEK_FLAG_ACCURATE),
+      0);
+  wait_for_eos (pipeline);
+  fail_unless_equals_int (data.first_frame, SEEK_FRAME);
+
+  /* and knows where the GOP of the target starts */
+  fail_unless_equals_int (do_seek (pipeline, &data, GST_SEEK_FLAG_KEY_UNIT),
+      0);
+  wait_for_eos (pipeline);
+  fail_unless_equals_int (data.first_frame, SEEK_KEYFRAME);
+
+  cleanup (pipeline, filename);
+}
+
+GST_END_TEST;
+
+static Suite *
+mpegpsdemux_suite (void)
+{
+  Suite *s = suite_create ("mpegpsdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_seek_unindexed);
+  tcase_add_test (tc_chain, test_seek_indexed);
+
+  return s;
+}
+
+GST_CHECK_MAIN (mpegpsdemux);
@@ -28,6 +28,7 @@ static GstPad *mysrcpad, *mysinkpad;
 static GMainLoop *loop = NULL;
 static gboolean have_eos = FALSE;
 static gboolean have_data = FALSE;
+static GstStructure *mxf_structure = NULL;
 
 static GstStaticPadTemplate mysrctemplate =
 GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
@@ -102,6 +103,20 @@ _sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       _sink_check_caps (pad, caps);
       break;
     }
+    case GST_EVENT_TAG:
+    {
+      GstTagList *tags;
+      const GValue *value;
+
+      gst_event_parse_tag (event, &tags);
+      value = gst_tag_list_get_value_index (tags, "mxf-structure", 0);
+      if (value) {
+        if (mxf_structure)
+          gst_structure_free (mxf_structure);
+        mxf_structure = gst_structure_copy (gst_value_get_structure (value));
+      }
+      break;
+    }
     default:
       break;
   }
@@ -184,18 +199,23 @@ _create_src_pad_pull (void)
   return mysrcpad;
 }
 
-GST_START_TEST (test_pull)
+/* Returns the mxf-structure tag of the file */
+static GstStructure *
+run_pull (gboolean lazy_metadata)
 {
   GstStateChangeReturn sret;
   GstElement *mxfdemux;
   GstPad *sinkpad;
+  GstStructure *structure;
 
   have_eos = FALSE;
   have_data = FALSE;
+  mxf_structure = NULL;
   loop = g_main_loop_new (NULL, FALSE);
 
   mxfdemux = gst_element_factory_make ("mxfdemux", NULL);
   fail_unless (mxfdemux != NULL);
+  g_object_set (mxfdemux, "lazy-metadata", lazy_metadata, NULL);
   g_signal_connect (mxfdemux, "pad-added", G_CALLBACK (_pad_added), NULL);
   sinkpad = gst_element_get_static_pad (mxfdemux, "sink");
   fail_unless (sinkpad != NULL);
@@ -228,22 +248,30 @@ GST_START_TEST (test_pull)
   gst_object_unref (mysrcpad);
   g_main_loop_unref (loop);
   loop = NULL;
-}
 
-GST_END_TEST;
+  fail_unless (mxf_structure != NULL);
+  structure = mxf_structure;
+  mxf_structure = NULL;
 
-GST_START_TEST (test_push)
+  return structure;
+}
+
+static GstStructure *
+run_push (gboolean lazy_metadata)
 {
   GstElement *mxfdemux;
   GstBuffer *buffer;
   GstPad *sinkpad;
   GstCaps *caps;
+  GstStructure *structure;
 
   have_data = FALSE;
   have_eos = FALSE;
+  mxf_structure = NULL;
 
   mxfdemux = gst_element_factory_make ("mxfdemux", NULL);
   fail_unless (mxfdemux != NULL);
+  g_object_set (mxfdemux, "lazy-metadata", lazy_metadata, NULL);
   g_signal_connect (mxfdemux, "pad-added", G_CALLBACK (_pad_added), NULL);
   sinkpad = gst_element_get_static_pad (mxfdemux, "sink");
   fail_unless (sinkpad != NULL);
@@ -283,6 +311,53 @@ GST_START_TEST (test_push)
   gst_object_unref (mxfdemux);
   gst_object_unref (mysinkpad);
   gst_object_unref (mysrcpad);
+
+  fail_unless (mxf_structure != NULL);
+  structure = mxf_structure;
+  mxf_structure = NULL;
+
+  return structure;
+}
+
+GST_START_TEST (test_pull)
+{
+  gst_structure_free (run_pull (FALSE));
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_push)
+{
+  gst_structure_free (run_push (FALSE));
+}
+
+GST_END_TEST;
+
+/* Only the sets reachable from the preface are parsed with lazy-metadata,
+ * all of them are referenced in this file so the metadata must be the same
+ * as when parsing everything */
+GST_START_TEST (test_pull_lazy_metadata)
+{
+  GstStructure *eager, *lazy;
+
+  eager = run_pull (FALSE);
+  lazy = run_pull (TRUE);
+  fail_unless (gst_structure_is_equal (eager, lazy));
+  gst_structure_free (eager);
+  gst_structure_free (lazy);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_push_lazy_metadata)
+{
+  GstStructure *eager, *lazy;
+
+  eager = run_push (FALSE);
+  lazy = run_push (TRUE);
+  fail_unless (gst_structure_is_equal (eager, lazy));
+  gst_structure_free (eager);
+  gst_structure_free (lazy);
 }
 
 GST_END_TEST;
@@ -302,6 +377,8 @@ mxfdemux_suite (void)
   tcase_set_timeout (tc_chain, 180);
   tcase_add_test (tc_chain, test_pull);
   tcase_add_test (tc_chain, test_push);
+  tcase_add_test (tc_chain, test_pull_lazy_metadata);
+  tcase_add_test (tc_chain, test_push_lazy_metadata);
 
   return s;
 }
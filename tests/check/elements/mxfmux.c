@@ -21,6 +21,7 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
 #include <string.h>
 
 static const gchar *
@@ -239,6 +240,243 @@ GST_START_TEST (test_multiple_av_streams)
 
 GST_END_TEST;
 
+static const guint8 index_table_segment_key[] = {
+  0x06, 0x0e, 0x2b, 0x34, 0x02, 0x53, 0x01, 0x01,
+  0x0d, 0x01, 0x02, 0x01, 0x01, 0x10, 0x01, 0x00
+};
+
+static const guint8 essence_container_data_key[] = {
+  0x06, 0x0e, 0x2b, 0x34, 0x02, 0x53, 0x01, 0x01,
+  0x0d, 0x01, 0x01, 0x01, 0x01, 0x01, 0x23, 0x00
+};
+
+/* Returns the local set of the last KLV with @key in @data */
+static const guint8 *
+find_last_set (const guint8 * data, gsize length, const guint8 * key,
+    gsize * set_size)
+{
+  const guint8 *set = NULL;
+  gsize i;
+
+  for (i = 0; i + 17 <= length; i++) {
+    gsize size = 0, n, j;
+
+    if (memcmp (data + i, key, 16) != 0)
+      continue;
+
+    /* BER length */
+    n = 1;
+    if (data[i + 16] & 0x80) {
+      n += data[i + 16] & 0x7f;
+      fail_unless (i + 16 + n <= length);
+      for (j = 1; j < n; j++)
+        size = (size << 8) | data[i + 16 + j];
+    } else {
+      size = data[i + 16];
+    }
+    fail_unless (i + 16 + n + size <= length);
+
+    set = data + i + 16 + n;
+    *set_size = size;
+  }
+
+  return set;
+}
+
+/* Returns the value of the local tag @tag in @set */
+static const guint8 *
+find_tag (const guint8 * set, gsize set_size, guint16 tag, guint * tag_size)
+{
+  gsize offset = 0;
+
+  while (offset + 4 <= set_size) {
+    guint size = GST_READ_UINT16_BE (set + offset + 2);
+
+    fail_unless (offset + 4 + size <= set_size);
+    if (GST_READ_UINT16_BE (set + offset) == tag) {
+      *tag_size = size;
+      return set + offset + 4;
+    }
+    offset += 4 + size;
+  }
+
+  return NULL;
+}
+
+static guint32
+read_uint32_tag (const guint8 * set, gsize set_size, guint16 tag)
+{
+  const guint8 *value;
+  guint size;
+
+  value = find_tag (set, set_size, tag, &size);
+  if (value == NULL)
+    return 0;
+  fail_unless_equals_int (size, 4);
+
+  return GST_READ_UINT32_BE (value);
+}
+
+/* Checks the index table segment of @location and that the metadata of the
+ * footer partition refers to it. Returns the edit unit byte count of a
+ * constant size index and sets the index entries of a variable size one in
+ * @n_entries, the flags of the first one in @first_flags. */
+static guint32
+check_index_table_segment (const gchar * location, guint * n_entries,
+    guint8 * first_flags)
+{
+  gchar *contents;
+  gsize length, set_size;
+  const guint8 *set, *entries;
+  guint32 edit_unit_byte_count;
+  guint size;
+
+  fail_unless (g_file_get_contents (location, &contents, &length, NULL));
+
+  set = find_last_set ((const guint8 *) contents, length,
+      index_table_segment_key, &set_size);
+  fail_unless (set != NULL, "no index table segment");
+
+  /* IndexSID */
+  fail_unless_equals_int (read_uint32_tag (set, set_size, 0x3f06), 2);
+  /* EditUnitByteCount */
+  edit_unit_byte_count = read_uint32_tag (set, set_size, 0x3f05);
+
+  /* IndexEntryArray */
+  *n_entries = 0;
+  entries = find_tag (set, set_size, 0x3f0a, &size);
+  if (entries) {
+    fail_unless (size >= 8);
+    *n_entries = GST_READ_UINT32_BE (entries);
+    fail_unless_equals_int (size, 8 + *n_entries *
+        GST_READ_UINT32_BE (entries + 4));
+    if (*n_entries > 0)
+      *first_flags = entries[8 + 2];
+  }
+
+  /* the essence container data of the footer has the same IndexSID */
+  set = find_last_set ((const guint8 *) contents, length,
+      essence_container_data_key, &set_size);
+  fail_unless (set != NULL, "no essence container data");
+  fail_unless_equals_int (read_uint32_tag (set, set_size, 0x3f06), 2);
+
+  g_free (contents);
+
+  return edit_unit_byte_count;
+}
+
+/* Seeks in @location with mxfdemux, the demuxer should find the edit unit
+ * from the index. Returns the buffer the sink prerolled on. */
+static GstBuffer *
+seek_mxf (const gchar * location, GstSeekFlags flags, GstClockTime position)
+{
+  gchar *pipeline;
+  GstElement *bin, *sink;
+  GstSample *sample = NULL;
+  GstBuffer *buffer;
+
+  pipeline = g_strdup_printf ("filesrc location=%s ! mxfdemux ! "
+      "fakesink name=sink", location);
+  bin = gst_parse_launch (pipeline, NULL);
+  fail_unless (bin != NULL);
+  g_free (pipeline);
+
+  fail_unless (gst_element_set_state (bin,
+          GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE);
+  fail_unless (gst_element_get_state (bin, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+
+  fail_unless (gst_element_seek_simple (bin, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | flags, position));
+  fail_unless (gst_element_get_state (bin, NULL, NULL,
+          GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+
+  sink = gst_bin_get_by_name (GST_BIN (bin), "sink");
+  g_object_get (sink, "last-sample", &sample, NULL);
+  fail_unless (sample != NULL);
+  buffer = gst_buffer_ref (gst_sample_get_buffer (sample));
+  gst_sample_unref (sample);
+  gst_object_unref (sink);
+
+  fail_unless (gst_element_set_state (bin,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (bin);
+
+  return buffer;
+}
+
+GST_START_TEST (test_index_table)
+{
+  gchar *location, *pipeline;
+  GstBuffer *buffer;
+  guint n_entries;
+  guint8 flags;
+
+  location = g_build_filename (g_get_tmp_dir (), "mxfmux-index-test.mxf",
+      NULL);
+
+  pipeline = g_strdup_printf ("videotestsrc num-buffers=100 ! "
+      "video/x-raw,format=(string)v308,width=64,height=48,framerate=25/1 ! "
+      "mxfmux ! filesink location=%s", location);
+  run_test (pipeline);
+  g_free (pipeline);
+
+  /* raw video has edit units of constant size, the KLV of a frame */
+  fail_unless (check_index_table_segment (location, &n_entries,
+          &flags) > 64 * 48 * 3 + 16);
+  fail_unless_equals_int (n_entries, 0);
+
+  buffer = seek_mxf (location, GST_SEEK_FLAG_ACCURATE, 2 * GST_SECOND);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), 2 * GST_SECOND);
+  gst_buffer_unref (buffer);
+
+  g_unlink (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_index_table_vbr)
+{
+  const gchar *mpeg2enc_name = get_mpeg2enc_element_name ();
+  gchar *location, *pipeline;
+  GstBuffer *buffer;
+  GstClockTime ts;
+  guint n_entries = 0;
+  guint8 flags = 0;
+
+  if (!mpeg2enc_name)
+    return;
+
+  location = g_build_filename (g_get_tmp_dir (), "mxfmux-index-vbr-test.mxf",
+      NULL);
+
+  pipeline = g_strdup_printf ("videotestsrc num-buffers=100 ! "
+      "video/x-raw,width=320,height=240,framerate=25/1 ! "
+      "%s ! mxfmux ! filesink location=%s", mpeg2enc_name, location);
+  run_test (pipeline);
+  g_free (pipeline);
+
+  /* one entry per frame, the first one is a keyframe */
+  fail_unless_equals_int (check_index_table_segment (location, &n_entries,
+          &flags), 0);
+  fail_unless_equals_int (n_entries, 100);
+  fail_unless (flags & 0x80);
+
+  /* the demuxer goes back to the keyframe before the position */
+  buffer = seek_mxf (location, GST_SEEK_FLAG_KEY_UNIT, 2 * GST_SECOND);
+  fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT));
+  ts = GST_BUFFER_PTS_IS_VALID (buffer) ? GST_BUFFER_PTS (buffer) :
+      GST_BUFFER_DTS (buffer);
+  fail_unless (ts > 0 && ts <= 2 * GST_SECOND);
+  gst_buffer_unref (buffer);
+
+  g_unlink (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
 static Suite *
 mxfmux_suite (void)
 {
@@ -259,6 +497,8 @@ mxfmux_suite (void)
   tcase_add_test (tc_chain, test_jpeg2000_alaw);
   tcase_add_test (tc_chain, test_dnxhd_mp3);
   tcase_add_test (tc_chain, test_multiple_av_streams);
+  tcase_add_test (tc_chain, test_index_table);
+  tcase_add_test (tc_chain, test_index_table_vbr);
 
   return s;
 }
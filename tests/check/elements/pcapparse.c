@@ -1,5 +1,7 @@
 #include "parser.h"
 #include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
 
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
@@ -27,6 +29,29 @@ static guint8 pcap_frame_with_eth_padding[] = {
   0x00, 0xa0, 0x00, 0x00
 };
 
+static const guint pcap_frame_with_vlan_offset = 16 + 14 + 4 + 20 + 8;
+static guint8 pcap_frame_with_vlan[] = {
+  0x5f, 0x12, 0x4e, 0x54, 0x57, 0x70, 0x00, 0x00, 0x40, 0x00, 0x00, 0x00,
+  0x40, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x29, 0xa6, 0x13, 0x41, 0x00, 0x0c,
+  0x29, 0xb2, 0x93, 0x7d, 0x81, 0x00, 0x00, 0x64, 0x08, 0x00, 0x45, 0x00,
+  0x00, 0x2c, 0x00, 0x00, 0x40, 0x00, 0x32, 0x11, 0x25, 0xb9, 0x52, 0xc5,
+  0x4d, 0xd6, 0xb9, 0x23, 0xc9, 0x49, 0x44, 0x66, 0x9f, 0xf2, 0x00, 0x18,
+  0x75, 0xe8, 0x80, 0xe3, 0x7c, 0xca, 0x79, 0xba, 0x09, 0xc0, 0x70, 0x6e,
+  0x8b, 0x33, 0x05, 0x0a, 0x00, 0xa0, 0x00, 0x00
+};
+
+static const guint pcap_frame_ipv6_offset = 16 + 14 + 40 + 8;
+static guint8 pcap_frame_ipv6[] = {
+  0x5f, 0x12, 0x4e, 0x54, 0x58, 0x70, 0x00, 0x00, 0x4e, 0x00, 0x00, 0x00,
+  0x4e, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x29, 0xa6, 0x13, 0x41, 0x00, 0x0c,
+  0x29, 0xb2, 0x93, 0x7d, 0x86, 0xdd, 0x60, 0x00, 0x00, 0x00, 0x00, 0x18,
+  0x11, 0x40, 0x20, 0x01, 0x0d, 0xb8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x20, 0x01, 0x0d, 0xb8, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x44, 0x66,
+  0x9f, 0xf4, 0x00, 0x18, 0x00, 0x00, 0x80, 0xe3, 0x7c, 0xcb, 0x79, 0xba,
+  0x09, 0xc0, 0x70, 0x6e, 0x8b, 0x33, 0x05, 0x0a, 0x00, 0xa0
+};
+
 static gboolean
 verify_buffer (buffer_verify_data_s * vdata, GstBuffer * buffer)
 {
@@ -37,6 +62,12 @@ verify_buffer (buffer_verify_data_s * vdata, GstBuffer * buffer)
     offset = pcap_frame_with_eth_padding_offset;
     size = sizeof (pcap_frame_with_eth_padding) -
       pcap_frame_with_eth_padding_offset - 2;
+  } else if (vdata->data_to_verify == pcap_frame_with_vlan) {
+    offset = pcap_frame_with_vlan_offset;
+    size = sizeof (pcap_frame_with_vlan) - pcap_frame_with_vlan_offset - 2;
+  } else if (vdata->data_to_verify == pcap_frame_ipv6) {
+    offset = pcap_frame_ipv6_offset;
+    size = sizeof (pcap_frame_ipv6) - pcap_frame_ipv6_offset;
   }
 
   fail_unless_equals_int (gst_buffer_get_size (buffer), size);
@@ -69,6 +100,286 @@ GST_START_TEST (test_parse_frames_with_eth_padding)
 }
 GST_END_TEST;
 
+GST_START_TEST (test_parse_frames_with_vlan)
+{
+  gst_parser_test_split (pcap_frame_with_vlan, sizeof (pcap_frame_with_vlan));
+}
+GST_END_TEST;
+
+GST_START_TEST (test_parse_frames_ipv6)
+{
+  gst_parser_test_split (pcap_frame_ipv6, sizeof (pcap_frame_ipv6));
+}
+GST_END_TEST;
+
+static void
+pull_handoff_cb (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    guint * n_buffers)
+{
+  g_atomic_int_inc (n_buffers);
+}
+
+static void
+pull_pad_added_cb (GstElement * parse, GstPad * pad, guint * n_buffers)
+{
+  GstElement *bin = GST_ELEMENT (gst_element_get_parent (parse));
+  GstElement *sink;
+  GstPad *sinkpad;
+
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "signal-handoffs", TRUE, "async", FALSE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (pull_handoff_cb), n_buffers);
+  gst_bin_add (GST_BIN (bin), sink);
+  gst_element_sync_state_with_parent (sink);
+
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  fail_unless (gst_pad_link (pad, sinkpad) == GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+  gst_object_unref (bin);
+}
+
+static guint
+run_pull_pipeline (const gchar * location, const gchar * index_location,
+    guint * n_pads)
+{
+  GstElement *pipeline, *src, *parse, *sink;
+  GstMessage *msg;
+  GstBus *bus;
+  guint n_buffers = 0;
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  parse = gst_element_factory_make ("pcapparse", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (pipeline && src && parse && sink);
+
+  g_object_set (src, "location", location, NULL);
+  g_object_set (parse, "split-flows", TRUE, "index-location", index_location,
+      NULL);
+  g_signal_connect (parse, "pad-added", G_CALLBACK (pull_pad_added_cb),
+      &n_buffers);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, parse, sink, NULL);
+  fail_unless (gst_element_link_many (src, parse, sink, NULL));
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  /* the always src pad plus one pad per flow */
+  *n_pads = parse->numsrcpads - 1;
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return n_buffers;
+}
+
+GST_START_TEST (test_pull_split_flows)
+{
+  GByteArray *data;
+  gchar *location, *index_location;
+  guint n_pads = 0;
+  gint fd;
+
+  fd = g_file_open_tmp ("pcapparse-XXXXXX.pcap", &location, NULL);
+  fail_unless (fd != -1);
+  close (fd);
+  index_location = g_strconcat (location, ".idx", NULL);
+
+  /* two frames of one IPv4 flow and one frame of an IPv6 flow */
+  data = g_byte_array_new ();
+  g_byte_array_append (data, pcap_header, sizeof (pcap_header));
+  g_byte_array_append (data, pcap_frame_with_eth_padding,
+      sizeof (pcap_frame_with_eth_padding));
+  g_byte_array_append (data, pcap_frame_with_vlan,
+      sizeof (pcap_frame_with_vlan));
+  g_byte_array_append (data, pcap_frame_ipv6, sizeof (pcap_frame_ipv6));
+  fail_unless (g_file_set_contents (location, (const gchar *) data->data,
+          data->len, NULL));
+  g_byte_array_unref (data);
+
+  fail_unless_equals_int (run_pull_pipeline (location, index_location,
+          &n_pads), 3);
+  fail_unless_equals_int (n_pads, 2);
+  fail_unless (g_file_test (index_location, G_FILE_TEST_EXISTS));
+
+  /* second run is served from the stored index */
+  fail_unless_equals_int (run_pull_pipeline (location, index_location,
+          &n_pads), 3);
+  fail_unless_equals_int (n_pads, 2);
+
+  g_unlink (index_location);
+  g_unlink (location);
+  g_free (index_location);
+  g_free (location);
+}
+GST_END_TEST;
+
+/* a capture of one UDP flow with a packet every 100ms, starting at 1000s,
+ * each payload carries the index of its packet */
+#define SEEK_N_PACKETS 100
+#define SEEK_FIRST_TS (1000 * GST_SECOND)
+#define SEEK_PACKET_DURATION (100 * GST_MSECOND)
+#define SEEK_FRAME_LEN (14 + 20 + 8 + 4)
+
+static gchar *
+create_seek_capture (void)
+{
+  GByteArray *data;
+  gchar *location;
+  guint i;
+  gint fd;
+
+  fd = g_file_open_tmp ("pcapparse-XXXXXX.pcap", &location, NULL);
+  fail_unless (fd != -1);
+  close (fd);
+
+  data = g_byte_array_new ();
+  g_byte_array_append (data, pcap_header, sizeof (pcap_header));
+  for (i = 0; i < SEEK_N_PACKETS; i++) {
+    guint8 record[16 + SEEK_FRAME_LEN] = { 0, };
+    guint8 *frame = record + 16;
+    GstClockTime ts = SEEK_FIRST_TS + i * SEEK_PACKET_DURATION;
+
+    GST_WRITE_UINT32_LE (record + 0, ts / GST_SECOND);
+    GST_WRITE_UINT32_LE (record + 4, (ts % GST_SECOND) / GST_USECOND);
+    GST_WRITE_UINT32_LE (record + 8, SEEK_FRAME_LEN);
+    GST_WRITE_UINT32_LE (record + 12, SEEK_FRAME_LEN);
+
+    /* ethernet, IPv4 and UDP headers */
+    GST_WRITE_UINT16_BE (frame + 12, 0x0800);
+    frame[14] = 0x45;
+    GST_WRITE_UINT16_BE (frame + 16, 20 + 8 + 4);
+    frame[22] = 0x40;
+    frame[23] = 0x11;
+    GST_WRITE_UINT32_BE (frame + 26, 0xc0a80001);
+    GST_WRITE_UINT32_BE (frame + 30, 0xc0a80002);
+    GST_WRITE_UINT16_BE (frame + 34, 5000);
+    GST_WRITE_UINT16_BE (frame + 36, 5002);
+    GST_WRITE_UINT16_BE (frame + 38, 8 + 4);
+    GST_WRITE_UINT32_BE (frame + 42, i);
+
+    g_byte_array_append (data, record, sizeof (record));
+  }
+  fail_unless (g_file_set_contents (location, (const gchar *) data->data,
+          data->len, NULL));
+  g_byte_array_unref (data);
+
+  return location;
+}
+
+static void
+seek_handoff_cb (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    GArray * indices)
+{
+  guint32 index;
+
+  fail_unless_equals_int (gst_buffer_get_size (buffer), 4);
+  gst_buffer_extract (buffer, 0, &index, 4);
+  index = GUINT32_FROM_BE (index);
+
+  /* the timestamps are the ones of the capture */
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer),
+      SEEK_FIRST_TS + index * SEEK_PACKET_DURATION);
+
+  g_array_append_val (indices, index);
+}
+
+static void
+wait_for_eos (GstElement * pipeline)
+{
+  GstMessage *msg;
+  GstBus *bus;
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+}
+
+/* Checks that the packets @first to @last were output, in order */
+static void
+check_indices (GArray * indices, guint first, guint last)
+{
+  guint i;
+
+  fail_unless_equals_int (indices->len, last - first + 1);
+  for (i = 0; i < indices->len; i++)
+    fail_unless_equals_int (g_array_index (indices, guint32, i), first + i);
+  g_array_set_size (indices, 0);
+}
+
+GST_START_TEST (test_pull_seek)
+{
+  GstElement *pipeline, *src, *parse, *sink;
+  GArray *indices;
+  gchar *location;
+  gint64 duration;
+
+  location = create_seek_capture ();
+  indices = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  parse = gst_element_factory_make ("pcapparse", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (pipeline && src && parse && sink);
+
+  g_object_set (src, "location", location, NULL);
+  g_object_set (sink, "signal-handoffs", TRUE, "sync", FALSE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (seek_handoff_cb), indices);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, parse, sink, NULL);
+  fail_unless (gst_element_link_many (src, parse, sink, NULL));
+
+  /* the whole capture is indexed before the first packet is output */
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+  wait_for_eos (pipeline);
+  check_indices (indices, 0, SEEK_N_PACKETS - 1);
+
+  fail_unless (gst_element_query_duration (pipeline, GST_FORMAT_TIME,
+          &duration));
+  fail_unless_equals_uint64 (duration,
+      (SEEK_N_PACKETS - 1) * SEEK_PACKET_DURATION);
+
+  /* positions are relative to the first packet, the index entry before the
+   * target is looked up and the packets before the target are skipped */
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, 5050 * GST_MSECOND));
+  wait_for_eos (pipeline);
+  check_indices (indices, 51, SEEK_N_PACKETS - 1);
+
+  /* a range ends before the packet at its stop position */
+  fail_unless (gst_element_seek (pipeline, 1.0, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, 2 * GST_SECOND,
+          GST_SEEK_TYPE_SET, 3 * GST_SECOND));
+  wait_for_eos (pipeline);
+  check_indices (indices, 20, 29);
+
+  /* and back to the start */
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH, 0));
+  wait_for_eos (pipeline);
+  check_indices (indices, 0, SEEK_N_PACKETS - 1);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+  g_array_unref (indices);
+  g_unlink (location);
+  g_free (location);
+}
+GST_END_TEST;
+
 static Suite *
 pcapparse_suite (void)
 {
@@ -86,6 +397,10 @@ pcapparse_suite (void)
 
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_parse_frames_with_eth_padding);
+  tcase_add_test (tc_chain, test_parse_frames_with_vlan);
+  tcase_add_test (tc_chain, test_parse_frames_ipv6);
+  tcase_add_test (tc_chain, test_pull_split_flows);
+  tcase_add_test (tc_chain, test_pull_seek);
 
   return s;
 }
@@ -0,0 +1,376 @@
+/* GStreamer
+ *
+ * unit test for profilemeter
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#define N_BUFFERS 10
+#define BUFFER_SIZE 1000
+
+static GstPad *mysrcpad, *mysinkpad;
+static GstBus *bus;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+static GstElement *
+setup_element (const gchar * factory)
+{
+  GstElement *element;
+
+  element = gst_check_setup_element (factory);
+  mysrcpad = gst_check_setup_src_pad (element, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (element, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  bus = gst_bus_new ();
+  gst_element_set_bus (element, bus);
+
+  return element;
+}
+
+static void
+start_element (GstElement * element)
+{
+  GstCaps *caps;
+
+  fail_unless (gst_element_set_state (element,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_new_empty_simple ("application/x-test");
+  gst_check_setup_events (mysrcpad, element, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+}
+
+static void
+cleanup_element (GstElement * element)
+{
+  gst_check_drop_buffers ();
+
+  gst_element_set_bus (element, NULL);
+  gst_object_unref (bus);
+  bus = NULL;
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (element);
+  gst_check_teardown_sink_pad (element);
+  gst_check_teardown_element (element);
+}
+
+/* Returns N_BUFFERS buffers that went through a profilestamp */
+static GList *
+create_stamped_buffers (const gchar * stamp_name)
+{
+  GstElement *stamp;
+  GList *stamped;
+  guint i;
+
+  stamp = setup_element ("profilestamp");
+  g_object_set (stamp, "stamp-name", stamp_name, NULL);
+  start_element (stamp);
+
+  for (i = 0; i < N_BUFFERS; i++)
+    fail_unless_equals_int (gst_pad_push (mysrcpad,
+            gst_buffer_new_and_alloc (BUFFER_SIZE)), GST_FLOW_OK);
+
+  stamped = buffers;
+  buffers = NULL;
+  cleanup_element (stamp);
+
+  return stamped;
+}
+
+/* Pushes @stamped 1ms apart, and EOS if @eos */
+static void
+push_buffers (GList * stamped, gboolean eos)
+{
+  GList *l;
+
+  for (l = stamped; l; l = l->next) {
+    g_usleep (1000);
+    fail_unless_equals_int (gst_pad_push (mysrcpad, l->data), GST_FLOW_OK);
+  }
+  g_list_free (stamped);
+
+  if (eos)
+    fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  fail_unless_equals_int (g_list_length (buffers), N_BUFFERS);
+}
+
+static guint64
+get_uint64 (const GstStructure * s, const gchar * field)
+{
+  guint64 value;
+
+  fail_unless (gst_structure_get_uint64 (s, field, &value),
+      "no %s field", field);
+
+  return value;
+}
+
+/* Checks the summary of a histogram of @count values */
+static void
+check_histogram (const GstStructure * s, const gchar * prefix, guint64 count)
+{
+  const GValue *array;
+  guint64 min, max, mean, p50, p90, p99, sum = 0;
+  gchar *name;
+  guint i;
+
+  name = g_strdup_printf ("%s-histogram", prefix);
+  array = gst_structure_get_value (s, name);
+  g_free (name);
+
+  if (count == 0) {
+    fail_unless (array == NULL);
+    return;
+  }
+
+  fail_unless (array != NULL);
+  fail_unless_equals_int (gst_value_array_get_size (array), 32);
+  for (i = 0; i < gst_value_array_get_size (array); i++)
+    sum += g_value_get_uint64 (gst_value_array_get_value (array, i));
+  fail_unless_equals_uint64 (sum, count);
+
+  name = g_strdup_printf ("%s-min", prefix);
+  min = get_uint64 (s, name);
+  g_free (name);
+  name = g_strdup_printf ("%s-max", prefix);
+  max = get_uint64 (s, name);
+  g_free (name);
+  name = g_strdup_printf ("%s-mean", prefix);
+  mean = get_uint64 (s, name);
+  g_free (name);
+  name = g_strdup_printf ("%s-p50", prefix);
+  p50 = get_uint64 (s, name);
+  g_free (name);
+  name = g_strdup_printf ("%s-p90", prefix);
+  p90 = get_uint64 (s, name);
+  g_free (name);
+  name = g_strdup_printf ("%s-p99", prefix);
+  p99 = get_uint64 (s, name);
+  g_free (name);
+
+  fail_unless (min <= mean && mean <= max);
+  fail_unless (min <= p50 && p50 <= p90 && p90 <= p99 && p99 <= max);
+}
+
+static GstStructure *
+pop_message (void)
+{
+  GstMessage *msg;
+  GstStructure *s;
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT);
+  fail_unless (msg != NULL);
+  fail_unless (gst_message_has_name (msg, "profilemeter"));
+  s = gst_structure_copy (gst_message_get_structure (msg));
+  gst_message_unref (msg);
+
+  return s;
+}
+
+GST_START_TEST (test_eos_message)
+{
+  GstElement *meter;
+  GstStructure *s;
+  GList *stamped;
+
+  stamped = create_stamped_buffers ("in");
+  g_usleep (10000);
+
+  meter = setup_element ("profilemeter");
+  g_object_set (meter, "stamp-name", "in", "interval", 0, NULL);
+  start_element (meter);
+
+  push_buffers (stamped, TRUE);
+
+  s = pop_message ();
+  fail_unless_equals_string (gst_structure_get_string (s, "stamp-name"), "in");
+  fail_unless_equals_uint64 (get_uint64 (s, "buffers"), N_BUFFERS);
+  fail_unless_equals_uint64 (get_uint64 (s, "bytes"),
+      N_BUFFERS * BUFFER_SIZE);
+
+  /* all buffers were stamped at least 10ms before */
+  check_histogram (s, "latency", N_BUFFERS);
+  fail_unless (get_uint64 (s, "latency-min") >= 10 * GST_MSECOND);
+
+  /* the buffers were pushed at least 1ms apart */
+  check_histogram (s, "interarrival", N_BUFFERS - 1);
+  fail_unless (get_uint64 (s, "interarrival-min") >= GST_MSECOND);
+  check_histogram (s, "throughput", N_BUFFERS - 1);
+  fail_unless (get_uint64 (s, "throughput-max") <= BUFFER_SIZE * 1000);
+  fail_unless (gst_structure_has_field (s, "jitter"));
+  gst_structure_free (s);
+
+  /* only one message without an interval */
+  fail_if (gst_bus_have_pending (bus));
+
+  cleanup_element (meter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_other_stamp)
+{
+  GstElement *meter;
+  GstStructure *s;
+  GList *stamped;
+
+  stamped = create_stamped_buffers ("in");
+
+  meter = setup_element ("profilemeter");
+  g_object_set (meter, "stamp-name", "other", "interval", 0, NULL);
+  start_element (meter);
+
+  /* only the latency since the stamp of that name is measured */
+  push_buffers (stamped, TRUE);
+
+  s = pop_message ();
+  fail_unless_equals_uint64 (get_uint64 (s, "buffers"), N_BUFFERS);
+  check_histogram (s, "latency", 0);
+  fail_if (gst_structure_has_field (s, "latency-min"));
+  check_histogram (s, "interarrival", N_BUFFERS - 1);
+  gst_structure_free (s);
+
+  cleanup_element (meter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_any_stamp)
+{
+  GstElement *meter;
+  GstStructure *s;
+  GList *stamped;
+
+  stamped = create_stamped_buffers ("in");
+
+  meter = setup_element ("profilemeter");
+  g_object_set (meter, "interval", 0, NULL);
+  start_element (meter);
+
+  /* without a stamp-name the most recent stamp is measured */
+  push_buffers (stamped, TRUE);
+
+  s = pop_message ();
+  fail_unless (gst_structure_get_string (s, "stamp-name") == NULL);
+  check_histogram (s, "latency", N_BUFFERS);
+  gst_structure_free (s);
+
+  cleanup_element (meter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_interval)
+{
+  GstElement *meter;
+  GstStructure *s;
+  GList *stamped;
+  guint64 total = 0;
+  guint n_messages = 0;
+
+  stamped = create_stamped_buffers ("in");
+
+  meter = setup_element ("profilemeter");
+  g_object_set (meter, "stamp-name", "in", "interval", 1, NULL);
+  start_element (meter);
+
+  /* the buffers are 1ms apart, so there is a message before EOS */
+  push_buffers (stamped, FALSE);
+  fail_unless (gst_bus_have_pending (bus));
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  /* together the messages cover all buffers */
+  while (gst_bus_have_pending (bus)) {
+    s = pop_message ();
+    total += get_uint64 (s, "buffers");
+    n_messages++;
+    gst_structure_free (s);
+  }
+  fail_unless (n_messages > 1);
+  fail_unless_equals_uint64 (total, N_BUFFERS);
+
+  cleanup_element (meter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_stats)
+{
+  GstElement *meter;
+  GstStructure *s;
+  GList *stamped;
+
+  stamped = create_stamped_buffers ("in");
+
+  meter = setup_element ("profilemeter");
+  g_object_set (meter, "stamp-name", "in", "interval", 0, NULL);
+  start_element (meter);
+
+  push_buffers (stamped, FALSE);
+
+  g_object_get (meter, "stats", &s, NULL);
+  fail_unless (s != NULL);
+  fail_unless_equals_uint64 (get_uint64 (s, "buffers"), N_BUFFERS);
+  check_histogram (s, "latency", N_BUFFERS);
+  check_histogram (s, "interarrival", N_BUFFERS - 1);
+  check_histogram (s, "throughput", N_BUFFERS - 1);
+  gst_structure_free (s);
+
+  /* EOS posts the current stats, the totals are kept */
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+  s = pop_message ();
+  gst_structure_free (s);
+
+  g_object_get (meter, "stats", &s, NULL);
+  fail_unless_equals_uint64 (get_uint64 (s, "buffers"), N_BUFFERS);
+  fail_unless_equals_uint64 (get_uint64 (s, "bytes"),
+      N_BUFFERS * BUFFER_SIZE);
+  gst_structure_free (s);
+
+  cleanup_element (meter);
+}
+
+GST_END_TEST;
+
+static Suite *
+profilemeter_suite (void)
+{
+  Suite *s = suite_create ("profilemeter");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_eos_message);
+  tcase_add_test (tc_chain, test_other_stamp);
+  tcase_add_test (tc_chain, test_any_stamp);
+  tcase_add_test (tc_chain, test_interval);
+  tcase_add_test (tc_chain, test_stats);
+
+  return s;
+}
+
+GST_CHECK_MAIN (profilemeter);
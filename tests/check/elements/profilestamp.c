@@ -0,0 +1,216 @@
+/* GStreamer
+ *
+ * unit test for profilestamp
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+/* only for the layout of the meta, its functions are in the plugin */
+#include "../../gst/debugutils/gstprofilemeta.h"
+
+static GstPad *mysrcpad, *mysinkpad;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+static GstElement *
+setup_profilestamp (const gchar * name, const gchar * stamp_name)
+{
+  GstElement *stamp;
+  GstCaps *caps;
+
+  stamp = gst_check_setup_element ("profilestamp");
+  gst_object_set_name (GST_OBJECT (stamp), name);
+  if (stamp_name)
+    g_object_set (stamp, "stamp-name", stamp_name, NULL);
+
+  mysrcpad = gst_check_setup_src_pad (stamp, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (stamp, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (stamp,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_new_empty_simple ("application/x-test");
+  gst_check_setup_events (mysrcpad, stamp, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return stamp;
+}
+
+static void
+cleanup_profilestamp (GstElement * stamp)
+{
+  gst_check_drop_buffers ();
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (stamp);
+  gst_check_teardown_sink_pad (stamp);
+  gst_check_teardown_element (stamp);
+}
+
+/* Pushes @buffer through a profilestamp and returns the stamped buffer */
+static GstBuffer *
+stamp_buffer (GstBuffer * buffer, const gchar * name, const gchar * stamp_name)
+{
+  GstElement *stamp = setup_profilestamp (name, stamp_name);
+  GstBuffer *outbuf;
+
+  fail_unless_equals_int (gst_pad_push (mysrcpad, buffer), GST_FLOW_OK);
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  outbuf = gst_buffer_ref (buffers->data);
+
+  cleanup_profilestamp (stamp);
+
+  return outbuf;
+}
+
+static GstProfileMeta *
+get_stamp (GstBuffer * buffer, const gchar * name, guint * n_stamps)
+{
+  GstProfileMeta *found = NULL;
+  gpointer state = NULL;
+  GstMeta *meta;
+  GType api = g_type_from_name ("GstProfileMetaAPI");
+
+  fail_unless (api != 0);
+
+  *n_stamps = 0;
+  while ((meta = gst_buffer_iterate_meta (buffer, &state))) {
+    GstProfileMeta *pmeta = (GstProfileMeta *) meta;
+
+    if (meta->info->api != api)
+      continue;
+
+    (*n_stamps)++;
+    if (pmeta->name == g_quark_from_string (name))
+      found = pmeta;
+  }
+
+  return found;
+}
+
+GST_START_TEST (test_stamp)
+{
+  GstClockTime before, after;
+  GstProfileMeta *meta;
+  GstBuffer *buffer;
+  guint n_stamps;
+
+  before = gst_util_get_timestamp ();
+  buffer = stamp_buffer (gst_buffer_new_and_alloc (16), "stamp", "in");
+  after = gst_util_get_timestamp ();
+
+  meta = get_stamp (buffer, "in", &n_stamps);
+  fail_unless_equals_int (n_stamps, 1);
+  fail_unless (meta != NULL);
+  fail_unless (meta->time >= before && meta->time <= after);
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_default_name)
+{
+  GstProfileMeta *meta;
+  GstBuffer *buffer;
+  guint n_stamps;
+
+  /* the name of the element is used without a stamp-name */
+  buffer = stamp_buffer (gst_buffer_new_and_alloc (16), "mystamp", NULL);
+
+  meta = get_stamp (buffer, "mystamp", &n_stamps);
+  fail_unless_equals_int (n_stamps, 1);
+  fail_unless (meta != NULL);
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_several_stamps)
+{
+  GstClockTime first, second;
+  GstBuffer *buffer;
+  guint n_stamps;
+
+  /* a buffer carries one stamp for each point it went through */
+  buffer = stamp_buffer (gst_buffer_new_and_alloc (16), "a", "first");
+  buffer = stamp_buffer (buffer, "b", "second");
+
+  fail_unless (get_stamp (buffer, "first", &n_stamps) != NULL);
+  fail_unless_equals_int (n_stamps, 2);
+  first = get_stamp (buffer, "first", &n_stamps)->time;
+  second = get_stamp (buffer, "second", &n_stamps)->time;
+  fail_unless (second >= first);
+
+  /* going through a stamp of the same name again updates it */
+  g_usleep (1000);
+  buffer = stamp_buffer (buffer, "c", "first");
+  fail_unless (get_stamp (buffer, "first", &n_stamps)->time > first);
+  fail_unless_equals_int (n_stamps, 2);
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_copy_region)
+{
+  GstBuffer *buffer, *region;
+  GstProfileMeta *meta;
+  guint n_stamps;
+
+  buffer = stamp_buffer (gst_buffer_new_and_alloc (16), "stamp", "in");
+
+  /* parts of the buffer went through the stamp at the same time */
+  region = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL, 4, 8);
+  meta = get_stamp (region, "in", &n_stamps);
+  fail_unless_equals_int (n_stamps, 1);
+  fail_unless (meta != NULL);
+  fail_unless_equals_uint64 (meta->time,
+      get_stamp (buffer, "in", &n_stamps)->time);
+
+  gst_buffer_unref (region);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+static Suite *
+profilestamp_suite (void)
+{
+  Suite *s = suite_create ("profilestamp");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_stamp);
+  tcase_add_test (tc_chain, test_default_name);
+  tcase_add_test (tc_chain, test_several_stamps);
+  tcase_add_test (tc_chain, test_copy_region);
+
+  return s;
+}
+
+GST_CHECK_MAIN (profilestamp);
@@ -0,0 +1,216 @@
+/* GStreamer
+ *
+ * unit test for rtph265depay
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#define FU_TYPE_ID 49
+#define NAL_TRAIL_R 1
+
+#define FRAGMENT_SIZE 100
+
+static GstPad *mysrcpad, *mysinkpad;
+
+#define RTP_CAPS_STRING "application/x-rtp, media = (string) video, " \
+    "clock-rate = (int) 90000, encoding-name = (string) H265"
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-h265, stream-format = (string) byte-stream, "
+        "alignment = (string) nal"));
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS (RTP_CAPS_STRING));
+
+static GstElement *
+setup_rtph265depay (void)
+{
+  GstElement *depay;
+  GstCaps *caps;
+
+  depay = gst_check_setup_element ("rtph265depay");
+  mysrcpad = gst_check_setup_src_pad (depay, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (depay, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (depay,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (RTP_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, depay, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return depay;
+}
+
+static void
+cleanup_rtph265depay (GstElement * depay)
+{
+  gst_check_drop_buffers ();
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (depay);
+  gst_check_teardown_sink_pad (depay);
+  gst_check_teardown_element (depay);
+}
+
+/* The byte at @offset of the payload of the fragmented NAL unit */
+static guint8
+payload_byte (guint offset)
+{
+  return offset % 251;
+}
+
+/* Pushes a TRAIL_R NAL unit with temporal id @tid, split in @n_fragments
+ * fragmentation units */
+static void
+push_fu (guint n_fragments, guint8 tid)
+{
+  guint i, j;
+
+  for (i = 0; i < n_fragments; i++) {
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    GstBuffer *buffer;
+    guint8 *payload;
+
+    buffer = gst_rtp_buffer_new_allocate (3 + FRAGMENT_SIZE, 0, 0);
+    gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp);
+    gst_rtp_buffer_set_payload_type (&rtp, 96);
+    gst_rtp_buffer_set_seq (&rtp, i);
+    gst_rtp_buffer_set_timestamp (&rtp, 0);
+    gst_rtp_buffer_set_marker (&rtp, i == n_fragments - 1);
+
+    payload = gst_rtp_buffer_get_payload (&rtp);
+    payload[0] = FU_TYPE_ID << 1;
+    payload[1] = tid + 1;
+    payload[2] = NAL_TRAIL_R;
+    if (i == 0)
+      payload[2] |= 0x80;
+    if (i == n_fragments - 1)
+      payload[2] |= 0x40;
+    for (j = 0; j < FRAGMENT_SIZE; j++)
+      payload[3 + j] = payload_byte (i * FRAGMENT_SIZE + j);
+    gst_rtp_buffer_unmap (&rtp);
+
+    GST_BUFFER_PTS (buffer) = 0;
+    fail_unless_equals_int (gst_pad_push (mysrcpad, buffer), GST_FLOW_OK);
+  }
+}
+
+/* Checks that @buffer is the byte-stream NAL unit of push_fu() */
+static void
+check_fu_nal (GstBuffer * buffer, guint n_fragments, guint8 tid)
+{
+  GstMapInfo map;
+  guint i;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.size, 4 + 2 + n_fragments * FRAGMENT_SIZE);
+  fail_unless_equals_int (GST_READ_UINT32_BE (map.data), 1);
+  fail_unless_equals_int (map.data[4], NAL_TRAIL_R << 1);
+  fail_unless_equals_int (map.data[5], tid + 1);
+  for (i = 0; i < n_fragments * FRAGMENT_SIZE; i++)
+    fail_unless (map.data[6 + i] == payload_byte (i),
+        "NAL payload differs at %u", i);
+  gst_buffer_unmap (buffer, &map);
+}
+
+GST_START_TEST (test_fu_chained)
+{
+  GstElement *depay;
+  GstBuffer *buffer;
+
+  depay = setup_rtph265depay ();
+  push_fu (4, 0);
+
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  buffer = buffers->data;
+
+  /* the start code, the rebuilt NAL header and the payload of each packet,
+   * none of them copied */
+  fail_unless_equals_int (gst_buffer_n_memory (buffer), 2 + 4);
+  check_fu_nal (buffer, 4, 0);
+
+  cleanup_rtph265depay (depay);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_fu_many_fragments)
+{
+  GstElement *depay;
+  GstBuffer *buffer;
+  guint n_fragments;
+
+  /* one memory more or less than a buffer can hold and far beyond it */
+  for (n_fragments = gst_buffer_get_max_memory () - 3;
+      n_fragments <= 3 * gst_buffer_get_max_memory (); n_fragments += 2) {
+    depay = setup_rtph265depay ();
+    push_fu (n_fragments, 0);
+
+    fail_unless_equals_int (g_list_length (buffers), 1);
+    buffer = buffers->data;
+    fail_unless (gst_buffer_n_memory (buffer) <= gst_buffer_get_max_memory (),
+        "%u memories for %u fragments", gst_buffer_n_memory (buffer),
+        n_fragments);
+    check_fu_nal (buffer, n_fragments, 0);
+
+    cleanup_rtph265depay (depay);
+  }
+}
+
+GST_END_TEST;
+
+/* the temporal id of the rebuilt NAL header has three bits */
+GST_START_TEST (test_fu_temporal_id)
+{
+  GstElement *depay;
+  guint8 tid;
+
+  for (tid = 0; tid < 7; tid++) {
+    depay = setup_rtph265depay ();
+    push_fu (3, tid);
+
+    fail_unless_equals_int (g_list_length (buffers), 1);
+    check_fu_nal (buffers->data, 3, tid);
+
+    cleanup_rtph265depay (depay);
+  }
+}
+
+GST_END_TEST;
+
+static Suite *
+rtph265depay_suite (void)
+{
+  Suite *s = suite_create ("rtph265depay");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_fu_chained);
+  tcase_add_test (tc_chain, test_fu_many_fragments);
+  tcase_add_test (tc_chain, test_fu_temporal_id);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtph265depay);
@@ -0,0 +1,414 @@
+/* GStreamer
+ *
+ * unit test for rtph265pay
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#define AP_TYPE_ID 48
+#define FU_TYPE_ID 49
+
+/* NAL unit types of H.265 */
+#define NAL_TRAIL_R 1
+#define NAL_VPS 32
+#define NAL_SPS 33
+#define NAL_PPS 34
+
+static GstPad *mysrcpad, *mysinkpad;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS ("application/x-rtp"));
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS ("video/x-h265"));
+
+typedef struct
+{
+  guint8 type;
+  guint8 tid;
+  guint size;
+} Nal;
+
+static GstElement *
+setup_rtph265pay (const gchar * alignment, gboolean aggregate, guint mtu)
+{
+  GstElement *pay;
+  GstCaps *caps;
+
+  pay = gst_check_setup_element ("rtph265pay");
+  g_object_set (pay, "aggregate", aggregate, NULL);
+  if (mtu)
+    g_object_set (pay, "mtu", mtu, NULL);
+
+  mysrcpad = gst_check_setup_src_pad (pay, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (pay, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (pay,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_new_simple ("video/x-h265",
+      "stream-format", G_TYPE_STRING, "byte-stream",
+      "alignment", G_TYPE_STRING, alignment, NULL);
+  gst_check_setup_events (mysrcpad, pay, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return pay;
+}
+
+static void
+cleanup_rtph265pay (GstElement * pay)
+{
+  gst_check_drop_buffers ();
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (pay);
+  gst_check_teardown_sink_pad (pay);
+  gst_check_teardown_element (pay);
+}
+
+/* Fills the header and payload of @nal at @data, the payload bytes are the
+ * index of the NAL unit so they can be told apart */
+static void
+write_nal (guint8 * data, const Nal * nal, guint index)
+{
+  data[0] = nal->type << 1;
+  data[1] = nal->tid + 1;
+  memset (data + 2, 0x80 | index, nal->size - 2);
+}
+
+/* Returns a byte-stream buffer with the @n_nals NAL units of @nals */
+static GstBuffer *
+create_buffer (const Nal * nals, guint n_nals, GstClockTime pts)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  gsize size = 0, offset = 0;
+  guint i;
+
+  for (i = 0; i < n_nals; i++)
+    size += 4 + nals[i].size;
+
+  buffer = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  for (i = 0; i < n_nals; i++) {
+    GST_WRITE_UINT32_BE (map.data + offset, 1);
+    write_nal (map.data + offset + 4, &nals[i], i);
+    offset += 4 + nals[i].size;
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  GST_BUFFER_PTS (buffer) = pts;
+  GST_BUFFER_DTS (buffer) = pts;
+
+  return buffer;
+}
+
+/* Checks that @data is NAL unit @index of @nals */
+static void
+check_nal (const guint8 * data, gsize size, const Nal * nals, guint index)
+{
+  guint8 *expected = g_malloc (nals[index].size);
+
+  write_nal (expected, &nals[index], index);
+  fail_unless_equals_int (size, nals[index].size);
+  fail_unless (memcmp (data, expected, size) == 0, "NAL %u differs", index);
+  g_free (expected);
+}
+
+/* Returns the payload of packet @index and its marker bit in @marker */
+static GstBuffer *
+get_payload (guint index, gboolean * marker)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *packet, *payload;
+
+  packet = g_list_nth_data (buffers, index);
+  fail_unless (packet != NULL, "no packet %u", index);
+
+  fail_unless (gst_rtp_buffer_map (packet, GST_MAP_READ, &rtp));
+  *marker = gst_rtp_buffer_get_marker (&rtp);
+  payload = gst_rtp_buffer_get_payload_buffer (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+
+  return payload;
+}
+
+/* Checks that packet @index is a single NAL unit packet of NAL @nal */
+static void
+check_single (guint index, gboolean marker, const Nal * nals, guint nal)
+{
+  GstBuffer *payload;
+  GstMapInfo map;
+  gboolean m;
+
+  payload = get_payload (index, &m);
+  fail_unless (m == marker, "packet %u: marker should be %d", index, marker);
+
+  gst_buffer_map (payload, &map, GST_MAP_READ);
+  check_nal (map.data, map.size, nals, nal);
+  gst_buffer_unmap (payload, &map);
+  gst_buffer_unref (payload);
+}
+
+/* Checks that packet @index is an aggregation packet of the NAL units
+ * @first to @last */
+static void
+check_ap (guint index, gboolean marker, const Nal * nals, guint first,
+    guint last)
+{
+  GstBuffer *payload;
+  GstMapInfo map;
+  guint8 tid = 7;
+  gsize offset;
+  gboolean m;
+  guint i;
+
+  payload = get_payload (index, &m);
+  fail_unless (m == marker, "packet %u: marker should be %d", index, marker);
+
+  gst_buffer_map (payload, &map, GST_MAP_READ);
+
+  /* PayloadHdr with the lowest TID of the aggregated units */
+  for (i = first; i <= last; i++)
+    tid = MIN (tid, nals[i].tid + 1);
+  fail_unless_equals_int ((map.data[0] >> 1) & 0x3f, AP_TYPE_ID);
+  fail_unless_equals_int (map.data[1] & 0x07, tid);
+
+  offset = 2;
+  for (i = first; i <= last; i++) {
+    guint size;
+
+    fail_unless (offset + 2 <= map.size);
+    size = GST_READ_UINT16_BE (map.data + offset);
+    offset += 2;
+    fail_unless (offset + size <= map.size);
+    check_nal (map.data + offset, size, nals, i);
+    offset += size;
+  }
+  fail_unless_equals_int (offset, map.size);
+
+  gst_buffer_unmap (payload, &map);
+  gst_buffer_unref (payload);
+}
+
+/* Checks that the packets from @index are the fragmentation units of NAL
+ * @nal, with @marker on the last one, and returns the number of fragments */
+static guint
+check_fu (guint index, gboolean marker, const Nal * nals, guint nal)
+{
+  guint8 *data = g_malloc (nals[nal].size);
+  gboolean end = FALSE;
+  gsize size = 2;
+  guint n = 0;
+
+  while (!end) {
+    GstBuffer *payload;
+    GstMapInfo map;
+    gboolean m;
+
+    payload = get_payload (index + n, &m);
+    gst_buffer_map (payload, &map, GST_MAP_READ);
+
+    fail_unless_equals_int ((map.data[0] >> 1) & 0x3f, FU_TYPE_ID);
+    fail_unless_equals_int (map.data[1], nals[nal].tid + 1);
+    fail_unless_equals_int (map.data[2] >> 7, n == 0);
+    fail_unless_equals_int (map.data[2] & 0x3f, nals[nal].type);
+    end = (map.data[2] & 0x40) != 0;
+    fail_unless (m == (end && marker), "fragment %u: wrong marker", n);
+
+    fail_unless (size + map.size - 3 <= nals[nal].size);
+    memcpy (data + size, map.data + 3, map.size - 3);
+    size += map.size - 3;
+
+    gst_buffer_unmap (payload, &map);
+    gst_buffer_unref (payload);
+    n++;
+  }
+
+  /* the fragments together are the NAL unit */
+  data[0] = nals[nal].type << 1;
+  data[1] = nals[nal].tid + 1;
+  check_nal (data, size, nals, nal);
+  g_free (data);
+
+  return n;
+}
+
+static void
+push_access_unit (const Nal * nals, guint n_nals, GstClockTime pts)
+{
+  fail_unless_equals_int (gst_pad_push (mysrcpad,
+          create_buffer (nals, n_nals, pts)), GST_FLOW_OK);
+}
+
+static const Nal access_unit[] = {
+  {NAL_VPS, 0, 24},
+  {NAL_SPS, 0, 40},
+  {NAL_PPS, 0, 8},
+  {NAL_TRAIL_R, 1, 300},
+};
+
+GST_START_TEST (test_aggregate_default)
+{
+  GstElement *pay;
+  gboolean aggregate;
+
+  pay = gst_check_setup_element ("rtph265pay");
+  g_object_get (pay, "aggregate", &aggregate, NULL);
+  fail_if (aggregate);
+  gst_check_teardown_element (pay);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_single_nal)
+{
+  GstElement *pay;
+  guint i;
+
+  pay = setup_rtph265pay ("au", FALSE, 0);
+  push_access_unit (access_unit, G_N_ELEMENTS (access_unit), 0);
+
+  /* one packet per NAL unit, the marker on the last one */
+  fail_unless_equals_int (g_list_length (buffers), G_N_ELEMENTS (access_unit));
+  for (i = 0; i < G_N_ELEMENTS (access_unit); i++)
+    check_single (i, i == G_N_ELEMENTS (access_unit) - 1, access_unit, i);
+
+  cleanup_rtph265pay (pay);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_aggregate)
+{
+  GstElement *pay;
+
+  pay = setup_rtph265pay ("au", TRUE, 0);
+  push_access_unit (access_unit, G_N_ELEMENTS (access_unit), 0);
+  push_access_unit (access_unit, G_N_ELEMENTS (access_unit), GST_SECOND / 25);
+
+  /* one aggregation packet with the marker per access unit */
+  fail_unless_equals_int (g_list_length (buffers), 2);
+  check_ap (0, TRUE, access_unit, 0, G_N_ELEMENTS (access_unit) - 1);
+  check_ap (1, TRUE, access_unit, 0, G_N_ELEMENTS (access_unit) - 1);
+
+  cleanup_rtph265pay (pay);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_aggregate_mtu)
+{
+  static const Nal slices[] = {
+    {NAL_TRAIL_R, 0, 100},
+    {NAL_TRAIL_R, 0, 100},
+    {NAL_TRAIL_R, 0, 100},
+    {NAL_TRAIL_R, 0, 100},
+    {NAL_TRAIL_R, 0, 100},
+  };
+  GstElement *pay;
+
+  /* room for the RTP header, the PayloadHdr and three NAL units */
+  pay = setup_rtph265pay ("au", TRUE, 12 + 2 + 3 * (2 + 100));
+  push_access_unit (slices, G_N_ELEMENTS (slices), 0);
+
+  fail_unless_equals_int (g_list_length (buffers), 2);
+  check_ap (0, FALSE, slices, 0, 2);
+  check_ap (1, TRUE, slices, 3, 4);
+
+  cleanup_rtph265pay (pay);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_aggregate_fragment)
+{
+  static const Nal nals[] = {
+    {NAL_VPS, 0, 24},
+    {NAL_SPS, 0, 40},
+    {NAL_PPS, 0, 8},
+    {NAL_TRAIL_R, 2, 3000},
+  };
+  GstElement *pay;
+  guint n;
+
+  pay = setup_rtph265pay ("au", TRUE, 0);
+  push_access_unit (nals, G_N_ELEMENTS (nals), 0);
+
+  /* the parameter sets are aggregated before the fragmented slice and only
+   * its last fragment has the marker */
+  check_ap (0, FALSE, nals, 0, 2);
+  n = check_fu (1, TRUE, nals, 3);
+  fail_unless (n > 1);
+  fail_unless_equals_int (g_list_length (buffers), 1 + n);
+
+  cleanup_rtph265pay (pay);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_aggregate_nal_alignment)
+{
+  GstElement *pay;
+  guint i;
+
+  pay = setup_rtph265pay ("nal", TRUE, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (access_unit); i++) {
+    GstBuffer *buffer = create_buffer (&access_unit[i], 1, 0);
+
+    /* number the payload as in the whole access unit */
+    gst_buffer_memset (buffer, 4 + 2, 0x80 | i, access_unit[i].size - 2);
+    fail_unless_equals_int (gst_pad_push (mysrcpad, buffer), GST_FLOW_OK);
+
+    /* the parameter sets wait for the slice that follows them */
+    if (i < G_N_ELEMENTS (access_unit) - 1)
+      fail_unless (buffers == NULL);
+  }
+
+  /* the end of the access unit is unknown, so there is no marker */
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  check_ap (0, FALSE, access_unit, 0, G_N_ELEMENTS (access_unit) - 1);
+
+  cleanup_rtph265pay (pay);
+}
+
+GST_END_TEST;
+
+static Suite *
+rtph265pay_suite (void)
+{
+  Suite *s = suite_create ("rtph265pay");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_aggregate_default);
+  tcase_add_test (tc_chain, test_single_nal);
+  tcase_add_test (tc_chain, test_aggregate);
+  tcase_add_test (tc_chain, test_aggregate_mtu);
+  tcase_add_test (tc_chain, test_aggregate_fragment);
+  tcase_add_test (tc_chain, test_aggregate_nal_alignment);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtph265pay);
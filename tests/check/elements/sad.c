@@ -0,0 +1,263 @@
+/* GStreamer
+ *
+ * unit test for the SAD/SSD kernels of the videofilters plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "../../gst/videofilters/gstsad.c"
+
+#include <gst/check/gstcheck.h>
+
+#define MAX_WIDTH 100
+
+/* line widths around the vector sizes of all implementations */
+static const gint widths[] = { 1, 3, 4, 15, 16, 17, 31, 32, 33, 64, 71,
+  MAX_WIDTH
+};
+
+static const gint steps[] = { 1, 2, 4 };
+
+/* Returns the implementations that can run here, the Orc one first */
+static GList *
+get_implementations (void)
+{
+  GList *impls = NULL;
+
+  impls = g_list_append (impls, (gpointer) & sad_impl_orc);
+#if HAVE_CPU_X86_64
+  impls = g_list_append (impls, (gpointer) & sad_impl_sse2);
+#endif
+#ifdef HAVE_AVX2_TARGET
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    impls = g_list_append (impls, (gpointer) & sad_impl_avx2);
+#endif
+#ifdef HAVE_NEON_INTRINSICS
+  impls = g_list_append (impls, (gpointer) & sad_impl_neon);
+#endif
+
+  return impls;
+}
+
+static guint64
+ref_sad (const guint8 * s1, const guint8 * s2, gint width, gint step)
+{
+  guint64 sum = 0;
+  gint x;
+
+  for (x = 0; x < width; x += step)
+    sum += ABS (s1[x] - s2[x]);
+
+  return sum;
+}
+
+static guint64
+ref_ssd (const guint8 * s1, const guint8 * s2, gint width, gint step)
+{
+  guint64 sum = 0;
+  gint x;
+
+  for (x = 0; x < width; x += step)
+    sum += (s1[x] - s2[x]) * (s1[x] - s2[x]);
+
+  return sum;
+}
+
+static void
+fill_random (GRand * rand, guint8 * data, gint size)
+{
+  gint i;
+
+  for (i = 0; i < size; i++)
+    data[i] = g_rand_int_range (rand, 0, 256);
+}
+
+GST_START_TEST (test_rows)
+{
+  guint8 s1[MAX_WIDTH], s2[MAX_WIDTH];
+  GRand *rand = g_rand_new_with_seed (42);
+  GList *impls, *l;
+  guint i, w, k;
+
+  impls = get_implementations ();
+
+  for (i = 0; i < 10; i++) {
+    fill_random (rand, s1, MAX_WIDTH);
+    fill_random (rand, s2, MAX_WIDTH);
+
+    for (l = impls; l; l = l->next) {
+      const GstSadImpl *impl = l->data;
+
+      for (w = 0; w < G_N_ELEMENTS (widths); w++) {
+        for (k = 0; k < G_N_ELEMENTS (steps); k++) {
+          gint width = widths[w], step = steps[k];
+
+          fail_unless_equals_uint64 (impl->sad_row (s1, s2, width, step),
+              ref_sad (s1, s2, width, step));
+          fail_unless_equals_uint64 (impl->ssd_row (s1, s2, width, step),
+              ref_ssd (s1, s2, width, step));
+        }
+      }
+    }
+  }
+
+  g_list_free (impls);
+  g_rand_free (rand);
+}
+
+GST_END_TEST;
+
+/* Only the first pixel of every group of step pixels may be looked at, on
+ * either endianness */
+GST_START_TEST (test_rows_skipped_pixels)
+{
+  guint8 s1[MAX_WIDTH], s2[MAX_WIDTH];
+  GList *impls, *l;
+  guint k;
+  gint x;
+
+  impls = get_implementations ();
+
+  for (k = 1; k < G_N_ELEMENTS (steps); k++) {
+    gint step = steps[k];
+
+    memset (s1, 0, MAX_WIDTH);
+    for (x = 0; x < MAX_WIDTH; x++)
+      s2[x] = x % step ? 255 : 0;
+
+    for (l = impls; l; l = l->next) {
+      const GstSadImpl *impl = l->data;
+
+      fail_unless_equals_uint64 (impl->sad_row (s1, s2, MAX_WIDTH, step), 0);
+      fail_unless_equals_uint64 (impl->ssd_row (s1, s2, MAX_WIDTH, step), 0);
+    }
+
+    /* and the sampled pixels are */
+    for (x = 0; x < MAX_WIDTH; x++)
+      s2[x] = x % step ? 0 : 2;
+
+    for (l = impls; l; l = l->next) {
+      const GstSadImpl *impl = l->data;
+      guint64 n = (MAX_WIDTH + step - 1) / step;
+
+      fail_unless_equals_uint64 (impl->sad_row (s1, s2, MAX_WIDTH, step),
+          2 * n);
+      fail_unless_equals_uint64 (impl->ssd_row (s1, s2, MAX_WIDTH, step),
+          4 * n);
+    }
+  }
+
+  g_list_free (impls);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mark_rows)
+{
+  static const gint thresholds[] = { 0, 1, 20, 128, 254, 255 };
+  guint8 s1[MAX_WIDTH], s2[MAX_WIDTH], expected[MAX_WIDTH], d[MAX_WIDTH];
+  GRand *rand = g_rand_new_with_seed (42);
+  GList *impls, *l;
+  guint w, t;
+  gint phase;
+
+  impls = get_implementations ();
+
+  fill_random (rand, s1, MAX_WIDTH);
+  fill_random (rand, s2, MAX_WIDTH);
+
+  for (w = 0; w < G_N_ELEMENTS (widths); w++) {
+    for (t = 0; t < G_N_ELEMENTS (thresholds); t++) {
+      for (phase = 0; phase < 8; phase++) {
+        mark_row_c (expected, s1, s2, widths[w], thresholds[t], phase);
+
+        for (l = impls; l; l = l->next) {
+          const GstSadImpl *impl = l->data;
+
+          memset (d, 0, MAX_WIDTH);
+          impl->mark_row (d, s1, s2, widths[w], thresholds[t], phase);
+          fail_unless (memcmp (d, expected, widths[w]) == 0,
+              "%s differs for width %d, threshold %d", impl->name, widths[w],
+              thresholds[t]);
+        }
+      }
+    }
+  }
+
+  g_list_free (impls);
+  g_rand_free (rand);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_planes)
+{
+  const gint width = 71, height = 13, stride = 80;
+  guint8 *s1, *s2;
+  GRand *rand = g_rand_new_with_seed (42);
+  guint k;
+  gint j;
+
+  s1 = g_malloc (stride * height);
+  s2 = g_malloc (stride * height);
+  fill_random (rand, s1, stride * height);
+  fill_random (rand, s2, stride * height);
+
+  for (k = 0; k < G_N_ELEMENTS (steps); k++) {
+    gint step = steps[k];
+    guint64 sad = 0, ssd = 0;
+
+    /* only every step'th line is sampled and the padding is not */
+    for (j = 0; j < height; j += step) {
+      sad += ref_sad (s1 + j * stride, s2 + j * stride, width, step);
+      ssd += ref_ssd (s1 + j * stride, s2 + j * stride, width, step);
+    }
+
+    fail_unless_equals_uint64 (gst_sad_plane_u8 (s1, stride, s2, stride,
+            width, height, step), sad);
+    fail_unless_equals_uint64 (gst_ssd_plane_u8 (s1, stride, s2, stride,
+            width, height, step), ssd);
+  }
+
+  fail_unless_equals_uint64 (gst_sad_n_samples (width, height, 1),
+      width * height);
+  fail_unless_equals_uint64 (gst_sad_n_samples (width, height, 2), 36 * 7);
+  fail_unless_equals_uint64 (gst_sad_n_samples (width, height, 4), 18 * 4);
+
+  g_free (s1);
+  g_free (s2);
+  g_rand_free (rand);
+}
+
+GST_END_TEST;
+
+static Suite *
+sad_suite (void)
+{
+  Suite *s = suite_create ("sad");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_rows);
+  tcase_add_test (tc_chain, test_rows_skipped_pixels);
+  tcase_add_test (tc_chain, test_mark_rows);
+  tcase_add_test (tc_chain, test_planes);
+
+  return s;
+}
+
+GST_CHECK_MAIN (sad);
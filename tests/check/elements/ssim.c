@@ -0,0 +1,365 @@
+/* GStreamer
+ *
+ * unit test for ssim
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+#include <string.h>
+
+#define WIDTH 64
+#define HEIGHT 64
+#define FRAME_DURATION (GST_SECOND / 25)
+
+#define VIDEO_CAPS_STRING "video/x-raw, format = (string) I420, " \
+    "width = (int) 64, height = (int) 64, framerate = (fraction) 25/1"
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-raw, format = (string) GRAY8"));
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (VIDEO_CAPS_STRING));
+
+static GstElement *ssim;
+static GstPad *orgpad, *modpad, *mysinkpad;
+static GstBus *bus;
+
+/* the number of maps received before each measured event, and EOS */
+static GMutex event_lock;
+static GCond event_cond;
+static GArray *measured_after;
+static gboolean got_eos;
+
+static gboolean
+sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  const GstStructure *s = gst_event_get_structure (event);
+
+  g_mutex_lock (&event_lock);
+  if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_DOWNSTREAM &&
+      gst_structure_has_name (s, "application/x-videomeasure")) {
+    guint n = g_list_length (buffers);
+
+    fail_unless_equals_string (gst_structure_get_string (s, "stream"),
+        "modified_0");
+    fail_unless_equals_string (gst_structure_get_string (s, "metric"),
+        "SSIM");
+    g_array_append_val (measured_after, n);
+  } else if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
+    got_eos = TRUE;
+    g_cond_signal (&event_cond);
+  }
+  g_mutex_unlock (&event_lock);
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static GstPad *
+setup_src_pad (const gchar * name, const gchar * stream_id)
+{
+  GstPad *srcpad, *sinkpad;
+  GstCaps *caps;
+  GstSegment segment;
+
+  srcpad = gst_pad_new_from_static_template (&srctemplate, "src");
+  sinkpad = gst_element_get_request_pad (ssim, name);
+  fail_unless (sinkpad != NULL);
+  fail_unless_equals_int (gst_pad_link (srcpad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+  gst_pad_set_active (srcpad, TRUE);
+
+  fail_unless (gst_pad_push_event (srcpad,
+          gst_event_new_stream_start (stream_id)));
+  caps = gst_caps_from_string (VIDEO_CAPS_STRING);
+  fail_unless (gst_pad_push_event (srcpad, gst_event_new_caps (caps)));
+  gst_caps_unref (caps);
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_pad_push_event (srcpad, gst_event_new_segment (&segment)));
+
+  return srcpad;
+}
+
+static void
+teardown_src_pad (GstPad * srcpad)
+{
+  GstPad *sinkpad = gst_pad_get_peer (srcpad);
+
+  gst_pad_unlink (srcpad, sinkpad);
+  gst_element_release_request_pad (ssim, sinkpad);
+  gst_object_unref (sinkpad);
+  gst_object_unref (srcpad);
+}
+
+static void
+setup_ssim (void)
+{
+  ssim = gst_check_setup_element ("ssim");
+  bus = gst_bus_new ();
+  gst_element_set_bus (ssim, bus);
+
+  mysinkpad = gst_check_setup_sink_pad (ssim, &sinktemplate);
+  gst_pad_set_event_function (mysinkpad, sink_event);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  measured_after = g_array_new (FALSE, FALSE, sizeof (guint));
+  got_eos = FALSE;
+
+  fail_unless_equals_int (gst_element_set_state (ssim, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_SUCCESS);
+
+  orgpad = setup_src_pad ("original", "original");
+  modpad = setup_src_pad ("modified_%u", "modified");
+}
+
+static void
+cleanup_ssim (void)
+{
+  fail_unless_equals_int (gst_element_set_state (ssim, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+
+  teardown_src_pad (orgpad);
+  teardown_src_pad (modpad);
+  gst_check_drop_buffers ();
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_sink_pad (ssim);
+
+  gst_element_set_bus (ssim, NULL);
+  gst_bus_set_flushing (bus, TRUE);
+  gst_object_unref (bus);
+  gst_check_teardown_element (ssim);
+
+  g_array_free (measured_after, TRUE);
+}
+
+/* a frame with some structure, or a noisy version of it */
+static GstBuffer *
+create_frame (GstClockTime pts, gboolean noisy)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  guint32 seed = 1;
+  gint x, y;
+
+  buffer = gst_buffer_new_allocate (NULL, WIDTH * HEIGHT * 3 / 2, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  for (y = 0; y < HEIGHT; y++) {
+    for (x = 0; x < WIDTH; x++) {
+      gint v = (x * 4 + y * 3) & 0xff;
+
+      if (noisy) {
+        seed = seed * 1103515245 + 12345;
+        v = CLAMP (v + (gint) ((seed >> 16) % 61) - 30, 0, 255);
+      }
+      map.data[y * WIDTH + x] = v;
+    }
+  }
+  memset (map.data + WIDTH * HEIGHT, 128, WIDTH * HEIGHT / 2);
+  gst_buffer_unmap (buffer, &map);
+
+  GST_BUFFER_PTS (buffer) = pts;
+  GST_BUFFER_DURATION (buffer) = FRAME_DURATION;
+
+  return buffer;
+}
+
+static void
+push_frame (GstPad * pad, guint frame, gboolean noisy)
+{
+  fail_unless_equals_int (gst_pad_push (pad,
+          create_frame (frame * FRAME_DURATION, noisy)), GST_FLOW_OK);
+}
+
+static void
+push_eos_and_wait (void)
+{
+  gst_pad_push_event (orgpad, gst_event_new_eos ());
+  gst_pad_push_event (modpad, gst_event_new_eos ());
+
+  g_mutex_lock (&event_lock);
+  while (!got_eos)
+    g_cond_wait (&event_cond, &event_lock);
+  g_mutex_unlock (&event_lock);
+}
+
+/* checks the timestamp of a map and whether it is all black */
+static void
+check_map (guint i, guint frame, gboolean black)
+{
+  GstBuffer *buffer = g_list_nth_data (buffers, i);
+  GstMapInfo map;
+  guint j, sum = 0;
+
+  fail_unless (buffer != NULL);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), frame * FRAME_DURATION);
+  fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buffer), i);
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  fail_unless (map.size >= WIDTH * HEIGHT);
+  for (j = 0; j < map.size; j++)
+    sum += map.data[j];
+  gst_buffer_unmap (buffer, &map);
+
+  fail_unless_equals_int (sum == 0, black);
+}
+
+/* checks the next measurement message and returns its mean */
+static gfloat
+check_message (guint64 offset, guint frame)
+{
+  const GstStructure *s;
+  GstMessage *msg;
+  GstClockTime timestamp;
+  guint64 msg_offset;
+  gfloat mean, lowest, highest;
+
+  msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT);
+  fail_unless (msg != NULL);
+  s = gst_message_get_structure (msg);
+  fail_unless (gst_structure_has_name (s, "SSIM"));
+  fail_unless_equals_string (gst_structure_get_string (s, "stream"),
+      "modified_0");
+  fail_unless (gst_structure_get (s, "offset", G_TYPE_UINT64, &msg_offset,
+          "timestamp", GST_TYPE_CLOCK_TIME, &timestamp, "mean", G_TYPE_FLOAT,
+          &mean, "lowest", G_TYPE_FLOAT, &lowest, "highest", G_TYPE_FLOAT,
+          &highest, NULL));
+  gst_message_unref (msg);
+
+  fail_unless_equals_uint64 (msg_offset, offset);
+  fail_unless_equals_uint64 (timestamp, frame * FRAME_DURATION);
+  fail_unless (lowest <= mean && mean <= highest);
+
+  return mean;
+}
+
+GST_START_TEST (test_pairing)
+{
+  setup_ssim ();
+
+  /* the same frame, a missing modified frame and a noisy frame */
+  push_frame (orgpad, 0, FALSE);
+  push_frame (modpad, 0, FALSE);
+  push_frame (orgpad, 1, FALSE);
+  push_frame (modpad, 2, TRUE);
+  push_frame (orgpad, 2, FALSE);
+  push_eos_and_wait ();
+
+  fail_unless_equals_int (g_list_length (buffers), 3);
+  check_map (0, 0, FALSE);
+  check_map (1, 1, TRUE);
+  check_map (2, 2, FALSE);
+
+  fail_unless (check_message (0, 0) > 0.999);
+  fail_unless (check_message (2, 2) < 0.9);
+  fail_unless (gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT) == NULL);
+
+  /* the measurements follow their maps */
+  fail_unless_equals_int (measured_after->len, 2);
+  fail_unless_equals_int (g_array_index (measured_after, guint, 0), 1);
+  fail_unless_equals_int (g_array_index (measured_after, guint, 1), 3);
+
+  cleanup_ssim ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_early_modified_frame)
+{
+  setup_ssim ();
+
+  /* the modified stream starts a frame earlier, that frame is dropped */
+  push_frame (modpad, 0, FALSE);
+  push_frame (orgpad, 1, FALSE);
+  push_frame (modpad, 1, FALSE);
+  push_eos_and_wait ();
+
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  check_map (0, 1, FALSE);
+  fail_unless (check_message (0, 1) > 0.999);
+  fail_unless (gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT) == NULL);
+
+  cleanup_ssim ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_modified_eos)
+{
+  setup_ssim ();
+
+  /* the original is still measured after the modified stream ended */
+  push_frame (orgpad, 0, FALSE);
+  push_frame (modpad, 0, FALSE);
+  gst_pad_push_event (modpad, gst_event_new_eos ());
+  push_frame (orgpad, 1, FALSE);
+  push_frame (orgpad, 2, FALSE);
+  push_eos_and_wait ();
+
+  fail_unless_equals_int (g_list_length (buffers), 3);
+  check_map (0, 0, FALSE);
+  check_map (1, 1, TRUE);
+  check_map (2, 2, TRUE);
+  fail_unless (check_message (0, 0) > 0.999);
+  fail_unless (gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT) == NULL);
+  fail_unless_equals_int (measured_after->len, 1);
+
+  cleanup_ssim ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_original_eos)
+{
+  setup_ssim ();
+
+  /* the end of the original is the end of the output, the modified frames
+   * after it are not measured */
+  push_frame (orgpad, 0, FALSE);
+  push_frame (modpad, 0, FALSE);
+  gst_pad_push_event (orgpad, gst_event_new_eos ());
+  gst_pad_push (modpad, create_frame (FRAME_DURATION, FALSE));
+  push_eos_and_wait ();
+
+  fail_unless_equals_int (g_list_length (buffers), 1);
+  check_map (0, 0, FALSE);
+  fail_unless (check_message (0, 0) > 0.999);
+  fail_unless (gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT) == NULL);
+
+  cleanup_ssim ();
+}
+
+GST_END_TEST;
+
+static Suite *
+ssim_suite (void)
+{
+  Suite *s = suite_create ("ssim");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_pairing);
+  tcase_add_test (tc_chain, test_early_modified_frame);
+  tcase_add_test (tc_chain, test_modified_eos);
+  tcase_add_test (tc_chain, test_original_eos);
+
+  return s;
+}
+
+GST_CHECK_MAIN (ssim);
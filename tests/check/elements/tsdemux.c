@@ -0,0 +1,436 @@
+/* GStreamer
+ *
+ * unit test for the tsdemux keyframe index
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/base/gstbytereader.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PACKET_SIZE 188
+#define PMT_PID 0x100
+#define VIDEO_PID 0x101
+#define PRIVATE_PID 0x102
+
+/* 10s of 25 fps H.264 with a keyframe every second */
+#define N_FRAMES 250
+#define GOP_SIZE 25
+#define N_KEYFRAMES (N_FRAMES / GOP_SIZE)
+
+#define INDEX_HEADER_SIZE (4 + 4 + 8 + 2 + 2 + 4)
+#define INDEX_ENTRY_SIZE (8 + 8 + 4)
+#define INDEX_FLAG_COMPLETE (1 << 0)
+
+static gchar *ts_filename;
+/* offsets of the packets starting the keyframes */
+static guint64 keyframe_offsets[N_KEYFRAMES];
+
+static guint32
+crc32_mpeg (const guint8 * data, guint size)
+{
+  guint32 crc = 0xffffffff;
+  guint i, j;
+
+  for (i = 0; i < size; i++) {
+    crc ^= (guint32) data[i] << 24;
+    for (j = 0; j < 8; j++)
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+  }
+
+  return crc;
+}
+
+static void
+write_header (guint8 * packet, guint16 pid, gboolean start,
+    gboolean adaptation, guint8 * cc)
+{
+  packet[0] = 0x47;
+  packet[1] = (start ? 0x40 : 0x00) | (pid >> 8);
+  packet[2] = pid & 0xff;
+  packet[3] = (adaptation ? 0x30 : 0x10) | ((*cc)++ & 0x0f);
+}
+
+/* writes a section in a packet of its own */
+static void
+write_section (GByteArray * ts, guint16 pid, guint8 * section, guint size,
+    guint8 * cc)
+{
+  guint8 packet[PACKET_SIZE];
+  guint32 crc;
+
+  memset (packet, 0xff, PACKET_SIZE);
+  write_header (packet, pid, TRUE, FALSE, cc);
+  packet[4] = 0;                /* pointer field */
+
+  crc = crc32_mpeg (section, size - 4);
+  GST_WRITE_UINT32_BE (section + size - 4, crc);
+  memcpy (packet + 5, section, size);
+
+  g_byte_array_append (ts, packet, PACKET_SIZE);
+}
+
+static void
+write_psi (GByteArray * ts, guint8 * pat_cc, guint8 * pmt_cc)
+{
+  guint8 pat[] = {
+    0x00, 0xb0, 13, 0x00, 0x01, 0xc1, 0x00, 0x00,
+    0x00, 0x01, 0xe0 | (PMT_PID >> 8), PMT_PID & 0xff,
+    0, 0, 0, 0
+  };
+  /* the private stream comes first, the index has to pick the video */
+  guint8 pmt[] = {
+    0x02, 0xb0, 23, 0x00, 0x01, 0xc1, 0x00, 0x00,
+    0xe0 | (VIDEO_PID >> 8), VIDEO_PID & 0xff, 0xf0, 0x00,
+    0x06, 0xe0 | (PRIVATE_PID >> 8), PRIVATE_PID & 0xff, 0xf0, 0x00,
+    0x1b, 0xe0 | (VIDEO_PID >> 8), VIDEO_PID & 0xff, 0xf0, 0x00,
+    0, 0, 0, 0
+  };
+
+  write_section (ts, 0, pat, sizeof (pat), pat_cc);
+  write_section (ts, PMT_PID, pmt, sizeof (pmt), pmt_cc);
+}
+
+/* one PES per frame, in one packet with a PCR */
+static void
+write_frame (GByteArray * ts, guint i, guint8 * cc)
+{
+  static const guint8 keyframe[] = {
+    0x00, 0x00, 0x00, 0x01, 0x09, 0x10,
+    0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1e, 0x95, 0xa8,
+    0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,
+    0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x33, 0xff
+  };
+  static const guint8 frame[] = {
+    0x00, 0x00, 0x00, 0x01, 0x09, 0x30,
+    0x00, 0x00, 0x00, 0x01, 0x41, 0x9a, 0x02, 0x04, 0x5f, 0xff
+  };
+  gboolean key = (i % GOP_SIZE) == 0;
+  const guint8 *payload = key ? keyframe : frame;
+  guint payload_size = key ? sizeof (keyframe) : sizeof (frame);
+  guint64 pts = 90000 + i * 3600;
+  guint64 pcr = pts - 9000;
+  guint8 packet[PACKET_SIZE];
+  guint8 *pes;
+  guint af_len;
+
+  memset (packet, 0xff, PACKET_SIZE);
+  write_header (packet, VIDEO_PID, TRUE, TRUE, cc);
+
+  af_len = PACKET_SIZE - 5 - 14 - payload_size;
+  packet[4] = af_len;
+  packet[5] = 0x10 | (key ? 0x40 : 0x00);
+  packet[6] = pcr >> 25;
+  packet[7] = pcr >> 17;
+  packet[8] = pcr >> 9;
+  packet[9] = pcr >> 1;
+  packet[10] = ((pcr & 1) << 7) | 0x7e;
+  packet[11] = 0;
+
+  pes = packet + 5 + af_len;
+  pes[0] = 0x00;
+  pes[1] = 0x00;
+  pes[2] = 0x01;
+  pes[3] = 0xe0;
+  pes[4] = 0x00;
+  pes[5] = 0x00;
+  pes[6] = 0x80;
+  pes[7] = 0x80;
+  pes[8] = 0x05;
+  pes[9] = 0x21 | ((pts >> 29) & 0x0e);
+  pes[10] = pts >> 22;
+  pes[11] = 0x01 | ((pts >> 14) & 0xfe);
+  pes[12] = pts >> 7;
+  pes[13] = 0x01 | ((pts << 1) & 0xfe);
+  memcpy (pes + 14, payload, payload_size);
+
+  if (key)
+    keyframe_offsets[i / GOP_SIZE] = ts->len;
+
+  g_byte_array_append (ts, packet, PACKET_SIZE);
+}
+
+static void
+create_ts_file (void)
+{
+  GByteArray *ts = g_byte_array_new ();
+  guint8 pat_cc = 0, pmt_cc = 0, video_cc = 0;
+  guint i;
+  gint fd;
+
+  for (i = 0; i < N_FRAMES; i++) {
+    if (i % GOP_SIZE == 0)
+      write_psi (ts, &pat_cc, &pmt_cc);
+    write_frame (ts, i, &video_cc);
+  }
+
+  fd = g_file_open_tmp ("tsdemux-XXXXXX.ts", &ts_filename, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  fail_unless (g_file_set_contents (ts_filename, (gchar *) ts->data, ts->len,
+          NULL));
+  g_byte_array_unref (ts);
+}
+
+static gchar *
+create_index_filename (void)
+{
+  gchar *filename;
+  gint fd;
+
+  fd = g_file_open_tmp ("tsdemux-XXXXXX.idx", &filename, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  g_unlink (filename);
+
+  return filename;
+}
+
+/* timestamp of the first buffer after preroll or a seek */
+static GstClockTime first_pts;
+
+static void
+handoff_cb (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  if (!GST_CLOCK_TIME_IS_VALID (first_pts))
+    first_pts = GST_BUFFER_PTS (buffer);
+}
+
+static void
+pad_added_cb (GstElement * demux, GstPad * pad, GstElement * sink)
+{
+  GstPad *sinkpad;
+
+  if (!g_str_has_prefix (GST_PAD_NAME (pad), "video_"))
+    return;
+
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  fail_unless_equals_int (gst_pad_link (pad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+}
+
+static GstElement *
+create_pipeline (const gchar * index_file, gboolean scan)
+{
+  GstElement *pipeline, *src, *demux, *sink;
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  demux = gst_element_factory_make ("tsdemux", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (src && demux && sink);
+
+  g_object_set (src, "location", ts_filename, NULL);
+  g_object_set (demux, "index-file", index_file, "index-scan", scan, NULL);
+  g_object_set (sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff_cb), NULL);
+  g_signal_connect (sink, "preroll-handoff", G_CALLBACK (handoff_cb), NULL);
+  g_signal_connect (demux, "pad-added", G_CALLBACK (pad_added_cb), sink);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, demux, sink, NULL);
+  fail_unless (gst_element_link (src, demux));
+
+  return pipeline;
+}
+
+static void
+play_to_eos (const gchar * index_file, gboolean scan)
+{
+  GstElement *pipeline = create_pipeline (index_file, scan);
+  GstMessage *msg;
+  GstBus *bus;
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  /* the index is saved when stopping */
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+}
+
+/* checks the index file and returns the timestamps of its entries */
+static void
+check_index_file (const gchar * index_file, gboolean complete,
+    GstClockTime * timestamps)
+{
+  GstByteReader br;
+  gchar *contents;
+  gsize length;
+  guint32 n;
+  guint16 pid, flags;
+  guint64 size;
+  guint i;
+
+  fail_unless (g_file_get_contents (index_file, &contents, &length, NULL));
+  gst_byte_reader_init (&br, (guint8 *) contents, length);
+
+  fail_unless (length >= INDEX_HEADER_SIZE);
+  fail_unless (memcmp (contents, "TSIX", 4) == 0);
+  gst_byte_reader_skip_unchecked (&br, 8);
+  size = gst_byte_reader_get_uint64_be_unchecked (&br);
+  pid = gst_byte_reader_get_uint16_be_unchecked (&br);
+  flags = gst_byte_reader_get_uint16_be_unchecked (&br);
+  n = gst_byte_reader_get_uint32_be_unchecked (&br);
+
+  fail_unless_equals_uint64 (size, N_FRAMES * PACKET_SIZE +
+      N_KEYFRAMES * 2 * PACKET_SIZE);
+  /* picked by stream type, not the first stream */
+  fail_unless_equals_int (pid, VIDEO_PID);
+  fail_unless_equals_int ((flags & INDEX_FLAG_COMPLETE) != 0, complete);
+  fail_unless_equals_int (n, N_KEYFRAMES);
+  fail_unless_equals_int (length, INDEX_HEADER_SIZE + n * INDEX_ENTRY_SIZE);
+
+  for (i = 0; i < n; i++) {
+    guint64 offset;
+
+    timestamps[i] = gst_byte_reader_get_uint64_be_unchecked (&br);
+    offset = gst_byte_reader_get_uint64_be_unchecked (&br);
+    gst_byte_reader_skip_unchecked (&br, 4);
+
+    fail_unless_equals_uint64 (offset, keyframe_offsets[i]);
+    if (i > 0)
+      fail_unless_equals_uint64 (timestamps[i] - timestamps[i - 1],
+          GST_SECOND);
+  }
+
+  g_free (contents);
+}
+
+GST_START_TEST (test_index_while_playing)
+{
+  GstClockTime timestamps[N_KEYFRAMES];
+  gchar *index_file = create_index_filename ();
+
+  play_to_eos (index_file, FALSE);
+  /* every keyframe was seen, but the file wasn't scanned */
+  check_index_file (index_file, FALSE, timestamps);
+
+  g_unlink (index_file);
+  g_free (index_file);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_index_scan)
+{
+  GstClockTime timestamps[N_KEYFRAMES];
+  gchar *index_file = create_index_filename ();
+
+  play_to_eos (index_file, TRUE);
+  check_index_file (index_file, TRUE, timestamps);
+
+  g_unlink (index_file);
+  g_free (index_file);
+}
+
+GST_END_TEST;
+
+static GstClockTime
+seek_and_get_first_pts (GstElement * pipeline, GstClockTime position)
+{
+  first_pts = GST_CLOCK_TIME_NONE;
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT, position));
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  return first_pts;
+}
+
+GST_START_TEST (test_index_seek)
+{
+  GstClockTime timestamps[N_KEYFRAMES];
+  gchar *index_file = create_index_filename ();
+  GstElement *pipeline;
+  guint i;
+
+  /* a complete index from a previous run */
+  play_to_eos (index_file, TRUE);
+  check_index_file (index_file, TRUE, timestamps);
+
+  pipeline = create_pipeline (index_file, FALSE);
+  first_pts = GST_CLOCK_TIME_NONE;
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PAUSED),
+      GST_STATE_CHANGE_ASYNC);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+  fail_unless_equals_uint64 (first_pts, timestamps[0]);
+
+  /* seeks start exactly at the last keyframe before the target, forwards
+   * and backwards */
+  for (i = N_KEYFRAMES - 1; i > 0; i -= 3) {
+    fail_unless_equals_uint64 (seek_and_get_first_pts (pipeline,
+            timestamps[i] + 500 * GST_MSECOND), timestamps[i]);
+    fail_unless_equals_uint64 (seek_and_get_first_pts (pipeline,
+            timestamps[i]), timestamps[i]);
+  }
+  fail_unless_equals_uint64 (seek_and_get_first_pts (pipeline,
+          timestamps[2] + 999 * GST_MSECOND), timestamps[2]);
+  fail_unless_equals_uint64 (seek_and_get_first_pts (pipeline,
+          timestamps[7] + GST_MSECOND), timestamps[7]);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+
+  g_unlink (index_file);
+  g_free (index_file);
+}
+
+GST_END_TEST;
+
+static void
+tsdemux_setup (void)
+{
+  create_ts_file ();
+}
+
+static void
+tsdemux_teardown (void)
+{
+  g_unlink (ts_filename);
+  g_free (ts_filename);
+  ts_filename = NULL;
+}
+
+static Suite *
+tsdemux_suite (void)
+{
+  Suite *s = suite_create ("tsdemux");
+  TCase *tc_chain = tcase_create ("index");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, tsdemux_setup, tsdemux_teardown);
+  tcase_add_test (tc_chain, test_index_while_playing);
+  tcase_add_test (tc_chain, test_index_scan);
+  tcase_add_test (tc_chain, test_index_seek);
+
+  return s;
+}
+
+GST_CHECK_MAIN (tsdemux);
@@ -0,0 +1,468 @@
+/* GStreamer
+ *
+ * unit test for videoparse
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+#define WIDTH 8
+#define HEIGHT 4
+#define N_FRAMES 4
+
+static GstPad *mysrcpad, *mysinkpad;
+static gboolean support_meta;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS ("video/x-raw"));
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+static gboolean
+sink_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  if (GST_QUERY_TYPE (query) == GST_QUERY_ALLOCATION && support_meta) {
+    gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+    return TRUE;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static GstElement *
+setup_videoparse (const gchar * strides, const gchar * offsets,
+    guint framesize, gboolean meta)
+{
+  GstElement *videoparse;
+  GstSegment segment;
+
+  videoparse = gst_check_setup_element ("videoparse");
+  g_object_set (videoparse, "format", GST_VIDEO_FORMAT_I420, "width", WIDTH,
+      "height", HEIGHT, "strides", strides, "offsets", offsets, "framesize",
+      framesize, NULL);
+
+  support_meta = meta;
+  mysrcpad = gst_check_setup_src_pad (videoparse, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (videoparse, &sinktemplate);
+  gst_pad_set_query_function (mysinkpad, sink_query);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (videoparse,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  /* videoparse sets its own caps */
+  fail_unless (gst_pad_push_event (mysrcpad,
+          gst_event_new_stream_start ("test")));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment)));
+
+  return videoparse;
+}
+
+static void
+cleanup_videoparse (GstElement * videoparse)
+{
+  gst_check_drop_buffers ();
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (videoparse);
+  gst_check_teardown_sink_pad (videoparse);
+  gst_check_teardown_element (videoparse);
+}
+
+static guint8
+pixel_value (guint plane, guint frame, guint line)
+{
+  if (plane == 0)
+    return frame * 16 + line;
+
+  return plane * 100 + frame;
+}
+
+/* Returns the I420 layout with the given plane strides and offsets */
+static void
+get_layout (GstVideoInfo * info, const gint * strides, const gsize * offsets)
+{
+  guint i;
+
+  gst_video_info_set_format (info, GST_VIDEO_FORMAT_I420, WIDTH, HEIGHT);
+  for (i = 0; i < 3; i++) {
+    info->stride[i] = strides[i];
+    info->offset[i] = offsets[i];
+  }
+}
+
+/* Returns @n_frames of @framesize bytes laid out as @info, the padding is
+ * all 0xff */
+static guint8 *
+create_stream (const GstVideoInfo * info, gsize framesize, guint n_frames)
+{
+  guint8 *data, *frame;
+  guint i, p, y;
+
+  data = g_malloc (framesize * n_frames);
+  memset (data, 0xff, framesize * n_frames);
+
+  for (i = 0; i < n_frames; i++) {
+    frame = data + i * framesize;
+    for (p = 0; p < 3; p++) {
+      for (y = 0; y < GST_VIDEO_INFO_COMP_HEIGHT (info, p); y++)
+        memset (frame + info->offset[p] + y * info->stride[p],
+            pixel_value (p, i, y), GST_VIDEO_INFO_COMP_WIDTH (info, p));
+    }
+  }
+
+  return data;
+}
+
+/* Pushes the stream in two buffers so that a frame straddles them */
+static void
+push_stream (guint8 * data, gsize framesize, guint n_frames)
+{
+  gsize size = framesize * n_frames;
+  gsize split = framesize * n_frames / 2 + framesize / 2;
+
+  fail_unless_equals_int (gst_pad_push (mysrcpad,
+          gst_buffer_new_wrapped (g_memdup (data, split), split)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_pad_push (mysrcpad,
+          gst_buffer_new_wrapped (g_memdup (data + split, size - split),
+              size - split)), GST_FLOW_OK);
+  g_free (data);
+}
+
+/* Checks that @buffer is frame @index, with a GstVideoMeta describing
+ * @layout or, without @layout, copied to the default layout */
+static void
+check_frame (GstBuffer * buffer, guint index, const GstVideoInfo * layout)
+{
+  GstVideoMeta *meta;
+  GstVideoInfo info;
+  GstVideoFrame frame;
+  guint p, x, y;
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, WIDTH, HEIGHT);
+
+  meta = gst_buffer_get_video_meta (buffer);
+  if (layout) {
+    fail_unless (meta != NULL);
+    fail_unless_equals_int (meta->format, GST_VIDEO_FORMAT_I420);
+    fail_unless_equals_int (meta->width, WIDTH);
+    fail_unless_equals_int (meta->height, HEIGHT);
+    fail_unless_equals_int (meta->n_planes, 3);
+    for (p = 0; p < 3; p++) {
+      fail_unless_equals_int (meta->stride[p], layout->stride[p]);
+      fail_unless_equals_uint64 (meta->offset[p], layout->offset[p]);
+    }
+  } else {
+    fail_unless (meta == NULL);
+    fail_unless_equals_int (gst_buffer_get_size (buffer),
+        GST_VIDEO_INFO_SIZE (&info));
+  }
+
+  /* maps through the meta if there is one */
+  fail_unless (gst_video_frame_map (&frame, &info, buffer, GST_MAP_READ));
+  for (p = 0; p < 3; p++) {
+    const guint8 *data = GST_VIDEO_FRAME_COMP_DATA (&frame, p);
+    gint stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, p);
+
+    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (&frame, p); y++) {
+      for (x = 0; x < GST_VIDEO_FRAME_COMP_WIDTH (&frame, p); x++)
+        fail_unless_equals_int (data[y * stride + x],
+            pixel_value (p, index, y));
+    }
+  }
+  gst_video_frame_unmap (&frame);
+}
+
+static void
+check_custom_layout (gboolean meta)
+{
+  static const gint strides[] = { 16, 8, 8 };
+  static const gsize offsets[] = { 0, 64, 80 };
+  GstElement *videoparse;
+  GstVideoInfo layout;
+  GList *l;
+  guint i;
+
+  /* padded lines, planes following each other and a padded frame */
+  videoparse = setup_videoparse ("16,8,8", NULL, 128, meta);
+  get_layout (&layout, strides, offsets);
+  push_stream (create_stream (&layout, 128, N_FRAMES), 128, N_FRAMES);
+
+  fail_unless_equals_int (g_list_length (buffers), N_FRAMES);
+  for (l = buffers, i = 0; l; l = l->next, i++) {
+    if (meta)
+      fail_unless_equals_int (gst_buffer_get_size (l->data), 128);
+    check_frame (l->data, i, meta ? &layout : NULL);
+  }
+
+  cleanup_videoparse (videoparse);
+}
+
+GST_START_TEST (test_properties)
+{
+  GstElement *videoparse;
+  gchar *strides, *offsets;
+  guint framesize;
+
+  videoparse = gst_check_setup_element ("videoparse");
+
+  g_object_get (videoparse, "strides", &strides, "offsets", &offsets, NULL);
+  fail_unless (strides == NULL);
+  fail_unless (offsets == NULL);
+
+  g_object_set (videoparse, "strides", "16,8,8", "offsets", "0,80,64",
+      "framesize", 128, NULL);
+  g_object_get (videoparse, "strides", &strides, "offsets", &offsets,
+      "framesize", &framesize, NULL);
+  fail_unless_equals_string (strides, "16,8,8");
+  fail_unless_equals_string (offsets, "0,80,64");
+  fail_unless_equals_int (framesize, 128);
+  g_free (strides);
+  g_free (offsets);
+
+  /* parsing stops at the first invalid value */
+  g_object_set (videoparse, "strides", "16,-8,8", NULL);
+  g_object_get (videoparse, "strides", &strides, NULL);
+  fail_unless_equals_string (strides, "16");
+  g_free (strides);
+
+  g_object_set (videoparse, "strides", NULL, NULL);
+  g_object_get (videoparse, "strides", &strides, NULL);
+  fail_unless (strides == NULL);
+
+  gst_check_teardown_element (videoparse);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_default_layout)
+{
+  GstElement *videoparse;
+  GstVideoInfo info;
+  GList *l;
+  guint i;
+
+  /* the default layout never needs a meta */
+  videoparse = setup_videoparse (NULL, NULL, 0, TRUE);
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_I420, WIDTH, HEIGHT);
+  push_stream (create_stream (&info, GST_VIDEO_INFO_SIZE (&info), N_FRAMES),
+      GST_VIDEO_INFO_SIZE (&info), N_FRAMES);
+
+  fail_unless_equals_int (g_list_length (buffers), N_FRAMES);
+  for (l = buffers, i = 0; l; l = l->next, i++)
+    check_frame (l->data, i, NULL);
+
+  cleanup_videoparse (videoparse);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_custom_layout_meta)
+{
+  check_custom_layout (TRUE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_custom_layout_copy)
+{
+  check_custom_layout (FALSE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_offsets)
+{
+  static const gint strides[] = { 16, 8, 8 };
+  static const gsize offsets[] = { 0, 80, 64 };
+  GstElement *videoparse;
+  GstVideoInfo layout;
+  GList *l;
+  guint i;
+
+  /* V before U, the frame ends with the last line of U */
+  videoparse = setup_videoparse ("16,8,8", "0,80,64", 0, TRUE);
+  get_layout (&layout, strides, offsets);
+  push_stream (create_stream (&layout, 96, N_FRAMES), 96, N_FRAMES);
+
+  fail_unless_equals_int (g_list_length (buffers), N_FRAMES);
+  for (l = buffers, i = 0; l; l = l->next, i++) {
+    fail_unless_equals_int (gst_buffer_get_size (l->data), 96);
+    check_frame (l->data, i, &layout);
+  }
+
+  cleanup_videoparse (videoparse);
+}
+
+GST_END_TEST;
+
+/* 1000x1000 GRAY8 frames with 1024 byte lines padded to 1MB, so that a
+ * 4MB pull block holds exactly 4 frames */
+#define PULL_WIDTH 1000
+#define PULL_STRIDE 1024
+#define PULL_FRAMESIZE (1024 * 1024)
+#define PULL_N_FRAMES 10
+
+typedef struct
+{
+  GArray *pulls;
+  guint n_frames;
+  gboolean bad_frame;
+} PullData;
+
+static GstPadProbeReturn
+pull_probe (GstPad * pad, GstPadProbeInfo * info, PullData * data)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (buffer) {
+    gsize size = gst_buffer_get_size (buffer);
+
+    g_array_append_val (data->pulls, size);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad, PullData * data)
+{
+  GstMapInfo map;
+  guint y;
+
+  /* fakesink does not support GstVideoMeta, so frames come copied */
+  if (gst_buffer_get_size (buffer) != PULL_WIDTH * PULL_WIDTH ||
+      gst_buffer_get_video_meta (buffer) != NULL) {
+    data->bad_frame = TRUE;
+    return;
+  }
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  for (y = 0; y < PULL_WIDTH; y++) {
+    guint8 v = (data->n_frames * 7 + y) & 0xff;
+
+    if (map.data[y * PULL_WIDTH] != v ||
+        map.data[y * PULL_WIDTH + PULL_WIDTH - 1] != v)
+      data->bad_frame = TRUE;
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  data->n_frames++;
+}
+
+GST_START_TEST (test_pull_blocks)
+{
+  GstElement *pipeline, *src, *videoparse, *sink;
+  GstMessage *msg;
+  GstBus *bus;
+  GstPad *pad;
+  PullData data;
+  gchar *filename;
+  guint8 *stream;
+  guint i, y;
+  gint fd;
+
+  fd = g_file_open_tmp ("videoparse-XXXXXX", &filename, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+
+  stream = g_malloc0 (PULL_FRAMESIZE * PULL_N_FRAMES);
+  for (i = 0; i < PULL_N_FRAMES; i++) {
+    for (y = 0; y < PULL_WIDTH; y++)
+      memset (stream + i * PULL_FRAMESIZE + y * PULL_STRIDE,
+          (i * 7 + y) & 0xff, PULL_WIDTH);
+  }
+  fail_unless (g_file_set_contents (filename, (gchar *) stream,
+          PULL_FRAMESIZE * PULL_N_FRAMES, NULL));
+  g_free (stream);
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  videoparse = gst_element_factory_make ("videoparse", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (src && videoparse && sink);
+  g_object_set (src, "location", filename, NULL);
+  g_object_set (videoparse, "format", GST_VIDEO_FORMAT_GRAY8, "width",
+      PULL_WIDTH, "height", PULL_WIDTH, "strides", "1024", "framesize",
+      PULL_FRAMESIZE, NULL);
+  g_object_set (sink, "signal-handoffs", TRUE, NULL);
+  gst_bin_add_many (GST_BIN (pipeline), src, videoparse, sink, NULL);
+  fail_unless (gst_element_link_many (src, videoparse, sink, NULL));
+
+  data.pulls = g_array_new (FALSE, FALSE, sizeof (gsize));
+  data.n_frames = 0;
+  data.bad_frame = FALSE;
+  pad = gst_element_get_static_pad (videoparse, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_PULL | GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) pull_probe, &data, NULL);
+  gst_object_unref (pad);
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff), &data);
+
+  bus = gst_element_get_bus (pipeline);
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  /* all frames arrive in order, in three 4MB, 4MB and 2MB pulls */
+  fail_unless_equals_int (data.n_frames, PULL_N_FRAMES);
+  fail_if (data.bad_frame);
+  fail_unless_equals_int (data.pulls->len, 3);
+  fail_unless_equals_uint64 (g_array_index (data.pulls, gsize, 0),
+      4 * PULL_FRAMESIZE);
+  fail_unless_equals_uint64 (g_array_index (data.pulls, gsize, 1),
+      4 * PULL_FRAMESIZE);
+  fail_unless_equals_uint64 (g_array_index (data.pulls, gsize, 2),
+      2 * PULL_FRAMESIZE);
+
+  g_array_free (data.pulls, TRUE);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+  g_unlink (filename);
+  g_free (filename);
+}
+
+GST_END_TEST;
+
+static Suite *
+videoparse_suite (void)
+{
+  Suite *s = suite_create ("videoparse");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_properties);
+  tcase_add_test (tc_chain, test_default_layout);
+  tcase_add_test (tc_chain, test_custom_layout_meta);
+  tcase_add_test (tc_chain, test_custom_layout_copy);
+  tcase_add_test (tc_chain, test_offsets);
+  tcase_add_test (tc_chain, test_pull_blocks);
+
+  return s;
+}
+
+GST_CHECK_MAIN (videoparse);
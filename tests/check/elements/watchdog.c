@@ -0,0 +1,275 @@
+/* GStreamer
+ *
+ * unit test for watchdog
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#define N_WATCHDOGS 3
+
+static GstBus *bus;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+/* Returns a playing watchdog, with its own test pads and the shared bus */
+static GstElement *
+setup_watchdog (gint timeout, GstPad ** srcpad)
+{
+  GstElement *watchdog;
+  GstPad *sinkpad;
+  GstCaps *caps;
+
+  watchdog = gst_check_setup_element ("watchdog");
+  g_object_set (watchdog, "timeout", timeout, NULL);
+  *srcpad = gst_check_setup_src_pad (watchdog, &srctemplate);
+  sinkpad = gst_check_setup_sink_pad (watchdog, &sinktemplate);
+  gst_pad_set_active (*srcpad, TRUE);
+  gst_pad_set_active (sinkpad, TRUE);
+  gst_element_set_bus (watchdog, bus);
+
+  fail_unless (gst_element_set_state (watchdog,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_new_empty_simple ("application/x-test");
+  gst_check_setup_events (*srcpad, watchdog, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return watchdog;
+}
+
+static void
+cleanup_watchdog (GstElement * watchdog)
+{
+  GstPad *sinkpad, *srcpad;
+
+  fail_unless (gst_element_set_state (watchdog,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  gst_element_set_bus (watchdog, NULL);
+
+  /* deactivate the test pads linked to the watchdog */
+  sinkpad = gst_element_get_static_pad (watchdog, "sink");
+  srcpad = gst_element_get_static_pad (watchdog, "src");
+  gst_pad_set_active (GST_PAD_PEER (sinkpad), FALSE);
+  gst_pad_set_active (GST_PAD_PEER (srcpad), FALSE);
+  gst_object_unref (sinkpad);
+  gst_object_unref (srcpad);
+
+  gst_check_teardown_src_pad (watchdog);
+  gst_check_teardown_sink_pad (watchdog);
+  gst_check_teardown_element (watchdog);
+}
+
+static void
+setup (void)
+{
+  bus = gst_bus_new ();
+}
+
+static void
+teardown (void)
+{
+  gst_check_drop_buffers ();
+  gst_object_unref (bus);
+  bus = NULL;
+}
+
+static void
+get_stats (GstElement * watchdog, guint * stalls, guint64 * max_interval)
+{
+  GstStructure *s;
+
+  g_object_get (watchdog, "stats", &s, NULL);
+  fail_unless (s != NULL);
+  fail_unless (gst_structure_has_name (s, "application/x-watchdog-stats"));
+  fail_unless (gst_structure_get_uint (s, "stalls", stalls));
+  fail_unless (gst_structure_get_uint64 (s, "max-interval", max_interval));
+  gst_structure_free (s);
+}
+
+/* Waits up to a second for an error and returns the element posting it */
+static GstObject *
+pop_error (void)
+{
+  GstMessage *msg;
+  GstObject *src;
+
+  msg = gst_bus_timed_pop_filtered (bus, GST_SECOND, GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL, "no watchdog triggered");
+  src = gst_object_ref (GST_MESSAGE_SRC (msg));
+  gst_message_unref (msg);
+
+  return src;
+}
+
+GST_START_TEST (test_stats_initial)
+{
+  GstElement *watchdog;
+  guint64 max_interval;
+  guint stalls;
+
+  /* also readable without a timer */
+  watchdog = gst_check_setup_element ("watchdog");
+  get_stats (watchdog, &stalls, &max_interval);
+  fail_unless_equals_int (stalls, 0);
+  fail_unless_equals_uint64 (max_interval, 0);
+  gst_check_teardown_element (watchdog);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_several_fire)
+{
+  static const gint timeouts[N_WATCHDOGS] = { 100, 400, 700 };
+  GstElement *watchdogs[N_WATCHDOGS];
+  GstPad *srcpads[N_WATCHDOGS];
+  guint64 max_interval;
+  guint stalls;
+  gint i;
+
+  /* the watchdogs share one timer thread, which fires each of them in
+   * the order of their deadlines */
+  for (i = 0; i < N_WATCHDOGS; i++)
+    watchdogs[i] = setup_watchdog (timeouts[i], &srcpads[i]);
+
+  for (i = 0; i < N_WATCHDOGS; i++) {
+    GstObject *src = pop_error ();
+
+    fail_unless (src == GST_OBJECT (watchdogs[i]), "%s triggered as %d",
+        GST_OBJECT_NAME (src), i);
+    gst_object_unref (src);
+  }
+
+  /* each one fired once */
+  g_usleep (100 * 1000);
+  fail_if (gst_bus_have_pending (bus));
+  for (i = 0; i < N_WATCHDOGS; i++) {
+    get_stats (watchdogs[i], &stalls, &max_interval);
+    fail_unless_equals_int (stalls, 1);
+  }
+
+  /* a buffer re-arms a watchdog that fired */
+  fail_unless_equals_int (gst_pad_push (srcpads[0], gst_buffer_new ()),
+      GST_FLOW_OK);
+  gst_object_unref (pop_error ());
+  get_stats (watchdogs[0], &stalls, &max_interval);
+  fail_unless_equals_int (stalls, 2);
+
+  for (i = 0; i < N_WATCHDOGS; i++)
+    cleanup_watchdog (watchdogs[i]);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_feeding)
+{
+  GstElement *fed, *starved;
+  GstPad *fed_pad, *starved_pad;
+  GstObject *src;
+  guint64 max_interval;
+  guint stalls;
+  gint i;
+
+  fed = setup_watchdog (200, &fed_pad);
+  starved = setup_watchdog (200, &starved_pad);
+
+  /* buffers every 20ms keep one watchdog quiet, while the other fires */
+  for (i = 0; i < 25; i++) {
+    g_usleep (20 * 1000);
+    fail_unless_equals_int (gst_pad_push (fed_pad, gst_buffer_new ()),
+        GST_FLOW_OK);
+  }
+
+  src = pop_error ();
+  fail_unless (src == GST_OBJECT (starved));
+  gst_object_unref (src);
+  fail_if (gst_bus_have_pending (bus));
+
+  get_stats (fed, &stalls, &max_interval);
+  fail_unless_equals_int (stalls, 0);
+  fail_unless (max_interval >= 20 * GST_MSECOND);
+  fail_unless (max_interval < 200 * GST_MSECOND);
+
+  get_stats (starved, &stalls, &max_interval);
+  fail_unless_equals_int (stalls, 1);
+
+  /* the stats are kept when the watchdog stops */
+  fail_unless (gst_element_set_state (starved,
+          GST_STATE_READY) == GST_STATE_CHANGE_SUCCESS);
+  get_stats (starved, &stalls, &max_interval);
+  fail_unless_equals_int (stalls, 1);
+
+  cleanup_watchdog (fed);
+  cleanup_watchdog (starved);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_paused)
+{
+  GstElement *watchdog;
+  GstPad *srcpad;
+  guint64 max_interval;
+  guint stalls;
+
+  watchdog = setup_watchdog (100, &srcpad);
+
+  /* got a buffer, then no timer runs while paused */
+  fail_unless_equals_int (gst_pad_push (srcpad, gst_buffer_new ()),
+      GST_FLOW_OK);
+  fail_unless (gst_element_set_state (watchdog,
+          GST_STATE_PAUSED) == GST_STATE_CHANGE_SUCCESS);
+  g_usleep (300 * 1000);
+  fail_if (gst_bus_have_pending (bus));
+  get_stats (watchdog, &stalls, &max_interval);
+  fail_unless_equals_int (stalls, 0);
+
+  /* and the next buffer in playing starts it again */
+  fail_unless (gst_element_set_state (watchdog,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless_equals_int (gst_pad_push (srcpad, gst_buffer_new ()),
+      GST_FLOW_OK);
+  gst_object_unref (pop_error ());
+  get_stats (watchdog, &stalls, &max_interval);
+  fail_unless_equals_int (stalls, 1);
+
+  cleanup_watchdog (watchdog);
+}
+
+GST_END_TEST;
+
+static Suite *
+watchdog_suite (void)
+{
+  Suite *s = suite_create ("watchdog");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, setup, teardown);
+  tcase_add_test (tc_chain, test_stats_initial);
+  tcase_add_test (tc_chain, test_several_fire);
+  tcase_add_test (tc_chain, test_feeding);
+  tcase_add_test (tc_chain, test_paused);
+
+  return s;
+}
+
+GST_CHECK_MAIN (watchdog);
@@ -0,0 +1,319 @@
+/* GStreamer
+ *
+ * unit test for y4mdec in pull mode
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* 2s of 16x8 I420 at 25 fps, the luma of every frame is its number */
+#define WIDTH 16
+#define HEIGHT 8
+#define FRAME_SIZE (WIDTH * HEIGHT * 3 / 2)
+#define N_FRAMES 50
+#define FRAME_DURATION (GST_SECOND / 25)
+
+static gchar *filename;
+
+/* frame numbers of the rendered buffers and their timestamps */
+static GMutex lock;
+static GArray *frames;
+static GArray *timestamps;
+
+static void
+create_file (gboolean frame_parameters)
+{
+  GString *y4m;
+  guint8 data[FRAME_SIZE];
+  guint i;
+  gint fd;
+
+  y4m = g_string_new ("YUV4MPEG2 W16 H8 F25:1 Ip A1:1 C420\n");
+  for (i = 0; i < N_FRAMES; i++) {
+    /* parameters make some FRAME headers longer than the others */
+    if (frame_parameters && i % 3 == 1)
+      g_string_append (y4m, "FRAME Ip X=frame\n");
+    else
+      g_string_append (y4m, "FRAME\n");
+
+    memset (data, i, WIDTH * HEIGHT);
+    memset (data + WIDTH * HEIGHT, 128, FRAME_SIZE - WIDTH * HEIGHT);
+    g_string_append_len (y4m, (gchar *) data, FRAME_SIZE);
+  }
+
+  fd = g_file_open_tmp ("y4mdec-XXXXXX.y4m", &filename, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  fail_unless (g_file_set_contents (filename, y4m->str, y4m->len, NULL));
+  g_string_free (y4m, TRUE);
+}
+
+static void
+handoff_cb (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    gpointer user_data)
+{
+  GstClockTime ts = GST_BUFFER_PTS (buffer);
+  GstMapInfo map;
+  guint8 frame;
+
+  fail_unless_equals_int (gst_buffer_get_size (buffer), FRAME_SIZE);
+  fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+  frame = map.data[0];
+  /* the whole frame is the data of the same frame */
+  fail_unless_equals_int (map.data[WIDTH * HEIGHT - 1], frame);
+  fail_unless_equals_int (map.data[FRAME_SIZE - 1], 128);
+  gst_buffer_unmap (buffer, &map);
+
+  g_mutex_lock (&lock);
+  g_array_append_val (frames, frame);
+  g_array_append_val (timestamps, ts);
+  g_mutex_unlock (&lock);
+}
+
+static void
+reset_frames (void)
+{
+  g_mutex_lock (&lock);
+  g_array_set_size (frames, 0);
+  g_array_set_size (timestamps, 0);
+  g_mutex_unlock (&lock);
+}
+
+static GstElement *
+create_pipeline (void)
+{
+  GstElement *pipeline, *src, *dec, *sink;
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("filesrc", NULL);
+  dec = gst_element_factory_make ("y4mdec", NULL);
+  sink = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (src && dec && sink);
+
+  g_object_set (src, "location", filename, NULL);
+  g_object_set (sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (handoff_cb), NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, dec, sink, NULL);
+  fail_unless (gst_element_link_many (src, dec, sink, NULL));
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PAUSED),
+      GST_STATE_CHANGE_ASYNC);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  return pipeline;
+}
+
+static void
+destroy_pipeline (GstElement * pipeline)
+{
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (pipeline);
+}
+
+static void
+seek (GstElement * pipeline, gdouble rate, GstSeekFlags flags,
+    GstClockTime start, GstClockTime stop)
+{
+  reset_frames ();
+  fail_unless (gst_element_seek (pipeline, rate, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | flags, GST_SEEK_TYPE_SET, start,
+          GST_SEEK_TYPE_SET, stop));
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+}
+
+/* plays until @type and checks that frames @first to @last were rendered,
+ * in that order */
+static void
+play_and_check (GstElement * pipeline, GstMessageType type, guint first,
+    guint last)
+{
+  GstMessage *msg;
+  GstBus *bus;
+  guint i, n;
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      type | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), type);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PAUSED),
+      GST_STATE_CHANGE_SUCCESS);
+
+  g_mutex_lock (&lock);
+  n = first <= last ? last - first + 1 : first - last + 1;
+  fail_unless_equals_int (frames->len, n);
+  for (i = 0; i < n; i++) {
+    guint frame = first <= last ? first + i : first - i;
+
+    fail_unless_equals_int (g_array_index (frames, guint8, i), frame);
+    fail_unless_equals_uint64 (g_array_index (timestamps, GstClockTime, i),
+        frame * FRAME_DURATION);
+  }
+  g_mutex_unlock (&lock);
+}
+
+static void
+check_playback (void)
+{
+  GstElement *pipeline = create_pipeline ();
+  gint64 duration;
+
+  fail_unless (gst_element_query_duration (pipeline, GST_FORMAT_TIME,
+          &duration));
+  fail_unless_equals_uint64 (duration, N_FRAMES * FRAME_DURATION);
+
+  play_and_check (pipeline, GST_MESSAGE_EOS, 0, N_FRAMES - 1);
+
+  /* playback starts at the frame containing the position */
+  seek (pipeline, 1.0, 0, 25 * FRAME_DURATION + GST_MSECOND, -1);
+  play_and_check (pipeline, GST_MESSAGE_EOS, 25, N_FRAMES - 1);
+
+  seek (pipeline, 1.0, 0, 31 * FRAME_DURATION, 40 * FRAME_DURATION);
+  play_and_check (pipeline, GST_MESSAGE_EOS, 31, 39);
+
+  seek (pipeline, 1.0, 0, 0, -1);
+  play_and_check (pipeline, GST_MESSAGE_EOS, 0, N_FRAMES - 1);
+
+  destroy_pipeline (pipeline);
+}
+
+GST_START_TEST (test_seek)
+{
+  create_file (FALSE);
+  check_playback ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_seek_frame_parameters)
+{
+  /* the frames are indexed once the first parameter is found */
+  create_file (TRUE);
+  check_playback ();
+}
+
+GST_END_TEST;
+
+static void
+check_reverse (void)
+{
+  GstElement *pipeline = create_pipeline ();
+
+  seek (pipeline, -1.0, 0, 0, -1);
+  play_and_check (pipeline, GST_MESSAGE_EOS, N_FRAMES - 1, 0);
+
+  /* starts at the frame before the stop */
+  seek (pipeline, -1.0, 0, 10 * FRAME_DURATION, 20 * FRAME_DURATION);
+  play_and_check (pipeline, GST_MESSAGE_EOS, 19, 10);
+
+  seek (pipeline, -2.0, 0, 5 * FRAME_DURATION + GST_MSECOND,
+      12 * FRAME_DURATION + GST_MSECOND);
+  play_and_check (pipeline, GST_MESSAGE_EOS, 12, 5);
+
+  destroy_pipeline (pipeline);
+}
+
+GST_START_TEST (test_reverse)
+{
+  create_file (FALSE);
+  check_reverse ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_reverse_frame_parameters)
+{
+  create_file (TRUE);
+  check_reverse ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_segment_seek)
+{
+  GstElement *pipeline;
+
+  create_file (FALSE);
+  pipeline = create_pipeline ();
+
+  seek (pipeline, 1.0, GST_SEEK_FLAG_SEGMENT, 10 * FRAME_DURATION,
+      20 * FRAME_DURATION);
+  play_and_check (pipeline, GST_MESSAGE_SEGMENT_DONE, 10, 19);
+
+  seek (pipeline, -1.0, GST_SEEK_FLAG_SEGMENT, 30 * FRAME_DURATION,
+      40 * FRAME_DURATION);
+  play_and_check (pipeline, GST_MESSAGE_SEGMENT_DONE, 39, 30);
+
+  /* up to the end of the file */
+  seek (pipeline, 1.0, GST_SEEK_FLAG_SEGMENT, 45 * FRAME_DURATION, -1);
+  play_and_check (pipeline, GST_MESSAGE_SEGMENT_DONE, 45, N_FRAMES - 1);
+
+  destroy_pipeline (pipeline);
+}
+
+GST_END_TEST;
+
+static void
+y4mdec_setup (void)
+{
+  frames = g_array_new (FALSE, FALSE, sizeof (guint8));
+  timestamps = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+}
+
+static void
+y4mdec_teardown (void)
+{
+  g_array_free (frames, TRUE);
+  g_array_free (timestamps, TRUE);
+
+  if (filename) {
+    g_unlink (filename);
+    g_free (filename);
+    filename = NULL;
+  }
+}
+
+static Suite *
+y4mdec_suite (void)
+{
+  Suite *s = suite_create ("y4mdec");
+  TCase *tc_chain = tcase_create ("pull");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, y4mdec_setup, y4mdec_teardown);
+  tcase_add_test (tc_chain, test_seek);
+  tcase_add_test (tc_chain, test_seek_frame_parameters);
+  tcase_add_test (tc_chain, test_reverse);
+  tcase_add_test (tc_chain, test_reverse_frame_parameters);
+  tcase_add_test (tc_chain, test_segment_seek);
+
+  return s;
+}
+
+GST_CHECK_MAIN (y4mdec);
@@ -0,0 +1,140 @@
+/*
+ * bandrunner.c - GstBandRunner testsuite
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/base/gstbandrunner.h>
+
+#define MAX_BANDS 64
+
+typedef struct
+{
+  guint n_bands;
+  gint counts[MAX_BANDS];
+  GThread *threads[MAX_BANDS];
+} BandData;
+
+static void
+count_band (guint band, guint n_bands, gpointer user_data)
+{
+  BandData *data = user_data;
+
+  fail_unless (band < n_bands);
+  fail_unless_equals_int (n_bands, data->n_bands);
+
+  /* give the other threads a chance to take bands too */
+  g_usleep (1000);
+
+  data->threads[band] = g_thread_self ();
+  g_atomic_int_inc (&data->counts[band]);
+}
+
+static void
+run_and_check (GstBandRunner * runner, guint n_bands)
+{
+  BandData data = { 0, };
+  guint i;
+
+  data.n_bands = n_bands;
+  gst_band_runner_run (runner, n_bands, count_band, &data);
+
+  for (i = 0; i < n_bands; i++)
+    fail_unless_equals_int (data.counts[i], 1);
+}
+
+GST_START_TEST (test_single_thread)
+{
+  GstBandRunner *runner = gst_band_runner_new ();
+  BandData data = { 0, };
+  guint i;
+
+  fail_unless_equals_int (gst_band_runner_get_n_threads (runner), 1);
+
+  data.n_bands = 8;
+  gst_band_runner_run (runner, 8, count_band, &data);
+  for (i = 0; i < 8; i++) {
+    fail_unless_equals_int (data.counts[i], 1);
+    fail_unless (data.threads[i] == g_thread_self ());
+  }
+
+  /* no bands is not an error */
+  gst_band_runner_run (runner, 0, count_band, &data);
+
+  gst_band_runner_free (runner);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_threads)
+{
+  GstBandRunner *runner = gst_band_runner_new ();
+  GError *err = NULL;
+  guint n_bands;
+
+  fail_unless (gst_band_runner_set_threads (runner, 4, &err));
+  fail_unless (err == NULL);
+  fail_unless_equals_int (gst_band_runner_get_n_threads (runner), 4);
+
+  /* fewer, as many and more bands than threads, several times in a row */
+  for (n_bands = 1; n_bands <= MAX_BANDS; n_bands++)
+    run_and_check (runner, n_bands);
+  run_and_check (runner, 3);
+
+  /* back to one thread */
+  fail_unless (gst_band_runner_set_threads (runner, 1, NULL));
+  fail_unless_equals_int (gst_band_runner_get_n_threads (runner), 1);
+  run_and_check (runner, 5);
+
+  gst_band_runner_free (runner);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_threads_from_processors)
+{
+  GstBandRunner *runner = gst_band_runner_new ();
+
+  fail_unless (gst_band_runner_set_threads (runner, 0, NULL));
+  fail_unless_equals_int (gst_band_runner_get_n_threads (runner),
+      g_get_num_processors ());
+  run_and_check (runner, 16);
+
+  gst_band_runner_free (runner);
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_band_runner_suite (void)
+{
+  Suite *s = suite_create ("GstBandRunner");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_single_thread);
+  tcase_add_test (tc_chain, test_threads);
+  tcase_add_test (tc_chain, test_threads_from_processors);
+
+  return s;
+}
+
+GST_CHECK_MAIN (gst_band_runner);
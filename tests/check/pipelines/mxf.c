@@ -20,8 +20,16 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
 #include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
 #include <string.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 static const gchar *
 get_mpeg2enc_element_name (void)
@@ -260,6 +268,486 @@ GST_START_TEST (test_multiple_av_streams)
 
 GST_END_TEST;
 
+/* Writes a long file with mxfmux for the seek tests */
+static gchar *
+create_seek_test_file (guint n_frames)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  GstBus *bus;
+  gchar *desc, *location;
+  gint fd;
+
+  fd = g_file_open_tmp ("mxfseekXXXXXX.mxf", &location, NULL);
+  fail_unless (fd != -1);
+  close (fd);
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%u pattern=blue ! "
+      "video/x-raw,format=(string)v308,width=16,height=16,framerate=25/1 ! "
+      "mxfmux ! filesink location=%s", n_frames, location);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return location;
+}
+
+static GstPadProbeReturn
+count_pulled_bytes (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  gint *bytes = user_data;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER)
+    g_atomic_int_add (bytes,
+        gst_buffer_get_size (GST_PAD_PROBE_INFO_BUFFER (info)));
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstClockTime
+seek_and_get_position (GstElement * pipeline, GstElement * sink,
+    GstClockTime position, gint * bytes)
+{
+  GstSample *sample;
+  GstClockTime pts;
+  gint64 start;
+
+  g_atomic_int_set (bytes, 0);
+  start = g_get_monotonic_time ();
+  fail_unless (gst_element_seek_simple (pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE, position));
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  GST_INFO ("seek to %" GST_TIME_FORMAT " took %" G_GINT64_FORMAT " us and "
+      "pulled %d bytes", GST_TIME_ARGS (position),
+      g_get_monotonic_time () - start, g_atomic_int_get (bytes));
+
+  g_object_get (sink, "last-sample", &sample, NULL);
+  fail_unless (sample != NULL);
+  pts = GST_BUFFER_PTS (gst_sample_get_buffer (sample));
+  gst_sample_unref (sample);
+
+  return pts;
+}
+
+GST_START_TEST (test_seek_pull)
+{
+  static const GstClockTime positions[] = {
+    100 * GST_SECOND, 10 * GST_SECOND, 50 * GST_SECOND + 40 * GST_MSECOND,
+    110 * GST_SECOND, 99 * GST_SECOND + 960 * GST_MSECOND
+  };
+  GstElement *pipeline, *src, *sink;
+  GstPad *srcpad;
+  gchar *location, *desc;
+  gint bytes = 0;
+  guint i;
+
+  /* 2 minutes of video */
+  location = create_seek_test_file (3000);
+
+  desc = g_strdup_printf ("filesrc name=src location=%s ! mxfdemux ! "
+      "fakesink name=sink sync=false", location);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  srcpad = gst_element_get_static_pad (src, "src");
+  gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_PULL |
+      GST_PAD_PROBE_TYPE_BUFFER, count_pulled_bytes, &bytes, NULL);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  for (i = 0; i < G_N_ELEMENTS (positions); i++) {
+    GstClockTime pts;
+
+    pts = seek_and_get_position (pipeline, sink, positions[i], &bytes);
+    fail_unless_equals_uint64 (pts, positions[i]);
+
+    /* Everything up to the first position was indexed while seeking there,
+     * later seeks before it must not scan the file again */
+    if (positions[i] < positions[0])
+      fail_unless (bytes < 64 * 1024, "seek pulled %d bytes", bytes);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (srcpad);
+  gst_object_unref (src);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+
+  g_unlink (location);
+  g_free (location);
+}
+
+GST_END_TEST;
+
+static const guint8 partition_pack_key[] = {
+  0x06, 0x0e, 0x2b, 0x34, 0x02, 0x05, 0x01, 0x01,
+  0x0d, 0x01, 0x02, 0x01, 0x01
+};
+
+static const guint8 index_table_segment_key[] = {
+  0x06, 0x0e, 0x2b, 0x34, 0x02, 0x53, 0x01, 0x01,
+  0x0d, 0x01, 0x02, 0x01, 0x01, 0x10, 0x01, 0x00
+};
+
+static const guint8 random_index_pack_key[] = {
+  0x06, 0x0e, 0x2b, 0x34, 0x02, 0x05, 0x01, 0x01,
+  0x0d, 0x01, 0x02, 0x01, 0x01, 0x11, 0x01, 0x00
+};
+
+typedef struct
+{
+  const guint8 *data;
+  /* key and BER length */
+  guint header_size;
+  /* of the complete packet */
+  gsize size;
+} KLVPacket;
+
+static void
+parse_klv (const guint8 * data, gsize size, gsize offset, KLVPacket * klv)
+{
+  guint64 length;
+  guint i, n;
+
+  fail_unless (offset + 17 <= size);
+  klv->data = data + offset;
+
+  if (klv->data[16] < 0x80) {
+    length = klv->data[16];
+    klv->header_size = 17;
+  } else {
+    n = klv->data[16] & 0x7f;
+    fail_unless (n > 0 && n <= 8 && offset + 17 + n <= size);
+    for (i = 0, length = 0; i < n; i++)
+      length = (length << 8) | klv->data[17 + i];
+    klv->header_size = 17 + n;
+  }
+
+  fail_unless (offset + klv->header_size + length <= size);
+  klv->size = klv->header_size + length;
+}
+
+static void
+append_klv (GByteArray * out, const guint8 * key, const guint8 * value,
+    guint length)
+{
+  guint8 ber[4];
+
+  ber[0] = 0x83;
+  GST_WRITE_UINT24_BE (ber + 1, length);
+  g_byte_array_append (out, key, 16);
+  g_byte_array_append (out, ber, 4);
+  g_byte_array_append (out, value, length);
+}
+
+/* Appends a copy of the partition pack @pack with new offsets and SIDs */
+static void
+append_partition_pack (GByteArray * out, const KLVPacket * pack,
+    guint64 this_partition, guint64 prev_partition, guint64 footer_partition,
+    guint64 index_byte_count, guint32 index_sid, guint64 body_offset,
+    guint32 body_sid)
+{
+  guint length = pack->size - pack->header_size;
+  guint8 *value = g_memdup (pack->data + pack->header_size, length);
+
+  GST_WRITE_UINT64_BE (value + 8, this_partition);
+  GST_WRITE_UINT64_BE (value + 16, prev_partition);
+  GST_WRITE_UINT64_BE (value + 24, footer_partition);
+  GST_WRITE_UINT64_BE (value + 40, index_byte_count);
+  GST_WRITE_UINT32_BE (value + 48, index_sid);
+  GST_WRITE_UINT64_BE (value + 52, body_offset);
+  GST_WRITE_UINT32_BE (value + 60, body_sid);
+  append_klv (out, pack->data, value, length);
+  g_free (value);
+}
+
+static void
+append_local_tag (GByteArray * out, guint16 tag, const guint8 * data,
+    guint16 size)
+{
+  guint8 header[4];
+
+  GST_WRITE_UINT16_BE (header, tag);
+  GST_WRITE_UINT16_BE (header + 2, size);
+  g_byte_array_append (out, header, 4);
+  g_byte_array_append (out, data, size);
+}
+
+/* Appends an index table segment of body SID 1 for @duration edit units of
+ * @edit_unit_size bytes from @start. VBR segments have an entry per edit
+ * unit, every fifth of them a keyframe the others point to with their
+ * KeyFrameOffset */
+static void
+append_index_table_segment (GByteArray * out, guint64 start,
+    guint64 duration, guint32 edit_unit_size, gboolean cbr)
+{
+  GByteArray *value = g_byte_array_new ();
+  guint8 data[16];
+  guint8 *entries;
+  guint i;
+
+  memset (data, 0, 16);
+  GST_WRITE_UINT64_BE (data, start);
+  data[8] = cbr;
+  append_local_tag (value, 0x3c0a, data, 16);
+  GST_WRITE_UINT32_BE (data, 25);
+  GST_WRITE_UINT32_BE (data + 4, 1);
+  append_local_tag (value, 0x3f0b, data, 8);
+  GST_WRITE_UINT64_BE (data, start);
+  append_local_tag (value, 0x3f0c, data, 8);
+  GST_WRITE_UINT64_BE (data, duration);
+  append_local_tag (value, 0x3f0d, data, 8);
+  GST_WRITE_UINT32_BE (data, cbr ? edit_unit_size : 0);
+  append_local_tag (value, 0x3f05, data, 4);
+  GST_WRITE_UINT32_BE (data, 2);
+  append_local_tag (value, 0x3f06, data, 4);
+  GST_WRITE_UINT32_BE (data, 1);
+  append_local_tag (value, 0x3f07, data, 4);
+  data[0] = 0;
+  append_local_tag (value, 0x3f08, data, 1);
+  append_local_tag (value, 0x3f0e, data, 1);
+
+  if (!cbr) {
+    entries = g_malloc (8 + 11 * duration);
+    GST_WRITE_UINT32_BE (entries, duration);
+    GST_WRITE_UINT32_BE (entries + 4, 11);
+    for (i = 0; i < duration; i++) {
+      guint8 *entry = entries + 8 + 11 * i;
+      gint8 key_frame_offset = -(gint) ((start + i) % 5);
+
+      GST_WRITE_UINT8 (entry, 0);
+      GST_WRITE_UINT8 (entry + 1, (guint8) key_frame_offset);
+      GST_WRITE_UINT8 (entry + 2, key_frame_offset == 0 ? 0x80 : 0x00);
+      GST_WRITE_UINT64_BE (entry + 3, (start + i) * edit_unit_size);
+    }
+    append_local_tag (value, 0x3f0a, entries, 8 + 11 * duration);
+    g_free (entries);
+  }
+
+  append_klv (out, index_table_segment_key, value->data, value->len);
+  g_byte_array_free (value, TRUE);
+}
+
+/* Rewrites a file written by mxfmux into one with its essence spread over
+ * three body partitions with these index table segments:
+ *  - 1st partition: CBR for edit units 0-99
+ *  - 2nd partition: VBR for edit units 100-179
+ *  - 3rd partition: the CBR one again, and VBR for edit units 170-249 that
+ *    overlaps with the previous one
+ * The footer has no index table segments and the random index pack is only
+ * written if @with_rip is TRUE, otherwise the partitions can only be found
+ * from the footer by their PreviousPartition */
+static gchar *
+create_index_test_file (gboolean with_rip)
+{
+  static const guint bounds[] = { 0, 100, 180, 250 };
+  gchar *location, *contents;
+  gsize size, offset;
+  KLVPacket klv, header_pack = { NULL, }, body_pack = { NULL, };
+  KLVPacket footer_pack = { NULL, };
+  GByteArray *header_metadata, *footer_metadata, *index[3], *rip, *out;
+  GArray *elements;
+  guint64 partitions[3], footer, pos;
+  guint8 section = 0, data[12];
+  gsize edit_unit_size;
+  guint i, j;
+
+  location = create_seek_test_file (bounds[3]);
+  fail_unless (g_file_get_contents (location, &contents, &size, NULL));
+
+  header_metadata = g_byte_array_new ();
+  footer_metadata = g_byte_array_new ();
+  elements = g_array_new (FALSE, FALSE, sizeof (KLVPacket));
+
+  /* header partition with the header metadata, body partition with the
+   * essence, footer partition with the header metadata and the index */
+  for (offset = 0; offset < size; offset += klv.size) {
+    parse_klv ((const guint8 *) contents, size, offset, &klv);
+
+    if (memcmp (klv.data, partition_pack_key, 13) == 0) {
+      section = klv.data[13];
+      if (section == 0x02)
+        header_pack = klv;
+      else if (section == 0x03)
+        body_pack = klv;
+      else
+        footer_pack = klv;
+    } else if (section == 0x02) {
+      g_byte_array_append (header_metadata, klv.data, klv.size);
+    } else if (section == 0x03) {
+      g_array_append_val (elements, klv);
+    } else if (memcmp (klv.data, index_table_segment_key, 16) != 0 &&
+        memcmp (klv.data, random_index_pack_key, 16) != 0) {
+      g_byte_array_append (footer_metadata, klv.data, klv.size);
+    }
+  }
+
+  fail_unless (header_pack.data != NULL);
+  fail_unless (body_pack.data != NULL);
+  fail_unless (footer_pack.data != NULL);
+  fail_unless_equals_int (elements->len, bounds[3]);
+
+  /* one element of the same size per content package */
+  edit_unit_size = g_array_index (elements, KLVPacket, 0).size;
+  for (i = 0; i < elements->len; i++)
+    fail_unless_equals_int (g_array_index (elements, KLVPacket, i).size,
+        edit_unit_size);
+
+  for (i = 0; i < 3; i++)
+    index[i] = g_byte_array_new ();
+  append_index_table_segment (index[0], 0, 100, edit_unit_size, TRUE);
+  append_index_table_segment (index[1], 100, 80, edit_unit_size, FALSE);
+  append_index_table_segment (index[2], 0, 100, edit_unit_size, TRUE);
+  append_index_table_segment (index[2], 170, 80, edit_unit_size, FALSE);
+
+  pos = 20 + header_pack.size - header_pack.header_size + header_metadata->len;
+  for (i = 0; i < 3; i++) {
+    partitions[i] = pos;
+    pos += 20 + body_pack.size - body_pack.header_size + index[i]->len +
+        (bounds[i + 1] - bounds[i]) * edit_unit_size;
+  }
+  footer = pos;
+
+  out = g_byte_array_new ();
+  append_partition_pack (out, &header_pack, 0, 0, footer, 0, 0, 0, 0);
+  g_byte_array_append (out, header_metadata->data, header_metadata->len);
+
+  for (i = 0; i < 3; i++) {
+    fail_unless_equals_uint64 (out->len, partitions[i]);
+    append_partition_pack (out, &body_pack, partitions[i],
+        i > 0 ? partitions[i - 1] : 0, footer, index[i]->len, 2,
+        bounds[i] * edit_unit_size, 1);
+    g_byte_array_append (out, index[i]->data, index[i]->len);
+    for (j = bounds[i]; j < bounds[i + 1]; j++) {
+      KLVPacket *element = &g_array_index (elements, KLVPacket, j);
+
+      g_byte_array_append (out, element->data, element->size);
+    }
+    g_byte_array_free (index[i], TRUE);
+  }
+
+  fail_unless_equals_uint64 (out->len, footer);
+  append_partition_pack (out, &footer_pack, footer, partitions[2], footer, 0,
+      0, 0, 0);
+  g_byte_array_append (out, footer_metadata->data, footer_metadata->len);
+
+  if (with_rip) {
+    rip = g_byte_array_new ();
+    for (i = 0; i < 5; i++) {
+      GST_WRITE_UINT32_BE (data, i > 0 && i < 4 ? 1 : 0);
+      GST_WRITE_UINT64_BE (data + 4,
+          i == 0 ? 0 : (i < 4 ? partitions[i - 1] : footer));
+      g_byte_array_append (rip, data, 12);
+    }
+    /* overall length of the pack */
+    GST_WRITE_UINT32_BE (data, 20 + rip->len + 4);
+    g_byte_array_append (rip, data, 4);
+    append_klv (out, random_index_pack_key, rip->data, rip->len);
+    g_byte_array_free (rip, TRUE);
+  }
+
+  fail_unless (g_file_set_contents (location, (const gchar *) out->data,
+          out->len, NULL));
+
+  g_byte_array_free (out, TRUE);
+  g_byte_array_free (header_metadata, TRUE);
+  g_byte_array_free (footer_metadata, TRUE);
+  g_array_free (elements, TRUE);
+  g_free (contents);
+
+  return location;
+}
+
+static void
+run_index_seek_test (gboolean with_rip)
+{
+  /* In the 3rd partition, in the overlap of the two VBR ranges and in the
+   * 2nd partition the keyframe is found by the KeyFrameOffset of the entry,
+   * the last one is in the CBR range */
+  static const guint edit_units[] = { 243, 177, 138, 60 };
+  GstElement *pipeline, *src, *sink;
+  GstPad *srcpad;
+  gchar *location, *desc;
+  gint bytes = 0;
+  guint i;
+
+  location = create_index_test_file (with_rip);
+
+  desc = g_strdup_printf ("filesrc name=src location=%s ! mxfdemux ! "
+      "fakesink name=sink sync=false", location);
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  srcpad = gst_element_get_static_pad (src, "src");
+  gst_pad_add_probe (srcpad, GST_PAD_PROBE_TYPE_PULL |
+      GST_PAD_PROBE_TYPE_BUFFER, count_pulled_bytes, &bytes, NULL);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE);
+  fail_unless_equals_int (gst_element_get_state (pipeline, NULL, NULL,
+          GST_CLOCK_TIME_NONE), GST_STATE_CHANGE_SUCCESS);
+
+  for (i = 0; i < G_N_ELEMENTS (edit_units); i++) {
+    GstClockTime position, pts;
+
+    position = gst_util_uint64_scale (edit_units[i], GST_SECOND, 25);
+    pts = seek_and_get_position (pipeline, sink, position, &bytes);
+    fail_unless_equals_uint64 (pts, position);
+
+    /* Only the partition packs, the index table segments and the content
+     * packages from the keyframe on are read. Scanning forward from the
+     * closest edit unit known before would read more than 45 kB */
+    fail_unless (bytes < 32 * 1024, "seek to edit unit %u pulled %d bytes",
+        edit_units[i], bytes);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (srcpad);
+  gst_object_unref (src);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+
+  g_unlink (location);
+  g_free (location);
+}
+
+GST_START_TEST (test_seek_index_tables)
+{
+  run_index_seek_test (TRUE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_seek_index_tables_no_rip)
+{
+  run_index_seek_test (FALSE);
+}
+
+GST_END_TEST;
+
 static Suite *
 mxf_suite (void)
 {
@@ -280,6 +768,9 @@ mxf_suite (void)
   tcase_add_test (tc_chain, test_jpeg2000_alaw);
   tcase_add_test (tc_chain, test_dnxhd_mp3);
   tcase_add_test (tc_chain, test_multiple_av_streams);
+  tcase_add_test (tc_chain, test_seek_pull);
+  tcase_add_test (tc_chain, test_seek_index_tables);
+  tcase_add_test (tc_chain, test_seek_index_tables_no_rip);
 
   return s;
 }